@@ -0,0 +1,26 @@
+#! /usr/bin/env bash
+#
+# Reports record fields looked up by name in the code running per packet,
+# connection or file. Such lookups walk the record type's fields and
+# compare each name on every call; use a RecordFieldHandle instead.
+# Lookups stored in a static happen only once and are fine, as are lines
+# marked with "NOLINT(field-lookup)".
+#
+# Usage: lint-field-lookups.sh [<zeek source directory>]
+
+cd "${1:-$(dirname "$0")/..}" || exit 1
+
+paths="src/analyzer src/packet_analysis src/file_analysis/analyzer src/iosource
+       src/Conn.cc src/Sessions.cc src/Reporter.cc src/zeek.bif src/strings.bif"
+
+matches=$(grep -rnE '(GetField|GetFieldOrDefault|GetFieldType|FieldOffset|HasField)\("' \
+	--include='*.cc' --include='*.h' --include='*.bif' --include='*.pac' ${paths} |
+	grep -v 'static' | grep -v 'NOLINT(field-lookup)')
+
+if [ -n "${matches}" ]; then
+    echo "Record fields looked up by name, consider a RecordFieldHandle:"
+    echo "${matches}"
+    exit 1
+fi
+
+exit 0
@@ -0,0 +1,163 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "AllocationProfiler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+#include "Frame.h"
+#include "ID.h"
+#include "Reporter.h"
+#include "RunState.h"
+#include "Scope.h"
+#include "Stmt.h"
+#include "Val.h"
+#include "util.h"
+
+namespace zeek::detail {
+
+// The number of sites and globals a report lists.
+static constexpr size_t REPORT_TOP = 25;
+
+AllocationProfiler::AllocationProfiler(std::string arg_file)
+	: file(std::move(arg_file))
+	{
+	struct sigaction action;
+	action.sa_handler = HandleSignal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	if ( sigaction(SIGUSR1, &action, &old_action) < 0 )
+		reporter->Error("failed to install allocation profiler signal handler: %s", strerror(errno));
+	else
+		have_handler = true;
+	}
+
+AllocationProfiler::~AllocationProfiler()
+	{
+	if ( have_handler )
+		sigaction(SIGUSR1, &old_action, nullptr);
+	}
+
+void AllocationProfiler::HandleSignal(int /* signo */)
+	{
+	dump_due = 1;
+	}
+
+void AllocationProfiler::Allocated(const Val* v)
+	{
+	const Location* loc = nullptr;
+
+	if ( ! g_frame_stack.empty() )
+		if ( const auto* stmt = g_frame_stack.back()->GetNextStmt() )
+			loc = stmt->GetLocationInfo();
+
+	auto& site = sites[loc];
+
+	if ( site.where.empty() )
+		{
+		if ( loc && loc->filename )
+			site.where = util::fmt("%s:%d", loc->filename, loc->first_line);
+		else
+			site.where = "<outside of script functions>";
+		}
+
+	++site.allocations;
+	++site.live;
+	live[v] = &site;
+	}
+
+bool AllocationProfiler::Dump()
+	{
+	dump_due = 0;
+
+	FILE* f = fopen(file.c_str(), "a");
+
+	if ( ! f )
+		{
+		reporter->Error("Failed to open ZEEK_ALLOC_PROFILE_FILE destination '%s' for writing", file.c_str());
+		return false;
+		}
+
+	Dump(f);
+	fclose(f);
+	return true;
+	}
+
+void AllocationProfiler::Dump(FILE* f)
+	{
+	struct Total {
+		uint64_t allocations = 0;
+		uint64_t live = 0;
+		uint64_t bytes = 0;
+	};
+
+	// Charge each live value the memory it references, except for
+	// other tracked values which count for their own sites. Memory
+	// referenced from more than one place goes to the first.
+	std::unordered_set<const void*> seen;
+
+	for ( const auto& l : live )
+		seen.insert(l.first);
+
+	// Locations of different statements on the same line go together.
+	std::map<std::string, Total> totals;
+
+	for ( const auto& s : sites )
+		{
+		auto& t = totals[s.second.where];
+		t.allocations += s.second.allocations;
+		t.live += s.second.live;
+		}
+
+	for ( const auto& l : live )
+		{
+		seen.erase(l.first);
+		totals[l.second->where].bytes += l.first->Footprint(&seen);
+		}
+
+	std::vector<std::pair<std::string, Total>> by_bytes(totals.begin(), totals.end());
+	std::sort(by_bytes.begin(), by_bytes.end(),
+	          [](const auto& a, const auto& b) { return a.second.bytes > b.second.bytes; });
+
+	fprintf(f, "# allocation profile at %.6f, network time %.6f\n",
+	        util::current_time(), run_state::network_time);
+	fprintf(f, "# %14s %10s %12s  %s\n", "live_bytes", "live", "allocations", "site");
+
+	for ( size_t i = 0; i < by_bytes.size() && i < REPORT_TOP; ++i )
+		{
+		const auto& t = by_bytes[i].second;
+		fprintf(f, "  %14" PRIu64 " %10" PRIu64 " %12" PRIu64 "  %s\n",
+		        t.bytes, t.live, t.allocations, by_bytes[i].first.c_str());
+		}
+
+	std::vector<std::pair<uint64_t, const char*>> globals;
+
+	for ( const auto& g : global_scope()->Vars() )
+		{
+		const auto& id = g.second;
+
+		if ( ! id->HasVal() || id->IsConst() )
+			continue;
+
+		std::unordered_set<const void*> global_seen;
+		globals.emplace_back(id->GetVal()->Footprint(&global_seen), id->Name());
+		}
+
+	std::sort(globals.begin(), globals.end(),
+	          [](const auto& a, const auto& b) { return a.first > b.first; });
+
+	fprintf(f, "# %14s  %s\n", "bytes", "global");
+
+	for ( size_t i = 0; i < globals.size() && i < REPORT_TOP; ++i )
+		fprintf(f, "  %14" PRIu64 "  %s\n", globals[i].first, globals[i].second);
+
+	fflush(f);
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,105 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <signal.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+namespace zeek {
+
+class Val;
+
+namespace detail {
+
+class Location;
+
+/**
+ * Attributes the allocation of tables, sets, vectors and records to the
+ * script location that created them, to find the state that keeps
+ * growing. Values created by the core or outside of any function count
+ * as such.
+ *
+ * Profiling is active when the environment variable
+ * ZEEK_ALLOC_PROFILE_FILE names an output file. Zeek then appends a
+ * report of the top allocation sites and the largest globals to that
+ * file upon SIGUSR1, when calling dump_allocation_profile(), and at
+ * shutdown.
+ */
+class AllocationProfiler {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param file The file to append reports to.
+	 */
+	explicit AllocationProfiler(std::string file);
+	~AllocationProfiler();
+
+	/**
+	 * Records the creation of an aggregate value.
+	 */
+	void Allocated(const Val* v);
+
+	/**
+	 * Records the destruction of an aggregate value.
+	 */
+	void Freed(const Val* v)
+		{
+		if ( auto it = live.find(v); it != live.end() )
+			{
+			--it->second->live;
+			live.erase(it);
+			}
+		}
+
+	/**
+	 * Returns true if SIGUSR1 came in since the last report.
+	 */
+	static bool DumpDue()	{ return dump_due; }
+
+	/**
+	 * Appends a report to the configured file.
+	 *
+	 * @return: true if the report was written, otherwise false.
+	 */
+	bool Dump();
+
+	/**
+	 * Writes a report.
+	 *
+	 * @param f The file to write to.
+	 */
+	void Dump(FILE* f);
+
+private:
+	static void HandleSignal(int signo);
+
+	struct Site {
+		std::string where;
+		uint64_t allocations = 0;
+		uint64_t live = 0;
+	};
+
+	inline static volatile sig_atomic_t dump_due = 0;
+
+	std::string file;
+	struct sigaction old_action;
+	bool have_handler = false;
+
+	// Sites by the location of the statement allocating, with null
+	// for allocations outside of script functions.
+	std::unordered_map<const Location*, Site> sites;
+
+	// The site of each live value.
+	std::unordered_map<const Val*, Site*> live;
+};
+
+// Only set if profiling is active.
+extern AllocationProfiler* alloc_profiler;
+
+} // namespace detail
+} // namespace zeek
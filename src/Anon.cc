@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <sys/time.h>
+#include <openssl/evp.h>
 
 #include "util.h"
 #include "net_util.h"
@@ -15,6 +16,8 @@
 #include "IPAddr.h"
 #include "Event.h"
 
+#include "3rdparty/doctest.h"
+
 namespace zeek::detail {
 
 AnonymizeIPAddr* ip_anonymizer[NUM_ADDR_ANONYMIZATION_METHODS] = {nullptr};
@@ -61,16 +64,26 @@ static int bi_ffs(uint32_t value)
 
 ipaddr32_t AnonymizeIPAddr::Anonymize(ipaddr32_t addr)
 	{
-	std::map<ipaddr32_t, ipaddr32_t>::iterator p = mapping.find(addr);
-	if ( p != mapping.end() )
-		return p->second;
-	else
+	auto p = cache_index.find(addr);
+
+	if ( p != cache_index.end() )
 		{
-		ipaddr32_t new_addr = anonymize(addr);
-		mapping[addr] = new_addr;
+		cache.splice(cache.begin(), cache, p->second);
+		return p->second->second;
+		}
+
+	ipaddr32_t new_addr = anonymize(addr);
 
-		return new_addr;
+	if ( cache.size() >= CACHE_SIZE )
+		{
+		cache_index.erase(cache.back().first);
+		cache.pop_back();
 		}
+
+	cache.emplace_front(addr, new_addr);
+	cache_index[addr] = cache.begin();
+
+	return new_addr;
 	}
 
 // Keep the specified prefix unchanged.
@@ -94,10 +107,16 @@ bool AnonymizeIPAddr::PreserveNet(ipaddr32_t input)
 	}
 	}
 
-ipaddr32_t AnonymizeIPAddr_Seq::anonymize(ipaddr32_t /* input */)
+ipaddr32_t AnonymizeIPAddr_Seq::anonymize(ipaddr32_t input)
 	{
+	// Remember all mappings, as we couldn't recreate evicted ones.
+	auto p = mapping.find(input);
+
+	if ( p != mapping.end() )
+		return p->second;
+
 	++seq;
-	return htonl(seq);
+	return mapping[input] = htonl(seq);
 	}
 
 ipaddr32_t AnonymizeIPAddr_RandomMD5::anonymize(ipaddr32_t input)
@@ -145,6 +164,75 @@ ipaddr32_t AnonymizeIPAddr_PrefixMD5::anonymize(ipaddr32_t input)
 	return htonl(output);
 	}
 
+AnonymizeIPAddr_CryptoPAn::AnonymizeIPAddr_CryptoPAn()
+	{
+	uint8_t key[32];
+	static const char key_label[] = "Crypto-PAn key";
+	static const char pad_label[] = "Crypto-PAn pad";
+
+	util::detail::hmac_md5(sizeof(key_label), (const u_char*) key_label, key);
+	util::detail::hmac_md5(sizeof(pad_label), (const u_char*) pad_label, key + 16);
+	init(key);
+	}
+
+AnonymizeIPAddr_CryptoPAn::AnonymizeIPAddr_CryptoPAn(const uint8_t key[32])
+	{
+	init(key);
+	}
+
+AnonymizeIPAddr_CryptoPAn::~AnonymizeIPAddr_CryptoPAn()
+	{
+	EVP_CIPHER_CTX_free(ctx);
+	}
+
+void AnonymizeIPAddr_CryptoPAn::init(const uint8_t key[32])
+	{
+	int len;
+	ctx = EVP_CIPHER_CTX_new();
+
+	if ( ! ctx ||
+	     ! EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), nullptr, key, nullptr) ||
+	     ! EVP_CIPHER_CTX_set_padding(ctx, 0) ||
+	     ! EVP_EncryptUpdate(ctx, pad, &len, key + 16, 16) )
+		reporter->InternalError("failed to initialize Crypto-PAn cipher");
+	}
+
+ipaddr32_t AnonymizeIPAddr_CryptoPAn::anonymize(ipaddr32_t input)
+	{
+	uint8_t in[32][16];
+	uint8_t out[32][16];
+	input = ntohl(input);
+
+	ipaddr32_t pad_prefix = (ipaddr32_t(pad[0]) << 24) | (pad[1] << 16) |
+	                          (pad[2] << 8) | pad[3];
+
+	// Block i holds the first i bits of the input, followed by the pad.
+	for ( int i = 0; i < 32; ++i )
+		{
+		ipaddr32_t mask = first_n_bit_mask(i);
+		ipaddr32_t p = (input & mask) | (pad_prefix & ~mask);
+
+		memcpy(in[i], pad, sizeof(pad));
+		in[i][0] = p >> 24;
+		in[i][1] = p >> 16;
+		in[i][2] = p >> 8;
+		in[i][3] = p;
+		}
+
+	int len;
+
+	if ( ! EVP_EncryptUpdate(ctx, &out[0][0], &len, &in[0][0], sizeof(in)) )
+		reporter->InternalError("Crypto-PAn encryption failed");
+
+	// Flip bit i of the input by the first bit of block i's ciphertext.
+	ipaddr32_t flip = 0;
+
+	for ( int i = 0; i < 32; ++i )
+		flip |= ipaddr32_t(out[i][0] >> 7) << (31 - i);
+
+	return htonl(input ^ flip);
+	}
+
 AnonymizeIPAddr_A50::~AnonymizeIPAddr_A50()
 	{
 	for ( auto& b : blocks )
@@ -370,6 +458,7 @@ void init_ip_addr_anonymizers()
 	ip_anonymizer[RANDOM_MD5] = new AnonymizeIPAddr_RandomMD5();
 	ip_anonymizer[PREFIX_PRESERVING_A50] = new AnonymizeIPAddr_A50();
 	ip_anonymizer[PREFIX_PRESERVING_MD5] = new AnonymizeIPAddr_PrefixMD5();
+	ip_anonymizer[PREFIX_PRESERVING_CRYPTOPAN] = new AnonymizeIPAddr_CryptoPAn();
 
 	auto id = global_scope()->Find("preserve_orig_addr");
 
@@ -450,4 +539,45 @@ void log_anonymization_mapping(ipaddr32_t input, ipaddr32_t output)
 
 #endif
 
+TEST_CASE("anonymize crypto-pan")
+	{
+	// The sample key and mappings from the Crypto-PAn reference code.
+	const uint8_t key[32] = {
+		21, 34, 23, 141, 51, 164, 207, 128, 19, 10, 91, 22, 73, 144, 125, 16,
+		216, 152, 143, 131, 121, 121, 101, 39, 98, 87, 76, 45, 42, 132, 34, 2
+	};
+
+	AnonymizeIPAddr_CryptoPAn anon(key);
+
+	auto check = [&anon](const char* in, const char* out)
+		{
+		const uint32_t* bytes;
+		IPAddr(in).GetBytes(&bytes);
+		uint32_t anonymized = anon.Anonymize(*bytes);
+		CHECK(IPAddr(IPv4, &anonymized, IPAddr::Network) == IPAddr(out));
+		};
+
+	check("128.11.68.132", "135.242.180.132");
+	check("129.118.74.4", "134.136.186.123");
+	check("130.132.252.244", "133.68.164.234");
+	check("141.223.7.43", "141.167.8.160");
+
+	// Again, from the cache.
+	check("128.11.68.132", "135.242.180.132");
+	}
+
+TEST_CASE("anonymize cache")
+	{
+	AnonymizeIPAddr_Seq anon;
+
+	ipaddr32_t first = anon.Anonymize(htonl(1));
+
+	for ( ipaddr32_t i = 2; i < AnonymizeIPAddr::CACHE_SIZE + 10; ++i )
+		anon.Anonymize(htonl(i));
+
+	// Evicted from the cache, but still remembered.
+	CHECK(anon.Anonymize(htonl(1)) == first);
+	CHECK(anon.Anonymize(htonl(2)) != first);
+	}
+
 } // namespace zeek::detail
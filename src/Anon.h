@@ -12,8 +12,14 @@
 
 #include <vector>
 #include <map>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
 #include <cstdint>
 
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
 namespace zeek::detail {
 
 // TODO: Anon.h may not be the right place to put these functions ...
@@ -31,6 +37,7 @@ enum ip_addr_anonymization_method_t {
 	RANDOM_MD5,
 	PREFIX_PRESERVING_A50,
 	PREFIX_PRESERVING_MD5,
+	PREFIX_PRESERVING_CRYPTOPAN,
 	NUM_ADDR_ANONYMIZATION_METHODS,
 };
 
@@ -51,8 +58,16 @@ public:
 
 	bool PreserveNet(ipaddr32_t input);
 
+	// The number of mappings Anonymize() remembers. Beyond that, it
+	// forgets the least recently used ones, so anonymize() must return
+	// the same output for an input each time.
+	static constexpr size_t CACHE_SIZE = 65536;
+
 protected:
-	std::map<ipaddr32_t, ipaddr32_t> mapping;
+	using CacheList = std::list<std::pair<ipaddr32_t, ipaddr32_t>>;
+
+	CacheList cache;	// Most recently used first.
+	std::unordered_map<ipaddr32_t, CacheList::iterator> cache_index;
 };
 
 class AnonymizeIPAddr_Seq : public AnonymizeIPAddr {
@@ -62,6 +77,7 @@ public:
 
 protected:
 	ipaddr32_t seq;
+	std::map<ipaddr32_t, ipaddr32_t> mapping;
 };
 
 class AnonymizeIPAddr_RandomMD5 : public AnonymizeIPAddr {
@@ -80,6 +96,31 @@ protected:
 	} prefix;
 };
 
+// Crypto-PAn, from "Prefix-Preserving IP Address Anonymization:
+// Measurement-based Security Evaluation and a New Cryptography-based
+// Scheme", by Xu et al (ICNP 2002). Like AnonymizeIPAddr_PrefixMD5, but
+// using AES, which OpenSSL runs in hardware where available, and
+// encrypting the blocks for all 32 bits of an address in one go.
+class AnonymizeIPAddr_CryptoPAn : public AnonymizeIPAddr {
+public:
+	// Uses a key derived from the process' HMAC key.
+	AnonymizeIPAddr_CryptoPAn();
+
+	// Uses the given key, the first 16 bytes of which are the AES key
+	// while the last 16 determine the pad.
+	explicit AnonymizeIPAddr_CryptoPAn(const uint8_t key[32]);
+
+	~AnonymizeIPAddr_CryptoPAn() override;
+
+	ipaddr32_t anonymize(ipaddr32_t addr) override;
+
+protected:
+	void init(const uint8_t key[32]);
+
+	EVP_CIPHER_CTX* ctx = nullptr;
+	uint8_t pad[16];
+};
+
 class AnonymizeIPAddr_A50 : public AnonymizeIPAddr {
 public:
 	AnonymizeIPAddr_A50()	{ init(); }
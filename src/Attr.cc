@@ -7,6 +7,8 @@
 #include "Desc.h"
 #include "Val.h"
 #include "IntrusivePtr.h"
+#include "OrderedIndex.h"
+#include "CompactSet.h"
 #include "input/Manager.h"
 #include "threading/SerialTypes.h"
 
@@ -22,6 +24,7 @@ const char* attr_name(AttrTag t)
 		"&group", "&log", "&error_handler", "&type_column",
 		"(&tracked)", "&on_change", "&broker_store",
 		"&broker_allow_complex_type", "&backend", "&deprecated",
+		"&ordered_index", "&persistent", "&compact",
 	};
 
 	return attr_names[int(t)];
@@ -740,6 +743,49 @@ void Attributes::CheckAttr(Attr* a)
 		break;
 		}
 
+	case ATTR_ORDERED_INDEX:
+		{
+		if ( type->Tag() != TYPE_TABLE )
+			{
+			Error("&ordered_index only applicable to sets/tables");
+			break;
+			}
+
+		for ( const auto& t : type->AsTableType()->GetIndexTypes() )
+			{
+			if ( ! OrderedIndex::IsOrderable(t.get()) )
+				{
+				Error("&ordered_index requires index types of numbers, addresses, subnets or strings");
+				break;
+				}
+			}
+		}
+		break;
+
+	case ATTR_PERSISTENT:
+		if ( ! global_var )
+			Error("&persistent only applicable to global variables");
+
+		else if ( type->Tag() == TYPE_FUNC || type->Tag() == TYPE_FILE ||
+		          type->Tag() == TYPE_OPAQUE || type->Tag() == TYPE_ANY )
+			Error("&persistent not applicable to functions, files, opaques or any");
+
+		break;
+
+	case ATTR_COMPACT:
+		if ( type->Tag() != TYPE_TABLE || ! CompactSet::IsCompactable(type->AsTableType()) )
+			Error("&compact only applicable to sets of addr or string");
+
+		else if ( Find(ATTR_EXPIRE_READ) || Find(ATTR_EXPIRE_WRITE) ||
+		          Find(ATTR_EXPIRE_CREATE) || Find(ATTR_EXPIRE_FUNC) )
+			Error("&compact cannot be used with expiration");
+
+		else if ( Find(ATTR_ON_CHANGE) || Find(ATTR_ORDERED_INDEX) ||
+		          Find(ATTR_BROKER_STORE) || Find(ATTR_BACKEND) )
+			Error("&compact cannot be used with &on_change, &ordered_index, &broker_store or &backend");
+
+		break;
+
 	case ATTR_BROKER_STORE_ALLOW_COMPLEX:
 		{
 		if ( type->Tag() != TYPE_TABLE )
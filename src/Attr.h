@@ -46,6 +46,9 @@ enum AttrTag {
 	ATTR_BROKER_STORE_ALLOW_COMPLEX, // for Broker store backed tables
 	ATTR_BACKEND, // for Broker store backed tables
 	ATTR_DEPRECATED,
+	ATTR_ORDERED_INDEX, // for prefix and range lookups in tables
+	ATTR_PERSISTENT, // for globals kept in state snapshots
+	ATTR_COMPACT, // for sets kept in compact storage
 	NUM_ATTRS // this item should always be last
 };
 
@@ -6,6 +6,10 @@
 
 #include <math.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace zeek::detail {
 
 int Base64Converter::default_base64_table[256];
@@ -34,7 +38,23 @@ void Base64Converter::Encode(int len, const unsigned char* data, int* pblen, cha
 		*pblen = blen;
 		}
 
-	for ( int i = 0, j = 0; (i < len) && ( j < blen ); )
+	int i = 0;
+	int j = 0;
+	const char* a = alphabet.data();
+
+	// Complete groups first, without checking for the end of the input
+	// byte by byte. The loop below takes care of the final one.
+	for ( ; i + 3 <= len && j + 4 <= blen; i += 3 )
+		{
+		uint32_t bit32 = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+
+		buf[j++] = a[(bit32 >> 18) & 0x3f];
+		buf[j++] = a[(bit32 >> 12) & 0x3f];
+		buf[j++] = a[(bit32 >> 6) & 0x3f];
+		buf[j++] = a[bit32 & 0x3f];
+		}
+
+	while ( (i < len) && ( j < blen ) )
 		{
 			uint32_t bit32 = data[i++]  << 16;
 			bit32 += (i++ < len ? data[i-1] : 0) << 8;
@@ -113,6 +133,95 @@ Base64Converter::~Base64Converter()
 		delete [] base64_table;
 	}
 
+int Base64Converter::DecodeGroups(int len, const char* data, char*& buf, const char* buf_end)
+	{
+	int i = 0;
+
+#if defined(__SSE2__)
+	// With the default alphabet, 16 characters at a time get validated
+	// and translated by their ranges.
+	if ( base64_table == default_base64_table )
+		{
+		const __m128i upper_lo = _mm_set1_epi8('A' - 1);
+		const __m128i upper_hi = _mm_set1_epi8('Z' + 1);
+		const __m128i lower_lo = _mm_set1_epi8('a' - 1);
+		const __m128i lower_hi = _mm_set1_epi8('z' + 1);
+		const __m128i digit_lo = _mm_set1_epi8('0' - 1);
+		const __m128i digit_hi = _mm_set1_epi8('9' + 1);
+
+		for ( ; i + 16 <= len && buf + 12 <= buf_end; i += 16 )
+			{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+			// Bytes above 127 compare as negative and match none of
+			// the ranges.
+			__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, upper_lo), _mm_cmpgt_epi8(upper_hi, v));
+			__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, lower_lo), _mm_cmpgt_epi8(lower_hi, v));
+			__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, digit_lo), _mm_cmpgt_epi8(digit_hi, v));
+			__m128i plus = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+			__m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+
+			__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+			                             _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+
+			if ( _mm_movemask_epi8(valid) != 0xffff )
+				break;
+
+			__m128i sixbits = _mm_or_si128(
+				_mm_or_si128(_mm_and_si128(upper, _mm_sub_epi8(v, _mm_set1_epi8('A'))),
+				             _mm_and_si128(lower, _mm_sub_epi8(v, _mm_set1_epi8('a' - 26)))),
+				_mm_or_si128(_mm_and_si128(digit, _mm_add_epi8(v, _mm_set1_epi8(52 - '0'))),
+				             _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62)),
+				                          _mm_and_si128(slash, _mm_set1_epi8(63)))));
+
+			// Merge each group's four 6-bit values into the low 24
+			// bits of its 32-bit lane: first pairs, then the pairs.
+			__m128i pairs = _mm_or_si128(
+				_mm_slli_epi16(_mm_and_si128(sixbits, _mm_set1_epi16(0x00ff)), 6),
+				_mm_srli_epi16(sixbits, 8));
+			__m128i groups = _mm_or_si128(
+				_mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0x0000ffff)), 12),
+				_mm_srli_epi32(pairs, 16));
+
+			uint32_t lanes[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), groups);
+
+			for ( auto bit32 : lanes )
+				{
+				*buf++ = char((bit32 >> 16) & 0xff);
+				*buf++ = char((bit32 >> 8) & 0xff);
+				*buf++ = char(bit32 & 0xff);
+				}
+			}
+		}
+#endif
+
+	for ( ; i + 4 <= len && buf + 3 <= buf_end; i += 4 )
+		{
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(data + i);
+
+		// The table maps the padding character to zero, so that one
+		// needs to go through the regular path as well.
+		if ( p[0] == '=' || p[1] == '=' || p[2] == '=' || p[3] == '=' )
+			break;
+
+		int a = base64_table[p[0]];
+		int b = base64_table[p[1]];
+		int c = base64_table[p[2]];
+		int d = base64_table[p[3]];
+
+		if ( (a | b | c | d) < 0 )
+			break;
+
+		uint32_t bit32 = (a << 18) | (b << 12) | (c << 6) | d;
+		*buf++ = char((bit32 >> 16) & 0xff);
+		*buf++ = char((bit32 >> 8) & 0xff);
+		*buf++ = char(bit32 & 0xff);
+		}
+
+	return i;
+	}
+
 int Base64Converter::Decode(int len, const char* data, int* pblen, char** pbuf)
 	{
 	int blen;
@@ -184,6 +293,17 @@ int Base64Converter::Decode(int len, const char* data, int* pblen, char** pbuf)
 		if ( dlen >= len )
 			break;
 
+		if ( base64_group_next == 0 && ! base64_after_padding )
+			{
+			int n = DecodeGroups(len - dlen, data + dlen, buf, *pbuf + blen);
+
+			if ( n > 0 )
+				{
+				dlen += n;
+				continue;
+				}
+			}
+
 		if ( data[dlen] == '=' )
 			++base64_padding;
 
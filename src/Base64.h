@@ -3,7 +3,7 @@
 #include "zeek-config.h"
 #include <string>
 
-namespace zeek { class String; }
+namespace zeek { class String; class Base64DecoderVal; }
 using BroString [[deprecated("Remove in v4.1. Use zeek::String instead.")]] = zeek::String;
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Connection, zeek);
@@ -44,6 +44,8 @@ public:
 	void IllegalEncoding(const char* msg);
 
 protected:
+	friend class zeek::Base64DecoderVal;
+
 	char error_msg[256];
 
 protected:
@@ -51,6 +53,12 @@ protected:
 	std::string alphabet;
 
 	static int* InitBase64Table(const std::string& alphabet);
+
+	// Decodes the complete groups of valid characters at the start of
+	// the input, as far as the output buffer has room, and returns the
+	// number of input bytes consumed. Only for use while no group is
+	// pending.
+	int DecodeGroups(int len, const char* data, char*& buf, const char* buf_end);
 	static int default_base64_table[256];
 	char base64_group[4];
 	int base64_group_next;
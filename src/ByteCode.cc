@@ -0,0 +1,1016 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ByteCode.h"
+
+#include <unordered_set>
+
+#include "Attr.h"
+#include "Debug.h"
+#include "DebugLogger.h"
+#include "Expr.h"
+#include "Frame.h"
+#include "ScriptProfiler.h"
+#include "Func.h"
+#include "ID.h"
+#include "NetVar.h"
+#include "Reporter.h"
+#include "Scope.h"
+#include "Stmt.h"
+#include "Val.h"
+
+namespace zeek::detail {
+
+namespace {
+
+// How a register holds a value. The first four are unboxed.
+enum Kind { K_INT, K_UINT, K_DOUBLE, K_BOOL, K_VAL };
+
+Kind kind_of(const Type* t)
+	{
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+		return K_BOOL;
+
+	case TYPE_INT:
+		return K_INT;
+
+	case TYPE_COUNT:
+		return K_UINT;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		return K_DOUBLE;
+
+	default:
+		return K_VAL;
+	}
+	}
+
+bool is_unboxed(Kind k)
+	{
+	return k != K_VAL;
+	}
+
+} // namespace
+
+class ByteCodeCompiler {
+public:
+	explicit ByteCodeCompiler(ByteCode* arg_bc) : bc(arg_bc), code(arg_bc->code)
+		{ }
+
+	void LowerStmt(const Stmt* s);
+
+	// Resolves the jump labels. Returns true if anything got lowered.
+	bool Finish();
+
+private:
+	using Op = ByteCode::Op;
+	using Instr = ByteCode::Instr;
+
+	struct Operand {
+		int reg;
+		Kind kind;
+	};
+
+	int NewLabel()
+		{
+		labels.push_back(-1);
+		return labels.size() - 1;
+		}
+
+	void SetLabel(int l)	{ labels[l] = code.size(); }
+
+	Instr& Emit(Op op)
+		{
+		code.emplace_back();
+		code.back().op = op;
+		return code.back();
+		}
+
+	Instr& Emit(Op op, int r1, int r2 = 0, int r3 = 0)
+		{
+		auto& i = Emit(op);
+		i.r1 = r1;
+		i.r2 = r2;
+		i.r3 = r3;
+		return i;
+		}
+
+	int NewReg()
+		{
+		if ( next_reg >= ByteCode::MAX_REGS )
+			{
+			out_of_regs = true;
+			return 0;
+			}
+
+		if ( next_reg >= bc->num_regs )
+			bc->num_regs = next_reg + 1;
+
+		return next_reg++;
+		}
+
+	void Access(const Stmt* s)	{ Emit(ByteCode::OP_ACCESS).s = s; }
+
+	// Runs a statement through the AST.
+	void Fallback(const Stmt* s);
+
+	// Returns true if an expression's value can be computed by
+	// instructions of its own rather than through a fallback.
+	bool Lowerable(const Expr* e) const;
+
+	// Lowers an expression, jumping to the abort label if it (or part
+	// of it) yields no value.
+	Operand LowerExpr(const Expr* e, int abort);
+	Operand LowerArith(const BinaryExpr* e, int abort);
+	Operand LowerCompare(const BinaryExpr* e, int abort);
+	Operand LowerLogical(const BinaryExpr* e, int abort);
+	Operand LowerCond(const CondExpr* e, int abort);
+	Operand LowerCoerce(const Expr* e, int abort);
+	Operand EvalExpr(const Expr* e, int abort);
+
+	// Lowers an expression into the given representation.
+	Operand LowerAs(const Expr* e, Kind want, int abort)
+		{ return Convert(LowerExpr(e, abort), want, e->GetType().get()); }
+
+	// Moves an operand into the given representation.
+	Operand Convert(Operand o, Kind want, const Type* t);
+
+	ByteCode* bc;
+	std::vector<Instr>& code;
+	std::vector<int> labels;
+
+	int next_reg = 0;
+	bool out_of_regs = false;
+	size_t num_lowered = 0;
+
+	// Where break and next go inside lowered loops, or -1.
+	int break_label = -1;
+	int next_label = -1;
+};
+
+void ByteCodeCompiler::Fallback(const Stmt* s)
+	{
+	auto& i = Emit(ByteCode::OP_EXEC);
+	i.s = s;
+	i.target = break_label;
+	i.n = next_label;
+	++bc->num_fallbacks;
+	}
+
+void ByteCodeCompiler::LowerStmt(const Stmt* s)
+	{
+	// If we run out of registers, the whole statement goes through
+	// the AST instead.
+	size_t mark = code.size();
+	size_t fallbacks_mark = bc->num_fallbacks;
+	size_t lowered_mark = num_lowered;
+
+	next_reg = 0;
+	out_of_regs = false;
+
+	switch ( s->Tag() ) {
+	case STMT_LIST:
+		Access(s);
+
+		for ( const auto& stmt : s->AsStmtList()->Stmts() )
+			LowerStmt(stmt);
+
+		next_reg = 0;
+		break;
+
+	case STMT_EXPR:
+		{
+		auto e = static_cast<const ExprStmt*>(s)->StmtExpr();
+
+		if ( ! Lowerable(e) )
+			{
+			Fallback(s);
+			return;
+			}
+
+		Access(s);
+		int end = NewLabel();
+		LowerExpr(e, end);
+		SetLabel(end);
+		}
+		break;
+
+	case STMT_IF:
+		{
+		auto is = static_cast<const IfStmt*>(s);
+		auto cond = is->StmtExpr();
+
+		if ( ! Lowerable(cond) )
+			{
+			Fallback(s);
+			return;
+			}
+
+		Access(s);
+		int end = NewLabel();
+		int else_label = NewLabel();
+
+		auto c = LowerAs(cond, K_BOOL, end);
+		Emit(ByteCode::OP_JMP_FALSE, c.reg).target = else_label;
+
+		if ( out_of_regs )
+			break;
+
+		LowerStmt(is->TrueBranch());
+		Emit(ByteCode::OP_JMP).target = end;
+		SetLabel(else_label);
+		LowerStmt(is->FalseBranch());
+		SetLabel(end);
+		}
+		break;
+
+	case STMT_WHILE:
+		{
+		auto ws = static_cast<const WhileStmt*>(s);
+		auto cond = ws->Condition();
+
+		Access(s);
+		int top = NewLabel();
+		int exit = NewLabel();
+
+		SetLabel(top);
+		auto c = LowerAs(cond, K_BOOL, exit);
+		Emit(ByteCode::OP_JMP_FALSE, c.reg).target = exit;
+
+		if ( out_of_regs )
+			break;
+
+		int prev_break = break_label;
+		int prev_next = next_label;
+		break_label = exit;
+		next_label = top;
+
+		LowerStmt(ws->Body());
+
+		break_label = prev_break;
+		next_label = prev_next;
+
+		Emit(ByteCode::OP_JMP).target = top;
+		SetLabel(exit);
+		}
+		break;
+
+	case STMT_RETURN:
+		{
+		auto e = static_cast<const ReturnStmt*>(s)->StmtExpr();
+
+		Access(s);
+
+		if ( e )
+			{
+			int abort = NewLabel();
+			auto r = LowerAs(e, K_VAL, abort);
+			Emit(ByteCode::OP_RETURN, r.reg);
+			SetLabel(abort);
+			}
+
+		Emit(ByteCode::OP_RETURN_VOID);
+		}
+		break;
+
+	case STMT_NEXT:
+	case STMT_BREAK:
+		{
+		Access(s);
+		int label = s->Tag() == STMT_NEXT ? next_label : break_label;
+
+		if ( label >= 0 )
+			Emit(ByteCode::OP_JMP).target = label;
+		else
+			Emit(ByteCode::OP_FLOW).n =
+				s->Tag() == STMT_NEXT ? FLOW_LOOP : FLOW_BREAK;
+		}
+		break;
+
+	case STMT_NULL:
+		Access(s);
+		break;
+
+	default:
+		Fallback(s);
+		return;
+	}
+
+	if ( out_of_regs )
+		{
+		code.resize(mark);
+		bc->num_fallbacks = fallbacks_mark;
+		num_lowered = lowered_mark;
+		out_of_regs = false;
+		Fallback(s);
+		return;
+		}
+
+	++num_lowered;
+	}
+
+bool ByteCodeCompiler::Lowerable(const Expr* e) const
+	{
+	switch ( e->Tag() ) {
+	case EXPR_CONST:
+	case EXPR_FIELD:
+	case EXPR_HAS_FIELD:
+		return true;
+
+	case EXPR_NAME:
+		return ! static_cast<const NameExpr*>(e)->Id()->IsType();
+
+	case EXPR_ASSIGN:
+		{
+		auto a = static_cast<const AssignExpr*>(e);
+		auto lhs = a->Op1();
+		return ! a->IsInit() && ! a->GetVal() && lhs->Tag() == EXPR_NAME &&
+		       ! static_cast<const NameExpr*>(lhs)->Id()->IsType();
+		}
+
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_DIVIDE:
+	case EXPR_MOD:
+		{
+		auto b = static_cast<const BinaryExpr*>(e);
+		Kind k = kind_of(e->GetType().get());
+
+		if ( k == K_VAL || k == K_BOOL )
+			return false;
+
+		if ( kind_of(b->Op1()->GetType().get()) != k ||
+		     kind_of(b->Op2()->GetType().get()) != k )
+			return false;
+
+		return e->Tag() != EXPR_MOD || k != K_DOUBLE;
+		}
+
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+		{
+		auto b = static_cast<const BinaryExpr*>(e);
+		Kind k = kind_of(b->Op1()->GetType().get());
+
+		return is_unboxed(k) && kind_of(b->Op2()->GetType().get()) == k &&
+		       (k != K_BOOL || e->Tag() == EXPR_EQ || e->Tag() == EXPR_NE);
+		}
+
+	case EXPR_AND_AND:
+	case EXPR_OR_OR:
+		{
+		auto b = static_cast<const BinaryExpr*>(e);
+		return kind_of(b->Op1()->GetType().get()) == K_BOOL &&
+		       kind_of(b->Op2()->GetType().get()) == K_BOOL;
+		}
+
+	case EXPR_NOT:
+		return kind_of(static_cast<const UnaryExpr*>(e)->Op()->GetType().get()) == K_BOOL;
+
+	case EXPR_NEGATE:
+		{
+		Kind k = kind_of(static_cast<const UnaryExpr*>(e)->Op()->GetType().get());
+		Kind result = kind_of(e->GetType().get());
+		return (k == K_DOUBLE && result == K_DOUBLE) ||
+		       ((k == K_INT || k == K_UINT) && result == K_INT);
+		}
+
+	case EXPR_ARITH_COERCE:
+		{
+		Kind from = kind_of(static_cast<const UnaryExpr*>(e)->Op()->GetType().get());
+		Kind to = kind_of(e->GetType().get());
+		return is_unboxed(from) && from != K_BOOL && is_unboxed(to) && to != K_BOOL;
+		}
+
+	case EXPR_COND:
+		return kind_of(static_cast<const CondExpr*>(e)->Op1()->GetType().get()) == K_BOOL;
+
+	default:
+		return false;
+	}
+	}
+
+ByteCodeCompiler::Operand ByteCodeCompiler::EvalExpr(const Expr* e, int abort)
+	{
+	auto& i = Emit(ByteCode::OP_EVAL, NewReg());
+	i.e = e;
+	i.target = abort;
+	++bc->num_fallbacks;
+	return {i.r1, K_VAL};
+	}
+
+ByteCodeCompiler::Operand ByteCodeCompiler::LowerExpr(const Expr* e, int abort)
+	{
+	if ( ! Lowerable(e) )
+		return EvalExpr(e, abort);
+
+	Kind k = kind_of(e->GetType().get());
+
+	switch ( e->Tag() ) {
+	case EXPR_CONST:
+		{
+		auto v = static_cast<const ConstExpr*>(e)->Value();
+		int r = NewReg();
+
+		switch ( k ) {
+		case K_INT:	Emit(ByteCode::OP_CONST_I, r).c.i = v->InternalInt(); break;
+		case K_BOOL:	Emit(ByteCode::OP_CONST_I, r).c.i = v->AsBool(); break;
+		case K_UINT:	Emit(ByteCode::OP_CONST_U, r).c.u = v->InternalUnsigned(); break;
+		case K_DOUBLE:	Emit(ByteCode::OP_CONST_D, r).c.d = v->InternalDouble(); break;
+		case K_VAL:	Emit(ByteCode::OP_CONST_V, r).v = v; break;
+		}
+
+		return {r, k};
+		}
+
+	case EXPR_NAME:
+		{
+		auto id = static_cast<const NameExpr*>(e)->Id();
+		bool global = id->IsGlobal();
+		Op op;
+
+		switch ( k ) {
+		case K_INT:
+		case K_BOOL:
+			op = global ? ByteCode::OP_GLOBAL_I : ByteCode::OP_LOCAL_I;
+			break;
+		case K_UINT:
+			op = global ? ByteCode::OP_GLOBAL_U : ByteCode::OP_LOCAL_U;
+			break;
+		case K_DOUBLE:
+			op = global ? ByteCode::OP_GLOBAL_D : ByteCode::OP_LOCAL_D;
+			break;
+		default:
+			op = global ? ByteCode::OP_GLOBAL_V : ByteCode::OP_LOCAL_V;
+			break;
+		}
+
+		auto& i = Emit(op, NewReg());
+		i.id = {NewRef{}, id};
+		i.e = e;
+		return {i.r1, k};
+		}
+
+	case EXPR_ASSIGN:
+		{
+		auto a = static_cast<const AssignExpr*>(e);
+		auto id = static_cast<const NameExpr*>(a->Op1())->Id();
+		auto rhs = a->Op2();
+		auto r = LowerExpr(rhs, abort);
+		auto boxed = Convert(r, K_VAL, rhs->GetType().get());
+
+		Emit(id->IsGlobal() ? ByteCode::OP_STORE_GLOBAL : ByteCode::OP_STORE_LOCAL,
+		     boxed.reg).id = {NewRef{}, id};
+
+		// Keep the unboxed value around for whoever uses ours.
+		return r.kind == k ? r : boxed;
+		}
+
+	case EXPR_FIELD:
+		{
+		auto fe = static_cast<const FieldExpr*>(e);
+		auto rt = fe->Op()->GetType();
+
+		if ( fe->Field() < 0 || rt->Tag() != TYPE_RECORD )
+			return EvalExpr(e, abort);
+
+		auto rec = LowerAs(fe->Op(), K_VAL, abort);
+		const auto& def = rt->AsRecordType()->FieldDecl(fe->Field())->GetAttr(ATTR_DEFAULT);
+
+		// Atomic fields are stored unboxed, so we can load them
+		// directly into the kind of register we want.
+		ByteCode::Op op = ByteCode::OP_FIELD;
+
+		if ( k == K_INT || k == K_BOOL )
+			op = ByteCode::OP_FIELD_I;
+		else if ( k == K_UINT )
+			op = ByteCode::OP_FIELD_U;
+		else if ( k == K_DOUBLE )
+			op = ByteCode::OP_FIELD_D;
+
+		auto& i = Emit(op, NewReg(), rec.reg);
+		i.n = fe->Field();
+		i.e = e;
+		i.e2 = def ? def->GetExpr().get() : nullptr;
+
+		return {i.r1, k};
+		}
+
+	case EXPR_HAS_FIELD:
+		{
+		auto he = static_cast<const HasFieldExpr*>(e);
+		auto rt = he->Op()->GetType();
+
+		if ( he->Field() < 0 || rt->Tag() != TYPE_RECORD )
+			return EvalExpr(e, abort);
+
+		auto rec = LowerAs(he->Op(), K_VAL, abort);
+		auto& i = Emit(ByteCode::OP_HAS_FIELD, NewReg(), rec.reg);
+		i.n = he->Field();
+		return {i.r1, K_BOOL};
+		}
+
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_DIVIDE:
+	case EXPR_MOD:
+		return LowerArith(static_cast<const BinaryExpr*>(e), abort);
+
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+		return LowerCompare(static_cast<const BinaryExpr*>(e), abort);
+
+	case EXPR_AND_AND:
+	case EXPR_OR_OR:
+		return LowerLogical(static_cast<const BinaryExpr*>(e), abort);
+
+	case EXPR_NOT:
+		{
+		auto o = LowerAs(static_cast<const UnaryExpr*>(e)->Op(), K_BOOL, abort);
+		auto& i = Emit(ByteCode::OP_NOT, NewReg(), o.reg);
+		return {i.r1, K_BOOL};
+		}
+
+	case EXPR_NEGATE:
+		{
+		auto op = static_cast<const UnaryExpr*>(e)->Op();
+		auto o = LowerAs(op, kind_of(op->GetType().get()), abort);
+
+		if ( o.kind == K_DOUBLE )
+			{
+			auto& i = Emit(ByteCode::OP_NEG_D, NewReg(), o.reg);
+			return {i.r1, K_DOUBLE};
+			}
+
+		if ( o.kind == K_UINT )
+			{
+			auto& c = Emit(ByteCode::OP_U2I, NewReg(), o.reg);
+			o = {c.r1, K_INT};
+			}
+
+		auto& i = Emit(ByteCode::OP_NEG_I, NewReg(), o.reg);
+		return {i.r1, K_INT};
+		}
+
+	case EXPR_ARITH_COERCE:
+		return LowerCoerce(e, abort);
+
+	case EXPR_COND:
+		return LowerCond(static_cast<const CondExpr*>(e), abort);
+
+	default:
+		return EvalExpr(e, abort);
+	}
+	}
+
+ByteCodeCompiler::Operand ByteCodeCompiler::LowerArith(const BinaryExpr* e, int abort)
+	{
+	Kind k = kind_of(e->GetType().get());
+	auto o1 = LowerAs(e->Op1(), k, abort);
+	auto o2 = LowerAs(e->Op2(), k, abort);
+
+	// Offsets of the I/U/D variants from the first of them.
+	int variant = k == K_INT ? 0 : (k == K_UINT ? 1 : 2);
+	int base;
+
+	switch ( e->Tag() ) {
+	case EXPR_ADD:		base = ByteCode::OP_ADD_I; break;
+	case EXPR_SUB:		base = ByteCode::OP_SUB_I; break;
+	case EXPR_TIMES:	base = ByteCode::OP_MUL_I; break;
+	case EXPR_DIVIDE:	base = ByteCode::OP_DIV_I; break;
+	default:		base = ByteCode::OP_MOD_I; break;
+	}
+
+	auto& i = Emit(static_cast<Op>(base + variant), NewReg(), o1.reg, o2.reg);
+	i.e = e;
+	return {i.r1, k};
+	}
+
+ByteCodeCompiler::Operand ByteCodeCompiler::LowerCompare(const BinaryExpr* e, int abort)
+	{
+	Kind k = kind_of(e->Op1()->GetType().get());
+	auto o1 = LowerAs(e->Op1(), k, abort);
+	auto o2 = LowerAs(e->Op2(), k, abort);
+
+	// Bools compare like ints.
+	int variant = (k == K_INT || k == K_BOOL) ? 0 : (k == K_UINT ? 1 : 2);
+	int base;
+	bool swap = false;
+
+	switch ( e->Tag() ) {
+	case EXPR_LT:	base = ByteCode::OP_LT_I; break;
+	case EXPR_LE:	base = ByteCode::OP_LE_I; break;
+	case EXPR_EQ:	base = ByteCode::OP_EQ_I; break;
+	case EXPR_NE:	base = ByteCode::OP_NE_I; break;
+	case EXPR_GT:	base = ByteCode::OP_LT_I; swap = true; break;
+	default:	base = ByteCode::OP_LE_I; swap = true; break;
+	}
+
+	if ( swap )
+		std::swap(o1, o2);
+
+	auto& i = Emit(static_cast<Op>(base + variant), NewReg(), o1.reg, o2.reg);
+	return {i.r1, K_BOOL};
+	}
+
+ByteCodeCompiler::Operand ByteCodeCompiler::LowerLogical(const BinaryExpr* e, int abort)
+	{
+	int r = NewReg();
+	int end = NewLabel();
+
+	auto o1 = LowerAs(e->Op1(), K_BOOL, abort);
+	Emit(ByteCode::OP_MOVE, r, o1.reg);
+	Emit(e->Tag() == EXPR_AND_AND ? ByteCode::OP_JMP_FALSE : ByteCode::OP_JMP_TRUE,
+	     r).target = end;
+
+	auto o2 = LowerAs(e->Op2(), K_BOOL, abort);
+	Emit(ByteCode::OP_MOVE, r, o2.reg);
+	SetLabel(end);
+
+	return {r, K_BOOL};
+	}
+
+ByteCodeCompiler::Operand ByteCodeCompiler::LowerCond(const CondExpr* e, int abort)
+	{
+	Kind k = kind_of(e->GetType().get());
+	int r = NewReg();
+	int end = NewLabel();
+	int else_label = NewLabel();
+
+	auto c = LowerAs(e->Op1(), K_BOOL, abort);
+	Emit(ByteCode::OP_JMP_FALSE, c.reg).target = else_label;
+
+	auto o2 = LowerAs(e->Op2(), k, abort);
+	Emit(ByteCode::OP_MOVE, r, o2.reg);
+	Emit(ByteCode::OP_JMP).target = end;
+
+	SetLabel(else_label);
+	auto o3 = LowerAs(e->Op3(), k, abort);
+	Emit(ByteCode::OP_MOVE, r, o3.reg);
+	SetLabel(end);
+
+	return {r, k};
+	}
+
+ByteCodeCompiler::Operand ByteCodeCompiler::LowerCoerce(const Expr* e, int abort)
+	{
+	auto operand = static_cast<const UnaryExpr*>(e)->Op();
+	auto o = LowerAs(operand, kind_of(operand->GetType().get()), abort);
+	Kind to = kind_of(e->GetType().get());
+
+	if ( o.kind == to )
+		return o;
+
+	Op op;
+
+	switch ( o.kind ) {
+	case K_INT:	op = to == K_UINT ? ByteCode::OP_I2U : ByteCode::OP_I2D; break;
+	case K_UINT:	op = to == K_INT ? ByteCode::OP_U2I : ByteCode::OP_U2D; break;
+	default:	op = to == K_INT ? ByteCode::OP_D2I : ByteCode::OP_D2U; break;
+	}
+
+	auto& i = Emit(op, NewReg(), o.reg);
+	return {i.r1, to};
+	}
+
+ByteCodeCompiler::Operand ByteCodeCompiler::Convert(Operand o, Kind want, const Type* t)
+	{
+	if ( o.kind == want )
+		return o;
+
+	if ( want == K_VAL )
+		{
+		auto& i = Emit(ByteCode::OP_BOX, NewReg(), o.reg);
+		i.n = t->Tag();
+		return {i.r1, K_VAL};
+		}
+
+	// Types match where we convert, so we only ever unbox.
+	assert(o.kind == K_VAL);
+
+	Op op;
+
+	switch ( want ) {
+	case K_INT:	op = ByteCode::OP_UNBOX_I; break;
+	case K_UINT:	op = ByteCode::OP_UNBOX_U; break;
+	case K_DOUBLE:	op = ByteCode::OP_UNBOX_D; break;
+	default:	op = ByteCode::OP_UNBOX_B; break;
+	}
+
+	auto& i = Emit(op, NewReg(), o.reg);
+	return {i.r1, want};
+	}
+
+bool ByteCodeCompiler::Finish()
+	{
+	for ( auto& i : code )
+		{
+		switch ( i.op ) {
+		case ByteCode::OP_JMP:
+		case ByteCode::OP_JMP_FALSE:
+		case ByteCode::OP_JMP_TRUE:
+		case ByteCode::OP_EVAL:
+			i.target = labels[i.target];
+			break;
+
+		case ByteCode::OP_EXEC:
+			if ( i.target >= 0 )
+				i.target = labels[i.target];
+			if ( i.n >= 0 )
+				i.n = labels[i.n];
+			break;
+
+		default:
+			break;
+		}
+		}
+
+	// A lone list around AST fallbacks isn't worth it.
+	return num_lowered > 1 || (num_lowered == 1 && bc->num_fallbacks == 0);
+	}
+
+std::unique_ptr<ByteCode> ByteCode::Compile(const Stmt* body)
+	{
+	auto bc = std::make_unique<ByteCode>();
+	ByteCodeCompiler c(bc.get());
+
+	c.LowerStmt(body);
+
+	if ( ! c.Finish() )
+		return nullptr;
+
+	return bc;
+	}
+
+ValPtr ByteCode::Box(const Reg& r, int tag)
+	{
+	switch ( tag ) {
+	case TYPE_BOOL:		return val_mgr->Bool(r.i);
+	case TYPE_INT:		return val_mgr->Int(r.i);
+	case TYPE_COUNT:	return val_mgr->Count(r.u);
+	case TYPE_TIME:		return make_intrusive<TimeVal>(r.d);
+	case TYPE_INTERVAL:	return make_intrusive<IntervalVal>(r.d);
+	default:		return make_intrusive<DoubleVal>(r.d);
+	}
+	}
+
+ValPtr ByteCode::Exec(Frame* f, StmtFlowType& flow) const
+	{
+	Reg regs[MAX_REGS];
+	const Instr* instrs = code.data();
+	int n = code.size();
+	int pc = 0;
+
+	flow = FLOW_NEXT;
+
+#define UNSET(i) reporter->ExprRuntimeError((i).e, "value used but not set")
+
+	while ( pc < n )
+		{
+		const Instr& i = instrs[pc++];
+		Reg& r1 = regs[i.r1];
+		const Reg& r2 = regs[i.r2];
+		const Reg& r3 = regs[i.r3];
+
+		switch ( i.op ) {
+		case OP_ACCESS:
+			// A sample that's due belongs to the previous statement.
+			if ( ScriptProfiler::SampleDue() )
+				script_profiler.Sample();
+
+			f->SetNextStmt(const_cast<Stmt*>(i.s));
+			i.s->RegisterAccess();
+			break;
+
+		case OP_CONST_I:	r1.i = i.c.i; break;
+		case OP_CONST_U:	r1.u = i.c.u; break;
+		case OP_CONST_D:	r1.d = i.c.d; break;
+		case OP_CONST_V:	r1.v = {NewRef{}, i.v}; break;
+
+#define LOAD(opname, src, assign) \
+		case opname: \
+			{ \
+			const auto& v = src; \
+			if ( ! v ) \
+				UNSET(i); \
+			assign; \
+			} \
+			break;
+
+		LOAD(OP_LOCAL_I, f->GetElementByID(i.id), r1.i = v->InternalInt())
+		LOAD(OP_LOCAL_U, f->GetElementByID(i.id), r1.u = v->InternalUnsigned())
+		LOAD(OP_LOCAL_D, f->GetElementByID(i.id), r1.d = v->InternalDouble())
+		LOAD(OP_LOCAL_V, f->GetElementByID(i.id), r1.v = v)
+		LOAD(OP_GLOBAL_I, i.id->GetVal(), r1.i = v->InternalInt())
+		LOAD(OP_GLOBAL_U, i.id->GetVal(), r1.u = v->InternalUnsigned())
+		LOAD(OP_GLOBAL_D, i.id->GetVal(), r1.d = v->InternalDouble())
+		LOAD(OP_GLOBAL_V, i.id->GetVal(), r1.v = v)
+
+		case OP_FIELD:
+			{
+			if ( const auto& v = r2.v->AsRecordVal()->GetField(i.n) )
+				r1.v = v;
+			else if ( i.e2 )
+				r1.v = i.e2->Eval(nullptr);
+			else
+				reporter->ExprRuntimeError(i.e, "field value missing");
+			}
+			break;
+
+#define FIELD(opname, field, accessor, internal) \
+		case opname: \
+			{ \
+			auto rv = r2.v->AsRecordVal(); \
+			if ( rv->HasField(i.n) ) \
+				r1.field = rv->accessor(i.n); \
+			else if ( i.e2 ) \
+				r1.field = i.e2->Eval(nullptr)->internal(); \
+			else \
+				reporter->ExprRuntimeError(i.e, "field value missing"); \
+			} \
+			break;
+
+		FIELD(OP_FIELD_I, i, GetFieldInt, InternalInt)
+		FIELD(OP_FIELD_U, u, GetFieldCount, InternalUnsigned)
+		FIELD(OP_FIELD_D, d, GetFieldDouble, InternalDouble)
+
+		case OP_HAS_FIELD:
+			r1.i = r2.v->AsRecordVal()->HasField(i.n);
+			break;
+
+		case OP_STORE_LOCAL:
+			f->SetElement(i.id, r1.v);
+			break;
+
+		case OP_STORE_GLOBAL:
+			i.id->SetVal(r1.v);
+			break;
+
+		case OP_BOX:		r1.v = Box(r2, i.n); break;
+		case OP_UNBOX_I:	r1.i = r2.v->InternalInt(); break;
+		case OP_UNBOX_U:	r1.u = r2.v->InternalUnsigned(); break;
+		case OP_UNBOX_D:	r1.d = r2.v->InternalDouble(); break;
+		case OP_UNBOX_B:	r1.i = ! r2.v->IsZero(); break;
+
+		case OP_I2U:	r1.u = static_cast<bro_uint_t>(r2.i); break;
+		case OP_I2D:	r1.d = r2.i; break;
+		case OP_U2I:	r1.i = static_cast<bro_int_t>(r2.u); break;
+		case OP_U2D:	r1.d = r2.u; break;
+		case OP_D2I:	r1.i = static_cast<bro_int_t>(r2.d); break;
+		case OP_D2U:	r1.u = static_cast<bro_uint_t>(r2.d); break;
+
+#define ARITH(opname, field, op) \
+		case opname: r1.field = r2.field op r3.field; break;
+
+		ARITH(OP_ADD_I, i, +) ARITH(OP_ADD_U, u, +) ARITH(OP_ADD_D, d, +)
+		ARITH(OP_SUB_I, i, -) ARITH(OP_SUB_U, u, -) ARITH(OP_SUB_D, d, -)
+		ARITH(OP_MUL_I, i, *) ARITH(OP_MUL_U, u, *) ARITH(OP_MUL_D, d, *)
+
+#define CHECKED(opname, field, op, msg) \
+		case opname: \
+			if ( r3.field == 0 ) \
+				reporter->ExprRuntimeError(i.e, msg); \
+			r1.field = r2.field op r3.field; \
+			break;
+
+		CHECKED(OP_DIV_I, i, /, "division by zero")
+		CHECKED(OP_DIV_U, u, /, "division by zero")
+		CHECKED(OP_DIV_D, d, /, "division by zero")
+		CHECKED(OP_MOD_I, i, %, "modulo by zero")
+		CHECKED(OP_MOD_U, u, %, "modulo by zero")
+
+#define COMPARE(opname, field, op) \
+		case opname: r1.i = r2.field op r3.field; break;
+
+		COMPARE(OP_LT_I, i, <) COMPARE(OP_LT_U, u, <) COMPARE(OP_LT_D, d, <)
+		COMPARE(OP_LE_I, i, <=) COMPARE(OP_LE_U, u, <=) COMPARE(OP_LE_D, d, <=)
+		COMPARE(OP_EQ_I, i, ==) COMPARE(OP_EQ_U, u, ==) COMPARE(OP_EQ_D, d, ==)
+		COMPARE(OP_NE_I, i, !=) COMPARE(OP_NE_U, u, !=) COMPARE(OP_NE_D, d, !=)
+
+		case OP_NOT:	r1.i = ! r2.i; break;
+		case OP_NEG_I:	r1.i = - r2.i; break;
+		case OP_NEG_D:	r1.d = - r2.d; break;
+
+		case OP_MOVE:
+			r1.u = r2.u;	// Copies the whole union.
+			r1.v = r2.v;
+			break;
+
+		case OP_JMP:
+			pc = i.target;
+			break;
+
+		case OP_JMP_FALSE:
+			if ( ! r1.i )
+				pc = i.target;
+			break;
+
+		case OP_JMP_TRUE:
+			if ( r1.i )
+				pc = i.target;
+			break;
+
+		case OP_EVAL:
+			r1.v = i.e->Eval(f);
+
+			if ( f->HasDelayed() )
+				return nullptr;
+
+			if ( ! r1.v )
+				pc = i.target;
+			break;
+
+		case OP_EXEC:
+			{
+			f->SetNextStmt(const_cast<Stmt*>(i.s));
+			auto result = i.s->Exec(f, flow);
+
+			if ( ScriptProfiler::SampleDue() )
+				script_profiler.Sample();
+
+			if ( flow == FLOW_RETURN || result || f->HasDelayed() )
+				return result;
+
+			if ( flow == FLOW_BREAK && i.target >= 0 )
+				pc = i.target;
+			else if ( flow == FLOW_LOOP && i.n >= 0 )
+				pc = i.n;
+			else if ( flow != FLOW_NEXT )
+				return nullptr;
+
+			flow = FLOW_NEXT;
+			}
+			break;
+
+		case OP_RETURN:
+			flow = FLOW_RETURN;
+			return std::move(r1.v);
+
+		case OP_RETURN_VOID:
+			flow = FLOW_RETURN;
+			return nullptr;
+
+		case OP_FLOW:
+			flow = static_cast<StmtFlowType>(i.n);
+			return nullptr;
+		}
+		}
+
+#undef UNSET
+#undef LOAD
+#undef ARITH
+#undef CHECKED
+#undef COMPARE
+#undef FIELD
+
+	return nullptr;
+	}
+
+void compile_script_bodies()
+	{
+	// The debugger needs to see every statement go by.
+	if ( ! compile_scripts || g_policy_debug )
+		return;
+
+	std::unordered_set<const Func*> seen;
+	int num_funcs = 0;
+	int num_bodies = 0;
+
+	for ( const auto& [name, id] : global_scope()->Vars() )
+		{
+		if ( ! id->HasVal() || id->GetType()->Tag() != TYPE_FUNC )
+			continue;
+
+		auto func = id->GetVal()->AsFunc();
+
+		if ( func->GetKind() != Func::SCRIPT_FUNC || ! seen.insert(func).second )
+			continue;
+
+		int n = static_cast<ScriptFunc*>(func)->CompileBodies();
+
+		if ( n > 0 )
+			{
+			++num_funcs;
+			num_bodies += n;
+			}
+		}
+
+	DBG_LOG(DBG_SCRIPTS, "compiled %d bodies of %d functions to bytecode",
+	        num_bodies, num_funcs);
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,164 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include "zeek-config.h"
+
+#include <memory>
+#include <vector>
+
+#include "IntrusivePtr.h"
+#include "ID.h"
+#include "StmtEnums.h"
+#include "Type.h"
+
+ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
+ZEEK_FORWARD_DECLARE_NAMESPACED(Frame, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(Stmt, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(Expr, zeek::detail);
+
+namespace zeek::detail {
+
+class ByteCodeCompiler;
+
+/**
+ * A script function body lowered to a flat, register-based instruction
+ * stream. Arithmetic, comparisons and logic on atomic types (bool, int,
+ * count, double, time, interval) run on unboxed registers without
+ * creating intermediary values; locals still live in the \a Frame, so
+ * that any expression or statement without an instruction of its own
+ * can run through the AST as before.
+ */
+class ByteCode {
+public:
+	/**
+	 * Lowers a function body.
+	 *
+	 * @param body The body's statements.
+	 *
+	 * @return The lowered body, or null if it wouldn't lower to anything
+	 * but AST fallbacks.
+	 */
+	static std::unique_ptr<ByteCode> Compile(const Stmt* body);
+
+	/**
+	 * Executes the body, with the same semantics as \a Stmt::Exec().
+	 */
+	ValPtr Exec(Frame* f, StmtFlowType& flow) const;
+
+	/**
+	 * Returns the number of instructions.
+	 */
+	size_t Size() const	{ return code.size(); }
+
+	/**
+	 * Returns the number of statements and expressions that execute
+	 * through the AST.
+	 */
+	size_t NumFallbacks() const	{ return num_fallbacks; }
+
+	// Upper bound on the registers a body may use.
+	static constexpr int MAX_REGS = 32;
+
+private:
+	friend class ByteCodeCompiler;
+
+	enum Op : uint8_t {
+		OP_ACCESS,	// Account for statement s.
+
+		// Loads into r1.
+		OP_CONST_I, OP_CONST_U, OP_CONST_D, OP_CONST_V,
+		OP_LOCAL_I, OP_LOCAL_U, OP_LOCAL_D, OP_LOCAL_V,
+		OP_GLOBAL_I, OP_GLOBAL_U, OP_GLOBAL_D, OP_GLOBAL_V,
+		OP_FIELD,	// r1 = field n of r2.
+		OP_FIELD_I, OP_FIELD_U, OP_FIELD_D,	// Same, unboxed.
+		OP_HAS_FIELD,	// r1 = whether field n of r2 is set.
+
+		// Stores r1.
+		OP_STORE_LOCAL, OP_STORE_GLOBAL,
+
+		// Conversions between boxed and unboxed representations,
+		// r1 = r2.
+		OP_BOX,	// For type tag n.
+		OP_UNBOX_I, OP_UNBOX_U, OP_UNBOX_D, OP_UNBOX_B,
+
+		// Arithmetic coercions, r1 = r2.
+		OP_I2U, OP_I2D, OP_U2I, OP_U2D, OP_D2I, OP_D2U,
+
+		// r1 = r2 op r3.
+		OP_ADD_I, OP_ADD_U, OP_ADD_D,
+		OP_SUB_I, OP_SUB_U, OP_SUB_D,
+		OP_MUL_I, OP_MUL_U, OP_MUL_D,
+		OP_DIV_I, OP_DIV_U, OP_DIV_D,
+		OP_MOD_I, OP_MOD_U,
+		OP_LT_I, OP_LT_U, OP_LT_D,
+		OP_LE_I, OP_LE_U, OP_LE_D,
+		OP_EQ_I, OP_EQ_U, OP_EQ_D,
+		OP_NE_I, OP_NE_U, OP_NE_D,
+
+		// r1 = op r2.
+		OP_NOT, OP_NEG_I, OP_NEG_D,
+		OP_MOVE,
+
+		OP_JMP,	// Jump to target.
+		OP_JMP_FALSE,	// Jump to target if r1 is false.
+		OP_JMP_TRUE,	// Jump to target if r1 is true.
+
+		// Evaluates e through the AST into r1. Jumps to target if it
+		// yields no value.
+		OP_EVAL,
+
+		// Executes s through the AST. On break/next, jumps to target
+		// or n, respectively, if inside a lowered loop.
+		OP_EXEC,
+
+		OP_RETURN,	// Returns r1.
+		OP_RETURN_VOID,
+		OP_FLOW,	// Returns with flow type n.
+	};
+
+	struct Instr {
+		Op op;
+		int r1 = 0;
+		int r2 = 0;
+		int r3 = 0;
+		int n = 0;
+		int target = -1;
+
+		union {
+			bro_int_t i;
+			bro_uint_t u;
+			double d;
+		} c = {0};
+
+		Val* v = nullptr;	// Kept alive by its ConstExpr.
+		IDPtr id;
+		const Expr* e = nullptr;	// For fallbacks and error messages.
+		const Expr* e2 = nullptr;	// A field's &default.
+		const Stmt* s = nullptr;
+	};
+
+	struct Reg {
+		union {
+			bro_int_t i;
+			bro_uint_t u;
+			double d;
+		};
+
+		ValPtr v;
+	};
+
+	static ValPtr Box(const Reg& r, int tag);
+
+	std::vector<Instr> code;
+	int num_regs = 0;
+	size_t num_fallbacks = 0;
+};
+
+/**
+ * Lowers the bodies of all global script functions, events and hooks to
+ * bytecode, if the compile_scripts option is set.
+ */
+extern void compile_script_bodies();
+
+} // namespace zeek::detail
@@ -7,6 +7,7 @@
 #include <map>
 
 #include "CompHash.h"
+#include "CompactSet.h"
 #include "ZeekString.h"
 #include "Dict.h"
 #include "Val.h"
@@ -64,6 +65,11 @@ CompositeHash::CompositeHash(TypeListPtr composite_type)
 				(new double[size/sizeof(double) + 1]);
 		else
 			key = nullptr;
+
+		const auto& tl = type->GetTypes();
+		is_addr_port = tl.size() == 2 &&
+			tl[0]->InternalType() == TYPE_INTERNAL_ADDR &&
+			tl[1]->InternalType() == TYPE_INTERNAL_UNSIGNED;
 		}
 	}
 
@@ -230,6 +236,20 @@ char* CompositeHash::SingleValHash(bool type_check, char* kp0,
 			HashKey* k;
 			auto idx = 0;
 
+			if ( auto cs = tv->CompactStorage() )
+				{
+				// The same keys as for a set with regular entries.
+				size_t pos = 0;
+
+				while ( auto index = cs->Next(&pos) )
+					{
+					hashkeys[tv->MakeHashKey(*index).release()] = idx++;
+					auto index_lv = make_intrusive<ListVal>(TYPE_ANY);
+					index_lv->Append(std::move(index));
+					lv->Append(std::move(index_lv));
+					}
+				}
+
 			while ( tbl->NextEntry(k, it) )
 				{
 				hashkeys[k] = idx++;
@@ -357,6 +377,9 @@ std::unique_ptr<HashKey> CompositeHash::MakeHashKey(const Val& argv, bool type_c
 		return MakeHashKey(lv, type_check);
 		}
 
+	if ( is_addr_port )
+		return ComputeAddrPortHash(v, type_check);
+
 	char* k = key;
 
 	if ( ! k )
@@ -390,6 +413,39 @@ std::unique_ptr<HashKey> CompositeHash::MakeHashKey(const Val& argv, bool type_c
 	return std::make_unique<HashKey>((k == key), (void*) k, kp - k);
 	}
 
+std::unique_ptr<HashKey> CompositeHash::ComputeAddrPortHash(const Val* v, bool type_check) const
+	{
+	if ( type_check && v->GetType()->Tag() != TYPE_LIST )
+		return nullptr;
+
+	auto lv = v->AsListVal();
+
+	if ( type_check && lv->Length() != 2 )
+		return nullptr;
+
+	const auto& a = lv->Idx(0);
+	const auto& p = lv->Idx(1);
+
+	if ( type_check &&
+	     (a->GetType()->InternalType() != TYPE_INTERNAL_ADDR ||
+	      p->GetType()->InternalType() != TYPE_INTERNAL_UNSIGNED) )
+		return nullptr;
+
+	// The same layout SingleValHash() produces for the pair, which
+	// RecoverVals() relies on. It fits into the key's inline storage.
+	struct {
+		uint32_t addr[4];
+		bro_uint_t port;
+	} k;
+
+	static_assert(sizeof(k) <= HashKey::INLINE_KEY_SIZE);
+
+	a->AsAddr().CopyIPv6(k.addr);
+	k.port = p->ForceAsUInt();
+
+	return std::make_unique<HashKey>(&k, sizeof(k));
+	}
+
 std::unique_ptr<HashKey> CompositeHash::ComputeSingletonHash(const Val* v, bool type_check) const
 	{
 	if ( v->GetType()->Tag() == TYPE_LIST )
@@ -732,6 +788,23 @@ ListValPtr CompositeHash::RecoverVals(const HashKey& k) const
 	return l;
 	}
 
+void CompositeHash::RecoverVals(const HashKey& k, ValPtr* vals) const
+	{
+	const auto& tl = type->GetTypes();
+	const char* kp = (const char*) k.Key();
+	const char* const k_end = kp + k.Size();
+
+	for ( const auto& type : tl )
+		{
+		kp = RecoverOneVal(k, kp, k_end, type.get(), vals, false);
+		ASSERT(*vals);
+		++vals;
+		}
+
+	if ( kp != k_end )
+		reporter->InternalError("under-ran key in CompositeHash::DescribeKey %zd", k_end - kp);
+	}
+
 const char* CompositeHash::RecoverOneVal(
 	const HashKey& k, const char* kp0,
 	const char* const k_end, Type* t,
@@ -32,6 +32,10 @@ public:
 	// Given a hash key, recover the values used to create it.
 	ListValPtr RecoverVals(const HashKey& k) const;
 
+	// Same, but stores the values in vals, which needs room for one
+	// per type, instead of building a ListVal.
+	void RecoverVals(const HashKey& k, ValPtr* vals) const;
+
 	[[deprecated("Remove in v4.1.  Pass in HashKey& instead.")]]
 	ListValPtr RecoverVals(const HashKey* k) const
 		{ return RecoverVals(*k); }
@@ -41,6 +45,10 @@ public:
 protected:
 	std::unique_ptr<HashKey> ComputeSingletonHash(const Val* v, bool type_check) const;
 
+	// Fast path for an address followed by a port or count, bypassing
+	// the generic per-element serialization.
+	std::unique_ptr<HashKey> ComputeAddrPortHash(const Val* v, bool type_check) const;
+
 	// Computes the piece of the hash for Val*, returning the new kp.
 	// Used as a helper for ComputeHash in the non-singleton case.
 	char* SingleValHash(bool type_check, char* kp, Type* bt, Val* v,
@@ -103,6 +111,9 @@ protected:
 	// If one type, but not normal "singleton", e.g. record.
 	bool is_complex_type;
 
+	// If an address and a port (or another unsigned type).
+	bool is_addr_port = false;
+
 	InternalTypeTag singleton_tag;
 };
 
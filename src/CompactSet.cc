@@ -0,0 +1,470 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "CompactSet.h"
+
+#include <cstring>
+#include <limits>
+
+#include "IPAddr.h"
+#include "Reporter.h"
+#include "Val.h"
+#include "ZeekString.h"
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::detail {
+
+// Tables start out at this many slots, and never shrink below it.
+static constexpr size_t MIN_SLOTS = 16;
+
+// Removed strings get dropped from the string buffer once they take up
+// more than half of it, and at least this much.
+static constexpr size_t MIN_STRING_GARBAGE = 4096;
+
+static hash_t hash_v4(uint32_t k)
+	{
+	return HashKey::HashBytes(&k, sizeof(k));
+	}
+
+static hash_t hash_v6(const std::array<uint32_t, 4>& k)
+	{
+	return HashKey::HashBytes(k.data(), sizeof(k));
+	}
+
+static size_t varint_size(size_t n)
+	{
+	size_t size = 1;
+
+	for ( ; n >= 0x80; n >>= 7 )
+		++size;
+
+	return size;
+	}
+
+template<typename Key>
+template<typename Match>
+ptrdiff_t CompactSet::Table<Key>::Find(hash_t h, Match match) const
+	{
+	if ( keys.empty() )
+		return -1;
+
+	// Resizing keeps some slots empty, so this terminates.
+	size_t mask = keys.size() - 1;
+
+	for ( size_t i = h & mask; ; i = (i + 1) & mask )
+		{
+		if ( states[i] == EMPTY )
+			return -1;
+
+		if ( states[i] == USED && match(keys[i]) )
+			return i;
+		}
+	}
+
+template<typename Key>
+template<typename Hash>
+void CompactSet::Table<Key>::Add(hash_t h, const Key& k, Hash hash)
+	{
+	if ( (count + deleted + 1) * 4 > keys.size() * 3 )
+		Resize(hash);
+
+	size_t mask = keys.size() - 1;
+	size_t i = h & mask;
+
+	while ( states[i] == USED )
+		i = (i + 1) & mask;
+
+	if ( states[i] == DELETED )
+		--deleted;
+
+	keys[i] = k;
+	states[i] = USED;
+	++count;
+	}
+
+template<typename Key>
+template<typename Hash>
+void CompactSet::Table<Key>::Resize(Hash hash)
+	{
+	// Leaves the table half full, which also drops the deleted slots.
+	size_t n = MIN_SLOTS;
+
+	while ( n < (count + 1) * 2 )
+		n *= 2;
+
+	std::vector<Key> old_keys(n);
+	std::vector<uint8_t> old_states(n, EMPTY);
+	old_keys.swap(keys);
+	old_states.swap(states);
+	deleted = 0;
+
+	size_t mask = n - 1;
+
+	for ( size_t j = 0; j < old_keys.size(); ++j )
+		{
+		if ( old_states[j] != USED )
+			continue;
+
+		size_t i = hash(old_keys[j]) & mask;
+
+		while ( states[i] == USED )
+			i = (i + 1) & mask;
+
+		keys[i] = old_keys[j];
+		states[i] = USED;
+		}
+	}
+
+template<typename Key>
+void CompactSet::Table<Key>::Clear()
+	{
+	std::vector<Key>().swap(keys);
+	std::vector<uint8_t>().swap(states);
+	count = 0;
+	deleted = 0;
+	}
+
+bool CompactSet::IsCompactable(const TableType* t)
+	{
+	if ( ! t->IsSet() )
+		return false;
+
+	const auto& types = t->GetIndexTypes();
+
+	if ( types.size() != 1 )
+		return false;
+
+	auto tag = types[0]->Tag();
+	return tag == TYPE_ADDR || tag == TYPE_STRING;
+	}
+
+CompactSet::CompactSet(TypeTag arg_tag) : tag(arg_tag)
+	{
+	}
+
+std::pair<const char*, size_t> CompactSet::StringAt(uint32_t offset) const
+	{
+	auto p = reinterpret_cast<const unsigned char*>(string_data.data() + offset);
+	size_t len = 0;
+
+	for ( int shift = 0; ; shift += 7 )
+		{
+		len |= size_t(*p & 0x7f) << shift;
+
+		if ( ! (*p++ & 0x80) )
+			break;
+		}
+
+	return {reinterpret_cast<const char*>(p), len};
+	}
+
+ptrdiff_t CompactSet::FindString(const char* s, size_t len, hash_t h) const
+	{
+	return strings.Find(h, [&](uint32_t offset)
+		{
+		auto [t, n] = StringAt(offset);
+		return n == len && memcmp(s, t, len) == 0;
+		});
+	}
+
+bool CompactSet::Insert(const Val& v)
+	{
+	if ( tag == TYPE_STRING )
+		{
+		auto str = v.AsString();
+		auto s = reinterpret_cast<const char*>(str->Bytes());
+		size_t len = str->Len();
+		auto h = HashKey::HashBytes(s, len);
+
+		if ( FindString(s, len, h) >= 0 )
+			return false;
+
+		size_t offset = string_data.size();
+
+		if ( offset + varint_size(len) + len > std::numeric_limits<uint32_t>::max() )
+			{
+			reporter->Error("compact set exceeds 4 GB of strings, element not added");
+			return false;
+			}
+
+		for ( size_t n = len; ; n >>= 7 )
+			{
+			if ( n < 0x80 )
+				{
+				string_data.push_back(char(n));
+				break;
+				}
+
+			string_data.push_back(char((n & 0x7f) | 0x80));
+			}
+
+		string_data.insert(string_data.end(), s, s + len);
+
+		strings.Add(h, offset, [this](uint32_t o)
+			{
+			auto [t, n] = StringAt(o);
+			return HashKey::HashBytes(t, n);
+			});
+
+		return true;
+		}
+
+	const uint32_t* bytes;
+
+	if ( v.AsAddr().GetBytes(&bytes) == 1 )
+		{
+		uint32_t k = bytes[0];
+		auto h = hash_v4(k);
+
+		if ( v4.Find(h, [k](uint32_t x) { return x == k; }) >= 0 )
+			return false;
+
+		v4.Add(h, k, hash_v4);
+		return true;
+		}
+
+	IPv6Key k;
+	memcpy(k.data(), bytes, sizeof(k));
+	auto h = hash_v6(k);
+
+	if ( v6.Find(h, [&k](const IPv6Key& x) { return x == k; }) >= 0 )
+		return false;
+
+	v6.Add(h, k, hash_v6);
+	return true;
+	}
+
+bool CompactSet::Remove(const Val& v)
+	{
+	if ( tag == TYPE_STRING )
+		{
+		auto str = v.AsString();
+		auto s = reinterpret_cast<const char*>(str->Bytes());
+		size_t len = str->Len();
+		auto slot = FindString(s, len, HashKey::HashBytes(s, len));
+
+		if ( slot < 0 )
+			return false;
+
+		strings.Erase(slot);
+		string_garbage += varint_size(len) + len;
+
+		if ( strings.count == 0 )
+			Clear();
+
+		else if ( string_garbage > MIN_STRING_GARBAGE &&
+		          string_garbage * 2 > string_data.size() )
+			CompactStrings();
+
+		return true;
+		}
+
+	const uint32_t* bytes;
+
+	if ( v.AsAddr().GetBytes(&bytes) == 1 )
+		{
+		uint32_t k = bytes[0];
+		auto slot = v4.Find(hash_v4(k), [k](uint32_t x) { return x == k; });
+
+		if ( slot < 0 )
+			return false;
+
+		v4.Erase(slot);
+
+		if ( v4.keys.size() > MIN_SLOTS && v4.count * 8 < v4.keys.size() )
+			v4.Resize(hash_v4);
+
+		return true;
+		}
+
+	IPv6Key k;
+	memcpy(k.data(), bytes, sizeof(k));
+	auto slot = v6.Find(hash_v6(k), [&k](const IPv6Key& x) { return x == k; });
+
+	if ( slot < 0 )
+		return false;
+
+	v6.Erase(slot);
+
+	if ( v6.keys.size() > MIN_SLOTS && v6.count * 8 < v6.keys.size() )
+		v6.Resize(hash_v6);
+
+	return true;
+	}
+
+bool CompactSet::Contains(const Val& v) const
+	{
+	if ( tag == TYPE_STRING )
+		{
+		auto str = v.AsString();
+		auto s = reinterpret_cast<const char*>(str->Bytes());
+		size_t len = str->Len();
+		return FindString(s, len, HashKey::HashBytes(s, len)) >= 0;
+		}
+
+	const uint32_t* bytes;
+
+	if ( v.AsAddr().GetBytes(&bytes) == 1 )
+		{
+		uint32_t k = bytes[0];
+		return v4.Find(hash_v4(k), [k](uint32_t x) { return x == k; }) >= 0;
+		}
+
+	IPv6Key k;
+	memcpy(k.data(), bytes, sizeof(k));
+	return v6.Find(hash_v6(k), [&k](const IPv6Key& x) { return x == k; }) >= 0;
+	}
+
+void CompactSet::Clear()
+	{
+	v4.Clear();
+	v6.Clear();
+	strings.Clear();
+	std::vector<char>().swap(string_data);
+	string_garbage = 0;
+	}
+
+void CompactSet::CompactStrings()
+	{
+	std::vector<char> data;
+	data.reserve(string_data.size() - string_garbage);
+
+	// The hashes don't change, so the strings keep their slots.
+	for ( size_t i = 0; i < strings.keys.size(); ++i )
+		{
+		if ( strings.states[i] != USED )
+			continue;
+
+		auto [s, len] = StringAt(strings.keys[i]);
+		const char* begin = string_data.data() + strings.keys[i];
+		strings.keys[i] = data.size();
+		data.insert(data.end(), begin, s + len);
+		}
+
+	string_data.swap(data);
+	string_garbage = 0;
+	}
+
+ValPtr CompactSet::Next(size_t* pos) const
+	{
+	if ( tag == TYPE_STRING )
+		{
+		for ( ; *pos < strings.keys.size(); ++*pos )
+			{
+			if ( strings.states[*pos] != USED )
+				continue;
+
+			auto [s, len] = StringAt(strings.keys[(*pos)++]);
+			return make_intrusive<StringVal>(len, s);
+			}
+
+		return nullptr;
+		}
+
+	for ( ; *pos < v4.keys.size(); ++*pos )
+		{
+		if ( v4.states[*pos] == USED )
+			return make_intrusive<AddrVal>(v4.keys[(*pos)++]);
+		}
+
+	for ( ; *pos < v4.keys.size() + v6.keys.size(); ++*pos )
+		{
+		size_t i = *pos - v4.keys.size();
+
+		if ( v6.states[i] == USED )
+			{
+			++*pos;
+			return make_intrusive<AddrVal>(v6.keys[i].data());
+			}
+		}
+
+	return nullptr;
+	}
+
+size_t CompactSet::MemoryAllocation() const
+	{
+	return padded_sizeof(*this) +
+		v4.keys.capacity() * sizeof(uint32_t) + v4.states.capacity() +
+		v6.keys.capacity() * sizeof(IPv6Key) + v6.states.capacity() +
+		strings.keys.capacity() * sizeof(uint32_t) + strings.states.capacity() +
+		string_data.capacity();
+	}
+
+} // namespace zeek::detail
+
+TEST_CASE("compact set addresses")
+	{
+	zeek::detail::CompactSet s(zeek::TYPE_ADDR);
+
+	for ( int i = 0; i < 1000; ++i )
+		{
+		auto a = zeek::make_intrusive<zeek::AddrVal>(zeek::util::fmt("10.0.%d.%d", i / 256, i % 256));
+		CHECK(s.Insert(*a));
+		CHECK_FALSE(s.Insert(*a));
+		}
+
+	auto v6 = zeek::make_intrusive<zeek::AddrVal>("2001:db8::1");
+	CHECK(s.Insert(*v6));
+	CHECK(s.Size() == 1001);
+	CHECK(s.Contains(*v6));
+	CHECK(s.Contains(*zeek::make_intrusive<zeek::AddrVal>("10.0.3.231")));
+	CHECK_FALSE(s.Contains(*zeek::make_intrusive<zeek::AddrVal>("10.0.3.232")));
+
+	for ( int i = 0; i < 990; ++i )
+		{
+		auto a = zeek::make_intrusive<zeek::AddrVal>(zeek::util::fmt("10.0.%d.%d", i / 256, i % 256));
+		CHECK(s.Remove(*a));
+		CHECK_FALSE(s.Remove(*a));
+		}
+
+	CHECK(s.Size() == 11);
+	CHECK(s.Contains(*zeek::make_intrusive<zeek::AddrVal>("10.0.3.230")));
+
+	size_t pos = 0;
+	size_t n = 0;
+	bool saw_v6 = false;
+
+	while ( auto v = s.Next(&pos) )
+		{
+		++n;
+		saw_v6 = saw_v6 || v->AsAddr() == v6->AsAddr();
+		}
+
+	CHECK(n == 11);
+	CHECK(saw_v6);
+	}
+
+TEST_CASE("compact set strings")
+	{
+	zeek::detail::CompactSet s(zeek::TYPE_STRING);
+	std::string long_string(300, 'x');
+
+	for ( int i = 0; i < 1000; ++i )
+		CHECK(s.Insert(*zeek::make_intrusive<zeek::StringVal>(long_string + std::to_string(i))));
+
+	CHECK(s.Insert(*zeek::make_intrusive<zeek::StringVal>("")));
+	CHECK_FALSE(s.Insert(*zeek::make_intrusive<zeek::StringVal>(long_string + "7")));
+	CHECK(s.Size() == 1002);
+
+	// Enough removals to have the remaining strings moved.
+	for ( int i = 0; i < 900; ++i )
+		CHECK(s.Remove(*zeek::make_intrusive<zeek::StringVal>(long_string + std::to_string(i))));
+
+	CHECK(s.Size() == 102);
+	CHECK(s.Contains(*zeek::make_intrusive<zeek::StringVal>("")));
+	CHECK(s.Contains(*zeek::make_intrusive<zeek::StringVal>(long_string + "999")));
+	CHECK_FALSE(s.Contains(*zeek::make_intrusive<zeek::StringVal>(long_string + "0")));
+
+	size_t pos = 0;
+	size_t n = 0;
+
+	while ( auto v = s.Next(&pos) )
+		{
+		++n;
+		CHECK(s.Contains(*v));
+		}
+
+	CHECK(n == 102);
+	}
@@ -0,0 +1,140 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Hash.h"
+#include "IntrusivePtr.h"
+#include "Type.h"
+
+ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
+
+namespace zeek {
+using ValPtr = zeek::IntrusivePtr<Val>;
+}
+
+namespace zeek::detail {
+
+/**
+ * The storage of a set with the &compact attribute. Instead of a
+ * dictionary of hash keys and table entries, it keeps the raw elements in
+ * flat open-addressing hash tables: IPv4 addresses as 4 bytes, IPv6
+ * addresses as 16, and strings as offsets into one buffer holding all of
+ * them. That takes a small fraction of the memory of regular entries,
+ * for the price of creating a Val for each element that gets iterated
+ * over.
+ */
+class CompactSet {
+public:
+	/**
+	 * Returns whether sets of the given type can be kept compact: they
+	 * need to have a single index of type addr or string.
+	 */
+	static bool IsCompactable(const TableType* t);
+
+	/**
+	 * Constructor.
+	 *
+	 * @param tag The type of the elements, TYPE_ADDR or TYPE_STRING.
+	 */
+	explicit CompactSet(TypeTag tag);
+
+	TypeTag Tag() const	{ return tag; }
+
+	/**
+	 * Adds an element, unless it's already present.
+	 *
+	 * @return True if the element is new.
+	 */
+	bool Insert(const Val& v);
+
+	/**
+	 * Removes an element, if present.
+	 *
+	 * @return True if the element was present.
+	 */
+	bool Remove(const Val& v);
+
+	bool Contains(const Val& v) const;
+
+	size_t Size() const	{ return v4.count + v6.count + strings.count; }
+
+	void Clear();
+
+	/**
+	 * Iterates over the elements, in no particular order. Start with a
+	 * position of zero. The set must not change during the iteration.
+	 *
+	 * @param pos Where to continue, updated to after the element
+	 * returned.
+	 *
+	 * @return The next element, or null if there are no more.
+	 */
+	ValPtr Next(size_t* pos) const;
+
+	size_t MemoryAllocation() const;
+
+private:
+	enum SlotState : uint8_t { EMPTY, USED, DELETED };
+
+	// A hash table with linear probing over flat arrays. Slot states
+	// have their own array so that any key value can be stored.
+	template<typename Key>
+	struct Table {
+		std::vector<Key> keys;
+		std::vector<uint8_t> states;
+		size_t count = 0;
+		size_t deleted = 0;
+
+		// Returns the slot of the key that match() accepts, or -1.
+		template<typename Match>
+		ptrdiff_t Find(hash_t h, Match match) const;
+
+		// Adds a key not present yet. hash() recomputes the hashes of
+		// existing keys if the table needs to be resized.
+		template<typename Hash>
+		void Add(hash_t h, const Key& k, Hash hash);
+
+		void Erase(size_t slot)
+			{
+			states[slot] = DELETED;
+			--count;
+			++deleted;
+			}
+
+		template<typename Hash>
+		void Resize(Hash hash);
+
+		void Clear();
+	};
+
+	using IPv6Key = std::array<uint32_t, 4>;
+
+	// Returns the element at a string offset.
+	std::pair<const char*, size_t> StringAt(uint32_t offset) const;
+
+	ptrdiff_t FindString(const char* s, size_t len, hash_t h) const;
+
+	// Moves the strings still present to a new buffer, once removals
+	// have left it mostly unused.
+	void CompactStrings();
+
+	TypeTag tag;
+	Table<uint32_t> v4;
+	Table<IPv6Key> v6;
+
+	// Offsets into string_data, where each string is stored as its
+	// length in a varint followed by its bytes.
+	Table<uint32_t> strings;
+	std::vector<char> string_data;
+
+	// Bytes of string_data belonging to removed strings.
+	size_t string_garbage = 0;
+};
+
+} // namespace zeek::detail
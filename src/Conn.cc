@@ -6,6 +6,8 @@
 
 #include <ctype.h>
 
+#include <algorithm>
+
 #include "Desc.h"
 #include "RunState.h"
 #include "NetVar.h"
@@ -21,6 +23,8 @@
 #include "analyzer/Manager.h"
 #include "iosource/IOSource.h"
 
+#include "analyzer/protocol/conn-size/events.bif.h"
+
 namespace zeek {
 namespace detail {
 
@@ -57,6 +61,20 @@ void ConnectionTimer::Dispatch(double t, bool is_expire)
 		reporter->InternalError("reference count inconsistency in ConnectionTimer::Dispatch");
 	}
 
+ConnectionSlotTimer::~ConnectionSlotTimer()
+	{
+	if ( conn->slot_timer == this )
+		conn->slot_timer = nullptr;
+
+	Unref(conn);
+	}
+
+void ConnectionSlotTimer::Dispatch(double t, bool is_expire)
+	{
+	conn->slot_timer = nullptr;
+	conn->DispatchSlotTimers(t, is_expire);
+	}
+
 } // namespace detail
 
 uint64_t Connection::total_connections = 0;
@@ -104,6 +122,8 @@ Connection::Connection(NetSessions* s, const detail::ConnIDKey& k, double t,
 	record_current_packet = record_current_content = 0;
 
 	timers_canceled = 0;
+	coalesce_timers = detail::connection_timer_coalescing;
+	slot_timer = nullptr;
 	inactivity_timeout = 0;
 	installed_status_timer = 0;
 
@@ -128,8 +148,11 @@ Connection::Connection(NetSessions* s, const detail::ConnIDKey& k, double t,
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 Connection::Connection(NetSessions* s, const detail::ConnIDKey& k, double t,
                        const ConnID* id, uint32_t flow, const Packet* pkt)
-	: Connection(s, k, t, id, flow, pkt, pkt->encap.get())
+	: Connection(s, k, t, id, flow, pkt, nullptr)
 	{
+	// Encapsulation stacks attached to packets don't change, so the
+	// connection can share its packet's.
+	encapsulation = pkt->encap;
 	}
 #pragma GCC diagnostic pop
 
@@ -151,6 +174,10 @@ Connection::~Connection()
 
 void Connection::CheckEncapsulation(const std::shared_ptr<EncapsulationStack>& arg_encap)
 	{
+	if ( encapsulation == arg_encap )
+		// Packets from the same tunnel share their stack.
+		return;
+
 	if ( encapsulation && arg_encap )
 		{
 		if ( *encapsulation != *arg_encap )
@@ -159,7 +186,7 @@ void Connection::CheckEncapsulation(const std::shared_ptr<EncapsulationStack>& a
 				EnqueueEvent(tunnel_changed, nullptr, ConnVal(),
 				             arg_encap->ToVal());
 
-			encapsulation = std::make_shared<EncapsulationStack>(*arg_encap);
+			encapsulation = arg_encap;
 			}
 		}
 
@@ -179,7 +206,7 @@ void Connection::CheckEncapsulation(const std::shared_ptr<EncapsulationStack>& a
 		if ( tunnel_changed )
 			EnqueueEvent(tunnel_changed, nullptr, ConnVal(), arg_encap->ToVal());
 
-		encapsulation = std::make_shared<EncapsulationStack>(*arg_encap);
+		encapsulation = arg_encap;
 		}
 	}
 
@@ -310,7 +337,7 @@ void Connection::SetInactivityTimeout(double timeout)
 	for ( const auto& timer : timers )
 		if ( timer->Type() == detail::TIMER_CONN_INACTIVITY )
 			{
-			detail::timer_mgr->Cancel(timer);
+			CancelTimer(timer);
 			break;
 			}
 
@@ -332,6 +359,41 @@ void Connection::EnableStatusUpdateTimer()
 		}
 	}
 
+void Connection::EnableCompactionTimer()
+	{
+	if ( detail::connection_compaction_interval > 0.0 )
+		ADD_TIMER(&Connection::CompactionTimer,
+		          run_state::network_time + detail::connection_compaction_interval, 0,
+		          detail::TIMER_CONN_COMPACTION);
+	}
+
+bool Connection::Compact()
+	{
+	if ( ! root_analyzer || ! root_analyzer->CanCompact() )
+		return false;
+
+	root_analyzer->Compact();
+	compacted_time = last_time;
+	return true;
+	}
+
+void Connection::CompactionTimer(double t)
+	{
+	double next = last_time + detail::connection_compaction_interval;
+
+	if ( next <= t )
+		{
+		// Idle long enough. Compacting again is pointless while
+		// there's been no activity since the last time.
+		if ( last_time != compacted_time && Compact() )
+			++detail::compacted_by_inactivity;
+
+		next = t + detail::connection_compaction_interval;
+		}
+
+	ADD_TIMER(&Connection::CompactionTimer, next, 0, detail::TIMER_CONN_COMPACTION);
+	}
+
 void Connection::StatusUpdateTimer(double t)
 	{
 	EnqueueEvent(connection_status_update, nullptr, ConnVal());
@@ -360,9 +422,9 @@ const RecordValPtr& Connection::ConnVal()
 		id_val->Assign(3, val_mgr->Port(ntohs(resp_port), prot_type));
 
 		auto orig_endp = make_intrusive<RecordVal>(id::endpoint);
-		orig_endp->Assign(0, val_mgr->Count(0));
-		orig_endp->Assign(1, val_mgr->Count(0));
-		orig_endp->Assign(4, val_mgr->Count(orig_flow_label));
+		orig_endp->AssignCount(0, 0);
+		orig_endp->AssignCount(1, 0);
+		orig_endp->AssignCount(4, orig_flow_label);
 
 		const int l2_len = sizeof(orig_l2_addr);
 		char null[l2_len]{};
@@ -371,9 +433,9 @@ const RecordValPtr& Connection::ConnVal()
 			orig_endp->Assign(5, make_intrusive<StringVal>(fmt_mac(orig_l2_addr, l2_len)));
 
 		auto resp_endp = make_intrusive<RecordVal>(id::endpoint);
-		resp_endp->Assign(0, val_mgr->Count(0));
-		resp_endp->Assign(1, val_mgr->Count(0));
-		resp_endp->Assign(4, val_mgr->Count(resp_flow_label));
+		resp_endp->AssignCount(0, 0);
+		resp_endp->AssignCount(1, 0);
+		resp_endp->AssignCount(4, resp_flow_label);
 
 		if ( memcmp(&resp_l2_addr, &null, l2_len) != 0 )
 			resp_endp->Assign(5, make_intrusive<StringVal>(fmt_mac(resp_l2_addr, l2_len)));
@@ -384,29 +446,36 @@ const RecordValPtr& Connection::ConnVal()
 		// 3 and 4 are set below.
 		conn_val->Assign(5, make_intrusive<TableVal>(id::string_set));	// service
 		conn_val->Assign(6, val_mgr->EmptyString());	// history
+		conn_val_history_len = 0;
 
-		if ( ! uid )
-			uid.Set(zeek::detail::bits_per_uid);
-
-		conn_val->Assign(7, make_intrusive<StringVal>(uid.Base62("C").c_str()));
+		conn_val->Assign(7, UIDVal());
 
 		if ( encapsulation && encapsulation->Depth() > 0 )
 			conn_val->Assign(8, encapsulation->ToVal());
 
 		if ( vlan != 0 )
-			conn_val->Assign(9, val_mgr->Int(vlan));
+			conn_val->AssignInt(9, vlan);
 
 		if ( inner_vlan != 0 )
-			conn_val->Assign(10, val_mgr->Int(inner_vlan));
+			conn_val->AssignInt(10, inner_vlan);
 
 		}
 
+	if ( conn_size.Enabled() )
+		conn_size.UpdateConnVal(conn_val.get());
+
 	if ( root_analyzer )
 		root_analyzer->UpdateConnVal(conn_val.get());
 
-	conn_val->Assign(3, make_intrusive<TimeVal>(start_time));	// ###
-	conn_val->Assign(4, make_intrusive<IntervalVal>(last_time - start_time));
-	conn_val->Assign(6, make_intrusive<StringVal>(history.c_str()));
+	conn_val->AssignDouble(3, start_time);	// ###
+	conn_val->AssignDouble(4, last_time - start_time);
+
+	// The history only ever grows, so it's stale iff its length changed.
+	if ( history.size() != conn_val_history_len )
+		{
+		conn_val->Assign(6, make_intrusive<StringVal>(history.c_str()));
+		conn_val_history_len = history.size();
+		}
 
 	conn_val->SetOrigin(this);
 
@@ -436,6 +505,9 @@ void Connection::AppendAddl(const char* str)
 	const char* format = *old ? "%s %s" : "%s%s";
 
 	cv->Assign(6, make_intrusive<StringVal>(util::fmt(format, old, str)));
+
+	// The next refresh puts the plain history back.
+	conn_val_history_len = std::string::npos;
 	}
 
 // Returns true if the character at s separates a version number.
@@ -550,8 +622,90 @@ void Connection::AddTimer(timer_func timer, double t, bool do_expire,
 		return;
 
 	detail::Timer* conn_timer = new detail::ConnectionTimer(this, timer, t, do_expire, type);
-	detail::timer_mgr->Add(conn_timer);
 	timers.push_back(conn_timer);
+	ScheduleTimer(conn_timer);
+	}
+
+void Connection::ScheduleTimer(detail::Timer* timer)
+	{
+	if ( ! coalesce_timers )
+		{
+		detail::timer_mgr->Add(timer);
+		return;
+		}
+
+	slot_timers.push_back(timer);
+
+	if ( ! slot_timer || timer->Time() < slot_timer->Time() )
+		ArmSlotTimer(timer);
+	}
+
+void Connection::CancelTimer(detail::Timer* timer)
+	{
+	auto it = std::find(slot_timers.begin(), slot_timers.end(), timer);
+
+	if ( it == slot_timers.end() )
+		{
+		detail::timer_mgr->Cancel(timer);
+		return;
+		}
+
+	slot_timers.erase(it);
+	delete timer;
+
+	// Otherwise we leave the slot armed; if it fires early, it just
+	// re-arms for the next pending timer. Canceling the slot may release
+	// the last reference to us, so it needs to come last.
+	if ( slot_timers.empty() && slot_timer )
+		detail::timer_mgr->Cancel(slot_timer);
+	}
+
+void Connection::ArmSlotTimer(const detail::Timer* next)
+	{
+	// Install the new one first, as canceling the old may otherwise
+	// release the last reference to us.
+	detail::Timer* old = slot_timer;
+	slot_timer = new detail::ConnectionSlotTimer(this, next->Time(), next->Type());
+	detail::timer_mgr->Add(slot_timer);
+
+	if ( old )
+		detail::timer_mgr->Cancel(old);
+	}
+
+void Connection::DispatchSlotTimers(double t, bool is_expire)
+	{
+	// One at a time, as each may cancel or add others.
+	while ( true )
+		{
+		auto due = slot_timers.end();
+
+		for ( auto it = slot_timers.begin(); it != slot_timers.end(); ++it )
+			{
+			if ( (is_expire || (*it)->Time() <= t) &&
+			     (due == slot_timers.end() || (*it)->Time() < (*due)->Time()) )
+				due = it;
+			}
+
+		if ( due == slot_timers.end() )
+			break;
+
+		detail::Timer* timer = *due;
+		slot_timers.erase(due);
+		timer->Dispatch(t, is_expire);
+		delete timer;
+		}
+
+	if ( is_expire || slot_timers.empty() )
+		return;
+
+	// The dispatched timers may have armed the slot already, though not
+	// necessarily for the earliest one.
+	auto next = std::min_element(slot_timers.begin(), slot_timers.end(),
+	                             [](const detail::Timer* a, const detail::Timer* b)
+	                             { return a->Time() < b->Time(); });
+
+	if ( ! slot_timer || (*next)->Time() < slot_timer->Time() )
+		ArmSlotTimer(*next);
 	}
 
 void Connection::RemoveTimer(detail::Timer* t)
@@ -569,12 +723,31 @@ void Connection::CancelTimers()
 	std::copy(timers.begin(), timers.end(), std::back_inserter(tmp));
 
 	for ( const auto& timer : tmp )
-		detail::timer_mgr->Cancel(timer);
+		CancelTimer(timer);
 
 	timers_canceled = 1;
 	timers.clear();
 	}
 
+void Connection::SetUID(const UID& arg_uid)
+	{
+	uid = arg_uid;
+	uid_val = nullptr;
+	}
+
+const StringValPtr& Connection::UIDVal()
+	{
+	if ( ! uid_val )
+		{
+		if ( ! uid )
+			uid.Set(zeek::detail::bits_per_uid);
+
+		uid_val = make_intrusive<StringVal>(uid.Base62("C"));
+		}
+
+	return uid_val;
+	}
+
 void Connection::FlipRoles()
 	{
 	IPAddr tmp_addr = resp_addr;
@@ -601,6 +774,9 @@ void Connection::FlipRoles()
 
 	conn_val = nullptr;
 
+	if ( conn_size.Enabled() )
+		conn_size.FlipRoles();
+
 	if ( root_analyzer )
 		root_analyzer->FlipRoles();
 
@@ -698,7 +874,7 @@ void Connection::CheckFlowLabel(bool is_orig, uint32_t flow_label)
 		if ( conn_val )
 			{
 			RecordVal* endp = conn_val->GetField(is_orig ? 1 : 2)->AsRecordVal();
-			endp->Assign(4, val_mgr->Count(flow_label));
+			endp->AssignCount(4, flow_label);
 			}
 
 		if ( connection_flow_label_changed &&
@@ -721,10 +897,114 @@ void Connection::CheckFlowLabel(bool is_orig, uint32_t flow_label)
 		saw_first_resp_packet = 1;
 	}
 
-bool Connection::PermitWeird(const char* name, uint64_t threshold, uint64_t rate,
+bool Connection::PermitWeird(detail::WeirdID id, uint64_t threshold, uint64_t rate,
                              double duration)
 	{
-	return detail::PermitWeird(weird_state, name, threshold, rate, duration);
+	return detail::PermitWeird(weird_state, id, threshold, rate, duration);
 	}
 
+namespace detail {
+
+void ConnSize::Enable(double arg_start_time)
+	{
+	enabled = true;
+	start_time = arg_start_time;
+	}
+
+void ConnSize::ThresholdEvent(Connection* c, EventHandlerPtr f, uint64_t threshold, bool is_orig)
+	{
+	if ( ! f )
+		return;
+
+	c->EnqueueEvent(f, nullptr, c->ConnVal(), val_mgr->Count(threshold),
+	                val_mgr->Bool(is_orig));
+	}
+
+void ConnSize::CheckThresholds(Connection* c, bool is_orig)
+	{
+	auto& e = is_orig ? orig : resp;
+
+	if ( e.bytes >= e.bytes_thresh )
+		{
+		auto t = e.bytes_thresh;
+		e.bytes_thresh = UNSET;
+		ThresholdEvent(c, conn_bytes_threshold_crossed, t, is_orig);
+		}
+
+	if ( e.pkts >= e.pkts_thresh )
+		{
+		auto t = e.pkts_thresh;
+		e.pkts_thresh = UNSET;
+		ThresholdEvent(c, conn_packets_threshold_crossed, t, is_orig);
+		}
+
+	if ( run_state::network_time - start_time > duration_thresh &&
+	     conn_duration_threshold_crossed )
+		{
+		auto t = duration_thresh;
+		duration_thresh = UNSET_DURATION;
+		c->EnqueueEvent(conn_duration_threshold_crossed, nullptr, c->ConnVal(),
+		                make_intrusive<IntervalVal>(t), val_mgr->Bool(is_orig));
+		}
+	}
+
+void ConnSize::SetByteAndPacketThreshold(Connection* c, uint64_t threshold, bool bytes,
+                                         bool is_orig)
+	{
+	auto& e = is_orig ? orig : resp;
+	(bytes ? e.bytes_thresh : e.pkts_thresh) = threshold ? threshold : UNSET;
+
+	// Check if threshold is already crossed.
+	CheckThresholds(c, is_orig);
+	}
+
+void ConnSize::SetDurationThreshold(Connection* c, double duration)
+	{
+	duration_thresh = duration ? duration : UNSET_DURATION;
+
+	// For duration thresholds, it does not matter which direction we check.
+	CheckThresholds(c, true);
+	}
+
+uint64_t ConnSize::GetByteAndPacketThreshold(bool bytes, bool is_orig) const
+	{
+	const auto& e = is_orig ? orig : resp;
+	auto t = bytes ? e.bytes_thresh : e.pkts_thresh;
+	return t == UNSET ? 0 : t;
+	}
+
+double ConnSize::GetDurationThreshold() const
+	{
+	return duration_thresh == UNSET_DURATION ? 0 : duration_thresh;
+	}
+
+void ConnSize::UpdateConnVal(RecordVal* conn_val) const
+	{
+	// Fields 1 and 2 are $orig and $resp, see Connection::ConnVal().
+	RecordVal* orig_endp = conn_val->GetField(1)->AsRecordVal();
+	RecordVal* resp_endp = conn_val->GetField(2)->AsRecordVal();
+
+	static const int pktidx = id::endpoint->FieldOffset("num_pkts");
+	static const int bytesidx = id::endpoint->FieldOffset("num_bytes_ip");
+
+	if ( pktidx < 0 )
+		reporter->InternalError("'endpoint' record missing 'num_pkts' field");
+
+	if ( bytesidx < 0 )
+		reporter->InternalError("'endpoint' record missing 'num_bytes_ip' field");
+
+	orig_endp->AssignCount(pktidx, orig.pkts);
+	orig_endp->AssignCount(bytesidx, orig.bytes);
+	resp_endp->AssignCount(pktidx, resp.pkts);
+	resp_endp->AssignCount(bytesidx, resp.bytes);
+	}
+
+void ConnSize::FlipRoles()
+	{
+	std::swap(orig.pkts, resp.pkts);
+	std::swap(orig.bytes, resp.bytes);
+	}
+
+} // namespace detail
+
 } // namespace zeek
@@ -4,18 +4,22 @@
 
 #include <sys/types.h>
 
+#include <limits>
 #include <string>
 #include <tuple>
 #include <type_traits>
+#include <vector>
 
 #include "Dict.h"
 #include "Timer.h"
 #include "Rule.h"
 #include "IPAddr.h"
+#include "MemoryTag.h"
 #include "UID.h"
 #include "WeirdState.h"
 #include "ZeekArgs.h"
 #include "IntrusivePtr.h"
+#include "RunState.h"
 #include "iosource/Packet.h"
 
 #include "analyzer/Tag.h"
@@ -23,6 +27,7 @@
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Connection, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(ConnectionTimer, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(ConnectionSlotTimer, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(NetSessions, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(EncapsulationStack, zeek);
 
@@ -31,12 +36,14 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(RuleEndpointState, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(RuleHdrTest, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(RecordVal, zeek);
+ZEEK_FORWARD_DECLARE_NAMESPACED(StringVal, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(TransportLayerAnalyzer, zeek, analyzer);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Analyzer, zeek, analyzer);
 
 namespace zeek {
 using ValPtr = IntrusivePtr<Val>;
 using RecordValPtr = IntrusivePtr<RecordVal>;
+using StringValPtr = IntrusivePtr<StringVal>;
 
 enum ConnEventToFlag {
 	NUL_IN_LINE,
@@ -55,13 +62,98 @@ struct ConnID {
 	bool is_one_way;	// if true, don't canonicalize order
 };
 
+namespace detail {
+
+/**
+ * The packet and IP-level byte counts of a connection's endpoints, along
+ * with the thresholds for raising the conn_*_threshold_crossed events.
+ * Connections keep these while the ConnSize analyzer is enabled. The
+ * transport-layer analyzers count the packets they pass on to their
+ * children, which saves an analyzer of its own on every connection.
+ */
+class ConnSize {
+public:
+	/**
+	 * Starts counting.
+	 *
+	 * @param start_time The connection's start, for the duration
+	 * threshold.
+	 */
+	void Enable(double start_time);
+
+	bool Enabled() const	{ return enabled; }
+
+	/**
+	 * Counts a packet, raising the events of all thresholds it crosses.
+	 */
+	void CountPacket(Connection* c, bool is_orig, uint64_t ip_len)
+		{
+		auto& e = is_orig ? orig : resp;
+		++e.pkts;
+		e.bytes += ip_len;
+
+		// Unset thresholds are out of reach, so this is all it takes
+		// for the common case.
+		if ( e.pkts >= e.pkts_thresh || e.bytes >= e.bytes_thresh ||
+		     run_state::network_time - start_time > duration_thresh )
+			CheckThresholds(c, is_orig);
+		}
+
+	/**
+	 * Sets a threshold, 0 to unset it. Raises its event right away if
+	 * the threshold has been crossed already.
+	 */
+	void SetByteAndPacketThreshold(Connection* c, uint64_t threshold, bool bytes,
+	                               bool is_orig);
+	void SetDurationThreshold(Connection* c, double duration);
+
+	/**
+	 * Returns a threshold, or 0 if it's not set.
+	 */
+	uint64_t GetByteAndPacketThreshold(bool bytes, bool is_orig) const;
+	double GetDurationThreshold() const;
+
+	/**
+	 * Fills in the endpoint records' packet and byte counts.
+	 */
+	void UpdateConnVal(RecordVal* conn_val) const;
+
+	/**
+	 * Swaps the endpoints' counts. Thresholds keep their direction.
+	 */
+	void FlipRoles();
+
+private:
+	static constexpr uint64_t UNSET = std::numeric_limits<uint64_t>::max();
+	static constexpr double UNSET_DURATION = std::numeric_limits<double>::infinity();
+
+	void CheckThresholds(Connection* c, bool is_orig);
+	void ThresholdEvent(Connection* c, EventHandlerPtr f, uint64_t threshold, bool is_orig);
+
+	struct Endpoint {
+		uint64_t pkts = 0;
+		uint64_t bytes = 0;
+		uint64_t pkts_thresh = UNSET;
+		uint64_t bytes_thresh = UNSET;
+	};
+
+	Endpoint orig;
+	Endpoint resp;
+	double start_time = 0;
+	double duration_thresh = UNSET_DURATION;
+	bool enabled = false;
+};
+
+} // namespace detail
+
 static inline int addr_port_canon_lt(const IPAddr& addr1, uint32_t p1,
                                      const IPAddr& addr2, uint32_t p2)
 	{
 	return addr1 < addr2 || (addr1 == addr2 && p1 < p2);
 	}
 
-class Connection final : public Obj {
+class Connection final : public Obj,
+                         public detail::MemoryTagged<detail::MemoryTag::Connections> {
 public:
 
 	[[deprecated("Remove in v4.1. Store encapsulation in the packet and use the other version of the constructor instead.")]]
@@ -120,6 +212,31 @@ public:
 
 	void FlipRoles();
 
+	/**
+	 * Returns the connection's packet and byte counts, or null if the
+	 * ConnSize analyzer wasn't enabled when the connection started.
+	 */
+	detail::ConnSize* GetConnSize()
+		{ return conn_size.Enabled() ? &conn_size : nullptr; }
+
+	/**
+	 * Starts counting packets and bytes, see GetConnSize().
+	 */
+	void EnableConnSize()	{ conn_size.Enable(start_time); }
+
+	/**
+	 * Counts a packet passed on by the transport-layer analyzer.
+	 *
+	 * @param is_orig True if the packet came from the originator.
+	 *
+	 * @param ip_len The packet's total IP length.
+	 */
+	void CountPacket(bool is_orig, uint64_t ip_len)
+		{
+		if ( conn_size.Enabled() )
+			conn_size.CountPacket(this, is_orig, ip_len);
+		}
+
 	analyzer::Analyzer* FindAnalyzer(analyzer::ID id);
 	analyzer::Analyzer* FindAnalyzer(const analyzer::Tag& tag);	// find first in tree.
 	analyzer::Analyzer* FindAnalyzer(const char* name);	// find first in tree.
@@ -166,6 +283,15 @@ public:
 	// Activate connection_status_update timer.
 	void EnableStatusUpdateTimer();
 
+	// Activate the timer compacting the connection once it has been
+	// idle for connection_compaction_interval.
+	void EnableCompactionTimer();
+
+	// Releases the state that the connection's analyzers can do without
+	// until further activity, provided they can all resume afterwards.
+	// Returns true if the connection got compacted.
+	bool Compact();
+
 	[[deprecated("Remove in v4.1.  Use ConnVal() instead.")]]
 	RecordVal* BuildConnVal();
 
@@ -236,7 +362,7 @@ public:
 		std::is_convertible_v<
 			std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	EnqueueEvent(EventHandlerPtr h, analyzer::Analyzer* analyzer, Args&&... args)
-		{ return EnqueueEvent(h, analyzer, zeek::Args{std::forward<Args>(args)...}); }
+		{ return EnqueueEvent(h, analyzer, zeek::make_args(std::forward<Args>(args)...)); }
 
 	void Weird(const char* name, const char* addl = "");
 	bool DidWeird() const	{ return weird != 0; }
@@ -306,10 +432,17 @@ public:
 	// Sets the transport protocol in use.
 	void SetTransport(TransportProto arg_proto)	{ proto = arg_proto; }
 
-	void SetUID(const UID &arg_uid)	 { uid = arg_uid; }
+	void SetUID(const UID &arg_uid);
 
 	UID GetUID() const { return uid; }
 
+	/**
+	 * Returns the connection's UID as a "C"-prefixed string, generating
+	 * the UID first if it isn't set yet. The string gets formatted only
+	 * once.
+	 */
+	const StringValPtr& UIDVal();
+
 	std::shared_ptr<EncapsulationStack> GetEncapsulation() const
 		{ return encapsulation; }
 
@@ -318,9 +451,22 @@ public:
 	uint32_t GetOrigFlowLabel() { return orig_flow_label; }
 	uint32_t GetRespFlowLabel() { return resp_flow_label; }
 
-	bool PermitWeird(const char* name, uint64_t threshold, uint64_t rate,
+	bool PermitWeird(detail::WeirdID id, uint64_t threshold, uint64_t rate,
 	                 double duration);
 
+	/**
+	 * Schedules a timer belonging to the connection or one of its
+	 * analyzers. With connection_timer_coalescing, the timer stays with
+	 * the connection and only the earliest pending one is represented
+	 * in the global timer manager; otherwise it goes there directly.
+	 */
+	void ScheduleTimer(detail::Timer* timer);
+
+	/**
+	 * Cancels a timer previously passed to ScheduleTimer().
+	 */
+	void CancelTimer(detail::Timer* timer);
+
 protected:
 
 	// Add the given timer to expire at time t.  If do_expire
@@ -333,9 +479,16 @@ protected:
 
 	// Allow other classes to access pointers to these:
 	friend class detail::ConnectionTimer;
+	friend class detail::ConnectionSlotTimer;
+
+	// Dispatches the pending coalesced timers that are due by t, then
+	// re-arms the slot for the next one.
+	void DispatchSlotTimers(double t, bool is_expire);
+	void ArmSlotTimer(const detail::Timer* next);
 
 	void InactivityTimer(double t);
 	void StatusUpdateTimer(double t);
+	void CompactionTimer(double t);
 	void RemoveConnectionTimer(double t);
 
 	NetSessions* sessions;
@@ -344,6 +497,11 @@ protected:
 
 	TimerPList timers;
 
+	// Timers held back in coalescing mode, and the one timer standing
+	// in for them in the global timer manager.
+	std::vector<detail::Timer*> slot_timers;
+	detail::Timer* slot_timer;
+
 	IPAddr orig_addr;
 	IPAddr resp_addr;
 	uint32_t orig_port, resp_port;	// in network order
@@ -354,12 +512,14 @@ protected:
 	u_char resp_l2_addr[Packet::L2_ADDR_LEN];	// Link-layer responder address, if available
 	double start_time, last_time;
 	double inactivity_timeout;
+	double compacted_time = 0.0;	// last_time when last compacted
 	RecordValPtr conn_val;
 	std::shared_ptr<EncapsulationStack> encapsulation; // tunnels
 	int suppress_event;	// suppress certain events to once per conn.
 
 	unsigned int installed_status_timer:1;
 	unsigned int timers_canceled:1;
+	unsigned int coalesce_timers:1;
 	unsigned int is_active:1;
 	unsigned int skip:1;
 	unsigned int weird:1;
@@ -373,13 +533,16 @@ protected:
 	static uint64_t current_connections;
 
 	std::string history;
+	std::string::size_type conn_val_history_len = 0;	// length of history in conn_val
 	uint32_t hist_seen;
 
 	analyzer::TransportLayerAnalyzer* root_analyzer;
 	analyzer::pia::PIA* primary_PIA;
 
 	UID uid;	// Globally unique connection ID.
+	StringValPtr uid_val;	// uid's string form, if needed already.
 	detail::WeirdStateMap weird_state;
+	detail::ConnSize conn_size;
 };
 
 namespace detail {
@@ -403,6 +566,21 @@ protected:
 	bool do_expire;
 };
 
+// Represents a connection's earliest coalesced timer in the global timer
+// manager.
+class ConnectionSlotTimer final : public Timer {
+public:
+	ConnectionSlotTimer(Connection* arg_conn, double arg_t, TimerType arg_type)
+		: Timer(arg_t, arg_type), conn(arg_conn)
+		{ Ref(conn); }
+	~ConnectionSlotTimer() override;
+
+	void Dispatch(double t, bool is_expire) override;
+
+protected:
+	Connection* conn;
+};
+
 } // namespace detail
 } // namespace zeek
 
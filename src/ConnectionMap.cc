@@ -0,0 +1,349 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "ConnectionMap.h"
+
+#include "Conn.h"
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::detail {
+
+static size_t round_up_pow2(size_t n)
+	{
+	size_t p = 1;
+
+	while ( p < n )
+		p <<= 1;
+
+	return p;
+	}
+
+ConnectionMap::ConnectionMap(size_t arg_initial_buckets)
+	{
+	initial_buckets = round_up_pow2(arg_initial_buckets < 2 ? 2 : arg_initial_buckets);
+	v4.Reset(initial_buckets);
+	}
+
+ConnIDKey ConnectionMap::Expand(const Key4& k)
+	{
+	ConnIDKey key;
+	IPAddr(IPv4, &k.ip1, IPAddr::Network).CopyIPv6(&key.ip1);
+	IPAddr(IPv4, &k.ip2, IPAddr::Network).CopyIPv6(&key.ip2);
+	key.port1 = k.port1;
+	key.port2 = k.port2;
+	key.hash = k.hash;
+	return key;
+	}
+
+Connection* ConnectionMap::Insert(const ConnIDKey& key, Connection* conn)
+	{
+	if ( key.IsIPv4() )
+		return v4.Insert(Compact(key), conn, initial_buckets);
+
+	return v6.Insert(key, conn, initial_buckets);
+	}
+
+Connection* ConnectionMap::Remove(const ConnIDKey& key)
+	{
+	if ( key.IsIPv4() )
+		return v4.Remove(Compact(key));
+
+	return v6.Remove(key);
+	}
+
+void ConnectionMap::Clear()
+	{
+	v4.Reset(initial_buckets);
+	v6.Reset(0);
+	}
+
+ConnectionMap::Stats ConnectionMap::GetStats() const
+	{
+	Stats s;
+	s.entries = Size();
+	s.buckets = Buckets();
+	s.max_probe_len = 0;
+
+	size_t total = 0;
+	v4.AddStats(&total, &s.max_probe_len);
+	v6.AddStats(&total, &s.max_probe_len);
+
+	s.avg_probe_len = s.entries ? double(total) / s.entries : 0.0;
+	return s;
+	}
+
+void ConnectionMap::const_iterator::SkipEmpty()
+	{
+	auto n4 = map->v4.Buckets();
+	auto n = n4 + map->v6.Buckets();
+
+	for ( ; pos < n4; ++pos )
+		{
+		const auto& e = map->v4.buckets[pos];
+
+		if ( e.conn )
+			{
+			current.key = Expand(e.key);
+			current.conn = e.conn;
+			return;
+			}
+		}
+
+	for ( ; pos < n; ++pos )
+		{
+		const auto& e = map->v6.buckets[pos - n4];
+
+		if ( e.conn )
+			{
+			current = e;
+			return;
+			}
+		}
+	}
+
+template<typename E, typename K>
+Connection* ConnectionMap::Table<E, K>::Insert(const K& key, Connection* conn, size_t initial_buckets)
+	{
+	if ( ! buckets )
+		Reset(initial_buckets);
+
+	else if ( NeedsResize() )
+		Resize(Buckets() * 2);
+
+	size_t i = key.hash & mask;
+
+	for ( ; buckets[i].conn; i = (i + 1) & mask )
+		{
+		if ( buckets[i].key.hash == key.hash && buckets[i].key == key )
+			{
+			Connection* old = buckets[i].conn;
+			buckets[i].key = key;
+			buckets[i].conn = conn;
+			return old;
+			}
+		}
+
+	buckets[i].key = key;
+	buckets[i].conn = conn;
+	++num_entries;
+	return nullptr;
+	}
+
+template<typename E, typename K>
+Connection* ConnectionMap::Table<E, K>::Remove(const K& key)
+	{
+	if ( ! buckets )
+		return nullptr;
+
+	size_t i = key.hash & mask;
+
+	for ( ; buckets[i].conn; i = (i + 1) & mask )
+		{
+		if ( buckets[i].key.hash == key.hash && buckets[i].key == key )
+			break;
+		}
+
+	Connection* old = buckets[i].conn;
+
+	if ( ! old )
+		return nullptr;
+
+	// Shift later entries of the same probe sequence back into the
+	// hole, so that lookups never stop early at an empty bucket.
+	for ( size_t j = (i + 1) & mask; buckets[j].conn; j = (j + 1) & mask )
+		{
+		if ( ProbeDistance(j) >= ((j - i) & mask) )
+			{
+			buckets[i] = buckets[j];
+			i = j;
+			}
+		}
+
+	buckets[i] = E{};
+	--num_entries;
+	return old;
+	}
+
+template<typename E, typename K>
+void ConnectionMap::Table<E, K>::Reset(size_t n)
+	{
+	buckets = n ? std::make_unique<E[]>(n) : nullptr;
+	mask = n ? n - 1 : 0;
+	num_entries = 0;
+	}
+
+template<typename E, typename K>
+void ConnectionMap::Table<E, K>::Resize(size_t new_buckets)
+	{
+	auto old_buckets = std::move(buckets);
+	size_t old_n = mask + 1;
+
+	buckets = std::make_unique<E[]>(new_buckets);
+	mask = new_buckets - 1;
+
+	for ( size_t i = 0; i < old_n; ++i )
+		{
+		if ( ! old_buckets[i].conn )
+			continue;
+
+		size_t j = old_buckets[i].key.hash & mask;
+
+		while ( buckets[j].conn )
+			j = (j + 1) & mask;
+
+		buckets[j] = old_buckets[i];
+		}
+	}
+
+template<typename E, typename K>
+void ConnectionMap::Table<E, K>::AddStats(size_t* total, size_t* max) const
+	{
+	for ( size_t i = 0; i < Buckets(); ++i )
+		{
+		if ( ! buckets[i].conn )
+			continue;
+
+		size_t len = ProbeDistance(i) + 1;
+		*total += len;
+
+		if ( len > *max )
+			*max = len;
+		}
+	}
+
+} // namespace zeek::detail
+
+TEST_SUITE_BEGIN("ConnectionMap");
+
+using zeek::detail::ConnectionMap;
+using zeek::detail::ConnIDKey;
+
+static ConnIDKey test_key(uint16_t port, uint32_t hash)
+	{
+	ConnIDKey key;
+	key.port1 = port;
+	key.hash = hash;
+	return key;
+	}
+
+static zeek::Connection* test_conn(uintptr_t n)
+	{
+	return reinterpret_cast<zeek::Connection*>(n);
+	}
+
+TEST_CASE("connection map operation")
+	{
+	ConnectionMap m(4);
+	CHECK(m.Size() == 0);
+	CHECK(m.Buckets() == 4);
+
+	auto k1 = test_key(1, 1);
+	auto k2 = test_key(2, 2);
+
+	CHECK(m.Insert(k1, test_conn(1)) == nullptr);
+	CHECK(m.Insert(k2, test_conn(2)) == nullptr);
+	CHECK(m.Size() == 2);
+	CHECK(m.Lookup(k1) == test_conn(1));
+	CHECK(m.Lookup(k2) == test_conn(2));
+	CHECK(m.Lookup(test_key(3, 3)) == nullptr);
+
+	CHECK(m.Insert(k1, test_conn(10)) == test_conn(1));
+	CHECK(m.Size() == 2);
+	CHECK(m.Lookup(k1) == test_conn(10));
+
+	CHECK(m.Remove(k1) == test_conn(10));
+	CHECK(m.Remove(k1) == nullptr);
+	CHECK(m.Size() == 1);
+	CHECK(m.Lookup(k1) == nullptr);
+
+	m.Clear();
+	CHECK(m.Size() == 0);
+	CHECK(m.Lookup(k2) == nullptr);
+	}
+
+TEST_CASE("connection map collisions")
+	{
+	ConnectionMap m(8);
+
+	// All with the same hash, so they share one probe sequence.
+	for ( uint16_t i = 1; i <= 5; ++i )
+		m.Insert(test_key(i, 7), test_conn(i));
+
+	auto s = m.GetStats();
+	CHECK(s.entries == 5);
+	CHECK(s.max_probe_len == 5);
+
+	// Removing from the middle must keep the rest reachable.
+	CHECK(m.Remove(test_key(2, 7)) == test_conn(2));
+
+	for ( uint16_t i = 1; i <= 5; ++i )
+		CHECK(m.Lookup(test_key(i, 7)) == (i == 2 ? nullptr : test_conn(i)));
+
+	CHECK(m.GetStats().max_probe_len == 4);
+	}
+
+TEST_CASE("connection map growth")
+	{
+	ConnectionMap m(2);
+
+	for ( uint16_t i = 1; i <= 100; ++i )
+		m.Insert(test_key(i, i * 2654435761u), test_conn(i));
+
+	CHECK(m.Size() == 100);
+	CHECK(m.Buckets() >= 128);
+
+	size_t n = 0;
+
+	for ( const auto& entry : m )
+		{
+		CHECK(m.Lookup(entry.key) == entry.conn);
+		++n;
+		}
+
+	CHECK(n == 100);
+	}
+
+TEST_CASE("connection map ipv4")
+	{
+	ConnectionMap m(4);
+
+	zeek::ConnID id;
+	id.src_addr = zeek::IPAddr("10.0.0.1");
+	id.dst_addr = zeek::IPAddr("10.0.0.2");
+	id.src_port = htons(1234);
+	id.dst_port = htons(80);
+	id.is_one_way = false;
+
+	auto k4 = zeek::detail::BuildConnIDKey(id);
+	CHECK(k4.IsIPv4());
+
+	id.src_addr = zeek::IPAddr("2001:db8::1");
+	id.dst_addr = zeek::IPAddr("2001:db8::2");
+	auto k6 = zeek::detail::BuildConnIDKey(id);
+	CHECK(! k6.IsIPv4());
+
+	auto before = m.MemoryAllocation();
+	CHECK(m.Insert(k4, test_conn(4)) == nullptr);
+	CHECK(m.MemoryAllocation() == before);
+	CHECK(m.Insert(k6, test_conn(6)) == nullptr);
+	CHECK(m.Size() == 2);
+	CHECK(m.Lookup(k4) == test_conn(4));
+	CHECK(m.Lookup(k6) == test_conn(6));
+
+	// Iteration restores the full keys.
+	size_t n = 0;
+
+	for ( const auto& entry : m )
+		{
+		CHECK((entry.key == k4 || entry.key == k6));
+		CHECK(m.Lookup(entry.key) == entry.conn);
+		++n;
+		}
+
+	CHECK(n == 2);
+	CHECK(m.Remove(k4) == test_conn(4));
+	CHECK(m.Lookup(k4) == nullptr);
+	CHECK(m.Lookup(k6) == test_conn(6));
+	}
+
+TEST_SUITE_END();
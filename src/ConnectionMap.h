@@ -0,0 +1,227 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "IPAddr.h"
+
+ZEEK_FORWARD_DECLARE_NAMESPACED(Connection, zeek);
+
+namespace zeek::detail {
+
+/**
+ * An open-addressing hash table mapping connection keys to connections.
+ * It uses linear probing over a power-of-two number of buckets, with
+ * backward-shift deletion so that no tombstones accumulate. The hash
+ * value is computed once when building the \a ConnIDKey and stored
+ * inside it, so neither lookups nor rehashing need to recompute it.
+ *
+ * Connections between IPv4 addresses, the vast majority usually, are
+ * kept in a separate table storing their keys in a compact form, with
+ * buckets half the size of those for IPv6 connections.
+ *
+ * Iteration order is unspecified.
+ */
+class ConnectionMap {
+public:
+	struct Entry {
+		ConnIDKey key;
+		Connection* conn = nullptr;	// Null for an empty bucket.
+	};
+
+	/**
+	 * Statistics about the table's layout.
+	 */
+	struct Stats {
+		size_t entries;
+		size_t buckets;
+		size_t max_probe_len;	// Longest probe sequence needed for a lookup.
+		double avg_probe_len;	// Average number of buckets examined per lookup.
+	};
+
+	class const_iterator {
+	public:
+		const_iterator(const ConnectionMap* arg_map, size_t arg_pos)
+			: map(arg_map), pos(arg_pos)
+			{ SkipEmpty(); }
+
+		const Entry& operator*() const	{ return current; }
+		const Entry* operator->() const	{ return &current; }
+
+		const_iterator& operator++()
+			{
+			++pos;
+			SkipEmpty();
+			return *this;
+			}
+
+		bool operator==(const const_iterator& other) const	{ return pos == other.pos; }
+		bool operator!=(const const_iterator& other) const	{ return pos != other.pos; }
+
+	private:
+		// Moves to the next non-empty bucket, going through the IPv4
+		// buckets first, and loads its entry into current.
+		void SkipEmpty();
+
+		const ConnectionMap* map;
+		size_t pos;
+		Entry current;
+	};
+
+	/**
+	 * Constructor.
+	 *
+	 * @param initial_buckets The initial number of buckets, rounded up to
+	 * the next power of two.
+	 */
+	explicit ConnectionMap(size_t initial_buckets = 256);
+
+	ConnectionMap(const ConnectionMap&) = delete;
+	ConnectionMap& operator=(const ConnectionMap&) = delete;
+
+	/**
+	 * Returns the connection stored for the given key, or null if none.
+	 */
+	Connection* Lookup(const ConnIDKey& key) const
+		{
+		if ( key.IsIPv4() )
+			return v4.Lookup(Compact(key));
+
+		return v6.Lookup(key);
+		}
+
+	/**
+	 * Prefetches the home bucket of a key into the cache ahead of a
+	 * lookup.
+	 */
+	void Prefetch(const ConnIDKey& key) const
+		{
+		if ( key.IsIPv4() )
+			__builtin_prefetch(&v4.buckets[key.hash & v4.mask]);
+
+		else if ( v6.buckets )
+			__builtin_prefetch(&v6.buckets[key.hash & v6.mask]);
+		}
+
+	/**
+	 * Stores a connection for a key. If there's already a connection for
+	 * the key, it gets replaced.
+	 *
+	 * @return The connection previously stored for the key, or null.
+	 */
+	Connection* Insert(const ConnIDKey& key, Connection* conn);
+
+	/**
+	 * Removes the entry for a key.
+	 *
+	 * @return The connection that was stored for the key, or null if
+	 * there was none.
+	 */
+	Connection* Remove(const ConnIDKey& key);
+
+	/**
+	 * Removes all entries and shrinks the table back to its initial
+	 * size. Doesn't touch the connections themselves.
+	 */
+	void Clear();
+
+	size_t Size() const	{ return v4.num_entries + v6.num_entries; }
+	size_t Buckets() const	{ return v4.Buckets() + v6.Buckets(); }
+
+	/**
+	 * Returns the number of bytes allocated for the buckets.
+	 */
+	size_t MemoryAllocation() const
+		{ return v4.Buckets() * sizeof(Entry4) + v6.Buckets() * sizeof(Entry); }
+
+	/**
+	 * Computes layout statistics. This walks the whole table.
+	 */
+	Stats GetStats() const;
+
+	const_iterator begin() const	{ return {this, 0}; }
+	const_iterator end() const	{ return {this, Buckets()}; }
+
+private:
+	// The compact form of the key of a connection between IPv4
+	// addresses.
+	struct Key4 {
+		uint32_t ip1;	// Network order.
+		uint32_t ip2;
+		uint16_t port1;
+		uint16_t port2;
+		uint32_t hash;
+
+		bool operator==(const Key4& rhs) const
+			{
+			return ip1 == rhs.ip1 && ip2 == rhs.ip2 &&
+			       port1 == rhs.port1 && port2 == rhs.port2;
+			}
+	};
+
+	struct Entry4 {
+		Key4 key;
+		Connection* conn = nullptr;
+	};
+
+	static Key4 Compact(const ConnIDKey& key)
+		{
+		Key4 k;
+		memcpy(&k.ip1, &key.ip1.s6_addr[12], sizeof(k.ip1));
+		memcpy(&k.ip2, &key.ip2.s6_addr[12], sizeof(k.ip2));
+		k.port1 = key.port1;
+		k.port2 = key.port2;
+		k.hash = key.hash;
+		return k;
+		}
+
+	static ConnIDKey Expand(const Key4& key);
+
+	// One table of buckets of entry type E, holding keys of type K.
+	template<typename E, typename K>
+	struct Table {
+		std::unique_ptr<E[]> buckets;	// Null until first needed.
+		size_t mask = 0;
+		size_t num_entries = 0;
+
+		size_t Buckets() const	{ return buckets ? mask + 1 : 0; }
+
+		Connection* Lookup(const K& key) const
+			{
+			if ( ! buckets )
+				return nullptr;
+
+			for ( size_t i = key.hash & mask; buckets[i].conn; i = (i + 1) & mask )
+				{
+				if ( buckets[i].key.hash == key.hash && buckets[i].key == key )
+					return buckets[i].conn;
+				}
+
+			return nullptr;
+			}
+
+		Connection* Insert(const K& key, Connection* conn, size_t initial_buckets);
+		Connection* Remove(const K& key);
+		void Reset(size_t n);
+		void Resize(size_t new_buckets);
+		void AddStats(size_t* total, size_t* max) const;
+
+		// Grow once more than 3/4 of the buckets are in use.
+		bool NeedsResize() const	{ return (num_entries + 1) * 4 > Buckets() * 3; }
+
+		// Distance of the entry in bucket i from its home bucket.
+		size_t ProbeDistance(size_t i) const	{ return (i - (buckets[i].key.hash & mask)) & mask; }
+	};
+
+	// IPv6 connections being rare, their table only gets allocated
+	// once needed.
+	Table<Entry4, Key4> v4;
+	Table<Entry, ConnIDKey> v6;
+	size_t initial_buckets;
+};
+
+} // namespace zeek::detail
@@ -0,0 +1,300 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ConstFold.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Debug.h"
+#include "DebugLogger.h"
+#include "Expr.h"
+#include "Func.h"
+#include "ID.h"
+#include "NetVar.h"
+#include "Reporter.h"
+#include "Scope.h"
+#include "Stmt.h"
+#include "Traverse.h"
+#include "Val.h"
+
+namespace zeek::detail {
+
+namespace {
+
+// Whether we fold expressions yielding the given type. Aggregates may
+// change at run time even if held by a constant.
+bool is_foldable_type(const TypePtr& t)
+	{
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+	case TYPE_PORT:
+	case TYPE_ENUM:
+	case TYPE_ADDR:
+	case TYPE_SUBNET:
+	case TYPE_STRING:
+		return true;
+	default:
+		return false;
+	}
+	}
+
+class ConstantFolder : public TraversalCallback {
+public:
+	TraversalCode PostExpr(const Expr* e) override
+		{
+		switch ( e->Tag() ) {
+		case EXPR_NOT:
+		case EXPR_COMPLEMENT:
+		case EXPR_POSITIVE:
+		case EXPR_NEGATE:
+			{
+			auto u = const_cast<UnaryExpr*>(static_cast<const UnaryExpr*>(e));
+
+			if ( auto c = MakeConst(u->Op()) )
+				u->SetOp(std::move(c));
+
+			if ( u->Op()->Tag() == EXPR_CONST )
+				Fold(e);
+
+			break;
+			}
+
+		case EXPR_ADD:
+		case EXPR_SUB:
+		case EXPR_TIMES:
+		case EXPR_DIVIDE:
+		case EXPR_MOD:
+		case EXPR_AND:
+		case EXPR_OR:
+		case EXPR_XOR:
+		case EXPR_AND_AND:
+		case EXPR_OR_OR:
+		case EXPR_LT:
+		case EXPR_LE:
+		case EXPR_EQ:
+		case EXPR_NE:
+		case EXPR_GE:
+		case EXPR_GT:
+			{
+			auto b = const_cast<BinaryExpr*>(static_cast<const BinaryExpr*>(e));
+
+			if ( auto c = MakeConst(b->Op1()) )
+				b->SetOp1(std::move(c));
+
+			if ( auto c = MakeConst(b->Op2()) )
+				b->SetOp2(std::move(c));
+
+			if ( b->Op1()->Tag() == EXPR_CONST && b->Op2()->Tag() == EXPR_CONST )
+				Fold(e);
+			else if ( b->Op1()->Tag() == EXPR_CONST )
+				FoldShortCircuit(b);
+
+			break;
+			}
+
+		default:
+			break;
+		}
+
+		return TC_CONTINUE;
+		}
+
+	TraversalCode PostStmt(const Stmt* s) override
+		{
+		if ( s->Tag() == STMT_LIST || s->Tag() == STMT_EVENT_BODY_LIST )
+			PruneBranches(const_cast<StmtList*>(static_cast<const StmtList*>(s)));
+
+		return TC_CONTINUE;
+		}
+
+	int num_folded = 0;	// Expressions replaced by constants.
+	int num_pruned = 0;	// If-statements replaced by one branch.
+
+private:
+	// Returns the constant value of an expression, or null if it's not
+	// known to be constant.
+	ValPtr ConstValue(const Expr* e) const
+		{
+		if ( e->IsError() || ! is_foldable_type(e->GetType()) )
+			return nullptr;
+
+		if ( e->Tag() == EXPR_CONST )
+			return {NewRef{}, static_cast<const ConstExpr*>(e)->Value()};
+
+		if ( e->Tag() == EXPR_NAME )
+			{
+			auto id = static_cast<const NameExpr*>(e)->Id();
+
+			// Options may change through the config framework.
+			if ( id->IsGlobal() && id->IsConst() && ! id->IsOption() && id->HasVal() )
+				return id->GetVal();
+
+			return nullptr;
+			}
+
+		if ( auto it = folded.find(e); it != folded.end() )
+			return it->second;
+
+		return nullptr;
+		}
+
+	// Returns a constant expression to replace the given operand with,
+	// or null if there's nothing to replace.
+	ExprPtr MakeConst(const Expr* e)
+		{
+		if ( e->Tag() == EXPR_CONST )
+			return nullptr;
+
+		auto v = ConstValue(e);
+
+		if ( ! v )
+			return nullptr;
+
+		auto c = make_intrusive<ConstExpr>(std::move(v));
+		c->SetLocationInfo(e->GetLocationInfo());
+
+		// The operand goes away with the replacement.
+		folded.erase(e);
+		++num_folded;
+
+		return c;
+		}
+
+	// Evaluates an operation on constant operands.
+	void Fold(const Expr* e)
+		{
+		if ( e->IsError() || ! is_foldable_type(e->GetType()) )
+			return;
+
+		if ( e->Tag() == EXPR_DIVIDE || e->Tag() == EXPR_MOD )
+			{
+			// Leave it to run time to report the error.
+			auto divisor = static_cast<const BinaryExpr*>(e)->Op2();
+
+			if ( static_cast<const ConstExpr*>(divisor)->Value()->IsZero() )
+				return;
+			}
+
+		try
+			{
+			if ( auto v = e->Eval(nullptr) )
+				folded[e] = std::move(v);
+			}
+		catch ( InterpreterException& )
+			{
+			}
+		}
+
+	// Folds && and || whose first operand alone decides the result.
+	void FoldShortCircuit(const BinaryExpr* e)
+		{
+		if ( e->Tag() != EXPR_AND_AND && e->Tag() != EXPR_OR_OR )
+			return;
+
+		if ( e->IsError() || e->GetType()->Tag() != TYPE_BOOL )
+			return;
+
+		auto v1 = static_cast<const ConstExpr*>(e->Op1())->Value();
+
+		if ( v1->AsBool() == (e->Tag() == EXPR_OR_OR) )
+			folded[e] = {NewRef{}, v1};
+		}
+
+	// Replaces if-statements with a constant condition by the branch
+	// they take.
+	void PruneBranches(StmtList* l)
+		{
+		auto& stmts = l->Stmts();
+
+		for ( int i = 0; i < stmts.length(); )
+			{
+			Stmt* s = stmts[i];
+
+			if ( s->Tag() != STMT_IF )
+				{
+				++i;
+				continue;
+				}
+
+			auto is = static_cast<IfStmt*>(s);
+			auto cond = ConstValue(is->StmtExpr());
+
+			if ( ! cond || cond->GetType()->Tag() != TYPE_BOOL )
+				{
+				++i;
+				continue;
+				}
+
+			bool taken = cond->AsBool();
+			Stmt* branch = const_cast<Stmt*>(taken ? is->TrueBranch() : is->FalseBranch());
+
+			auto loc = s->GetLocationInfo();
+			DBG_LOG(DBG_SCRIPTS, "pruned if-statement at %s:%d, condition is always %s",
+			        loc->filename, loc->first_line, taken ? "true" : "false");
+
+			if ( fold_report )
+				reporter->Info("removed if-statement at %s:%d, condition is always %s",
+				               loc->filename, loc->first_line, taken ? "true" : "false");
+
+			++num_pruned;
+
+			if ( branch->Tag() == STMT_NULL )
+				stmts.remove_nth(i);
+			else
+				{
+				// Checked again, as the branch may be another
+				// if-statement with a constant condition.
+				Ref(branch);
+				stmts.replace(i, branch);
+				}
+
+			Unref(s);
+			}
+		}
+
+	std::unordered_map<const Expr*, ValPtr> folded;
+};
+
+} // namespace
+
+void fold_constant_expressions()
+	{
+	// The debugger needs statements to remain where they were.
+	if ( ! fold_script_constants || g_policy_debug )
+		return;
+
+	ConstantFolder folder;
+	std::unordered_set<const Func*> seen;
+
+	for ( const auto& [name, id] : global_scope()->Vars() )
+		{
+		if ( ! id->HasVal() || id->GetType()->Tag() != TYPE_FUNC )
+			continue;
+
+		auto func = id->GetVal()->AsFunc();
+
+		if ( func->GetKind() != Func::SCRIPT_FUNC || ! seen.insert(func).second )
+			continue;
+
+		for ( const auto& body : func->GetBodies() )
+			body.stmts->Traverse(&folder);
+		}
+
+	DBG_LOG(DBG_SCRIPTS, "folded %d expressions, pruned %d if-statements",
+	        folder.num_folded, folder.num_pruned);
+
+	if ( fold_report )
+		reporter->Info("folded %d constant expression%s, removed %d if-statement%s",
+		               folder.num_folded, folder.num_folded == 1 ? "" : "s",
+		               folder.num_pruned, folder.num_pruned == 1 ? "" : "s");
+	}
+
+} // namespace zeek::detail
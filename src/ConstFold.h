@@ -0,0 +1,19 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+namespace zeek::detail {
+
+/**
+ * Folds expressions over constants throughout all script bodies, if the
+ * fold_script_constants option is set. References to global constants
+ * of atomic type get replaced by their values, unary and binary
+ * operations on constants by their results, and if-statements with a
+ * constant condition by the branch they always take.
+ *
+ * This has to run once parsing has settled all redefs. Constants updated
+ * later through Broker::publish_id keep their folded value.
+ */
+extern void fold_constant_expressions();
+
+} // namespace zeek::detail
@@ -2,10 +2,13 @@
 
 #include "zeek-config.h"
 
+#include <algorithm>
+
 #include "DFA.h"
 #include "EquivClass.h"
 #include "Desc.h"
 #include "Hash.h"
+#include "NetVar.h"
 
 namespace zeek::detail {
 
@@ -80,6 +83,7 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 	int equiv_sym = meta_ec->EquivRep(sym);
 	if ( xtions[equiv_sym] != DFA_UNCOMPUTED_STATE_PTR )
 		{
+		++machine->num_xtions;
 		AddXtion(sym, xtions[equiv_sym]);
 		return xtions[sym];
 		}
@@ -101,6 +105,12 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 		next_d = nullptr;	// Jam
 		}
 
+	// Nothing points to an evicted state anymore, so there's no use in
+	// remembering where it leads.
+	if ( evicted )
+		return next_d;
+
+	++machine->num_xtions;
 	AddXtion(equiv_sym, next_d);
 	if ( sym != equiv_sym )
 		AddXtion(sym, next_d);
@@ -108,6 +118,43 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 	return xtions[sym];
 	}
 
+void DFA_State::ComputeExits(const int* ecs, DFA_Machine* machine)
+	{
+	num_exits = EXITS_TOO_MANY;
+
+	// Transitions leaving a dropped state never lead back to it.
+	if ( evicted )
+		return;
+
+	// The transitions we compute may make the cache drop us, which
+	// mustn't free us while we're still looking.
+	Ref(this);
+
+	int n = 0;
+
+	for ( int c = 0; c < SYM_BOL; ++c )
+		{
+		if ( Xtion(ecs[c], machine) == this )
+			continue;
+
+		if ( n == MAX_EXITS )
+			{
+			n = EXITS_TOO_MANY;
+			break;
+			}
+
+		exits[n++] = c;
+		}
+
+	if ( n > 0 && n < EXITS_TOO_MANY )
+		for ( int i = n; i < MAX_EXITS; ++i )
+			exits[i] = exits[0];
+
+	num_exits = evicted ? EXITS_TOO_MANY : n;
+
+	Unref(this);
+	}
+
 void DFA_State::AppendIfNew(int sym, int_list* sym_list)
 	{
 	for ( auto value : *sym_list )
@@ -292,7 +339,7 @@ unsigned int DFA_State::Size()
 
 DFA_State_Cache::DFA_State_Cache()
 	{
-	hits = misses = 0;
+	hits = misses = num_evicted = 0;
 	}
 
 DFA_State_Cache::~DFA_State_Cache()
@@ -304,6 +351,9 @@ DFA_State_Cache::~DFA_State_Cache()
 		}
 
 	states.clear();
+
+	for ( auto s : evicted )
+		Unref(s);
 	}
 
 DFA_State* DFA_State_Cache::Lookup(const NFA_state_list& nfas, DigestStr* digest)
@@ -357,6 +407,71 @@ DFA_State* DFA_State_Cache::Insert(DFA_State* state, DigestStr digest)
 	return state;
 	}
 
+void DFA_State_Cache::Evict(int target, const DFA_State* keep1, const DFA_State* keep2)
+	{
+	// Free the states dropped last time that nobody holds anymore.
+	auto still_held = [](DFA_State* s)
+		{
+		if ( s->RefCnt() > 1 )
+			return true;
+
+		Unref(s);
+		return false;
+		};
+
+	evicted.erase(std::stable_partition(evicted.begin(), evicted.end(), still_held),
+	              evicted.end());
+
+	// A clock sweep in place of exact LRU: the first pass spares the
+	// states used since the last sweep, clearing their flag on the way;
+	// the second one drops whatever it takes to get down to target.
+	std::vector<DFA_State*> dropped;
+
+	for ( int pass = 0; pass < 2 && NumEntries() > target; ++pass )
+		{
+		for ( auto it = states.begin(); it != states.end() && NumEntries() > target; )
+			{
+			DFA_State* d = it->second;
+
+			if ( d == keep1 || d == keep2 || (pass == 0 && d->referenced) )
+				{
+				d->referenced = false;
+				++it;
+				continue;
+				}
+
+			d->evicted = true;
+			dropped.push_back(d);
+			it = states.erase(it);
+			}
+		}
+
+	if ( dropped.empty() )
+		return;
+
+	// Unlink the dropped states in both directions, so that transitions
+	// get computed again from the NFA state sets when next needed.
+	for ( auto d : dropped )
+		for ( int i = 0; i < d->num_sym; ++i )
+			d->xtions[i] = DFA_UNCOMPUTED_STATE_PTR;
+
+	for ( auto& entry : states )
+		{
+		DFA_State* d = entry.second;
+
+		for ( int i = 0; i < d->num_sym; ++i )
+			{
+			DFA_State* x = d->xtions[i];
+
+			if ( x && x != DFA_UNCOMPUTED_STATE_PTR && x->evicted )
+				d->xtions[i] = DFA_UNCOMPUTED_STATE_PTR;
+			}
+		}
+
+	num_evicted += dropped.size();
+	evicted.insert(evicted.end(), dropped.begin(), dropped.end());
+	}
+
 void DFA_State_Cache::GetStats(Stats* s)
 	{
 	s->dfa_states = 0;
@@ -366,6 +481,7 @@ void DFA_State_Cache::GetStats(Stats* s)
 	s->mem = 0;
 	s->hits = hits;
 	s->misses = misses;
+	s->evicted = num_evicted;
 
 	for ( const auto& state : states )
 		{
@@ -377,6 +493,53 @@ void DFA_State_Cache::GetStats(Stats* s)
 		}
 	}
 
+DFA_Table::DFA_Table(DFA_Machine* machine)
+	{
+	num_sym = machine->EC()->NumClasses();
+	version = machine->num_xtions;
+
+	// We hold on to the states, so that rows stay valid even if the
+	// cache drops their states in the meantime.
+	for ( const auto& entry : machine->Cache()->states )
+		{
+		DFA_State* d = entry.second;
+		d->table_row = states.size();
+		Ref(d);
+		states.push_back(d);
+		}
+
+	xtions.reserve(states.size() * num_sym);
+
+	for ( auto d : states )
+		for ( int sym = 0; sym < num_sym; ++sym )
+			{
+			DFA_State* x = d->xtions[sym];
+
+			if ( ! x )
+				xtions.push_back(JAM);
+
+			else if ( x == DFA_UNCOMPUTED_STATE_PTR ||
+			          x->table_row < 0 || states[x->table_row] != x )
+				xtions.push_back(UNCOMPUTED);
+
+			else
+				xtions.push_back((x->table_row * num_sym) << 1 | (x->accept ? 1 : 0));
+			}
+	}
+
+DFA_Table::~DFA_Table()
+	{
+	for ( auto d : states )
+		Unref(d);
+	}
+
+unsigned int DFA_Table::MemoryAllocation() const
+	{
+	return padded_sizeof(*this)
+		+ util::pad_size(xtions.capacity() * sizeof(int32_t))
+		+ util::pad_size(states.capacity() * sizeof(DFA_State*));
+	}
+
 DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec)
 	{
 	state_count = 0;
@@ -405,6 +568,7 @@ DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec)
 
 DFA_Machine::~DFA_Machine()
 	{
+	delete table;
 	delete dfa_state_cache;
 	Unref(nfa);
 	}
@@ -429,9 +593,35 @@ unsigned int DFA_Machine::MemoryAllocation() const
 	return padded_sizeof(*this)
 		+ s.mem
 		+ padded_sizeof(*start_state)
+		+ (table ? table->MemoryAllocation() : 0)
 		+ nfa->MemoryAllocation();
 	}
 
+const DFA_Table* DFA_Machine::Table()
+	{
+	if ( num_xtions != last_num_xtions )
+		{
+		last_num_xtions = num_xtions;
+		stable_runs = 0;
+		return table;
+		}
+
+	if ( stable_runs >= TABLE_AFTER_STABLE_RUNS ||
+	     ++stable_runs < TABLE_AFTER_STABLE_RUNS )
+		return table;
+
+	if ( table && table->Version() == num_xtions )
+		return table;
+
+	if ( NumStates() * ec->NumClasses() > MAX_TABLE_ENTRIES )
+		return table;
+
+	delete table;
+	table = new DFA_Table(this);
+
+	return table;
+	}
+
 bool DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set,
 				DFA_State*& d, const EquivClass* ec)
 	{
@@ -460,9 +650,19 @@ bool DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set,
 	DFA_State* ds = new DFA_State(state_count++, ec, state_set, accept);
 	d = dfa_state_cache->Insert(ds, std::move(digest));
 
+	if ( int budget = StateBudget(); budget > 0 && NumStates() > budget )
+		// Leave some room, so that we don't have to sweep again right
+		// with the next new state.
+		dfa_state_cache->Evict(budget - budget / 4, start_state, ds);
+
 	return true;
 	}
 
+int DFA_Machine::StateBudget() const
+	{
+	return state_budget >= 0 ? state_budget : dfa_state_budget;
+	}
+
 int DFA_Machine::Rep(int sym)
 	{
 	for ( int i = 0; i < NUM_SYM; ++i )
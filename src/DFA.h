@@ -5,8 +5,10 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <assert.h>
+#include <string.h>
 #include <sys/types.h> // for u_char
 
 #include "NFA.h"
@@ -16,6 +18,7 @@
 namespace zeek::detail {
 
 class DFA_State;
+class DFA_Table;
 class DFA_Machine;
 
 // Transitions to the uncomputed state indicate that we haven't yet
@@ -35,6 +38,14 @@ public:
 
 	inline DFA_State* Xtion(int sym, DFA_Machine* machine);
 
+	// Returns how many of the n bytes at p leave the machine in this
+	// state, if that's quick to tell, and zero otherwise. It is for
+	// states that only a few byte values lead out of, which then get
+	// looked for directly instead of walking the input byte by byte.
+	// ecs maps bytes to equivalence classes.
+	inline int SelfLoopSpan(const u_char* p, int n, const int* ecs,
+	                        DFA_Machine* machine);
+
 	const AcceptingSet* Accept() const	{ return accept; }
 	void SymPartition(const EquivClass* ec);
 
@@ -55,8 +66,10 @@ public:
 
 protected:
 	friend class DFA_State_Cache;
+	friend class DFA_Table;
 
 	DFA_State* ComputeXtion(int sym, DFA_Machine* machine);
+	void ComputeExits(const int* ecs, DFA_Machine* machine);
 	void AppendIfNew(int sym, int_list* sym_list);
 
 	int state_num;
@@ -69,6 +82,28 @@ protected:
 	EquivClass* meta_ec;	// which ec's make same transition
 	DFA_State* mark;
 
+	// Set whenever a transition leaves this state, cleared when the
+	// cache looks for states to evict; see DFA_State_Cache::Evict().
+	bool referenced = false;
+
+	// Whether the cache has dropped this state. Transitions leaving it
+	// get computed anew each time, rather than stored.
+	bool evicted = false;
+
+	// Byte values leading out of this state, as far as there are few of
+	// them. Worked out once the state has seen enough input.
+	static constexpr int MAX_EXITS = 3;
+	static constexpr int EXITS_UNKNOWN = -1;
+	static constexpr int EXITS_TOO_MANY = MAX_EXITS + 1;
+	static constexpr int EXITS_AFTER_VISITS = 64;
+
+	u_char exits[MAX_EXITS];
+	int num_exits = EXITS_UNKNOWN;
+	int visits = 0;
+
+	// Where the machine's table has this state, if anywhere.
+	int table_row = -1;
+
 	static unsigned int transition_counter;	// see Xtion()
 };
 
@@ -87,6 +122,12 @@ public:
 
 	int NumEntries() const	{ return states.size(); }
 
+	// Drops states until at most target remain, preferring those no
+	// transition has left since the previous call. The two given states
+	// are kept in any case. Dropped states stay valid until the next
+	// call; callers holding on to one longer need to Ref() it.
+	void Evict(int target, const DFA_State* keep1, const DFA_State* keep2);
+
 	struct Stats {
 		// Sum of all NFA states
 		unsigned int nfa_states;
@@ -96,16 +137,61 @@ public:
 		unsigned int mem;
 		unsigned int hits;
 		unsigned int misses;
+		unsigned int evicted;
 	};
 
 	void GetStats(Stats* s);
 
 private:
+	friend class DFA_Table;
+
 	int hits;	// Statistics
 	int misses;
+	int num_evicted;
 
 	// Hash indexed by NFA states (MD5s of them, actually).
 	std::map<DigestStr, DFA_State*> states;
+
+	// Dropped states, until nothing but us references them anymore.
+	std::vector<DFA_State*> evicted;
+};
+
+// A machine's states frozen into one contiguous array, for matching with
+// fewer indirections than following the states' own transitions. States
+// get renumbered into rows of transitions, one per equivalence class.
+// Transitions not computed at the time the table gets built stay out of
+// it; matching falls back to the states for those.
+class DFA_Table {
+public:
+	explicit DFA_Table(DFA_Machine* machine);
+	~DFA_Table();
+
+	DFA_Table(const DFA_Table&) = delete;
+	DFA_Table& operator=(const DFA_Table&) = delete;
+
+	// Feeds up to n bytes at p through the table, starting from state
+	// d. Stops ahead of any transition the table doesn't have, of jams
+	// and, if stop_at_accept is set, of entering an accepting state.
+	// Returns the number of bytes consumed and sets d to the state
+	// reached.
+	inline int Run(DFA_State*& d, const u_char* p, int n, const int* ecs,
+	               bool stop_at_accept) const;
+
+	// The machine's transition count at the time of building.
+	unsigned int Version() const	{ return version; }
+
+	unsigned int MemoryAllocation() const;
+
+private:
+	// Entries hold the offset of the target's row, shifted left by
+	// one, with the lowest bit set if the target accepts.
+	static constexpr int32_t JAM = -1;
+	static constexpr int32_t UNCOMPUTED = -2;
+
+	int num_sym;
+	unsigned int version;
+	std::vector<int32_t> xtions;	// row-major, one row per state
+	std::vector<DFA_State*> states;	// index is the row
 };
 
 class DFA_Machine : public Obj {
@@ -119,8 +205,19 @@ public:
 
 	DFA_State_Cache* Cache()	{ return dfa_state_cache; }
 
+	// Returns the machine's transition table, or null if there isn't
+	// one (yet). Matchers call this once per input they're given, which
+	// is what decides when to build one: after enough inputs in a row
+	// that didn't need any new transitions.
+	const DFA_Table* Table();
+
 	int Rep(int sym);
 
+	// Sets the maximum number of states to keep, with zero meaning no
+	// limit. By default, the machine follows dfa_state_budget.
+	void SetStateBudget(int budget)	{ state_budget = budget; }
+	int StateBudget() const;
+
 	void Describe(ODesc* d) const override;
 	void Dump(FILE* f);
 
@@ -129,8 +226,20 @@ public:
 protected:
 	friend class DFA_State;	// for DFA_State::ComputeXtion
 	friend class DFA_State_Cache;
+	friend class DFA_Table;
+
+	// Number of inputs without new transitions before building a table,
+	// and the largest table to build.
+	static constexpr int TABLE_AFTER_STABLE_RUNS = 64;
+	static constexpr int MAX_TABLE_ENTRIES = 1 << 20;
 
 	int state_count;
+	int state_budget = -1;
+
+	unsigned int num_xtions = 0;	// transitions computed so far
+	unsigned int last_num_xtions = 0;	// as of the previous input
+	int stable_runs = 0;
+	DFA_Table* table = nullptr;
 
 	// The state list has to be sorted according to IDs.
 	bool StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d,
@@ -146,12 +255,86 @@ protected:
 
 inline DFA_State* DFA_State::Xtion(int sym, DFA_Machine* machine)
 	{
+	referenced = true;
+
 	if ( xtions[sym] == DFA_UNCOMPUTED_STATE_PTR )
 		return ComputeXtion(sym, machine);
 	else
 		return xtions[sym];
 	}
 
+inline int DFA_State::SelfLoopSpan(const u_char* p, int n, const int* ecs,
+                                  DFA_Machine* machine)
+	{
+	if ( num_exits == EXITS_UNKNOWN )
+		{
+		if ( ++visits < EXITS_AFTER_VISITS )
+			return 0;
+
+		ComputeExits(ecs, machine);
+		}
+
+	int i;
+
+	switch ( num_exits ) {
+	case 0:
+		i = n;
+		break;
+
+	case 1:
+		{
+		auto e = static_cast<const u_char*>(memchr(p, exits[0], n));
+		i = e ? e - p : n;
+		break;
+		}
+
+	case 2:
+	case MAX_EXITS:
+		// Unused slots repeat the first exit.
+		for ( i = 0; i < n; ++i )
+			if ( p[i] == exits[0] || p[i] == exits[1] || p[i] == exits[2] )
+				break;
+		break;
+
+	default:
+		return 0;
+	}
+
+	if ( i > 0 )
+		referenced = true;
+
+	return i;
+	}
+
+inline int DFA_Table::Run(DFA_State*& d, const u_char* p, int n,
+                         const int* ecs, bool stop_at_accept) const
+	{
+	int row = d->table_row;
+
+	if ( row < 0 || row >= static_cast<int>(states.size()) || states[row] != d )
+		return 0;
+
+	const int32_t* t = xtions.data();
+	const int32_t stop = stop_at_accept ? 1 : 0;
+	int32_t cur = row * num_sym;
+	int i;
+
+	for ( i = 0; i < n; ++i )
+		{
+		int32_t next = t[cur + ecs[p[i]]];
+
+		if ( next < 0 || (next & stop) )
+			break;
+
+		cur = next >> 1;
+		}
+
+	d = states[cur / num_sym];
+	d->referenced = true;
+
+	return i;
+	}
+
 } // namespace zeek::detail
 
 using DFA_State [[deprecated("Remove in v4.1. Use zeek::detail::DFA_State.")]] = zeek::detail::DFA_State;
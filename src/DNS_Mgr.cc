@@ -71,6 +71,7 @@ public:
 	// Returns nil if this was an address request.
 	const char* ReqHost() const	{ return host; }
 	const IPAddr& ReqAddr() const		{ return addr; }
+	int ReqFamily() const	{ return fam; }
 	bool ReqIsTxt() const	{ return qtype == 16; }
 
 	int MakeRequest(nb_dns_info* nb_dns);
@@ -137,9 +138,6 @@ public:
 
 	bool Expired() const
 		{
-		if ( req_host && num_addrs == 0)
-			return false; // nothing to expire
-
 		return util::current_time() > (creation_time + req_ttl);
 		}
 
@@ -377,6 +375,10 @@ void DNS_Mapping::Save(FILE* f) const
 	}
 
 
+// The number of requests in flight at a time until scripts have set
+// dns_resolver_max_pending.
+static constexpr int MAX_PENDING_REQUESTS = 20;
+
 DNS_Mgr::DNS_Mgr(DNS_MgrMode arg_mode)
 	{
 	did_init = false;
@@ -386,6 +388,8 @@ DNS_Mgr::DNS_Mgr(DNS_MgrMode arg_mode)
 	cache_name = dir = nullptr;
 
 	asyncs_pending = 0;
+	max_pending = MAX_PENDING_REQUESTS;
+	negative_ttl = 0;
 	num_requests = 0;
 	successful = 0;
 	failed = 0;
@@ -453,6 +457,8 @@ void DNS_Mgr::InitSource()
 void DNS_Mgr::InitPostScript()
 	{
 	dm_rec = id::find_type<RecordType>("dns_mapping");
+	max_pending = std::max(id::find_val("dns_resolver_max_pending")->AsCount(), bro_uint_t(1));
+	negative_ttl = id::find_val("dns_resolver_negative_ttl")->AsInterval();
 
 	// Registering will call Init()
 	iosource_mgr->Register(this, true);
@@ -592,8 +598,6 @@ void DNS_Mgr::Verify()
 	{
 	}
 
-#define MAX_PENDING_REQUESTS 20
-
 void DNS_Mgr::Resolve()
 	{
 	if ( ! nb_dns )
@@ -602,7 +606,7 @@ void DNS_Mgr::Resolve()
 	int i;
 
 	int first_req = 0;
-	int num_pending = min(requests.length(), MAX_PENDING_REQUESTS);
+	int num_pending = min(requests.length(), max_pending);
 	int last_req = num_pending - 1;
 
 	// Prime with the initial requests.
@@ -631,7 +635,7 @@ void DNS_Mgr::Resolve()
 
 			first_req = last_req + 1;
 			num_pending = min(requests.length() - first_req,
-						MAX_PENDING_REQUESTS);
+						max_pending);
 			last_req = first_req + num_pending - 1;
 
 			for ( i = first_req; i <= last_req; ++i )
@@ -677,7 +681,10 @@ bool DNS_Mgr::Save()
 	if ( ! cache_name )
 		return false;
 
-	FILE* f = fopen(cache_name, "w");
+	// Write to a temporary file first so that readers never see a
+	// partial cache.
+	std::string tmp_name = std::string(cache_name) + ".tmp";
+	FILE* f = fopen(tmp_name.c_str(), "w");
 
 	if ( ! f )
 		return false;
@@ -686,7 +693,11 @@ bool DNS_Mgr::Save()
 	Save(f, addr_mappings);
 	// Save(f, text_mappings); // We don't save the TXT mappings (yet?).
 
-	fclose(f);
+	if ( fclose(f) != 0 || rename(tmp_name.c_str(), cache_name) != 0 )
+		{
+		unlink(tmp_name.c_str());
+		return false;
+		}
 
 	return true;
 	}
@@ -737,6 +748,11 @@ void DNS_Mgr::AddResult(DNS_Mgr_Request* dr, struct nb_dns_result* r)
 	struct hostent* h = (r && r->host_errno == 0) ? r->hostent : nullptr;
 	u_int32_t ttl = (r && r->host_errno == 0) ? r->ttl : 0;
 
+	// Failures and names without addresses of the requested type get
+	// cached for the negative TTL.
+	if ( ! h || (dr->ReqHost() && ! dr->ReqIsTxt() && ! h->h_addr_list[0]) )
+		ttl = negative_ttl;
+
 	DNS_Mapping* new_dm;
 	DNS_Mapping* prev_dm;
 	int keep_prev = 0;
@@ -746,6 +762,10 @@ void DNS_Mgr::AddResult(DNS_Mgr_Request* dr, struct nb_dns_result* r)
 		new_dm = new DNS_Mapping(dr->ReqHost(), h, ttl);
 		prev_dm = nullptr;
 
+		// Keep failures apart by the address family asked for.
+		if ( ! h )
+			new_dm->map_type = dr->ReqFamily();
+
 		if ( dr->ReqIsTxt() )
 			{
 			TextMap::iterator it = text_mappings.find(dr->ReqHost());
@@ -977,6 +997,9 @@ const char* DNS_Mgr::LookupAddrInCache(const IPAddr& addr)
 		return nullptr;
 		}
 
+	if ( d->Failed() )
+		return nullptr;
+
 	// The escapes in the following strings are to avoid having it
 	// interpreted as a trigraph sequence.
 	return d->names ? d->names[0] : "<\?\?\?>";
@@ -1026,11 +1049,59 @@ const char* DNS_Mgr::LookupTextInCache(const string& name)
 		return nullptr;
 		}
 
+	if ( d->Failed() )
+		return nullptr;
+
 	// The escapes in the following strings are to avoid having it
 	// interpreted as a trigraph sequence.
 	return d->names ? d->names[0] : "<\?\?\?>";
 	}
 
+bool DNS_Mgr::AddrLookupFailed(const IPAddr& addr)
+	{
+	auto it = addr_mappings.find(addr);
+	return it != addr_mappings.end() && it->second->Failed() && ! it->second->Expired();
+	}
+
+bool DNS_Mgr::NameLookupFailed(const string& name)
+	{
+	// A lookup in progress may have some of its answers already.
+	if ( asyncs_names.find(name) != asyncs_names.end() )
+		return false;
+
+	auto it = host_mappings.find(name);
+
+	if ( it == host_mappings.end() )
+		return false;
+
+	DNS_Mapping* d4 = it->second.first;
+	DNS_Mapping* d6 = it->second.second;
+
+	// One family resolving is good enough.
+	if ( d4 && d4->Failed() && ! d4->Expired() &&
+	     d6 && d6->Failed() && ! d6->Expired() )
+		return true;
+
+	// The name gets looked up again. Don't leave a partial result
+	// around, as Process() takes it for the first of the two answers.
+	host_mappings.erase(it);
+	delete d4;
+	delete d6;
+	return false;
+	}
+
+bool DNS_Mgr::TextLookupFailed(const string& name)
+	{
+	auto it = text_mappings.find(name);
+	return it != text_mappings.end() && it->second->Failed() && ! it->second->Expired();
+	}
+
+static void fail_lookup_cb(DNS_Mgr::LookupCallback* callback)
+	{
+	callback->Timeout();
+	delete callback;
+	}
+
 static void resolve_lookup_cb(DNS_Mgr::LookupCallback* callback,
                               TableValPtr result)
 	{
@@ -1063,6 +1134,12 @@ void DNS_Mgr::AsyncLookupAddr(const IPAddr& host, LookupCallback* callback)
 		return;
 		}
 
+	if ( AddrLookupFailed(host) )
+		{
+		fail_lookup_cb(callback);
+		return;
+		}
+
 	AsyncRequest* req = nullptr;
 
 	// Have we already a request waiting for this host?
@@ -1101,6 +1178,12 @@ void DNS_Mgr::AsyncLookupName(const string& name, LookupCallback* callback)
 		return;
 		}
 
+	if ( NameLookupFailed(name) )
+		{
+		fail_lookup_cb(callback);
+		return;
+		}
+
 	AsyncRequest* req = nullptr;
 
 	// Have we already a request waiting for this host?
@@ -1140,6 +1223,12 @@ void DNS_Mgr::AsyncLookupNameText(const string& name, LookupCallback* callback)
 		return;
 		}
 
+	if ( TextLookupFailed(name) )
+		{
+		fail_lookup_cb(callback);
+		return;
+		}
+
 	AsyncRequest* req = nullptr;
 
 	// Have we already a request waiting for this host?
@@ -1174,7 +1263,7 @@ static bool DoRequest(nb_dns_info* nb_dns, DNS_Mgr_Request* dr)
 
 void DNS_Mgr::IssueAsyncRequests()
 	{
-	while ( asyncs_queued.size() && asyncs_pending < MAX_PENDING_REQUESTS )
+	while ( asyncs_queued.size() && asyncs_pending < max_pending )
 		{
 		AsyncRequest* req = asyncs_queued.front();
 		asyncs_queued.pop_front();
@@ -1367,9 +1456,15 @@ void DNS_Mgr::Process()
 		delete req;
 		}
 
-	if ( AnswerAvailable(0) <= 0 )
-		return;
+	// Take all answers that have come in, rather than one per main loop
+	// iteration, bounded by what can be in flight for host lookups,
+	// which take one answer per address family.
+	for ( int i = 0; i < 2 * max_pending && AnswerAvailable(0) > 0; ++i )
+		ProcessAnswer();
+	}
 
+void DNS_Mgr::ProcessAnswer()
+	{
 	char err[NB_DNS_ERRSIZE];
 	struct nb_dns_result r;
 
@@ -4,6 +4,7 @@
 
 #include <list>
 #include <map>
+#include <unordered_map>
 #include <queue>
 #include <utility>
 
@@ -117,9 +118,9 @@ protected:
 	ListValPtr AddrListDelta(ListVal* al1, ListVal* al2);
 	void DumpAddrList(FILE* f, ListVal* al);
 
-	typedef std::map<std::string, std::pair<DNS_Mapping*, DNS_Mapping*> > HostMap;
-	typedef std::map<IPAddr, DNS_Mapping*> AddrMap;
-	typedef std::map<std::string, DNS_Mapping*> TextMap;
+	typedef std::unordered_map<std::string, std::pair<DNS_Mapping*, DNS_Mapping*> > HostMap;
+	typedef std::unordered_map<IPAddr, DNS_Mapping*> AddrMap;
+	typedef std::unordered_map<std::string, DNS_Mapping*> TextMap;
 	void LoadCache(FILE* f);
 	void Save(FILE* f, const AddrMap& m);
 	void Save(FILE* f, const HostMap& m);
@@ -132,12 +133,24 @@ protected:
 	// Issue as many queued async requests as slots are available.
 	void IssueAsyncRequests();
 
+	// Return true if the most recent lookup of the address, name or TXT
+	// record failed, and that's still recent enough to not try again,
+	// see dns_resolver_negative_ttl. For names that aren't cached
+	// completely, NameLookupFailed() drops what's there, as they get
+	// looked up again.
+	bool AddrLookupFailed(const IPAddr& addr);
+	bool NameLookupFailed(const std::string& name);
+	bool TextLookupFailed(const std::string& name);
+
 	// Finish the request if we have a result.  If not, time it out if
 	// requested.
 	void CheckAsyncAddrRequest(const IPAddr& addr, bool timeout);
 	void CheckAsyncHostRequest(const char* host, bool timeout);
 	void CheckAsyncTextRequest(const char* host, bool timeout);
 
+	// Reads and handles a single answer.
+	void ProcessAnswer();
+
 	// IOSource interface.
 	void Process() override;
 	void InitSource() override;
@@ -212,13 +225,13 @@ protected:
 
 	};
 
-	typedef std::map<IPAddr, AsyncRequest*> AsyncRequestAddrMap;
+	typedef std::unordered_map<IPAddr, AsyncRequest*> AsyncRequestAddrMap;
 	AsyncRequestAddrMap asyncs_addrs;
 
-	typedef std::map<std::string, AsyncRequest*> AsyncRequestNameMap;
+	typedef std::unordered_map<std::string, AsyncRequest*> AsyncRequestNameMap;
 	AsyncRequestNameMap asyncs_names;
 
-	typedef std::map<std::string, AsyncRequest*> AsyncRequestTextMap;
+	typedef std::unordered_map<std::string, AsyncRequest*> AsyncRequestTextMap;
 	AsyncRequestTextMap asyncs_texts;
 
 	typedef std::list<AsyncRequest*> QueuedList;
@@ -236,6 +249,11 @@ protected:
 
 	int asyncs_pending;
 
+	// Script-level tuning, see dns_resolver_max_pending and
+	// dns_resolver_negative_ttl.
+	int max_pending;
+	uint32_t negative_ttl;
+
 	unsigned long num_requests;
 	unsigned long successful;
 	unsigned long failed;
@@ -8,16 +8,79 @@
 #include <errno.h>
 #include <math.h>
 
+#include <charconv>
+
 #include "File.h"
 #include "Reporter.h"
 #include "ConvertUTF.h"
 #include "IPAddr.h"
 
+#include "3rdparty/doctest.h"
+
 #define DEFAULT_SIZE 128
 #define SLOP 10
 
 namespace zeek {
 
+// Buffers of destroyed ODescs, kept per thread for the next ones to
+// start out with, so that the many short-lived descriptions for log
+// fields and string conversions don't each allocate and grow their own.
+static constexpr int BUFFER_POOL_SIZE = 8;
+static constexpr unsigned int MAX_POOLED_BUFFER_SIZE = 64 * 1024;
+
+namespace {
+
+struct BufferPool {
+	void* bufs[BUFFER_POOL_SIZE];
+	unsigned int sizes[BUFFER_POOL_SIZE];
+	int num = 0;
+
+	~BufferPool();
+};
+
+} // namespace
+
+static thread_local BufferPool buffer_pool;
+
+// Set once the thread's pool is gone, for ODescs destroyed after it.
+static thread_local bool buffer_pool_gone = false;
+
+BufferPool::~BufferPool()
+	{
+	for ( int i = 0; i < num; ++i )
+		free(bufs[i]);
+
+	num = 0;
+	buffer_pool_gone = true;
+	}
+
+static void* get_buffer(unsigned int* size)
+	{
+	if ( buffer_pool_gone || buffer_pool.num == 0 )
+		{
+		*size = DEFAULT_SIZE;
+		return util::safe_malloc(DEFAULT_SIZE);
+		}
+
+	--buffer_pool.num;
+	*size = buffer_pool.sizes[buffer_pool.num];
+	return buffer_pool.bufs[buffer_pool.num];
+	}
+
+static void release_buffer(void* buf, unsigned int size)
+	{
+	if ( buffer_pool_gone || buffer_pool.num == BUFFER_POOL_SIZE ||
+	     size > MAX_POOLED_BUFFER_SIZE )
+		{
+		free(buf);
+		return;
+		}
+
+	buffer_pool.bufs[buffer_pool.num] = buf;
+	buffer_pool.sizes[buffer_pool.num] = size;
+	++buffer_pool.num;
+	}
+
 ODesc::ODesc(DescType t, File* arg_f)
 	{
 	type = t;
@@ -26,8 +89,7 @@ ODesc::ODesc(DescType t, File* arg_f)
 
 	if ( f == nullptr )
 		{
-		size = DEFAULT_SIZE;
-		base = util::safe_malloc(size);
+		base = get_buffer(&size);
 		((char*) base)[0] = '\0';
 		offset = 0;
 		}
@@ -55,7 +117,7 @@ ODesc::~ODesc()
 			f->Flush();
 		}
 	else if ( base )
-		free(base);
+		release_buffer(base, size);
 	}
 
 void ODesc::EnableEscaping()
@@ -102,52 +164,47 @@ void ODesc::Add(const char* s, int do_indent)
 		AddBytes(s, n);
 	}
 
-void ODesc::Add(int i)
+template <typename T>
+void ODesc::AddInteger(T v)
 	{
 	if ( IsBinary() )
-		AddBytes(&i, sizeof(i));
-	else
 		{
-		char tmp[256];
-		modp_litoa10(i, tmp);
-		Add(tmp);
+		AddBytes(&v, sizeof(v));
+		return;
 		}
+
+	// Enough for the largest 64-bit values, with sign.
+	constexpr unsigned int max_len = 21;
+
+	if ( char* p = DirectSpace(max_len) )
+		{
+		CommitDirect(std::to_chars(p, p + max_len, v).ptr - p);
+		return;
+		}
+
+	char tmp[max_len + 1];
+	*std::to_chars(tmp, tmp + max_len, v).ptr = '\0';
+	Add(tmp);
+	}
+
+void ODesc::Add(int i)
+	{
+	AddInteger(i);
 	}
 
 void ODesc::Add(uint32_t u)
 	{
-	if ( IsBinary() )
-		AddBytes(&u, sizeof(u));
-	else
-		{
-		char tmp[256];
-		modp_ulitoa10(u, tmp);
-		Add(tmp);
-		}
+	AddInteger(u);
 	}
 
 void ODesc::Add(int64_t i)
 	{
-	if ( IsBinary() )
-		AddBytes(&i, sizeof(i));
-	else
-		{
-		char tmp[256];
-		modp_litoa10(i, tmp);
-		Add(tmp);
-		}
+	AddInteger(i);
 	}
 
 void ODesc::Add(uint64_t u)
 	{
-	if ( IsBinary() )
-		AddBytes(&u, sizeof(u));
-	else
-		{
-		char tmp[256];
-		modp_ulitoa10(u, tmp);
-		Add(tmp);
-		}
+	AddInteger(u);
 	}
 
 void ODesc::Add(double d, bool no_exp)
@@ -157,15 +214,17 @@ void ODesc::Add(double d, bool no_exp)
 	else
 		{
 		// Buffer needs enough chars to store max. possible "double" value
-		// of 1.79e308 without using scientific notation.
-		char tmp[350];
+		// of 1.79e308 without using scientific notation, plus the ".0"
+		// added below.
+		constexpr unsigned int max_len = 352;
+		char tmp[max_len];
+		char* direct = DirectSpace(max_len);
+		char* p = direct ? direct : tmp;
 
 		if ( no_exp )
-			modp_dtoa3(d, tmp, sizeof(tmp), IsReadable() ? 6 : 8);
+			modp_dtoa3(d, p, max_len - 2, IsReadable() ? 6 : 8);
 		else
-			modp_dtoa2(d, tmp, IsReadable() ? 6 : 8);
-
-		Add(tmp);
+			modp_dtoa2(d, p, IsReadable() ? 6 : 8);
 
 		auto approx_equal = [](double a, double b, double tolerance = 1e-6) -> bool
 			{
@@ -173,10 +232,20 @@ void ODesc::Add(double d, bool no_exp)
 			return v < 0 ? -v < tolerance : v < tolerance;
 			};
 
+		size_t n = strlen(p);
+
 		if ( approx_equal(d, nearbyint(d), 1e-9) &&
-		     isfinite(d) && ! strchr(tmp, 'e') )
+		     isfinite(d) && ! memchr(p, 'e', n) )
+			{
 			// disambiguate from integer
-			Add(".0");
+			memcpy(p + n, ".0", 3);
+			n += 2;
+			}
+
+		if ( direct )
+			CommitDirect(n);
+		else
+			Add(tmp);
 		}
 	}
 
@@ -221,19 +290,25 @@ void ODesc::AddBytes(const String* s)
 		}
 	}
 
-void ODesc::Indent()
+void ODesc::AddN(char c, unsigned int n)
 	{
-	if ( indent_with_spaces > 0 )
+	if ( char* p = DirectSpace(n) )
 		{
-		for ( int i = 0; i < indent_level; ++i )
-			for ( int j = 0; j < indent_with_spaces; ++j )
-				Add(" ", 0);
+		memset(p, c, n);
+		CommitDirect(n);
+		return;
 		}
+
+	for ( unsigned int i = 0; i < n; ++i )
+		AddBytes(&c, 1);
+	}
+
+void ODesc::Indent()
+	{
+	if ( indent_with_spaces > 0 )
+		AddN(' ', indent_level * indent_with_spaces);
 	else
-		{
-		for ( int i = 0; i < indent_level; ++i )
-			Add("\t", 0);
-		}
+		AddN('\t', indent_level);
 	}
 
 static bool starts_with(const char* str1, const char* str2, size_t len)
@@ -385,12 +460,34 @@ void ODesc::AddBytesRaw(const void* bytes, unsigned int n)
 
 void ODesc::Grow(unsigned int n)
 	{
+	if ( offset + n + SLOP < size )
+		return;
+
 	while ( offset + n + SLOP >= size )
 		size *= 2;
 
 	base = util::safe_realloc(base, size);
 	}
 
+char* ODesc::DirectSpace(unsigned int n)
+	{
+	if ( f || escape || ! base )
+		return nullptr;
+
+	if ( IsReadable() && offset > 0 && ((const char*) base)[offset - 1] == '\n' )
+		// Needs indentation first.
+		return nullptr;
+
+	Grow(n);
+	return (char*) base + offset;
+	}
+
+void ODesc::CommitDirect(unsigned int n)
+	{
+	offset += n;
+	((char*) base)[offset] = '\0';
+	}
+
 void ODesc::Clear()
 	{
 	offset = 0;
@@ -428,3 +525,30 @@ bool ODesc::FindType(const Type* type)
 	}
 
 } // namespace zeek
+
+TEST_CASE("describe numbers")
+	{
+	zeek::ODesc d;
+	d.Add(-42);
+	d.SP();
+	d.Add(uint64_t(18446744073709551615ULL));
+	d.SP();
+	d.Add(1.5);
+	d.SP();
+	d.Add(3.0);
+	d.AddN('-', 3);
+	CHECK(std::string(d.Description()) == "-42 18446744073709551615 1.5 3.0---");
+
+	// Indentation still comes first after a newline.
+	zeek::ODesc indented;
+	indented.PushIndent();
+	indented.Add(7);
+	CHECK(std::string(indented.Description()) == "\n\t7");
+
+	// Escaping still applies.
+	zeek::ODesc escaped;
+	escaped.EnableEscaping();
+	escaped.AddEscapeSequence("1");
+	escaped.Add(12);
+	CHECK(std::string(escaped.Description()) == "\\x312");
+	}
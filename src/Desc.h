@@ -82,6 +82,8 @@ public:
 
 	void Add(const char* s, int do_indent=1);
 	void AddN(const char* s, int len)	{ AddBytes(s, len); }
+	// Adds n copies of c.
+	void AddN(char c, unsigned int n);
 	void Add(const std::string& s)	{ AddBytes(s.data(), s.size()); }
 	void Add(int i);
 	void Add(uint32_t u);
@@ -162,6 +164,15 @@ protected:
 	// Make buffer big enough for n bytes beyond bufp.
 	void Grow(unsigned int n);
 
+	// Returns where up to n bytes of formatted output can go directly,
+	// or nullptr if it needs to take the regular route because of a file,
+	// escaping or pending indentation. CommitDirect() then accounts for
+	// the bytes actually written.
+	char* DirectSpace(unsigned int n);
+	void CommitDirect(unsigned int n);
+
+	template <typename T> void AddInteger(T v);
+
 	/**
 	 * Returns the location of the first place in the bytes to be hex-escaped.
 	 *
@@ -13,6 +13,7 @@
 #include <fstream>
 
 #include "Reporter.h"
+#include "LoopTrace.h"
 #include "util.h"
 
 #include "3rdparty/doctest.h"
@@ -218,6 +219,77 @@ TEST_CASE("dict iteration")
 	delete key2;
 	}
 
+TEST_CASE("dict fast hash policy")
+	{
+	PDict<uint32_t> dict(UNORDERED, 0, FAST_HASH);
+	CHECK(dict.HashPolicy() == FAST_HASH);
+
+	uint32_t val = 10;
+	uint32_t val2 = 15;
+	dict.Insert("one", &val);
+	dict.Insert("two", &val2);
+	CHECK(dict.Length() == 2);
+
+	// Regular keys work too; their keyed hash never gets computed.
+	detail::HashKey key("two");
+	CHECK(dict.Lookup(&key) == &val2);
+	CHECK(*dict.Lookup("one") == 10);
+
+	detail::HashKey* it_key;
+	IterCookie* it = dict.InitForIteration();
+	int count = 0;
+
+	while ( dict.NextEntry(it_key, it) )
+		{
+		// Handed-out keys work with keyed dictionaries again.
+		CHECK(it_key->Hash() == detail::HashKey::HashBytes(it_key->Key(), it_key->Size()));
+		delete it_key;
+		count++;
+		}
+
+	CHECK(count == 2);
+
+	CHECK(dict.RemoveEntry(key) == &val2);
+	CHECK(dict.Lookup("two") == nullptr);
+	CHECK(dict.Length() == 1);
+	}
+
+TEST_CASE("dict incremental resize")
+	{
+	PDict<uint32_t> dict;
+	std::vector<uint32_t> vals(10000);
+	std::vector<detail::HashKey*> keys;
+
+	for ( uint32_t i = 0; i < vals.size(); i++ )
+		{
+		vals[i] = i;
+		keys.push_back(new detail::HashKey(i));
+		dict.Insert(keys.back(), &vals[i]);
+		}
+
+	CHECK(dict.Length() == 10000);
+
+	// Everything has to stay reachable while remapping is spread out over
+	// later operations.
+	for ( uint32_t i = 0; i < vals.size(); i++ )
+		{
+		uint32_t* v = dict.Lookup(keys[i]);
+		REQUIRE(v);
+		CHECK(*v == i);
+		}
+
+	for ( uint32_t i = 0; i < vals.size(); i += 2 )
+		CHECK(dict.Remove(keys[i]) == &vals[i]);
+
+	CHECK(dict.Length() == 5000);
+
+	for ( uint32_t i = 0; i < vals.size(); i++ )
+		CHECK((dict.Lookup(keys[i]) != nullptr) == (i % 2 == 1));
+
+	for ( auto k : keys )
+		delete k;
+	}
+
 TEST_SUITE_END();
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -546,7 +618,8 @@ void Dictionary::Dump(int level) const
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //Initialization.
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-Dictionary::Dictionary(DictOrder ordering, int initial_size)
+Dictionary::Dictionary(DictOrder ordering, int initial_size, DictHashPolicy hash_policy)
+	: fast_hash(hash_policy == FAST_HASH)
 	{
 	if ( initial_size > 0 )
 		{
@@ -575,8 +648,11 @@ void Dictionary::Clear()
 				continue;
 			if ( delete_func )
 				delete_func(table[i].value);
+			if ( table[i].key_size > 8 )
+				detail::memory_tag_free(mem_tag, table[i].key_size);
 			table[i].Clear();
 			}
+		detail::memory_tag_free(mem_tag, Capacity() * sizeof(detail::DictEntry));
 		free(table);
 		table = nullptr;
 		}
@@ -603,6 +679,7 @@ void Dictionary::Init()
 	{
 	ASSERT(! table);
 	table = (detail::DictEntry*)malloc(sizeof(detail::DictEntry) * Capacity(true));
+	detail::memory_tag_alloc(mem_tag, sizeof(detail::DictEntry) * Capacity(true));
 	for ( int i = Capacity() - 1; i >= 0; i-- )
 		table[i].SetEmpty();
 	}
@@ -621,13 +698,13 @@ void generic_delete_func(void* v)
 // position so next lookup is fast.
 void* Dictionary::Lookup(const detail::HashKey* key) const
 	{
-	return Lookup(key->Key(), key->Size(), key->Hash());
+	return Lookup(key->Key(), key->Size(), HashOf(key));
 	}
 
 void* Dictionary::Lookup(const void* key, int key_size, detail::hash_t h) const
 	{
 	Dictionary* d = const_cast<Dictionary*>(this);
-	int position = d->LookupIndex(key, key_size, h);
+	int position = d->LookupIndex(key, key_size, PolicyHash(key, key_size, h));
 	return position >= 0 ? table[position].value : nullptr;
 	}
 
@@ -701,9 +778,22 @@ int Dictionary::LookupIndex(const void* key, int key_size, detail::hash_t hash,
 	{
 	ASSERT(bucket>=0 && bucket < Buckets());
 	int i = bucket;
-	for ( ; i < end && ! table[i].Empty() && BucketByPosition(i) <= bucket; i++ )
-		if ( BucketByPosition(i) == bucket && table[i].Equal((char*)key, key_size, hash) )
+	for ( ; i < end; i++ )
+		{
+		// Each entry is read once. Its distance and hash sit next to each
+		// other, so ruling out a slot takes a single cache line; the key is
+		// compared only when the 32-bit hashes match.
+		const detail::DictEntry& e = table[i];
+		if ( e.Empty() )
+			break;
+
+		int b = i - e.distance;
+		if ( b > bucket )
+			break;
+
+		if ( b == bucket && e.Equal((const char*)key, key_size, hash) )
 			return i;
+		}
 
 	//no such cluster, or not found in the cluster.
 	if ( insert_position )
@@ -731,6 +821,8 @@ void* Dictionary::Insert(void* key, int key_size, detail::hash_t hash, void* val
 	if ( ! table )
 		Init();
 
+	hash = PolicyHash(key, key_size, hash);
+
 	void* v = nullptr;
 	//if found. i is the position
 	//if not found, i is the insert position, d is the distance of key on position i.
@@ -766,6 +858,8 @@ void* Dictionary::Insert(void* key, int key_size, detail::hash_t hash, void* val
 		// Allocate memory for key if necesary. Key is updated to reflect internal key if necessary.
 		detail::DictEntry entry(key, key_size, hash, val, insert_distance, copy_key);
 		InsertRelocateAndAdjust(entry, insert_position);
+		if ( key_size > 8 )
+			detail::memory_tag_alloc(mem_tag, key_size);
 		if ( order )
 			order->push_back(entry);
 
@@ -777,9 +871,8 @@ void* Dictionary::Insert(void* key, int key_size, detail::hash_t hash, void* val
 			SizeUp();
 		}
 
-	// Remap after insert can adjust asap to shorten period of mixed table.
-	// TODO: however, if remap happens right after size up, then it consumes more cpu for this cycle,
-	// a possible hiccup point.
+	// Remap after insert can adjust asap to shorten period of mixed table. Each round is
+	// bounded, so even the insert right after a size up doesn't pay for much of it.
 	if ( Remapping() )
 		Remap();
 	ASSERT_VALID(this);
@@ -862,6 +955,8 @@ void Dictionary::SizeUp()
 	log2_buckets++;
 	int capacity = Capacity();
 	table = (detail::DictEntry*)realloc(table, capacity * sizeof(detail::DictEntry));
+	detail::memory_tag_free(mem_tag, prev_capacity * sizeof(detail::DictEntry));
+	detail::memory_tag_alloc(mem_tag, capacity * sizeof(detail::DictEntry));
 	for ( int i = prev_capacity; i < capacity; i++ )
 		table[i].SetEmpty();
 
@@ -874,6 +969,9 @@ void Dictionary::SizeUp()
 	//another remap starts.
 	remaps++; //used in Lookup() to cover SizeUp with incomplete remaps.
 	ASSERT(remaps <= log2_buckets);//because we only sizeUp, one direction. we know the previous log2_buckets.
+
+	if ( zeek::detail::loop_trace )
+		zeek::detail::loop_trace->Record(zeek::detail::LoopTraceType::DICT_RESIZE, capacity, num_entries);
 	}
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -886,7 +984,7 @@ void* Dictionary::Remove(const void* key, int key_size, detail::hash_t hash, boo
 	ASSERT(num_iterators == 0 || (cookies && cookies->size() == num_iterators)); //only robust iterators exist.
 	ASSERT(! dont_delete); //this is a poorly designed flag. if on, the internal has nowhere to return and memory is lost.
 
-	int position = LookupIndex(key, key_size, hash);
+	int position = LookupIndex(key, key_size, PolicyHash(key, key_size, hash));
 	if ( position < 0 )
 		return nullptr;
 
@@ -898,7 +996,16 @@ void* Dictionary::Remove(const void* key, int key_size, detail::hash_t hash, boo
 		order->erase(std::remove(order->begin(), order->end(), entry), order->end());
 
 	void* v = entry.value;
+	if ( entry.key_size > 8 )
+		detail::memory_tag_free(mem_tag, entry.key_size);
 	entry.Clear();
+
+	// Removals move entries only toward the front, so they never take an old entry
+	// past remap_end. Advancing here too keeps the mixed period short for tables
+	// that stop growing, but still see churn.
+	if ( Remapping() )
+		Remap();
+
 	ASSERT_VALID(this);
 	return v;
 	}
@@ -978,7 +1085,8 @@ void Dictionary::Remap()
 		return;
 
 	int left = detail::DICT_REMAP_ENTRIES;
-	while ( remap_end >= 0 && left > 0 )
+	int slots = detail::DICT_REMAP_SLOTS;
+	while ( remap_end >= 0 && left > 0 && slots-- > 0 )
 		{
 		if ( ! table[remap_end].Empty() && Remap(remap_end) )
 			left--;
@@ -1050,6 +1158,16 @@ void Dictionary::StopIterationNonConst(IterCookie* cookie) //const
 	delete cookie;
 	}
 
+detail::HashKey* Dictionary::EntryHashKey(const detail::DictEntry& e) const
+	{
+	// Entries of FAST_HASH dictionaries don't carry the keyed hash; the key
+	// computes that itself if it gets used elsewhere.
+	if ( fast_hash )
+		return new detail::HashKey(e.GetKey(), e.key_size);
+
+	return new detail::HashKey(e.GetKey(), e.key_size, e.hash);
+	}
+
 void* Dictionary::NextEntryNonConst(detail::HashKey*& h, IterCookie*& c, bool return_hash) //const
 	{
 	// If there are any inserted entries, return them first.
@@ -1072,7 +1190,7 @@ void* Dictionary::NextEntryNonConst(detail::HashKey*& h, IterCookie*& c, bool re
 		// and removing from the tail is cheaper.
 		detail::DictEntry e = c->inserted->back();
 		if ( return_hash )
-			h = new detail::HashKey(e.GetKey(), e.key_size, e.hash);
+			h = EntryHashKey(e);
 		void* v = e.value;
 		c->inserted->pop_back();
 		return v;
@@ -1120,7 +1238,7 @@ void* Dictionary::NextEntryNonConst(detail::HashKey*& h, IterCookie*& c, bool re
 	ASSERT(! table[c->next].Empty());
 	void* v = table[c->next].value;
 	if ( return_hash )
-		h = new detail::HashKey(table[c->next].GetKey(), table[c->next].key_size, table[c->next].hash);
+		h = EntryHashKey(table[c->next]);
 
 	//prepare for next time.
 	c->next = Next(c->next);
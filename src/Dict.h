@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "Hash.h"
+#include "MemoryTag.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(IterCookie, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(DictEntry, zeek::detail);
@@ -17,6 +18,11 @@ namespace zeek {
 
 enum DictOrder { ORDERED, UNORDERED };
 
+// KEYED_HASH uses the keys' seeded hash, which resists collision attacks. FAST_HASH
+// dictionaries hash the key bytes themselves with a cheap unkeyed hash instead, and
+// are only for keys an attacker can't choose.
+enum DictHashPolicy { KEYED_HASH, FAST_HASH };
+
 // A dict_delete_func that just calls delete.
 extern void generic_delete_func(void*);
 
@@ -33,6 +39,11 @@ constexpr uint32_t HASH_MASK = 0xFFFFFFFF; //only lower 32 bits.
 // 2 for debug. 16 is best for a release build.
 constexpr uint8_t DICT_REMAP_ENTRIES = 16;
 
+// Upper bound on the slots a single remap step looks at, including empty ones and
+// entries already in their new bucket. This keeps each step's cost bounded no matter
+// how the remaining entries are spread out.
+constexpr uint8_t DICT_REMAP_SLOTS = 4 * DICT_REMAP_ENTRIES;
+
 // Load factor = 1 - 0.5 ^ LOAD_FACTOR_BITS. 0.75 is the optimal value for release builds.
 constexpr uint8_t DICT_LOAD_FACTOR_BITS = 2;
 
@@ -152,7 +163,8 @@ public:
  */
 class Dictionary {
 public:
-	explicit Dictionary(DictOrder ordering = UNORDERED, int initial_size = detail::DEFAULT_DICT_SIZE);
+	explicit Dictionary(DictOrder ordering = UNORDERED, int initial_size = detail::DEFAULT_DICT_SIZE,
+	                    DictHashPolicy hash_policy = KEYED_HASH);
 	~Dictionary();
 
 	// Member functions for looking up a key, inserting/changing its
@@ -165,7 +177,7 @@ public:
 
 	// Returns previous value, or 0 if none.
 	void* Insert(detail::HashKey* key, void* val)
-		{ return Insert(key->TakeKey(), key->Size(), key->Hash(), val, false); }
+		{ return Insert(key->TakeKey(), key->Size(), HashOf(key), val, false); }
 
 	// If copy_key is true, then the key is copied, otherwise it's assumed
 	// that it's a heap pointer that now belongs to the Dictionary to
@@ -176,7 +188,7 @@ public:
 	// case it needs to be deleted.  Returns 0 if no such element exists.
 	// If dontdelete is true, the key's bytes will not be deleted.
 	void* Remove(const detail::HashKey* key)
-		{ return Remove(key->Key(), key->Size(), key->Hash()); }
+		{ return Remove(key->Key(), key->Size(), HashOf(key)); }
 	void* Remove(const void* key, int key_size, detail::hash_t hash, bool dont_delete = false);
 
 	// Number of entries.
@@ -194,6 +206,9 @@ public:
 	// True if the dictionary is ordered, false otherwise.
 	int IsOrdered() const	{ return order != nullptr; }
 
+	DictHashPolicy HashPolicy() const
+		{ return fast_hash ? FAST_HASH : KEYED_HASH; }
+
 	// If the dictionary is ordered then returns the n'th entry's value;
 	// the second method also returns the key.  The first entry inserted
 	// corresponds to n=0.
@@ -227,6 +242,10 @@ public:
 
 	void SetDeleteFunc(dict_delete_func f)		{ delete_func = f; }
 
+	// Accounts the bucket array and the keys stored outside of it to a
+	// memory tag. Needs calling while the dictionary is still empty.
+	void SetMemoryTag(detail::MemoryTag tag)	{ mem_tag = tag; }
+
 	// With a robust cookie, it is safe to change the dictionary while
 	// iterating. This means that (i) we will eventually visit all
 	// unmodified entries as well as all entries added during iteration,
@@ -251,9 +270,22 @@ public:
 	void DistanceStats(int& max_distance, int* distances = 0, int num_distances = 0) const;
 	void DumpKeys() const;
 
+protected:
+	// The hash to pass along for a HashKey. FAST_HASH dictionaries compute their
+	// own, so the key's keyed hash is never needed for them.
+	detail::hash_t HashOf(const detail::HashKey* key) const
+		{ return fast_hash ? 0 : key->Hash(); }
+
 private:
 	friend zeek::IterCookie;
 
+	// The hash to use for a key given with the caller's hash h.
+	detail::hash_t PolicyHash(const void* key, int key_size, detail::hash_t h) const
+		{ return fast_hash ? detail::HashKey::FastHashBytes(key, key_size) : h; }
+
+	// A new HashKey for an entry, for handing out during iteration.
+	detail::HashKey* EntryHashKey(const detail::DictEntry& e) const;
+
 	/// Buckets of the table, not including overflow size.
 	int Buckets(bool expected = false) const;
 
@@ -327,7 +359,7 @@ private:
 
 	bool Remapping() const { return remap_end >= 0;} //remap in reverse order.
 
-	///One round of remap.
+	///One round of remap, bounded by DICT_REMAP_ENTRIES moves and DICT_REMAP_SLOTS slots.
 	void Remap();
 
 	// Remap an item in position to a new position. Returns true if the relocation was
@@ -346,6 +378,11 @@ private:
 	unsigned char remaps = 0;
 	unsigned char log2_buckets = 0;
 
+	// Whether the dictionary uses the FAST_HASH policy.
+	bool fast_hash = false;
+
+	detail::MemoryTag mem_tag = detail::MemoryTag::Untracked;
+
 	// Pending number of iterators on the Dict, including both robust and non-robust.
 	// This is used to avoid remapping if there are any active iterators.
 	unsigned short num_iterators = 0;
@@ -371,8 +408,9 @@ private:
 template<typename T>
 class PDict : public Dictionary {
 public:
-	explicit PDict(DictOrder ordering = UNORDERED, int initial_size = 0) :
-		Dictionary(ordering, initial_size) {}
+	explicit PDict(DictOrder ordering = UNORDERED, int initial_size = 0,
+	               DictHashPolicy hash_policy = KEYED_HASH) :
+		Dictionary(ordering, initial_size, hash_policy) {}
 	T* Lookup(const char* key) const
 		{
 		detail::HashKey h(key);
@@ -402,9 +440,9 @@ public:
 	T* NextEntry(detail::HashKey*& h, IterCookie*& cookie) const
 		{ return (T*) Dictionary::NextEntry(h, cookie, true); }
 	T* RemoveEntry(const detail::HashKey* key)
-		{ return (T*) Remove(key->Key(), key->Size(), key->Hash()); }
+		{ return (T*) Remove(key->Key(), key->Size(), HashOf(key)); }
 	T* RemoveEntry(const detail::HashKey& key)
-		{ return (T*) Remove(key.Key(), key.Size(), key.Hash()); }
+		{ return (T*) Remove(key.Key(), key.Size(), HashOf(&key)); }
 };
 
 } // namespace zeek
@@ -16,6 +16,155 @@
 
 namespace zeek::detail {
 
+DiscardRules discard_rules;
+
+uint64_t DiscardRules::Add(const RecordVal* r)
+	{
+	Rule rule;
+
+	if ( const auto& v = r->GetField("net") )
+		rule.net = v->AsSubNet();
+
+	if ( const auto& v = r->GetField("ports") )
+		{
+		auto lv = v->AsTableVal()->ToPureListVal();
+
+		for ( int i = 0; i < lv->Length(); ++i )
+			{
+			auto p = lv->Idx(i)->AsPortVal();
+			rule.ports.push_back(PortKey(p->PortType(), p->Port()));
+			}
+
+		std::sort(rule.ports.begin(), rule.ports.end());
+		rule.needs_transport = true;
+		}
+
+	if ( const auto& v = r->GetField("proto") )
+		{
+		rule.proto = static_cast<TransportProto>(v->AsEnum());
+		rule.needs_transport = true;
+		}
+
+	if ( const auto& v = r->GetField("min_payload_len") )
+		{
+		rule.min_payload_len = v->AsCount();
+		rule.needs_transport = true;
+		}
+
+	if ( const auto& v = r->GetField("max_payload_len") )
+		{
+		rule.max_payload_len = v->AsCount();
+		rule.needs_transport = true;
+		}
+
+	auto id = next_id++;
+	rules.emplace_back(id, std::move(rule));
+	return id;
+	}
+
+bool DiscardRules::Remove(uint64_t id)
+	{
+	auto it = std::find_if(rules.begin(), rules.end(),
+	                       [id](const auto& r) { return r.first == id; });
+
+	if ( it == rules.end() )
+		return false;
+
+	rules.erase(it);
+	return true;
+	}
+
+bool DiscardRules::Match(const IP_Hdr* ip, int len, int caplen) const
+	{
+	IPAddr src = ip->SrcAddr();
+	IPAddr dst = ip->DstAddr();
+
+	// The transport header's values, for unfragmented TCP, UDP and ICMP
+	// packets. Like for connections, ICMP's "ports" are its types.
+	bool have_transport = false;
+	TransportProto proto = TRANSPORT_UNKNOWN;
+	uint32_t sport = 0;
+	uint32_t dport = 0;
+	uint64_t payload_len = 0;
+
+	if ( ! ip->IsFragment() )
+		{
+		int ip_hdr_len = ip->HdrLen();
+		int tlen = len - ip_hdr_len;
+		int tcaplen = caplen - ip_hdr_len;
+		const u_char* data = ip->Payload();
+		int hdr_len = 0;
+
+		switch ( ip->NextProto() ) {
+		case IPPROTO_TCP:
+			if ( tcaplen >= static_cast<int>(sizeof(struct tcphdr)) )
+				{
+				auto tp = reinterpret_cast<const struct tcphdr*>(data);
+				proto = TRANSPORT_TCP;
+				sport = ntohs(tp->th_sport);
+				dport = ntohs(tp->th_dport);
+				hdr_len = tp->th_off * 4;
+				}
+			break;
+
+		case IPPROTO_UDP:
+			if ( tcaplen >= static_cast<int>(sizeof(struct udphdr)) )
+				{
+				auto up = reinterpret_cast<const struct udphdr*>(data);
+				proto = TRANSPORT_UDP;
+				sport = ntohs(up->uh_sport);
+				dport = ntohs(up->uh_dport);
+				hdr_len = sizeof(struct udphdr);
+				}
+			break;
+
+		case IPPROTO_ICMP:
+		case IPPROTO_ICMPV6:
+			// Type, code, checksum and 4 bytes that depend on the type.
+			if ( tcaplen >= 8 )
+				{
+				proto = TRANSPORT_ICMP;
+				sport = dport = data[0];
+				hdr_len = 8;
+				}
+			break;
+		}
+
+		if ( proto != TRANSPORT_UNKNOWN )
+			{
+			have_transport = true;
+			payload_len = std::max(tlen - hdr_len, 0);
+			}
+		}
+
+	for ( const auto& [id, r] : rules )
+		{
+		if ( r.net && ! r.net->Contains(src) && ! r.net->Contains(dst) )
+			continue;
+
+		if ( r.needs_transport )
+			{
+			if ( ! have_transport )
+				continue;
+
+			if ( r.proto && *r.proto != proto )
+				continue;
+
+			if ( payload_len < r.min_payload_len || payload_len > r.max_payload_len )
+				continue;
+
+			if ( ! r.ports.empty() &&
+			     ! std::binary_search(r.ports.begin(), r.ports.end(), PortKey(proto, sport)) &&
+			     ! std::binary_search(r.ports.begin(), r.ports.end(), PortKey(proto, dport)) )
+				continue;
+			}
+
+		return true;
+		}
+
+	return false;
+	}
+
 Discarder::Discarder()
 	{
 	check_ip = id::find_func("discarder_check_ip");
@@ -32,11 +181,17 @@ Discarder::~Discarder()
 
 bool Discarder::IsActive()
 	{
-	return check_ip || check_tcp || check_udp || check_icmp;
+	return check_ip || check_tcp || check_udp || check_icmp || ! discard_rules.Empty();
 	}
 
 bool Discarder::NextPacket(const std::unique_ptr<IP_Hdr>& ip, int len, int caplen)
 	{
+	if ( ! discard_rules.Empty() && discard_rules.Match(ip.get(), len, caplen) )
+		return true;
+
+	if ( ! (check_ip || check_tcp || check_udp || check_icmp) )
+		return false;
+
 	bool discard_packet = false;
 
 	if ( check_ip )
@@ -3,19 +3,83 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 
 #include "IntrusivePtr.h"
+#include "IPAddr.h"
+#include "net_util.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(IP_Hdr, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Func, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
+ZEEK_FORWARD_DECLARE_NAMESPACED(RecordVal, zeek);
 
 namespace zeek {
 using FuncPtr = IntrusivePtr<Func>;
 
 namespace detail {
 
+/**
+ * The discard rules that scripts install through add_discard_rule(). They
+ * get evaluated for every packet before the discarder_check_* functions,
+ * without building any script values.
+ */
+class DiscardRules {
+public:
+	/**
+	 * Adds a rule.
+	 *
+	 * @param r A \c discard_rule record.
+	 *
+	 * @return The rule's ID, for Remove().
+	 */
+	uint64_t Add(const RecordVal* r);
+
+	/**
+	 * Removes a rule.
+	 *
+	 * @return False if there's no rule with that ID.
+	 */
+	bool Remove(uint64_t id);
+
+	bool Empty() const	{ return rules.empty(); }
+
+	/**
+	 * Returns true if the packet matches one of the rules.
+	 *
+	 * @param ip The packet's IP header.
+	 *
+	 * @param len The length of the IP packet.
+	 *
+	 * @param caplen The captured length of the IP packet.
+	 */
+	bool Match(const IP_Hdr* ip, int len, int caplen) const;
+
+private:
+	struct Rule {
+		std::optional<IPPrefix> net;
+		std::vector<uint32_t> ports;	// Sorted, by PortKey().
+		std::optional<TransportProto> proto;
+		uint64_t min_payload_len = 0;
+		uint64_t max_payload_len = UINT64_MAX;
+
+		// Whether the rule looks at anything beyond the addresses.
+		bool needs_transport = false;
+	};
+
+	static uint32_t PortKey(TransportProto proto, uint32_t port)
+		{ return (static_cast<uint32_t>(proto) << 16) | port; }
+
+	std::vector<std::pair<uint64_t, Rule>> rules;
+	uint64_t next_id = 1;
+};
+
+extern DiscardRules discard_rules;
+
 class Discarder {
 public:
 	Discarder();
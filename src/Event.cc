@@ -12,6 +12,13 @@
 #include "iosource/Manager.h"
 #include "iosource/PktSrc.h"
 #include "RunState.h"
+#include "Stats.h"
+#include "telemetry/Manager.h"
+#include "LoopTrace.h"
+#include "ValArena.h"
+
+#include <algorithm>
+#include <vector>
 
 zeek::EventMgr zeek::event_mgr;
 zeek::EventMgr& mgr = zeek::event_mgr;
@@ -32,6 +39,37 @@ namespace zeek {
 		Ref(obj);
 	}
 
+Event::~Event()
+	{
+	event_mgr.RecycleArgs(std::move(args));
+	}
+
+void* Event::operator new(size_t size)
+	{
+	auto& pool = event_mgr.event_pool;
+
+	if ( size != sizeof(Event) || pool.empty() )
+		{
+		++event_mgr.num_event_pool_misses;
+		return ::operator new(size);
+		}
+
+	++event_mgr.num_event_pool_hits;
+	void* ptr = pool.back();
+	pool.pop_back();
+	return ptr;
+	}
+
+void Event::operator delete(void* ptr, size_t size)
+	{
+	auto& pool = event_mgr.event_pool;
+
+	if ( size != sizeof(Event) || pool.size() >= EventMgr::MAX_POOLED_EVENTS )
+		::operator delete(ptr);
+	else
+		pool.push_back(ptr);
+	}
+
 void Event::Describe(ODesc* d) const
 	{
 	if ( d->IsReadable() )
@@ -55,6 +93,9 @@ void Event::Dispatch(bool no_remote)
 	if ( handler->ErrorHandler() )
 		reporter->BeginErrorHandler();
 
+	detail::StageTimer stage(detail::STAGE_SCRIPT_HANDLERS);
+	detail::ValArenaScope arena_scope;
+
 	try
 		{
 		handler->Call(&args, no_remote);
@@ -73,9 +114,14 @@ void Event::Dispatch(bool no_remote)
 		reporter->EndErrorHandler();
 	}
 
+thread_local EventMgr::Lane EventMgr::current_lane = EventMgr::LANE_PACKET;
+
 EventMgr::EventMgr()
 	{
-	head = tail = nullptr;
+	for ( auto& l : lanes )
+		l.store(nullptr, std::memory_order_relaxed);
+
+	next_seq.store(0, std::memory_order_relaxed);
 	current_src = util::detail::SOURCE_LOCAL;
 	current_aid = 0;
 	src_val = nullptr;
@@ -84,13 +130,22 @@ EventMgr::EventMgr()
 
 EventMgr::~EventMgr()
 	{
-	while ( head )
+	for ( auto& l : lanes )
 		{
-		Event* n = head->NextEvent();
-		Unref(head);
-		head = n;
+		Event* e = l.exchange(nullptr);
+
+		while ( e )
+			{
+			Event* n = e->NextEvent();
+			Unref(e);
+			e = n;
+			}
 		}
 
+	for ( auto ptr : event_pool )
+		::operator delete(ptr);
+
+	event_pool.clear();
 	Unref(src_val);
 	}
 
@@ -136,18 +191,96 @@ void EventMgr::QueueEvent(Event* event)
 	if ( done )
 		return;
 
-	if ( ! head )
-		{
-		head = tail = event;
+	event->seq = next_seq.fetch_add(1, std::memory_order_relaxed);
+
+	Lane lane = event->Source() == util::detail::SOURCE_BROKER ? LANE_BROKER : current_lane;
+	auto& l = lanes[lane];
+
+	Event* old = l.load(std::memory_order_relaxed);
+
+	do
+		event->SetNext(old);
+	while ( ! l.compare_exchange_weak(old, event, std::memory_order_release,
+	                                  std::memory_order_relaxed) );
+
+	if ( ! old )
 		queue_flare.Fire();
+
+	++event_mgr.num_events_queued;
+	}
+
+Event* EventMgr::TakeQueued()
+	{
+	Event* heads[NUM_LANES];
+
+	for ( int i = 0; i < NUM_LANES; ++i )
+		{
+		// Reverse the lane's stack into queueing order.
+		Event* e = lanes[i].exchange(nullptr, std::memory_order_acquire);
+		Event* fifo = nullptr;
+		bool sorted = true;
+
+		while ( e )
+			{
+			Event* n = e->NextEvent();
+
+			if ( fifo && fifo->seq < e->seq )
+				sorted = false;
+
+			e->SetNext(fifo);
+			fifo = e;
+			e = n;
+			}
+
+		if ( ! sorted )
+			{
+			// Concurrent producers may have pushed slightly out of
+			// sequence order.
+			std::vector<Event*> v;
+
+			for ( e = fifo; e; e = e->NextEvent() )
+				v.push_back(e);
+
+			std::sort(v.begin(), v.end(),
+			          [](const Event* a, const Event* b) { return a->seq < b->seq; });
+
+			for ( size_t j = 0; j < v.size(); ++j )
+				v[j]->SetNext(j + 1 < v.size() ? v[j + 1] : nullptr);
+
+			fifo = v.front();
+			}
+
+		heads[i] = fifo;
 		}
-	else
+
+	// Merge the lanes by sequence number.
+	Event* head = nullptr;
+	Event* tail = nullptr;
+
+	while ( true )
 		{
-		tail->SetNext(event);
-		tail = event;
+		int next = -1;
+
+		for ( int i = 0; i < NUM_LANES; ++i )
+			if ( heads[i] && (next < 0 || heads[i]->seq < heads[next]->seq) )
+				next = i;
+
+		if ( next < 0 )
+			break;
+
+		Event* e = heads[next];
+		heads[next] = e->NextEvent();
+		e->SetNext(nullptr);
+
+		if ( tail )
+			tail->SetNext(e);
+		else
+			head = e;
+
+		tail = e;
 		}
 
-	++event_mgr.num_events_queued;
+	return head;
 	}
 
 void EventMgr::Dispatch(Event* event, bool no_remote)
@@ -163,11 +296,18 @@ void EventMgr::Drain()
 		Enqueue(event_queue_flush_point, Args{});
 
 	detail::SegmentProfiler prof(detail::segment_logger, "draining-events");
+	detail::StageTimer stage(detail::STAGE_EVENT_DISPATCH);
 
 	PLUGIN_HOOK_VOID(HOOK_DRAIN_EVENTS, HookDrainEvents());
 
 	draining = true;
 
+	uint64_t trace_start = detail::loop_trace ? detail::LoopTrace::Now() : 0;
+	uint64_t num_dispatched = num_events_dispatched;
+
+	if ( telemetry_mgr && HasEvents() && run_state::reading_live && ! run_state::pseudo_realtime )
+		telemetry_mgr->event_latency->Observe(util::current_time(true) - run_state::network_time);
+
 	// Past Bro versions drained as long as there events, including when
 	// a handler queued new events during its execution. This could lead
 	// to endless loops in case a handler kept triggering its own event.
@@ -175,11 +315,9 @@ void EventMgr::Drain()
 	// just one round to make it less likley to break existing scripts
 	// that expect the old behavior to trigger something quickly.
 
-	for ( int round = 0; head && round < 2; round++ )
+	for ( int round = 0; HasEvents() && round < 2; round++ )
 		{
-		Event* current = head;
-		head = nullptr;
-		tail = nullptr;
+		Event* current = TakeQueued();
 
 		while ( current )
 			{
@@ -190,6 +328,10 @@ void EventMgr::Drain()
 			current->Dispatch();
 			Unref(current);
 
+			// Triggers learn about the event's modifications only
+			// now, once for each object.
+			notifier::detail::registry.Flush();
+
 			++event_mgr.num_events_dispatched;
 			current = next;
 			}
@@ -199,6 +341,11 @@ void EventMgr::Drain()
 	// do after draining events.
 	draining = false;
 
+	if ( detail::loop_trace && num_events_dispatched != num_dispatched )
+		detail::loop_trace->Record(detail::LoopTraceType::DRAIN,
+		                           num_events_dispatched - num_dispatched,
+		                           detail::LoopTrace::Now() - trace_start);
+
 	// Make sure all of the triggers get processed every time the events
 	// drain.
 	detail::trigger_mgr->Process();
@@ -208,16 +355,20 @@ void EventMgr::Describe(ODesc* d) const
 	{
 	int n = 0;
 	Event* e;
-	for ( e = head; e; e = e->NextEvent() )
-		++n;
+
+	for ( const auto& l : lanes )
+		for ( e = l.load(); e; e = e->NextEvent() )
+			++n;
 
 	d->AddCount(n);
 
-	for ( e = head; e; e = e->NextEvent() )
-		{
-		e->Describe(d);
-		d->NL();
-		}
+	// Lanes hold their events newest first.
+	for ( const auto& l : lanes )
+		for ( e = l.load(); e; e = e->NextEvent() )
+			{
+			e->Describe(d);
+			d->NL();
+			}
 	}
 
 void EventMgr::Process()
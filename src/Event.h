@@ -9,6 +9,7 @@
 #include "ZeekArgs.h"
 #include "IntrusivePtr.h"
 
+#include <atomic>
 #include <tuple>
 #include <type_traits>
 
@@ -21,6 +22,12 @@ public:
 	Event(EventHandlerPtr handler, zeek::Args args,
 	      util::detail::SourceID src = util::detail::SOURCE_LOCAL, analyzer::ID aid = 0,
 	      Obj* obj = nullptr);
+	~Event() override;
+
+	// Events are recycled through a free list in the event manager
+	// rather than going back to the heap.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
 
 	void SetNext(Event* n)		{ next_event = n; }
 	Event* NextEvent() const	{ return next_event; }
@@ -45,10 +52,43 @@ protected:
 	analyzer::ID aid;
 	Obj* obj;
 	Event* next_event;
+	uint64_t seq = 0;	// Position in overall queueing order.
 };
 
 class EventMgr final : public Obj, public iosource::IOSource {
 public:
+	/**
+	 * The queues that events get posted to, according to where they
+	 * originate. Draining merges them back into the order in which the
+	 * events were queued.
+	 */
+	enum Lane {
+		LANE_PACKET,	// Anything not covered below, mostly packet-driven.
+		LANE_BROKER,	// Events received from remote peers.
+		LANE_INPUT,	// Events of the input framework.
+		LANE_TIMER,	// Events raised by expiring timers.
+		NUM_LANES
+	};
+
+	/**
+	 * Directs the events that the current thread queues (other than
+	 * remote ones) into a given lane for as long as the instance
+	 * exists.
+	 */
+	class LaneScope {
+	public:
+		explicit LaneScope(Lane lane) : prev(current_lane)
+			{ current_lane = lane; }
+		~LaneScope()
+			{ current_lane = prev; }
+
+		LaneScope(const LaneScope&) = delete;
+		LaneScope& operator=(const LaneScope&) = delete;
+
+	private:
+		Lane prev;
+	};
+
 	EventMgr();
 	~EventMgr() override;
 
@@ -109,14 +149,43 @@ public:
 		std::is_convertible_v<
 			std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	Enqueue(const EventHandlerPtr& h, Args&&... args)
-		{ return Enqueue(h, zeek::Args{std::forward<Args>(args)...}); }
+		{
+		auto vl = NewArgs();
+		(vl.emplace_back(std::forward<Args>(args)), ...);
+		return Enqueue(h, std::move(vl));
+		}
+
+	/**
+	 * Returns an empty argument vector for a new event. It reuses the
+	 * storage of one from an already dispatched event if possible.
+	 */
+	zeek::Args NewArgs()
+		{
+		if ( args_pool.empty() )
+			{
+			zeek::Args vl;
+			vl.reserve(POOLED_ARGS);
+			return vl;
+			}
+
+		auto vl = std::move(args_pool.back());
+		args_pool.pop_back();
+		return vl;
+		}
 
 	void Dispatch(Event* event, bool no_remote = false);
 
 	void Drain();
 	bool IsDraining() const	{ return draining; }
 
-	bool HasEvents() const	{ return head != nullptr; }
+	bool HasEvents() const
+		{
+		for ( const auto& l : lanes )
+			if ( l.load(std::memory_order_relaxed) )
+				return true;
+
+		return false;
+		}
 
 	// Returns the source ID of last raised event.
 	util::detail::SourceID CurrentSource() const	{ return current_src; }
@@ -138,11 +207,43 @@ public:
 	uint64_t num_events_queued = 0;
 	uint64_t num_events_dispatched = 0;
 
+	// Event allocations served from, and missing, the free list.
+	uint64_t num_event_pool_hits = 0;
+	uint64_t num_event_pool_misses = 0;
+
 protected:
+	friend class Event;
+
+	// Upper bounds on what we keep around for reuse. Argument vectors
+	// are kept up to the capacity needed by the vast majority of events.
+	static constexpr size_t MAX_POOLED_EVENTS = 4096;
+	static constexpr size_t POOLED_ARGS = 6;
+
+	void RecycleArgs(zeek::Args&& vl)
+		{
+		vl.clear();
+
+		if ( vl.capacity() && vl.capacity() <= POOLED_ARGS &&
+		     args_pool.size() < MAX_POOLED_EVENTS )
+			args_pool.emplace_back(std::move(vl));
+		}
+
+	std::vector<void*> event_pool;
+	std::vector<zeek::Args> args_pool;
+
 	void QueueEvent(Event* event);
 
-	Event* head;
-	Event* tail;
+	// Takes all events queued so far out of the lanes and returns them
+	// as one list in queueing order.
+	Event* TakeQueued();
+
+	// Each lane is a lock-free multi-producer stack holding its events
+	// in reverse order; the consumer grabs it as a whole.
+	std::atomic<Event*> lanes[NUM_LANES];
+	std::atomic<uint64_t> next_seq;
+
+	static thread_local Lane current_lane;
+
 	util::detail::SourceID current_src;
 	analyzer::ID current_aid;
 	RecordVal* src_val;
@@ -10,8 +10,17 @@
 #include "broker/Manager.h"
 #include "broker/Data.h"
 
+#include <time.h>
+
 namespace zeek {
 
+static double clock_seconds(clockid_t clock)
+	{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+
 EventHandler::EventHandler(std::string arg_name)
 	{
 	name = std::move(arg_name);
@@ -67,10 +76,28 @@ void EventHandler::Call(Args* vl, bool no_remote)
 			{
 			// Send event in form [name, xs...] where xs represent the arguments.
 			broker::vector xs;
-			xs.reserve(vl->size());
 			bool valid_args = true;
+			bool packed = false;
 
-			for ( auto i = 0u; i < vl->size(); ++i )
+			if ( broker_mgr->PacksEventArgs() )
+				{
+				std::vector<const Val*> vals;
+				vals.reserve(vl->size());
+
+				for ( const auto& v : *vl )
+					vals.emplace_back(v.get());
+
+				if ( auto packed_args = Broker::detail::pack_event_args(vals, GetType(false)->ParamList()->GetTypes()) )
+					{
+					xs = std::move(*packed_args);
+					packed = true;
+					}
+				}
+
+			if ( ! packed )
+				xs.reserve(vl->size());
+
+			for ( auto i = 0u; ! packed && i < vl->size(); ++i )
 				{
 				auto opt_data = Broker::detail::val_to_data((*vl)[i].get());
 
@@ -104,11 +131,62 @@ void EventHandler::Call(Args* vl, bool no_remote)
 			}
 		}
 
-	if ( local )
+	if ( ! local )
+		return;
+
+	if ( detail::event_handler_profiling )
+		ProfiledInvoke(vl);
+	else
 		// No try/catch here; we pass exceptions upstream.
 		local->Invoke(vl);
 	}
 
+void EventHandler::ProfiledInvoke(Args* vl)
+	{
+	// Accounts for the call on the way out, including when the handler
+	// throws.
+	class Sample {
+	public:
+		explicit Sample(Stats* arg_stats) : stats(arg_stats)
+			{
+			uint64_t depth = event_mgr.Size();
+
+			if ( depth > stats->max_queue_depth )
+				stats->max_queue_depth = depth;
+
+			objs = Obj::NumCreated();
+			wall = clock_seconds(CLOCK_MONOTONIC);
+			cpu = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+			}
+
+		~Sample()
+			{
+			double dcpu = clock_seconds(CLOCK_THREAD_CPUTIME_ID) - cpu;
+			double dwall = clock_seconds(CLOCK_MONOTONIC) - wall;
+
+			++stats->calls;
+			stats->wall_time += dwall;
+			stats->cpu_time += dcpu;
+			stats->allocations += Obj::NumCreated() - objs;
+
+			if ( dwall > stats->max_wall_time )
+				stats->max_wall_time = dwall;
+
+			if ( dcpu > stats->max_cpu_time )
+				stats->max_cpu_time = dcpu;
+			}
+
+	private:
+		Stats* stats;
+		uint64_t objs;
+		double wall;
+		double cpu;
+	};
+
+	Sample sample(&stats);
+	local->Invoke(vl);
+	}
+
 void EventHandler::NewEvent(Args* vl)
 	{
 	if ( ! new_event )
@@ -16,6 +16,21 @@ using FuncPtr = IntrusivePtr<Func>;
 
 class EventHandler {
 public:
+	/**
+	 * Dispatch statistics, collected only if the script-level
+	 * event_handler_profiling option is set. Times include those of any
+	 * events that the handler dispatches synchronously itself.
+	 */
+	struct Stats {
+		uint64_t calls = 0;
+		double wall_time = 0.0;
+		double max_wall_time = 0.0;
+		double cpu_time = 0.0;
+		double max_cpu_time = 0.0;
+		uint64_t allocations = 0;	// Script-layer objects created.
+		uint64_t max_queue_depth = 0;	// Events pending when called.
+	};
+
 	explicit EventHandler(std::string name);
 
 	const char* Name()	{ return name.data(); }
@@ -67,9 +82,14 @@ public:
 	void SetGenerateAlways()	{ generate_always = true; }
 	bool GenerateAlways()	{ return generate_always; }
 
+	const Stats& GetStats() const	{ return stats; }
+
 private:
 	void NewEvent(zeek::Args* vl);	// Raise new_event() meta event.
 
+	// Calls the local handler, accounting for it in the stats.
+	void ProfiledInvoke(zeek::Args* vl);
+
 	std::string name;
 	FuncPtr local;
 	FuncTypePtr type;
@@ -79,6 +99,8 @@ private:
 	bool generate_always;
 
 	std::unordered_set<std::string> auto_publish;
+
+	Stats stats;
 };
 
 // Encapsulates a ptr to an event handler to overload the boolean operator.
@@ -31,14 +31,20 @@ EventHandlerPtr EventRegistry::Register(std::string_view name)
 
 void EventRegistry::Register(EventHandlerPtr handler)
 	{
-	handlers[std::string(handler->Name())] = std::unique_ptr<EventHandler>(handler.Ptr());
+	// A handler replacing another one takes over the key as well, as
+	// the old key goes away with the old handler.
+	std::string_view name = handler->Name();
+	index.erase(name);
+	index.emplace(name, handler.Ptr());
+
+	handlers[std::string(name)] = std::unique_ptr<EventHandler>(handler.Ptr());
 	}
 
 EventHandler* EventRegistry::Lookup(std::string_view name)
 	{
-	auto it = handlers.find(name);
-	if ( it != handlers.end() )
-		return it->second.get();
+	auto it = index.find(name);
+	if ( it != index.end() )
+		return it->second;
 
 	return nullptr;
 	}
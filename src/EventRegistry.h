@@ -8,6 +8,7 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(EventHandler, zeek);
@@ -53,6 +54,10 @@ public:
 
 private:
 	std::map<std::string, std::unique_ptr<EventHandler>, std::less<>> handlers;
+
+	// The same handlers hashed, for Lookup(). The keys point to the
+	// handlers' own names.
+	std::unordered_map<std::string_view, EventHandler*> index;
 };
 
 extern EventRegistry* event_registry;
@@ -0,0 +1,137 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "ExpireIndex.h"
+
+#include <cstring>
+#include <new>
+
+#include "MemoryTag.h"
+#include "Val.h"
+
+namespace zeek::detail {
+
+static size_t node_size(int key_size)
+	{
+	return sizeof(ExpireNode) + key_size;
+	}
+
+void ExpireIndex::Insert(TableEntryVal* entry, const HashKey& key)
+	{
+	if ( entry->expire_node )
+		return;
+
+	auto n = static_cast<ExpireNode*>(::operator new(node_size(key.Size())));
+	n->entry = entry;
+	n->hash = key.Hash();
+	n->key_size = key.Size();
+	memcpy(n + 1, key.Key(), key.Size());
+	memory_tag_alloc(MemoryTag::Tables, node_size(n->key_size));
+
+	entry->expire_node = n;
+	Link(n, entry->expire_access_time);
+	++size;
+	}
+
+void ExpireIndex::Remove(TableEntryVal* entry)
+	{
+	auto n = entry->expire_node;
+
+	if ( ! n )
+		return;
+
+	Unlink(n);
+	entry->expire_node = nullptr;
+	--size;
+
+	memory_tag_free(MemoryTag::Tables, node_size(n->key_size));
+	::operator delete(n);
+	}
+
+void ExpireIndex::Touch(TableEntryVal* entry, double time)
+	{
+	entry->SetExpireAccess(time);
+
+	auto n = entry->expire_node;
+
+	// Most accesses come within the same second as the previous one.
+	if ( ! n || n->bucket == entry->expire_access_time )
+		return;
+
+	Unlink(n);
+	Link(n, entry->expire_access_time);
+	}
+
+TableEntryVal* ExpireIndex::Oldest(std::unique_ptr<HashKey>* key)
+	{
+	while ( ! buckets.empty() )
+		{
+		auto n = buckets.begin()->second;
+
+		// Access times set without going through Touch() leave their
+		// entries behind; file them where they belong now.
+		if ( n->bucket != n->entry->expire_access_time )
+			{
+			Unlink(n);
+			Link(n, n->entry->expire_access_time);
+			continue;
+			}
+
+		*key = std::make_unique<HashKey>(n->Key(), n->key_size, n->hash);
+		return n->entry;
+		}
+
+	return nullptr;
+	}
+
+void ExpireIndex::Clear()
+	{
+	for ( const auto& b : buckets )
+		{
+		for ( auto n = b.second; n; )
+			{
+			auto next = n->next;
+			n->entry->expire_node = nullptr;
+			memory_tag_free(MemoryTag::Tables, node_size(n->key_size));
+			::operator delete(n);
+			n = next;
+			}
+		}
+
+	buckets.clear();
+	size = 0;
+	}
+
+void ExpireIndex::Link(ExpireNode* n, int bucket)
+	{
+	// New buckets mostly go to the end.
+	auto it = buckets.try_emplace(buckets.end(), bucket, nullptr);
+
+	n->bucket = bucket;
+	n->prev = nullptr;
+	n->next = it->second;
+
+	if ( n->next )
+		n->next->prev = n;
+
+	it->second = n;
+	}
+
+void ExpireIndex::Unlink(ExpireNode* n)
+	{
+	if ( n->prev )
+		n->prev->next = n->next;
+	else
+		{
+		auto it = buckets.find(n->bucket);
+
+		if ( n->next )
+			it->second = n->next;
+		else
+			buckets.erase(it);
+		}
+
+	if ( n->next )
+		n->next->prev = n->prev;
+	}
+
+} // namespace zeek::detail
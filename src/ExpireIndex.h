@@ -0,0 +1,94 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+
+#include "Hash.h"
+
+ZEEK_FORWARD_DECLARE_NAMESPACED(TableEntryVal, zeek);
+
+namespace zeek::detail {
+
+// An entry's place in the index, with a copy of its key following it.
+struct ExpireNode {
+	ExpireNode* prev;
+	ExpireNode* next;
+	TableEntryVal* entry;
+	hash_t hash;
+	int bucket;
+	int key_size;
+
+	const void* Key() const	{ return this + 1; }
+};
+
+/**
+ * An index of the entries of a table with &create_expire, &read_expire or
+ * &write_expire by the time of their last expiration-relevant access, in
+ * buckets of one second, the resolution the entries keep that time in.
+ * Expiration then only visits the entries that are due, oldest first,
+ * rather than scanning the whole table for them, and refreshing an
+ * entry's access time just moves it to another bucket. The index keeps a
+ * copy of each entry's key, to remove expired ones from the table.
+ */
+class ExpireIndex {
+public:
+	ExpireIndex() = default;
+	ExpireIndex(const ExpireIndex&) = delete;
+	ExpireIndex& operator=(const ExpireIndex&) = delete;
+
+	~ExpireIndex()	{ Clear(); }
+
+	/**
+	 * Adds a table entry, filed under its current access time.
+	 *
+	 * @param entry The entry.
+	 *
+	 * @param key The entry's key in the table.
+	 */
+	void Insert(TableEntryVal* entry, const HashKey& key);
+
+	/**
+	 * Removes a table entry, if present.
+	 */
+	void Remove(TableEntryVal* entry);
+
+	/**
+	 * Sets the access time of an entry and moves it to the according
+	 * bucket.
+	 *
+	 * @param entry The entry.
+	 *
+	 * @param time The new access time, as for
+	 * TableEntryVal::SetExpireAccess().
+	 */
+	void Touch(TableEntryVal* entry, double time);
+
+	/**
+	 * Returns the entry with the oldest access time, or null if the
+	 * index is empty.
+	 *
+	 * @param key Set to the entry's key.
+	 */
+	TableEntryVal* Oldest(std::unique_ptr<HashKey>* key);
+
+	/**
+	 * Removes all entries.
+	 */
+	void Clear();
+
+	size_t Size() const	{ return size; }
+
+private:
+	void Link(ExpireNode* n, int bucket);
+	void Unlink(ExpireNode* n);
+
+	// The first node of each bucket, by access time in seconds since
+	// Zeek's start.
+	std::map<int, ExpireNode*> buckets;
+	size_t size = 0;
+};
+
+} // namespace zeek::detail
@@ -17,8 +17,10 @@
 #include "IPAddr.h"
 #include "digest.h"
 #include "module_util.h"
+#include "Debug.h"
 #include "DebugLogger.h"
 #include "Hash.h"
+#include "plugin/Manager.h"
 
 #include "broker/Data.h"
 
@@ -489,6 +491,15 @@ ValPtr BinaryExpr::Eval(Frame* f) const
 	if ( ! v2 )
 		return nullptr;
 
+	if ( fast_fold )
+		{
+		if ( auto v = fast_fold(this, v1.get(), v2.get()) )
+			return v;
+
+		// Vector folds leave the unusual cases to the generic code
+		// below.
+		}
+
 	bool is_vec1 = is_vector(v1);
 	bool is_vec2 = is_vector(v2);
 
@@ -571,6 +582,368 @@ void BinaryExpr::ExprDescribe(ODesc* d) const
 	op2->Describe(d);
 	}
 
+// Folds for operands of statically known types, see SelectFastFold().
+
+using fast_fold_func = ValPtr (*)(const BinaryExpr* e, const Val* v1, const Val* v2);
+
+template <class T> static T unboxed(const Val* v);
+template <> bro_int_t unboxed(const Val* v)	{ return v->ForceAsInt(); }
+template <> bro_uint_t unboxed(const Val* v)	{ return v->ForceAsUInt(); }
+template <> double unboxed(const Val* v)	{ return v->ForceAsDouble(); }
+
+template <TypeTag RT, class T>
+static ValPtr fold_result(T v)
+	{
+	if constexpr ( RT == TYPE_BOOL )
+		return val_mgr->Bool(v);
+	else if constexpr ( RT == TYPE_INT )
+		return val_mgr->Int(v);
+	else if constexpr ( RT == TYPE_COUNT )
+		return val_mgr->Count(v);
+	else if constexpr ( RT == TYPE_TIME )
+		return make_intrusive<TimeVal>(v);
+	else if constexpr ( RT == TYPE_INTERVAL )
+		return make_intrusive<IntervalVal>(v);
+	else
+		return make_intrusive<DoubleVal>(v);
+	}
+
+template <BroExprTag op, class T, TypeTag RT>
+static ValPtr fast_fold(const BinaryExpr* e, const Val* v1, const Val* v2)
+	{
+	T a = unboxed<T>(v1);
+	T b = unboxed<T>(v2);
+
+	if constexpr ( op == EXPR_ADD )
+		return fold_result<RT>(a + b);
+	else if constexpr ( op == EXPR_SUB )
+		return fold_result<RT>(a - b);
+	else if constexpr ( op == EXPR_TIMES )
+		return fold_result<RT>(a * b);
+	else if constexpr ( op == EXPR_DIVIDE )
+		{
+		if ( b == 0 )
+			reporter->ExprRuntimeError(e, "division by zero");
+
+		return fold_result<RT>(a / b);
+		}
+	else if constexpr ( op == EXPR_MOD )
+		{
+		if ( b == 0 )
+			reporter->ExprRuntimeError(e, "modulo by zero");
+
+		return fold_result<RT>(a % b);
+		}
+	else if constexpr ( op == EXPR_LT )
+		return val_mgr->Bool(a < b);
+	else if constexpr ( op == EXPR_LE )
+		return val_mgr->Bool(a <= b);
+	else if constexpr ( op == EXPR_EQ )
+		return val_mgr->Bool(a == b);
+	else
+		return val_mgr->Bool(a != b);
+	}
+
+template <BroExprTag op, class T>
+static auto vector_op(T a, T b)
+	{
+	if constexpr ( op == EXPR_ADD )
+		return a + b;
+	else if constexpr ( op == EXPR_SUB )
+		return a - b;
+	else if constexpr ( op == EXPR_TIMES )
+		return a * b;
+	else if constexpr ( op == EXPR_DIVIDE )
+		return a / b;
+	else if constexpr ( op == EXPR_MOD )
+		return a % b;
+	else if constexpr ( op == EXPR_LT )
+		return static_cast<uint8_t>(a < b);
+	else if constexpr ( op == EXPR_LE )
+		return static_cast<uint8_t>(a <= b);
+	else if constexpr ( op == EXPR_EQ )
+		return static_cast<uint8_t>(a == b);
+	else
+		return static_cast<uint8_t>(a != b);
+	}
+
+// Copies a vector's elements into a plain array. Returns false if the
+// vector has holes.
+template <class T>
+static bool unbox_vector(const Val* v, std::vector<T>& out)
+	{
+	const auto& vv = *v->AsVector();
+	out.resize(vv.size());
+
+	for ( size_t i = 0; i < vv.size(); ++i )
+		{
+		if ( ! vv[i] )
+			return false;
+
+		out[i] = unboxed<T>(vv[i].get());
+		}
+
+	return true;
+	}
+
+// The element-wise version of fast_fold(), for a vector and a vector or a
+// scalar. The elements get unboxed into arrays first, so that the
+// operation itself is a plain loop the compiler can vectorize. Returns
+// nullptr for operands it leaves to the generic code: vectors with holes
+// and vectors of different sizes.
+template <BroExprTag op, class T, TypeTag RT>
+static ValPtr fast_vector_fold(const BinaryExpr* e, const Val* v1, const Val* v2)
+	{
+	bool is_vec1 = v1->GetType()->Tag() == TYPE_VECTOR;
+	bool is_vec2 = v2->GetType()->Tag() == TYPE_VECTOR;
+
+	std::vector<T> a;
+	std::vector<T> b;
+
+	if ( is_vec1 && ! unbox_vector(v1, a) )
+		return nullptr;
+
+	if ( is_vec2 && ! unbox_vector(v2, b) )
+		return nullptr;
+
+	if ( is_vec1 && is_vec2 && a.size() != b.size() )
+		return nullptr;
+
+	if ( ! is_vec1 )
+		a.assign(1, unboxed<T>(v1));
+
+	if ( ! is_vec2 )
+		b.assign(1, unboxed<T>(v2));
+
+	if constexpr ( op == EXPR_DIVIDE || op == EXPR_MOD )
+		{
+		if ( std::find(b.begin(), b.end(), T(0)) != b.end() )
+			reporter->ExprRuntimeError(e, op == EXPR_DIVIDE ?
+			                           "division by zero" : "modulo by zero");
+		}
+
+	size_t n = is_vec1 ? a.size() : b.size();
+	std::vector<decltype(vector_op<op>(T(), T()))> r(n);
+	const T* pa = a.data();
+	const T* pb = b.data();
+
+	if ( is_vec1 && is_vec2 )
+		for ( size_t i = 0; i < n; ++i )
+			r[i] = vector_op<op>(pa[i], pb[i]);
+
+	else if ( is_vec1 )
+		for ( size_t i = 0; i < n; ++i )
+			r[i] = vector_op<op>(pa[i], pb[0]);
+
+	else
+		for ( size_t i = 0; i < n; ++i )
+			r[i] = vector_op<op>(pa[0], pb[i]);
+
+	// A fresh vector, so its storage can be filled directly.
+	auto result = make_intrusive<VectorVal>(e->GetType<VectorType>());
+	result->Resize(n);
+	auto& out = *result->AsVector();
+
+	for ( size_t i = 0; i < n; ++i )
+		out[i] = fold_result<RT>(r[i]);
+
+	return result;
+	}
+
+template <BroExprTag op, class T, TypeTag RT, bool is_vec>
+static ValPtr (*fold_for())(const BinaryExpr*, const Val*, const Val*)
+	{
+	if constexpr ( is_vec )
+		return fast_vector_fold<op, T, RT>;
+	else
+		return fast_fold<op, T, RT>;
+	}
+
+template <BroExprTag op>
+static ValPtr fast_string_fold(const BinaryExpr* e, const Val* v1, const Val* v2)
+	{
+	int cmp = Bstr_cmp(v1->AsString(), v2->AsString());
+
+	if constexpr ( op == EXPR_LT )
+		return val_mgr->Bool(cmp < 0);
+	else if constexpr ( op == EXPR_LE )
+		return val_mgr->Bool(cmp <= 0);
+	else if constexpr ( op == EXPR_EQ )
+		return val_mgr->Bool(cmp == 0);
+	else
+		return val_mgr->Bool(cmp != 0);
+	}
+
+template <BroExprTag op>
+static ValPtr fast_addr_fold(const BinaryExpr* e, const Val* v1, const Val* v2)
+	{
+	const IPAddr& a = v1->AsAddr();
+	const IPAddr& b = v2->AsAddr();
+
+	if constexpr ( op == EXPR_LT )
+		return val_mgr->Bool(a < b);
+	else if constexpr ( op == EXPR_LE )
+		return val_mgr->Bool(a < b || a == b);
+	else if constexpr ( op == EXPR_EQ )
+		return val_mgr->Bool(a == b);
+	else
+		return val_mgr->Bool(a != b);
+	}
+
+template <class T, TypeTag RT, bool is_vec>
+static fast_fold_func select_arith_fold(BroExprTag tag)
+	{
+	switch ( tag ) {
+	case EXPR_ADD:		return fold_for<EXPR_ADD, T, RT, is_vec>();
+	case EXPR_SUB:		return fold_for<EXPR_SUB, T, RT, is_vec>();
+	case EXPR_TIMES:	return fold_for<EXPR_TIMES, T, RT, is_vec>();
+	case EXPR_DIVIDE:	return fold_for<EXPR_DIVIDE, T, RT, is_vec>();
+
+	case EXPR_MOD:
+		if constexpr ( std::is_integral_v<T> )
+			return fold_for<EXPR_MOD, T, RT, is_vec>();
+		else
+			return nullptr;
+
+	default:
+		return nullptr;
+	}
+	}
+
+template <class T, bool is_vec>
+static fast_fold_func select_compare_fold(BroExprTag tag)
+	{
+	switch ( tag ) {
+	case EXPR_LT:	return fold_for<EXPR_LT, T, TYPE_BOOL, is_vec>();
+	case EXPR_LE:	return fold_for<EXPR_LE, T, TYPE_BOOL, is_vec>();
+	case EXPR_EQ:	return fold_for<EXPR_EQ, T, TYPE_BOOL, is_vec>();
+	case EXPR_NE:	return fold_for<EXPR_NE, T, TYPE_BOOL, is_vec>();
+	default:	return nullptr;
+	}
+	}
+
+static bool is_fast_fold_atomic(TypeTag t)
+	{
+	switch ( t ) {
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+// Arithmetic and comparisons on numbers, where type-checking has already
+// promoted both operands to the same internal type. For vectors, the
+// types are those of the elements.
+template <bool is_vec>
+static fast_fold_func select_atomic_fold(BroExprTag tag, const TypePtr& t1,
+                                         const TypePtr& t2, const TypePtr& rt)
+	{
+	InternalTypeTag it = t1->InternalType();
+
+	if ( ! is_fast_fold_atomic(t1->Tag()) || ! is_fast_fold_atomic(t2->Tag()) ||
+	     it != t2->InternalType() )
+		return nullptr;
+
+	if ( rt->Tag() == TYPE_BOOL )
+		{
+		if ( it == TYPE_INTERNAL_INT )
+			return select_compare_fold<bro_int_t, is_vec>(tag);
+		else if ( it == TYPE_INTERNAL_UNSIGNED )
+			return select_compare_fold<bro_uint_t, is_vec>(tag);
+		else if ( it == TYPE_INTERNAL_DOUBLE )
+			return select_compare_fold<double, is_vec>(tag);
+
+		return nullptr;
+		}
+
+	if ( rt->InternalType() != it )
+		return nullptr;
+
+	switch ( rt->Tag() ) {
+	case TYPE_INT:
+		return select_arith_fold<bro_int_t, TYPE_INT, is_vec>(tag);
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		return select_arith_fold<bro_uint_t, TYPE_COUNT, is_vec>(tag);
+
+	case TYPE_DOUBLE:
+		return select_arith_fold<double, TYPE_DOUBLE, is_vec>(tag);
+
+	case TYPE_TIME:
+		return select_arith_fold<double, TYPE_TIME, is_vec>(tag);
+
+	case TYPE_INTERVAL:
+		return select_arith_fold<double, TYPE_INTERVAL, is_vec>(tag);
+
+	default:
+		return nullptr;
+	}
+	}
+
+void BinaryExpr::SelectFastFold()
+	{
+	if ( IsError() )
+		return;
+
+	const auto& t1 = op1->GetType();
+	const auto& t2 = op2->GetType();
+	const auto& rt = GetType();
+
+	if ( IsVector(t1->Tag()) || IsVector(t2->Tag()) )
+		{
+		if ( ! IsVector(rt->Tag()) )
+			return;
+
+		auto elem_type = [](const TypePtr& t) -> const TypePtr&
+			{ return IsVector(t->Tag()) ? t->Yield() : t; };
+
+		fast_fold = select_atomic_fold<true>(tag, elem_type(t1), elem_type(t2),
+		                                     rt->Yield());
+		return;
+		}
+
+	bool is_compare = (rt->Tag() == TYPE_BOOL);
+
+	if ( t1->Tag() == TYPE_STRING && t2->Tag() == TYPE_STRING )
+		{
+		if ( ! is_compare )
+			return;
+
+		switch ( tag ) {
+		case EXPR_LT:	fast_fold = fast_string_fold<EXPR_LT>; break;
+		case EXPR_LE:	fast_fold = fast_string_fold<EXPR_LE>; break;
+		case EXPR_EQ:	fast_fold = fast_string_fold<EXPR_EQ>; break;
+		case EXPR_NE:	fast_fold = fast_string_fold<EXPR_NE>; break;
+		default:	break;
+		}
+
+		return;
+		}
+
+	if ( t1->Tag() == TYPE_ADDR && t2->Tag() == TYPE_ADDR )
+		{
+		switch ( tag ) {
+		case EXPR_LT:	fast_fold = fast_addr_fold<EXPR_LT>; break;
+		case EXPR_LE:	fast_fold = fast_addr_fold<EXPR_LE>; break;
+		case EXPR_EQ:	fast_fold = fast_addr_fold<EXPR_EQ>; break;
+		case EXPR_NE:	fast_fold = fast_addr_fold<EXPR_NE>; break;
+		default:	break;
+		}
+
+		return;
+		}
+
+	fast_fold = select_atomic_fold<false>(tag, t1, t2, rt);
+	}
+
 ValPtr BinaryExpr::Fold(Val* v1, Val* v2) const
 	{
 	InternalTypeTag it = v1->GetType()->InternalType();
@@ -1219,6 +1592,8 @@ AddExpr::AddExpr(ExprPtr arg_op1, ExprPtr arg_op2)
 		else
 			SetType(std::move(base_result_type));
 		}
+
+	SelectFastFold();
 	}
 
 void AddExpr::Canonicize()
@@ -1292,7 +1667,7 @@ ValPtr AddToExpr::Eval(Frame* f) const
 		{
 		VectorVal* vv = v1->AsVectorVal();
 
-		if ( ! vv->Assign(vv->Size(), v2) )
+		if ( ! vv->Assign(vv->Size(), std::move(v2)) )
 			RuntimeError("type-checking failed in vector append");
 
 		return v1;
@@ -1353,6 +1728,8 @@ SubExpr::SubExpr(ExprPtr arg_op1, ExprPtr arg_op2)
 		else
 			SetType(std::move(base_result_type));
 		}
+
+	SelectFastFold();
 	}
 
 RemoveFromExpr::RemoveFromExpr(ExprPtr arg_op1, ExprPtr arg_op2)
@@ -1427,6 +1804,8 @@ TimesExpr::TimesExpr(ExprPtr arg_op1, ExprPtr arg_op2)
 		PromoteType(max_type(bt1, bt2), is_vector(op1) || is_vector(op2));
 	else
 		ExprError("requires arithmetic operands");
+
+	SelectFastFold();
 	}
 
 void TimesExpr::Canonicize()
@@ -1481,6 +1860,8 @@ DivideExpr::DivideExpr(ExprPtr arg_op1, ExprPtr arg_op2)
 
 	else
 		ExprError("requires arithmetic operands");
+
+	SelectFastFold();
 	}
 
 ValPtr DivideExpr::AddrFold(Val* v1, Val* v2) const
@@ -1528,6 +1909,8 @@ ModExpr::ModExpr(ExprPtr arg_op1, ExprPtr arg_op2)
 		PromoteType(max_type(bt1, bt2), is_vector(op1) || is_vector(op2));
 	else
 		ExprError("requires integral operands");
+
+	SelectFastFold();
 	}
 
 BoolExpr::BoolExpr(BroExprTag arg_tag, ExprPtr arg_op1, ExprPtr arg_op2)
@@ -1797,6 +2180,8 @@ EqExpr::EqExpr(BroExprTag arg_tag, ExprPtr arg_op1, ExprPtr arg_op2)
 
 	else
 		ExprError("type clash in comparison");
+
+	SelectFastFold();
 	}
 
 void EqExpr::Canonicize()
@@ -1872,6 +2257,8 @@ RelExpr::RelExpr(BroExprTag arg_tag, ExprPtr arg_op1, ExprPtr arg_op2)
 		  bt1 != TYPE_PORT && bt1 != TYPE_ADDR &&
 		  bt1 != TYPE_STRING )
 		ExprError("illegal comparison");
+
+	SelectFastFold();
 	}
 
 void RelExpr::Canonicize()
@@ -2313,11 +2700,13 @@ ValPtr AssignExpr::Eval(Frame* f) const
 
 	if ( auto v = op2->Eval(f) )
 		{
-		op1->Assign(f, v);
-
 		if ( val )
+			{
+			op1->Assign(f, std::move(v));
 			return val;
+			}
 
+		op1->Assign(f, v);
 		return v;
 		}
 	else
@@ -2912,6 +3301,21 @@ TraversalCode IndexExpr::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_EXPR_POST(tc);
 	}
 
+void IndexExprWhen::RecordKey(Val* aggr, Val* index)
+	{
+	if ( evaluating <= 0 || aggr->GetType()->Tag() != TYPE_TABLE )
+		return;
+
+	auto tv = aggr->AsTableVal();
+
+	// Subnet lookups may find entries stored under other indices.
+	if ( tv->Subnets() )
+		return;
+
+	if ( auto k = tv->MakeHashKey(*index) )
+		keys.emplace_back(IntrusivePtr{NewRef{}, tv}, k->Hash());
+	}
+
 FieldExpr::FieldExpr(ExprPtr arg_op, const char* arg_field_name)
 	: UnaryExpr(EXPR_FIELD, std::move(arg_op)),
 	  field_name(util::copy_string(arg_field_name)), td(nullptr), field(0)
@@ -4099,7 +4503,10 @@ ValPtr InExpr::Fold(Val* v1, Val* v2) const
 	if ( is_vector(v2) )
 		res = (bool)v2->AsVectorVal()->At(v1->AsListVal()->Idx(0)->CoerceToUnsigned());
 	else
+		{
+		IndexExprWhen::RecordKey(v2, v1);
 		res = (bool)v2->AsTableVal()->Find({NewRef{}, v1});
+		}
 
 	return val_mgr->Bool(res);
 	}
@@ -4235,6 +4642,10 @@ ValPtr CallExpr::Eval(Frame* f) const
 			}
 		}
 
+	if ( inlined_func && ! g_trace_state.DoTrace() &&
+	     ! plugin_mgr->HavePluginForHook(plugin::HOOK_CALL_FUNCTION) )
+		return EvalInlined(f);
+
 	ValPtr ret;
 	auto func_val = func->Eval(f);
 	auto v = eval_list(f, args.get());
@@ -4257,6 +4668,24 @@ ValPtr CallExpr::Eval(Frame* f) const
 	return ret;
 	}
 
+ValPtr CallExpr::EvalInlined(Frame* f) const
+	{
+	auto v = eval_list(f, args.get());
+
+	if ( ! v )
+		return nullptr;
+
+	// The return expression can't call anything or capture its frame,
+	// so the frame only lives as long as this evaluation.
+	Frame inline_frame(inlined_func->FrameSize(), inlined_func, &*v);
+
+	for ( size_t i = 0; i < v->size(); ++i )
+		inline_frame.SetElement(i, (*v)[i]);
+
+	inlined_ret->RegisterAccess();
+	return inlined_ret->StmtExpr()->Eval(&inline_frame);
+	}
+
 TraversalCode CallExpr::Traverse(TraversalCallback* cb) const
 	{
 	TraversalCode tc = cb->PreExpr(this);
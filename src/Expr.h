@@ -78,6 +78,8 @@ class AssignExpr;
 class CallExpr;
 class EventExpr;
 class Stmt;
+class ReturnStmt;
+class ScriptFunc;
 
 class Expr;
 using ExprPtr = IntrusivePtr<Expr>;
@@ -252,6 +254,9 @@ class UnaryExpr : public Expr {
 public:
 	Expr* Op() const	{ return op.get(); }
 
+	// Replaces the operand with one of the same type.
+	void SetOp(ExprPtr new_op)	{ op = std::move(new_op); }
+
 	// UnaryExpr::Eval correctly handles vector types.  Any child
 	// class that overrides Eval() should be modified to handle
 	// vectors correctly as necessary.
@@ -277,6 +282,10 @@ public:
 	Expr* Op1() const	{ return op1.get(); }
 	Expr* Op2() const	{ return op2.get(); }
 
+	// Replace an operand with one of the same type.
+	void SetOp1(ExprPtr new_op)	{ op1 = std::move(new_op); }
+	void SetOp2(ExprPtr new_op)	{ op2 = std::move(new_op); }
+
 	bool IsPure() const override;
 
 	// BinaryExpr::Eval correctly handles vector types.  Any child
@@ -325,10 +334,19 @@ protected:
 	// operands and also set expression's type).
 	void PromoteType(TypeTag t, bool is_vector);
 
+	// Picks a fold specialized for the operands' static types, if
+	// there's one. Derived constructors call this once they're done
+	// type-checking.
+	void SelectFastFold();
+
 	void ExprDescribe(ODesc* d) const override;
 
 	ExprPtr op1;
 	ExprPtr op2;
+
+	// If set, Eval() uses this instead of Fold(), skipping the latter's
+	// run-time dispatch on the operands' types.
+	ValPtr (*fast_fold)(const BinaryExpr* e, const Val* v1, const Val* v2) = nullptr;
 };
 
 class CloneExpr final : public UnaryExpr {
@@ -509,6 +527,9 @@ public:
 		op2 = std::move(e);
 		}
 
+	bool IsInit() const	{ return is_init; }
+	const ValPtr& GetVal() const	{ return val; }
+
 protected:
 	bool TypeCheck(const AttributesPtr& attrs = nullptr);
 	bool TypeCheckArithmetics(TypeTag bt1, TypeTag bt2);
@@ -559,6 +580,10 @@ public:
 	static inline std::vector<ValPtr> results = {};
 	static inline int evaluating = 0;
 
+	// Tables looked up while evaluating, along with the hashes of the
+	// keys looked up.
+	static inline std::vector<std::pair<TableValPtr, uint64_t>> keys = {};
+
 	static void StartEval()
 		{ ++evaluating; }
 
@@ -572,6 +597,18 @@ public:
 		return rval;
 		}
 
+	static std::vector<std::pair<TableValPtr, uint64_t>> TakeAllKeys()
+		{
+		auto rval = std::move(keys);
+		keys = {};
+		return rval;
+		}
+
+	// Notes a lookup of the given index in the given aggregate, if
+	// evaluating. Only tracks tables that find entries by their exact
+	// index.
+	static void RecordKey(Val* aggr, Val* index);
+
 	IndexExprWhen(ExprPtr op1, ListExprPtr op2, bool is_slice = false)
 	    : IndexExpr(std::move(op1), std::move(op2), is_slice)
 		{ }
@@ -585,6 +622,13 @@ public:
 
 		return v;
 		}
+
+protected:
+	ValPtr Fold(Val* v1, Val* v2) const override
+		{
+		RecordKey(v1, v2);
+		return IndexExpr::Fold(v1, v2);
+		}
 };
 
 class FieldExpr final : public UnaryExpr {
@@ -620,6 +664,7 @@ public:
 	~HasFieldExpr() override;
 
 	const char* FieldName() const	{ return field_name; }
+	int Field() const	{ return field; }
 
 protected:
 	ValPtr Fold(Val* v) const override;
@@ -820,11 +865,26 @@ public:
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
 
+	/**
+	 * Makes the call evaluate the callee's return expression directly,
+	 * rather than invoking the callee. Only valid if the callee always
+	 * is \a f and its body consists of just \a ret.
+	 */
+	void Inline(const ScriptFunc* f, const ReturnStmt* ret)
+		{ inlined_func = f; inlined_ret = ret; }
+
+	const ScriptFunc* InlinedFunc() const	{ return inlined_func; }
+
 protected:
 	void ExprDescribe(ODesc* d) const override;
 
+	ValPtr EvalInlined(Frame* f) const;
+
 	ExprPtr func;
 	ListExprPtr args;
+
+	const ScriptFunc* inlined_func = nullptr;
+	const ReturnStmt* inlined_ret = nullptr;
 };
 
 
@@ -0,0 +1,114 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "FlowTable.h"
+
+#include "Event.h"
+#include "ID.h"
+#include "NetVar.h"
+#include "Val.h"
+
+namespace zeek::detail {
+
+FlowTable::Flow* FlowTable::Lookup(const ConnIDKey& key)
+	{
+	auto it = index.find(key);
+	return it != index.end() ? it->second : nullptr;
+	}
+
+FlowTable::Flow* FlowTable::Insert(const ConnIDKey& key, const IPAddr& orig_addr,
+                                   uint32_t orig_port, const IPAddr& resp_addr,
+                                   uint32_t resp_port, TransportProto proto, double t)
+	{
+	auto& f = flows.emplace_back();
+	f.key = key;
+	f.orig_addr = orig_addr;
+	f.orig_port = orig_port;
+	f.resp_addr = resp_addr;
+	f.resp_port = resp_port;
+	f.proto = proto;
+	f.start_time = f.last_time = t;
+	f.pos = std::prev(flows.end());
+
+	index.emplace(key, &f);
+	return &f;
+	}
+
+void FlowTable::Update(Flow* f, double t, bool is_orig, uint64_t ip_len)
+	{
+	if ( is_orig )
+		{
+		++f->orig_pkts;
+		f->orig_bytes += ip_len;
+		}
+	else
+		{
+		++f->resp_pkts;
+		f->resp_bytes += ip_len;
+		}
+
+	if ( t > f->last_time )
+		f->last_time = t;
+
+	if ( f->pos != std::prev(flows.end()) )
+		flows.splice(flows.end(), flows, f->pos);
+	}
+
+void FlowTable::Remove(Flow* f)
+	{
+	index.erase(f->key);
+	RemovalEvent(*f);
+	flows.erase(f->pos);
+	}
+
+void FlowTable::Expire(double cutoff)
+	{
+	while ( ! flows.empty() && flows.front().last_time < cutoff )
+		Remove(&flows.front());
+	}
+
+void FlowTable::Drain()
+	{
+	for ( const auto& f : flows )
+		RemovalEvent(f);
+
+	Clear();
+	}
+
+void FlowTable::Clear()
+	{
+	index.clear();
+	flows.clear();
+	}
+
+size_t FlowTable::MemoryAllocation() const
+	{
+	// List nodes carry two pointers, hash nodes one plus the bucket array.
+	return flows.size() * (sizeof(Flow) + 2 * sizeof(void*)) +
+		index.size() * (sizeof(ConnIDKey) + 2 * sizeof(void*)) +
+		index.bucket_count() * sizeof(void*);
+	}
+
+void FlowTable::RemovalEvent(const Flow& f)
+	{
+	if ( ! flow_record_remove )
+		return;
+
+	auto id_val = make_intrusive<RecordVal>(id::conn_id);
+	id_val->Assign(0, make_intrusive<AddrVal>(f.orig_addr));
+	id_val->Assign(1, val_mgr->Port(ntohs(f.orig_port), f.proto));
+	id_val->Assign(2, make_intrusive<AddrVal>(f.resp_addr));
+	id_val->Assign(3, val_mgr->Port(ntohs(f.resp_port), f.proto));
+
+	event_mgr.Enqueue(flow_record_remove,
+	                  std::move(id_val),
+	                  make_intrusive<TimeVal>(f.start_time),
+	                  make_intrusive<IntervalVal>(f.last_time - f.start_time),
+	                  val_mgr->Count(f.orig_pkts),
+	                  val_mgr->Count(f.orig_bytes),
+	                  val_mgr->Count(f.resp_pkts),
+	                  val_mgr->Count(f.resp_bytes));
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,105 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+#include "IPAddr.h"
+#include "MemoryTag.h"
+#include "net_util.h"
+
+namespace zeek::detail {
+
+/**
+ * Compact state for UDP and ICMP flows that don't need a full \a Connection,
+ * see the flow_only_udp_icmp option. A flow record only counts packets and
+ * IP bytes per direction and remembers when the flow began and was last
+ * active.
+ *
+ * Flows are kept in the order of their last activity, so expiring the idle
+ * ones only ever looks at the front.
+ */
+class FlowTable {
+public:
+	struct Flow;
+	using FlowList = std::list<Flow, TaggedAllocator<Flow, MemoryTag::Connections>>;
+
+	struct Flow {
+		ConnIDKey key;
+		IPAddr orig_addr;
+		IPAddr resp_addr;
+		uint32_t orig_port, resp_port;	// in network order
+		TransportProto proto;
+		double start_time, last_time;
+		uint64_t orig_pkts = 0, orig_bytes = 0;
+		uint64_t resp_pkts = 0, resp_bytes = 0;
+
+		FlowList::iterator pos;	// in FlowTable::flows
+	};
+
+	/**
+	 * Returns the flow for a key, or nullptr if there's none.
+	 */
+	Flow* Lookup(const ConnIDKey& key);
+
+	/**
+	 * Starts tracking a new flow, with the given addresses and ports as
+	 * its originator and responder. The key mustn't be present yet.
+	 */
+	Flow* Insert(const ConnIDKey& key, const IPAddr& orig_addr, uint32_t orig_port,
+	             const IPAddr& resp_addr, uint32_t resp_port,
+	             TransportProto proto, double t);
+
+	/**
+	 * Accounts for a packet of the flow.
+	 *
+	 * @param f The flow, as returned by Lookup() or Insert().
+	 * @param t The packet's timestamp.
+	 * @param is_orig Whether the originator sent the packet.
+	 * @param ip_len The packet's IP length, including headers.
+	 */
+	void Update(Flow* f, double t, bool is_orig, uint64_t ip_len);
+
+	/**
+	 * Stops tracking a flow, raising flow_record_remove for it.
+	 */
+	void Remove(Flow* f);
+
+	/**
+	 * Removes all flows that were last active before the given time,
+	 * raising flow_record_remove for each.
+	 */
+	void Expire(double cutoff);
+
+	/**
+	 * Raises flow_record_remove for all flows, in the order of their last
+	 * activity, and then removes them.
+	 */
+	void Drain();
+
+	/**
+	 * Removes all flows without raising events.
+	 */
+	void Clear();
+
+	size_t Size() const	{ return index.size(); }
+	size_t MemoryAllocation() const;
+
+private:
+	struct KeyHash {
+		size_t operator()(const ConnIDKey& k) const	{ return k.hash; }
+	};
+
+	void RemovalEvent(const Flow& f);
+
+	// Least recently active first.
+	FlowList flows;
+	std::unordered_map<ConnIDKey, Flow*, KeyHash, std::equal_to<ConnIDKey>,
+	                   TaggedAllocator<std::pair<const ConnIDKey, Flow*>,
+	                                   MemoryTag::Connections>> index;
+};
+
+} // namespace zeek::detail
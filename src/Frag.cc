@@ -15,6 +15,28 @@ constexpr uint32_t MAX_ACCEPTABLE_FRAG_SIZE = 64000;
 
 namespace zeek::detail {
 
+size_t FragReassemblerKeyHash::operator()(const FragReassemblerKey& k) const
+	{
+	struct {
+		uint32_t src[4];
+		uint32_t dst[4];
+		uint64_t id;
+	} buf;
+
+	std::get<0>(k).CopyIPv6(buf.src);
+	std::get<1>(k).CopyIPv6(buf.dst);
+	buf.id = std::get<2>(k);
+
+	return KeyedHash::Hash64(&buf, sizeof(buf));
+	}
+
+size_t FragSourceHash::operator()(const IPAddr& a) const
+	{
+	uint32_t buf[4];
+	a.CopyIPv6(buf);
+	return KeyedHash::Hash64(buf, sizeof(buf));
+	}
+
 FragTimer::~FragTimer()
 	{
 	if ( f )
@@ -189,6 +211,14 @@ void FragReassembler::Overlap(const u_char* b1, const u_char* b2, uint64_t n)
 		Weird("fragment_overlap");
 	}
 
+void FragReassembler::Evict()
+	{
+	// Without its fragments so far the datagram can't complete anymore;
+	// the timer takes care of the rest.
+	Weird("reassembly_memory_budget_exceeded");
+	ClearBlocks();
+	}
+
 void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
 	{
 	auto it = block_list.Begin();
@@ -355,8 +385,21 @@ FragReassembler* FragmentManager::NextFragment(double t, const std::unique_ptr<I
 
 	if ( ! f )
 		{
+		if ( frag_max_per_source > 0 )
+			{
+			auto& n = per_source[ip->SrcAddr()];
+
+			if ( n >= static_cast<uint32_t>(frag_max_per_source) )
+				{
+				sessions->Weird("fragment_source_limit_exceeded", ip.get());
+				return nullptr;
+				}
+
+			++n;
+			}
+
 		f = new FragReassembler(sessions, ip, pkt, key, t);
-		fragments[key] = f;
+		fragments.emplace(key, f);
 		if ( fragments.size() > max_fragments )
 			max_fragments = fragments.size();
 		return f;
@@ -372,6 +415,7 @@ void FragmentManager::Clear()
 		Unref(entry.second);
 
 	fragments.clear();
+	per_source.clear();
 	}
 
 void FragmentManager::Remove(detail::FragReassembler* f)
@@ -382,12 +426,22 @@ void FragmentManager::Remove(detail::FragReassembler* f)
 	if ( fragments.erase(f->Key()) == 0 )
 		reporter->InternalWarning("fragment reassembler not in dict");
 
+	else if ( frag_max_per_source > 0 )
+		{
+		auto it = per_source.find(std::get<0>(f->Key()));
+
+		if ( it != per_source.end() && --it->second == 0 )
+			per_source.erase(it);
+		}
+
 	Unref(f);
 	}
 
 uint32_t FragmentManager::MemoryAllocation() const
 	{
-	return fragments.size() * (sizeof(FragmentMap::key_type) + sizeof(FragmentMap::value_type));
+	return fragments.size() * (sizeof(FragmentMap::key_type) + sizeof(FragmentMap::value_type)) +
+		fragments.bucket_count() * sizeof(void*) +
+		per_source.size() * (sizeof(IPAddr) + sizeof(uint32_t));
 	}
 
 } // namespace zeek::detail
@@ -8,6 +8,7 @@
 #include "Timer.h"
 
 #include <tuple>
+#include <unordered_map>
 
 #include <sys/types.h> // for u_char
 
@@ -20,6 +21,15 @@ namespace zeek::detail {
 
 using FragReassemblerKey = std::tuple<IPAddr, IPAddr, bro_uint_t>;
 
+// Fragments are attacker-controlled, so these use the keyed hash.
+struct FragReassemblerKeyHash {
+	size_t operator()(const FragReassemblerKey& k) const;
+};
+
+struct FragSourceHash {
+	size_t operator()(const IPAddr& a) const;
+};
+
 class FragReassembler : public Reassembler {
 public:
 	FragReassembler(NetSessions* s, const std::unique_ptr<IP_Hdr>& ip, const u_char* pkt,
@@ -38,6 +48,7 @@ public:
 protected:
 	void BlockInserted(DataBlockMap::const_iterator it) override;
 	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
+	void Evict() override;
 	void Weird(const char* name) const;
 
 	u_char* proto_hdr;
@@ -73,6 +84,11 @@ public:
 	FragmentManager() = default;
 	~FragmentManager();
 
+	/**
+	 * Adds a fragment to the reassembler for its datagram, creating one
+	 * if needed. Returns nullptr if the fragment got dropped because its
+	 * source has reached frag_max_per_source datagrams in reassembly.
+	 */
 	FragReassembler* NextFragment(double t, const std::unique_ptr<IP_Hdr>& ip,
 	                              const u_char* pkt);
 	void Clear();
@@ -84,8 +100,13 @@ public:
 
 private:
 
-	using FragmentMap = std::map<detail::FragReassemblerKey, detail::FragReassembler*>;
+	using FragmentMap = std::unordered_map<detail::FragReassemblerKey, detail::FragReassembler*,
+	                                       detail::FragReassemblerKeyHash>;
 	FragmentMap fragments;
+
+	// Number of reassemblers per source address, if frag_max_per_source
+	// is set.
+	std::unordered_map<IPAddr, uint32_t, FragSourceHash> per_source;
 	size_t max_fragments = 0;
 };
 
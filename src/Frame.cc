@@ -18,7 +18,16 @@ namespace zeek::detail {
 Frame::Frame(int arg_size, const ScriptFunc* func, const zeek::Args* fn_args)
 	{
 	size = arg_size;
-	frame = std::make_unique<Element[]>(size);
+
+	if ( size <= MAX_POOLED_FRAME_SIZE && ! FreeElements(size).empty() )
+		{
+		auto& pool = FreeElements(size);
+		frame = std::move(pool.back());
+		pool.pop_back();
+		}
+	else
+		frame = std::make_unique<Element[]>(size);
+
 	function = func;
 	func_args = fn_args;
 
@@ -50,7 +59,52 @@ Frame::~Frame()
 		Unref(i);
 
 	for ( int i = 0; i < size; ++i )
+		{
 		ClearElement(i);
+		frame[i].weak_ref = false;
+		}
+
+	if ( size <= MAX_POOLED_FRAME_SIZE )
+		{
+		auto& pool = FreeElements(size);
+
+		if ( pool.size() < MAX_POOLED_FRAMES )
+			pool.emplace_back(std::move(frame));
+		}
+	}
+
+void* Frame::operator new(size_t size)
+	{
+	auto& pool = FreeFrames();
+
+	if ( size != sizeof(Frame) || pool.empty() )
+		return ::operator new(size);
+
+	void* ptr = pool.back();
+	pool.pop_back();
+	return ptr;
+	}
+
+void Frame::operator delete(void* ptr, size_t size)
+	{
+	auto& pool = FreeFrames();
+
+	if ( size != sizeof(Frame) || pool.size() >= MAX_POOLED_FRAMES )
+		::operator delete(ptr);
+	else
+		pool.push_back(ptr);
+	}
+
+std::vector<void*>& Frame::FreeFrames()
+	{
+	static auto pool = new std::vector<void*>;
+	return *pool;
+	}
+
+std::vector<std::unique_ptr<Frame::Element[]>>& Frame::FreeElements(int size)
+	{
+	static auto pools = new std::vector<std::unique_ptr<Element[]>>[MAX_POOLED_FRAME_SIZE + 1];
+	return pools[size];
 	}
 
 void Frame::AddFunctionWithClosureRef(ScriptFunc* func)
@@ -188,6 +242,41 @@ Frame* Frame::Clone() const
 	return other;
 	}
 
+Frame* Frame::Clone(const std::vector<const ID*>& ids) const
+	{
+	Frame* other = new Frame(size, function, func_args);
+
+	if ( offset_map )
+		other->offset_map = std::make_unique<OffsetMap>(*offset_map);
+
+	other->CaptureClosure(closure, outer_ids);
+
+	other->call = call;
+	other->trigger = trigger;
+
+	for ( const auto& id : ids )
+		{
+		// Those are shared with the closure, as in Clone().
+		if ( closure && IsOuterID(id) )
+			continue;
+
+		int offset = id->Offset();
+
+		if ( offset_map && ! offset_map->empty() )
+			{
+			auto where = offset_map->find(std::string(id->Name()));
+
+			if ( where != offset_map->end() )
+				offset = where->second;
+			}
+
+		if ( offset < size && frame[offset].val && ! other->frame[offset].val )
+			other->frame[offset].val = frame[offset].val->Clone();
+		}
+
+	return other;
+	}
+
 static bool val_is_func(const ValPtr& v, ScriptFunc* func)
 	{
 	if ( v->GetType()->Tag() != TYPE_FUNC )
@@ -53,6 +53,13 @@ public:
 	 */
 	virtual ~Frame() override;
 
+	// Frames and their element arrays get recycled through free lists
+	// rather than going back to the heap, most recently released first.
+	// A frame that something holds on to, like a closure or a trigger,
+	// only returns there once the last reference to it goes away.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	/**
 	 * @param n the index to get.
 	 * @return the value at index *n* of the underlying array.
@@ -161,6 +168,16 @@ public:
 	 */
 	Frame* Clone() const;
 
+	/**
+	 * Like Clone(), but only copies the values of the given IDs, which
+	 * are null in the copy otherwise. Used for "when" statements, which
+	 * know the locals they reference.
+	 *
+	 * @param ids the IDs whose values to copy.
+	 * @return a copy of this frame.
+	 */
+	Frame* Clone(const std::vector<const ID*>& ids) const;
+
 	/**
 	 * Clones a Frame, only making copies of the values associated with
 	 * the IDs in selection. Cloning a frame does not deep-copy its
@@ -261,6 +278,15 @@ private:
 		bool weak_ref;
 	};
 
+	// Upper bounds on what we keep around for reuse.
+	static constexpr size_t MAX_POOLED_FRAMES = 1024;
+	static constexpr int MAX_POOLED_FRAME_SIZE = 32;
+
+	// The free lists. They're never destroyed, so that frames released
+	// during shutdown can still go back to them.
+	static std::vector<void*>& FreeFrames();
+	static std::vector<std::unique_ptr<Element[]>>& FreeElements(int size);
+
 	const ValPtr& GetElementByID(const ID* id) const;
 
 	/**
@@ -34,6 +34,7 @@
 #include <broker/error.hh>
 
 #include "Base64.h"
+#include "ByteCode.h"
 #include "Debug.h"
 #include "Desc.h"
 #include "Expr.h"
@@ -43,6 +44,7 @@
 #include "NetVar.h"
 #include "File.h"
 #include "Frame.h"
+#include "ScriptProfiler.h"
 #include "Var.h"
 #include "analyzer/protocol/login/Login.h"
 #include "Sessions.h"
@@ -365,6 +367,10 @@ ValPtr ScriptFunc::Invoke(zeek::Args* args, Frame* parent) const
 		f->SetCall(parent->GetCall());
 		}
 
+	// A sample due when entering scripts from the core belongs to the core.
+	if ( g_frame_stack.empty() && ScriptProfiler::SampleDue() )
+		script_profiler.SampleOutsideScripts();
+
 	g_frame_stack.push_back(f.get());	// used for backtracing
 	const CallExpr* call_expr = parent ? parent->GetCall() : nullptr;
 	call_stack.emplace_back(CallInfo{call_expr, this, *args});
@@ -401,7 +407,10 @@ ValPtr ScriptFunc::Invoke(zeek::Args* args, Frame* parent) const
 
 		try
 			{
-			result = body.stmts->Exec(f.get(), flow);
+			if ( body.compiled )
+				result = body.compiled->Exec(f.get(), flow);
+			else
+				result = body.stmts->Exec(f.get(), flow);
 			}
 
 		catch ( InterpreterException& e )
@@ -501,6 +510,28 @@ void ScriptFunc::AddBody(StmtPtr new_body,
 	sort(bodies.begin(), bodies.end());
 	}
 
+int ScriptFunc::CompileBodies()
+	{
+	// Leave closures to the AST, their frames get shared around.
+	if ( closure || outer_ids.length() > 0 )
+		return 0;
+
+	int n = 0;
+
+	for ( auto& body : bodies )
+		{
+		if ( body.compiled )
+			continue;
+
+		body.compiled = ByteCode::Compile(body.stmts.get());
+
+		if ( body.compiled )
+			++n;
+		}
+
+	return n;
+	}
+
 void ScriptFunc::AddClosure(IDPList ids, Frame* f)
 	{
 	if ( ! f )
@@ -917,6 +948,11 @@ void init_primary_bifs()
 	DNSStats = id::find_type<RecordType>("DNSStats");
 	GapStats = id::find_type<RecordType>("GapStats");
 	EventStats = id::find_type<RecordType>("EventStats");
+	EventHandlerStats = id::find_type<RecordType>("EventHandlerStats");
+	MemoryTagStats = id::find_type<RecordType>("MemoryTagStats");
+	AnalyzerStats = id::find_type<RecordType>("AnalyzerStats");
+	TableStats = id::find_type<RecordType>("TableStats");
+	LogWriterStats = id::find_type<RecordType>("LogWriterStats");
 	TimerStats = id::find_type<RecordType>("TimerStats");
 	FileAnalysisStats = id::find_type<RecordType>("FileAnalysisStats");
 	ThreadStats = id::find_type<RecordType>("ThreadStats");
@@ -24,6 +24,7 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(CallExpr, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(ID, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(FuncType, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Frame, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(ByteCode, zeek::detail);
 
 namespace caf {
 template <class> class expected;
@@ -65,6 +66,7 @@ public:
 
 	struct Body {
 		detail::StmtPtr stmts;
+		std::shared_ptr<detail::ByteCode> compiled;	// If set, runs instead of stmts.
 		int priority;
 		bool operator<(const Body& other) const
 			{ return priority > other.priority; } // reverse sort
@@ -94,7 +96,7 @@ public:
 		ValPtr>
 	Invoke(Args&&... args) const
 		{
-		auto zargs = zeek::Args{std::forward<Args>(args)...};
+		auto zargs = zeek::make_args(std::forward<Args>(args)...);
 		return Invoke(&zargs);
 		}
 
@@ -193,10 +195,19 @@ public:
 	             const std::vector<IDPtr>& new_inits,
 	             size_t new_frame_size, int priority) override;
 
+	size_t FrameSize() const	{ return frame_size; }
+
 	/** Sets this function's outer_id list. */
 	void SetOuterIDs(IDPList ids)
 		{ outer_ids = std::move(ids); }
 
+	/**
+	 * Lowers the function's bodies to bytecode, where that's worth it.
+	 *
+	 * @return The number of bodies lowered.
+	 */
+	int CompileBodies();
+
 	void Describe(ODesc* d) const override;
 
 protected:
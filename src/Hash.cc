@@ -13,6 +13,8 @@
 #include "highwayhash/highwayhash_target.h"
 #include "highwayhash/instruction_sets.h"
 
+#include "3rdparty/doctest.h"
+
 namespace zeek::detail {
 
 alignas(32) uint64_t KeyedHash::shared_highwayhash_key[4];
@@ -93,7 +95,6 @@ HashKey::HashKey(bro_int_t i)
 	key_u.i = i;
 	key = (void*) &key_u;
 	size = sizeof(i);
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(bro_uint_t u)
@@ -101,7 +102,6 @@ HashKey::HashKey(bro_uint_t u)
 	key_u.i = bro_int_t(u);
 	key = (void*) &key_u;
 	size = sizeof(u);
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(uint32_t u)
@@ -109,14 +109,12 @@ HashKey::HashKey(uint32_t u)
 	key_u.u32 = u;
 	key = (void*) &key_u;
 	size = sizeof(u);
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(const uint32_t u[], int n)
 	{
 	size = n * sizeof(u[0]);
 	key = (void*) u;
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(double d)
@@ -129,7 +127,6 @@ HashKey::HashKey(double d)
 	key_u.d = u.d = d;
 	key = (void*) &key_u;
 	size = sizeof(d);
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(const void* p)
@@ -137,45 +134,40 @@ HashKey::HashKey(const void* p)
 	key_u.p = p;
 	key = (void*) &key_u;
 	size = sizeof(p);
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(const char* s)
 	{
 	size = strlen(s);	// note - skip final \0
 	key = (void*) s;
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(const String* s)
 	{
 	size = s->Len();
 	key = (void*) s->Bytes();
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(int copy_key, void* arg_key, int arg_size)
 	{
 	size = arg_size;
-	is_our_dynamic = true;
 
 	if ( copy_key )
-		{
-		key = (void*) new char[size];
-		memcpy(key, arg_key, size);
-		}
+		StoreKey(arg_key);
 	else
+		{
 		key = arg_key;
+		is_our_dynamic = true;
+		}
 
-	hash = HashBytes(key, size);
 	}
 
 HashKey::HashKey(const void* arg_key, int arg_size, hash_t arg_hash)
 	{
 	size = arg_size;
 	hash = arg_hash;
-	key = CopyKey(arg_key, size);
-	is_our_dynamic = true;
+	hashed = true;
+	StoreKey(arg_key);
 	}
 
 HashKey::HashKey(const void* arg_key, int arg_size, hash_t arg_hash,
@@ -183,15 +175,14 @@ HashKey::HashKey(const void* arg_key, int arg_size, hash_t arg_hash,
 	{
 	size = arg_size;
 	hash = arg_hash;
+	hashed = true;
 	key = const_cast<void*>(arg_key);
 	}
 
 HashKey::HashKey(const void* bytes, int arg_size)
 	{
 	size = arg_size;
-	key = CopyKey(bytes, size);
-	hash = HashBytes(key, size);
-	is_our_dynamic = true;
+	StoreKey(bytes);
 	}
 
 void* HashKey::TakeKey()
@@ -212,9 +203,81 @@ void* HashKey::CopyKey(const void* k, int s) const
 	return k_copy;
 	}
 
+void HashKey::StoreKey(const void* k)
+	{
+	if ( size <= INLINE_KEY_SIZE )
+		{
+		memcpy(key_u.bytes, k, size);
+		key = (void*) &key_u;
+		}
+	else
+		{
+		key = CopyKey(k, size);
+		is_our_dynamic = true;
+		}
+	}
+
 hash_t HashKey::HashBytes(const void* bytes, int size)
 	{
 	return KeyedHash::Hash64(bytes, size);
 	}
 
+// Multiplies and folds the 128-bit product, as wyhash does.
+static inline uint64_t fast_hash_mix(uint64_t a, uint64_t b)
+	{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = static_cast<__uint128_t>(a) * b;
+	return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#else
+	uint64_t r = a * b;
+	return r ^ (r >> 32) ^ b;
+#endif
+	}
+
+hash_t HashKey::FastHashBytes(const void* bytes, int size)
+	{
+	constexpr uint64_t p0 = 0xa0761d6478bd642full;
+	constexpr uint64_t p1 = 0xe7037ed1a0b428dbull;
+
+	auto p = static_cast<const unsigned char*>(bytes);
+	uint64_t h = p0 ^ static_cast<uint64_t>(size);
+
+	for ( ; size >= 8; p += 8, size -= 8 )
+		{
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+		h = fast_hash_mix(h ^ w, p1);
+		}
+
+	if ( size > 0 )
+		{
+		uint64_t w = 0;
+		memcpy(&w, p, size);
+		h = fast_hash_mix(h ^ w, p1);
+		}
+
+	return fast_hash_mix(h, p0);
+	}
+
 } // namespace zeek::detail
+
+TEST_CASE("hash key inline storage")
+	{
+	uint32_t addr[4] = { 1, 2, 3, 4 };
+	char big[zeek::detail::HashKey::INLINE_KEY_SIZE + 1] = { 0 };
+
+	zeek::detail::HashKey k1(addr, sizeof(addr));
+	zeek::detail::HashKey k2(big, sizeof(big));
+
+	// The copy is independent of the original bytes.
+	CHECK(k1.Key() != addr);
+	CHECK(memcmp(k1.Key(), addr, sizeof(addr)) == 0);
+	CHECK(k1.Hash() == zeek::detail::HashKey::HashBytes(addr, sizeof(addr)));
+	CHECK(k2.Size() == sizeof(big));
+
+	// Handing over an inline key gives the caller a copy of its own.
+	void* taken = k1.TakeKey();
+	CHECK(taken != k1.Key());
+	CHECK(memcmp(taken, addr, sizeof(addr)) == 0);
+	delete [] (char*) taken;
+	}
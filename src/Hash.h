@@ -230,7 +230,7 @@ public:
 	// Create a HashKey given all of its components.  "key" is assumed
 	// to be dynamically allocated and to now belong to this HashKey
 	// (to delete upon destruct'ing).  If "copy_key" is true, it's
-	// first copied.
+	// first copied, into inline storage if it fits.
 	//
 	// The calling sequence here is unusual (normally key would be
 	// first) to avoid possible ambiguities with the next constructor,
@@ -240,7 +240,9 @@ public:
 	// Same, but automatically copies the key.
 	HashKey(const void* key, int size, hash_t hash);
 
-	// Builds a key from the given chunk of bytes.
+	// Builds a key from the given chunk of bytes. Keys of up to
+	// INLINE_KEY_SIZE bytes, such as addresses or an address and a
+	// port, are kept inline without a heap allocation.
 	HashKey(const void* bytes, int size);
 
 	// Create a Hashkey given all of its components *without*
@@ -257,25 +259,50 @@ public:
 
 	const void* Key() const	{ return key; }
 	int Size() const	{ return size; }
-	hash_t Hash() const	{ return hash; }
+
+	// The keyed hash is computed on first use, so that keys for
+	// dictionaries with the FAST_HASH policy never pay for it.
+	hash_t Hash() const
+		{
+		if ( ! hashed )
+			{
+			hash = HashBytes(key, size);
+			hashed = true;
+			}
+
+		return hash;
+		}
 
 	unsigned int MemoryAllocation() const	{ return padded_sizeof(*this) + util::pad_size(size); }
 
 	static hash_t HashBytes(const void* bytes, int size);
+
+	// A fast, unkeyed hash for keys an attacker can't choose. Not
+	// resistant to collision attacks.
+	static hash_t FastHashBytes(const void* bytes, int size);
+
+	// Largest key that's copied into inline storage.
+	static constexpr int INLINE_KEY_SIZE = 32;
+
 protected:
 	void* CopyKey(const void* key, int size) const;
 
+	// Copies a key of the current size into our own storage.
+	void StoreKey(const void* key);
+
 	union {
 		bro_int_t i;
 		uint32_t u32;
 		double d;
 		const void* p;
+		char bytes[INLINE_KEY_SIZE];
 	} key_u;
 
 	void* key;
-	hash_t hash;
+	mutable hash_t hash = 0;
 	int size;
 	bool is_our_dynamic = false;
+	mutable bool hashed = false;
 };
 
 extern void init_hash_function();
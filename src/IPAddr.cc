@@ -1,5 +1,6 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <cstddef>
 #include <cstdlib>
 #include <string>
 #include <vector>
@@ -42,6 +43,20 @@ detail::ConnIDKey detail::BuildConnIDKey(const ConnID& id)
 		key.port2 = id.src_port;
 		}
 
+	if ( key.IsIPv4() )
+		{
+		// Hash just the parts that differ between IPv4 connections,
+		// a third of the full key.
+		uint8_t packed[12];
+		memcpy(packed, &key.ip1.s6_addr[12], 4);
+		memcpy(packed + 4, &key.ip2.s6_addr[12], 4);
+		memcpy(packed + 8, &key.port1, 2);
+		memcpy(packed + 10, &key.port2, 2);
+		key.hash = static_cast<uint32_t>(KeyedHash::Hash64(packed, sizeof(packed)));
+		}
+	else
+		key.hash = static_cast<uint32_t>(KeyedHash::Hash64(&key, offsetof(ConnIDKey, hash)));
+
 	return key;
 	}
 
@@ -29,13 +29,27 @@ struct ConnIDKey {
 	in6_addr ip2;
 	uint16_t port1;
 	uint16_t port2;
+	uint32_t hash;	// Precomputed over the fields above, see BuildConnIDKey().
 
-	ConnIDKey() : port1(0), port2(0)
+	ConnIDKey() : port1(0), port2(0), hash(0)
 		{
 		memset(&ip1, 0, sizeof(in6_addr));
 		memset(&ip2, 0, sizeof(in6_addr));
 		}
 
+	/**
+	 * Returns true if both addresses are IPv4 (i.e., v4-mapped).
+	 */
+	bool IsIPv4() const
+		{
+		static constexpr uint8_t v4_mapped_prefix[12] = { 0, 0, 0, 0,
+		                                                  0, 0, 0, 0,
+		                                                  0, 0, 0xff, 0xff };
+
+		return memcmp(ip1.s6_addr, v4_mapped_prefix, 12) == 0 &&
+		       memcmp(ip2.s6_addr, v4_mapped_prefix, 12) == 0;
+		}
+
 	bool operator<(const ConnIDKey& rhs) const { return memcmp(this, &rhs, sizeof(ConnIDKey)) < 0; }
 	bool operator==(const ConnIDKey& rhs) const { return memcmp(this, &rhs, sizeof(ConnIDKey)) == 0; }
 
@@ -49,7 +63,7 @@ struct ConnIDKey {
 };
 
 /**
- * Returns a map key for a given ConnID.
+ * Returns a map key for a given ConnID, including its hash value.
  */
 ConnIDKey BuildConnIDKey(const ConnID& id);
 
@@ -734,6 +748,24 @@ private:
 
 } // namespace zeek
 
+namespace std {
+
+template<> struct hash<zeek::IPAddr> {
+	size_t operator()(const zeek::IPAddr& addr) const noexcept
+		{
+		const uint32_t* bytes;
+		int n = addr.GetBytes(&bytes);
+		size_t h = n;
+
+		for ( int i = 0; i < n; ++i )
+			h = h * 0x9e3779b97f4a7c15ULL ^ bytes[i];
+
+		return h;
+		}
+};
+
+} // namespace std
+
 using ConnIDKey [[deprecated("Remove in v4.1. Use zeek::detail::ConnIDKey.")]] = zeek::detail::ConnIDKey;
 using IPAddr [[deprecated("Remove in v4.1. Use zeek::IPAddr.")]] = zeek::IPAddr;
 using IPPrefix [[deprecated("Remove in v4.1. Use zeek::IPPrefix.")]] = zeek::IPPrefix;
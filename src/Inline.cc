@@ -0,0 +1,199 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "Inline.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Debug.h"
+#include "DebugLogger.h"
+#include "Expr.h"
+#include "Func.h"
+#include "ID.h"
+#include "NetVar.h"
+#include "Reporter.h"
+#include "Scope.h"
+#include "Stmt.h"
+#include "Traverse.h"
+#include "Val.h"
+
+namespace zeek::detail {
+
+// Functions whose return expression has more nodes than this stay calls.
+static constexpr int MAX_INLINE_SIZE = 16;
+
+namespace {
+
+// Checks whether an expression is fit for inlining: small, and neither
+// calling out nor creating anything that might hold on to its frame.
+class InlineSizeCheck : public TraversalCallback {
+public:
+	TraversalCode PreExpr(const Expr* e) override
+		{
+		switch ( e->Tag() ) {
+		case EXPR_CALL:
+		case EXPR_EVENT:
+		case EXPR_SCHEDULE:
+		case EXPR_LAMBDA:
+			ok = false;
+			return TC_ABORTALL;
+
+		default:
+			break;
+		}
+
+		if ( ++size > MAX_INLINE_SIZE )
+			{
+			ok = false;
+			return TC_ABORTALL;
+			}
+
+		return TC_CONTINUE;
+		}
+
+	bool ok = true;
+	int size = 0;
+};
+
+// Marks the call sites of inlinable functions.
+class InlineCallFinder : public TraversalCallback {
+public:
+	TraversalCode PreExpr(const Expr* e) override
+		{
+		if ( e->Tag() != EXPR_CALL )
+			return TC_CONTINUE;
+
+		auto c = static_cast<const CallExpr*>(e);
+		auto sf = Callee(c);
+
+		if ( ! sf )
+			return TC_CONTINUE;
+
+		auto ret = Candidate(sf);
+
+		if ( ! ret )
+			return TC_CONTINUE;
+
+		const_cast<CallExpr*>(c)->Inline(sf, ret);
+		++inlined[sf->Name()];
+
+		return TC_CONTINUE;
+		}
+
+	// Number of inlined call sites per function.
+	std::map<std::string, int> inlined;
+
+private:
+	// Returns the script function a call always goes to, if any.
+	const ScriptFunc* Callee(const CallExpr* c) const
+		{
+		if ( c->IsError() || c->Func()->Tag() != EXPR_NAME )
+			return nullptr;
+
+		auto id = static_cast<const NameExpr*>(c->Func())->Id();
+
+		if ( ! id->IsGlobal() || ! id->IsConst() || ! id->HasVal() ||
+		     id->GetType()->Tag() != TYPE_FUNC )
+			return nullptr;
+
+		auto func = id->GetVal()->AsFunc();
+
+		if ( func->GetKind() != Func::SCRIPT_FUNC ||
+		     func->Flavor() != FUNC_FLAVOR_FUNCTION )
+			return nullptr;
+
+		auto sf = static_cast<const ScriptFunc*>(func);
+		auto num_params = sf->GetType()->Params()->NumFields();
+
+		if ( c->Args()->Exprs().length() != num_params )
+			return nullptr;
+
+		return sf;
+		}
+
+	// Returns the return statement of an inlinable function, or null.
+	const ReturnStmt* Candidate(const ScriptFunc* sf)
+		{
+		if ( auto it = candidates.find(sf); it != candidates.end() )
+			return it->second;
+
+		return candidates[sf] = FindCandidate(sf);
+		}
+
+	const ReturnStmt* FindCandidate(const ScriptFunc* sf) const
+		{
+		const auto& bodies = sf->GetBodies();
+
+		if ( bodies.size() != 1 )
+			return nullptr;
+
+		const Stmt* s = bodies[0].stmts.get();
+
+		while ( s->Tag() == STMT_LIST )
+			{
+			const auto& stmts = static_cast<const StmtList*>(s)->Stmts();
+
+			if ( stmts.length() != 1 )
+				return nullptr;
+
+			s = stmts[0];
+			}
+
+		if ( s->Tag() != STMT_RETURN )
+			return nullptr;
+
+		auto ret = static_cast<const ReturnStmt*>(s);
+		auto e = ret->StmtExpr();
+
+		if ( ! e || e->IsError() )
+			return nullptr;
+
+		InlineSizeCheck check;
+		e->Traverse(&check);
+
+		return check.ok ? ret : nullptr;
+		}
+
+	std::unordered_map<const ScriptFunc*, const ReturnStmt*> candidates;
+};
+
+} // namespace
+
+void inline_script_function_calls()
+	{
+	// The debugger needs to see every call go by.
+	if ( ! inline_script_functions || g_policy_debug )
+		return;
+
+	InlineCallFinder finder;
+	std::unordered_set<const Func*> seen;
+
+	for ( const auto& [name, id] : global_scope()->Vars() )
+		{
+		if ( ! id->HasVal() || id->GetType()->Tag() != TYPE_FUNC )
+			continue;
+
+		auto func = id->GetVal()->AsFunc();
+
+		if ( func->GetKind() != Func::SCRIPT_FUNC || ! seen.insert(func).second )
+			continue;
+
+		for ( const auto& body : func->GetBodies() )
+			body.stmts->Traverse(&finder);
+		}
+
+	for ( const auto& [name, n] : finder.inlined )
+		{
+		DBG_LOG(DBG_SCRIPTS, "inlined %s at %d call sites", name.c_str(), n);
+
+		if ( inline_report )
+			reporter->Info("inlined %s at %d call site%s", name.c_str(), n,
+			               n == 1 ? "" : "s");
+		}
+	}
+
+} // namespace zeek::detail
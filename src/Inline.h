@@ -0,0 +1,16 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+namespace zeek::detail {
+
+/**
+ * Inlines calls to small, non-recursive script functions into their
+ * callers, if the inline_script_functions option is set. A function
+ * qualifies if its body is a single return of an expression that
+ * doesn't call anything else. Its call sites then evaluate that
+ * expression directly, skipping \a ScriptFunc::Invoke().
+ */
+extern void inline_script_function_calls();
+
+} // namespace zeek::detail
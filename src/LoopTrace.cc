@@ -0,0 +1,146 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "LoopTrace.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "Reporter.h"
+#include "util.h"
+
+namespace zeek::detail {
+
+// The minimum time between two dumps because of stalls, for stalls that
+// keep recurring.
+static constexpr double STALL_DUMP_INTERVAL = 60;
+
+LoopTrace::LoopTrace(std::string arg_file, uint64_t size, double stall_msec)
+	: file(std::move(arg_file))
+	{
+	uint64_t n = 1;
+
+	while ( n < size )
+		n <<= 1;
+
+	ring = std::make_unique<LoopTraceRecord[]>(n);
+	mask = n - 1;
+
+	start_ticks = Now();
+	start_time = std::chrono::steady_clock::now();
+
+	// Calibrate the time-stamp counter for the stall threshold. Dumps
+	// re-estimate the rate over the longer time passed by then.
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	stall_ticks = static_cast<uint64_t>(TicksPerSecond() * stall_msec / 1000);
+
+	struct sigaction action;
+	action.sa_handler = HandleSignal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	if ( sigaction(SIGUSR2, &action, &old_action) < 0 )
+		reporter->Error("failed to install loop trace signal handler: %s", strerror(errno));
+	else
+		have_handler = true;
+	}
+
+LoopTrace::~LoopTrace()
+	{
+	if ( have_handler )
+		sigaction(SIGUSR2, &old_action, nullptr);
+	}
+
+void LoopTrace::HandleSignal(int /* signo */)
+	{
+	dump_due = 1;
+	}
+
+double LoopTrace::TicksPerSecond() const
+	{
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+	if ( secs <= 0 )
+		return 1e9;
+
+	return (Now() - start_ticks) / secs;
+	}
+
+uint32_t LoopTrace::SourceID(const char* tag)
+	{
+	auto [it, inserted] = source_ids.emplace(tag, source_names.size());
+
+	if ( inserted )
+		source_names.emplace_back(tag);
+
+	return it->second;
+	}
+
+void LoopTrace::IterationDone(uint64_t start, uint32_t ready)
+	{
+	auto now = Now();
+	auto ticks = now - start;
+	Record(LoopTraceType::ITERATION, ready, ticks, now);
+
+	if ( ticks > stall_ticks )
+		{
+		Record(LoopTraceType::STALL, 0, ticks, now);
+
+		if ( ! last_stall_dump ||
+		     now - last_stall_dump > STALL_DUMP_INTERVAL * TicksPerSecond() )
+			{
+			last_stall_dump = now;
+			Dump();
+			}
+		}
+
+	if ( dump_due )
+		Dump();
+	}
+
+bool LoopTrace::Dump()
+	{
+	dump_due = 0;
+
+	auto fn = util::fmt("%s.%d", file.c_str(), ++num_dumps);
+	FILE* f = fopen(fn, "wb");
+
+	if ( ! f )
+		{
+		reporter->Error("Failed to open ZEEK_LOOP_TRACE_FILE destination '%s' for writing", fn);
+		return false;
+		}
+
+	uint64_t size = mask + 1;
+	uint64_t num = next < size ? next : size;
+
+	LoopTraceHeader hdr = {};
+	memcpy(hdr.magic, "ZLTR", 4);
+	hdr.version = LOOP_TRACE_VERSION;
+	hdr.num_records = num;
+	hdr.num_sources = source_names.size();
+	hdr.ticks_per_second = TicksPerSecond();
+	hdr.dump_ticks = Now();
+	hdr.dump_time = util::current_time(true);
+
+	bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+
+	for ( const auto& name : source_names )
+		ok = ok && fwrite(name.c_str(), name.size() + 1, 1, f) == 1;
+
+	// Oldest first.
+	uint64_t first = next - num;
+
+	for ( uint64_t i = first; ok && i < next; ++i )
+		ok = fwrite(&ring[i & mask], sizeof(LoopTraceRecord), 1, f) == 1;
+
+	fclose(f);
+
+	if ( ! ok )
+		reporter->Error("Failed to write loop trace to '%s'", fn);
+
+	return ok;
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,168 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <signal.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace zeek::detail {
+
+/**
+ * The kinds of records in a loop trace, along with the meaning of their
+ * two arguments.
+ */
+enum class LoopTraceType : uint32_t {
+	ITERATION,	// A main loop iteration ended: number of ready sources, ticks it took.
+	SOURCE,	// An IOSource processed its input: source, ticks it took.
+	TIMERS,	// A batch of timers expired: number of timers, ticks it took.
+	DRAIN,	// The event queue was drained: number of events, ticks it took.
+	BROKER,	// Broker messages were processed: number of messages, backlog.
+	DICT_RESIZE,	// A dictionary doubled in size: new number of buckets, entries.
+	TABLE_EXPIRE,	// A table expiration step removed entries: number removed, 0.
+	STALL,	// An iteration took longer than the stall threshold: 0, ticks it took.
+	NUM_RECORD_TYPES
+};
+
+/**
+ * A single record of a loop trace, as stored in the ring buffer and in
+ * dump files.
+ */
+struct LoopTraceRecord {
+	uint64_t ticks;	// Timestamp, see LoopTraceHeader::ticks_per_second.
+	uint32_t type;	// A LoopTraceType.
+	uint32_t a;
+	uint64_t b;
+};
+
+/**
+ * The start of a dump file, followed by num_sources source names as
+ * NUL-terminated strings, in the order of their IDs, and then
+ * num_records LoopTraceRecords from oldest to newest.
+ */
+struct LoopTraceHeader {
+	char magic[4];	// "ZLTR"
+	uint32_t version;
+	uint64_t num_records;
+	uint64_t num_sources;
+	double ticks_per_second;
+	uint64_t dump_ticks;	// Timestamp of the dump.
+	double dump_time;	// Wall-clock time of the dump.
+};
+
+constexpr uint32_t LOOP_TRACE_VERSION = 1;
+
+/**
+ * A flight recorder for the main loop: it keeps the most recent loop
+ * activity in a fixed-size ring buffer, cheap enough to leave on in
+ * production, and writes it to a file on demand to show what happened
+ * right before a latency spike.
+ *
+ * Tracing is on when the environment variable ZEEK_LOOP_TRACE_FILE names
+ * an output file. Zeek then writes the buffer to that file, with a
+ * sequence number appended, on SIGUSR2 and when a main loop iteration
+ * takes longer than ZEEK_LOOP_TRACE_STALL_MSEC milliseconds (default
+ * 100). ZEEK_LOOP_TRACE_SIZE sets the number of records kept, rounded up
+ * to a power of two (default 65536). zeek-loop-trace decodes the dumps.
+ */
+class LoopTrace {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param file The base name of the dump files.
+	 *
+	 * @param size The number of records to keep.
+	 *
+	 * @param stall_msec The iteration time that counts as a stall.
+	 */
+	LoopTrace(std::string file, uint64_t size, double stall_msec);
+	~LoopTrace();
+
+	/**
+	 * Returns the current timestamp, from the CPU's time-stamp counter
+	 * where available.
+	 */
+	static uint64_t Now()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+
+	/**
+	 * Adds a record, overwriting the oldest if the buffer is full.
+	 */
+	void Record(LoopTraceType type, uint32_t a, uint64_t b, uint64_t ticks = Now())
+		{
+		ring[next++ & mask] = {ticks, static_cast<uint32_t>(type), a, b};
+		}
+
+	/**
+	 * Returns the ID of an IOSource for SOURCE records.
+	 *
+	 * @param tag The source's tag.
+	 */
+	uint32_t SourceID(const char* tag);
+
+	/**
+	 * Records the end of a main loop iteration, and dumps the buffer
+	 * if it was a stall or if SIGUSR2 came in.
+	 *
+	 * @param start The timestamp of the iteration's start.
+	 *
+	 * @param ready The number of sources that were ready.
+	 */
+	void IterationDone(uint64_t start, uint32_t ready);
+
+	/**
+	 * Writes the buffer to the next dump file.
+	 *
+	 * @return: true if the dump was written, otherwise false.
+	 */
+	bool Dump();
+
+private:
+	static void HandleSignal(int signo);
+
+	// Estimates the time-stamp counter's rate from the time passed
+	// since the start.
+	double TicksPerSecond() const;
+
+	inline static volatile sig_atomic_t dump_due = 0;
+
+	std::string file;
+	std::unique_ptr<LoopTraceRecord[]> ring;
+	uint64_t mask;
+	uint64_t next = 0;
+
+	uint64_t stall_ticks;
+	uint64_t last_stall_dump = 0;
+	int num_dumps = 0;
+
+	uint64_t start_ticks;
+	std::chrono::steady_clock::time_point start_time;
+
+	std::unordered_map<std::string, uint32_t> source_ids;
+	std::vector<std::string> source_names;
+
+	struct sigaction old_action;
+	bool have_handler = false;
+};
+
+// Only set if loop tracing is active.
+extern LoopTrace* loop_trace;
+
+} // namespace zeek::detail
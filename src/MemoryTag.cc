@@ -0,0 +1,71 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "MemoryTag.h"
+
+#include <vector>
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::detail {
+
+MemoryTagCounter memory_tag_counters[static_cast<int>(MemoryTag::NumTags)];
+
+const char* memory_tag_name(MemoryTag tag)
+	{
+	switch ( tag ) {
+	case MemoryTag::Connections:	return "connections";
+	case MemoryTag::Reassembly:	return "reassembly";
+	case MemoryTag::Tables:	return "tables";
+	case MemoryTag::Logging:	return "logging";
+	case MemoryTag::Broker:	return "broker";
+	case MemoryTag::FileAnalysis:	return "file_analysis";
+	default:	return nullptr;
+	}
+	}
+
+TEST_CASE("memory tags")
+	{
+	auto& c = memory_tag_counters[static_cast<int>(MemoryTag::Logging)];
+	auto bytes = c.bytes.load();
+	auto allocs = c.allocations.load();
+
+	SUBCASE("tagged objects")
+		{
+		struct Base : public MemoryTagged<MemoryTag::Logging> {
+			virtual ~Base() = default;
+		};
+
+		struct Derived : public Base {
+			char payload[100];
+		};
+
+		Base* b = new Derived;
+		CHECK(c.bytes.load() == bytes + sizeof(Derived));
+		CHECK(c.allocations.load() == allocs + 1);
+		CHECK(c.peak_bytes.load() >= bytes + sizeof(Derived));
+
+		delete b;
+		CHECK(c.bytes.load() == bytes);
+		}
+
+	SUBCASE("tagged containers")
+		{
+			{
+			std::vector<uint64_t, TaggedAllocator<uint64_t, MemoryTag::Logging>> v;
+			v.reserve(64);
+			CHECK(c.bytes.load() == bytes + 64 * sizeof(uint64_t));
+			}
+
+		CHECK(c.bytes.load() == bytes);
+		}
+
+	SUBCASE("untracked")
+		{
+		memory_tag_alloc(MemoryTag::Untracked, 1000);
+		memory_tag_free(MemoryTag::Untracked, 1000);
+		CHECK(memory_tag_name(MemoryTag::Untracked) == nullptr);
+		CHECK(c.bytes.load() == bytes);
+		}
+	}
+
+} // namespace zeek::detail
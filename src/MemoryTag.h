@@ -0,0 +1,128 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace zeek::detail {
+
+/**
+ * The subsystems that memory gets accounted to. Accounting covers the
+ * allocations that each subsystem makes for its own state, counted as they
+ * happen, not estimates computed after the fact.
+ */
+enum class MemoryTag : uint8_t {
+	Connections,	// Connection objects and their analyzer trees.
+	Reassembly,	// Reassemblers and the data they buffer.
+	Tables,	// Entries and buckets of script-level tables and sets.
+	Logging,	// Log records queued for writer threads.
+	Broker,	// Log records batched for publishing through Broker.
+	FileAnalysis,	// Files, their analyzers and beginning-of-file buffers.
+	NumTags,
+
+	// For allocations not accounted anywhere.
+	Untracked = NumTags,
+};
+
+struct MemoryTagCounter {
+	std::atomic<uint64_t> bytes{0};
+	std::atomic<uint64_t> peak_bytes{0};
+	std::atomic<uint64_t> allocations{0};
+};
+
+extern MemoryTagCounter memory_tag_counters[static_cast<int>(MemoryTag::NumTags)];
+
+/**
+ * Returns the name of a tag as shown in stats, or nullptr for Untracked.
+ */
+extern const char* memory_tag_name(MemoryTag tag);
+
+/**
+ * Accounts an allocation of \a n bytes to a tag. Thread-safe.
+ */
+inline void memory_tag_alloc(MemoryTag tag, size_t n)
+	{
+	if ( tag == MemoryTag::Untracked )
+		return;
+
+	auto& c = memory_tag_counters[static_cast<int>(tag)];
+	auto b = c.bytes.fetch_add(n, std::memory_order_relaxed) + n;
+	c.allocations.fetch_add(1, std::memory_order_relaxed);
+
+	// Racy between threads, but only ever off by concurrent allocations.
+	if ( b > c.peak_bytes.load(std::memory_order_relaxed) )
+		c.peak_bytes.store(b, std::memory_order_relaxed);
+	}
+
+/**
+ * Accounts the release of \a n bytes previously accounted to a tag.
+ * Thread-safe.
+ */
+inline void memory_tag_free(MemoryTag tag, size_t n)
+	{
+	if ( tag == MemoryTag::Untracked )
+		return;
+
+	memory_tag_counters[static_cast<int>(tag)].bytes.fetch_sub(n, std::memory_order_relaxed);
+	}
+
+/**
+ * A base class that accounts all heap instances of the classes deriving
+ * from it to a tag. With a virtual destructor, deleting through a base
+ * pointer accounts the size of the most derived class.
+ */
+template <MemoryTag Tag>
+class MemoryTagged {
+public:
+	static void* operator new(size_t size)
+		{
+		memory_tag_alloc(Tag, size);
+		return ::operator new(size);
+		}
+
+	static void operator delete(void* ptr, size_t size)
+		{
+		memory_tag_free(Tag, size);
+		::operator delete(ptr);
+		}
+};
+
+/**
+ * An allocator for standard containers that accounts their storage to a tag.
+ */
+template <typename T, MemoryTag Tag>
+class TaggedAllocator {
+public:
+	using value_type = T;
+
+	template <typename U>
+	struct rebind { using other = TaggedAllocator<U, Tag>; };
+
+	TaggedAllocator() = default;
+
+	template <typename U>
+	TaggedAllocator(const TaggedAllocator<U, Tag>&)	{ }
+
+	T* allocate(size_t n)
+		{
+		memory_tag_alloc(Tag, n * sizeof(T));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+		}
+
+	void deallocate(T* p, size_t n)
+		{
+		memory_tag_free(Tag, n * sizeof(T));
+		::operator delete(p);
+		}
+
+	template <typename U>
+	bool operator==(const TaggedAllocator<U, Tag>&) const	{ return true; }
+
+	template <typename U>
+	bool operator!=(const TaggedAllocator<U, Tag>&) const	{ return false; }
+};
+
+} // namespace zeek::detail
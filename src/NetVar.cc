@@ -110,6 +110,7 @@ namespace zeek::detail {
 int watchdog_interval;
 
 int max_timer_expires;
+int connection_timer_coalescing;
 
 int ignore_checksums;
 int partial_connection_ok;
@@ -117,6 +118,7 @@ int tcp_SYN_ack_ok;
 int tcp_match_undelivered;
 
 double frag_timeout;
+int frag_max_per_source;
 
 double tcp_SYN_timeout;
 double tcp_session_timer;
@@ -130,10 +132,19 @@ int tcp_max_initial_window;
 int tcp_max_above_hole_without_any_acks;
 int tcp_excessive_data_without_further_acks;
 int tcp_max_old_segments;
+uint64_t reassembly_memory_budget;
 
 double non_analyzed_lifetime;
 double tcp_inactivity_timeout;
 double udp_inactivity_timeout;
+int flow_only_udp_icmp;
+int tcp_defer_syn;
+int tcp_syn_table_size;
+double connection_compaction_interval;
+int flow_shedding;
+double flow_shedding_fraction;
+double flow_shedding_lag;
+int prefetch_connections;
 double icmp_inactivity_timeout;
 
 int tcp_storm_thresh;
@@ -163,6 +174,7 @@ double stp_idle_min;
 double table_expire_interval;
 double table_expire_delay;
 int table_incremental_step;
+int table_expire_index;
 
 double connection_status_update_interval;
 
@@ -180,14 +192,25 @@ int load_sample_freq;
 int packet_filter_default;
 
 int sig_max_group_size;
+int dfa_state_budget;
 
 int dpd_reassemble_first_packets;
 int dpd_buffer_size;
+uint64_t dpd_buffer_memory_budget;
 int dpd_match_only_beginning;
 int dpd_late_match_stop;
 int dpd_ignore_ports;
 
 int check_for_unused_event_handlers;
+int event_handler_profiling;
+int table_profiling;
+uint64_t event_val_arena_size;
+int compile_scripts;
+int inline_script_functions;
+int inline_report;
+int fold_script_constants;
+int fold_report;
+int copy_on_write_clones;
 
 double timer_mgr_inactivity_timeout;
 
@@ -238,9 +261,20 @@ void init_general_global_var()
 	table_expire_interval = id::find_val("table_expire_interval")->AsInterval();
 	table_expire_delay = id::find_val("table_expire_delay")->AsInterval();
 	table_incremental_step = id::find_val("table_incremental_step")->AsCount();
+	table_expire_index = id::find_val("table_expire_index")->AsBool();
 	packet_filter_default = id::find_val("packet_filter_default")->AsBool();
 	sig_max_group_size = id::find_val("sig_max_group_size")->AsCount();
+	dfa_state_budget = id::find_val("dfa_state_budget")->AsCount();
 	check_for_unused_event_handlers = id::find_val("check_for_unused_event_handlers")->AsBool();
+	event_handler_profiling = id::find_val("event_handler_profiling")->AsBool();
+	table_profiling = id::find_val("table_profiling")->AsBool();
+	event_val_arena_size = id::find_val("event_val_arena_size")->AsCount();
+	compile_scripts = id::find_val("compile_scripts")->AsBool();
+	inline_script_functions = id::find_val("inline_script_functions")->AsBool();
+	inline_report = id::find_val("inline_report")->AsBool();
+	fold_script_constants = id::find_val("fold_script_constants")->AsBool();
+	fold_report = id::find_val("fold_report")->AsBool();
+	copy_on_write_clones = id::find_val("copy_on_write_clones")->AsBool();
 	record_all_packets = id::find_val("record_all_packets")->AsBool();
 	bits_per_uid = id::find_val("bits_per_uid")->AsCount();
 	}
@@ -265,6 +299,7 @@ void init_net_var()
 	tcp_match_undelivered = id::find_val("tcp_match_undelivered")->AsBool();
 
 	frag_timeout = id::find_val("frag_timeout")->AsInterval();
+	frag_max_per_source = id::find_val("frag_max_per_source")->AsCount();
 
 	tcp_SYN_timeout = id::find_val("tcp_SYN_timeout")->AsInterval();
 	tcp_session_timer = id::find_val("tcp_session_timer")->AsInterval();
@@ -278,10 +313,20 @@ void init_net_var()
 	tcp_max_above_hole_without_any_acks = id::find_val("tcp_max_above_hole_without_any_acks")->AsCount();
 	tcp_excessive_data_without_further_acks = id::find_val("tcp_excessive_data_without_further_acks")->AsCount();
 	tcp_max_old_segments = id::find_val("tcp_max_old_segments")->AsCount();
+	reassembly_memory_budget = id::find_val("reassembly_memory_budget")->AsCount();
 
 	non_analyzed_lifetime = id::find_val("non_analyzed_lifetime")->AsInterval();
 	tcp_inactivity_timeout = id::find_val("tcp_inactivity_timeout")->AsInterval();
 	udp_inactivity_timeout = id::find_val("udp_inactivity_timeout")->AsInterval();
+	flow_only_udp_icmp = id::find_val("flow_only_udp_icmp")->AsBool();
+	tcp_defer_syn = id::find_val("tcp_defer_syn")->AsBool();
+	tcp_syn_table_size = id::find_val("tcp_syn_table_size")->AsCount();
+	connection_compaction_interval = id::find_val("connection_compaction_interval")->AsInterval();
+	flow_shedding_fraction = id::find_val("flow_shedding_fraction")->AsDouble();
+	flow_shedding_lag = id::find_val("flow_shedding_lag")->AsInterval();
+	flow_shedding = flow_shedding_fraction > 0.0 ||
+		id::find_val<TableVal>("flow_shedding_ports")->Size() > 0;
+	prefetch_connections = id::find_val("prefetch_connections")->AsBool();
 	icmp_inactivity_timeout = id::find_val("icmp_inactivity_timeout")->AsInterval();
 
 	tcp_storm_thresh = id::find_val("tcp_storm_thresh")->AsCount();
@@ -305,6 +350,7 @@ void init_net_var()
 	watchdog_interval = int(id::find_val("watchdog_interval")->AsInterval());
 
 	max_timer_expires = id::find_val("max_timer_expires")->AsCount();
+	connection_timer_coalescing = id::find_val("connection_timer_coalescing")->AsBool();
 
 	mime_segment_length = id::find_val("mime_segment_length")->AsCount();
 	mime_segment_overlap_length = id::find_val("mime_segment_overlap_length")->AsCount();
@@ -350,6 +396,7 @@ void init_net_var()
 
 	dpd_reassemble_first_packets = id::find_val("dpd_reassemble_first_packets")->AsBool();
 	dpd_buffer_size = id::find_val("dpd_buffer_size")->AsCount();
+	dpd_buffer_memory_budget = id::find_val("dpd_buffer_memory_budget")->AsCount();
 	dpd_match_only_beginning = id::find_val("dpd_match_only_beginning")->AsBool();
 	dpd_late_match_stop = id::find_val("dpd_late_match_stop")->AsBool();
 	dpd_ignore_ports = id::find_val("dpd_ignore_ports")->AsBool();
@@ -11,6 +11,7 @@ namespace zeek::detail {
 extern int watchdog_interval;
 
 extern int max_timer_expires;
+extern int connection_timer_coalescing;
 
 extern int ignore_checksums;
 extern int partial_connection_ok;
@@ -18,6 +19,7 @@ extern int tcp_SYN_ack_ok;
 extern int tcp_match_undelivered;
 
 extern double frag_timeout;
+extern int frag_max_per_source;
 
 extern double tcp_SYN_timeout;
 extern double tcp_session_timer;
@@ -31,11 +33,20 @@ extern int tcp_max_initial_window;
 extern int tcp_max_above_hole_without_any_acks;
 extern int tcp_excessive_data_without_further_acks;
 extern int tcp_max_old_segments;
+extern uint64_t reassembly_memory_budget;
 
 extern double non_analyzed_lifetime;
 extern double tcp_inactivity_timeout;
 extern double udp_inactivity_timeout;
 extern double icmp_inactivity_timeout;
+extern int flow_only_udp_icmp;
+extern int tcp_defer_syn;
+extern int tcp_syn_table_size;
+extern double connection_compaction_interval;
+extern int flow_shedding;
+extern double flow_shedding_fraction;
+extern double flow_shedding_lag;
+extern int prefetch_connections;
 
 extern int tcp_storm_thresh;
 extern double tcp_storm_interarrival_thresh;
@@ -64,6 +75,7 @@ extern double stp_idle_min;
 extern double table_expire_interval;
 extern double table_expire_delay;
 extern int table_incremental_step;
+extern int table_expire_index;
 
 extern int orig_addr_anonymization, resp_addr_anonymization;
 extern int other_addr_anonymization;
@@ -81,14 +93,25 @@ extern int load_sample_freq;
 extern int packet_filter_default;
 
 extern int sig_max_group_size;
+extern int dfa_state_budget;
 
 extern int dpd_reassemble_first_packets;
 extern int dpd_buffer_size;
+extern uint64_t dpd_buffer_memory_budget;
 extern int dpd_match_only_beginning;
 extern int dpd_late_match_stop;
 extern int dpd_ignore_ports;
 
 extern int check_for_unused_event_handlers;
+extern int event_handler_profiling;
+extern int table_profiling;
+extern uint64_t event_val_arena_size;
+extern int compile_scripts;
+extern int inline_script_functions;
+extern int inline_report;
+extern int fold_script_constants;
+extern int fold_report;
+extern int copy_on_write_clones;
 
 extern double timer_mgr_inactivity_timeout;
 
@@ -3,6 +3,7 @@
 #include "Notifier.h"
 #include "DebugLogger.h"
 
+#include <cinttypes>
 #include <set>
 
 zeek::notifier::detail::Registry zeek::notifier::detail::registry;
@@ -24,6 +25,9 @@ Registry::~Registry()
 	{
 	while ( registrations.begin() != registrations.end() )
 		Unregister(registrations.begin()->first);
+
+	while ( key_registrations.begin() != key_registrations.end() )
+		Unregister(key_registrations.begin()->first);
 	}
 
 void Registry::Register(Modifiable* m, Receiver* r)
@@ -34,6 +38,15 @@ void Registry::Register(Modifiable* m, Receiver* r)
 	++m->num_receivers;
 	}
 
+void Registry::Register(Modifiable* m, uint64_t key, Receiver* r)
+	{
+	DBG_LOG(DBG_NOTIFIERS, "registering key %" PRIu64 " of object %p for receiver %p",
+	        key, m, r);
+
+	key_registrations[m].insert({key, r});
+	++m->num_receivers;
+	}
+
 void Registry::Unregister(Modifiable* m, Receiver* r)
 	{
 	DBG_LOG(DBG_NOTIFIERS, "unregistering object %p from receiver %p", m, r);
@@ -50,24 +63,121 @@ void Registry::Unregister(Modifiable* m, Receiver* r)
 		}
 	}
 
+void Registry::Unregister(Modifiable* m, uint64_t key, Receiver* r)
+	{
+	DBG_LOG(DBG_NOTIFIERS, "unregistering key %" PRIu64 " of object %p from receiver %p",
+	        key, m, r);
+
+	auto k = key_registrations.find(m);
+
+	if ( k == key_registrations.end() )
+		return;
+
+	auto x = k->second.equal_range(key);
+	for ( auto i = x.first; i != x.second; i++ )
+		{
+		if ( i->second == r )
+			{
+			--m->num_receivers;
+			k->second.erase(i);
+			break;
+			}
+		}
+
+	if ( k->second.empty() )
+		key_registrations.erase(k);
+	}
+
 void Registry::Unregister(Modifiable* m)
 	{
 	DBG_LOG(DBG_NOTIFIERS, "unregistering object %p from all notifiers", m);
 
+	if ( m->pending )
+		{
+		pending.erase(m);
+		m->pending = m->pending_all = false;
+		}
+
 	auto x = registrations.equal_range(m);
 	for ( auto i = x.first; i != x.second; i++ )
 		--i->first->num_receivers;
 
 	registrations.erase(x.first, x.second);
+
+	if ( auto k = key_registrations.find(m); k != key_registrations.end() )
+		{
+		m->num_receivers -= k->second.size();
+		key_registrations.erase(k);
+		}
 	}
 
 void Registry::Modified(Modifiable* m)
 	{
+	if ( m->pending_all )
+		return;
+
 	DBG_LOG(DBG_NOTIFIERS, "object %p has been modified", m);
 
+	// The keys don't matter anymore.
+	auto& keys = pending[m];
+	keys.clear();
+	m->pending = m->pending_all = true;
+	}
+
+void Registry::Modified(Modifiable* m, uint64_t key)
+	{
+	if ( m->pending_all )
+		return;
+
+	DBG_LOG(DBG_NOTIFIERS, "key %" PRIu64 " of object %p has been modified", key, m);
+
+	pending[m].insert(key);
+	m->pending = true;
+	}
+
+void Registry::Notify(Modifiable* m, bool all, const std::unordered_set<uint64_t>& keys)
+	{
 	auto x = registrations.equal_range(m);
 	for ( auto i = x.first; i != x.second; i++ )
 		i->second->Modified(m);
+
+	auto k = key_registrations.find(m);
+
+	if ( k == key_registrations.end() )
+		return;
+
+	if ( all )
+		{
+		// Without knowing better, any of the keys may have changed.
+		for ( auto& r : k->second )
+			r.second->Modified(m);
+
+		return;
+		}
+
+	for ( auto key : keys )
+		{
+		auto y = k->second.equal_range(key);
+		for ( auto i = y.first; i != y.second; i++ )
+			i->second->Modified(m);
+		}
+	}
+
+void Registry::Flush()
+	{
+	// Receivers may modify objects in turn.
+	while ( ! pending.empty() )
+		{
+		auto batch = std::move(pending);
+		pending.clear();
+
+		for ( auto& [m, keys] : batch )
+			{
+			bool all = m->pending_all;
+			m->pending = m->pending_all = false;
+			Notify(m, all, keys);
+			}
+		}
 	}
 
 void Registry::Terminate()
@@ -77,13 +187,17 @@ void Registry::Terminate()
 	for ( auto& r : registrations )
 		receivers.emplace(r.second);
 
+	for ( auto& k : key_registrations )
+		for ( auto& r : k.second )
+			receivers.emplace(r.second);
+
 	for ( auto& r : receivers )
 		r->Terminate();
 	}
 
 Modifiable::~Modifiable()
 	{
-	if ( num_receivers )
+	if ( num_receivers || pending )
 		registry.Unregister(this);
 	}
 
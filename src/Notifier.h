@@ -3,11 +3,18 @@
 // A notification framework to inform interested parties of modifications to
 // selected global objects. To get notified about a change, derive a class
 // from notifier::Receiver and register the interesting objects with the
-// notification::Registry.
+// notification::Registry. Receivers may also register for changes to
+// individual keys of an object only, where the object's class defines
+// what a key is; for tables, it's the hash of an index.
+//
+// Notifications get batched: modifications are only recorded as they
+// happen, and receivers learn about them once the current event is done,
+// no matter how often an object has changed in the meantime.
 
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <cstdint>
 
 namespace zeek::notifier::detail  {
@@ -52,6 +59,20 @@ public:
 	 */
 	void Register(Modifiable* m, Receiver* r);
 
+	/**
+	 * Registers a receiver to be informed when a particular key of a
+	 * modifiable object has changed, or when the object changed in a way
+	 * that doesn't pertain to specific keys.
+	 *
+	 * @param m object to track, as with the other Register().
+	 *
+	 * @param key the key to track. Its meaning depends on the object.
+	 *
+	 * @param r receiver to notify on changes, as with the other
+	 * Register().
+	 */
+	void Register(Modifiable* m, uint64_t key, Receiver* r);
+
 	/**
 	 * Cancels a receiver's request to be informed about an object's
 	 * modification. The arguments to the method must match what was
@@ -63,6 +84,19 @@ public:
 	 */
 	void Unregister(Modifiable* m, Receiver* Receiver);
 
+	/**
+	 * Cancels a receiver's request to be informed about modifications
+	 * of an object's key. The arguments to the method must match what
+	 * was originally registered.
+	 *
+	 * @param m object to no loger track.
+	 *
+	 * @param key key to no longer track.
+	 *
+	 * @param r receiver to no longer notify.
+	 */
+	void Unregister(Modifiable* m, uint64_t key, Receiver* r);
+
 	/**
 	 * Cancels any active receiver requests to be informed about a
 	 * partilar object's modifications.
@@ -71,6 +105,13 @@ public:
 	 */
 	void Unregister(Modifiable* m);
 
+	/**
+	 * Passes the modifications recorded since the last call on to the
+	 * receivers. Called after each event, and before evaluating
+	 * triggers.
+	 */
+	void Flush();
+
 	/**
 	 * Notifies all receivers that no further modifications will occur
 	 * as the registry is shutting down.
@@ -80,12 +121,28 @@ public:
 private:
 	friend class Modifiable;
 
-	// Inform all registered receivers of a modification to an object.
-	// Will be called from the object itself.
+	// Records a modification to an object, which is to be passed on to
+	// all of its receivers. Will be called from the object itself.
 	void Modified(Modifiable* m);
 
+	// Records a modification to a key of an object, which is to be
+	// passed on to the receivers registered for the object as a whole
+	// and to those registered for the key.
+	void Modified(Modifiable* m, uint64_t key);
+
+	// Inform the receivers of the recorded modifications of an object.
+	void Notify(Modifiable* m, bool all, const std::unordered_set<uint64_t>& keys);
+
 	typedef std::unordered_multimap<Modifiable*, Receiver*> ModifiableMap;
 	ModifiableMap registrations;
+
+	typedef std::unordered_multimap<uint64_t, Receiver*> KeyMap;
+	std::unordered_map<Modifiable*, KeyMap> key_registrations;
+
+	// Objects with modifications not passed on yet, along with their
+	// modified keys. Those modified as a whole have pending_all set
+	// instead.
+	std::unordered_map<Modifiable*, std::unordered_set<uint64_t>> pending;
 };
 
 /**
@@ -109,6 +166,17 @@ public:
 			registry.Modified(this);
 		}
 
+	/**
+	 * Calling this method signals to the registered receivers that the
+	 * given key of the object has been modified. Receivers registered
+	 * for other keys don't get notified.
+	 */
+	void Modified(uint64_t key)
+		{
+		if ( num_receivers )
+			registry.Modified(this, key);
+		}
+
 protected:
 	friend class Registry;
 
@@ -116,6 +184,11 @@ protected:
 
 	// Number of currently registered receivers.
 	uint64_t num_receivers = 0;
+
+	// True if the registry has modifications of the object pending, and
+	// if those are of the object as a whole.
+	bool pending = false;
+	bool pending_all = false;
 };
 
 } // namespace zeek::notifier::detail
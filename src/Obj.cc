@@ -51,9 +51,14 @@ bool Location::operator==(const Location& l) const
 		return false;
 	}
 
+#ifdef DEBUG
+uint64_t num_ref_ops = 0;
+#endif
+
 } // namespace detail
 
 int Obj::suppress_errors = 0;
+uint64_t Obj::num_created = 0;
 
 Obj::~Obj()
 	{
@@ -5,6 +5,7 @@
 #include "zeek-config.h"
 
 #include <limits.h>
+#include <cstdint>
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(ODesc, zeek);
 
@@ -77,6 +78,8 @@ public:
 		location = nullptr;
 		if ( detail::start_location.first_line != 0 )
 			SetLocationInfo(&detail::start_location, &detail::end_location);
+
+		++num_created;
 		}
 
 	virtual ~Obj();
@@ -128,6 +131,9 @@ public:
 
 	int RefCnt() const	{ return ref_cnt; }
 
+	// Returns the total number of objects created so far.
+	static uint64_t NumCreated()	{ return num_created; }
+
 	// Helper class to temporarily suppress errors
 	// as long as there exist any instances.
 	class SuppressErrors {
@@ -158,6 +164,8 @@ private:
 	// If non-zero, do not print runtime errors.  Useful for
 	// speculative evaluation.
 	static int suppress_errors;
+
+	static uint64_t num_created;
 };
 
 // Sometimes useful when dealing with Obj subclasses that have their
@@ -169,8 +177,21 @@ inline void Error(const Obj* o, const char* msg)
 
 [[noreturn]] extern void bad_ref(int type);
 
+#ifdef DEBUG
+namespace detail {
+
+// The number of Ref() and Unref() calls on objects so far, to measure
+// reference count traffic. Debug builds only.
+extern uint64_t num_ref_ops;
+
+} // namespace detail
+#endif
+
 inline void Ref(Obj* o)
 	{
+#ifdef DEBUG
+	++detail::num_ref_ops;
+#endif
 	if ( ++(o->ref_cnt) <= 1 )
 		bad_ref(0);
 	if ( o->ref_cnt == INT_MAX )
@@ -179,6 +200,11 @@ inline void Ref(Obj* o)
 
 inline void Unref(Obj* o)
 	{
+#ifdef DEBUG
+	if ( o )
+		++detail::num_ref_ops;
+#endif
+
 	if ( o && --o->ref_cnt <= 0 )
 		{
 		if ( o->ref_cnt < 0 )
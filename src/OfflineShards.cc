@@ -0,0 +1,355 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "OfflineShards.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+
+#include "Options.h"
+#include "util.h"
+#include "logging/writers/ascii/Ascii.h"
+
+namespace zeek::detail {
+
+static std::string shard_dir(int i)
+	{
+	return util::fmt("shard-%d", i);
+	}
+
+// The children run in their own directories, so relative paths need to
+// keep pointing to the same files.
+static std::string absolute_path(const std::string& path)
+	{
+	char buf[PATH_MAX];
+
+	if ( ! realpath(path.c_str(), buf) )
+		return path;
+
+	return buf;
+	}
+
+// Returns true if the string starts with a timestamp, and stores it in ts.
+static bool parse_ts(const char* s, double* ts)
+	{
+	char* end;
+	double d = strtod(s, &end);
+
+	if ( end == s )
+		return false;
+
+	*ts = d;
+	return true;
+	}
+
+namespace {
+
+// One of the inputs of merge_logs(), with its next entry.
+struct LogInput {
+	std::ifstream in;
+	std::string line;
+	double ts = 0;
+
+	// For ASCII logs, the timestamp's column and the separator.
+	int ts_field = -1;
+	char separator = '\t';
+
+	bool json = false;
+	std::string footer;
+};
+
+} // namespace
+
+// Reads the input's next entry, and returns false at its end. Footer
+// lines get collected on the way.
+static bool next_entry(LogInput* in)
+	{
+	while ( std::getline(in->in, in->line) )
+		{
+		if ( ! in->line.empty() && in->line[0] == '#' )
+			{
+			in->footer += in->line + "\n";
+			continue;
+			}
+
+		// Entries without a usable timestamp stay with the one before.
+		const char* s = in->line.c_str();
+
+		if ( in->json )
+			{
+			if ( auto p = strstr(s, "\"ts\":") )
+				parse_ts(p + 5, &in->ts);
+			}
+
+		else if ( in->ts_field >= 0 )
+			{
+			for ( int i = 0; i < in->ts_field && s; ++i )
+				{
+				s = strchr(s, in->separator);
+
+				if ( s )
+					++s;
+				}
+
+			if ( s )
+				parse_ts(s, &in->ts);
+			}
+
+		return true;
+		}
+
+	return false;
+	}
+
+bool merge_logs(const std::vector<std::string>& inputs, const std::string& output)
+	{
+	std::vector<std::unique_ptr<LogInput>> ins;
+	std::string header;
+
+	for ( const auto& path : inputs )
+		{
+		auto in = std::make_unique<LogInput>();
+		in->in.open(path);
+
+		if ( ! in->in )
+			{
+			fprintf(stderr, "can't open %s: %s\n", path.c_str(), strerror(errno));
+			return false;
+			}
+
+		// Read the header, up to the first entry.
+		std::string h;
+		int c;
+
+		while ( (c = in->in.peek()) == '#' )
+			{
+			std::string line;
+			std::getline(in->in, line);
+			h += line + "\n";
+
+			if ( line.compare(0, 11, "#separator ") == 0 )
+				{
+				// It comes escaped, as in "\x09".
+				unsigned int sep;
+
+				if ( sscanf(line.c_str() + 11, "\\x%2x", &sep) == 1 )
+					in->separator = sep;
+				}
+
+			else if ( line.compare(0, 7, "#fields") == 0 )
+				{
+				auto fields = util::tokenize_string(line, in->separator);
+
+				for ( size_t i = 1; i < fields.size(); ++i )
+					if ( fields[i] == "ts" )
+						in->ts_field = i - 1;
+				}
+			}
+
+		in->json = h.empty() && c == '{';
+
+		if ( header.empty() )
+			header = h;
+
+		ins.push_back(std::move(in));
+		}
+
+	std::ofstream out(output, std::ios::trunc);
+
+	if ( ! out )
+		{
+		fprintf(stderr, "can't write %s: %s\n", output.c_str(), strerror(errno));
+		return false;
+		}
+
+	out << header;
+
+	// Earliest timestamp first, ties go to the lower shard.
+	using Entry = std::pair<double, size_t>;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heads;
+
+	for ( size_t i = 0; i < ins.size(); ++i )
+		if ( next_entry(ins[i].get()) )
+			heads.emplace(ins[i]->ts, i);
+
+	while ( ! heads.empty() )
+		{
+		auto i = heads.top().second;
+		heads.pop();
+
+		out << ins[i]->line << '\n';
+
+		if ( next_entry(ins[i].get()) )
+			heads.emplace(ins[i]->ts, i);
+		}
+
+	// The footers only hold the #close line with the time the log got
+	// closed. The latest one stands for the merged log.
+	std::string footer;
+
+	for ( const auto& in : ins )
+		footer = std::max(footer, in->footer);
+
+	out << footer;
+	out.close();
+
+	if ( ! out )
+		{
+		fprintf(stderr, "can't write %s: %s\n", output.c_str(), strerror(errno));
+		return false;
+		}
+
+	for ( const auto& path : inputs )
+		unlink(path.c_str());
+
+	return true;
+	}
+
+// Returns the log files in each shard's directory, by name.
+static std::map<std::string, std::vector<std::string>> find_logs(int num_shards)
+	{
+	std::map<std::string, std::vector<std::string>> logs;
+	auto ext = "." + logging::writer::detail::Ascii::LogExt();
+
+	for ( int i = 0; i < num_shards; ++i )
+		{
+		auto dir = shard_dir(i);
+		DIR* d = opendir(dir.c_str());
+
+		if ( ! d )
+			continue;
+
+		while ( auto e = readdir(d) )
+			{
+			std::string name = e->d_name;
+
+			if ( name.size() > ext.size() &&
+			     name.compare(name.size() - ext.size(), ext.size(), ext) == 0 )
+				logs[name].emplace_back(dir + "/" + name);
+			}
+
+		closedir(d);
+		}
+
+	return logs;
+	}
+
+void run_offline_shards(Options* options)
+	{
+	int num_shards = options->offline_shards;
+	std::vector<pid_t> children;
+
+	for ( int i = 0; i < num_shards; ++i )
+		{
+		auto dir = shard_dir(i);
+
+		// Leftovers of an earlier run would get mixed into the logs.
+		if ( mkdir(dir.c_str(), 0777) < 0 )
+			{
+			fprintf(stderr, "can't create directory %s: %s\n", dir.c_str(), strerror(errno));
+			exit(1);
+			}
+		}
+
+	char cwd[PATH_MAX];
+
+	if ( ! getcwd(cwd, sizeof(cwd)) )
+		{
+		fprintf(stderr, "can't get current directory: %s\n", strerror(errno));
+		exit(1);
+		}
+
+	for ( int i = 0; i < num_shards; ++i )
+		{
+		pid_t pid = fork();
+
+		if ( pid < 0 )
+			{
+			fprintf(stderr, "can't fork: %s\n", strerror(errno));
+			exit(1);
+			}
+
+		if ( pid > 0 )
+			{
+			children.push_back(pid);
+			continue;
+			}
+
+		// We are the child.
+		std::vector<std::string> files;
+
+		for ( const auto& f : options->pcap_files )
+			files.emplace_back(absolute_path(f));
+
+		options->pcap_file = "mmap::" + util::implode_string_vector(files, ":");
+		options->offline_shards = 0;
+
+		if ( options->random_seed_input_file )
+			options->random_seed_input_file = absolute_path(*options->random_seed_input_file);
+
+		options->script_options_to_set.emplace_back(util::fmt("Pcap::read_shards=%d", num_shards));
+		options->script_options_to_set.emplace_back(util::fmt("Pcap::read_shard=%d", i));
+
+		if ( chdir(shard_dir(i).c_str()) < 0 )
+			{
+			fprintf(stderr, "can't change to directory %s: %s\n",
+			        shard_dir(i).c_str(), strerror(errno));
+			_exit(1);
+			}
+
+		// Scripts and signatures given relative to where we started.
+		util::detail::add_to_zeek_path(cwd);
+		return;
+		}
+
+	int rc = 0;
+
+	for ( auto pid : children )
+		{
+		int status;
+
+		while ( waitpid(pid, &status, 0) < 0 )
+			{
+			if ( errno != EINTR )
+				{
+				status = 1;
+				break;
+				}
+			}
+
+		if ( ! WIFEXITED(status) || WEXITSTATUS(status) != 0 )
+			rc = 1;
+		}
+
+	if ( rc )
+		fprintf(stderr, "not all shards finished successfully, merging what they logged\n");
+
+	for ( const auto& [name, inputs] : find_logs(num_shards) )
+		{
+		if ( ! merge_logs(inputs, name) )
+			rc = 1;
+		}
+
+	// Directories with anything else than logs stay.
+	for ( int i = 0; i < num_shards; ++i )
+		rmdir(shard_dir(i).c_str());
+
+	exit(rc);
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,48 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace zeek {
+
+struct Options;
+
+namespace detail {
+
+/**
+ * Splits reading traces across options->offline_shards processes, as
+ * requested by ``-j<n>`` along with ``-r``. Each process runs in its own
+ * directory ``shard-<i>`` below the current one, shares nothing with the
+ * others, and analyzes only the packets of its shard, chosen by pair of
+ * IP addresses so that connections stay intact (see Pcap::read_shards).
+ *
+ * This returns in each of the child processes, with the options adjusted
+ * for its shard, and setup continues from there as usual. The parent
+ * waits for all children, merges their logs into the current directory
+ * by timestamp, and exits.
+ *
+ * @param options The command-line options, with offline_shards larger
+ * than 1.
+ */
+void run_offline_shards(Options* options);
+
+/**
+ * Merges log files by the timestamps of their entries, removing the
+ * inputs. Each input has to be ordered by timestamp for the output to
+ * be ordered. ASCII logs keep the header and footer of the first input,
+ * with the latest #close line; for JSON logs, the timestamps come from
+ * each entry's ``ts`` field.
+ *
+ * @param inputs The files to merge.
+ *
+ * @param output The file to write.
+ *
+ * @return True if successful; false if a file couldn't be read or
+ * written, in which case the inputs are left in place.
+ */
+bool merge_logs(const std::vector<std::string>& inputs, const std::string& output);
+
+} // namespace detail
+} // namespace zeek
@@ -5,6 +5,7 @@
 #include "OpaqueVal.h"
 #include "CompHash.h"
 #include "NetVar.h"
+#include "RE.h"
 #include "Reporter.h"
 #include "Scope.h"
 #include "Desc.h"
@@ -599,7 +600,8 @@ bool SHA256Val::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
-EntropyVal::EntropyVal() : OpaqueVal(entropy_type)
+EntropyVal::EntropyVal(bool histogram_only)
+	: OpaqueVal(entropy_type), state(histogram_only)
 	{
 	}
 
@@ -1038,4 +1040,173 @@ ValPtr ParaglobVal::DoClone(CloneState* state)
 		}
 	}
 
+PatternSetVal::PatternSetVal(std::vector<ValPtr> arg_patterns)
+	: OpaqueVal(pattern_set_type), patterns(std::move(arg_patterns))
+	{
+	Build();
+	}
+
+void PatternSetVal::Build()
+	{
+	for ( const auto& p : patterns )
+		matcher.Add(p->AsPattern());
+
+	matcher.Compile();
+	}
+
+VectorValPtr PatternSetVal::Match(const StringVal* s) const
+	{
+	auto rval = make_intrusive<VectorVal>(id::index_vec);
+	auto matches = matcher.MatchAnywhere(s->AsString());
+
+	for ( size_t i = 0; i < matches.size(); ++i )
+		rval->Assign(i, val_mgr->Count(matches[i]));
+
+	return rval;
+	}
+
+ValPtr PatternSetVal::DoClone(CloneState* state)
+	{
+	// Patterns don't change, so the clone can share them.
+	return state->NewClone(this, make_intrusive<PatternSetVal>(patterns));
+	}
+
+IMPLEMENT_OPAQUE_VALUE(PatternSetVal)
+
+broker::expected<broker::data> PatternSetVal::DoSerialize() const
+	{
+	broker::vector d;
+
+	for ( const auto& p : patterns )
+		{
+		const RE_Matcher* re = p->AsPattern();
+		d.emplace_back(broker::vector{re->PatternText(), re->AnywherePatternText()});
+		}
+
+	return {std::move(d)};
+	}
+
+bool PatternSetVal::DoUnserialize(const broker::data& data)
+	{
+	auto d = caf::get_if<broker::vector>(&data);
+	if ( ! d )
+		return false;
+
+	for ( const auto& entry : *d )
+		{
+		auto texts = caf::get_if<broker::vector>(&entry);
+		if ( ! (texts && texts->size() == 2) )
+			return false;
+
+		auto exact_text = caf::get_if<std::string>(&(*texts)[0]);
+		auto anywhere_text = caf::get_if<std::string>(&(*texts)[1]);
+		if ( ! (exact_text && anywhere_text) )
+			return false;
+
+		auto re = new RE_Matcher(exact_text->c_str(), anywhere_text->c_str());
+		if ( ! re->Compile() )
+			{
+			delete re;
+			return false;
+			}
+
+		patterns.push_back(make_intrusive<PatternVal>(re));
+		}
+
+	Build();
+	return true;
+	}
+
+Base64DecoderVal::Base64DecoderVal(std::string arg_alphabet)
+	: OpaqueVal(base64_decoder_type), alphabet(std::move(arg_alphabet)),
+	  converter(new detail::Base64Converter(nullptr, alphabet))
+	{
+	}
+
+// Takes over a buffer that the converter allocated.
+static StringValPtr decoded_val(char* buf, int len)
+	{
+	if ( ! buf )
+		return val_mgr->EmptyString();
+
+	// The converter leaves room for a terminating NUL.
+	buf[len] = '\0';
+	return make_intrusive<StringVal>(new String(true, reinterpret_cast<u_char*>(buf), len));
+	}
+
+StringValPtr Base64DecoderVal::Feed(const String* s)
+	{
+	if ( converter->Errored() )
+		return nullptr;
+
+	if ( ! s->Len() )
+		return val_mgr->EmptyString();
+
+	char* buf = nullptr;
+	int len = 0;
+	converter->Decode(s->Len(), reinterpret_cast<const char*>(s->Bytes()), &len, &buf);
+
+	if ( converter->Errored() )
+		{
+		delete [] buf;
+		return nullptr;
+		}
+
+	return decoded_val(buf, len);
+	}
+
+StringValPtr Base64DecoderVal::Finish()
+	{
+	char* buf = nullptr;
+	int len = 0;
+
+	if ( ! converter->Errored() )
+		// Like decode_base64(), this ignores missing padding.
+		converter->Done(&len, &buf);
+
+	converter = std::make_unique<detail::Base64Converter>(nullptr, alphabet);
+	return decoded_val(buf, len);
+	}
+
+IMPLEMENT_OPAQUE_VALUE(Base64DecoderVal)
+
+broker::expected<broker::data> Base64DecoderVal::DoSerialize() const
+	{
+	const auto& c = *converter;
+
+	return {broker::vector{alphabet,
+	                       std::string(c.base64_group, c.base64_group_next),
+	                       static_cast<uint64_t>(c.base64_padding),
+	                       static_cast<bool>(c.base64_after_padding),
+	                       static_cast<bool>(c.errored)}};
+	}
+
+bool Base64DecoderVal::DoUnserialize(const broker::data& data)
+	{
+	auto d = caf::get_if<broker::vector>(&data);
+	if ( ! (d && d->size() == 5) )
+		return false;
+
+	auto alpha = caf::get_if<std::string>(&(*d)[0]);
+	auto group = caf::get_if<std::string>(&(*d)[1]);
+	auto padding = caf::get_if<uint64_t>(&(*d)[2]);
+	auto after_padding = caf::get_if<bool>(&(*d)[3]);
+	auto errored = caf::get_if<bool>(&(*d)[4]);
+
+	if ( ! (alpha && group && padding && after_padding && errored) )
+		return false;
+
+	if ( ! (alpha->empty() || alpha->size() == 64) || group->size() > 3 || *padding > 3 )
+		return false;
+
+	alphabet = *alpha;
+	converter = std::make_unique<detail::Base64Converter>(nullptr, alphabet);
+	memcpy(converter->base64_group, group->data(), group->size());
+	converter->base64_group_next = group->size();
+	converter->base64_padding = *padding;
+	converter->base64_after_padding = *after_padding;
+	converter->errored = *errored;
+	return true;
+	}
+
 }
@@ -3,8 +3,10 @@
 #pragma once
 
 #include "IntrusivePtr.h"
+#include "Base64.h"
 #include "RandTest.h"
 #include "Val.h"
+#include "PatternSet.h"
 #include "digest.h"
 #include "paraglob/paraglob.h"
 
@@ -288,7 +290,14 @@ private:
 
 class EntropyVal : public OpaqueVal {
 public:
-	EntropyVal();
+	/**
+	 * Constructor.
+	 *
+	 * @param histogram_only If true, skips the Monte Carlo and serial
+	 * correlation tests, which are the costlier ones. Their results
+	 * then come out as 0 and -100000, respectively.
+	 */
+	explicit EntropyVal(bool histogram_only = false);
 
 	bool Feed(const void* data, size_t size);
 	bool Get(double *r_ent, double *r_chisq, double *r_mean,
@@ -381,6 +390,63 @@ private:
 	std::unique_ptr<paraglob::Paraglob> internal_paraglob;
 };
 
+class PatternSetVal : public OpaqueVal {
+public:
+	explicit PatternSetVal(std::vector<ValPtr> patterns);
+
+	// Returns the indices of the patterns occurring in s.
+	VectorValPtr Match(const StringVal* s) const;
+
+	ValPtr DoClone(CloneState* state) override;
+
+protected:
+	PatternSetVal() : OpaqueVal(pattern_set_type) {}
+
+	DECLARE_OPAQUE_VALUE(PatternSetVal)
+
+private:
+	void Build();
+
+	std::vector<ValPtr> patterns;
+	detail::PatternSet matcher;
+};
+
+class Base64DecoderVal : public OpaqueVal {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param alphabet The alphabet, with the empty string for the
+	 * default one.
+	 */
+	explicit Base64DecoderVal(std::string alphabet);
+
+	/**
+	 * Decodes the next piece of input.
+	 *
+	 * @return The bytes of the groups completed so far, or null if the
+	 * input isn't valid Base64.
+	 */
+	StringValPtr Feed(const String* s);
+
+	/**
+	 * Decodes the rest of the input, padding an incomplete last group.
+	 * The decoder then starts over.
+	 *
+	 * @return The remaining bytes.
+	 */
+	StringValPtr Finish();
+
+protected:
+	Base64DecoderVal() : OpaqueVal(base64_decoder_type) {}
+
+	DECLARE_OPAQUE_VALUE(Base64DecoderVal)
+
+private:
+	std::string alphabet;
+	std::unique_ptr<detail::Base64Converter> converter;
+};
+
 } // namespace zeek
 
 using OpaqueMgr [[deprecated("Remove in v4.1. Use zeek::OpaqueMgr instead.")]] = zeek::OpaqueMgr;
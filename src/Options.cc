@@ -89,7 +89,7 @@ void usage(const char* prog, int code)
 	fprintf(stderr, "    -h|--help                      | command line help\n");
 	fprintf(stderr, "    -i|--iface <interface>         | read from given interface (only one allowed)\n");
 	fprintf(stderr, "    -p|--prefix <prefix>           | add given prefix to Zeek script file resolution\n");
-	fprintf(stderr, "    -r|--readfile <readfile>       | read from given tcpdump file (only one allowed, pass '-' as the filename to read from stdin)\n");
+	fprintf(stderr, "    -r|--readfile <readfile>       | read from given tcpdump file (pass '-' as the filename to read from stdin, repeat to read several files in turn)\n");
 	fprintf(stderr, "    -s|--rulefile <rulefile>       | read rules from given file\n");
 	fprintf(stderr, "    -t|--tracefile <tracefile>     | activate execution tracing\n");
 	fprintf(stderr, "    -v|--version                   | print version and exit\n");
@@ -117,7 +117,8 @@ void usage(const char* prog, int code)
 	fprintf(stderr, "    -M|--mem-profile               | record heap [perftools]\n");
 #endif
 	fprintf(stderr, "    --pseudo-realtime[=<speedup>]  | enable pseudo-realtime for performance evaluation (default 1)\n");
-	fprintf(stderr, "    -j|--jobs                      | enable supervisor mode\n");
+	fprintf(stderr, "    --bench[=<loops>]              | replay the trace from memory and report time per stage (default 1)\n");
+	fprintf(stderr, "    -j|--jobs[=<shards>]           | enable supervisor mode, or with -r split reading traces across processes\n");
 
 #ifdef USE_IDMEF
 	fprintf(stderr, "    -n|--idmef-dtd <idmef-msg.dtd> | specify path to IDMEF DTD file\n");
@@ -132,8 +133,11 @@ void usage(const char* prog, int code)
 	fprintf(stderr, "    $ZEEK_SEED_FILE                | file to load seeds from (not set)\n");
 	fprintf(stderr, "    $ZEEK_LOG_SUFFIX               | ASCII log file extension (.%s)\n", logging::writer::detail::Ascii::LogExt().c_str());
 	fprintf(stderr, "    $ZEEK_PROFILER_FILE            | Output file for script execution statistics (not set)\n");
+	fprintf(stderr, "    $ZEEK_SCRIPT_PROFILE_FILE      | Output file for sampled script call stacks (not set)\n");
+	fprintf(stderr, "    $ZEEK_SCRIPT_PROFILE_RATE      | Script call stack samples per second of CPU time (100)\n");
 	fprintf(stderr, "    $ZEEK_DISABLE_ZEEKYGEN         | Disable Zeekygen documentation support (%s)\n", util::zeekenv("ZEEK_DISABLE_ZEEKYGEN") ? "set" : "not set");
 	fprintf(stderr, "    $ZEEK_DNS_RESOLVER             | IPv4/IPv6 address of DNS resolver to use (%s)\n", util::zeekenv("ZEEK_DNS_RESOLVER") ? util::zeekenv("ZEEK_DNS_RESOLVER") : "not set, will use first IPv4 address from /etc/resolv.conf");
+	fprintf(stderr, "    $ZEEK_TIMER_WHEEL              | Use the timing wheel timer manager (%s)\n", util::zeekenv("ZEEK_TIMER_WHEEL") ? "set" : "not set");
 	fprintf(stderr, "    $ZEEK_DEBUG_LOG_STDERR         | Use stderr for debug logs generated via the -B flag");
 
 	fprintf(stderr, "\n");
@@ -272,6 +276,7 @@ Options parse_cmdline(int argc, char** argv)
 #endif
 
 		{"pseudo-realtime",	optional_argument, nullptr,	'E'},
+		{"bench",	optional_argument, nullptr,	'%'},
 		{"jobs",	optional_argument, nullptr,	'j'},
 		{"test",		no_argument,		nullptr,	'#'},
 
@@ -335,21 +340,18 @@ Options parse_cmdline(int argc, char** argv)
 			rval.supervisor_mode = true;
 			if ( optarg )
 				{
-				// TODO: for supervised offline pcap reading, the argument is
-				// expected to be number of workers like "-j 4" or possibly a
-				// list of worker/proxy/logger counts like "-j 4,2,1"
+				// With -r, that's the number of processes to split
+				// reading the traces across. Otherwise it isn't used
+				// yet.
+				rval.offline_shards = atoi(optarg);
+				if ( rval.offline_shards < 1 )
+					usage(zargs[0], 1);
 				}
 			break;
 		case 'p':
 			rval.script_prefixes.emplace_back(optarg);
 			break;
 		case 'r':
-			if ( rval.pcap_file )
-				{
-				fprintf(stderr, "ERROR: Only a single readfile option (-r) is allowed.\n");
-				exit(1);
-				}
-
 			if ( rval.interface )
 				{
 				fprintf(stderr, "Using -r is not allowed when reading a live interface.\n");
@@ -357,6 +359,7 @@ Options parse_cmdline(int argc, char** argv)
 				}
 
 			rval.pcap_file = optarg;
+			rval.pcap_files.emplace_back(optarg);
 			break;
 		case 's':
 			rval.signature_files.emplace_back(optarg);
@@ -445,6 +448,14 @@ Options parse_cmdline(int argc, char** argv)
 			usage(zargs[0], 1);
 			break;
 
+		case '%':
+			rval.bench_loops = 1;
+			if ( optarg )
+				rval.bench_loops = atoi(optarg);
+			if ( rval.bench_loops < 1 )
+				usage(zargs[0], 1);
+			break;
+
 		case 0:
 			// This happens for long options that don't have
 			// a short-option equivalent.
@@ -456,6 +467,40 @@ Options parse_cmdline(int argc, char** argv)
 			break;
 		}
 
+	if ( rval.bench_loops && ! rval.pcap_file )
+		{
+		fprintf(stderr, "ERROR: --bench requires reading a pcap file (-r).\n");
+		usage(zargs[0], 1);
+		}
+
+	if ( rval.pcap_file && rval.offline_shards )
+		// Reading traces in parallel doesn't need the supervisor.
+		rval.supervisor_mode = false;
+	else
+		rval.offline_shards = 0;
+
+	if ( rval.pcap_files.size() > 1 || rval.offline_shards )
+		{
+		// These need the mmap packet source, which reads a list of
+		// files and can pick out its share of the packets.
+		for ( const auto& f : rval.pcap_files )
+			{
+			if ( f == "-" || f.find(':') != std::string::npos )
+				{
+				fprintf(stderr, "ERROR: reading several traces, or with -j, needs plain file names (got '%s').\n", f.c_str());
+				exit(1);
+				}
+			}
+
+		if ( rval.bench_loops )
+			{
+			fprintf(stderr, "ERROR: --bench reads a single trace in a single process.\n");
+			exit(1);
+			}
+
+		rval.pcap_file = "mmap::" + util::implode_string_vector(rval.pcap_files, ":");
+		}
+
 	// Process remaining arguments. X=Y arguments indicate script
 	// variable/parameter assignments. X::Y arguments indicate plugins to
 	// activate/query. The remainder are treated as scripts to load.
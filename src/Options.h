@@ -45,6 +45,7 @@ struct Options {
 	bool ignore_checksums = false;
 	bool use_watchdog = false;
 	double pseudo_realtime = 0;
+	int bench_loops = 0;
 	detail::DNS_MgrMode dns_mode = detail::DNS_DEFAULT;
 
 	bool supervisor_mode = false;
@@ -62,6 +63,8 @@ struct Options {
 	std::optional<std::string> pcap_filter;
 	std::optional<std::string> interface;
 	std::optional<std::string> pcap_file;
+	std::vector<std::string> pcap_files; // All given with -r, pcap_file is built from them.
+	int offline_shards = 0; // Number of processes to split reading traces across.
 	std::vector<std::string> signature_files;
 
 	std::optional<std::string> pcap_output_file;
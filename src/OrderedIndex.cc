@@ -0,0 +1,151 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "OrderedIndex.h"
+
+#include "IPAddr.h"
+#include "Val.h"
+#include "ZeekString.h"
+
+namespace zeek::detail {
+
+// Compares two values of the same orderable type.
+static int compare_vals(const Val* a, const Val* b)
+	{
+	switch ( a->GetType()->InternalType() ) {
+	case TYPE_INTERNAL_INT:
+		{
+		auto x = a->ForceAsInt(), y = b->ForceAsInt();
+		return x < y ? -1 : (x > y);
+		}
+
+	case TYPE_INTERNAL_UNSIGNED:
+		{
+		auto x = a->ForceAsUInt(), y = b->ForceAsUInt();
+		return x < y ? -1 : (x > y);
+		}
+
+	case TYPE_INTERNAL_DOUBLE:
+		{
+		auto x = a->InternalDouble(), y = b->InternalDouble();
+		return x < y ? -1 : (x > y);
+		}
+
+	case TYPE_INTERNAL_ADDR:
+		{
+		const auto& x = a->AsAddr();
+		const auto& y = b->AsAddr();
+		return x < y ? -1 : (y < x);
+		}
+
+	case TYPE_INTERNAL_SUBNET:
+		{
+		const auto& x = a->AsSubNet();
+		const auto& y = b->AsSubNet();
+		return x < y ? -1 : (y < x);
+		}
+
+	case TYPE_INTERNAL_STRING:
+		return Bstr_cmp(a->AsString(), b->AsString());
+
+	default:
+		return 0;
+	}
+	}
+
+// Compares an index's leading components against prefix values.
+static int compare_prefix(const ListVal* l, const std::vector<const Val*>& prefix)
+	{
+	for ( size_t i = 0; i < prefix.size(); ++i )
+		{
+		if ( int c = compare_vals(l->Idx(i).get(), prefix[i]) )
+			return c;
+		}
+
+	return 0;
+	}
+
+bool OrderedIndex::IsOrderable(const Type* t)
+	{
+	switch ( t->InternalType() ) {
+	case TYPE_INTERNAL_INT:
+	case TYPE_INTERNAL_UNSIGNED:
+	case TYPE_INTERNAL_DOUBLE:
+	case TYPE_INTERNAL_ADDR:
+	case TYPE_INTERNAL_SUBNET:
+	case TYPE_INTERNAL_STRING:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+bool OrderedIndex::Less::operator()(const ListValPtr& a, const ListValPtr& b) const
+	{
+	for ( int i = 0; i < a->Length(); ++i )
+		{
+		if ( int c = compare_vals(a->Idx(i).get(), b->Idx(i).get()) )
+			return c < 0;
+		}
+
+	return false;
+	}
+
+bool OrderedIndex::Less::operator()(const ListValPtr& a, const Prefix& b) const
+	{
+	return compare_prefix(a.get(), b.vals) < 0;
+	}
+
+bool OrderedIndex::Less::operator()(const Prefix& a, const ListValPtr& b) const
+	{
+	return compare_prefix(b.get(), a.vals) > 0;
+	}
+
+void OrderedIndex::Insert(ListValPtr index)
+	{
+	keys.insert(std::move(index));
+	}
+
+void OrderedIndex::Remove(const ListVal* index)
+	{
+	std::vector<const Val*> vals;
+
+	for ( const auto& v : index->Vals() )
+		vals.push_back(v.get());
+
+	auto it = keys.find(Prefix{vals});
+
+	if ( it != keys.end() )
+		keys.erase(it);
+	}
+
+std::vector<ListValPtr> OrderedIndex::FindPrefix(const std::vector<const Val*>& prefix) const
+	{
+	std::vector<ListValPtr> rval;
+	auto [begin, end] = keys.equal_range(Prefix{prefix});
+
+	for ( auto it = begin; it != end; ++it )
+		rval.push_back(*it);
+
+	return rval;
+	}
+
+std::vector<ListValPtr> OrderedIndex::FindRange(const Val* lo, const Val* hi) const
+	{
+	std::vector<ListValPtr> rval;
+	std::vector<const Val*> lo_prefix{lo};
+
+	for ( auto it = keys.lower_bound(Prefix{lo_prefix}); it != keys.end(); ++it )
+		{
+		if ( compare_vals((*it)->Idx(0).get(), hi) > 0 )
+			break;
+
+		rval.push_back(*it);
+		}
+
+	return rval;
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,78 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <set>
+#include <vector>
+
+#include "IntrusivePtr.h"
+
+ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
+ZEEK_FORWARD_DECLARE_NAMESPACED(ListVal, zeek);
+ZEEK_FORWARD_DECLARE_NAMESPACED(Type, zeek);
+
+namespace zeek {
+using ListValPtr = zeek::IntrusivePtr<ListVal>;
+}
+
+namespace zeek::detail {
+
+/**
+ * A sorted secondary index over the keys of a table with the
+ * &ordered_index attribute. It allows finding all entries whose leading
+ * index components have given values, or whose first component lies in a
+ * range, without going through the whole table. The index holds the keys
+ * only; values still come from the table itself.
+ */
+class OrderedIndex {
+public:
+	/**
+	 * Returns whether values of the given type have an order the index can
+	 * use: numbers, addresses, subnets and strings.
+	 */
+	static bool IsOrderable(const Type* t);
+
+	/**
+	 * Adds a table index, unless it's already present.
+	 */
+	void Insert(ListValPtr index);
+
+	/**
+	 * Removes a table index, if present.
+	 */
+	void Remove(const ListVal* index);
+
+	void Clear()	{ keys.clear(); }
+	size_t Size() const	{ return keys.size(); }
+
+	/**
+	 * Returns all indices whose leading components equal the given
+	 * values, in ascending order.
+	 */
+	std::vector<ListValPtr> FindPrefix(const std::vector<const Val*>& prefix) const;
+
+	/**
+	 * Returns all indices whose first component lies within [lo, hi],
+	 * in ascending order.
+	 */
+	std::vector<ListValPtr> FindRange(const Val* lo, const Val* hi) const;
+
+private:
+	// Leading component values to look up with.
+	struct Prefix {
+		const std::vector<const Val*>& vals;
+	};
+
+	struct Less {
+		using is_transparent = void;
+
+		bool operator()(const ListValPtr& a, const ListValPtr& b) const;
+		bool operator()(const ListValPtr& a, const Prefix& b) const;
+		bool operator()(const Prefix& a, const ListValPtr& b) const;
+	};
+
+	std::set<ListValPtr, Less> keys;
+};
+
+} // namespace zeek::detail
@@ -0,0 +1,493 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "PatternSet.h"
+
+#include <ctype.h>
+#include <algorithm>
+#include <deque>
+
+#include "RE.h"
+#include "ZeekString.h"
+#include "util.h"
+
+namespace zeek::detail {
+
+namespace {
+
+// Beyond this many alternatives, we don't bother requiring any of them.
+constexpr size_t MAX_ALTERNATIVES = 16;
+
+// What we know about the strings that a part of a pattern matches.
+struct LiteralInfo {
+	// Whether the part only matches exactly the one string below.
+	bool is_exact = false;
+	std::string exact;
+
+	// Strings of which each match contains at least one. Empty if we
+	// don't know any.
+	std::vector<std::string> required;
+};
+
+char lower(int c)
+	{
+	return tolower(static_cast<u_char>(c));
+	}
+
+std::vector<std::string> required_of(const LiteralInfo& info)
+	{
+	if ( info.is_exact )
+		{
+		if ( info.exact.empty() )
+			return {};
+
+		return {info.exact};
+		}
+
+	return info.required;
+	}
+
+// How useful a set of alternatives is for filtering: the length of the
+// shortest one.
+size_t quality(const std::vector<std::string>& required)
+	{
+	if ( required.empty() )
+		return 0;
+
+	size_t q = required[0].size();
+
+	for ( const auto& r : required )
+		q = std::min(q, r.size());
+
+	return q;
+	}
+
+void consider(std::vector<std::string>& best, std::vector<std::string> candidate)
+	{
+	auto qc = quality(candidate);
+	auto qb = quality(best);
+
+	if ( qc > qb || (qc == qb && qc > 0 && candidate.size() < best.size()) )
+		best = std::move(candidate);
+	}
+
+// Walks the pattern syntax that the RE scanner accepts, well enough to
+// find literals. Anything it doesn't understand contributes nothing.
+class LiteralExtractor {
+public:
+	explicit LiteralExtractor(const char* text) : p(text)	{ }
+
+	std::vector<std::string> Required()
+		{
+		auto info = Alternation();
+
+		if ( failed || *p )
+			return {};
+
+		return required_of(info);
+		}
+
+private:
+	LiteralInfo Alternation()
+		{
+		auto info = Concatenation();
+
+		while ( *p == '|' )
+			{
+			++p;
+			auto rhs = Concatenation();
+
+			if ( info.is_exact && rhs.is_exact && info.exact == rhs.exact )
+				continue;
+
+			auto l = required_of(info);
+			auto r = required_of(rhs);
+
+			info = LiteralInfo{};
+
+			if ( l.empty() || r.empty() )
+				continue;
+
+			for ( auto& s : r )
+				if ( std::find(l.begin(), l.end(), s) == l.end() )
+					l.push_back(std::move(s));
+
+			if ( l.size() <= MAX_ALTERNATIVES )
+				info.required = std::move(l);
+			}
+
+		return info;
+		}
+
+	LiteralInfo Concatenation()
+		{
+		LiteralInfo info;
+		std::string run;
+		bool all_exact = true;
+
+		while ( *p && *p != '|' && *p != ')' && ! failed )
+			{
+			auto item = Repetition();
+
+			if ( item.is_exact )
+				{
+				run += item.exact;
+				continue;
+				}
+
+			all_exact = false;
+
+			if ( ! run.empty() )
+				consider(info.required, {run});
+
+			consider(info.required, std::move(item.required));
+			run.clear();
+			}
+
+		if ( all_exact )
+			{
+			info.is_exact = true;
+			info.exact = run;
+			}
+
+		else if ( ! run.empty() )
+			consider(info.required, {run});
+
+		return info;
+		}
+
+	LiteralInfo Repetition()
+		{
+		auto info = Atom();
+
+		for ( ;; )
+			{
+			if ( *p == '*' || *p == '?' )
+				{
+				++p;
+				info = LiteralInfo{};
+				}
+
+			else if ( *p == '+' )
+				{
+				++p;
+				info.required = required_of(info);
+				info.is_exact = false;
+				}
+
+			else if ( *p == '{' && isdigit(static_cast<u_char>(p[1])) )
+				{
+				++p;
+				int lo = 0;
+
+				while ( isdigit(static_cast<u_char>(*p)) )
+					lo = lo * 10 + (*p++ - '0');
+
+				while ( *p && *p != '}' )
+					++p;
+
+				if ( *p != '}' )
+					{
+					failed = true;
+					return {};
+					}
+
+				++p;
+
+				if ( lo == 0 )
+					info = LiteralInfo{};
+				else
+					{
+					info.required = required_of(info);
+					info.is_exact = false;
+					}
+				}
+
+			else
+				return info;
+			}
+		}
+
+	LiteralInfo Atom()
+		{
+		LiteralInfo info;
+
+		switch ( *p ) {
+		case '(':
+			++p;
+
+			// Our literals ignore case anyway.
+			if ( p[0] == '?' && (p[1] == 'i' || p[1] == 'I') && p[2] == ':' )
+				p += 3;
+
+			info = Alternation();
+
+			if ( *p != ')' )
+				{
+				failed = true;
+				return {};
+				}
+
+			++p;
+			return info;
+
+		case '[':
+			SkipClass();
+			return info;
+
+		case '"':
+			{
+			++p;
+			info.is_exact = true;
+
+			while ( *p && *p != '"' && ! failed )
+				{
+				if ( *p == '\\' )
+					{
+					++p;
+					info.exact += lower(Escape());
+					}
+				else
+					info.exact += lower(*p++);
+				}
+
+			if ( failed || *p != '"' )
+				{
+				failed = true;
+				return {};
+				}
+
+			++p;
+			return info;
+			}
+
+		case '{':
+			// A named definition; we don't look those up.
+			while ( *p && *p != '}' )
+				++p;
+
+			if ( *p != '}' )
+				failed = true;
+			else
+				++p;
+
+			return info;
+
+		case '^':
+		case '$':
+			++p;
+			info.is_exact = true;
+			return info;
+
+		case '.':
+			++p;
+			return info;
+
+		case '\\':
+			++p;
+			info.is_exact = true;
+			info.exact += lower(Escape());
+			return info;
+
+		case '*':
+		case '+':
+		case '?':
+		case '|':
+		case ')':
+		case '\0':
+			failed = true;
+			return {};
+
+		default:
+			info.is_exact = true;
+			info.exact += lower(*p++);
+			return info;
+		}
+		}
+
+	// Returns the character that the escape sequence at p stands for,
+	// reading it the way the RE scanner does.
+	int Escape()
+		{
+		if ( ! *p || (*p == 'x' && ! (isxdigit(static_cast<u_char>(p[1])) &&
+		                              isxdigit(static_cast<u_char>(p[2])))) )
+			{
+			failed = true;
+			return 0;
+			}
+
+		bool octal = *p >= '0' && *p <= '7';
+		int c = util::detail::expand_escape(p);
+
+		if ( octal )
+			while ( *p >= '0' && *p <= '7' )
+				++p;
+
+		return c;
+		}
+
+	void SkipClass()
+		{
+		++p;
+
+		if ( *p == '^' )
+			++p;
+
+		// A leading ']' is part of the class.
+		if ( *p == ']' )
+			++p;
+
+		while ( *p && *p != ']' )
+			{
+			if ( *p == '\\' && p[1] )
+				p += 2;
+
+			else if ( p[0] == '[' && p[1] == ':' )
+				{
+				p += 2;
+
+				while ( *p && ! (p[0] == ':' && p[1] == ']') )
+					++p;
+
+				if ( *p )
+					p += 2;
+				}
+
+			else
+				++p;
+			}
+
+		if ( *p == ']' )
+			++p;
+		else
+			failed = true;
+		}
+
+	const char* p;
+	bool failed = false;
+};
+
+} // namespace
+
+std::vector<std::string> PatternSet::RequiredLiterals(const char* pattern_text)
+	{
+	return LiteralExtractor(pattern_text).Required();
+	}
+
+int PatternSet::Add(RE_Matcher* re)
+	{
+	patterns.push_back(re);
+	return patterns.size() - 1;
+	}
+
+void PatternSet::AddLiteral(const std::string& literal, int idx)
+	{
+	int state = 0;
+
+	for ( auto c : literal )
+		{
+		auto& next = go[state][static_cast<u_char>(c)];
+
+		if ( next < 0 )
+			{
+			next = go.size();
+			state = next;
+
+			// Invalidates the reference.
+			go.emplace_back();
+			go.back().fill(-1);
+			outputs.emplace_back();
+			}
+		else
+			state = next;
+		}
+
+	outputs[state].push_back(idx);
+	}
+
+void PatternSet::Compile()
+	{
+	go.clear();
+	outputs.clear();
+	unfiltered.clear();
+
+	go.emplace_back();
+	go.back().fill(-1);
+	outputs.emplace_back();
+
+	for ( size_t i = 0; i < patterns.size(); ++i )
+		{
+		auto literals = RequiredLiterals(patterns[i]->PatternText());
+
+		if ( literals.empty() )
+			unfiltered.push_back(i);
+
+		for ( const auto& l : literals )
+			AddLiteral(l, i);
+		}
+
+	// Turn the trie into an automaton, breadth-first so that each
+	// state's failure state is complete before the state itself.
+	std::vector<int32_t> fail(go.size(), 0);
+	std::deque<int32_t> todo;
+
+	for ( auto& next : go[0] )
+		{
+		if ( next < 0 )
+			next = 0;
+		else
+			todo.push_back(next);
+		}
+
+	while ( ! todo.empty() )
+		{
+		auto state = todo.front();
+		todo.pop_front();
+
+		const auto& f = outputs[fail[state]];
+		outputs[state].insert(outputs[state].end(), f.begin(), f.end());
+
+		for ( int c = 0; c < 256; ++c )
+			{
+			auto& next = go[state][c];
+
+			if ( next < 0 )
+				next = go[fail[state]][c];
+			else
+				{
+				fail[next] = go[fail[state]][c];
+				todo.push_back(next);
+				}
+			}
+		}
+	}
+
+std::vector<int> PatternSet::MatchAnywhere(const String* s) const
+	{
+	std::vector<bool> candidates(patterns.size());
+
+	for ( auto idx : unfiltered )
+		candidates[idx] = true;
+
+	const u_char* b = s->Bytes();
+	int state = 0;
+
+	for ( int i = 0; i < s->Len(); ++i )
+		{
+		state = go[state][tolower(b[i])];
+
+		for ( auto idx : outputs[state] )
+			candidates[idx] = true;
+		}
+
+	std::vector<int> rval;
+
+	for ( size_t i = 0; i < patterns.size(); ++i )
+		if ( candidates[i] && patterns[i]->MatchAnywhere(s) )
+			rval.push_back(i);
+
+	return rval;
+	}
+
+} // namespace zeek::detail
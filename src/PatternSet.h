@@ -0,0 +1,80 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zeek {
+class RE_Matcher;
+class String;
+}
+
+namespace zeek::detail {
+
+/**
+ * Matches a string against many patterns at once. For each pattern, the
+ * set works out literal strings of which every match has to contain at
+ * least one, and looks for all of them in a single Aho-Corasick pass over
+ * the input. Only the patterns whose literals occur then run their full
+ * DFA, along with any patterns no literals could be found for.
+ *
+ * Literals are looked for without regard to case, so that they also filter
+ * case-insensitive patterns; the DFAs have the last word.
+ */
+class PatternSet {
+public:
+	/**
+	 * Adds a pattern. The set doesn't take ownership; the pattern has to
+	 * remain valid for the set's lifetime.
+	 *
+	 * @return The pattern's index, counting from zero in the order of
+	 * adding.
+	 */
+	int Add(RE_Matcher* re);
+
+	/**
+	 * Builds the prefilter. Needs to be called once after adding all
+	 * patterns and before matching.
+	 */
+	void Compile();
+
+	/**
+	 * Returns the indices of all patterns occurring anywhere in the given
+	 * string, in ascending order.
+	 */
+	std::vector<int> MatchAnywhere(const String* s) const;
+
+	/**
+	 * Returns the number of patterns.
+	 */
+	size_t Size() const	{ return patterns.size(); }
+
+	/**
+	 * Returns the number of patterns that run on every input, for lack
+	 * of any literals they require.
+	 */
+	size_t NumUnfiltered() const	{ return unfiltered.size(); }
+
+	/**
+	 * Returns the literals of which matches of the given pattern text
+	 * have to contain at least one, in lower case. Returns nothing if
+	 * there aren't any the analysis can tell.
+	 */
+	static std::vector<std::string> RequiredLiterals(const char* pattern_text);
+
+private:
+	void AddLiteral(const std::string& literal, int idx);
+
+	std::vector<RE_Matcher*> patterns;
+	std::vector<int> unfiltered;
+
+	// The Aho-Corasick automaton, with state 0 as its root. Once
+	// compiled, every state has a transition for every byte.
+	std::vector<std::array<int32_t, 256>> go;
+	std::vector<std::vector<int>> outputs;
+};
+
+} // namespace zeek::detail
@@ -0,0 +1,256 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Poptrie.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::detail {
+
+static inline int popcount(uint64_t x)
+	{
+	return __builtin_popcountll(x);
+	}
+
+// Returns the number of set bits at positions up to and including pos.
+static inline int rank(uint64_t bits, uint32_t pos)
+	{
+	return popcount(bits << (63 - pos));
+	}
+
+Poptrie::Prefix Poptrie::MakePrefix(const IPAddr& addr, int len, void* data)
+	{
+	uint32_t w[4];
+	addr.CopyIPv6(w, IPAddr::Host);
+
+	Prefix p;
+	p.addr[0] = (uint64_t(w[0]) << 32) | w[1];
+	p.addr[1] = (uint64_t(w[2]) << 32) | w[3];
+	p.len = len;
+	p.data = data;
+
+	// Clear the bits beyond the prefix.
+	if ( len < 64 )
+		p.addr[0] &= len ? ~uint64_t(0) << (64 - len) : 0;
+
+	if ( len < 128 )
+		p.addr[1] &= len > 64 ? ~uint64_t(0) << (128 - len) : 0;
+
+	return p;
+	}
+
+Poptrie::Poptrie(std::vector<Prefix> prefixes)
+	{
+	std::sort(prefixes.begin(), prefixes.end(),
+	          [](const Prefix& a, const Prefix& b)
+		{
+		if ( a.addr[0] != b.addr[0] )
+			return a.addr[0] < b.addr[0];
+		if ( a.addr[1] != b.addr[1] )
+			return a.addr[1] < b.addr[1];
+		return a.len < b.len;
+		});
+
+	void* default_data = nullptr;
+
+	for ( const auto& p : prefixes )
+		if ( p.len == 0 )
+			default_data = p.data;
+
+	nodes.resize(1);
+	Build(0, prefixes, 0, prefixes.size(), 0, default_data);
+
+	// Locate the node for IPv4-mapped addresses.
+	const uint64_t v4[2] = {0, 0x0000ffff00000000ULL};
+	uint32_t node = 0;
+	int depth = 0;
+
+	while ( depth < 96 )
+		{
+		const auto& n = nodes[node];
+		auto c = Chunk(v4, depth);
+
+		if ( ! (n.children & (uint64_t(1) << c)) )
+			{
+			v4_leaf = leaves[n.leaf_base + rank(n.leaves, c) - 1];
+			break;
+			}
+
+		node = n.child_base + rank(n.children, c) - 1;
+		depth += STRIDE;
+		}
+
+	if ( depth == 96 )
+		{
+		v4_has_node = true;
+		v4_node = node;
+		}
+
+	nodes.shrink_to_fit();
+	leaves.shrink_to_fit();
+	}
+
+uint32_t Poptrie::Chunk(const uint64_t addr[2], int depth)
+	{
+	// Bits beyond the end of the address count as zero.
+	uint64_t v;
+
+	if ( depth == 0 )
+		v = addr[0];
+	else if ( depth < 64 )
+		v = (addr[0] << depth) | (addr[1] >> (64 - depth));
+	else if ( depth < 128 )
+		v = addr[1] << (depth - 64);
+	else
+		v = 0;
+
+	return v >> (64 - STRIDE);
+	}
+
+void Poptrie::Build(uint32_t node, const std::vector<Prefix>& prefixes,
+                    size_t begin, size_t end, int depth, void* inherited)
+	{
+	constexpr uint32_t fanout = 1 << STRIDE;
+
+	// The longest match for each chunk among the prefixes ending in this
+	// node, and the ranges of the prefixes continuing in each child.
+	void* best[fanout];
+	int best_len[fanout];
+	size_t child_begin[fanout];
+	size_t child_end[fanout];
+	uint64_t children = 0;
+
+	std::fill(best, best + fanout, inherited);
+	std::fill(best_len, best_len + fanout, 0);
+
+	for ( size_t i = begin; i < end; ++i )
+		{
+		const auto& p = prefixes[i];
+
+		// Left over from our parent.
+		if ( p.len <= depth )
+			continue;
+
+		auto c = Chunk(p.addr, depth);
+
+		if ( p.len > depth + STRIDE )
+			{
+			if ( ! (children & (uint64_t(1) << c)) )
+				child_begin[c] = i;
+
+			children |= uint64_t(1) << c;
+			child_end[c] = i + 1;
+			continue;
+			}
+
+		// The prefix covers all chunks agreeing on its remaining bits.
+		int l = p.len - depth;
+		uint32_t n = 1 << (STRIDE - l);
+
+		for ( uint32_t j = c; j < c + n; ++j )
+			if ( l > best_len[j] )
+				{
+				best[j] = p.data;
+				best_len[j] = l;
+				}
+		}
+
+	uint32_t child_base = nodes.size();
+	nodes.resize(nodes.size() + popcount(children));
+
+	// Store one leaf per run of chunks with equal data, skipping those
+	// continuing in a child.
+	uint32_t leaf_base = leaves.size();
+	uint64_t leaf_bits = 0;
+	bool first = true;
+	void* prev = nullptr;
+
+	for ( uint32_t c = 0; c < fanout; ++c )
+		{
+		if ( children & (uint64_t(1) << c) )
+			continue;
+
+		if ( first || best[c] != prev )
+			{
+			leaf_bits |= uint64_t(1) << c;
+			leaves.push_back(best[c]);
+			prev = best[c];
+			first = false;
+			}
+		}
+
+	nodes[node] = {children, leaf_bits, child_base, leaf_base};
+
+	uint32_t child = child_base;
+
+	for ( uint32_t c = 0; c < fanout; ++c )
+		if ( children & (uint64_t(1) << c) )
+			Build(child++, prefixes, child_begin[c], child_end[c],
+			      depth + STRIDE, best[c]);
+	}
+
+void* Poptrie::Descend(const uint64_t addr[2], uint32_t node, int depth) const
+	{
+	while ( true )
+		{
+		const auto& n = nodes[node];
+		auto c = Chunk(addr, depth);
+
+		if ( ! (n.children & (uint64_t(1) << c)) )
+			return leaves[n.leaf_base + rank(n.leaves, c) - 1];
+
+		node = n.child_base + rank(n.children, c) - 1;
+		depth += STRIDE;
+		}
+	}
+
+void* Poptrie::Lookup(const IPAddr& a) const
+	{
+	uint32_t w[4];
+	a.CopyIPv6(w, IPAddr::Host);
+
+	const uint64_t addr[2] = {(uint64_t(w[0]) << 32) | w[1],
+	                          (uint64_t(w[2]) << 32) | w[3]};
+
+	if ( a.GetFamily() == IPv4 )
+		return v4_has_node ? Descend(addr, v4_node, 96) : v4_leaf;
+
+	return Descend(addr, 0, 0);
+	}
+
+TEST_CASE("poptrie lookup")
+	{
+	int a, b, c, d, e;
+
+	std::vector<Poptrie::Prefix> prefixes = {
+		Poptrie::MakePrefix(IPAddr("10.0.0.0"), 96 + 8, &a),
+		Poptrie::MakePrefix(IPAddr("10.1.0.0"), 96 + 16, &b),
+		Poptrie::MakePrefix(IPAddr("10.1.2.3"), 128, &c),
+		Poptrie::MakePrefix(IPAddr("2001:db8::"), 32, &d),
+		Poptrie::MakePrefix(IPAddr("2001:db8:0:1::"), 64, &e),
+	};
+
+	Poptrie t(prefixes);
+
+	CHECK(t.Lookup(IPAddr("10.2.3.4")) == &a);
+	CHECK(t.Lookup(IPAddr("10.1.3.4")) == &b);
+	CHECK(t.Lookup(IPAddr("10.1.2.3")) == &c);
+	CHECK(t.Lookup(IPAddr("10.1.2.4")) == &b);
+	CHECK(t.Lookup(IPAddr("11.0.0.1")) == nullptr);
+	CHECK(t.Lookup(IPAddr("2001:db8::1")) == &d);
+	CHECK(t.Lookup(IPAddr("2001:db8:0:1::1")) == &e);
+	CHECK(t.Lookup(IPAddr("2001:db9::1")) == nullptr);
+
+	prefixes.push_back(Poptrie::MakePrefix(IPAddr("::"), 0, &a));
+	Poptrie with_default(prefixes);
+	CHECK(with_default.Lookup(IPAddr("11.0.0.1")) == &a);
+	CHECK(with_default.Lookup(IPAddr("2001:db9::1")) == &a);
+	CHECK(with_default.Lookup(IPAddr("2001:db8::1")) == &d);
+
+	Poptrie empty({});
+	CHECK(empty.Lookup(IPAddr("10.1.2.3")) == nullptr);
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,95 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "IPAddr.h"
+
+namespace zeek::detail {
+
+/**
+ * A compressed multibit trie for longest-prefix matching of addresses,
+ * with IPv4 addresses mapped into IPv6 space as in PrefixTable. This
+ * follows Asai and Ohara, "Poptrie: A Compressed Trie with Population
+ * Count for Fast and Scalable Software IP Routing Table Lookup": each node
+ * covers six bits of the address and locates its children and leaves in
+ * contiguous arrays through the population count of two bitmaps, so a
+ * lookup takes one node access per six bits instead of chasing a pointer
+ * per branching bit. Leaves hold the result of the longest match for
+ * their range, so lookups never backtrack.
+ *
+ * The trie is immutable once built. PrefixTable builds one from its
+ * patricia tree while the table sees lookups but no changes.
+ */
+class Poptrie {
+public:
+	struct Prefix {
+		uint64_t addr[2];	// Host order, most significant word first.
+		int len;
+		void* data;
+	};
+
+	/**
+	 * Returns a prefix for use with the constructor.
+	 *
+	 * @param addr The address, of which only the first *len* bits
+	 * count.
+	 *
+	 * @param len The length of the prefix in bits, counting IPv4
+	 * addresses as IPv6-mapped.
+	 *
+	 * @param data The data to return for matching addresses.
+	 */
+	static Prefix MakePrefix(const IPAddr& addr, int len, void* data);
+
+	/**
+	 * Constructor.
+	 *
+	 * @param prefixes The prefixes to match, without duplicates.
+	 */
+	explicit Poptrie(std::vector<Prefix> prefixes);
+
+	/**
+	 * Returns the data of the longest prefix matching an address, or
+	 * null if there is none.
+	 */
+	void* Lookup(const IPAddr& addr) const;
+
+	/**
+	 * Returns the number of bytes allocated by the trie.
+	 */
+	size_t MemoryAllocation() const
+		{ return sizeof(*this) + nodes.capacity() * sizeof(Node) + leaves.capacity() * sizeof(void*); }
+
+private:
+	static constexpr int STRIDE = 6;
+
+	struct Node {
+		uint64_t children;	// Bit set for chunks continuing in a child node.
+		uint64_t leaves;	// Bit set for leaf chunks starting a run of equal data.
+		uint32_t child_base;	// Index of the first child in nodes.
+		uint32_t leaf_base;	// Index of the first leaf in leaves.
+	};
+
+	static uint32_t Chunk(const uint64_t addr[2], int depth);
+
+	void Build(uint32_t node, const std::vector<Prefix>& prefixes,
+	           size_t begin, size_t end, int depth, void* inherited);
+
+	void* Descend(const uint64_t addr[2], uint32_t node, int depth) const;
+
+	std::vector<Node> nodes;	// The root comes first.
+	std::vector<void*> leaves;
+
+	// IPv4-mapped addresses share their first 96 bits, so lookups for
+	// them start right at the node for ::ffff:0:0/96 if there's one,
+	// or return v4_leaf otherwise.
+	bool v4_has_node = false;
+	uint32_t v4_node = 0;
+	void* v4_leaf = nullptr;
+};
+
+} // namespace zeek::detail
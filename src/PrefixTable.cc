@@ -2,8 +2,18 @@
 #include "Reporter.h"
 #include "Val.h"
 
+#include <algorithm>
+#include <chrono>
+
+#include "3rdparty/doctest.h"
+
 namespace zeek::detail {
 
+// The Poptrie gets built after this many lookups without a change, or
+// more for larger tables, to amortize its construction.
+static constexpr uint64_t POPTRIE_MIN_LOOKUPS = 1000;
+static constexpr uint64_t POPTRIE_LOOKUPS_PER_NODE = 4;
+
 prefix_t* PrefixTable::MakePrefix(const IPAddr& addr, int width)
 	{
 	prefix_t* prefix = (prefix_t*) util::safe_malloc(sizeof(prefix_t));
@@ -22,8 +32,26 @@ IPPrefix PrefixTable::PrefixToIPPrefix(prefix_t* prefix)
 	                       IPAddr::Network), prefix->bitlen, true);
 	}
 
+void PrefixTable::BuildPoptrie() const
+	{
+	std::vector<Poptrie::Prefix> prefixes;
+	patricia_node_t* node;
+
+	PATRICIA_WALK(tree->head, node)
+		{
+		IPAddr addr(IPv6, reinterpret_cast<const uint32_t*>(&node->prefix->add.sin6),
+		            IPAddr::Network);
+		prefixes.push_back(Poptrie::MakePrefix(addr, node->prefix->bitlen, node->data));
+		}
+	PATRICIA_WALK_END;
+
+	lpm = std::make_unique<Poptrie>(std::move(prefixes));
+	}
+
 void* PrefixTable::Insert(const IPAddr& addr, int width, void* data)
 	{
+	Changed();
+
 	prefix_t* prefix = MakePrefix(addr, width);
 	patricia_node_t* node = patricia_lookup(tree, prefix);
 	Deref_Prefix(prefix);
@@ -91,6 +119,17 @@ std::list<std::tuple<IPPrefix,void*>> PrefixTable::FindAll(const SubNetVal* valu
 
 void* PrefixTable::Lookup(const IPAddr& addr, int width, bool exact) const
 	{
+	if ( ! exact && width == 128 )
+		{
+		if ( ! lpm &&
+		     ++lookups_since_change >= std::max(POPTRIE_MIN_LOOKUPS,
+		                                        POPTRIE_LOOKUPS_PER_NODE * tree->num_active_node) )
+			BuildPoptrie();
+
+		if ( lpm )
+			return lpm->Lookup(addr);
+		}
+
 	prefix_t* prefix = MakePrefix(addr, width);
 	patricia_node_t* node =
 		exact ? patricia_search_exact(tree, prefix) :
@@ -138,6 +177,7 @@ void* PrefixTable::Remove(const IPAddr& addr, int width)
 
 	void* old = node->data;
 	patricia_remove(tree, node);
+	Changed();
 
 	return old;
 	}
@@ -206,4 +246,108 @@ void* PrefixTable::GetNext(iterator* i)
 	// Not reached.
 	}
 
+TEST_CASE("prefix table lookup")
+	{
+	PrefixTable t;
+	int a, b, c;
+
+	t.Insert(IPAddr("10.0.0.0"), 96 + 8, &a);
+	t.Insert(IPAddr("10.1.0.0"), 96 + 16, &b);
+	t.Insert(IPAddr("2001:db8::"), 32, &c);
+
+	// Enough lookups for switching to the Poptrie, which needs to agree
+	// with the patricia tree.
+	for ( int i = 0; i < 2000; ++i )
+		{
+		CHECK(t.Lookup(IPAddr("10.2.3.4"), 128) == &a);
+		CHECK(t.Lookup(IPAddr("10.1.3.4"), 128) == &b);
+		CHECK(t.Lookup(IPAddr("11.1.3.4"), 128) == nullptr);
+		CHECK(t.Lookup(IPAddr("2001:db8::1"), 128) == &c);
+		}
+
+	t.Remove(IPAddr("10.1.0.0"), 96 + 16);
+	CHECK(t.Lookup(IPAddr("10.1.3.4"), 128) == &a);
+
+	t.Insert(IPAddr("10.1.3.0"), 96 + 24, &b);
+	CHECK(t.Lookup(IPAddr("10.1.3.4"), 128) == &b);
+
+	t.Clear();
+	CHECK(t.Lookup(IPAddr("10.1.3.4"), 128) == nullptr);
+	}
+
+// Compares lookups through a Poptrie with patricia_search_best. Run with
+// --no-skip to include it.
+TEST_CASE("prefix table lookup benchmark" * doctest::skip())
+	{
+	patricia_tree_t* tree = New_Patricia(128);
+	std::vector<Poptrie::Prefix> prefixes;
+	uint32_t state = 1;
+
+	auto next = [&state]()
+		{
+		state = state * 1103515245 + 12345;
+		return state;
+		};
+
+	auto make_prefix = [](uint32_t a, int width)
+		{
+		prefix_t* prefix = (prefix_t*) util::safe_malloc(sizeof(prefix_t));
+		IPAddr(IPv4, &a, IPAddr::Network).CopyIPv6(&prefix->add.sin6);
+		prefix->family = AF_INET6;
+		prefix->bitlen = width;
+		prefix->ref_count = 1;
+		return prefix;
+		};
+
+	for ( int i = 0; i < 100000; ++i )
+		{
+		uint32_t a = htonl(next());
+		int width = 96 + 8 + next() % 17;
+		prefix_t* prefix = make_prefix(a, width);
+		patricia_node_t* node = patricia_lookup(tree, prefix);
+		Deref_Prefix(prefix);
+
+		if ( ! node->data )
+			{
+			node->data = node;
+			prefixes.push_back(Poptrie::MakePrefix(IPAddr(IPv4, &a, IPAddr::Network), width, node));
+			}
+		}
+
+	std::vector<uint32_t> addrs;
+
+	for ( int i = 0; i < 1000000; ++i )
+		addrs.push_back(htonl(next()));
+
+	auto start = std::chrono::steady_clock::now();
+	size_t patricia_matches = 0;
+
+	for ( auto a : addrs )
+		{
+		prefix_t* prefix = make_prefix(a, 128);
+		patricia_matches += patricia_search_best(tree, prefix) != nullptr;
+		Deref_Prefix(prefix);
+		}
+
+	auto mid = std::chrono::steady_clock::now();
+	Poptrie t(std::move(prefixes));
+	auto built = std::chrono::steady_clock::now();
+	size_t poptrie_matches = 0;
+
+	for ( auto a : addrs )
+		poptrie_matches += t.Lookup(IPAddr(IPv4, &a, IPAddr::Network)) != nullptr;
+
+	auto end = std::chrono::steady_clock::now();
+
+	CHECK(patricia_matches == poptrie_matches);
+
+	using ms = std::chrono::milliseconds;
+	MESSAGE("patricia_search_best: " << std::chrono::duration_cast<ms>(mid - start).count() << " ms");
+	MESSAGE("Poptrie build: " << std::chrono::duration_cast<ms>(built - mid).count() << " ms, "
+	        << t.MemoryAllocation() << " bytes");
+	MESSAGE("Poptrie lookups: " << std::chrono::duration_cast<ms>(end - built).count() << " ms");
+
+	Destroy_Patricia(tree, nullptr);
+	}
+
 } // namespace zeek::detail
@@ -5,8 +5,10 @@ extern "C" {
 }
 
 #include <list>
+#include <memory>
 
 #include "IPAddr.h"
+#include "Poptrie.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(SubNetVal, zeek);
@@ -48,7 +50,7 @@ public:
 	void* Remove(const IPAddr& addr, int width);
 	void* Remove(const Val* value);
 
-	void Clear()	{ Clear_Patricia(tree, delete_function); }
+	void Clear()	{ Clear_Patricia(tree, delete_function); Changed(); }
 
 	// Sets a function to call for each node when table is cleared/destroyed.
 	void SetDeleteFunction(data_fn_t del_fn)	{ delete_function = del_fn; }
@@ -60,8 +62,20 @@ private:
 	static prefix_t* MakePrefix(const IPAddr& addr, int width);
 	static IPPrefix PrefixToIPPrefix(prefix_t* p);
 
+	// Drops the Poptrie after a change of the table.
+	void Changed()	{ lpm.reset(); lookups_since_change = 0; }
+
+	void BuildPoptrie() const;
+
 	patricia_tree_t* tree;
 	data_fn_t delete_function;
+
+	// Longest-prefix matches of addresses, the common case for lookups,
+	// go through a Poptrie once the table has seen a number of lookups
+	// without changes. It's dropped on the next change and rebuilt once
+	// the table settles again.
+	mutable std::unique_ptr<Poptrie> lpm;
+	mutable uint64_t lookups_since_change = 0;
 };
 
 } // namespace zeek::detail
@@ -248,11 +248,19 @@ bool Specific_RE_Matcher::MatchAll(const u_char* bv, int n)
 		// matched is empty.
 		return n == 0;
 
+	const DFA_Table* table = dfa->Table();
 	DFA_State* d = dfa->StartState();
 	d = d->Xtion(ecs[SYM_BOL], dfa);
 
 	while ( d )
 		{
+		if ( table )
+			{
+			int k = table->Run(d, bv, n, ecs, false);
+			bv += k;
+			n -= k;
+			}
+
 		if ( --n < 0 )
 			break;
 
@@ -273,6 +281,7 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n)
 		// An empty pattern matches anything.
 		return 1;
 
+	const DFA_Table* table = dfa->Table();
 	DFA_State* d = dfa->StartState();
 
 	d = d->Xtion(ecs[SYM_BOL], dfa);
@@ -280,6 +289,14 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n)
 
 	for ( int i = 0; i < n; ++i )
 		{
+		if ( table )
+			{
+			i += table->Run(d, bv + i, n - i, ecs, true);
+
+			if ( i == n )
+				break;
+			}
+
 		int ec = ecs[bv[i]];
 		d = d->Xtion(ec, dfa);
 		if ( ! d )
@@ -305,6 +322,19 @@ void Specific_RE_Matcher::Dump(FILE* f)
 	dfa->Dump(f);
 	}
 
+RE_Match_State::~RE_Match_State()
+	{
+	Unref(current_state);
+	}
+
+void RE_Match_State::Clear()
+	{
+	current_pos = -1;
+	Unref(current_state);
+	current_state = nullptr;
+	accepted_matches.clear();
+	}
+
 inline void RE_Match_State::AddMatches(const AcceptingSet& as,
                                        MatchPos position)
 	{
@@ -317,6 +347,8 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as,
 bool RE_Match_State::Match(const u_char* bv, int n,
 				bool bol, bool eol, bool clear)
 	{
+	DFA_State* held = current_state;
+
 	if ( current_pos == -1 )
 		{
 		// First call to Match().
@@ -337,10 +369,14 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 		current_state = dfa->StartState();
 
 	if ( ! current_state )
+		{
+		Unref(held);
 		return false;
+		}
 
 	current_pos = 0;
 
+	const DFA_Table* table = dfa->Table();
 	size_t old_matches = accepted_matches.size();
 
 	int ec;
@@ -354,7 +390,30 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 		else if ( m == -1 )
 			ec = ecs[SYM_EOL];
 		else
+			{
+			// Skip over input that doesn't get us anywhere else.
+			// Seeing an accepting state again adds no new matches.
+			if ( int k = current_state->SelfLoopSpan(bv, m + 1, ecs, dfa) )
+				{
+				bv += k;
+				current_pos += k;
+				m -= k - 1;
+				continue;
+				}
+
+			if ( table )
+				{
+				if ( int k = table->Run(current_state, bv, m + 1, ecs, true) )
+					{
+					bv += k;
+					current_pos += k;
+					m -= k - 1;
+					continue;
+					}
+				}
+
 			ec = ecs[*(bv++)];
+			}
 
 		DFA_State* next_state = current_state->Xtion(ec,dfa);
 
@@ -374,6 +433,11 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 		current_state = next_state;
 		}
 
+	if ( current_state )
+		Ref(current_state);
+
+	Unref(held);
+
 	return accepted_matches.size() != old_matches;
 	}
 
@@ -385,6 +449,7 @@ int Specific_RE_Matcher::LongestMatch(const u_char* bv, int n)
 
 	// Use -1 to indicate no match.
 	int last_accept = -1;
+	const DFA_Table* table = dfa->Table();
 	DFA_State* d = dfa->StartState();
 
 	d = d->Xtion(ecs[SYM_BOL], dfa);
@@ -396,6 +461,14 @@ int Specific_RE_Matcher::LongestMatch(const u_char* bv, int n)
 
 	for ( int i = 0; i < n; ++i )
 		{
+		if ( table )
+			{
+			i += table->Run(d, bv + i, n - i, ecs, true);
+
+			if ( i == n )
+				break;
+			}
+
 		int ec = ecs[bv[i]];
 		d = d->Xtion(ec, dfa);
 
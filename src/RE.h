@@ -153,22 +153,26 @@ public:
 		current_state = nullptr;
 		}
 
+	~RE_Match_State();
+
+	RE_Match_State(const RE_Match_State&) = delete;
+	RE_Match_State& operator=(const RE_Match_State&) = delete;
+
 	const AcceptingMatchSet& AcceptedMatches() const
 		{ return accepted_matches; }
 
 	// Returns the number of bytes feeded into the matcher so far
 	int Length()	{ return current_pos; }
 
+	// Returns true if the DFA has run into a dead end, so that further
+	// input can't lead to any new match until starting over.
+	bool Exhausted() const	{ return current_pos >= 0 && ! current_state; }
+
 	// Returns true if this inputs leads to at least one new match.
 	// If clear is true, starts matching over.
 	bool Match(const u_char* bv, int n, bool bol, bool eol, bool clear);
 
-	void Clear()
-		{
-		current_pos = -1;
-		current_state = nullptr;
-		accepted_matches.clear();
-		}
+	void Clear();
 
 	void AddMatches(const AcceptingSet& as, MatchPos position);
 
@@ -177,6 +181,9 @@ protected:
 	int* ecs;
 
 	AcceptingMatchSet accepted_matches;
+
+	// Held across calls, so that the DFA can't free it when staying
+	// within its state budget.
 	DFA_State* current_state;
 	int current_pos;
 };
@@ -29,8 +29,9 @@ constexpr double RT_INCIRC = 281474943156225.0;
 
 namespace zeek::detail {
 
-RandTest::RandTest()
+RandTest::RandTest(bool arg_histogram_only)
 	{
+	histogram_only = arg_histogram_only;
 	totalc = 0;
 	mp = 0;
 	sccfirst = 1;
@@ -46,51 +47,115 @@ RandTest::RandTest()
 void RandTest::add(const void *buf, int bufl)
 	{
 	const unsigned char *bp = static_cast<const unsigned char*>(buf);
-	int oc;
 
-	while (bufl-- > 0)
+	if (bufl <= 0)
+		return;
+
+	/* All the sums of byte values below are integers well within
+	   the range that doubles represent exactly, so accumulating them
+	   as integers first yields the same results as updating the
+	   statistics one byte at a time. */
+
+	/* Count into several histograms, so that runs of the same byte
+	   don't serialize on a single counter. That only pays off for
+	   buffers large enough to amortize setting them up. */
+	if (bufl < 1024)
 		{
-		oc = *bp++;
-		ccount[oc]++;   /* Update counter for this bin */
-		totalc++;
-
-		/* Update inside / outside circle counts for Monte Carlo
- 		   computation of PI */
-		monte[mp++] = oc;  /* Save character for Monte Carlo */
-		if (mp >= RT_MONTEN)  /* Calculate every RT_MONTEN character */
-			{
-			mp = 0;
-			mcount++;
-			montex = 0;
-			montey = 0;
-			for (int mj=0; mj < RT_MONTEN/2; mj++)
-				{
-				montex = (montex * 256.0) + monte[mj];
-				montey = (montey * 256.0) + monte[(RT_MONTEN / 2) + mj];
-				}
-			if (montex*montex + montey*montey <= RT_INCIRC)
-				{
-				inmont++;
-				}
-			}
+		for (int i = 0; i < bufl; i++)
+			ccount[bp[i]]++;
+		}
+	else
+		{
+		uint32_t hist[4][256] = {};
+		int i = 0;
 
-		/* Update calculation of serial correlation coefficient */
-		if (sccfirst)
+		for (; i + 4 <= bufl; i += 4)
 			{
-			sccfirst = 0;
-			scclast = 0;
-			sccu0 = oc;
+			hist[0][bp[i]]++;
+			hist[1][bp[i + 1]]++;
+			hist[2][bp[i + 2]]++;
+			hist[3][bp[i + 3]]++;
 			}
-		else
+
+		for (; i < bufl; i++)
+			hist[0][bp[i]]++;
+
+		for (int b = 0; b < 256; b++)
+			ccount[b] += uint64_t(hist[0][b]) + hist[1][b] + hist[2][b] + hist[3][b];
+		}
+
+	totalc += bufl;
+
+	if (histogram_only)
+		return;
+
+	/* Update inside / outside circle counts for Monte Carlo
+	   computation of PI, from each RT_MONTEN bytes. The co-ordinates
+	   are integers of RT_MONTEN / 2 bytes. */
+	static_assert(RT_MONTEN == 6, "Monte Carlo kernel assumes 3-byte co-ordinates");
+
+	uint64_t x = 0, y = 0;
+	bool have_xy = false;
+	int i = 0;
+
+	while (mp > 0 && i < bufl)
+		{
+		monte[mp++] = bp[i++];
+
+		if (mp >= RT_MONTEN)
 			{
-			scct1 = scct1 + scclast * oc;
+			mp = 0;
+			x = (uint64_t(monte[0]) << 16) | (monte[1] << 8) | monte[2];
+			y = (uint64_t(monte[3]) << 16) | (monte[4] << 8) | monte[5];
+			have_xy = true;
+			mcount++;
+			inmont += (x * x + y * y <= uint64_t(RT_INCIRC));
 			}
+		}
 
-		scct2 = scct2 + oc;
-		scct3 = scct3 + (oc * oc);
-		scclast = oc;
-		oc <<= 1;
+	for (; i + RT_MONTEN <= bufl; i += RT_MONTEN)
+		{
+		const unsigned char* m = bp + i;
+		x = (uint64_t(m[0]) << 16) | (m[1] << 8) | m[2];
+		y = (uint64_t(m[3]) << 16) | (m[4] << 8) | m[5];
+		mcount++;
+		inmont += (x * x + y * y <= uint64_t(RT_INCIRC));
+		have_xy = true;
+		}
+
+	while (i < bufl)
+		monte[mp++] = bp[i++];
+
+	if (have_xy)
+		{
+		montex = double(x);
+		montey = double(y);
 		}
+
+	/* Update calculation of serial correlation coefficient */
+	if (sccfirst)
+		{
+		sccfirst = 0;
+		scclast = 0;
+		sccu0 = bp[0];
+		}
+
+	uint64_t t1 = 0, t2 = 0, t3 = 0;
+	unsigned int last = static_cast<unsigned int>(scclast);
+
+	for (i = 0; i < bufl; i++)
+		{
+		unsigned int oc = bp[i];
+		t1 += last * oc;
+		t2 += oc;
+		t3 += oc * oc;
+		last = oc;
+		}
+
+	scct1 += double(t1);
+	scct2 += double(t2);
+	scct3 += double(t3);
+	scclast = last;
 	}
 
 void RandTest::end(double* r_ent, double* r_chisq,
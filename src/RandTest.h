@@ -14,7 +14,9 @@ namespace zeek::detail {
 
 class RandTest {
 public:
-	RandTest();
+	// With histogram_only, only the statistics derived from the byte
+	// histogram get computed: the entropy, chi-square and mean.
+	explicit RandTest(bool histogram_only = false);
 	void add(const void* buf, int bufl);
 	void end(double* r_ent, double* r_chisq, double* r_mean,
 	         double* r_montepicalc, double* r_scc);
@@ -30,6 +32,7 @@ private:
 	int64_t inmont, mcount;
 	double cexp, montex, montey, montepi,
 	       sccu0, scclast, scct1, scct2, scct3;
+	bool histogram_only;
 };
 
 } // namespace zeek::detail
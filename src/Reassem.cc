@@ -6,20 +6,57 @@
 #include <algorithm>
 
 #include "Desc.h"
+#include "NetVar.h"
+#include "Stats.h"
+#include "iosource/Manager.h"
+#include "iosource/PktSrc.h"
 
 using std::min;
 
 namespace zeek {
 
 uint64_t Reassembler::total_size = 0;
+uint64_t Reassembler::num_evictions = 0;
 uint64_t Reassembler::sizes[REASSEM_NUM];
+Reassembler* Reassembler::all_reassemblers = nullptr;
+int Reassembler::delivery_depth = 0;
+PacketBuffer* Reassembler::delivery_pin = nullptr;
+
+// Returns a reference to the packet memory holding the given data if
+// it comes from the packet currently being processed and the packet's
+// source allows pinning it.
+static PacketBufferPtr pin_current_packet(const u_char* data, uint64_t size)
+	{
+	auto ps = iosource_mgr ? iosource_mgr->GetPktSrc() : nullptr;
+	const Packet* pkt;
+
+	if ( ps && ps->GetCurrentPacket(&pkt) )
+		return pkt->Pin(data, size);
+
+	return nullptr;
+	}
 
-DataBlock::DataBlock(const u_char* data, uint64_t size, uint64_t arg_seq)
+DataBlock::DataBlock(const u_char* data, uint64_t size, uint64_t arg_seq,
+                     PacketBufferPtr pin)
 	{
 	seq = arg_seq;
 	upper = seq + size;
-	block = new u_char[size];
-	memcpy(block, data, size);
+
+	if ( pin )
+		{
+		pinned = std::move(pin);
+		block = data;
+		}
+	else
+		block = CopyData(data, size);
+	}
+
+PacketBufferPtr Reassembler::PinDelivered(const u_char* data, uint64_t len)
+	{
+	if ( delivery_pin && delivery_pin->Pinnable() && delivery_pin->Contains(data, len) )
+		return {NewRef{}, delivery_pin};
+
+	return pin_current_packet(data, len);
 	}
 
 void DataBlockList::DataSize(uint64_t seq_cutoff, uint64_t* below, uint64_t* above) const
@@ -57,10 +94,10 @@ void DataBlockList::Delete(DataBlockMap::const_iterator it)
 
 DataBlock DataBlockList::Remove(DataBlockMap::const_iterator it)
 	{
-	auto b = std::move(it->second);
+	// Through the const_iterator, moving would make a copy of the data.
+	auto b = std::move(block_map.extract(it).mapped());
 	auto size = b.Size();
 
-	block_map.erase(it);
 	total_data_size -= size;
 
 	return b;
@@ -105,7 +142,8 @@ DataBlockList::Insert(uint64_t seq, uint64_t upper, const u_char* data,
                       DataBlockMap::const_iterator hint)
 	{
 	auto size = upper - seq;
-	auto rval = block_map.emplace_hint(hint, seq, DataBlock(data, size, seq));
+	auto rval = block_map.emplace_hint(hint, seq, DataBlock(data, size, seq,
+	                                                        pin_current_packet(data, size)));
 
 	total_data_size += size;
 	Reassembler::sizes[reassembler->rtype] += size + sizeof(DataBlock);
@@ -271,6 +309,23 @@ Reassembler::Reassembler(uint64_t init_seq, ReassemblerType reassem_type)
 	  last_reassem_seq(init_seq), trim_seq(init_seq),
 	  max_old_blocks(0), rtype(reassem_type)
 	{
+	next_reassembler = all_reassemblers;
+
+	if ( next_reassembler )
+		next_reassembler->prev_reassembler = this;
+
+	all_reassemblers = this;
+	}
+
+Reassembler::~Reassembler()
+	{
+	if ( prev_reassembler )
+		prev_reassembler->next_reassembler = next_reassembler;
+	else
+		all_reassemblers = next_reassembler;
+
+	if ( next_reassembler )
+		next_reassembler->prev_reassembler = prev_reassembler;
 	}
 
 void Reassembler::CheckOverlap(const DataBlockList& list,
@@ -328,6 +383,8 @@ void Reassembler::NewBlock(double t, uint64_t seq, uint64_t len, const u_char* d
 	if ( len == 0 )
 		return;
 
+	detail::StageTimer stage(detail::STAGE_REASSEMBLY);
+
 	uint64_t upper_seq = seq + len;
 
 	CheckOverlap(old_block_list, seq, len, data);
@@ -347,13 +404,87 @@ void Reassembler::NewBlock(double t, uint64_t seq, uint64_t len, const u_char* d
 		len -= amount_old;
 		}
 
-	auto it = block_list.Insert(seq, upper_seq, data);;
-	BlockInserted(it);
+	++delivery_depth;
+	bool delivered = seq == last_reassem_seq && block_list.Empty() &&
+	                 DeliverInOrder(seq, len, data);
+	--delivery_depth;
+
+	if ( delivered )
+		{
+		// The data never entered the block list, but we still keep
+		// it around for overlap checks if asked to.
+		if ( max_old_blocks )
+			{
+			Reassembler::sizes[rtype] += len + sizeof(DataBlock);
+			Reassembler::total_size += len + sizeof(DataBlock);
+			old_block_list.Append(DataBlock(data, len, seq,
+			                                pin_current_packet(data, len)),
+			                      max_old_blocks);
+			}
+
+		SetTrimSeq(last_reassem_seq);
+		}
+	else
+		{
+		auto it = block_list.Insert(seq, upper_seq, data);
+
+		++delivery_depth;
+		BlockInserted(it);
+		--delivery_depth;
+		}
+
+	if ( detail::reassembly_memory_budget && delivery_depth == 0 &&
+	     total_size > detail::reassembly_memory_budget )
+		EnforceBudget(detail::reassembly_memory_budget);
 	}
 
 uint64_t Reassembler::TrimToSeq(uint64_t seq)
 	{
-	return block_list.Trim(seq, max_old_blocks, &old_block_list);
+	++delivery_depth;
+	auto rval = block_list.Trim(seq, max_old_blocks, &old_block_list);
+	--delivery_depth;
+	return rval;
+	}
+
+void Reassembler::Evict()
+	{
+	if ( ! block_list.Empty() )
+		TrimToSeq(block_list.LastBlock().upper);
+
+	ClearOldBlocks();
+	}
+
+void Reassembler::EnforceBudget(uint64_t budget)
+	{
+	uint64_t target = budget - budget / 4;
+
+	while ( total_size > target )
+		{
+		Reassembler* victim = nullptr;
+		uint64_t victim_size = 0;
+
+		for ( auto r = all_reassemblers; r; r = r->next_reassembler )
+			{
+			auto size = r->TotalSize();
+
+			if ( size > victim_size )
+				{
+				victim = r;
+				victim_size = size;
+				}
+			}
+
+		if ( ! victim )
+			break;
+
+		auto before = total_size;
+		++num_evictions;
+		victim->Evict();
+
+		if ( total_size >= before )
+			// Nothing we can free right now.
+			break;
+		}
 	}
 
 void Reassembler::ClearBlocks()
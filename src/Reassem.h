@@ -4,7 +4,10 @@
 
 #include <map>
 
+#include "MemoryTag.h"
 #include "Obj.h"
+#include "SlabAllocator.h"
+#include "iosource/PacketBuffer.h"
 
 #include <assert.h>
 #include <string.h>
@@ -28,29 +31,35 @@ enum ReassemblerType {
 class Reassembler;
 
 /**
- * A block/segment of data for use in the reassembly process.
+ * A block/segment of data for use in the reassembly process. Copies of the
+ * data live in the thread's slab allocator.
  */
 class DataBlock {
 public:
 
 	/**
 	 * Create a data block/segment with associated sequence numbering.
+	 *
+	 * @param pin If given, a reference to the packet memory that *data*
+	 * points into. The block then refers to that memory instead of
+	 * making a copy.
 	 */
-	DataBlock(const u_char* data, uint64_t size, uint64_t seq);
+	DataBlock(const u_char* data, uint64_t size, uint64_t seq,
+	          PacketBufferPtr pin = nullptr);
 
 	DataBlock(const DataBlock& other)
 		{
 		seq = other.seq;
 		upper = other.upper;
-		auto size = other.Size();
-		block = new u_char[size];
-		memcpy(block, other.block, size);
+		pinned = other.pinned;
+		block = pinned ? other.block : CopyData(other.block, other.Size());
 		}
 
 	DataBlock(DataBlock&& other)
 		{
 		seq = other.seq;
 		upper = other.upper;
+		pinned = std::move(other.pinned);
 		block = other.block;
 		other.block = nullptr;
 		}
@@ -60,12 +69,11 @@ public:
 		if ( this == &other )
 			return *this;
 
+		FreeData();
 		seq = other.seq;
 		upper = other.upper;
-		auto size = other.Size();
-		delete [] block;
-		block = new u_char[size];
-		memcpy(block, other.block, size);
+		pinned = other.pinned;
+		block = pinned ? other.block : CopyData(other.block, other.Size());
 		return *this;
 		}
 
@@ -74,16 +82,17 @@ public:
 		if ( this == &other )
 			return *this;
 
+		FreeData();
 		seq = other.seq;
 		upper = other.upper;
-		delete [] block;
+		pinned = std::move(other.pinned);
 		block = other.block;
 		other.block = nullptr;
 		return *this;
 		}
 
 	~DataBlock()
-		{ delete [] block; }
+		{ FreeData(); }
 
 	/**
 	 * @return length of the data block
@@ -91,12 +100,49 @@ public:
 	uint64_t Size() const
 		{ return upper - seq; }
 
+	/**
+	 * @return true if the block refers to pinned packet memory rather
+	 * than owning a copy of its data.
+	 */
+	bool IsPinned() const
+		{ return pinned != nullptr; }
+
+	/**
+	 * @return the packet memory the block refers to, if pinned.
+	 */
+	PacketBuffer* PinnedBuffer() const
+		{ return pinned.get(); }
+
 	uint64_t seq;
 	uint64_t upper;
-	u_char* block;
+	const u_char* block;
+
+private:
+	static const u_char* CopyData(const u_char* data, uint64_t size)
+		{
+		auto copy = static_cast<u_char*>(detail::SlabAllocator::ForThread().Allocate(size));
+		memcpy(copy, data, size);
+		detail::memory_tag_alloc(detail::MemoryTag::Reassembly, size);
+		return copy;
+		}
+
+	// Needs to run while seq and upper still describe the block.
+	void FreeData()
+		{
+		if ( ! pinned && block )
+			{
+			detail::SlabAllocator::ForThread().Free(const_cast<u_char*>(block), Size());
+			detail::memory_tag_free(detail::MemoryTag::Reassembly, Size());
+			}
+
+		pinned = nullptr;
+		}
+
+	PacketBufferPtr pinned;
 };
 
-using DataBlockMap = std::map<uint64_t, DataBlock>;
+using DataBlockMap = std::map<uint64_t, DataBlock, std::less<uint64_t>,
+                              detail::SlabStdAllocator<std::pair<const uint64_t, DataBlock>>>;
 
 
 /**
@@ -252,10 +298,10 @@ private:
 	DataBlockMap block_map;
 };
 
-class Reassembler : public Obj {
+class Reassembler : public Obj, public detail::MemoryTagged<detail::MemoryTag::Reassembly> {
 public:
 	Reassembler(uint64_t init_seq, ReassemblerType reassem_type = REASSEM_UNKNOWN);
-	~Reassembler() override	{}
+	~Reassembler() override;
 
 	void NewBlock(double t, uint64_t seq, uint64_t len, const u_char* data);
 
@@ -288,8 +334,23 @@ public:
 	// Data buffered by type of reassembler.
 	static uint64_t MemoryAllocation(ReassemblerType rtype);
 
+	// Number of times a reassembler had its buffered data evicted to
+	// stay within reassembly_memory_budget.
+	static uint64_t NumEvictions()	{ return num_evictions; }
+
 	void SetMaxOldBlocks(uint32_t count)	{ max_old_blocks = count; }
 
+	/**
+	 * Returns a reference to the packet memory holding data that's
+	 * currently being delivered, either from a pinned block or from the
+	 * packet being processed. Consumers buffering delivered data can
+	 * hold on to that instead of making a copy.
+	 * @param data  points to the delivered data
+	 * @param len  length of the delivered data
+	 * @return the reference, or null if the data needs to be copied
+	 */
+	static PacketBufferPtr PinDelivered(const u_char* data, uint64_t len);
+
 protected:
 
 	friend class DataBlockList;
@@ -297,6 +358,29 @@ protected:
 	virtual void Undelivered(uint64_t up_to_seq);
 
 	virtual void BlockInserted(DataBlockMap::const_iterator it) = 0;
+
+	/**
+	 * Offers new data that starts right where delivery left off, while
+	 * nothing else is buffered. A reassembler that wouldn't hold on to
+	 * the data after delivering it can pass it on directly, skipping the
+	 * block list: it then advances last_reassem_seq past the data and
+	 * returns true. Returning false has the data buffered as usual.
+	 * @param seq  sequence number of the data, equal to last_reassem_seq
+	 * @param len  length of the data
+	 * @param data  points to the data, valid only for the call's duration
+	 * @return whether the data got delivered
+	 */
+	virtual bool DeliverInOrder(uint64_t seq, uint64_t len, const u_char* data)
+		{ return false; }
+
+	/**
+	 * Gives up on buffered data because reassembly as a whole is over
+	 * its memory budget and this reassembler holds the most. The default
+	 * skips all holes, passing on what's buffered with gaps where data
+	 * is missing, and drops the old blocks. Subclasses typically report
+	 * a weird before doing the same.
+	 */
+	virtual void Evict();
 	virtual void Overlap(const u_char* b1, const u_char* b2, uint64_t n) = 0;
 
 	void CheckOverlap(const DataBlockList& list,
@@ -312,7 +396,25 @@ protected:
 	ReassemblerType rtype = REASSEM_UNKNOWN;
 
 	static uint64_t total_size;
+	static uint64_t num_evictions;
 	static uint64_t sizes[REASSEM_NUM];
+
+	// The pinned memory of the block being delivered, if any.
+	static PacketBuffer* delivery_pin;
+
+private:
+	// Evicts the largest reassemblers until the total is back below the
+	// budget, leaving some headroom.
+	static void EnforceBudget(uint64_t budget);
+
+	// All reassemblers, to look for eviction candidates.
+	Reassembler* prev_reassembler = nullptr;
+	Reassembler* next_reassembler = nullptr;
+	static Reassembler* all_reassemblers;
+
+	// How many deliveries are in progress. Evicting while one is could
+	// pull blocks out from under it.
+	static int delivery_depth;
 };
 
 } // namespace zeek
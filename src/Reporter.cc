@@ -7,6 +7,8 @@
 
 #include <unistd.h>
 #include <syslog.h>
+#include <cmath>
+#include <cstring>
 
 #include "Desc.h"
 #include "Event.h"
@@ -54,6 +56,12 @@ Reporter::Reporter(bool arg_abort_on_scripting_errors)
 	weird_sampling_rate = 0;
 	weird_sampling_duration = 0;
 	weird_sampling_threshold = 0;
+	weird_max_names = 10000;
+	weird_max_sampling_state = 0;
+	weird_max_per_second = 0;
+	weird_budget_second = 0;
+	weird_budget_used = 0;
+	weirds_over_budget = 0;
 
 	openlog("bro", 0, LOG_LOCAL5);
 	}
@@ -71,6 +79,9 @@ void Reporter::InitOptions()
 	weird_sampling_rate = id::find_val("Weird::sampling_rate")->AsCount();
 	weird_sampling_threshold = id::find_val("Weird::sampling_threshold")->AsCount();
 	weird_sampling_duration = id::find_val("Weird::sampling_duration")->AsInterval();
+	weird_max_per_second = id::find_val("Weird::max_per_second")->AsCount();
+	weird_max_sampling_state = id::find_val("Weird::max_sampling_state")->AsCount();
+	weird_max_names = id::find_val("Weird::max_names")->AsCount();
 
 	auto init_weird_set = [](WeirdSet* set, const char* name)
 		{
@@ -92,6 +103,7 @@ void Reporter::InitOptions()
 
 	init_weird_set(&weird_sampling_whitelist, "Weird::sampling_whitelist");
 	init_weird_set(&weird_sampling_global_list, "Weird::sampling_global_list");
+	UpdateWeirdListFlags();
 	}
 
 void Reporter::Info(const char* fmt, ...)
@@ -245,27 +257,121 @@ void Reporter::WeirdHelper(EventHandlerPtr event, ValPList vl, const char* fmt_n
 	{
 	va_list ap;
 	va_start(ap, fmt_name);
+	++weird_budget_used;
 	DoLog("weird", event, nullptr, nullptr, &vl, false, false, nullptr, fmt_name, ap);
 	va_end(ap);
 	}
 
-void Reporter::UpdateWeirdStats(const char* name)
+// Weird names beyond Weird::max_names all count under this one.
+static constexpr const char* OVERFLOW_WEIRD_NAME = "<other>";
+
+// Boost's hash_combine().
+static size_t combine_hash(size_t seed, size_t h)
+	{
+	return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+
+size_t Reporter::IPPairHash::operator()(const IPPair& p) const
+	{
+	std::hash<IPAddr> h;
+	return combine_hash(h(p.first), h(p.second));
+	}
+
+size_t Reporter::ConnTupleHash::operator()(const ConnTuple& t) const
+	{
+	std::hash<IPAddr> h;
+	auto seed = combine_hash(h(std::get<0>(t)), h(std::get<1>(t)));
+	seed = combine_hash(seed, std::get<2>(t));
+	seed = combine_hash(seed, std::get<3>(t));
+	return combine_hash(seed, std::get<4>(t));
+	}
+
+detail::WeirdID Reporter::InternWeird(const char* name)
+	{
+	if ( auto it = weird_ids.find(name); it != weird_ids.end() )
+		return it->second;
+
+	if ( weird_names.size() >= weird_max_names &&
+	     strcmp(name, OVERFLOW_WEIRD_NAME) != 0 )
+		return InternWeird(OVERFLOW_WEIRD_NAME);
+
+	detail::WeirdID id = weird_names.size();
+	const auto& n = weird_names.emplace_back(name);
+	weird_ids.emplace(n, id);
+	weird_count_by_type.push_back(0);
+	weird_list_flags.push_back(WeirdListFlagsFor(n));
+	return id;
+	}
+
+uint8_t Reporter::WeirdListFlagsFor(const std::string& name) const
+	{
+	uint8_t flags = 0;
+
+	if ( weird_sampling_whitelist.find(name) != weird_sampling_whitelist.end() )
+		flags |= WEIRD_ON_WHITELIST;
+
+	if ( weird_sampling_global_list.find(name) != weird_sampling_global_list.end() )
+		flags |= WEIRD_ON_GLOBAL_LIST;
+
+	return flags;
+	}
+
+void Reporter::UpdateWeirdListFlags()
+	{
+	for ( size_t i = 0; i < weird_names.size(); ++i )
+		weird_list_flags[i] = WeirdListFlagsFor(weird_names[i]);
+	}
+
+Reporter::WeirdCountMap Reporter::GetWeirdsByType() const
+	{
+	WeirdCountMap rval;
+
+	for ( size_t i = 0; i < weird_names.size(); ++i )
+		if ( weird_count_by_type[i] )
+			rval.emplace(weird_names[i], weird_count_by_type[i]);
+
+	return rval;
+	}
+
+detail::WeirdID Reporter::UpdateWeirdStats(const char* name)
 	{
+	auto id = InternWeird(name);
 	++weird_count;
-	++weird_count_by_type[name];
+	++weird_count_by_type[id];
+	return id;
+	}
+
+bool Reporter::WeirdOverBudget()
+	{
+	if ( ! weird_max_per_second )
+		return false;
+
+	double second = floor(run_state::network_time);
+
+	if ( second != weird_budget_second )
+		{
+		weird_budget_second = second;
+		weird_budget_used = 0;
+		}
+
+	if ( weird_budget_used < weird_max_per_second )
+		return false;
+
+	++weirds_over_budget;
+	return true;
 	}
 
 class NetWeirdTimer final : public detail::Timer {
 public:
-	NetWeirdTimer(double t, const char* name, double timeout)
+	NetWeirdTimer(double t, detail::WeirdID id, double timeout)
 		: detail::Timer(t + timeout, detail::TIMER_NET_WEIRD_EXPIRE),
-		  weird_name(name)
+		  weird_id(id)
 		{}
 
 	void Dispatch(double t, bool is_expire) override
-		{ reporter->ResetNetWeird(weird_name); }
+		{ reporter->ResetNetWeird(weird_id); }
 
-	std::string weird_name;
+	detail::WeirdID weird_id;
 };
 
 class FlowWeirdTimer final : public detail::Timer {
@@ -298,9 +404,9 @@ public:
 	ConnTuple conn_id;
 };
 
-void Reporter::ResetNetWeird(const std::string& name)
+void Reporter::ResetNetWeird(detail::WeirdID id)
 	{
-	net_weird_state.erase(name);
+	net_weird_state.erase(id);
 	}
 
 void Reporter::ResetFlowWeird(const IPAddr& orig, const IPAddr& resp)
@@ -313,27 +419,20 @@ void Reporter::ResetExpiredConnWeird(const ConnTuple& id)
 	expired_conn_weird_state.erase(id);
 	}
 
-Reporter::PermitWeird Reporter::CheckGlobalWeirdLists(const char* name)
+Reporter::PermitWeird Reporter::CheckGlobalWeirdLists(detail::WeirdID id)
 	{
-	if ( WeirdOnSamplingWhiteList(name) )
+	if ( WeirdOnSamplingWhiteList(id) )
 		return PermitWeird::Allow;
 
-	if ( WeirdOnGlobalList(name) )
+	if ( WeirdOnGlobalList(id) )
 		// We track weirds on the global list through the "net_weird" table.
-		return PermitNetWeird(name) ? PermitWeird::Allow : PermitWeird::Deny;
+		return PermitNetWeird(id) ? PermitWeird::Allow : PermitWeird::Deny;
 
 	return PermitWeird::Unknown;
 	}
 
-bool Reporter::PermitNetWeird(const char* name)
+bool Reporter::PermitSampled(uint64_t count) const
 	{
-	auto& count = net_weird_state[name];
-	++count;
-
-	if ( count == 1 )
-		detail::timer_mgr->Add(new NetWeirdTimer(run_state::network_time, name,
-		                                         weird_sampling_duration));
-
 	if ( count <= weird_sampling_threshold )
 		return true;
 
@@ -344,65 +443,81 @@ bool Reporter::PermitNetWeird(const char* name)
 		return false;
 	}
 
-bool Reporter::PermitFlowWeird(const char* name,
+bool Reporter::PermitNetWeird(detail::WeirdID id)
+	{
+	auto& count = net_weird_state[id];
+	++count;
+
+	if ( count == 1 )
+		detail::timer_mgr->Add(new NetWeirdTimer(run_state::network_time, id,
+		                                         weird_sampling_duration));
+
+	return PermitSampled(count);
+	}
+
+bool Reporter::PermitFlowWeird(detail::WeirdID id,
                                const IPAddr& orig, const IPAddr& resp)
 	{
 	auto endpoints = std::make_pair(orig, resp);
-	auto& map = flow_weird_state[endpoints];
+	auto it = flow_weird_state.find(endpoints);
+
+	if ( it == flow_weird_state.end() )
+		{
+		// Once the table is full, further flows share the per-name
+		// state of "net" weirds until entries expire.
+		if ( weird_max_sampling_state &&
+		     flow_weird_state.size() >= weird_max_sampling_state )
+			return PermitNetWeird(id);
 
-	if ( map.empty() )
+		it = flow_weird_state.emplace(endpoints, WeirdIDCountMap()).first;
 		detail::timer_mgr->Add(new FlowWeirdTimer(run_state::network_time, endpoints,
 		                                          weird_sampling_duration));
+		}
 
-	auto& count = map[name];
-	++count;
-
-	if ( count <= weird_sampling_threshold )
-		return true;
-
-	auto num_above_threshold = count - weird_sampling_threshold;
-	if ( weird_sampling_rate )
-		return num_above_threshold % weird_sampling_rate == 0;
-	else
-		return false;
+	return PermitSampled(++it->second[id]);
 	}
 
-bool Reporter::PermitExpiredConnWeird(const char* name, const RecordVal& conn_id)
+bool Reporter::PermitExpiredConnWeird(detail::WeirdID id, const RecordVal& conn_id)
 	{
-	auto conn_tuple = std::make_tuple(conn_id.GetField("orig_h")->AsAddr(),
-	                                  conn_id.GetField("resp_h")->AsAddr(),
-	                                  conn_id.GetField("orig_p")->AsPortVal()->Port(),
-	                                  conn_id.GetField("resp_p")->AsPortVal()->Port(),
-	                                  conn_id.GetField("resp_p")->AsPortVal()->PortType());
+	static RecordFieldHandle orig_h{"conn_id", "orig_h"};
+	static RecordFieldHandle resp_h{"conn_id", "resp_h"};
+	static RecordFieldHandle orig_p{"conn_id", "orig_p"};
+	static RecordFieldHandle resp_p{"conn_id", "resp_p"};
+
+	auto conn_tuple = std::make_tuple(conn_id.GetField(orig_h)->AsAddr(),
+	                                  conn_id.GetField(resp_h)->AsAddr(),
+	                                  conn_id.GetField(orig_p)->AsPortVal()->Port(),
+	                                  conn_id.GetField(resp_p)->AsPortVal()->Port(),
+	                                  conn_id.GetField(resp_p)->AsPortVal()->PortType());
 
-	auto& map = expired_conn_weird_state[conn_tuple];
+	auto it = expired_conn_weird_state.find(conn_tuple);
+
+	if ( it == expired_conn_weird_state.end() )
+		{
+		// Same as for flows.
+		if ( weird_max_sampling_state &&
+		     expired_conn_weird_state.size() >= weird_max_sampling_state )
+			return PermitNetWeird(id);
 
-	if ( map.empty() )
+		it = expired_conn_weird_state.emplace(conn_tuple, WeirdIDCountMap()).first;
 		detail::timer_mgr->Add(new ConnTupleWeirdTimer(run_state::network_time,
 		                                               std::move(conn_tuple),
 		                                               weird_sampling_duration));
+		}
 
-	auto& count = map[name];
-	++count;
-
-	if ( count <= weird_sampling_threshold )
-		return true;
-
-	auto num_above_threshold = count - weird_sampling_threshold;
-
-	if ( weird_sampling_rate )
-		return num_above_threshold % weird_sampling_rate == 0;
-	else
-		return false;
+	return PermitSampled(++it->second[id]);
 	}
 
 void Reporter::Weird(const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
+
+	if ( WeirdOverBudget() )
+		return;
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! PermitNetWeird(name) )
+		if ( ! PermitNetWeird(id) )
 			return;
 		}
 
@@ -411,15 +526,18 @@ void Reporter::Weird(const char* name, const char* addl)
 
 void Reporter::Weird(file_analysis::File* f, const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
 
-	switch ( CheckGlobalWeirdLists(name) ) {
+	if ( WeirdOverBudget() )
+		return;
+
+	switch ( CheckGlobalWeirdLists(id) ) {
 	case PermitWeird::Allow:
 		break;
 	case PermitWeird::Deny:
 		return;
 	case PermitWeird::Unknown:
-		if ( ! f->PermitWeird(name, weird_sampling_threshold,
+		if ( ! f->PermitWeird(id, weird_sampling_threshold,
 		                      weird_sampling_rate, weird_sampling_duration) )
 			return;
 	}
@@ -430,15 +548,18 @@ void Reporter::Weird(file_analysis::File* f, const char* name, const char* addl)
 
 void Reporter::Weird(Connection* conn, const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
 
-	switch ( CheckGlobalWeirdLists(name) ) {
+	if ( WeirdOverBudget() )
+		return;
+
+	switch ( CheckGlobalWeirdLists(id) ) {
 	case PermitWeird::Allow:
 		break;
 	case PermitWeird::Deny:
 		return;
 	case PermitWeird::Unknown:
-		if ( ! conn->PermitWeird(name, weird_sampling_threshold,
+		if ( ! conn->PermitWeird(id, weird_sampling_threshold,
 		                         weird_sampling_rate, weird_sampling_duration) )
 			return;
 	}
@@ -450,15 +571,18 @@ void Reporter::Weird(Connection* conn, const char* name, const char* addl)
 void Reporter::Weird(RecordValPtr conn_id, StringValPtr uid,
                      const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
+
+	if ( WeirdOverBudget() )
+		return;
 
-	switch ( CheckGlobalWeirdLists(name) ) {
+	switch ( CheckGlobalWeirdLists(id) ) {
 	case PermitWeird::Allow:
 		break;
 	case PermitWeird::Deny:
 		return;
 	case PermitWeird::Unknown:
-		if ( ! PermitExpiredConnWeird(name, *conn_id) )
+		if ( ! PermitExpiredConnWeird(id, *conn_id) )
 			return;
 	}
 
@@ -469,15 +593,18 @@ void Reporter::Weird(RecordValPtr conn_id, StringValPtr uid,
 
 void Reporter::Weird(const IPAddr& orig, const IPAddr& resp, const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
+
+	if ( WeirdOverBudget() )
+		return;
 
-	switch ( CheckGlobalWeirdLists(name) ) {
+	switch ( CheckGlobalWeirdLists(id) ) {
 	case PermitWeird::Allow:
 		break;
 	case PermitWeird::Deny:
 		return;
 	case PermitWeird::Unknown:
-		if ( ! PermitFlowWeird(name, orig, resp) )
+		if ( ! PermitFlowWeird(id, orig, resp) )
 			 return;
 	}
 
@@ -4,16 +4,21 @@
 
 #include <stdarg.h>
 
+#include <deque>
 #include <list>
 #include <utility>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <map>
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 
 #include "ZeekList.h"
+#include "IPAddr.h"
 #include "net_util.h"
+#include "WeirdState.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Analyzer, zeek, analyzer);
 ZEEK_FORWARD_DECLARE_NAMESPACED(File, zeek, file_analysis);
@@ -22,7 +27,6 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(EventHandlerPtr, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(RecordVal, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(StringVal, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Location, zeek::detail);
-ZEEK_FORWARD_DECLARE_NAMESPACED(IPAddr, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Expr, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Reporter, zeek);
 
@@ -53,8 +57,18 @@ public:
 	using IPPair = std::pair<IPAddr, IPAddr>;
 	using ConnTuple = std::tuple<IPAddr, IPAddr, uint32_t, uint32_t, TransportProto>;
 	using WeirdCountMap = std::unordered_map<std::string, uint64_t>;
-	using WeirdFlowMap = std::map<IPPair, WeirdCountMap>;
-	using WeirdConnTupleMap = std::map<ConnTuple, WeirdCountMap>;
+	using WeirdIDCountMap = std::unordered_map<detail::WeirdID, uint64_t>;
+
+	struct IPPairHash {
+		size_t operator()(const IPPair& p) const;
+	};
+
+	struct ConnTupleHash {
+		size_t operator()(const ConnTuple& t) const;
+	};
+
+	using WeirdFlowMap = std::unordered_map<IPPair, WeirdIDCountMap, IPPairHash>;
+	using WeirdConnTupleMap = std::unordered_map<ConnTuple, WeirdIDCountMap, ConnTupleHash>;
 	using WeirdSet = std::unordered_set<std::string>;
 
 	Reporter(bool abort_on_scripting_errors);
@@ -143,10 +157,24 @@ public:
 	// Signals that we're done processing an error handler event.
 	void EndErrorHandler()	{ --in_error_handler; }
 
+	/**
+	 * Returns the numeric ID of a weird name, which all of the per-name
+	 * counters and sampling state are keyed by. The first use of a new
+	 * name assigns it the next ID. Once Weird::max_names names have come
+	 * up, further new names all share a single ID.
+	 */
+	detail::WeirdID InternWeird(const char* name);
+
+	/**
+	 * Returns the name of an interned weird.
+	 */
+	const std::string& WeirdName(detail::WeirdID id) const
+		{ return weird_names[id]; }
+
 	/**
 	 * Reset/cleanup state tracking for a "net" weird.
 	 */
-	void ResetNetWeird(const std::string& name);
+	void ResetNetWeird(detail::WeirdID id);
 
 	/**
 	 * Reset/cleanup state tracking for a "flow" weird.
@@ -169,8 +197,14 @@ public:
 	 * Return number of weirds generated per weird type/name (counts weirds
 	 * before any rate-limiting occurs).
 	 */
-	const WeirdCountMap& GetWeirdsByType() const
-		{ return weird_count_by_type; }
+	WeirdCountMap GetWeirdsByType() const;
+
+	/**
+	 * Return the number of weirds dropped because they exceeded
+	 * Weird::max_per_second.
+	 */
+	uint64_t GetWeirdsOverBudget() const
+		{ return weirds_over_budget; }
 
 	/**
 	 * Gets the weird sampling whitelist.
@@ -188,6 +222,7 @@ public:
 	void SetWeirdSamplingWhitelist(WeirdSet weird_sampling_whitelist)
 		{
 		this->weird_sampling_whitelist = std::move(weird_sampling_whitelist);
+		UpdateWeirdListFlags();
 		}
 
 	/**
@@ -206,6 +241,7 @@ public:
 	void SetWeirdSamplingGlobalList(WeirdSet weird_sampling_global_list)
 		{
 		this->weird_sampling_global_list = std::move(weird_sampling_global_list);
+		UpdateWeirdListFlags();
 		}
 
 	/**
@@ -269,6 +305,27 @@ public:
 		this->weird_sampling_duration = weird_sampling_duration;
 		}
 
+	/**
+	 * Gets the current maximum number of weirds per second.
+	 *
+	 * @return maximum number of weirds per second, 0 for no limit.
+	 */
+	uint64_t GetWeirdMaxPerSecond() const
+		{
+		return weird_max_per_second;
+		}
+
+	/**
+	 * Sets the maximum number of weirds raising events per second of
+	 * network time.
+	 *
+	 * @param weird_max_per_second New maximum, 0 for no limit.
+	 */
+	void SetWeirdMaxPerSecond(uint64_t weird_max_per_second)
+		{
+		this->weird_max_per_second = weird_max_per_second;
+		}
+
 private:
 	void DoLog(const char* prefix, EventHandlerPtr event, FILE* out,
 		   Connection* conn, ValPList* addl, bool location, bool time,
@@ -277,17 +334,29 @@ private:
 	// WeirdHelper doesn't really have to be variadic, but it calls DoLog
 	// and that takes va_list anyway.
 	void WeirdHelper(EventHandlerPtr event, ValPList vl, const char* fmt_name, ...) __attribute__((format(printf, 4, 5)));;
-	void UpdateWeirdStats(const char* name);
-	inline bool WeirdOnSamplingWhiteList(const char* name)
-		{ return weird_sampling_whitelist.find(name) != weird_sampling_whitelist.end(); }
-	inline bool WeirdOnGlobalList(const char* name)
-		{ return weird_sampling_global_list.find(name) != weird_sampling_global_list.end(); }
-	bool PermitNetWeird(const char* name);
-	bool PermitFlowWeird(const char* name, const IPAddr& o, const IPAddr& r);
-	bool PermitExpiredConnWeird(const char* name, const RecordVal& conn_id);
+	detail::WeirdID UpdateWeirdStats(const char* name);
+	bool WeirdOverBudget();
+
+	// Flags cached per weird ID, so that the sampling lists don't
+	// need string lookups.
+	enum WeirdListFlags : uint8_t {
+		WEIRD_ON_WHITELIST = 1,
+		WEIRD_ON_GLOBAL_LIST = 2,
+	};
+
+	uint8_t WeirdListFlagsFor(const std::string& name) const;
+	void UpdateWeirdListFlags();
+	inline bool WeirdOnSamplingWhiteList(detail::WeirdID id)
+		{ return weird_list_flags[id] & WEIRD_ON_WHITELIST; }
+	inline bool WeirdOnGlobalList(detail::WeirdID id)
+		{ return weird_list_flags[id] & WEIRD_ON_GLOBAL_LIST; }
+	bool PermitNetWeird(detail::WeirdID id);
+	bool PermitFlowWeird(detail::WeirdID id, const IPAddr& o, const IPAddr& r);
+	bool PermitExpiredConnWeird(detail::WeirdID id, const RecordVal& conn_id);
+	bool PermitSampled(uint64_t count) const;
 
 	enum class PermitWeird { Allow, Deny, Unknown };
-	PermitWeird CheckGlobalWeirdLists(const char* name);
+	PermitWeird CheckGlobalWeirdLists(detail::WeirdID id);
 
 	bool EmitToStderr(bool flag);
 
@@ -301,11 +370,19 @@ private:
 
 	std::list<std::pair<const detail::Location*, const detail::Location*> > locations;
 
+	// Interned weird names. The deque keeps the strings in place, so
+	// the map can key on views of them.
+	std::unordered_map<std::string_view, detail::WeirdID> weird_ids;
+	std::deque<std::string> weird_names;
+	std::vector<uint8_t> weird_list_flags;
+	uint64_t weird_max_names;
+
 	uint64_t weird_count;
-	WeirdCountMap weird_count_by_type;
-	WeirdCountMap net_weird_state;
+	std::vector<uint64_t> weird_count_by_type;
+	WeirdIDCountMap net_weird_state;
 	WeirdFlowMap flow_weird_state;
 	WeirdConnTupleMap expired_conn_weird_state;
+	uint64_t weird_max_sampling_state;
 
 	WeirdSet weird_sampling_whitelist;
 	WeirdSet weird_sampling_global_list;
@@ -313,6 +390,11 @@ private:
 	uint64_t weird_sampling_rate;
 	double weird_sampling_duration;
 
+	uint64_t weird_max_per_second;
+	double weird_budget_second;
+	uint64_t weird_budget_used;
+	uint64_t weirds_over_budget;
+
 };
 
 extern Reporter* reporter;
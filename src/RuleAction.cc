@@ -8,12 +8,51 @@ using std::string;
 #include "Conn.h"
 #include "Event.h"
 #include "NetVar.h"
+#include "SerializationFormat.h"
 #include "analyzer/protocol/pia/PIA.h"
 
 #include "analyzer/Manager.h"
 
 namespace zeek::detail {
 
+// Identifies the kinds of actions in the signature cache.
+enum CachedActionType {
+	ACTION_EVENT, ACTION_MIME, ACTION_ENABLE, ACTION_DISABLE,
+};
+
+RuleAction* RuleAction::Unserialize(SerializationFormat* fmt)
+	{
+	int type;
+	std::string str;
+
+	if ( ! fmt->Read(&type, "type") || ! fmt->Read(&str, "arg") )
+		return nullptr;
+
+	switch ( type ) {
+	case ACTION_EVENT:
+		return new RuleActionEvent(str.c_str());
+
+	case ACTION_MIME:
+		{
+		int strength;
+
+		if ( ! fmt->Read(&strength, "strength") )
+			return nullptr;
+
+		return new RuleActionMIME(str.c_str(), strength);
+		}
+
+	case ACTION_ENABLE:
+		return new RuleActionEnable(str.c_str());
+
+	case ACTION_DISABLE:
+		return new RuleActionDisable(str.c_str());
+
+	default:
+		return nullptr;
+	}
+	}
+
 RuleActionEvent::RuleActionEvent(const char* arg_msg)
 	{
 	msg = util::copy_string(arg_msg);
@@ -36,6 +75,11 @@ void RuleActionEvent::PrintDebug()
 	fprintf(stderr, "	RuleActionEvent: |%s|\n", msg);
 	}
 
+bool RuleActionEvent::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(ACTION_EVENT, "type") && fmt->Write(msg, "arg");
+	}
+
 RuleActionMIME::RuleActionMIME(const char* arg_mime, int arg_strength)
 	{
 	mime = util::copy_string(arg_mime);
@@ -47,7 +91,14 @@ void RuleActionMIME::PrintDebug()
 	fprintf(stderr, "	RuleActionMIME: |%s|\n", mime);
 	}
 
+bool RuleActionMIME::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(ACTION_MIME, "type") && fmt->Write(mime, "arg") &&
+	       fmt->Write(strength, "strength");
+	}
+
 RuleActionAnalyzer::RuleActionAnalyzer(const char* arg_analyzer)
+	: spec(arg_analyzer)
 	{
 	string str(arg_analyzer);
 	string::size_type pos = str.find(':');
@@ -109,6 +160,11 @@ void RuleActionEnable::PrintDebug()
 	RuleActionAnalyzer::PrintDebug();
 	}
 
+bool RuleActionEnable::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(ACTION_ENABLE, "type") && fmt->Write(spec, "arg");
+	}
+
 void RuleActionDisable::DoAction(const Rule* parent, RuleEndpointState* state,
                                  const u_char* data, int len)
 	{
@@ -128,4 +184,9 @@ void RuleActionDisable::PrintDebug()
 	RuleActionAnalyzer::PrintDebug();
 	}
 
+bool RuleActionDisable::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(ACTION_DISABLE, "type") && fmt->Write(spec, "arg");
+	}
+
 } // namespace zeek::detail
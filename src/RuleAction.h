@@ -8,6 +8,7 @@
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Rule, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(RuleEndpointState, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(SerializationFormat, zeek::detail);
 
 namespace zeek::detail {
 
@@ -20,6 +21,14 @@ public:
 	virtual void DoAction(const Rule* parent, RuleEndpointState* state,
 				const u_char* data, int len) = 0;
 	virtual void PrintDebug() = 0;
+
+	// Writes the action into the signature cache. Returns false if
+	// it can't go there.
+	virtual bool Serialize(SerializationFormat* fmt) const	{ return false; }
+
+	// Reads back an action that Serialize() has written. Returns null
+	// if the data is not valid.
+	static RuleAction* Unserialize(SerializationFormat* fmt);
 };
 
 // Implements the "event" keyword.
@@ -32,6 +41,7 @@ public:
 				const u_char* data, int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 
 private:
 	const char* msg;
@@ -49,6 +59,7 @@ public:
 		{ }
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 
 	std::string GetMIME() const
 		{ return mime; }
@@ -74,6 +85,10 @@ public:
 	analyzer::Tag Analyzer() const { return analyzer; }
 	analyzer::Tag ChildAnalyzer() const { return child_analyzer; }
 
+protected:
+	// The analyzer as given in the signature, for the cache.
+	std::string spec;
+
 private:
 	analyzer::Tag analyzer;
 	analyzer::Tag child_analyzer;
@@ -87,6 +102,7 @@ public:
 				const u_char* data, int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 };
 
 class RuleActionDisable : public RuleActionAnalyzer {
@@ -97,6 +113,7 @@ public:
 				const u_char* data, int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 };
 
 } // namespace zeek::detail
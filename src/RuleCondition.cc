@@ -8,6 +8,7 @@
 #include "Func.h"
 #include "ID.h"
 #include "Val.h"
+#include "SerializationFormat.h"
 
 static inline bool is_established(const zeek::analyzer::tcp::TCP_Endpoint* e)
 	{
@@ -22,6 +23,51 @@ static inline bool is_established(const zeek::analyzer::tcp::TCP_Endpoint* e)
 
 namespace zeek::detail {
 
+// Identifies the kinds of conditions in the signature cache.
+enum CachedConditionType {
+	COND_TCP_STATE, COND_UDP_STATE, COND_IP_OPTIONS, COND_SAME_IP,
+	COND_PAYLOAD_SIZE, COND_EVAL,
+};
+
+RuleCondition* RuleCondition::Unserialize(SerializationFormat* fmt)
+	{
+	int type;
+
+	if ( ! fmt->Read(&type, "type") )
+		return nullptr;
+
+	int i;
+	uint32_t u;
+	std::string str;
+
+	switch ( type ) {
+	case COND_TCP_STATE:
+		return fmt->Read(&i, "states") ? new RuleConditionTCPState(i) : nullptr;
+
+	case COND_UDP_STATE:
+		return fmt->Read(&i, "states") ? new RuleConditionUDPState(i) : nullptr;
+
+	case COND_IP_OPTIONS:
+		return fmt->Read(&i, "options") ? new RuleConditionIPOptions(i) : nullptr;
+
+	case COND_SAME_IP:
+		return new RuleConditionSameIP();
+
+	case COND_PAYLOAD_SIZE:
+		if ( ! fmt->Read(&u, "val") || ! fmt->Read(&i, "comp") ||
+		     i < RuleConditionPayloadSize::RULE_LE || i > RuleConditionPayloadSize::RULE_NE )
+			return nullptr;
+
+		return new RuleConditionPayloadSize(u, static_cast<RuleConditionPayloadSize::Comp>(i));
+
+	case COND_EVAL:
+		return fmt->Read(&str, "func") ? new RuleConditionEval(str.c_str()) : nullptr;
+
+	default:
+		return nullptr;
+	}
+	}
+
 bool RuleConditionTCPState::DoMatch(Rule* rule, RuleEndpointState* state,
 					const u_char* data, int len)
 	{
@@ -54,6 +100,11 @@ void RuleConditionTCPState::PrintDebug()
 	fprintf(stderr, "	RuleConditionTCPState: 0x%x\n", tcpstates);
 	}
 
+bool RuleConditionTCPState::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(COND_TCP_STATE, "type") && fmt->Write(tcpstates, "states");
+	}
+
 bool RuleConditionUDPState::DoMatch(Rule* rule, RuleEndpointState* state,
                                     const u_char* data, int len)
 	{
@@ -79,11 +130,21 @@ void RuleConditionUDPState::PrintDebug()
 	fprintf(stderr, "	RuleConditionUDPState: 0x%x\n", states);
 	}
 
+bool RuleConditionUDPState::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(COND_UDP_STATE, "type") && fmt->Write(states, "states");
+	}
+
 void RuleConditionIPOptions::PrintDebug()
 	{
 	fprintf(stderr, "	RuleConditionIPOptions: 0x%x\n", options);
 	}
 
+bool RuleConditionIPOptions::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(COND_IP_OPTIONS, "type") && fmt->Write(options, "options");
+	}
+
 bool RuleConditionIPOptions::DoMatch(Rule* rule, RuleEndpointState* state,
 					const u_char* data, int len)
 	{
@@ -96,6 +157,11 @@ void RuleConditionSameIP::PrintDebug()
 	fprintf(stderr, "	RuleConditionSameIP\n");
 	}
 
+bool RuleConditionSameIP::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(COND_SAME_IP, "type");
+	}
+
 bool RuleConditionSameIP::DoMatch(Rule* rule, RuleEndpointState* state,
 					const u_char* data, int len)
 	{
@@ -108,6 +174,12 @@ void RuleConditionPayloadSize::PrintDebug()
 	fprintf(stderr, "	RuleConditionPayloadSize %d\n", val);
 	}
 
+bool RuleConditionPayloadSize::Serialize(SerializationFormat* fmt) const
+	{
+	return fmt->Write(COND_PAYLOAD_SIZE, "type") && fmt->Write(val, "val") &&
+	       fmt->Write(static_cast<int>(comp), "comp");
+	}
+
 bool RuleConditionPayloadSize::DoMatch(Rule* rule, RuleEndpointState* state,
 					const u_char* data, int len)
 	{
@@ -224,4 +296,9 @@ void RuleConditionEval::PrintDebug()
 	fprintf(stderr, "	RuleConditionEval: %s\n", id->Name());
 	}
 
+bool RuleConditionEval::Serialize(SerializationFormat* fmt) const
+	{
+	return id && fmt->Write(COND_EVAL, "type") && fmt->Write(id->Name(), "func");
+	}
+
 } // namespace zeek::detail
@@ -7,6 +7,7 @@
 ZEEK_FORWARD_DECLARE_NAMESPACED(RuleEndpointState, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Rule, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(ID, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(SerializationFormat, zeek::detail);
 
 namespace zeek::detail {
 
@@ -20,6 +21,14 @@ public:
 				const u_char* data, int len) = 0;
 
 	virtual void PrintDebug() = 0;
+
+	// Writes the condition into the signature cache. Returns false if
+	// it can't go there.
+	virtual bool Serialize(SerializationFormat* fmt) const	{ return false; }
+
+	// Reads back a condition that Serialize() has written. Returns null
+	// if the data is not valid.
+	static RuleCondition* Unserialize(SerializationFormat* fmt);
 };
 
 enum RuleStateKind {
@@ -39,6 +48,7 @@ public:
 				const u_char* data, int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 
 private:
 	int tcpstates;
@@ -54,6 +64,7 @@ public:
 	             int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 
 private:
 	int states;
@@ -75,6 +86,7 @@ public:
 				const u_char* data, int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 
 private:
 	int options;
@@ -89,6 +101,7 @@ public:
 				const u_char* data, int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 };
 
 // Implements "payload-size".
@@ -103,6 +116,7 @@ public:
 				const u_char* data, int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 
 private:
 	uint32_t val;
@@ -118,6 +132,7 @@ public:
 				const u_char* data, int len) override;
 
 	void PrintDebug() override;
+	bool Serialize(SerializationFormat* fmt) const override;
 private:
 	ID* id;
 };
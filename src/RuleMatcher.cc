@@ -2,7 +2,12 @@
 #include "zeek-config.h"
 #include "RuleMatcher.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <algorithm>
+#include <cerrno>
 #include <functional>
 
 #include "RuleAction.h"
@@ -23,6 +28,11 @@
 #include "Var.h"
 #include "IPAddr.h"
 #include "RunState.h"
+#include "SerializationFormat.h"
+#include "Desc.h"
+#include "digest.h"
+
+extern const char* zeek_version();
 
 using namespace std;
 
@@ -42,6 +52,9 @@ namespace zeek::detail {
 
 uint32_t RuleHdrTest::idcounter = 0;
 
+// Bump when changing the format of the signature cache.
+static constexpr uint32_t SIG_CACHE_VERSION = 1;
+
 static bool is_member_of(const int_list& l, int_list::value_type v)
 	{
 	return std::find(l.begin(), l.end(), v) != l.end();
@@ -260,20 +273,38 @@ bool RuleMatcher::ReadFiles(const std::vector<std::string>& files)
 
 	parse_error = false;
 
+	std::vector<std::string> paths;
+
 	for ( const auto& f : files )
+		paths.emplace_back(util::find_file(f, util::zeek_path(), ".sig"));
+
+	auto cache_file = CacheFile(paths);
+
+	if ( cache_file.empty() || ! ReadCache(cache_file) )
 		{
-		rules_in = util::open_file(util::find_file(f, util::zeek_path(), ".sig"));
+		referenced_ids.clear();
 
-		if ( ! rules_in )
+		for ( size_t i = 0; i < files.size(); ++i )
 			{
-			reporter->Error("Can't open signature file %s", f.data());
-			return false;
+			rules_in = util::open_file(paths[i]);
+
+			if ( ! rules_in )
+				{
+				reporter->Error("Can't open signature file %s", files[i].data());
+				return false;
+				}
+
+			rules_line_number = 0;
+			current_rule_file = files[i].data();
+			rules_parse();
+			fclose(rules_in);
 			}
 
-		rules_line_number = 0;
-		current_rule_file = f.data();
-		rules_parse();
-		fclose(rules_in);
+		if ( parse_error )
+			return false;
+
+		if ( ! cache_file.empty() )
+			WriteCache(cache_file);
 		}
 
 	if ( parse_error )
@@ -283,11 +314,425 @@ bool RuleMatcher::ReadFiles(const std::vector<std::string>& files)
 
 	string_list exprs[Rule::TYPES];
 	int_list ids[Rule::TYPES];
-	BuildRegEx(root, exprs, ids);
+	std::vector<const RuleHdrTest*> owners[Rule::TYPES];
+	magic_prefixes.clear();
+	magic_prefixes.emplace_back();
+	BuildRegEx(root, exprs, ids, owners);
 
 	return ! parse_error;
 	}
 
+// Describes a value such that equal values come out the same across
+// processes, regardless of the order in which tables iterate.
+static std::string describe_referenced_value(const Val* v)
+	{
+	if ( ! v )
+		return "<none>";
+
+	if ( v->GetType()->Tag() != TYPE_TABLE )
+		{
+		ODesc d;
+		v->Describe(&d);
+		return d.Description();
+		}
+
+	std::vector<std::string> elems;
+
+	for ( const auto& e : v->AsTableVal()->ToPureListVal()->Vals() )
+		{
+		ODesc d;
+		e->Describe(&d);
+		elems.emplace_back(d.Description());
+		}
+
+	std::sort(elems.begin(), elems.end());
+
+	std::string result = "{";
+
+	for ( const auto& e : elems )
+		result += e + ",";
+
+	return result + "}";
+	}
+
+void RuleMatcher::NoteReferencedID(const char* id, const Val* v)
+	{
+	referenced_ids[id] = describe_referenced_value(v);
+	}
+
+std::string RuleMatcher::CacheFile(const std::vector<std::string>& paths) const
+	{
+	const auto& dir_val = id::find_val("signature_cache_dir");
+
+	if ( ! dir_val || dir_val->AsString()->Len() == 0 )
+		return "";
+
+	auto ctx = hash_init(Hash_SHA256);
+	hash_update(ctx, &SIG_CACHE_VERSION, sizeof(SIG_CACHE_VERSION));
+
+	for ( const auto& path : paths )
+		{
+		auto f = util::open_file(path);
+
+		if ( ! f )
+			{
+			// ReadFiles() will report it.
+			u_char digest[SHA256_DIGEST_LENGTH];
+			hash_final(ctx, digest);
+			return "";
+			}
+
+		hash_update(ctx, path.c_str(), path.size() + 1);
+
+		char buf[65536];
+		size_t n;
+
+		while ( (n = fread(buf, 1, sizeof(buf), f)) > 0 )
+			hash_update(ctx, buf, n);
+
+		fclose(f);
+
+		// Separates the files' contents.
+		uint64_t end = 0;
+		hash_update(ctx, &end, sizeof(end));
+		}
+
+	u_char digest[SHA256_DIGEST_LENGTH];
+	hash_final(ctx, digest);
+
+	auto dir = dir_val->AsString()->CheckString();
+	return util::fmt("%s/%s.sigcache", dir, sha256_digest_print(digest));
+	}
+
+bool RuleMatcher::ReadCache(const std::string& file)
+	{
+	int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if ( fd < 0 )
+		return false;
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || st.st_size == 0 || st.st_size > UINT32_MAX )
+		{
+		close(fd);
+		return false;
+		}
+
+	// Mapping the file lets all processes reading it share its pages.
+	void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if ( data == MAP_FAILED )
+		return false;
+
+	BinarySerializationFormat fmt;
+	fmt.StartRead(static_cast<const char*>(data), st.st_size);
+	bool ok = ReadCachedRules(&fmt);
+	fmt.EndRead();
+
+	munmap(data, st.st_size);
+
+	if ( ok )
+		DBG_LOG(DBG_RULES, "Loaded %d signatures from cache %s", rules.length(), file.c_str());
+
+	return ok;
+	}
+
+bool RuleMatcher::ReadCachedRules(SerializationFormat* fmt)
+	{
+	std::string magic;
+	uint32_t version;
+	std::string zeek_version_str;
+
+	if ( ! fmt->Read(&magic, "magic") || magic != "ZSIG" ||
+	     ! fmt->Read(&version, "version") || version != SIG_CACHE_VERSION ||
+	     ! fmt->Read(&zeek_version_str, "zeek_version") ||
+	     zeek_version_str != zeek_version() )
+		return false;
+
+	uint32_t num_ids;
+
+	if ( ! fmt->Read(&num_ids, "num_ids") )
+		return false;
+
+	std::map<std::string, std::string> ids;
+
+	for ( uint32_t i = 0; i < num_ids; ++i )
+		{
+		std::string name;
+		std::string value;
+
+		if ( ! fmt->Read(&name, "name") || ! fmt->Read(&value, "value") )
+			return false;
+
+		// Scripts may have changed what the signatures refer to.
+		const auto& id = lookup_ID(name.c_str(), GLOBAL_MODULE_NAME, false);
+
+		if ( ! id || describe_referenced_value(id->GetVal().get()) != value )
+			return false;
+
+		ids[std::move(name)] = std::move(value);
+		}
+
+	uint32_t num_rules;
+
+	if ( ! fmt->Read(&num_rules, "num_rules") )
+		return false;
+
+	std::vector<Rule*> loaded;
+	loaded.reserve(num_rules);
+
+	for ( uint32_t i = 0; i < num_rules; ++i )
+		{
+		auto r = ReadCachedRule(fmt);
+
+		if ( ! r )
+			{
+			for ( auto lr : loaded )
+				delete lr;
+
+			return false;
+			}
+
+		loaded.push_back(r);
+		}
+
+	for ( auto r : loaded )
+		AddRule(r);
+
+	referenced_ids = std::move(ids);
+	return true;
+	}
+
+Rule* RuleMatcher::ReadCachedRule(SerializationFormat* fmt)
+	{
+	std::string id;
+	std::string file;
+	int line;
+	bool active;
+
+	if ( ! fmt->Read(&id, "id") || ! fmt->Read(&file, "file") ||
+	     ! fmt->Read(&line, "line") || ! fmt->Read(&active, "active") )
+		return nullptr;
+
+	auto file_name = cached_file_names.insert(std::move(file)).first->c_str();
+	auto r = new Rule(id.c_str(), Location(file_name, line, 0, 0, 0));
+	r->SetActiveStatus(active);
+
+	bool ok = true;
+	uint32_t n;
+
+	// Header tests.
+	ok = ok && fmt->Read(&n, "num_hdr_tests");
+
+	for ( uint32_t i = 0; ok && i < n; ++i )
+		{
+		int prot, comp;
+		uint32_t offset, size, num_vals, num_prefixes;
+
+		ok = fmt->Read(&prot, "prot") && prot >= RuleHdrTest::NOPROT && prot <= RuleHdrTest::IPDst &&
+		     fmt->Read(&comp, "comp") && comp >= RuleHdrTest::LE && comp <= RuleHdrTest::NE &&
+		     fmt->Read(&offset, "offset") && fmt->Read(&size, "size") &&
+		     fmt->Read(&num_vals, "num_vals");
+
+		if ( ! ok )
+			break;
+
+		auto vals = new maskedvalue_list;
+		auto h = new RuleHdrTest(static_cast<RuleHdrTest::Prot>(prot), offset, size,
+		                         static_cast<RuleHdrTest::Comp>(comp), vals);
+		r->AddHdrTest(h);
+
+		for ( uint32_t j = 0; ok && j < num_vals; ++j )
+			{
+			auto mval = new MaskedValue;
+			vals->push_back(mval);
+			ok = fmt->Read(&mval->val, "val") && fmt->Read(&mval->mask, "mask");
+			}
+
+		ok = ok && fmt->Read(&num_prefixes, "num_prefixes");
+
+		for ( uint32_t j = 0; ok && j < num_prefixes; ++j )
+			{
+			IPPrefix prefix;
+			ok = fmt->Read(&prefix, "prefix");
+			h->prefix_vals.push_back(prefix);
+			}
+		}
+
+	// Patterns.
+	ok = ok && fmt->Read(&n, "num_patterns");
+
+	for ( uint32_t i = 0; ok && i < n; ++i )
+		{
+		std::string pattern;
+		int type;
+		uint32_t offset, depth;
+
+		ok = fmt->Read(&pattern, "pattern") &&
+		     fmt->Read(&type, "type") && type >= 0 && type < Rule::TYPES &&
+		     fmt->Read(&offset, "offset") && fmt->Read(&depth, "depth");
+
+		if ( ok )
+			r->AddPattern(pattern.c_str(), static_cast<Rule::PatternType>(type), offset, depth);
+		}
+
+	// Conditions and actions.
+	ok = ok && fmt->Read(&n, "num_conditions");
+
+	for ( uint32_t i = 0; ok && i < n; ++i )
+		{
+		auto c = RuleCondition::Unserialize(fmt);
+
+		if ( c )
+			r->AddCondition(c);
+		else
+			ok = false;
+		}
+
+	ok = ok && fmt->Read(&n, "num_actions");
+
+	for ( uint32_t i = 0; ok && i < n; ++i )
+		{
+		auto a = RuleAction::Unserialize(fmt);
+
+		if ( a )
+			r->AddAction(a);
+		else
+			ok = false;
+		}
+
+	// Dependencies on other rules.
+	ok = ok && fmt->Read(&n, "num_preconds");
+
+	for ( uint32_t i = 0; ok && i < n; ++i )
+		{
+		std::string pid;
+		bool opposite_dir, negate;
+
+		ok = fmt->Read(&pid, "id") && fmt->Read(&opposite_dir, "opposite_dir") &&
+		     fmt->Read(&negate, "negate");
+
+		if ( ok )
+			r->AddRequires(pid.c_str(), opposite_dir, negate);
+		}
+
+	if ( ! ok )
+		{
+		delete r;
+		return nullptr;
+		}
+
+	return r;
+	}
+
+void RuleMatcher::WriteCache(const std::string& file)
+	{
+	BinarySerializationFormat fmt;
+	fmt.StartWrite();
+
+	bool ok = fmt.Write("ZSIG", "magic") &&
+	          fmt.Write(SIG_CACHE_VERSION, "version") &&
+	          fmt.Write(zeek_version(), "zeek_version") &&
+	          fmt.Write(static_cast<uint32_t>(referenced_ids.size()), "num_ids");
+
+	for ( const auto& [name, value] : referenced_ids )
+		ok = ok && fmt.Write(name, "name") && fmt.Write(value, "value");
+
+	ok = ok && fmt.Write(static_cast<uint32_t>(rules.length()), "num_rules");
+
+	for ( const auto& r : rules )
+		ok = ok && WriteCachedRule(&fmt, r);
+
+	char* data;
+	uint32_t len = fmt.EndWrite(&data);
+
+	if ( ! ok )
+		{
+		// Some signature uses something the cache can't represent.
+		DBG_LOG(DBG_RULES, "Signatures can't be cached");
+		free(data);
+		return;
+		}
+
+	// Write to a temporary file first, so that processes starting up
+	// concurrently never see a partial cache.
+	auto tmp = util::fmt("%s.%d.tmp", file.c_str(), getpid());
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if ( fd < 0 )
+		{
+		reporter->Warning("can't write signature cache %s: %s", tmp, strerror(errno));
+		free(data);
+		return;
+		}
+
+	ok = util::safe_write(fd, data, len);
+	close(fd);
+	free(data);
+
+	if ( ! ok || rename(tmp, file.c_str()) < 0 )
+		{
+		reporter->Warning("can't write signature cache %s: %s", file.c_str(), strerror(errno));
+		unlink(tmp);
+		}
+	}
+
+bool RuleMatcher::WriteCachedRule(SerializationFormat* fmt, const Rule* r)
+	{
+	const auto& loc = r->GetLocation();
+
+	bool ok = fmt->Write(r->id, "id") &&
+	          fmt->Write(loc.filename ? loc.filename : "", "file") &&
+	          fmt->Write(loc.first_line, "line") &&
+	          fmt->Write(r->active, "active");
+
+	ok = ok && fmt->Write(static_cast<uint32_t>(r->hdr_tests.length()), "num_hdr_tests");
+
+	for ( const auto& h : r->hdr_tests )
+		{
+		ok = ok && fmt->Write(static_cast<int>(h->prot), "prot") &&
+		     fmt->Write(static_cast<int>(h->comp), "comp") &&
+		     fmt->Write(h->offset, "offset") && fmt->Write(h->size, "size") &&
+		     fmt->Write(static_cast<uint32_t>(h->vals->length()), "num_vals");
+
+		for ( const auto& mval : *h->vals )
+			ok = ok && fmt->Write(mval->val, "val") && fmt->Write(mval->mask, "mask");
+
+		ok = ok && fmt->Write(static_cast<uint32_t>(h->prefix_vals.size()), "num_prefixes");
+
+		for ( const auto& prefix : h->prefix_vals )
+			ok = ok && fmt->Write(prefix, "prefix");
+		}
+
+	ok = ok && fmt->Write(static_cast<uint32_t>(r->patterns.length()), "num_patterns");
+
+	for ( const auto& p : r->patterns )
+		ok = ok && fmt->Write(p->pattern, "pattern") &&
+		     fmt->Write(static_cast<int>(p->type), "type") &&
+		     fmt->Write(p->offset, "offset") && fmt->Write(p->depth, "depth");
+
+	ok = ok && fmt->Write(static_cast<uint32_t>(r->conditions.length()), "num_conditions");
+
+	for ( const auto& c : r->conditions )
+		ok = ok && c->Serialize(fmt);
+
+	ok = ok && fmt->Write(static_cast<uint32_t>(r->actions.length()), "num_actions");
+
+	for ( const auto& a : r->actions )
+		ok = ok && a->Serialize(fmt);
+
+	ok = ok && fmt->Write(static_cast<uint32_t>(r->preconds.length()), "num_preconds");
+
+	for ( const auto& p : r->preconds )
+		ok = ok && fmt->Write(p->id, "id") &&
+		     fmt->Write(p->opposite_dir, "opposite_dir") &&
+		     fmt->Write(p->negate, "negate");
+
+	return ok;
+	}
+
 void RuleMatcher::AddRule(Rule* rule)
 	{
 	if ( rules_by_id.find(rule->ID()) != rules_by_id.end() )
@@ -384,15 +829,20 @@ void RuleMatcher::InsertRuleIntoTree(Rule* r, int testnr,
 	}
 
 void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
-                             int_list* ids)
+                             int_list* ids, std::vector<const RuleHdrTest*>* owners)
 	{
 	// For each type, get all patterns on this node.
 	for ( Rule* r = hdr_test->pattern_rules; r; r = r->next )
 		{
 		for ( const auto& p : r->patterns )
 			{
+			if ( p->type == Rule::FILE_MAGIC && r->patterns.length() == 1 &&
+			     AddMagicPrefix(r, p) )
+				continue;
+
 			exprs[p->type].push_back(p->pattern);
 			ids[p->type].push_back(p->id);
+			owners[p->type].push_back(hdr_test);
 			}
 		}
 
@@ -401,7 +851,7 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 		{
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			if ( exprs[i].length() )
-				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i], owners[i]);
 		}
 
 	// Get the patterns on all of our children.
@@ -409,8 +859,9 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 		{
 		string_list child_exprs[Rule::TYPES];
 		int_list child_ids[Rule::TYPES];
+		std::vector<const RuleHdrTest*> child_owners[Rule::TYPES];
 
-		BuildRegEx(h, child_exprs, child_ids);
+		BuildRegEx(h, child_exprs, child_ids, child_owners);
 
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			{
@@ -418,6 +869,7 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 				{
 				exprs[i].push_back(child_exprs[i][j]);
 				ids[i].push_back(child_ids[i][j]);
+				owners[i].push_back(child_owners[i][j]);
 				}
 			}
 		}
@@ -428,21 +880,129 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 		{
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			if ( exprs[i].length() )
-				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i], owners[i]);
 		}
 
 	// If we're below the RE_level, the regexprs remains empty.
 	}
 
+// Returns the value of a hex digit, or -1 if it isn't one.
+static int hex_digit(char c)
+	{
+	if ( c >= '0' && c <= '9' )
+		return c - '0';
+	if ( c >= 'a' && c <= 'f' )
+		return c - 'a' + 10;
+	if ( c >= 'A' && c <= 'F' )
+		return c - 'A' + 10;
+	return -1;
+	}
+
+// Extracts the bytes from a pattern consisting of a "^" followed by
+// literal characters and escapes only. Returns false for anything else.
+static bool anchored_literal(const char* pattern, std::string* bytes)
+	{
+	if ( *pattern != '^' )
+		return false;
+
+	bytes->clear();
+
+	for ( const char* c = pattern + 1; *c; ++c )
+		{
+		if ( strchr(".[]()|*+?{}^$\\\"/", *c) == nullptr )
+			{
+			bytes->push_back(*c);
+			continue;
+			}
+
+		if ( *c != '\\' )
+			return false;
+
+		++c;
+
+		if ( *c == 'x' )
+			{
+			int hi = hex_digit(c[1]);
+			int lo = hi >= 0 ? hex_digit(c[2]) : -1;
+
+			if ( lo < 0 )
+				return false;
+
+			bytes->push_back(static_cast<char>(hi * 16 + lo));
+			c += 2;
+			}
+
+		// Escaped letters and digits may be classes or
+		// control characters.
+		else if ( *c && ! isalnum(static_cast<unsigned char>(*c)) )
+			bytes->push_back(*c);
+
+		else
+			return false;
+		}
+
+	return ! bytes->empty();
+	}
+
+bool RuleMatcher::AddMagicPrefix(Rule* r, const Rule::Pattern* p)
+	{
+	std::string bytes;
+
+	if ( p->offset != 0 || ! anchored_literal(p->pattern, &bytes) ||
+	     bytes.size() > p->depth )
+		return false;
+
+	uint32_t node = 0;
+
+	for ( char c : bytes )
+		{
+		auto b = static_cast<u_char>(c);
+		auto& children = magic_prefixes[node].children;
+		auto it = std::lower_bound(children.begin(), children.end(),
+		                           std::make_pair(b, uint32_t(0)));
+
+		if ( it != children.end() && it->first == b )
+			node = it->second;
+		else
+			{
+			uint32_t child = magic_prefixes.size();
+			children.insert(it, {b, child});
+			magic_prefixes.emplace_back();
+			node = child;
+			}
+		}
+
+	magic_prefixes[node].rules.push_back(r);
+	return true;
+	}
+
+void RuleMatcher::AddMIMEMatches(const Rule* r, MIME_Matches* matches)
+	{
+	for ( const auto& action : r->actions )
+		{
+		const RuleActionMIME* ram =
+			dynamic_cast<const RuleActionMIME*>(action);
+
+		if ( ! ram )
+			continue;
+
+		set<string>& ss = (*matches)[ram->GetStrength()];
+		ss.insert(ram->GetMIME());
+		}
+	}
+
 void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
-                                   const string_list& exprs, const int_list& ids)
+                                   const string_list& exprs, const int_list& ids,
+                                   const std::vector<const RuleHdrTest*>& owners)
 	{
 	assert(static_cast<size_t>(exprs.length()) == ids.size());
+	assert(ids.size() == owners.size());
 
 	// We build groups of at most sig_max_group_size regexps.
 
 	string_list group_exprs;
 	int_list group_ids;
+	std::vector<const RuleHdrTest*> group_owners;
 
 	for ( int i = 0; i < exprs.length() + 1 /* sic! */; i++ )
 		{
@@ -450,6 +1010,10 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
 			{
 			group_exprs.push_back(exprs[i]);
 			group_ids.push_back(ids[i]);
+
+			if ( std::find(group_owners.begin(), group_owners.end(),
+			               owners[i]) == group_owners.end() )
+				group_owners.push_back(owners[i]);
 			}
 
 		if ( group_exprs.length() > sig_max_group_size ||
@@ -461,10 +1025,12 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
 			set->re->CompileSet(group_exprs, group_ids);
 			set->patterns = group_exprs;
 			set->ids = group_ids;
+			set->owners = std::move(group_owners);
 			dst->push_back(set);
 
 			group_exprs.clear();
 			group_ids.clear();
+			group_owners.clear();
 			}
 		}
 	}
@@ -682,6 +1248,31 @@ RuleMatcher::MIME_Matches* RuleMatcher::Match(RuleFileMagicState* state,
 		}
 #endif
 
+	// Patterns that are just a string at the beginning take a walk
+	// along the trie.
+	if ( ! magic_prefixes.empty() )
+		{
+		uint32_t node = 0;
+
+		for ( uint64_t i = 0; ; ++i )
+			{
+			for ( const auto* r : magic_prefixes[node].rules )
+				AddMIMEMatches(r, rval);
+
+			if ( i == len )
+				break;
+
+			const auto& children = magic_prefixes[node].children;
+			auto it = std::lower_bound(children.begin(), children.end(),
+			                           std::make_pair(data[i], uint32_t(0)));
+
+			if ( it == children.end() || it->first != data[i] )
+				break;
+
+			node = it->second;
+			}
+		}
+
 	bool newmatch = false;
 
 	for ( const auto& m : state->matchers )
@@ -718,23 +1309,8 @@ RuleMatcher::MIME_Matches* RuleMatcher::Match(RuleFileMagicState* state,
 			rule_matches.insert(r);
 		}
 
-	for ( set<Rule*>::const_iterator it = rule_matches.begin();
-	      it != rule_matches.end(); ++it )
-		{
-		Rule* r = *it;
-
-		for ( const auto& action : r->actions )
-			{
-			const RuleActionMIME* ram =
-				dynamic_cast<const RuleActionMIME*>(action);
-
-			if ( ! ram )
-				continue;
-
-			set<string>& ss = (*rval)[ram->GetStrength()];
-			ss.insert(ram->GetMIME());
-			}
-		}
+	for ( const auto* r : rule_matches )
+		AddMIMEMatches(r, rval);
 
 	return rval;
 	}
@@ -750,6 +1326,11 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer,
 	rule_hdr_test_list tests;
 	tests.push_back(root);
 
+	// Pattern sets of the nodes we get to. Which of them we need
+	// depends on the nodes further down, so we wait with setting up
+	// their matchers until we're through the tree.
+	std::vector<std::pair<RuleHdrTest::PatternSet*, Rule::PatternType>> psets;
+
 	loop_over_list(tests, h)
 		{
 		RuleHdrTest* hdr_test = tests[h];
@@ -778,11 +1359,7 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer,
 				for ( const auto& set : hdr_test->psets[i] )
 					{
 					assert(set->re);
-
-					auto* m = new RuleEndpointState::Matcher;
-					m->state = new RE_Match_State(set->re);
-					m->type = (Rule::PatternType) i;
-					state->matchers.push_back(m);
+					psets.emplace_back(set, (Rule::PatternType) i);
 					}
 				}
 			}
@@ -840,6 +1417,36 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer,
 				}
 			}
 		}
+
+	// A set on the RE_level also holds the patterns of the nodes
+	// below, whose header tests we may not have passed.
+	auto needed = [&state](const RuleHdrTest::PatternSet* set)
+		{
+		if ( set->owners.empty() )
+			return true;
+
+		for ( const auto& owner : set->owners )
+			for ( const auto& h : state->hdr_tests )
+				if ( h == owner )
+					return true;
+
+		return false;
+		};
+
+	for ( const auto& [set, type] : psets )
+		{
+		if ( ! needed(set) )
+			{
+			DBG_LOG(DBG_RULES, "Skipping pattern set, none of its rules apply");
+			continue;
+			}
+
+		auto* m = new RuleEndpointState::Matcher;
+		m->state = new RE_Match_State(set->re);
+		m->type = type;
+		state->matchers.push_back(m);
+		}
+
 	// Save some memory.
 	state->hdr_tests.resize(0);
 	state->matchers.resize(0);
@@ -1120,6 +1727,15 @@ void RuleMatcher::ExecRule(Rule* rule, RuleEndpointState* state, bool eos)
 		}
 	}
 
+bool RuleEndpointState::PayloadExhausted() const
+	{
+	for ( const auto& m : matchers )
+		if ( m->type == Rule::PAYLOAD && ! m->state->Exhausted() )
+			return false;
+
+	return true;
+	}
+
 void RuleMatcher::ClearEndpointState(RuleEndpointState* state)
 	{
 	ExecPureRules(state, true);
@@ -1201,6 +1817,7 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test)
 		stats->mem = 0;
 		stats->hits = 0;
 		stats->misses = 0;
+		stats->evicted = 0;
 		stats->nfa_states = 0;
 		hdr_test = root;
 		}
@@ -1221,6 +1838,7 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test)
 			stats->mem += cstats.mem;
 			stats->hits += cstats.hits;
 			stats->misses += cstats.misses;
+			stats->evicted += cstats.evicted;
 			stats->nfa_states += cstats.nfa_states;
 			}
 		}
@@ -1284,6 +1902,9 @@ static Val* get_bro_val(const char* label)
 		return nullptr;
 		}
 
+	if ( rule_matcher )
+		rule_matcher->NoteReferencedID(label, id->GetVal().get());
+
 	return id->GetVal().get();
 	}
 
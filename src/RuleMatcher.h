@@ -8,6 +8,7 @@
 #include <functional>
 #include <set>
 #include <string>
+#include <utility>
 
 #include "Rule.h"
 #include "RE.h"
@@ -38,6 +39,7 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Analyzer, zeek, analyzer);
 ZEEK_FORWARD_DECLARE_NAMESPACED(IntSet, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(PIA, zeek, analyzer::pia);
+ZEEK_FORWARD_DECLARE_NAMESPACED(SerializationFormat, zeek::detail);
 
 namespace zeek::detail {
 
@@ -115,6 +117,11 @@ private:
 		// All the patterns and their rule indices.
 		string_list patterns;
 		int_list ids;	// (only needed for debugging)
+
+		// The nodes holding the rules that the patterns come from.
+		// Endpoints not getting to any of them can skip the set.
+		// If empty, the set always runs.
+		std::vector<const RuleHdrTest*> owners;
 	};
 
 	using pattern_set_list = PList<PatternSet>;
@@ -153,6 +160,11 @@ public:
 
 	analyzer::pia::PIA* PIA() const	{ return pia; }
 
+	// Returns true if none of the payload patterns can match anymore,
+	// given the input so far. That's typically clear after the first
+	// byte of payload.
+	bool PayloadExhausted() const;
+
 private:
 	friend class RuleMatcher;
 
@@ -220,7 +232,10 @@ public:
 	RuleMatcher(int RE_level = 4);
 	~RuleMatcher();
 
-	// Parse the given files and built up data structures.
+	// Parse the given files and built up data structures. With
+	// signature_cache_dir set, the parsed signatures get cached there,
+	// keyed by the files' contents, and later calls with the same files
+	// load them from the cache instead of parsing them again.
 	bool ReadFiles(const std::vector<std::string>& files);
 
 	/**
@@ -285,6 +300,11 @@ public:
 	void AddRule(Rule* rule);
 	void SetParseError()		{ parse_error = true; }
 
+	// Records the value of a script-level identifier that the
+	// signatures being parsed refer to. Cached signatures remain valid
+	// only as long as it keeps that value.
+	void NoteReferencedID(const char* id, const Val* v);
+
 	bool HasNonFileMagicRule() const	{ return has_non_file_magic_rule; }
 
 	// Interface to for getting some statistics
@@ -302,6 +322,7 @@ public:
 		// # cache hits (sampled, multiply by MOVE_TO_FRONT_SAMPLE_SIZE)
 		unsigned int hits;
 		unsigned int misses;	// # cache misses
+		unsigned int evicted;	// # DFA states dropped to stay within budget
 	};
 
 	Val* BuildRuleStateValue(const Rule* rule,
@@ -322,11 +343,14 @@ private:
 				int level);
 
 	// Traverse tree building the combined regular expressions.
-	void BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list* ids);
+	// For each pattern, owners receives the node its rule is on.
+	void BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list* ids,
+	                std::vector<const RuleHdrTest*>* owners);
 
 	// Build groups of regular epxressions.
 	void BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
-				const string_list& exprs, const int_list& ids);
+				const string_list& exprs, const int_list& ids,
+				const std::vector<const RuleHdrTest*>& owners);
 
 	// Check an arbitrary rule if it's satisfied right now.
 	// eos signals end of stream
@@ -351,17 +375,55 @@ private:
 
 	void PrintTreeDebug(RuleHdrTest* node);
 
+	// Returns the path of the cache file for the given signature files,
+	// or an empty string if there's no cache.
+	std::string CacheFile(const std::vector<std::string>& paths) const;
+
+	// Loads the signatures from a cache file. Returns false if there's
+	// no valid one, without having added any rules.
+	bool ReadCache(const std::string& file);
+	bool ReadCachedRules(SerializationFormat* fmt);
+	Rule* ReadCachedRule(SerializationFormat* fmt);
+
+	// Writes the parsed signatures into a cache file.
+	void WriteCache(const std::string& file);
+	bool WriteCachedRule(SerializationFormat* fmt, const Rule* r);
+
 	void DumpStateStats(File* f, RuleHdrTest* hdr_test);
 
 	static bool AllRulePatternsMatched(const Rule* r, MatchPos matchpos,
 	                                   const AcceptingMatchSet& ams);
 
+	// If a file magic rule's only pattern is a plain byte string anchored
+	// at the beginning, adds it to the magic prefix trie and returns true.
+	// Such patterns don't need to go into the regular expressions.
+	bool AddMagicPrefix(Rule* r, const Rule::Pattern* p);
+
+	// Adds the MIME types of a matching file magic rule.
+	static void AddMIMEMatches(const Rule* r, MIME_Matches* matches);
+
+	// A trie over the byte strings that file magic patterns require at the
+	// beginning of a file.
+	struct MagicPrefixNode {
+		std::vector<std::pair<u_char, uint32_t>> children;	// Sorted by byte.
+		std::vector<const Rule*> rules;	// Rules matching at this node.
+	};
+
+	std::vector<MagicPrefixNode> magic_prefixes;	// The root comes first.
+
 	int RE_level;
 	bool has_non_file_magic_rule;
 	bool parse_error;
 	RuleHdrTest* root;
 	rule_list rules;
 	rule_dict rules_by_id;
+
+	// Script-level identifiers the signatures refer to, with their values
+	// in the form NoteReferencedID() stores them, for the cache.
+	std::map<std::string, std::string> referenced_ids;
+
+	// Names of signature files that rules loaded from the cache point to.
+	std::set<std::string> cached_file_names;
 };
 
 // Keeps bi-directional matching-state.
@@ -386,6 +448,15 @@ public:
 	bool MatcherInitialized(bool orig)
 		{ return orig ? orig_match_state : resp_match_state; }
 
+	// Returns true if, for both endpoints, no payload pattern can match
+	// anymore without starting over, so that no signature with payload
+	// conditions can trigger on further input.
+	bool PayloadMatchingExhausted() const
+		{
+		return orig_match_state && orig_match_state->PayloadExhausted() &&
+		       resp_match_state && resp_match_state->PayloadExhausted();
+		}
+
 private:
 	RuleEndpointState* orig_match_state;
 	RuleEndpointState* resp_match_state;
@@ -30,6 +30,10 @@ extern "C" {
 #include "ID.h"
 #include "Reporter.h"
 #include "Scope.h"
+#include "Stats.h"
+#include "AllocationProfiler.h"
+#include "LoopTrace.h"
+#include "telemetry/Manager.h"
 #include "Anon.h"
 #include "iosource/Manager.h"
 #include "iosource/PktSrc.h"
@@ -53,6 +57,7 @@ iosource::PktSrc* current_pktsrc = nullptr;
 iosource::IOSource* current_iosrc = nullptr;
 bool have_pending_timers = false;
 double first_wallclock = 0.0;
+int bench_loops = 0;
 double first_timestamp = 0.0;
 double current_wallclock = 0.0;
 double current_pseudo = 0.0;
@@ -205,10 +210,16 @@ void init_run(const std::optional<std::string>& interface,
 void expire_timers()
 	{
 	zeek::detail::SegmentProfiler prof(zeek::detail::segment_logger, "expiring-timers");
+	zeek::detail::StageTimer stage(zeek::detail::STAGE_TIMERS);
 
-	current_dispatched +=
-		zeek::detail::timer_mgr->Advance(network_time,
-			zeek::detail::max_timer_expires - current_dispatched);
+	uint64_t trace_start = zeek::detail::loop_trace ? zeek::detail::LoopTrace::Now() : 0;
+	int expired = zeek::detail::timer_mgr->Advance(network_time,
+		zeek::detail::max_timer_expires - current_dispatched);
+	current_dispatched += expired;
+
+	if ( zeek::detail::loop_trace && expired )
+		zeek::detail::loop_trace->Record(zeek::detail::LoopTraceType::TIMERS, expired,
+		                                 zeek::detail::LoopTrace::Now() - trace_start);
 	}
 
 void dispatch_packet(Packet* pkt, iosource::PktSrc* pkt_src)
@@ -254,7 +265,22 @@ void dispatch_packet(Packet* pkt, iosource::PktSrc* pkt_src)
 			}
 		}
 
+	if ( zeek::detail::stage_profiler )
+		zeek::detail::stage_profiler->ProfilePkt(pkt->len);
+
+	if ( telemetry_mgr )
+		{
+		telemetry_mgr->packets->Inc();
+		telemetry_mgr->packet_bytes->Inc(pkt->len);
+
+		if ( reading_live && ! pseudo_realtime )
+			telemetry_mgr->packet_latency->Observe(util::current_time(true) - pkt->time);
+		}
+
+	zeek::detail::StageTimer stage(zeek::detail::STAGE_PACKET_ANALYSIS);
 	packet_mgr->ProcessPacket(pkt);
+	stage.Done();
+
 	event_mgr.Drain();
 
 	if ( sp )
@@ -287,6 +313,7 @@ void run_loop()
 	while ( iosource_mgr->Size() ||
 		(BifConst::exit_only_after_terminate && ! terminating) )
 		{
+		uint64_t iteration_start = zeek::detail::loop_trace ? zeek::detail::LoopTrace::Now() : 0;
 		iosource_mgr->FindReadySources(&ready);
 
 #ifdef DEBUG
@@ -312,7 +339,19 @@ void run_loop()
 				{
 				DBG_LOG(DBG_MAINLOOP, "processing source %s", src->Tag());
 				current_iosrc = src;
+
+				double start = telemetry_mgr ? util::current_time(true) : 0;
+				uint64_t trace_start = zeek::detail::loop_trace ? zeek::detail::LoopTrace::Now() : 0;
+
 				src->Process();
+
+				if ( zeek::detail::loop_trace )
+					zeek::detail::loop_trace->Record(zeek::detail::LoopTraceType::SOURCE,
+					                                 zeek::detail::loop_trace->SourceID(src->Tag()),
+					                                 zeek::detail::LoopTrace::Now() - trace_start);
+
+				if ( telemetry_mgr )
+					telemetry_mgr->ObserveIOSource(src->Tag(), util::current_time(true) - start);
 				}
 			}
 		else if ( (have_pending_timers || communication_enabled ||
@@ -333,6 +372,12 @@ void run_loop()
 		current_dispatched = 0;
 		current_iosrc = nullptr;
 
+		if ( zeek::detail::alloc_profiler && zeek::detail::AllocationProfiler::DumpDue() )
+			zeek::detail::alloc_profiler->Dump();
+
+		if ( zeek::detail::loop_trace )
+			zeek::detail::loop_trace->IterationDone(iteration_start, ready.size());
+
 		if ( ::signal_val == SIGTERM || ::signal_val == SIGINT )
 			// We received a signal while processing the
 			// current packet and its related events.
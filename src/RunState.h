@@ -49,6 +49,10 @@ extern bool have_pending_timers;
 
 extern double first_wallclock;
 
+// If > 0, the trace is read into memory up front and replayed this many
+// times as fast as possible, for benchmarking.
+extern int bench_loops;
+
 // Only set in pseudo-realtime mode.
 extern double first_timestamp;
 extern double current_wallclock;
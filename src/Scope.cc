@@ -39,10 +39,10 @@ Scope::Scope(IDPtr id,
 
 const IDPtr& Scope::Find(std::string_view name) const
 	{
-	auto entry = local.find(name);
+	auto entry = index.find(name);
 
-	if ( entry != local.end() )
-		return entry->second;
+	if ( entry != index.end() )
+		return *entry->second;
 
 	return ID::nil;
 	}
@@ -54,6 +54,7 @@ IDPtr Scope::Remove(std::string_view name)
 	if ( entry != local.end() )
 		{
 		auto id = std::move(entry->second);
+		index.erase(entry->first);
 		local.erase(entry);
 		return id;
 		}
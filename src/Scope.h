@@ -6,6 +6,7 @@
 #include <string>
 #include <string_view>
 #include <map>
+#include <unordered_map>
 
 #include "Obj.h"
 #include "ZeekList.h"
@@ -44,7 +45,11 @@ public:
 		{ return Find(name).get(); }
 
 	template<typename N, typename I>
-	void Insert(N&& name, I&& id) { local[std::forward<N>(name)] = std::forward<I>(id); }
+	void Insert(N&& name, I&& id)
+		{
+		auto it = local.insert_or_assign(std::forward<N>(name), std::forward<I>(id)).first;
+		index[it->first] = &it->second;
+		}
 
 	IDPtr Remove(std::string_view name);
 
@@ -86,6 +91,11 @@ protected:
 	TypePtr return_type;
 	std::map<std::string, IDPtr, std::less<>> local;
 	std::vector<IDPtr> inits;
+
+	// Hashed view of local for Find(), which scripts and BiFs call by
+	// name at run time. The map keeps providing ordered iteration. Keys
+	// and values point into local's nodes, which stay put.
+	std::unordered_map<std::string_view, const IDPtr*> index;
 };
 
 // If no_global is true, don't search in the default "global" namespace.
@@ -0,0 +1,177 @@
+#include "ScriptProfiler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cinttypes>
+#include <sys/time.h>
+
+#include "Frame.h"
+#include "Func.h"
+#include "Stmt.h"
+#include "Reporter.h"
+#include "Val.h"
+#include "util.h"
+
+namespace zeek::detail {
+
+ScriptProfiler::~ScriptProfiler()
+	{
+	StopTimer();
+	}
+
+void ScriptProfiler::HandleSignal(int /* signo */)
+	{
+	sample_due = 1;
+	}
+
+bool ScriptProfiler::Start()
+	{
+	if ( active || ! util::zeekenv("ZEEK_SCRIPT_PROFILE_FILE") )
+		return false;
+
+	long rate = 100;
+
+	if ( const char* r = util::zeekenv("ZEEK_SCRIPT_PROFILE_RATE") )
+		{
+		rate = strtol(r, nullptr, 10);
+
+		if ( rate <= 0 || rate > 1000000 )
+			{
+			reporter->Error("invalid ZEEK_SCRIPT_PROFILE_RATE: %s", r);
+			return false;
+			}
+		}
+
+	struct sigaction action;
+	action.sa_handler = HandleSignal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	if ( sigaction(SIGPROF, &action, &old_action) < 0 )
+		{
+		reporter->Error("failed to install script profiler signal handler: %s", strerror(errno));
+		return false;
+		}
+
+	long interval = 1000000 / rate;	// In microseconds.
+
+#ifdef __APPLE__
+	// No per-thread CPU timers here, so this also counts other threads.
+	struct itimerval it;
+	it.it_interval.tv_sec = interval / 1000000;
+	it.it_interval.tv_usec = interval % 1000000;
+	it.it_value = it.it_interval;
+
+	bool started = setitimer(ITIMER_PROF, &it, nullptr) == 0;
+#else
+	// Measure the CPU time of the main thread only, so that samples
+	// don't depend on what the logging and other threads are doing.
+	struct sigevent ev = {};
+	ev.sigev_notify = SIGEV_SIGNAL;
+	ev.sigev_signo = SIGPROF;
+
+	struct itimerspec it;
+	it.it_interval.tv_sec = interval / 1000000;
+	it.it_interval.tv_nsec = (interval % 1000000) * 1000;
+	it.it_value = it.it_interval;
+
+	bool started = false;
+
+	if ( timer_create(CLOCK_THREAD_CPUTIME_ID, &ev, &timer) == 0 )
+		{
+		started = timer_settime(timer, 0, &it, nullptr) == 0;
+
+		if ( ! started )
+			timer_delete(timer);
+		}
+#endif
+
+	if ( ! started )
+		{
+		reporter->Error("failed to start script profiler timer: %s", strerror(errno));
+		sigaction(SIGPROF, &old_action, nullptr);
+		return false;
+		}
+
+	active = true;
+	return true;
+	}
+
+void ScriptProfiler::StopTimer()
+	{
+	if ( ! active )
+		return;
+
+#ifdef __APPLE__
+	struct itimerval it = {};
+	setitimer(ITIMER_PROF, &it, nullptr);
+#else
+	timer_delete(timer);
+#endif
+
+	sigaction(SIGPROF, &old_action, nullptr);
+	sample_due = 0;
+	active = false;
+	}
+
+void ScriptProfiler::Sample()
+	{
+	sample_due = 0;
+
+	std::string stack;
+
+	for ( const auto* f : g_frame_stack )
+		{
+		if ( ! stack.empty() )
+			stack += ';';
+
+		const auto* func = f->GetFunction();
+		stack += func ? func->Name() : "<global>";
+
+		const auto* stmt = f->GetNextStmt();
+
+		if ( stmt && stmt->GetLocationInfo()->filename )
+			{
+			const auto* loc = stmt->GetLocationInfo();
+			stack += util::fmt("@%s:%d", loc->filename, loc->first_line);
+			}
+		}
+
+	if ( stack.empty() )
+		stack = "<no script>";
+
+	++samples[stack];
+	}
+
+void ScriptProfiler::SampleOutsideScripts()
+	{
+	sample_due = 0;
+	++samples["<no script>"];
+	}
+
+bool ScriptProfiler::Stop()
+	{
+	if ( ! active )
+		return false;
+
+	StopTimer();
+
+	const char* fn = util::zeekenv("ZEEK_SCRIPT_PROFILE_FILE");
+	FILE* f = fopen(fn, "w");
+
+	if ( ! f )
+		{
+		reporter->Error("Failed to open ZEEK_SCRIPT_PROFILE_FILE destination '%s' for writing", fn);
+		return false;
+		}
+
+	for ( const auto& [stack, count] : samples )
+		fprintf(f, "%s %" PRIu64 "\n", stack.c_str(), count);
+
+	fclose(f);
+	return true;
+	}
+
+} // namespace zeek::detail
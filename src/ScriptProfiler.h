@@ -0,0 +1,77 @@
+#pragma once
+
+#include <signal.h>
+#include <time.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace zeek::detail {
+
+/**
+ * A sampling profiler for script execution. While active, a timer signal
+ * fires at a fixed rate of the main thread's CPU time, and the next
+ * statement to finish records the script call stack, with the function
+ * and current line of each frame. Samples arriving while no script runs
+ * count as such. The profiler writes the aggregated samples in the
+ * collapsed-stack format that flame graph tools read.
+ *
+ * Profiling starts when the environment variable ZEEK_SCRIPT_PROFILE_FILE
+ * names an output file. ZEEK_SCRIPT_PROFILE_RATE sets the number of
+ * samples per second of CPU time, with a default of 100.
+ */
+class ScriptProfiler {
+public:
+	ScriptProfiler() = default;
+	~ScriptProfiler();
+
+	/**
+	 * Starts sampling, if configured.
+	 *
+	 * @return: true if sampling started, otherwise false.
+	 */
+	bool Start();
+
+	/**
+	 * Stops sampling and writes the samples to the configured file.
+	 *
+	 * @return: true when samples were written, otherwise false.
+	 */
+	bool Stop();
+
+	/**
+	 * Returns true if the timer has fired since the last sample.
+	 */
+	static bool SampleDue()	{ return sample_due; }
+
+	/**
+	 * Records the current script call stack as a sample.
+	 */
+	void Sample();
+
+	/**
+	 * Records a sample for time spent outside of script execution.
+	 */
+	void SampleOutsideScripts();
+
+private:
+	static void HandleSignal(int signo);
+
+	void StopTimer();
+
+	inline static volatile sig_atomic_t sample_due = 0;
+
+	bool active = false;
+#ifndef __APPLE__
+	timer_t timer;
+#endif
+	struct sigaction old_action;
+
+	// Maps collapsed stacks to their number of samples.
+	std::map<std::string, uint64_t> samples;
+};
+
+extern ScriptProfiler script_profiler;
+
+} // namespace zeek::detail
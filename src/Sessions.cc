@@ -10,12 +10,17 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 #include "Desc.h"
 #include "RunState.h"
 #include "Event.h"
 #include "Timer.h"
 #include "NetVar.h"
 #include "Reporter.h"
+#include "Stats.h"
 
 #include "analyzer/protocol/icmp/ICMP.h"
 #include "analyzer/protocol/udp/UDP.h"
@@ -54,6 +59,9 @@ NetSessions::NetSessions()
 
 	packet_filter = nullptr;
 
+	if ( detail::tcp_defer_syn )
+		syn_table.Init(detail::tcp_syn_table_size);
+
 	memset(&stats, 0, sizeof(SessionStats));
 	}
 
@@ -63,11 +71,11 @@ NetSessions::~NetSessions()
 	delete stp_manager;
 
 	for ( const auto& entry : tcp_conns )
-		Unref(entry.second);
+		Unref(entry.conn);
 	for ( const auto& entry : udp_conns )
-		Unref(entry.second);
+		Unref(entry.conn);
 	for ( const auto& entry : icmp_conns )
-		Unref(entry.second);
+		Unref(entry.conn);
 
 	detail::fragment_mgr->Clear();
 	}
@@ -167,14 +175,36 @@ void NetSessions::ProcessTransportLayer(double t, const Packet* pkt, size_t rema
 		return;
 	}
 
+	detail::StageTimer lookup_stage(detail::STAGE_SESSION_LOOKUP);
 	detail::ConnIDKey key = detail::BuildConnIDKey(id);
-	Connection* conn = nullptr;
-
 	// FIXME: The following is getting pretty complex. Need to split up
 	// into separate functions.
-	auto it = d->find(key);
-	if ( it != d->end() )
-		conn = it->second;
+	Connection* conn = d->Lookup(key);
+
+	if ( ! conn && detail::flow_shedding && ! replaying_syn )
+		{
+		auto tproto = d == &tcp_conns ? TRANSPORT_TCP :
+			(d == &udp_conns ? TRANSPORT_UDP : TRANSPORT_ICMP);
+
+		if ( ShedNewFlow(pkt, key, id, tproto) )
+			return;
+		}
+
+	if ( ! conn && detail::flow_only_udp_icmp && d != &tcp_conns )
+		{
+		auto tproto = d == &udp_conns ? TRANSPORT_UDP : TRANSPORT_ICMP;
+
+		if ( ProcessFlowOnly(t, pkt, key, id, tproto) )
+			return;
+		}
+
+	if ( ! conn && detail::tcp_defer_syn && d == &tcp_conns && ! replaying_syn )
+		{
+		if ( ProcessDeferredSyn(t, pkt, key, data, len) )
+			return;
+
+		conn = d->Lookup(key);
+		}
 
 	if ( ! conn )
 		{
@@ -200,6 +230,8 @@ void NetSessions::ProcessTransportLayer(double t, const Packet* pkt, size_t rema
 			}
 		}
 
+	lookup_stage.Done();
+
 	if ( ! conn )
 		return;
 
@@ -242,6 +274,246 @@ void NetSessions::ProcessTransportLayer(double t, const Packet* pkt, size_t rema
 		}
 	}
 
+bool NetSessions::ProcessFlowOnly(double t, const Packet* pkt, const detail::ConnIDKey& key,
+                                  const ConnID& id, TransportProto proto)
+	{
+	if ( udp_inactivity_timeout > 0.0 )
+		udp_flows.Expire(t - udp_inactivity_timeout);
+
+	if ( icmp_inactivity_timeout > 0.0 )
+		icmp_flows.Expire(t - icmp_inactivity_timeout);
+
+	auto& flows = proto == TRANSPORT_UDP ? udp_flows : icmp_flows;
+	auto f = flows.Lookup(key);
+
+	if ( new_packet ||
+	     analyzer_mgr->HasAnalyzerFor(id.src_addr, ntohs(id.src_port),
+	                                  id.dst_addr, ntohs(id.dst_port), proto) )
+		{
+		if ( f )
+			flows.Remove(f);
+
+		return false;
+		}
+
+	if ( ! f )
+		{
+		bool flip = false;
+
+		if ( ! WantConnection(ntohs(id.src_port), ntohs(id.dst_port), proto, 0, flip) )
+			return true;
+
+		if ( flip )
+			f = flows.Insert(key, id.dst_addr, id.dst_port, id.src_addr, id.src_port, proto, t);
+		else
+			f = flows.Insert(key, id.src_addr, id.src_port, id.dst_addr, id.dst_port, proto, t);
+		}
+
+	bool is_orig = id.src_addr == f->orig_addr && id.src_port == f->orig_port;
+	flows.Update(f, t, is_orig, pkt->ip_hdr->TotalLen());
+
+	if ( ! pkt->ip_hdr->reassembled )
+		pkt->dump_packet = true;
+
+	return true;
+	}
+
+bool NetSessions::ProcessDeferredSyn(double t, const Packet* pkt, const detail::ConnIDKey& key,
+                                     const u_char* data, uint32_t len)
+	{
+	ExpireDeferredSyns(t);
+
+	if ( new_packet || pkt->ip_hdr->reassembled )
+		return false;
+
+	const struct tcphdr* tp = (const struct tcphdr*) data;
+	auto e = syn_table.Lookup(key);
+
+	if ( (tp->th_flags & (TH_SYN|TH_ACK|TH_FIN|TH_RST)) == TH_SYN &&
+	     len == uint32_t(tp->th_off) * 4 )
+		{
+		// A bare SYN without payload.
+		if ( e )
+			++e->syns;
+		else if ( ! syn_table.Insert(key, pkt, t) )
+			return false;
+
+		pkt->dump_packet = true;
+		return true;
+		}
+
+	if ( ! e )
+		return false;
+
+	// The handshake progressed, so build its connection by running the
+	// recorded SYN through the usual path first.
+	auto syn = *e;
+	syn_table.Remove(e);
+
+	Packet syn_pkt;
+	syn_pkt.time = syn.time;
+	syn_pkt.l2_src = syn.have_l2_src ? syn.l2_src : nullptr;
+	syn_pkt.l2_dst = syn.have_l2_dst ? syn.l2_dst : nullptr;
+	syn_pkt.vlan = syn.vlan;
+	syn_pkt.inner_vlan = syn.inner_vlan;
+	syn_pkt.encap = pkt->encap;
+	syn_pkt.proto = IPPROTO_TCP;
+	syn_pkt.cap_len = syn_pkt.len = syn.hdr_len;
+
+	if ( syn.ipv6 )
+		{
+		syn_pkt.l3_proto = L3_IPV6;
+		syn_pkt.ip_hdr = std::make_unique<IP_Hdr>((const struct ip6_hdr*) syn.hdr, false,
+		                                          syn.hdr_len);
+		}
+	else
+		{
+		syn_pkt.l3_proto = L3_IPV4;
+		syn_pkt.ip_hdr = std::make_unique<IP_Hdr>((const struct ip*) syn.hdr, false);
+		}
+
+	replaying_syn = true;
+	ProcessTransportLayer(syn.time, &syn_pkt, syn.hdr_len - syn_pkt.ip_hdr->HdrLen());
+	replaying_syn = false;
+
+	return false;
+	}
+
+bool NetSessions::ShedNewFlow(const Packet* pkt, const detail::ConnIDKey& key,
+                              const ConnID& id, TransportProto proto)
+	{
+	// Processing lag is the best measure of backlog we have: how far the
+	// packets we're working on trail behind the wall clock. Back off
+	// only once lag has halved again, to not flap around the threshold.
+	double lag = util::current_time() - pkt->time;
+	bool was_shedding = shedding;
+
+	if ( shedding )
+		shedding = lag >= detail::flow_shedding_lag / 2;
+	else
+		shedding = lag > detail::flow_shedding_lag;
+
+	if ( shedding != was_shedding && flow_shedding_state )
+		event_mgr.Enqueue(flow_shedding_state, val_mgr->Bool(shedding),
+		                  make_intrusive<IntervalVal>(lag));
+
+	if ( ! shedding )
+		return false;
+
+	// Flows we keep a compact record or a SYN for aren't new.
+	if ( proto == TRANSPORT_TCP && syn_table.Lookup(key) )
+		return false;
+
+	if ( proto == TRANSPORT_UDP && udp_flows.Lookup(key) )
+		return false;
+
+	if ( proto == TRANSPORT_ICMP && icmp_flows.Lookup(key) )
+		return false;
+
+	// The key's hash doesn't depend on direction, so a flow's packets
+	// all get the same decision. Neither does a symmetric NIC hash, which
+	// lines the decision up with how the NIC spreads flows across queues.
+	uint32_t hash = key.hash;
+
+	if ( pkt->meta.have_flow_hash && pkt->meta.symmetric_flow_hash )
+		hash = pkt->meta.flow_hash;
+
+	bool shed = hash < detail::flow_shedding_fraction * 4294967296.0;
+
+	static auto flow_shedding_ports = id::find_val<TableVal>("flow_shedding_ports");
+
+	if ( ! shed && flow_shedding_ports->Size() > 0 )
+		{
+		// Without a connection, the port we know the service by is
+		// the destination's, or the source's for a reply.
+		auto resp_port = val_mgr->Port(ntohs(id.dst_port), proto);
+		auto orig_port = val_mgr->Port(ntohs(id.src_port), proto);
+		shed = flow_shedding_ports->Find(resp_port) ||
+		       flow_shedding_ports->Find(orig_port);
+		}
+
+	if ( ! shed )
+		return false;
+
+	++stats.num_shed_packets;
+	stats.num_shed_bytes += pkt->ip_hdr->TotalLen();
+	return true;
+	}
+
+void NetSessions::PrefetchConnection(const u_char* ip, size_t len) const
+	{
+	if ( len < sizeof(struct ip) )
+		return;
+
+	auto ip4 = reinterpret_cast<const struct ip*>(ip);
+	ConnID id;
+	int proto;
+	const u_char* tp;
+
+	if ( ip4->ip_v == 4 )
+		{
+		size_t hdr_len = ip4->ip_hl * 4;
+
+		if ( (ntohs(ip4->ip_off) & (IP_MF | IP_OFFMASK)) || len < hdr_len + 4 )
+			return;
+
+		id.src_addr = IPAddr(ip4->ip_src);
+		id.dst_addr = IPAddr(ip4->ip_dst);
+		proto = ip4->ip_p;
+		tp = ip + hdr_len;
+		}
+
+	else if ( ip4->ip_v == 6 && len >= sizeof(struct ip6_hdr) + 4 )
+		{
+		// Only covers transport headers directly following the fixed
+		// header; walking extension headers isn't worth it here.
+		auto ip6 = reinterpret_cast<const struct ip6_hdr*>(ip);
+		id.src_addr = IPAddr(ip6->ip6_src);
+		id.dst_addr = IPAddr(ip6->ip6_dst);
+		proto = ip6->ip6_nxt;
+		tp = ip + sizeof(struct ip6_hdr);
+		}
+
+	else
+		return;
+
+	const ConnectionMap* m;
+
+	if ( proto == IPPROTO_TCP )
+		m = &tcp_conns;
+	else if ( proto == IPPROTO_UDP )
+		m = &udp_conns;
+	else
+		return;
+
+	// TCP and UDP headers both start with the ports.
+	uint16_t ports[2];
+	memcpy(ports, tp, sizeof(ports));
+	id.src_port = ports[0];
+	id.dst_port = ports[1];
+	id.is_one_way = false;
+
+	m->Prefetch(detail::BuildConnIDKey(id));
+	}
+
+void NetSessions::ExpireDeferredSyns(double t, bool all)
+	{
+	if ( ! all && t < next_syn_expiration )
+		return;
+
+	// Sweeping the whole table is linear in its size, so do it only once
+	// per timeout. A handshake may thus wait for up to twice as long.
+	next_syn_expiration = t + detail::tcp_SYN_timeout;
+
+	auto cutoff = all ? std::numeric_limits<double>::max() : t - detail::tcp_SYN_timeout;
+	auto expired = syn_table.Expire(cutoff);
+	auto evicted = syn_table.TakeEvicted();
+
+	if ( tcp_unanswered_syns && (expired || evicted) )
+		event_mgr.Enqueue(tcp_unanswered_syns, val_mgr->Count(expired),
+		                  val_mgr->Count(evicted));
+	}
+
 int NetSessions::ParseIPPacket(int caplen, const u_char* const pkt, int proto,
                                IP_Hdr*& inner)
 	{
@@ -320,7 +592,7 @@ Connection* NetSessions::FindConnection(Val* v)
 		return nullptr;
 
 	RecordType* vr = vt->AsRecordType();
-	auto vl = v->AsRecord();
+	auto rv = v->AsRecordVal();
 
 	int orig_h, orig_p;	// indices into record's value list
 	int resp_h, resp_p;
@@ -336,10 +608,11 @@ Connection* NetSessions::FindConnection(Val* v)
 	else
 		{
 		// While it's not a conn_id, it may have equivalent fields.
-		orig_h = vr->FieldOffset("orig_h");
-		resp_h = vr->FieldOffset("resp_h");
-		orig_p = vr->FieldOffset("orig_p");
-		resp_p = vr->FieldOffset("resp_p");
+		// Which type that is differs by call, so there's no handle.
+		orig_h = vr->FieldOffset("orig_h");	// NOLINT(field-lookup)
+		resp_h = vr->FieldOffset("resp_h");	// NOLINT(field-lookup)
+		orig_p = vr->FieldOffset("orig_p");	// NOLINT(field-lookup)
+		resp_p = vr->FieldOffset("resp_p");	// NOLINT(field-lookup)
 
 		if ( orig_h < 0 || resp_h < 0 || orig_p < 0 || resp_p < 0 )
 			return nullptr;
@@ -348,11 +621,11 @@ Connection* NetSessions::FindConnection(Val* v)
 		// types, too.
 		}
 
-	const IPAddr& orig_addr = (*vl)[orig_h]->AsAddr();
-	const IPAddr& resp_addr = (*vl)[resp_h]->AsAddr();
+	const IPAddr& orig_addr = rv->GetField(orig_h)->AsAddr();
+	const IPAddr& resp_addr = rv->GetField(resp_h)->AsAddr();
 
-	PortVal* orig_portv = (*vl)[orig_p]->AsPortVal();
-	PortVal* resp_portv = (*vl)[resp_p]->AsPortVal();
+	PortVal* orig_portv = rv->GetField(orig_p)->AsPortVal();
+	PortVal* resp_portv = rv->GetField(resp_p)->AsPortVal();
 
 	ConnID id;
 
@@ -381,12 +654,7 @@ Connection* NetSessions::FindConnection(Val* v)
 		return nullptr;
 		}
 
-	Connection* conn = nullptr;
-	auto it = d->find(key);
-	if ( it != d->end() )
-		conn = it->second;
-
-	return conn;
+	return d->Lookup(key);
 	}
 
 void NetSessions::Remove(Connection* c)
@@ -416,17 +684,17 @@ void NetSessions::Remove(Connection* c)
 
 		switch ( c->ConnTransport() ) {
 		case TRANSPORT_TCP:
-			if ( tcp_conns.erase(key) == 0 )
+			if ( ! tcp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
 		case TRANSPORT_UDP:
-			if ( udp_conns.erase(key) == 0 )
+			if ( ! udp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
 		case TRANSPORT_ICMP:
-			if ( icmp_conns.erase(key) == 0 )
+			if ( ! icmp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
@@ -446,24 +714,21 @@ void NetSessions::Insert(Connection* c)
 	Connection* old = nullptr;
 
 	switch ( c->ConnTransport() ) {
-	// Remove first. Otherwise the map would still reference the old key for
-	// already existing connections.
+	// InsertConnection() replaces both key and connection of an existing
+	// entry.
 
 	case TRANSPORT_TCP:
 		old = LookupConn(tcp_conns, c->Key());
-		tcp_conns.erase(c->Key());
 		InsertConnection(&tcp_conns, c->Key(), c);
 		break;
 
 	case TRANSPORT_UDP:
 		old = LookupConn(udp_conns, c->Key());
-		udp_conns.erase(c->Key());
 		InsertConnection(&udp_conns, c->Key(), c);
 		break;
 
 	case TRANSPORT_ICMP:
 		old = LookupConn(icmp_conns, c->Key());
-		icmp_conns.erase(c->Key());
 		InsertConnection(&icmp_conns, c->Key(), c);
 		break;
 
@@ -483,53 +748,78 @@ void NetSessions::Insert(Connection* c)
 		}
 	}
 
+// Returns the map's connections ordered by key, so that draining
+// generates events in a deterministic order independent of the hash
+// seed.
+static std::vector<Connection*> sorted_conns(const detail::ConnectionMap& m)
+	{
+	std::vector<Connection*> conns;
+	conns.reserve(m.Size());
+
+	for ( const auto& entry : m )
+		conns.push_back(entry.conn);
+
+	std::sort(conns.begin(), conns.end(),
+	          [](const Connection* a, const Connection* b)
+	          { return a->Key() < b->Key(); });
+
+	return conns;
+	}
+
 void NetSessions::Drain()
 	{
-	for ( const auto& entry : tcp_conns )
+	for ( Connection* tc : sorted_conns(tcp_conns) )
 		{
-		Connection* tc = entry.second;
 		tc->Done();
 		tc->RemovalEvent();
 		}
 
-	for ( const auto& entry : udp_conns )
+	for ( Connection* uc : sorted_conns(udp_conns) )
 		{
-		Connection* uc = entry.second;
 		uc->Done();
 		uc->RemovalEvent();
 		}
 
-	for ( const auto& entry : icmp_conns )
+	for ( Connection* ic : sorted_conns(icmp_conns) )
 		{
-		Connection* ic = entry.second;
 		ic->Done();
 		ic->RemovalEvent();
 		}
+
+	udp_flows.Drain();
+	icmp_flows.Drain();
+
+	ExpireDeferredSyns(run_state::network_time, true);
 	}
 
 void NetSessions::Clear()
 	{
 	for ( const auto& entry : tcp_conns )
-		Unref(entry.second);
+		Unref(entry.conn);
 	for ( const auto& entry : udp_conns )
-		Unref(entry.second);
+		Unref(entry.conn);
 	for ( const auto& entry : icmp_conns )
-		Unref(entry.second);
+		Unref(entry.conn);
+
+	tcp_conns.Clear();
+	udp_conns.Clear();
+	icmp_conns.Clear();
 
-	tcp_conns.clear();
-	udp_conns.clear();
-	icmp_conns.clear();
+	udp_flows.Clear();
+	icmp_flows.Clear();
+
+	syn_table.Clear();
 
 	detail::fragment_mgr->Clear();
 	}
 
 void NetSessions::GetStats(SessionStats& s) const
 	{
-	s.num_TCP_conns = tcp_conns.size();
+	s.num_TCP_conns = tcp_conns.Size();
 	s.cumulative_TCP_conns = stats.cumulative_TCP_conns;
-	s.num_UDP_conns = udp_conns.size();
+	s.num_UDP_conns = udp_conns.Size();
 	s.cumulative_UDP_conns = stats.cumulative_UDP_conns;
-	s.num_ICMP_conns = icmp_conns.size();
+	s.num_ICMP_conns = icmp_conns.Size();
 	s.cumulative_ICMP_conns = stats.cumulative_ICMP_conns;
 	s.num_fragments = detail::fragment_mgr->Size();
 	s.num_packets = packet_mgr->PacketsProcessed();
@@ -538,6 +828,29 @@ void NetSessions::GetStats(SessionStats& s) const
 	s.max_UDP_conns = stats.max_UDP_conns;
 	s.max_ICMP_conns = stats.max_ICMP_conns;
 	s.max_fragments = detail::fragment_mgr->MaxFragments();
+
+	s.num_shed_packets = stats.num_shed_packets;
+	s.num_shed_bytes = stats.num_shed_bytes;
+
+	s.num_conn_buckets = 0;
+	s.max_conn_probe_len = 0;
+
+	size_t num_entries = 0;
+	double total_probe_len = 0;
+
+	for ( const auto* m : { &tcp_conns, &udp_conns, &icmp_conns } )
+		{
+		auto ms = m->GetStats();
+		s.num_conn_buckets += ms.buckets;
+		num_entries += ms.entries;
+		total_probe_len += ms.avg_probe_len * ms.entries;
+
+		if ( ms.max_probe_len > s.max_conn_probe_len )
+			s.max_conn_probe_len = ms.max_probe_len;
+		}
+
+	s.conn_bucket_load = s.num_conn_buckets ? double(num_entries) / s.num_conn_buckets : 0.0;
+	s.avg_conn_probe_len = num_entries ? total_probe_len / num_entries : 0.0;
 	}
 
 Connection* NetSessions::NewConn(const detail::ConnIDKey& k, double t, const ConnID* id,
@@ -594,6 +907,8 @@ Connection* NetSessions::NewConn(const detail::ConnIDKey& k, double t, const Con
 		return nullptr;
 		}
 
+	conn->EnableCompactionTimer();
+
 	if ( new_connection )
 		conn->Event(new_connection, nullptr);
 
@@ -602,11 +917,7 @@ Connection* NetSessions::NewConn(const detail::ConnIDKey& k, double t, const Con
 
 Connection* NetSessions::LookupConn(const ConnectionMap& conns, const detail::ConnIDKey& key)
 	{
-	auto it = conns.find(key);
-	if ( it != conns.end() )
-		return it->second;
-
-	return nullptr;
+	return conns.Lookup(key);
 	}
 
 bool NetSessions::IsLikelyServerPort(uint32_t port, TransportProto proto) const
@@ -709,6 +1020,18 @@ void NetSessions::Weird(const char* name, const IP_Hdr* ip, const char* addl)
 	reporter->Weird(ip->SrcAddr(), ip->DstAddr(), name, addl);
 	}
 
+void NetSessions::VisitConnections(const std::function<void(Connection*)>& f)
+	{
+	for ( const auto& entry : tcp_conns )
+		f(entry.conn);
+
+	for ( const auto& entry : udp_conns )
+		f(entry.conn);
+
+	for ( const auto& entry : icmp_conns )
+		f(entry.conn);
+	}
+
 unsigned int NetSessions::ConnectionMemoryUsage()
 	{
 	unsigned int mem = 0;
@@ -718,13 +1041,13 @@ unsigned int NetSessions::ConnectionMemoryUsage()
 		return 0;
 
 	for ( const auto& entry : tcp_conns )
-		mem += entry.second->MemoryAllocation();
+		mem += entry.conn->MemoryAllocation();
 
 	for ( const auto& entry : udp_conns )
-		mem += entry.second->MemoryAllocation();
+		mem += entry.conn->MemoryAllocation();
 
 	for ( const auto& entry : icmp_conns )
-		mem += entry.second->MemoryAllocation();
+		mem += entry.conn->MemoryAllocation();
 
 	return mem;
 	}
@@ -738,13 +1061,13 @@ unsigned int NetSessions::ConnectionMemoryUsageConnVals()
 		return 0;
 
 	for ( const auto& entry : tcp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+		mem += entry.conn->MemoryAllocationConnVal();
 
 	for ( const auto& entry : udp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+		mem += entry.conn->MemoryAllocationConnVal();
 
 	for ( const auto& entry : icmp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+		mem += entry.conn->MemoryAllocationConnVal();
 
 	return mem;
 	}
@@ -757,9 +1080,12 @@ unsigned int NetSessions::MemoryAllocation()
 
 	return ConnectionMemoryUsage()
 		+ padded_sizeof(*this)
-		+ (tcp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
-		+ (udp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
-		+ (icmp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
+		+ tcp_conns.MemoryAllocation()
+		+ udp_conns.MemoryAllocation()
+		+ icmp_conns.MemoryAllocation()
+		+ udp_flows.MemoryAllocation()
+		+ icmp_flows.MemoryAllocation()
+		+ syn_table.MemoryAllocation()
 		+ detail::fragment_mgr->MemoryAllocation();
 		// FIXME: MemoryAllocation() not implemented for rest.
 		;
@@ -767,24 +1093,24 @@ unsigned int NetSessions::MemoryAllocation()
 
 void NetSessions::InsertConnection(ConnectionMap* m, const detail::ConnIDKey& key, Connection* conn)
 	{
-	(*m)[key] = conn;
+	m->Insert(key, conn);
 
 	switch ( conn->ConnTransport() )
 		{
 		case TRANSPORT_TCP:
 			stats.cumulative_TCP_conns++;
-			if ( m->size() > stats.max_TCP_conns )
-				stats.max_TCP_conns = m->size();
+			if ( m->Size() > stats.max_TCP_conns )
+				stats.max_TCP_conns = m->Size();
 			break;
 		case TRANSPORT_UDP:
 			stats.cumulative_UDP_conns++;
-			if ( m->size() > stats.max_UDP_conns )
-				stats.max_UDP_conns = m->size();
+			if ( m->Size() > stats.max_UDP_conns )
+				stats.max_UDP_conns = m->Size();
 			break;
 		case TRANSPORT_ICMP:
 			stats.cumulative_ICMP_conns++;
-			if ( m->size() > stats.max_ICMP_conns )
-				stats.max_ICMP_conns = m->size();
+			if ( m->Size() > stats.max_ICMP_conns )
+				stats.max_ICMP_conns = m->Size();
 			break;
 		default: break;
 		}
@@ -2,12 +2,15 @@
 
 #pragma once
 
+#include "ConnectionMap.h"
+#include "FlowTable.h"
 #include "Frag.h"
 #include "PacketFilter.h"
+#include "SynTable.h"
 #include "NetVar.h"
 #include "analyzer/protocol/tcp/Stats.h"
 
-#include <map>
+#include <functional>
 #include <utility>
 
 #include <sys/types.h> // for u_char
@@ -40,6 +43,17 @@ struct SessionStats {
 	size_t num_fragments;
 	size_t max_fragments;
 	uint64_t num_packets;
+
+	// Layout of the connection hash tables, summed over TCP, UDP and
+	// ICMP.
+	size_t num_conn_buckets;
+	double conn_bucket_load;	// Fraction of buckets in use.
+	double avg_conn_probe_len;
+	size_t max_conn_probe_len;
+
+	// Packets without connection dropped by flow shedding.
+	uint64_t num_shed_packets;
+	uint64_t num_shed_bytes;
 };
 
 class NetSessions {
@@ -86,7 +100,7 @@ public:
 
 	unsigned int CurrentConnections()
 		{
-		return tcp_conns.size() + udp_conns.size() + icmp_conns.size();
+		return tcp_conns.Size() + udp_conns.Size() + icmp_conns.Size();
 		}
 
 	/**
@@ -101,6 +115,16 @@ public:
 	 */
 	void ProcessTransportLayer(double t, const Packet *pkt, size_t len);
 
+	/**
+	 * Prefetches the connection table bucket for a TCP or UDP packet ahead
+	 * of processing it, see the prefetch_connections option. Fragments and
+	 * IPv6 packets with extension headers get skipped.
+	 *
+	 * @param ip The packet's raw IP header.
+	 * @param len The number of bytes available from \a ip on.
+	 */
+	void PrefetchConnection(const u_char* ip, size_t len) const;
+
 	/**
 	 * Returns a wrapper IP_Hdr object if \a pkt appears to be a valid IPv4
 	 * or IPv6 header based on whether it's long enough to contain such a header,
@@ -126,6 +150,9 @@ public:
 	int ParseIPPacket(int caplen, const u_char* const pkt, int proto,
 	                  IP_Hdr*& inner);
 
+	// Calls a function for each current connection.
+	void VisitConnections(const std::function<void(Connection*)>& f);
+
 	unsigned int ConnectionMemoryUsage();
 	unsigned int ConnectionMemoryUsageConnVals();
 	unsigned int MemoryAllocation();
@@ -134,7 +161,7 @@ public:
 protected:
 	friend class ConnCompressor;
 
-	using ConnectionMap = std::map<detail::ConnIDKey, Connection*>;
+	using ConnectionMap = detail::ConnectionMap;
 
 	Connection* NewConn(const detail::ConnIDKey& k, double t, const ConnID* id,
 	                    const u_char* data, int proto, uint32_t flow_label,
@@ -164,6 +191,30 @@ protected:
 	// than that protocol's minimum header size.
 	bool CheckHeaderTrunc(int proto, uint32_t len, uint32_t caplen, const Packet *pkt);
 
+	// Handles a UDP or ICMP packet through a compact flow record if
+	// flow_only_udp_icmp permits. Returns false if the packet needs a full
+	// connection instead, having removed any flow record for it by then.
+	bool ProcessFlowOnly(double t, const Packet* pkt, const detail::ConnIDKey& key,
+	                     const ConnID& id, TransportProto proto);
+
+	// Handles a TCP packet without connection if tcp_defer_syn permits,
+	// recording a bare SYN in the SYN table. Returns false if the packet
+	// needs a full connection; for a handshake found in the table that
+	// connection then exists already, built from the recorded SYN.
+	bool ProcessDeferredSyn(double t, const Packet* pkt, const detail::ConnIDKey& key,
+	                        const u_char* data, uint32_t len);
+
+	// Checks whether a packet without connection belongs to a new flow to
+	// shed, per flow_shedding_fraction and flow_shedding_ports, because
+	// packet processing lags too far behind. Counts the packet if so.
+	bool ShedNewFlow(const Packet* pkt, const detail::ConnIDKey& key,
+	                 const ConnID& id, TransportProto proto);
+
+	// Drops the handshakes in the SYN table that have been waiting for
+	// longer than tcp_SYN_timeout, or all of them if \a all, and reports
+	// them through tcp_unanswered_syns.
+	void ExpireDeferredSyns(double t, bool all = false);
+
 	// Inserts a new connection into the sessions map. If a connection with
 	// the same key already exists in the map, it will be overwritten by
 	// the new one.  Connection count stats get updated either way (so most
@@ -175,6 +226,15 @@ protected:
 	ConnectionMap udp_conns;
 	ConnectionMap icmp_conns;
 
+	detail::FlowTable udp_flows;
+	detail::FlowTable icmp_flows;
+
+	detail::SynTable syn_table;
+	double next_syn_expiration = 0.0;
+	bool replaying_syn = false;
+
+	bool shedding = false;
+
 	SessionStats stats;
 
 	analyzer::stepping_stone::SteppingStoneManager* stp_manager;
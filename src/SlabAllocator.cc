@@ -0,0 +1,122 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "SlabAllocator.h"
+
+#include <cstdlib>
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::detail {
+
+static_assert(SlabAllocator::MAX_SIZE == SlabAllocator::MIN_SIZE << 8,
+              "NUM_CLASSES doesn't match the size range");
+
+SlabAllocator::~SlabAllocator()
+	{
+	for ( auto s : slabs )
+		free(s);
+	}
+
+SlabAllocator& SlabAllocator::ForThread()
+	{
+	static thread_local SlabAllocator allocator;
+	return allocator;
+	}
+
+int SlabAllocator::SizeClass(size_t size)
+	{
+	int c = 0;
+
+	for ( size_t s = MIN_SIZE; s < size; s <<= 1 )
+		++c;
+
+	return c;
+	}
+
+void SlabAllocator::Refill(int c)
+	{
+	size_t obj_size = MIN_SIZE << c;
+	auto slab = static_cast<char*>(malloc(SLAB_SIZE));
+
+	if ( ! slab )
+		throw std::bad_alloc();
+
+	slabs.push_back(slab);
+	slab_bytes += SLAB_SIZE;
+
+	// Thread the new objects onto the free list in address order.
+	for ( size_t off = SLAB_SIZE; off >= obj_size; off -= obj_size )
+		{
+		auto obj = reinterpret_cast<FreeObj*>(slab + off - obj_size);
+		obj->next = free_lists[c];
+		free_lists[c] = obj;
+		}
+	}
+
+void* SlabAllocator::Allocate(size_t size)
+	{
+	if ( size > MAX_SIZE )
+		return ::operator new(size);
+
+	int c = SizeClass(size);
+
+	if ( ! free_lists[c] )
+		Refill(c);
+
+	auto obj = free_lists[c];
+	free_lists[c] = obj->next;
+	bytes_in_use += MIN_SIZE << c;
+
+	return obj;
+	}
+
+void SlabAllocator::Free(void* p, size_t size)
+	{
+	if ( ! p )
+		return;
+
+	if ( size > MAX_SIZE )
+		{
+		::operator delete(p);
+		return;
+		}
+
+	int c = SizeClass(size);
+	auto obj = static_cast<FreeObj*>(p);
+	obj->next = free_lists[c];
+	free_lists[c] = obj;
+	bytes_in_use -= MIN_SIZE << c;
+	}
+
+TEST_CASE("slab allocator")
+	{
+	SlabAllocator a;
+
+	auto p1 = a.Allocate(1);
+	auto p2 = a.Allocate(16);
+	CHECK(p1 != p2);
+	CHECK(a.BytesInUse() == 32);
+	CHECK(a.SlabBytes() == SlabAllocator::SLAB_SIZE);
+
+	a.Free(p2, 16);
+	CHECK(a.Allocate(10) == p2);
+
+	auto p3 = a.Allocate(1000);
+	CHECK(reinterpret_cast<uintptr_t>(p3) % alignof(std::max_align_t) == 0);
+	CHECK(a.BytesInUse() == 32 + 1024);
+	CHECK(a.SlabBytes() == 2 * SlabAllocator::SLAB_SIZE);
+
+	auto big = a.Allocate(SlabAllocator::MAX_SIZE + 1);
+	CHECK(a.BytesInUse() == 32 + 1024);
+
+	a.Free(big, SlabAllocator::MAX_SIZE + 1);
+	a.Free(p3, 1000);
+	a.Free(p2, 10);
+	a.Free(p1, 1);
+	CHECK(a.BytesInUse() == 0);
+	CHECK(a.SlabBytes() == 2 * SlabAllocator::SLAB_SIZE);
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,118 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * Hands out memory of small sizes from large slabs, with one free list per
+ * power-of-two size class. Freed memory goes back onto its free list for
+ * reuse rather than to the system, so a workload that keeps allocating and
+ * freeing similar sizes (such as reassembly buffering segments) settles at
+ * a stable footprint without fragmenting the heap. Requests above the
+ * largest size class go straight to the heap.
+ *
+ * An allocator isn't thread-safe; use \a ForThread() to get the calling
+ * thread's own one.
+ */
+class SlabAllocator {
+public:
+	SlabAllocator() = default;
+	~SlabAllocator();
+
+	SlabAllocator(const SlabAllocator&) = delete;
+	SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+	/**
+	 * Returns the calling thread's allocator.
+	 */
+	static SlabAllocator& ForThread();
+
+	/**
+	 * Returns memory for the given number of bytes, suitably aligned for
+	 * any type.
+	 */
+	void* Allocate(size_t size);
+
+	/**
+	 * Returns memory to the allocator. The size has to be the one passed
+	 * to \a Allocate() for it.
+	 */
+	void Free(void* p, size_t size);
+
+	/**
+	 * Returns the number of bytes currently held in slabs, whether in use
+	 * or not.
+	 */
+	uint64_t SlabBytes() const	{ return slab_bytes; }
+
+	/**
+	 * Returns the number of bytes currently handed out, counting each
+	 * allocation at its full size class.
+	 */
+	uint64_t BytesInUse() const	{ return bytes_in_use; }
+
+	static constexpr size_t MIN_SIZE = 16;
+	static constexpr size_t MAX_SIZE = 4096;
+	static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+private:
+	static constexpr int NUM_CLASSES = 9;	// 16 bytes through 4 KB
+
+	struct FreeObj {
+		FreeObj* next;
+	};
+
+	static int SizeClass(size_t size);
+	void Refill(int c);
+
+	FreeObj* free_lists[NUM_CLASSES] = { };
+	std::vector<void*> slabs;
+	uint64_t slab_bytes = 0;
+	uint64_t bytes_in_use = 0;
+};
+
+/**
+ * An allocator for standard containers that takes single objects from the
+ * calling thread's \a SlabAllocator, which suits node-based ones such as
+ * std::map.
+ */
+template <typename T>
+class SlabStdAllocator {
+public:
+	using value_type = T;
+
+	SlabStdAllocator() = default;
+
+	template <typename U>
+	SlabStdAllocator(const SlabStdAllocator<U>&)	{ }
+
+	T* allocate(size_t n)
+		{
+		if ( n == 1 )
+			return static_cast<T*>(SlabAllocator::ForThread().Allocate(sizeof(T)));
+
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+		}
+
+	void deallocate(T* p, size_t n)
+		{
+		if ( n == 1 )
+			SlabAllocator::ForThread().Free(p, sizeof(T));
+		else
+			::operator delete(p);
+		}
+
+	template <typename U>
+	bool operator==(const SlabStdAllocator<U>&) const	{ return true; }
+
+	template <typename U>
+	bool operator!=(const SlabStdAllocator<U>&) const	{ return false; }
+};
+
+} // namespace zeek::detail
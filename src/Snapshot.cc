@@ -0,0 +1,751 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Snapshot.h"
+#include "3rdparty/doctest.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+#include "Attr.h"
+#include "ID.h"
+#include "Scope.h"
+#include "Val.h"
+#include "Reporter.h"
+#include "RunState.h"
+#include "Timer.h"
+#include "broker/Data.h"
+
+namespace zeek::detail {
+
+Snapshot* snapshot = nullptr;
+
+static constexpr char MAGIC[] = "ZEEKSNAP";
+static constexpr size_t MAGIC_LEN = sizeof(MAGIC) - 1;
+static constexpr uint8_t FORMAT_VERSION = 1;
+
+// Corrupt files mustn't run the decoder out of stack.
+static constexpr int MAX_DEPTH = 128;
+
+// The encoding's tags for the alternatives of broker::data.
+enum DataTag : uint8_t {
+	TAG_NONE, TAG_BOOL, TAG_COUNT, TAG_INTEGER, TAG_REAL, TAG_STRING,
+	TAG_ADDRESS, TAG_SUBNET, TAG_PORT, TAG_TIMESTAMP, TAG_TIMESPAN,
+	TAG_ENUM, TAG_SET, TAG_TABLE, TAG_VECTOR,
+};
+
+class SnapshotTimer final : public Timer {
+public:
+	SnapshotTimer(double t, Snapshot* arg_owner, double arg_interval)
+		: Timer(t, TIMER_SNAPSHOT)
+		{
+		owner = arg_owner;
+		interval = arg_interval;
+		}
+
+	void Dispatch(double t, bool is_expire) override
+		{
+		if ( is_expire )
+			return;
+
+		owner->Write();
+		timer_mgr->Add(new SnapshotTimer(run_state::network_time + interval,
+		                                 owner, interval));
+		}
+
+protected:
+	Snapshot* owner;
+	double interval;
+};
+
+static void put_varint(std::string* out, uint64_t n)
+	{
+	while ( n >= 0x80 )
+		{
+		out->push_back(static_cast<char>(n | 0x80));
+		n >>= 7;
+		}
+
+	out->push_back(static_cast<char>(n));
+	}
+
+static void put_fixed(std::string* out, uint64_t n)
+	{
+	for ( int i = 0; i < 8; ++i )
+		out->push_back(static_cast<char>(n >> (8 * i)));
+	}
+
+static void put_bytes(std::string* out, const void* data, size_t len)
+	{
+	put_varint(out, len);
+	out->append(static_cast<const char*>(data), len);
+	}
+
+struct data_encoder {
+	using result_type = void;
+
+	std::string* out;
+
+	void Tag(DataTag t)
+		{ out->push_back(static_cast<char>(t)); }
+
+	result_type operator()(broker::none)
+		{ Tag(TAG_NONE); }
+
+	result_type operator()(bool a)
+		{
+		Tag(TAG_BOOL);
+		out->push_back(a ? 1 : 0);
+		}
+
+	result_type operator()(uint64_t a)
+		{
+		Tag(TAG_COUNT);
+		put_varint(out, a);
+		}
+
+	result_type operator()(int64_t a)
+		{
+		Tag(TAG_INTEGER);
+		put_varint(out, (static_cast<uint64_t>(a) << 1) ^ static_cast<uint64_t>(a >> 63));
+		}
+
+	result_type operator()(double a)
+		{
+		uint64_t bits;
+		memcpy(&bits, &a, sizeof(bits));
+		Tag(TAG_REAL);
+		put_fixed(out, bits);
+		}
+
+	result_type operator()(const std::string& a)
+		{
+		Tag(TAG_STRING);
+		put_bytes(out, a.data(), a.size());
+		}
+
+	result_type operator()(const broker::address& a)
+		{
+		Tag(TAG_ADDRESS);
+		out->append(reinterpret_cast<const char*>(a.bytes().data()), a.bytes().size());
+		}
+
+	result_type operator()(const broker::subnet& a)
+		{
+		const auto& bytes = a.network().bytes();
+		Tag(TAG_SUBNET);
+		out->append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		out->push_back(static_cast<char>(a.length()));
+		}
+
+	result_type operator()(const broker::port& a)
+		{
+		Tag(TAG_PORT);
+		put_varint(out, a.number());
+		out->push_back(static_cast<char>(a.type()));
+		}
+
+	result_type operator()(const broker::timestamp& a)
+		{
+		Tag(TAG_TIMESTAMP);
+		put_fixed(out, static_cast<uint64_t>(a.time_since_epoch().count()));
+		}
+
+	result_type operator()(const broker::timespan& a)
+		{
+		Tag(TAG_TIMESPAN);
+		put_fixed(out, static_cast<uint64_t>(a.count()));
+		}
+
+	result_type operator()(const broker::enum_value& a)
+		{
+		Tag(TAG_ENUM);
+		put_bytes(out, a.name.data(), a.name.size());
+		}
+
+	result_type operator()(const broker::set& a)
+		{
+		Tag(TAG_SET);
+		put_varint(out, a.size());
+
+		for ( const auto& e : a )
+			caf::visit(*this, e);
+		}
+
+	result_type operator()(const broker::table& a)
+		{
+		Tag(TAG_TABLE);
+		put_varint(out, a.size());
+
+		for ( const auto& [k, v] : a )
+			{
+			caf::visit(*this, k);
+			caf::visit(*this, v);
+			}
+		}
+
+	result_type operator()(const broker::vector& a)
+		{
+		Tag(TAG_VECTOR);
+		put_varint(out, a.size());
+
+		for ( const auto& e : a )
+			caf::visit(*this, e);
+		}
+};
+
+class DataDecoder {
+public:
+	DataDecoder(const char* data, size_t len)
+		: p(reinterpret_cast<const uint8_t*>(data)), end(p + len)
+		{}
+
+	bool AtEnd() const	{ return p == end; }
+
+	bool Bytes(size_t n, const char** b)
+		{
+		if ( static_cast<size_t>(end - p) < n )
+			return false;
+
+		*b = reinterpret_cast<const char*>(p);
+		p += n;
+		return true;
+		}
+
+	bool Varint(uint64_t* n)
+		{
+		*n = 0;
+
+		for ( int shift = 0; shift < 64; shift += 7 )
+			{
+			if ( p == end )
+				return false;
+
+			uint8_t b = *p++;
+			*n |= static_cast<uint64_t>(b & 0x7f) << shift;
+
+			if ( ! (b & 0x80) )
+				return true;
+			}
+
+		return false;
+		}
+
+	bool Fixed(uint64_t* n)
+		{
+		const char* b;
+
+		if ( ! Bytes(8, &b) )
+			return false;
+
+		*n = 0;
+
+		for ( int i = 0; i < 8; ++i )
+			*n |= static_cast<uint64_t>(static_cast<uint8_t>(b[i])) << (8 * i);
+
+		return true;
+		}
+
+	bool String(std::string* s)
+		{
+		uint64_t len;
+		const char* b;
+
+		if ( ! Varint(&len) || ! Bytes(len, &b) )
+			return false;
+
+		s->assign(b, len);
+		return true;
+		}
+
+	bool Address(broker::address* a)
+		{
+		const char* b;
+
+		if ( ! Bytes(16, &b) )
+			return false;
+
+		uint32_t bits[4];
+		memcpy(bits, b, sizeof(bits));
+		*a = broker::address(bits, broker::address::family::ipv6,
+		                     broker::address::byte_order::network);
+		return true;
+		}
+
+	bool Data(broker::data* d, int depth = 0);
+
+private:
+	const uint8_t* p;
+	const uint8_t* end;
+};
+
+bool DataDecoder::Data(broker::data* d, int depth)
+	{
+	const char* tag;
+	uint64_t n;
+
+	if ( depth > MAX_DEPTH || ! Bytes(1, &tag) )
+		return false;
+
+	switch ( static_cast<uint8_t>(*tag) ) {
+	case TAG_NONE:
+		*d = broker::none{};
+		return true;
+
+	case TAG_BOOL:
+		{
+		const char* b;
+
+		if ( ! Bytes(1, &b) )
+			return false;
+
+		*d = (*b != 0);
+		return true;
+		}
+
+	case TAG_COUNT:
+		if ( ! Varint(&n) )
+			return false;
+
+		*d = broker::count(n);
+		return true;
+
+	case TAG_INTEGER:
+		if ( ! Varint(&n) )
+			return false;
+
+		*d = static_cast<broker::integer>((n >> 1) ^ (~(n & 1) + 1));
+		return true;
+
+	case TAG_REAL:
+		{
+		double r;
+
+		if ( ! Fixed(&n) )
+			return false;
+
+		memcpy(&r, &n, sizeof(r));
+		*d = r;
+		return true;
+		}
+
+	case TAG_STRING:
+		{
+		std::string s;
+
+		if ( ! String(&s) )
+			return false;
+
+		*d = std::move(s);
+		return true;
+		}
+
+	case TAG_ADDRESS:
+		{
+		broker::address a;
+
+		if ( ! Address(&a) )
+			return false;
+
+		*d = std::move(a);
+		return true;
+		}
+
+	case TAG_SUBNET:
+		{
+		broker::address a;
+		const char* len;
+
+		if ( ! Address(&a) || ! Bytes(1, &len) )
+			return false;
+
+		*d = broker::subnet(std::move(a), static_cast<uint8_t>(*len));
+		return true;
+		}
+
+	case TAG_PORT:
+		{
+		const char* proto;
+
+		if ( ! Varint(&n) || n > 0xffff || ! Bytes(1, &proto) )
+			return false;
+
+		*d = broker::port(static_cast<uint16_t>(n),
+		                  static_cast<broker::port::protocol>(*proto));
+		return true;
+		}
+
+	case TAG_TIMESTAMP:
+		if ( ! Fixed(&n) )
+			return false;
+
+		*d = broker::timestamp(broker::timespan(static_cast<int64_t>(n)));
+		return true;
+
+	case TAG_TIMESPAN:
+		if ( ! Fixed(&n) )
+			return false;
+
+		*d = broker::timespan(static_cast<int64_t>(n));
+		return true;
+
+	case TAG_ENUM:
+		{
+		std::string s;
+
+		if ( ! String(&s) )
+			return false;
+
+		*d = broker::enum_value(std::move(s));
+		return true;
+		}
+
+	case TAG_SET:
+		{
+		broker::set s;
+
+		if ( ! Varint(&n) )
+			return false;
+
+		while ( n-- )
+			{
+			broker::data e;
+
+			if ( ! Data(&e, depth + 1) )
+				return false;
+
+			s.insert(std::move(e));
+			}
+
+		*d = std::move(s);
+		return true;
+		}
+
+	case TAG_TABLE:
+		{
+		broker::table t;
+
+		if ( ! Varint(&n) )
+			return false;
+
+		while ( n-- )
+			{
+			broker::data k;
+			broker::data v;
+
+			if ( ! Data(&k, depth + 1) || ! Data(&v, depth + 1) )
+				return false;
+
+			t.emplace(std::move(k), std::move(v));
+			}
+
+		*d = std::move(t);
+		return true;
+		}
+
+	case TAG_VECTOR:
+		{
+		broker::vector v;
+
+		// Each element takes at least a byte, which keeps a corrupt
+		// size from reserving a lot of memory.
+		if ( ! Varint(&n) || n > static_cast<uint64_t>(end - p) )
+			return false;
+
+		v.reserve(n);
+
+		while ( n-- )
+			{
+			broker::data e;
+
+			if ( ! Data(&e, depth + 1) )
+				return false;
+
+			v.emplace_back(std::move(e));
+			}
+
+		*d = std::move(v);
+		return true;
+		}
+	}
+
+	return false;
+	}
+
+Snapshot::Snapshot(std::string arg_path, double arg_interval)
+	: path(std::move(arg_path)), interval(arg_interval)
+	{
+	}
+
+Snapshot::~Snapshot()
+	{
+	if ( writer.joinable() )
+		{
+			{
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+			}
+
+		cv.notify_one();
+		writer.join();
+		}
+	}
+
+std::string Snapshot::Encode(const Entries& entries)
+	{
+	std::string out(MAGIC, MAGIC_LEN);
+	out.push_back(static_cast<char>(FORMAT_VERSION));
+	put_varint(&out, entries.size());
+
+	data_encoder enc{&out};
+
+	for ( const auto& [name, d] : entries )
+		{
+		put_bytes(&out, name.data(), name.size());
+		caf::visit(enc, d);
+		}
+
+	return out;
+	}
+
+bool Snapshot::Decode(const char* data, size_t len, Entries* entries)
+	{
+	DataDecoder dec(data, len);
+	const char* header;
+	uint64_t n;
+
+	if ( ! dec.Bytes(MAGIC_LEN + 1, &header) ||
+	     memcmp(header, MAGIC, MAGIC_LEN) != 0 ||
+	     static_cast<uint8_t>(header[MAGIC_LEN]) != FORMAT_VERSION ||
+	     ! dec.Varint(&n) )
+		return false;
+
+	while ( n-- )
+		{
+		std::string name;
+		broker::data d;
+
+		if ( ! dec.String(&name) || ! dec.Data(&d) )
+			return false;
+
+		entries->emplace_back(std::move(name), std::move(d));
+		}
+
+	return dec.AtEnd();
+	}
+
+void Snapshot::Restore()
+	{
+	if ( interval > 0 )
+		timer_mgr->Add(new SnapshotTimer(run_state::network_time + interval,
+		                                 this, interval));
+
+	int fd = open(path.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		if ( errno != ENOENT )
+			reporter->Error("can't open snapshot file %s: %s", path.c_str(), strerror(errno));
+
+		return;
+		}
+
+	struct stat st;
+	Entries entries;
+	bool valid = false;
+
+	if ( fstat(fd, &st) == 0 && st.st_size > 0 )
+		{
+		void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if ( data != MAP_FAILED )
+			{
+			valid = Decode(static_cast<const char*>(data), st.st_size, &entries);
+			munmap(data, st.st_size);
+			}
+		}
+
+	close(fd);
+
+	if ( ! valid )
+		{
+		reporter->Error("snapshot file %s is invalid, not restoring it", path.c_str());
+		return;
+		}
+
+	for ( auto& [name, d] : entries )
+		{
+		const auto& id = global_scope()->Find(name);
+
+		if ( ! id || ! id->GetAttr(ATTR_PERSISTENT) )
+			{
+			reporter->Warning("snapshot file %s: %s is not a persistent global anymore",
+			                  path.c_str(), name.c_str());
+			continue;
+			}
+
+		auto v = Broker::detail::data_to_val(std::move(d), id->GetType().get());
+
+		if ( ! v )
+			{
+			reporter->Warning("snapshot file %s: type of %s has changed, not restoring it",
+			                  path.c_str(), name.c_str());
+			continue;
+			}
+
+		// Tables keep their attributes and what zeek_init has put
+		// into them.
+		const auto& cur = id->GetVal();
+
+		if ( cur && cur->GetType()->Tag() == TYPE_TABLE )
+			v->AddTo(cur.get(), false);
+		else
+			id->SetVal(std::move(v));
+		}
+	}
+
+void Snapshot::Write()
+	{
+	auto entries = std::make_unique<Entries>();
+
+	for ( const auto& [name, id] : global_scope()->Vars() )
+		{
+		if ( ! id->GetAttr(ATTR_PERSISTENT) || ! id->GetVal() )
+			continue;
+
+		auto d = Broker::detail::val_to_data(id->GetVal().get());
+
+		if ( ! d )
+			{
+			reporter->Warning("can't snapshot %s: unsupported value", name.c_str());
+			continue;
+			}
+
+		entries->emplace_back(name, std::move(*d));
+		}
+
+	if ( int err = write_errno.exchange(0) )
+		reporter->Error("can't write snapshot file %s: %s", path.c_str(), strerror(err));
+
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending = std::move(entries);
+		}
+
+	if ( ! writer.joinable() )
+		writer = std::thread(&Snapshot::Run, this);
+
+	cv.notify_one();
+	}
+
+void Snapshot::Terminate()
+	{
+	Write();
+
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+		}
+
+	cv.notify_one();
+	writer.join();
+
+	if ( int err = write_errno.exchange(0) )
+		reporter->Error("can't write snapshot file %s: %s", path.c_str(), strerror(err));
+	}
+
+void Snapshot::Run()
+	{
+	for ( ;; )
+		{
+		std::unique_ptr<Entries> entries;
+
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [this] { return pending || done; });
+
+			if ( ! pending )
+				return;
+
+			entries = std::move(pending);
+			}
+
+		WriteFile(Encode(*entries));
+		}
+	}
+
+void Snapshot::WriteFile(const std::string& data)
+	{
+	// Readers must never see a partial snapshot.
+	auto tmp = path + ".tmp";
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+	if ( fd < 0 )
+		{
+		write_errno = errno;
+		return;
+		}
+
+	size_t written = 0;
+
+	while ( written < data.size() )
+		{
+		auto rc = write(fd, data.data() + written, data.size() - written);
+
+		if ( rc < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			write_errno = errno;
+			close(fd);
+			unlink(tmp.c_str());
+			return;
+			}
+
+		written += rc;
+		}
+
+	int rc = fsync(fd);
+
+	if ( close(fd) != 0 )
+		rc = -1;
+
+	if ( rc != 0 || rename(tmp.c_str(), path.c_str()) != 0 )
+		{
+		write_errno = errno;
+		unlink(tmp.c_str());
+		}
+	}
+
+} // namespace zeek::detail
+
+TEST_CASE("snapshot encoding")
+	{
+	using zeek::detail::Snapshot;
+
+	broker::table t;
+	t.emplace(std::string("a"), broker::count(1));
+	t.emplace(std::string("b"), broker::count(300));
+
+	broker::vector v{broker::integer(-5), 2.5, true, broker::none{},
+	                 broker::port(80, broker::port::protocol::tcp),
+	                 broker::enum_value("Foo::BAR"), broker::timespan(1500)};
+
+	Snapshot::Entries in{{"t", t}, {"v", v}, {"s", broker::set{std::string("x")}}};
+	auto encoded = Snapshot::Encode(in);
+
+	Snapshot::Entries out;
+	CHECK(Snapshot::Decode(encoded.data(), encoded.size(), &out));
+	CHECK(out == in);
+
+	out.clear();
+	CHECK_FALSE(Snapshot::Decode(encoded.data(), encoded.size() - 1, &out));
+
+	out.clear();
+	encoded[0] = 'X';
+	CHECK_FALSE(Snapshot::Decode(encoded.data(), encoded.size(), &out));
+	}
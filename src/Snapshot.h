@@ -0,0 +1,97 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <broker/data.hh>
+
+namespace zeek::detail {
+
+/**
+ * Keeps the values of globals declared with &persistent across restarts.
+ * Write() converts them to Broker data on the main thread and hands that
+ * to a background thread, which encodes it and replaces the snapshot file
+ * atomically. Restore() maps the file and assigns the values back to
+ * their globals.
+ *
+ * A snapshot is a header followed by one entry per global: its name and
+ * its value as Broker data, in a compact binary encoding.
+ */
+class Snapshot {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param path The snapshot file.
+	 *
+	 * @param interval If positive, how often to write a snapshot while
+	 * running, in seconds of network time.
+	 */
+	Snapshot(std::string path, double interval);
+	~Snapshot();
+
+	/**
+	 * Assigns the values in the snapshot file, if there is one, to their
+	 * globals. Called once zeek_init has been handled, and before
+	 * packet processing begins. Also starts the snapshot timer.
+	 */
+	void Restore();
+
+	/**
+	 * Queues a snapshot of the current values for the background thread.
+	 * If the previous one hasn't been written yet, this replaces it.
+	 */
+	void Write();
+
+	/**
+	 * Writes a final snapshot and waits until it's on disk.
+	 */
+	void Terminate();
+
+	using Entries = std::vector<std::pair<std::string, broker::data>>;
+
+	/**
+	 * Encodes a snapshot.
+	 */
+	static std::string Encode(const Entries& entries);
+
+	/**
+	 * Decodes a snapshot.
+	 *
+	 * @return False if the data isn't a valid snapshot.
+	 */
+	static bool Decode(const char* data, size_t len, Entries* entries);
+
+private:
+	// The background thread.
+	void Run();
+
+	// Writes the encoded snapshot to the file. Called by the background
+	// thread.
+	void WriteFile(const std::string& data);
+
+	std::string path;
+	double interval;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::unique_ptr<Entries> pending;	// Protected by mutex.
+	bool done = false;	// Protected by mutex.
+
+	// Set by the background thread when writing fails.
+	std::atomic<int> write_errno{0};
+};
+
+// Only set if snapshot_file is.
+extern Snapshot* snapshot;
+
+} // namespace zeek::detail
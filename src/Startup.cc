@@ -0,0 +1,101 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Startup.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "Reporter.h"
+
+namespace zeek::detail {
+
+void StartupProfiler::Phase(const char* name)
+	{
+	auto now = Clock::now();
+
+	if ( phase )
+		phases.push_back({phase, std::chrono::duration<double, std::milli>(now - phase_start).count()});
+	else if ( phases.empty() )
+		start = now;
+
+	phase = name;
+	phase_start = now;
+	}
+
+void StartupProfiler::Report(const char* file)
+	{
+	Phase(nullptr);
+
+	FILE* f = strcmp(file, "-") == 0 ? stderr : fopen(file, "w");
+
+	if ( ! f )
+		{
+		reporter->Error("Failed to open ZEEK_STARTUP_PROFILE_FILE destination '%s' for writing: %s",
+		                file, strerror(errno));
+		return;
+		}
+
+	double total = std::chrono::duration<double, std::milli>(phase_start - start).count();
+
+	fprintf(f, "# startup profile: phase, msecs, share of total\n");
+
+	for ( const auto& p : phases )
+		fprintf(f, "%-24s %10.3f %5.1f%%\n", p.name, p.msecs,
+		        total > 0 ? 100 * p.msecs / total : 0.0);
+
+	fprintf(f, "%-24s %10.3f\n", "total", total);
+
+	if ( f != stderr )
+		fclose(f);
+	}
+
+static void prefetch_files(const std::vector<std::string>& paths)
+	{
+	char buf[64 * 1024];
+
+	for ( const auto& path : paths )
+		{
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+		if ( fd < 0 )
+			continue;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+		// Reading rather than just advising the kernel makes this work
+		// where readahead hints get ignored.
+		for ( ;; )
+			{
+			auto n = read(fd, buf, sizeof(buf));
+
+			if ( n > 0 || (n < 0 && errno == EINTR) )
+				continue;
+
+			break;
+			}
+
+		close(fd);
+		}
+	}
+
+void FilePrefetcher::Prefetch(std::vector<std::string> paths)
+	{
+	if ( paths.empty() )
+		return;
+
+	threads.emplace_back([paths = std::move(paths)] { prefetch_files(paths); });
+	}
+
+void FilePrefetcher::Wait()
+	{
+	for ( auto& t : threads )
+		t.join();
+
+	threads.clear();
+	}
+
+} // namespace zeek::detail
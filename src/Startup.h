@@ -0,0 +1,76 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * Measures the time that Zeek's initialization spends in each of its
+ * phases. zeek-setup marks the start of each phase, and with the
+ * environment variable ZEEK_STARTUP_PROFILE_FILE set writes a report to
+ * that file once initialization is complete ("-" means stderr).
+ */
+class StartupProfiler {
+public:
+	/**
+	 * Ends the current phase and starts the next one.
+	 *
+	 * @param name The name of the new phase. Must remain valid.
+	 */
+	void Phase(const char* name);
+
+	/**
+	 * Ends the current phase and writes the report.
+	 *
+	 * @param file The report's destination.
+	 */
+	void Report(const char* file);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Entry {
+		const char* name;
+		double msecs;
+	};
+
+	Clock::time_point start;
+	Clock::time_point phase_start;
+	const char* phase = nullptr;
+	std::vector<Entry> phases;
+};
+
+/**
+ * Reads files in background threads to get them into the page cache
+ * before initialization needs them, such as plugins' shared libraries
+ * and signature files. Loading the files themselves has to remain
+ * serial because it modifies global state, but the disk reads don't
+ * need to wait for that.
+ */
+class FilePrefetcher {
+public:
+	~FilePrefetcher()	{ Wait(); }
+
+	/**
+	 * Starts reading a set of files in a new thread.
+	 *
+	 * @param paths The files' paths. Files that don't exist are skipped.
+	 */
+	void Prefetch(std::vector<std::string> paths);
+
+	/**
+	 * Waits for all reads to finish.
+	 */
+	void Wait();
+
+private:
+	std::vector<std::thread> threads;
+};
+
+} // namespace zeek::detail
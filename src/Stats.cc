@@ -11,11 +11,18 @@
 #include "DNS_Mgr.h"
 #include "Trigger.h"
 #include "threading/Manager.h"
+#include "logging/Manager.h"
 #include "broker/Manager.h"
 #include "input.h"
 #include "Func.h"
+#include "MemoryTag.h"
+#include "analyzer/Analyzer.h"
+
+zeek::detail::StageProfiler* zeek::detail::stage_profiler = nullptr;
+zeek::detail::AnalyzerAccounting* zeek::detail::analyzer_accounting = nullptr;
 
 uint64_t zeek::detail::killed_by_inactivity = 0;
+uint64_t zeek::detail::compacted_by_inactivity = 0;
 uint64_t& killed_by_inactivity = zeek::detail::killed_by_inactivity;
 
 uint64_t zeek::detail::tot_ack_events = 0;
@@ -174,9 +181,26 @@ void ProfileLogger::Log()
 	file->Write(util::fmt("%.06f Connections expired due to inactivity: %" PRIu64 "\n",
 	                      run_state::network_time, killed_by_inactivity));
 
+	file->Write(util::fmt("%.06f Connections compacted due to inactivity: %" PRIu64 "\n",
+	                      run_state::network_time, compacted_by_inactivity));
+
+	file->Write(util::fmt("%.06f Packets of new flows shed: %" PRIu64 " (%" PRIu64 "K)\n",
+	                      run_state::network_time, s.num_shed_packets,
+	                      s.num_shed_bytes / 1024));
+
 	file->Write(util::fmt("%.06f Total reassembler data: %" PRIu64 "K\n", run_state::network_time,
 	                      Reassembler::TotalMemoryAllocation() / 1024));
 
+	for ( int i = 0; i < static_cast<int>(MemoryTag::NumTags); ++i )
+		{
+		const auto& c = memory_tag_counters[i];
+		file->Write(util::fmt("%.06f Memory %s: %" PRIu64 "K (peak %" PRIu64 "K, %" PRIu64 " allocations)\n",
+		                      run_state::network_time,
+		                      memory_tag_name(static_cast<MemoryTag>(i)),
+		                      c.bytes.load() / 1024, c.peak_bytes.load() / 1024,
+		                      c.allocations.load()));
+		}
+
 	// Signature engine.
 	if ( expensive && rule_matcher )
 		{
@@ -234,6 +258,19 @@ void ProfileLogger::Log()
 			    ));
 		}
 
+	const auto& writer_stats = log_mgr->GetWriterStats();
+	file->Write(util::fmt("%0.6f Log writers: current=%zu\n", run_state::network_time, writer_stats.size()));
+
+	for ( const auto& w : writer_stats )
+		{
+		const auto& s = w.second;
+		file->Write(util::fmt("%0.6f   %-25s pending=%" PRIu64 " (%" PRIu64 " bytes, %" PRIu64 " batches)"
+		                      " written=%" PRIu64 " dropped=%" PRIu64 " latency=%.6f/%.6f batch=%" PRIu64 "\n",
+		                      run_state::network_time, w.first.c_str(),
+		                      s.pending_writes, s.pending_bytes, s.pending_batches,
+		                      s.written, s.dropped, s.latency, s.max_latency, s.batch_size));
+		}
+
 	auto cs = broker_mgr->GetStatistics();
 
 	file->Write(util::fmt("%0.6f Comm: peers=%zu stores=%zu "
@@ -282,7 +319,7 @@ void ProfileLogger::Log()
 
 				if ( v->GetType()->Tag() == TYPE_TABLE )
 					{
-					entries = v->AsTable()->Length();
+					entries = v->AsTableVal()->Size();
 					total_table_entries += entries;
 
 					// ### 100 shouldn't be hardwired
@@ -493,4 +530,91 @@ void PacketProfiler::ProfilePkt(double t, unsigned int bytes)
 	time = t;
 	}
 
+static const char* stage_names[NUM_STAGES] = {
+	"other",
+	"capture",
+	"packet analysis",
+	"session lookup",
+	"reassembly",
+	"app analyzers",
+	"timers",
+	"event dispatch",
+	"script handlers",
+	"logging enqueue",
+};
+
+StageProfiler::StageProfiler()
+	{
+	stack.reserve(64);
+	stack.push_back(STAGE_OTHER);
+	Restart();
+	}
+
+void StageProfiler::Restart()
+	{
+	for ( auto& t : totals )
+		t = Clock::duration::zero();
+
+	start = last = Clock::now();
+	pkt_cnt = byte_cnt = 0;
+#ifdef DEBUG
+	ref_ops_start = num_ref_ops;
+#endif
+	}
+
+void StageProfiler::Report(FILE* f)
+	{
+	Charge();
+
+	double secs = std::chrono::duration<double>(last - start).count();
+
+	if ( secs <= 0 )
+		secs = 1e-9;
+
+	fprintf(f, "# bench %" PRIu64 " packets, %" PRIu64 " bytes in %.6f s\n",
+	        pkt_cnt, byte_cnt, secs);
+	fprintf(f, "# bench %.0f packets/s, %.2f Mbit/s\n",
+	        pkt_cnt / secs, byte_cnt * 8 / secs / 1e6);
+
+	for ( int i = 0; i < NUM_STAGES; ++i )
+		{
+		double t = std::chrono::duration<double>(totals[i]).count();
+		fprintf(f, "# bench %-16s %10.6f s %6.2f%%\n",
+		        stage_names[i], t, 100 * t / secs);
+		}
+
+#ifdef DEBUG
+	fprintf(f, "# bench %.1f refcount operations/packet\n",
+	        pkt_cnt ? double(num_ref_ops - ref_ops_start) / pkt_cnt : 0.0);
+#endif
+	}
+
+AnalyzerAccounting::AnalyzerAccounting()
+	{
+	stack.reserve(64);
+	stack.push_back(nullptr);
+	last = Clock::now();
+	}
+
+AnalyzerUsage* AnalyzerAccounting::Usage(bool file, const std::string& name)
+	{
+	auto& u = usages[{file, name}];
+	u.file = file;
+	u.name = name;
+	return &u;
+	}
+
+void AnalyzerAccounting::UpdateMemory()
+	{
+	for ( auto& u : usages )
+		u.second.memory = 0;
+
+	if ( sessions && ! run_state::terminating )
+		sessions->VisitConnections([](Connection* c)
+			{
+			if ( auto a = c->GetRootAnalyzer() )
+				a->AccountMemory();
+			});
+	}
+
 } // namespace zeek::detail
@@ -8,6 +8,12 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace zeek { class File; }
 using BroFile [[deprecated("Remove in v4.1. Use zeek::File.")]] = zeek::File;
@@ -114,6 +120,7 @@ extern SampleLogger* sample_logger;
 
 // Connection statistics.
 extern uint64_t killed_by_inactivity;
+extern uint64_t compacted_by_inactivity;
 
 // Content gap statistics.
 extern uint64_t tot_ack_events;
@@ -143,6 +150,189 @@ protected:
 	uint64_t byte_cnt;
 };
 
+// The pipeline stages a StageProfiler attributes time to.
+enum Stage {
+	STAGE_OTHER,	// Main loop, I/O sources and anything not below.
+	STAGE_CAPTURE,
+	STAGE_PACKET_ANALYSIS,
+	STAGE_SESSION_LOOKUP,
+	STAGE_REASSEMBLY,
+	STAGE_APP_ANALYZERS,
+	STAGE_TIMERS,
+	STAGE_EVENT_DISPATCH,
+	STAGE_SCRIPT_HANDLERS,
+	STAGE_LOGGING,
+	NUM_STAGES
+};
+
+// Splits up wall-clock time between the stages of packet processing, as
+// reported by zeek --bench.  Stages nest, e.g. script handlers run inside
+// event dispatch, and each stage is charged only the time not spent in
+// nested ones.
+class StageProfiler {
+public:
+	StageProfiler();
+
+	void Enter(Stage s)
+		{
+		Charge();
+		stack.push_back(s);
+		}
+
+	void Leave()
+		{
+		Charge();
+		stack.pop_back();
+		}
+
+	void ProfilePkt(unsigned int bytes)
+		{
+		++pkt_cnt;
+		byte_cnt += bytes;
+		}
+
+	// Discards everything measured so far, e.g. to exclude a one-time
+	// setup cost from the results.
+	void Restart();
+
+	// Writes packet rates and the time per stage to the given file.
+	void Report(FILE* f);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	void Charge()
+		{
+		auto now = Clock::now();
+		totals[stack.back()] += now - last;
+		last = now;
+		}
+
+	std::vector<Stage> stack;
+	Clock::duration totals[NUM_STAGES];
+	Clock::time_point start;
+	Clock::time_point last;
+	uint64_t pkt_cnt;
+	uint64_t byte_cnt;
+#ifdef DEBUG
+	uint64_t ref_ops_start;
+#endif
+};
+
+// Only set in benchmark mode.
+extern StageProfiler* stage_profiler;
+
+// Charges the time during its lifetime, or until Done(), to a stage.
+class StageTimer {
+public:
+	explicit StageTimer(Stage s) : active(stage_profiler != nullptr)
+		{
+		if ( active )
+			stage_profiler->Enter(s);
+		}
+
+	~StageTimer()
+		{ Done(); }
+
+	void Done()
+		{
+		if ( active )
+			{
+			stage_profiler->Leave();
+			active = false;
+			}
+		}
+
+private:
+	bool active;
+};
+
+// Resource usage of all instances of one protocol or file analyzer.
+struct AnalyzerUsage {
+	bool file;	// True for a file analyzer.
+	std::string name;
+	std::chrono::steady_clock::duration time{};	// Excluding nested analyzers.
+	uint64_t bytes = 0;
+	uint64_t calls = 0;
+	uint64_t instances = 0;	// Currently active ones.
+	uint64_t memory = 0;	// As of the last UpdateMemory().
+};
+
+// Accounts CPU time, input and memory to the analyzers, if enabled through
+// analyzer_accounting. Like with the StageProfiler, time spent in an
+// analyzer is charged to it only while it doesn't pass the data on to
+// another one.
+class AnalyzerAccounting {
+public:
+	AnalyzerAccounting();
+
+	// Returns the usage entry for an analyzer, creating it on first use.
+	// The pointer remains valid as long as the AnalyzerAccounting.
+	AnalyzerUsage* Usage(bool file, const std::string& name);
+
+	void Enter(AnalyzerUsage* u, uint64_t len)
+		{
+		Charge();
+		stack.push_back(u);
+		++u->calls;
+		u->bytes += len;
+		}
+
+	void Leave()
+		{
+		Charge();
+		stack.pop_back();
+		}
+
+	// Recomputes the memory of the protocol analyzers of all current
+	// connections.
+	void UpdateMemory();
+
+	const std::map<std::pair<bool, std::string>, AnalyzerUsage>& Usages() const
+		{ return usages; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	void Charge()
+		{
+		auto now = Clock::now();
+
+		if ( stack.back() )
+			stack.back()->time += now - last;
+
+		last = now;
+		}
+
+	std::map<std::pair<bool, std::string>, AnalyzerUsage> usages;
+	std::vector<AnalyzerUsage*> stack;
+	Clock::time_point last;
+};
+
+// Only set if analyzer_accounting is.
+extern AnalyzerAccounting* analyzer_accounting;
+
+// Charges the time during its lifetime to an analyzer. A null usage
+// makes it a no-op.
+class AnalyzerUsageTimer {
+public:
+	AnalyzerUsageTimer(AnalyzerUsage* arg_u, uint64_t len)
+		: u(analyzer_accounting ? arg_u : nullptr)
+		{
+		if ( u )
+			analyzer_accounting->Enter(u, len);
+		}
+
+	~AnalyzerUsageTimer()
+		{
+		if ( u )
+			analyzer_accounting->Leave();
+		}
+
+private:
+	AnalyzerUsage* u;
+};
+
 } // namespace zeek::detail
 
 using SegmentStatsReporter [[deprecated("Remove in v4.1. Use zeek::detail::SegmentStatsReporter.")]] = zeek::detail::SegmentStatsReporter;
@@ -5,9 +5,11 @@
 #include "Stmt.h"
 
 #include "CompHash.h"
+#include "CompactSet.h"
 #include "Expr.h"
 #include "Event.h"
 #include "Frame.h"
+#include "Func.h"
 #include "File.h"
 #include "Reporter.h"
 #include "NetVar.h"
@@ -15,12 +17,15 @@
 #include "Var.h"
 #include "Desc.h"
 #include "Debug.h"
+#include "ScriptProfiler.h"
 #include "Traverse.h"
 #include "Trigger.h"
 #include "IntrusivePtr.h"
 #include "logging/Manager.h"
 #include "logging/logging.bif.h"
 
+#include <unordered_set>
+
 namespace zeek::detail {
 
 const char* stmt_name(StmtTag t)
@@ -1228,27 +1233,84 @@ ValPtr ForStmt::DoExec(Frame* f, Val* v, StmtFlowType& flow) const
 	{
 	ValPtr ret;
 
-	if ( v->GetType()->Tag() == TYPE_TABLE )
+	if ( v->GetType()->Tag() == TYPE_TABLE && v->AsTableVal()->CompactStorage() )
+		{
+		// The body may modify the set, which then moves on to a copy
+		// of its elements.
+		TableVal* tv = v->AsTableVal();
+		auto loop_vals = tv->CompactStorage();
+		size_t pos = 0;
+		uint64_t visited = 0;
+
+		while ( auto ind = loop_vals->Next(&pos) )
+			{
+			++visited;
+			f->SetElement((*loop_vars)[0], std::move(ind));
+			flow = FLOW_NEXT;
+
+			try
+				{
+				ret = body->Exec(f, flow);
+				}
+			catch ( InterpreterException& )
+				{
+				tv->CountIterations(visited);
+				throw;
+				}
+
+			if ( flow == FLOW_BREAK || flow == FLOW_RETURN )
+				break;
+			}
+
+		tv->CountIterations(visited);
+		}
+
+	else if ( v->GetType()->Tag() == TYPE_TABLE )
 		{
 		TableVal* tv = v->AsTableVal();
 		const PDict<TableEntryVal>* loop_vals = tv->AsTable();
 
+		// The body may modify a table that shares its storage, which
+		// then moves on to a copy of it.
+		auto shared_loop_vals = tv->SharedStorage();
+
 		if ( ! loop_vals->Length() )
 			return nullptr;
 
+		// The indices get decoded straight into these, rather than
+		// into a ListVal for each entry.
+		int num_ind = loop_vars->length();
+		ValPtr single_ind;
+		std::vector<ValPtr> multi_ind;
+		ValPtr* ind_vals = &single_ind;
+
+		if ( num_ind > 1 )
+			{
+			multi_ind.resize(num_ind);
+			ind_vals = multi_ind.data();
+			}
+
+		bool need_ind = IndexUsed(f);
+
 		HashKey* k;
 		TableEntryVal* current_tev;
+		uint64_t visited = 0;
 		IterCookie* c = loop_vals->InitForIteration();
-		while ( (current_tev = loop_vals->NextEntry(k, c)) )
+		while ( (current_tev = need_ind ? loop_vals->NextEntry(k, c) : loop_vals->NextEntry(c)) )
 			{
-			auto ind_lv = tv->RecreateIndex(*k);
-			delete k;
+			++visited;
 
 			if ( value_var )
 				f->SetElement(value_var, current_tev->GetVal());
 
-			for ( int i = 0; i < ind_lv->Length(); i++ )
-				f->SetElement((*loop_vars)[i], ind_lv->Idx(i));
+			if ( need_ind )
+				{
+				tv->RecreateIndex(*k, ind_vals);
+				delete k;
+
+				for ( int i = 0; i < num_ind; i++ )
+					f->SetElement((*loop_vars)[i], std::move(ind_vals[i]));
+				}
 
 			flow = FLOW_NEXT;
 
@@ -1259,6 +1321,7 @@ ValPtr ForStmt::DoExec(Frame* f, Val* v, StmtFlowType& flow) const
 			catch ( InterpreterException& )
 				{
 				loop_vals->StopIteration(c);
+				tv->CountIterations(visited);
 				throw;
 				}
 
@@ -1270,6 +1333,8 @@ ValPtr ForStmt::DoExec(Frame* f, Val* v, StmtFlowType& flow) const
 				break;
 				}
 			}
+
+		tv->CountIterations(visited);
 		}
 
 	else if ( v->GetType()->Tag() == TYPE_VECTOR )
@@ -1320,6 +1385,71 @@ ValPtr ForStmt::DoExec(Frame* f, Val* v, StmtFlowType& flow) const
 	return ret;
 	}
 
+namespace {
+
+// Looks for anything that may read a set of local variables: a reference
+// by name, or a lambda, since its closure may read the frame later on.
+class LoopVarUseFinder : public TraversalCallback {
+public:
+	explicit LoopVarUseFinder(const IDPList* arg_vars) : vars(arg_vars)	{ }
+
+	TraversalCode PreExpr(const Expr* e) override
+		{
+		if ( e->Tag() == EXPR_LAMBDA )
+			{
+			used = true;
+			return TC_ABORTALL;
+			}
+
+		if ( e->Tag() != EXPR_NAME )
+			return TC_CONTINUE;
+
+		auto id = static_cast<const NameExpr*>(e)->Id();
+
+		for ( const auto& var : *vars )
+			if ( var == id )
+				{
+				used = true;
+				return TC_ABORTALL;
+				}
+
+		return TC_CONTINUE;
+		}
+
+	const IDPList* vars;
+	bool used = false;
+};
+
+}
+
+bool ForStmt::IndexUsed(const Frame* f) const
+	{
+	if ( index_use_known )
+		return index_used;
+
+	// Locals live as long as their function's frame, so it takes the
+	// whole function to tell, and loops at the global level always
+	// recover the indices.
+	auto func = f->GetFunction();
+
+	if ( ! func )
+		return true;
+
+	LoopVarUseFinder cb(loop_vars);
+
+	for ( const auto& b : func->GetBodies() )
+		{
+		b.stmts->Traverse(&cb);
+
+		if ( cb.used )
+			break;
+		}
+
+	index_use_known = true;
+	index_used = cb.used;
+	return index_used;
+	}
+
 bool ForStmt::IsPure() const
 	{
 	return e->IsPure() && body->IsPure();
@@ -1561,6 +1691,9 @@ ValPtr StmtList::Exec(Frame* f, StmtFlowType& flow) const
 
 		auto result = stmt->Exec(f, flow);
 
+		if ( ScriptProfiler::SampleDue() )
+			script_profiler.Sample();
+
 		if ( ! post_execute_stmt(stmt, f, result.get(), &flow) )
 			{ // ### Abort or something
 			}
@@ -1644,6 +1777,9 @@ ValPtr EventBodyList::Exec(Frame* f, StmtFlowType& flow) const
 
 		auto result = stmt->Exec(f, flow);
 
+		if ( ScriptProfiler::SampleDue() )
+			script_profiler.Sample();
+
 		if ( ! post_execute_stmt(stmt, f, result.get(), &flow) )
 			{ // ### Abort or something
 			}
@@ -1785,6 +1921,26 @@ TraversalCode NullStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+// Collects the locals that a statement references.
+class LocalsFinder : public TraversalCallback {
+public:
+	TraversalCode PreExpr(const Expr* expr) override
+		{
+		if ( expr->Tag() != EXPR_NAME )
+			return TC_CONTINUE;
+
+		auto id = static_cast<const NameExpr*>(expr)->Id();
+
+		if ( ! id->IsGlobal() && seen.insert(id).second )
+			locals.push_back(id);
+
+		return TC_CONTINUE;
+		}
+
+	std::vector<const ID*> locals;
+	std::unordered_set<const ID*> seen;
+};
+
 WhenStmt::WhenStmt(ExprPtr arg_cond,
                    StmtPtr arg_s1, StmtPtr arg_s2,
                    ExprPtr arg_timeout, bool arg_is_return)
@@ -1807,6 +1963,10 @@ WhenStmt::WhenStmt(ExprPtr arg_cond,
 		if ( bt != TYPE_TIME && bt != TYPE_INTERVAL )
 			cond->Error("when timeout requires a time or time interval");
 		}
+
+	LocalsFinder lf;
+	Traverse(&lf);
+	captures = std::make_shared<const std::vector<const ID*>>(std::move(lf.locals));
 	}
 
 WhenStmt::~WhenStmt() = default;
@@ -1821,7 +1981,7 @@ ValPtr WhenStmt::Exec(Frame* f, StmtFlowType& flow) const
 	                     IntrusivePtr{s1}.release(),
 	                     IntrusivePtr{s2}.release(),
 	                     IntrusivePtr{timeout}.release(),
-	                     f, is_return, location);
+	                     f, is_return, location, captures);
 	return nullptr;
 	}
 
@@ -1884,6 +2044,12 @@ TraversalCode WhenStmt::Traverse(TraversalCallback* cb) const
 		HANDLE_TC_STMT_PRE(tc);
 		}
 
+	if ( timeout )
+		{
+		tc = timeout->Traverse(cb);
+		HANDLE_TC_STMT_PRE(tc);
+		}
+
 	tc = cb->PostStmt(this);
 	HANDLE_TC_STMT_POST(tc);
 	}
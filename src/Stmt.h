@@ -4,6 +4,9 @@
 
 // BRO statements.
 
+#include <memory>
+#include <vector>
+
 #include "ZeekList.h"
 #include "Dict.h"
 #include "ID.h"
@@ -216,7 +219,10 @@ protected:
 	case_list* cases;
 	int default_case_idx;
 	CompositeHash* comp_hash;
-	PDict<int> case_label_value_map;
+
+	// The labels are fixed at parse time, so lookups with arbitrary
+	// values can't be made to collide more than the labels do.
+	PDict<int> case_label_value_map{UNORDERED, 0, FAST_HASH};
 	std::vector<std::pair<ID*, int>> case_label_type_list;
 };
 
@@ -258,6 +264,9 @@ public:
 	WhileStmt(ExprPtr loop_condition, StmtPtr body);
 	~WhileStmt() override;
 
+	const Expr* Condition() const	{ return loop_condition.get(); }
+	const Stmt* Body() const	{ return body.get(); }
+
 	bool IsPure() const override;
 
 	void Describe(ODesc* d) const override;
@@ -293,11 +302,20 @@ public:
 protected:
 	ValPtr DoExec(Frame* f, Val* v, StmtFlowType& flow) const override;
 
+	// Returns true if anything in f's function may read the loop
+	// variables of a table iteration. If not, the loop doesn't recover
+	// the indices at all.
+	bool IndexUsed(const Frame* f) const;
+
 	IDPList* loop_vars;
 	StmtPtr body;
 	// Stores the value variable being used for a key value for loop.
 	// Always set to nullptr unless special constructor is called.
 	IDPtr value_var;
+
+	// Caches IndexUsed()'s result.
+	mutable bool index_use_known = false;
+	mutable bool index_used = true;
 };
 
 class NextStmt final : public Stmt {
@@ -443,6 +461,10 @@ protected:
 	StmtPtr s2;
 	ExprPtr timeout;
 	bool is_return;
+
+	// The locals referenced anywhere in the statement, which are all
+	// its trigger needs to copy from the frame.
+	std::shared_ptr<const std::vector<const ID*>> captures;
 };
 
 } // namespace zeek::detail
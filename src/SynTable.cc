@@ -0,0 +1,106 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "SynTable.h"
+
+#include <string.h>
+
+#include "IP.h"
+#include "iosource/Packet.h"
+
+namespace zeek::detail {
+
+void SynTable::Init(size_t size)
+	{
+	size_t n = 1;
+
+	while ( n < size )
+		n <<= 1;
+
+	Clear();
+	slots.resize(n);
+	mask = n - 1;
+	}
+
+void SynTable::Clear()
+	{
+	slots.clear();
+	slots.shrink_to_fit();
+	mask = 0;
+	num_entries = 0;
+	num_evicted = 0;
+	}
+
+SynTable::Entry* SynTable::Lookup(const ConnIDKey& key)
+	{
+	if ( slots.empty() )
+		return nullptr;
+
+	auto& e = slots[key.hash & mask];
+	return e.time != 0.0 && e.key == key ? &e : nullptr;
+	}
+
+bool SynTable::Insert(const ConnIDKey& key, const Packet* pkt, double t)
+	{
+	if ( slots.empty() )
+		return false;
+
+	const IP_Hdr* ip = pkt->ip_hdr.get();
+	auto ip_hdr_len = ip->HdrLen();
+	auto tp = reinterpret_cast<const struct tcphdr*>(ip->Payload());
+	auto hdr_len = ip_hdr_len + tp->th_off * 4;
+
+	if ( hdr_len > MAX_HDR_LEN )
+		return false;
+
+	auto& e = slots[key.hash & mask];
+
+	if ( e.time != 0.0 )
+		++num_evicted;
+	else
+		++num_entries;
+
+	e.key = key;
+	e.time = t;
+	e.syns = 1;
+	e.vlan = pkt->vlan;
+	e.inner_vlan = pkt->inner_vlan;
+
+	e.have_l2_src = pkt->l2_src != nullptr;
+	e.have_l2_dst = pkt->l2_dst != nullptr;
+
+	if ( e.have_l2_src )
+		memcpy(e.l2_src, pkt->l2_src, sizeof(e.l2_src));
+
+	if ( e.have_l2_dst )
+		memcpy(e.l2_dst, pkt->l2_dst, sizeof(e.l2_dst));
+
+	e.ipv6 = ip->IP6_Hdr() != nullptr;
+	e.hdr_len = hdr_len;
+
+	if ( e.ipv6 )
+		memcpy(e.hdr, ip->IP6_Hdr(), hdr_len);
+	else
+		memcpy(e.hdr, ip->IP4_Hdr(), hdr_len);
+
+	return true;
+	}
+
+uint64_t SynTable::Expire(double cutoff)
+	{
+	uint64_t n = 0;
+
+	for ( auto& e : slots )
+		{
+		if ( e.time != 0.0 && e.time < cutoff )
+			{
+			Remove(&e);
+			++n;
+			}
+		}
+
+	return n;
+	}
+
+} // namespace zeek::detail
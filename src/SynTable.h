@@ -0,0 +1,96 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "IPAddr.h"
+#include "MemoryTag.h"
+
+ZEEK_FORWARD_DECLARE_NAMESPACED(Packet, zeek);
+
+namespace zeek::detail {
+
+/**
+ * A fixed-size table of TCP handshakes that haven't gotten past their
+ * initial SYN, see the tcp_defer_syn option. Instead of a \a Connection,
+ * a handshake only takes a slot holding the SYN's headers, so that the
+ * connection can get built from them once the handshake progresses.
+ *
+ * The table is direct-mapped: a new handshake takes over the slot of the
+ * one its key hashes to, evicting any previous occupant. It never
+ * allocates beyond its slots, no matter how many SYNs arrive.
+ */
+class SynTable {
+public:
+	// IPv4 and TCP headers with maximal options, or a plain IPv6 header
+	// with room for TCP options or an extension header.
+	static constexpr int MAX_HDR_LEN = 120;
+
+	struct Entry {
+		ConnIDKey key;
+		double time = 0.0;	// of the first SYN; 0.0 means the slot is free
+		uint32_t syns = 0;	// including retransmissions
+		uint32_t vlan = 0, inner_vlan = 0;
+		uint8_t l2_src[6], l2_dst[6];
+		bool have_l2_src = false, have_l2_dst = false;
+		bool ipv6 = false;
+		uint16_t hdr_len = 0;	// of the IP and TCP headers in hdr
+		uint8_t hdr[MAX_HDR_LEN];
+	};
+
+	/**
+	 * Sets the number of slots, rounded up to a power of two. Drops all
+	 * handshakes.
+	 */
+	void Init(size_t size);
+
+	/**
+	 * Drops all handshakes and releases the slots.
+	 */
+	void Clear();
+
+	/**
+	 * Returns the handshake for a key, or nullptr if there's none.
+	 */
+	Entry* Lookup(const ConnIDKey& key);
+
+	/**
+	 * Records the initial SYN of a handshake. The key mustn't be present
+	 * yet.
+	 *
+	 * @return False if the SYN's headers don't fit into a slot.
+	 */
+	bool Insert(const ConnIDKey& key, const Packet* pkt, double t);
+
+	/**
+	 * Frees the slot of a handshake.
+	 */
+	void Remove(Entry* e)	{ e->time = 0.0; --num_entries; }
+
+	/**
+	 * Drops all handshakes whose initial SYN came before the given time.
+	 *
+	 * @return The number of handshakes dropped.
+	 */
+	uint64_t Expire(double cutoff);
+
+	/**
+	 * Returns the number of handshakes evicted by others since the last
+	 * call, and resets it.
+	 */
+	uint64_t TakeEvicted()	{ auto n = num_evicted; num_evicted = 0; return n; }
+
+	size_t Size() const	{ return num_entries; }
+	size_t MemoryAllocation() const	{ return slots.capacity() * sizeof(Entry); }
+
+private:
+	std::vector<Entry, TaggedAllocator<Entry, MemoryTag::Connections>> slots;
+	size_t mask = 0;
+	size_t num_entries = 0;
+	uint64_t num_evicted = 0;
+};
+
+} // namespace zeek::detail
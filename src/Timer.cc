@@ -7,6 +7,7 @@
 #include "Desc.h"
 #include "RunState.h"
 #include "NetVar.h"
+#include "Event.h"
 #include "broker/Manager.h"
 #include "iosource/Manager.h"
 #include "iosource/PktSrc.h"
@@ -17,6 +18,7 @@ namespace zeek::detail {
 const char* TimerNames[] = {
 	"BackdoorTimer",
 	"BreakpointTimer",
+	"ConnectionCompactionTimer",
 	"ConnectionDeleteTimer",
 	"ConnectionExpireTimer",
 	"ConnectionInactivityTimer",
@@ -37,6 +39,7 @@ const char* TimerNames[] = {
 	"RemoveConnection",
 	"RPCExpireTimer",
 	"ScheduleTimer",
+	"SnapshotTimer",
 	"TableValTimer",
 	"TCPConnectionAttemptTimer",
 	"TCPConnectionDeleteTimer",
@@ -88,6 +91,7 @@ int TimerMgr::Advance(double arg_t, int max_expire)
 	last_advance = timer_mgr->Time();
 	broker_mgr->AdvanceTime(arg_t);
 
+	EventMgr::LaneScope lane(EventMgr::LANE_TIMER);
 	return DoAdvance(t, max_expire);
 	}
 
@@ -192,4 +196,254 @@ double PQ_TimerMgr::GetNextTimeout()
 	return -1;
 	}
 
+Wheel_TimerMgr::Wheel_TimerMgr(double arg_resolution) : TimerMgr()
+	{
+	resolution = arg_resolution;
+	}
+
+Wheel_TimerMgr::~Wheel_TimerMgr()
+	{
+	// The heap deletes the timers it still holds itself.
+	for ( int i = 0; i <= OVERFLOW_SLOT; ++i )
+		{
+		while ( Timer* timer = slots[i] )
+			{
+			Unlink(timer);
+			delete timer;
+			}
+		}
+	}
+
+void Wheel_TimerMgr::Add(Timer* timer)
+	{
+	DBG_LOG(DBG_TM, "Adding timer %s (%p) at %.6f",
+	        timer_type_to_string(timer->Type()), timer, timer->Time());
+
+	Insert(timer);
+
+	++cumulative_num;
+
+	if ( ++num_timers > peak_timers )
+		peak_timers = num_timers;
+
+	++current_timers[timer->Type()];
+	}
+
+void Wheel_TimerMgr::Insert(Timer* timer)
+	{
+	uint64_t tick = Tick(timer->Time());
+
+	if ( tick < current_tick )
+		{
+		// Already expired, or in a tick we've moved past; the heap
+		// keeps them in order with the others due.
+		if ( ! heap.Add(timer) )
+			reporter->InternalError("out of memory");
+
+		return;
+		}
+
+	uint64_t delta = tick - current_tick;
+	int level = 0;
+
+	while ( level < NUM_LEVELS && delta >= (uint64_t(1) << (LEVEL_BITS * (level + 1))) )
+		++level;
+
+	if ( level == NUM_LEVELS )
+		Link(timer, OVERFLOW_SLOT);
+	else
+		Link(timer, level * SLOTS_PER_LEVEL +
+		     ((tick >> (LEVEL_BITS * level)) & (SLOTS_PER_LEVEL - 1)));
+	}
+
+void Wheel_TimerMgr::Link(Timer* timer, int slot)
+	{
+	timer->wheel_slot = slot;
+	timer->wheel_prev = nullptr;
+	timer->wheel_next = slots[slot];
+
+	if ( slots[slot] )
+		slots[slot]->wheel_prev = timer;
+
+	slots[slot] = timer;
+	++level_size[slot / SLOTS_PER_LEVEL];
+	}
+
+void Wheel_TimerMgr::Unlink(Timer* timer)
+	{
+	int slot = timer->wheel_slot;
+
+	if ( timer->wheel_prev )
+		timer->wheel_prev->wheel_next = timer->wheel_next;
+	else
+		slots[slot] = timer->wheel_next;
+
+	if ( timer->wheel_next )
+		timer->wheel_next->wheel_prev = timer->wheel_prev;
+
+	timer->wheel_slot = UINT16_MAX;
+	timer->wheel_prev = timer->wheel_next = nullptr;
+	--level_size[slot / SLOTS_PER_LEVEL];
+	}
+
+void Wheel_TimerMgr::Reinsert(int slot)
+	{
+	while ( Timer* timer = slots[slot] )
+		{
+		Unlink(timer);
+		Insert(timer);
+		}
+	}
+
+void Wheel_TimerMgr::MoveToHeap(int slot)
+	{
+	while ( Timer* timer = slots[slot] )
+		{
+		Unlink(timer);
+
+		if ( ! heap.Add(timer) )
+			reporter->InternalError("out of memory");
+		}
+	}
+
+void Wheel_TimerMgr::CascadeAt()
+	{
+	// Higher levels first, so that their timers can trickle all the
+	// way down.
+	for ( int level = NUM_LEVELS; level >= 1; --level )
+		{
+		if ( current_tick & ((uint64_t(1) << (LEVEL_BITS * level)) - 1) )
+			continue;
+
+		if ( level == NUM_LEVELS )
+			Reinsert(OVERFLOW_SLOT);
+		else
+			Reinsert(level * SLOTS_PER_LEVEL +
+			         ((current_tick >> (LEVEL_BITS * level)) & (SLOTS_PER_LEVEL - 1)));
+		}
+	}
+
+void Wheel_TimerMgr::AdvanceTo(uint64_t target)
+	{
+	while ( current_tick <= target )
+		{
+		if ( level_size[0] == 0 )
+			{
+			// Nothing to do until the next level wrapping around
+			// that has timers, so skip ahead to there.
+			int level = 1;
+
+			while ( level <= NUM_LEVELS && level_size[level] == 0 )
+				++level;
+
+			if ( level > NUM_LEVELS )
+				{
+				current_tick = target + 1;
+				return;
+				}
+
+			uint64_t next = ((current_tick >> (LEVEL_BITS * level)) + 1) << (LEVEL_BITS * level);
+
+			if ( next > target )
+				{
+				current_tick = target + 1;
+				return;
+				}
+
+			current_tick = next;
+			CascadeAt();
+			continue;
+			}
+
+		MoveToHeap(current_tick & (SLOTS_PER_LEVEL - 1));
+		++current_tick;
+		CascadeAt();
+		}
+	}
+
+void Wheel_TimerMgr::Expire()
+	{
+	for ( int i = 0; i <= OVERFLOW_SLOT; ++i )
+		MoveToHeap(i);
+
+	Timer* timer;
+	while ( (timer = static_cast<Timer*>(heap.Remove())) )
+		{
+		DBG_LOG(DBG_TM, "Dispatching timer %s (%p)",
+		        timer_type_to_string(timer->Type()), timer);
+		timer->Dispatch(t, true);
+		--current_timers[timer->Type()];
+		--num_timers;
+		delete timer;
+		}
+	}
+
+int Wheel_TimerMgr::DoAdvance(double new_t, int max_expire)
+	{
+	AdvanceTo(Tick(new_t));
+
+	Timer* timer = static_cast<Timer*>(heap.Top());
+	for ( num_expired = 0; (num_expired < max_expire || max_expire == 0) &&
+		     timer && timer->Time() <= new_t; ++num_expired )
+		{
+		last_timestamp = timer->Time();
+		--current_timers[timer->Type()];
+		--num_timers;
+
+		// Remove it before dispatching, since the dispatch
+		// can otherwise delete it, and then we won't know
+		// whether we should delete it too.
+		(void) heap.Remove();
+
+		DBG_LOG(DBG_TM, "Dispatching timer %s (%p)",
+		        timer_type_to_string(timer->Type()), timer);
+		timer->Dispatch(new_t, false);
+		delete timer;
+
+		timer = static_cast<Timer*>(heap.Top());
+		}
+
+	return num_expired;
+	}
+
+void Wheel_TimerMgr::Remove(Timer* timer)
+	{
+	if ( timer->wheel_slot != UINT16_MAX )
+		Unlink(timer);
+
+	else if ( ! heap.Remove(timer) )
+		reporter->InternalError("asked to remove a missing timer");
+
+	--current_timers[timer->Type()];
+	--num_timers;
+	delete timer;
+	}
+
+double Wheel_TimerMgr::GetNextTimeout()
+	{
+	if ( Timer* top = static_cast<Timer*>(heap.Top()) )
+		return std::max(0.0, top->Time() - run_state::network_time);
+
+	if ( num_timers == 0 )
+		return -1;
+
+	// Wake up at the next tick that has timers, or when the next
+	// level-1 slot gets distributed.
+	uint64_t next = ((current_tick >> LEVEL_BITS) + 1) << LEVEL_BITS;
+
+	if ( level_size[0] > 0 )
+		{
+		for ( uint64_t tick = current_tick; tick < current_tick + SLOTS_PER_LEVEL; ++tick )
+			{
+			if ( slots[tick & (SLOTS_PER_LEVEL - 1)] )
+				{
+				next = tick;
+				break;
+				}
+			}
+		}
+
+	return std::max(0.0, next * resolution - run_state::network_time);
+	}
+
 } // namespace zeek::detail
@@ -15,6 +15,7 @@ namespace zeek::detail {
 enum TimerType : uint8_t {
 	TIMER_BACKDOOR,
 	TIMER_BREAKPOINT,
+	TIMER_CONN_COMPACTION,
 	TIMER_CONN_DELETE,
 	TIMER_CONN_EXPIRE,
 	TIMER_CONN_INACTIVITY,
@@ -35,6 +36,7 @@ enum TimerType : uint8_t {
 	TIMER_REMOVE_CONNECTION,
 	TIMER_RPC_EXPIRE,
 	TIMER_SCHEDULE,
+	TIMER_SNAPSHOT,
 	TIMER_TABLE_VAL,
 	TIMER_TCP_ATTEMPT,
 	TIMER_TCP_DELETE,
@@ -66,8 +68,14 @@ public:
 	void Describe(ODesc* d) const;
 
 protected:
+	friend class Wheel_TimerMgr;
 
 	TimerType type{};
+
+	// Bookkeeping for Wheel_TimerMgr's slot lists.
+	uint16_t wheel_slot = UINT16_MAX;
+	Timer* wheel_prev = nullptr;
+	Timer* wheel_next = nullptr;
 };
 
 class TimerMgr : public iosource::IOSource {
@@ -171,6 +179,81 @@ protected:
 	PriorityQueue* q;
 };
 
+/**
+ * A timer manager based on a hierarchical timing wheel. Timers are
+ * hashed into one of four levels of 256 slots each by how far out they
+ * expire; level 0 has a granularity of one tick, each further level
+ * spans 256 times as much. Adding and canceling a timer are constant
+ * time list operations. When the clock reaches a slot, its timers move
+ * in bulk into a small heap that dispatches them in exact time order;
+ * slots of the higher levels get distributed to the lower ones as the
+ * clock passes them.
+ *
+ * Selected by setting ZEEK_TIMER_WHEEL in the environment.
+ */
+class Wheel_TimerMgr : public TimerMgr {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param resolution The length of a tick in seconds.
+	 */
+	explicit Wheel_TimerMgr(double resolution = 0.01);
+	~Wheel_TimerMgr() override;
+
+	void Add(Timer* timer) override;
+	void Expire() override;
+
+	int Size() const override { return num_timers; }
+	int PeakSize() const override { return peak_timers; }
+	uint64_t CumulativeNum() const override { return cumulative_num; }
+	double GetNextTimeout() override;
+
+protected:
+	int DoAdvance(double t, int max_expire) override;
+	void Remove(Timer* timer) override;
+
+private:
+	static constexpr int LEVEL_BITS = 8;
+	static constexpr int SLOTS_PER_LEVEL = 1 << LEVEL_BITS;
+	static constexpr int NUM_LEVELS = 4;
+	// Timers beyond the range of the top level.
+	static constexpr int OVERFLOW_SLOT = NUM_LEVELS * SLOTS_PER_LEVEL;
+
+	uint64_t Tick(double t) const
+		{ return t <= 0 ? 0 : static_cast<uint64_t>(t / resolution); }
+
+	// Places a timer into the slot corresponding to its expiration, or
+	// into the heap if that tick has been reached already.
+	void Insert(Timer* timer);
+
+	void Link(Timer* timer, int slot);
+	void Unlink(Timer* timer);
+
+	// Moves all timers expiring up to and including the given tick into
+	// the heap.
+	void AdvanceTo(uint64_t target);
+
+	// Redistributes the slots of the levels wrapping around at the
+	// current tick.
+	void CascadeAt();
+
+	void Reinsert(int slot);
+	void MoveToHeap(int slot);
+
+	double resolution;
+	uint64_t current_tick = 0;	// First tick not yet moved into the heap.
+
+	Timer* slots[OVERFLOW_SLOT + 1] = {};
+	int level_size[NUM_LEVELS + 1] = {};
+
+	PriorityQueue heap;
+
+	int num_timers = 0;
+	int peak_timers = 0;
+	uint64_t cumulative_num = 0;
+};
+
 extern TimerMgr* timer_mgr;
 
 } // namespace zeek::detail
@@ -1,6 +1,7 @@
 #include "Trigger.h"
 
 #include <algorithm>
+#include <unordered_set>
 
 #include <assert.h>
 
@@ -35,6 +36,11 @@ public:
 
 private:
 	Trigger* trigger;
+
+	// Names that only get indexed. If they refer to tables, the trigger
+	// registers for the keys looked up during evaluation instead of for
+	// the whole table.
+	std::unordered_set<const Expr*> indexed;
 };
 
 TraversalCode trigger::TriggerTraversalCallback::PreExpr(const Expr* expr)
@@ -51,11 +57,28 @@ TraversalCode trigger::TriggerTraversalCallback::PreExpr(const Expr* expr)
 
 		Val* v = e->Id()->GetVal().get();
 
+		if ( v && v->GetType()->Tag() == TYPE_TABLE && indexed.count(e) &&
+		     ! v->AsTableVal()->Subnets() )
+			break;
+
 		if ( v && v->Modifiable() )
 			trigger->Register(v);
 		break;
 		};
 
+	case EXPR_INDEX:
+		{
+		const auto* e = static_cast<const IndexExpr*>(expr);
+
+		if ( ! e->IsSlice() )
+			indexed.insert(e->Op1());
+		break;
+		}
+
+	case EXPR_IN:
+		indexed.insert(static_cast<const InExpr*>(expr)->Op2());
+		break;
+
 	default:
 		// All others are uninteresting.
 		break;
@@ -102,13 +125,15 @@ protected:
 Trigger::Trigger(Expr* arg_cond, Stmt* arg_body,
                  Stmt* arg_timeout_stmts,
                  Expr* arg_timeout, Frame* arg_frame,
-                 bool arg_is_return, const Location* arg_location)
+                 bool arg_is_return, const Location* arg_location,
+                 std::shared_ptr<const std::vector<const ID*>> arg_captures)
 	{
+	captures = std::move(arg_captures);
 	cond = arg_cond;
 	body = arg_body;
 	timeout_stmts = arg_timeout_stmts;
 	timeout = arg_timeout;
-	frame = arg_frame->Clone();
+	frame = CloneFrame(arg_frame);
 	timer = nullptr;
 	delayed = false;
 	disabled = false;
@@ -199,7 +224,8 @@ Trigger::~Trigger()
 	// point.
 	}
 
-void Trigger::Init(std::vector<ValPtr> index_expr_results)
+void Trigger::Init(std::vector<ValPtr> index_expr_results,
+                   std::vector<std::pair<TableValPtr, uint64_t>> index_expr_keys)
 	{
 	assert(! disabled);
 	UnregisterAll();
@@ -208,6 +234,9 @@ void Trigger::Init(std::vector<ValPtr> index_expr_results)
 
 	for ( const auto& v : index_expr_results )
 		Register(v.get());
+
+	for ( const auto& [tv, key] : index_expr_keys )
+		Register(tv.get(), key);
 	}
 
 bool Trigger::Eval()
@@ -236,7 +265,7 @@ bool Trigger::Eval()
 
 	try
 		{
-		f = frame->Clone();
+		f = CloneFrame(frame);
 		}
 	catch ( InterpreterException& )
 		{
@@ -261,6 +290,7 @@ bool Trigger::Eval()
 
 	IndexExprWhen::EndEval();
 	auto index_expr_results = IndexExprWhen::TakeAllResults();
+	auto index_expr_keys = IndexExprWhen::TakeAllKeys();
 
 	f->ClearTrigger();
 
@@ -277,7 +307,7 @@ bool Trigger::Eval()
 		// Not true. Perhaps next time...
 		DBG_LOG(DBG_NOTIFIERS, "%s: trigger condition is false", Name());
 		Unref(f);
-		Init(std::move(index_expr_results));
+		Init(std::move(index_expr_results), std::move(index_expr_keys));
 		return false;
 		}
 
@@ -337,7 +367,7 @@ void Trigger::Timeout()
 	if ( timeout_stmts )
 		{
 		StmtFlowType flow;
-		FramePtr f{AdoptRef{}, frame->Clone()};
+		FramePtr f{AdoptRef{}, CloneFrame(frame)};
 		ValPtr v;
 
 		try
@@ -374,6 +404,11 @@ void Trigger::Timeout()
 	Unref(this);
 	}
 
+Frame* Trigger::CloneFrame(const Frame* f) const
+	{
+	return captures ? f->Clone(*captures) : f->Clone();
+	}
+
 void Trigger::Register(ID* id)
 	{
 	assert(! disabled);
@@ -395,6 +430,15 @@ void Trigger::Register(Val* val)
 	objs.emplace_back(val, val->Modifiable());
 	}
 
+void Trigger::Register(Val* val, uint64_t key)
+	{
+	assert(! disabled);
+	notifier::detail::registry.Register(val->Modifiable(), key, this);
+
+	Ref(val);
+	key_objs.emplace_back(val, key);
+	}
+
 void Trigger::UnregisterAll()
 	{
 	DBG_LOG(DBG_NOTIFIERS, "%s: unregistering all", Name());
@@ -406,6 +450,14 @@ void Trigger::UnregisterAll()
 		}
 
 	objs.clear();
+
+	for ( const auto& [val, key] : key_objs )
+		{
+		notifier::detail::registry.Unregister(val->Modifiable(), key, this);
+		Unref(val);
+		}
+
+	key_objs.clear();
 	}
 
 void Trigger::Attach(Trigger *trigger)
@@ -501,6 +553,10 @@ void Manager::Process()
 	{
 	DBG_LOG(DBG_NOTIFIERS, "evaluating all pending triggers");
 
+	// Modifications from outside of events, such as expiring table
+	// entries, are still waiting to queue their triggers.
+	notifier::detail::registry.Flush();
+
 	// While we iterate over the list, executing statements, we may
 	// in fact trigger new triggers and thereby modify the list.
 	// Therefore, we create a new temporary list which will receive
@@ -512,10 +568,15 @@ void Manager::Process()
 	for ( TriggerList::iterator i = orig->begin(); i != orig->end(); ++i )
 		{
 		Trigger* t = *i;
+		t->queued = false;
 		(*i)->Eval();
 		Unref(t);
 		}
 
+	// Modifications by the trigger bodies go to the next round, same
+	// as the triggers they queue.
+	notifier::detail::registry.Flush();
+
 	pending = orig;
 	orig->clear();
 
@@ -524,8 +585,9 @@ void Manager::Process()
 
 void Manager::Queue(Trigger* trigger)
 	{
-	if ( std::find(pending->begin(), pending->end(), trigger) == pending->end() )
+	if ( ! trigger->queued )
 		{
+		trigger->queued = true;
 		Ref(trigger);
 		pending->push_back(trigger);
 		total_triggers++;
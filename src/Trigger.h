@@ -1,6 +1,7 @@
 #pragma once
 
 #include <list>
+#include <memory>
 #include <vector>
 #include <map>
 
@@ -12,6 +13,7 @@
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(ODesc, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
+ZEEK_FORWARD_DECLARE_NAMESPACED(TableVal, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Frame, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Stmt, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Expr, zeek::detail);
@@ -27,6 +29,7 @@ namespace trigger {
 
 class TriggerTimer;
 class TriggerTraversalCallback;
+class Manager;
 
 class Trigger final : public Obj, public notifier::detail::Receiver {
 public:
@@ -34,8 +37,13 @@ public:
 	// instantiation.  Note that if the condition is already true, the
 	// statements are executed immediately and the object is deleted
 	// right away.
+	//
+	// If given, captures are the locals that the statement references.
+	// Only their values get copied from the frame, instead of all of
+	// them.
 	Trigger(Expr* cond, Stmt* body, Stmt* timeout_stmts, Expr* timeout,
-		Frame* f, bool is_return, const Location* loc);
+		Frame* f, bool is_return, const Location* loc,
+		std::shared_ptr<const std::vector<const ID*>> captures = nullptr);
 	~Trigger() override;
 
 	// Evaluates the condition. If true, executes the body and deletes
@@ -90,18 +98,25 @@ public:
 private:
 	friend class TriggerTraversalCallback;
 	friend class TriggerTimer;
+	friend class Manager;
 
-	void Init(std::vector<IntrusivePtr<Val>> index_expr_results);
+	void Init(std::vector<IntrusivePtr<Val>> index_expr_results,
+	          std::vector<std::pair<IntrusivePtr<TableVal>, uint64_t>> index_expr_keys);
 	void Register(ID* id);
 	void Register(Val* val);
+	void Register(Val* val, uint64_t key);	// For changes to a key only.
 	void UnregisterAll();
 
+	// Copies the frame's values that the statement may use.
+	Frame* CloneFrame(const Frame* f) const;
+
 	Expr* cond;
 	Stmt* body;
 	Stmt* timeout_stmts;
 	Expr* timeout;
 	double timeout_value;
 	Frame* frame;
+	std::shared_ptr<const std::vector<const ID*>> captures;
 	bool is_return;
 	const Location* location;
 
@@ -110,8 +125,10 @@ private:
 
 	bool delayed; // true if a function call is currently being delayed
 	bool disabled;
+	bool queued = false; // true if pending evaluation by the manager
 
 	std::vector<std::pair<Obj *, notifier::detail::Modifiable*>> objs;
+	std::vector<std::pair<Val*, uint64_t>> key_objs;
 
 	using ValCache = std::map<const CallExpr*, Val*>;
 	ValCache cache;
@@ -55,4 +55,22 @@ bool operator==(const EncapsulationStack& e1, const EncapsulationStack& e2)
 	return true;
 	}
 
+const std::shared_ptr<EncapsulationStack>& EncapsulationCache::Get(const std::shared_ptr<EncapsulationStack>& arg_outer,
+                                                                   const EncapsulatingConn& arg_ec)
+	{
+	if ( inner && outer == arg_outer && ec == arg_ec )
+		return inner;
+
+	outer = arg_outer;
+	ec = arg_ec;
+
+	if ( outer )
+		inner = std::make_shared<EncapsulationStack>(*outer);
+	else
+		inner = std::make_shared<EncapsulationStack>();
+
+	inner->Add(ec);
+	return inner;
+	}
+
 } // namespace zeek
@@ -4,6 +4,7 @@
 
 #include "zeek-config.h"
 
+#include <memory>
 #include <vector>
 
 #include "NetVar.h"
@@ -70,6 +71,8 @@ public:
 		  proto(other.proto), type(other.type), uid(other.uid)
 		{}
 
+	EncapsulatingConn& operator=(const EncapsulatingConn& other) = default;
+
 	/**
 	 * Destructor.
 	 */
@@ -228,4 +231,36 @@ protected:
 	std::vector<EncapsulatingConn>* conns;
 };
 
+/**
+ * Holds the encapsulation stack of the packets found inside a tunnel, that
+ * is, the tunnel's own encapsulation with the tunnel appended. The stack
+ * only gets rebuilt when either of those changes, so that all the inner
+ * packets of a tunnel share it instead of each building their own. A stack
+ * handed out must not be modified.
+ */
+class EncapsulationCache {
+public:
+	/**
+	 * Returns the stack for packets inside a tunnel.
+	 *
+	 * @param outer The encapsulation of the tunnel itself, if any. It is
+	 *        recognized by identity, and so mustn't be modified while
+	 *        there's a stack built from it.
+	 * @param ec The tunnel.
+	 */
+	const std::shared_ptr<EncapsulationStack>& Get(const std::shared_ptr<EncapsulationStack>& outer,
+	                                               const EncapsulatingConn& ec);
+
+	/**
+	 * Drops the stack.
+	 */
+	void Clear()
+		{ outer = nullptr; inner = nullptr; }
+
+private:
+	std::shared_ptr<EncapsulationStack> outer;
+	EncapsulatingConn ec;
+	std::shared_ptr<EncapsulationStack> inner;
+};
+
 } // namespace zeek
@@ -9,6 +9,7 @@
 #include "Scope.h"
 #include "Val.h"
 #include "Var.h"
+#include "ID.h"
 #include "Reporter.h"
 #include "zeekygen/Manager.h"
 #include "zeekygen/IdentifierInfo.h"
@@ -19,6 +20,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <unordered_map>
 
 using namespace std;
 
@@ -887,6 +889,20 @@ int RecordType::FieldOffset(const char* field) const
 	return -1;
 	}
 
+void RecordFieldHandle::Resolve() const
+	{
+	const auto& t = id::find_type(type_name);
+
+	if ( t->Tag() != TYPE_RECORD )
+		reporter->InternalError("Expected '%s' to be a record type", type_name);
+
+	offset = t->AsRecordType()->FieldOffset(field_name);
+
+	if ( offset < 0 )
+		reporter->InternalError("Field '%s' not found in record type '%s'",
+		                        field_name, type_name);
+	}
+
 const char* RecordType::FieldName(int field) const
 	{
 	return FieldDecl(field)->id;
@@ -1580,6 +1596,55 @@ static bool is_init_compat(const Type& t1, const Type& t2)
 	return false;
 	}
 
+namespace {
+
+struct SameTypeKey {
+	const Type* t1;
+	const Type* t2;
+	bool is_init;
+	bool match_record_field_names;
+
+	bool operator==(const SameTypeKey& other) const
+		{
+		return t1 == other.t1 && t2 == other.t2 &&
+		       is_init == other.is_init &&
+		       match_record_field_names == other.match_record_field_names;
+		}
+};
+
+struct SameTypeKeyHash {
+	size_t operator()(const SameTypeKey& k) const
+		{
+		auto h = std::hash<const Type*>()(k.t1);
+		h ^= std::hash<const Type*>()(k.t2) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		return h ^ (k.is_init << 1) ^ k.match_record_field_names;
+		}
+};
+
+struct SameTypeResult {
+	// Keeps the types alive, so that their addresses don't get reused
+	// by other types while they're part of a key.
+	TypePtr t1;
+	TypePtr t2;
+	bool same;
+};
+
+} // namespace
+
+// The results of comparing compound types, once script parsing is done
+// and redefs can't change them anymore.
+static bool same_type_memo_active = false;
+static std::unordered_map<SameTypeKey, SameTypeResult, SameTypeKeyHash> same_type_memo;
+static constexpr size_t SAME_TYPE_MEMO_MAX_SIZE = 16384;
+
+void memoize_same_type()
+	{
+	same_type_memo_active = true;
+	}
+
+static bool compare_types(const Type* t1, const Type* t2,
+                          bool is_init, bool match_record_field_names);
+
 bool same_type(const Type& arg_t1, const Type& arg_t2,
                bool is_init, bool match_record_field_names)
 	{
@@ -1602,6 +1667,41 @@ bool same_type(const Type& arg_t1, const Type& arg_t2,
 		return false;
 		}
 
+	switch ( t1->Tag() ) {
+	case TYPE_TABLE:
+	case TYPE_RECORD:
+	case TYPE_LIST:
+	case TYPE_VECTOR:
+		// Function types aren't memoized, since their comparison
+		// warns about mismatching arguments.
+		if ( same_type_memo_active )
+			break;
+
+		// Fall through.
+	default:
+		return compare_types(t1, t2, is_init, match_record_field_names);
+	}
+
+	SameTypeKey key{t1, t2, is_init, match_record_field_names};
+
+	if ( auto it = same_type_memo.find(key); it != same_type_memo.end() )
+		return it->second.same;
+
+	bool same = compare_types(t1, t2, is_init, match_record_field_names);
+
+	if ( same_type_memo.size() >= SAME_TYPE_MEMO_MAX_SIZE )
+		same_type_memo.clear();
+
+	same_type_memo.emplace(key, SameTypeResult{{NewRef{}, const_cast<Type*>(t1)},
+	                                           {NewRef{}, const_cast<Type*>(t2)},
+	                                           same});
+	return same;
+	}
+
+// Compares two flattened types that have the same tag.
+static bool compare_types(const Type* t1, const Type* t2,
+                          bool is_init, bool match_record_field_names)
+	{
 	switch ( t1->Tag() ) {
 	case TYPE_VOID:
 	case TYPE_BOOL:
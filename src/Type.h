@@ -644,6 +644,53 @@ protected:
 	type_decl_list* types;
 };
 
+/**
+ * A handle on a field of a script-level record type, for C++ code that
+ * would otherwise look the field up by name on every access. The name gets
+ * resolved on first use and the offset cached from then on, which stays
+ * valid across redefs since those only append fields. Declare handles
+ * once, typically as statics, and pass them wherever a field offset is
+ * expected:
+ *
+ *     static RecordFieldHandle orig_h{"conn_id", "orig_h"};
+ *     const auto& a = id_val->GetField(orig_h)->AsAddr();
+ */
+class RecordFieldHandle {
+public:
+	/**
+	 * Constructor. Doesn't resolve the field yet, so handles can be
+	 * declared before the scripts defining the type have been parsed.
+	 *
+	 * @param type_name The global name of the record type.
+	 *
+	 * @param field_name The name of the field.
+	 */
+	constexpr RecordFieldHandle(const char* type_name, const char* field_name)
+		: type_name(type_name), field_name(field_name)
+		{ }
+
+	/**
+	 * Returns the field's offset. It is an internal error if the type or
+	 * the field doesn't exist.
+	 */
+	int Offset() const
+		{
+		if ( offset < 0 )
+			Resolve();
+
+		return offset;
+		}
+
+	operator int() const	{ return Offset(); }
+
+private:
+	void Resolve() const;
+
+	const char* type_name;
+	const char* field_name;
+	mutable int offset = -1;
+};
+
 class SubNetType final : public Type {
 public:
 	SubNetType();
@@ -778,6 +825,11 @@ inline bool same_type(const Type* t1, const TypePtr& t2,
                       bool is_init=false, bool match_record_field_names=true)
     { return same_type(*t1, *t2, is_init, match_record_field_names); }
 
+// Makes same_type() remember its results for compound types other than
+// functions. Called once script parsing is done, as record redefs may
+// change types until then.
+extern void memoize_same_type();
+
 // True if the two attribute lists are equivalent.
 extern bool same_attrs(const detail::Attributes* a1, const detail::Attributes* a2);
 
@@ -887,10 +939,14 @@ extern zeek::OpaqueTypePtr sha256_type;
 extern zeek::OpaqueTypePtr entropy_type;
 extern zeek::OpaqueTypePtr cardinality_type;
 extern zeek::OpaqueTypePtr topk_type;
+extern zeek::OpaqueTypePtr quantile_type;
 extern zeek::OpaqueTypePtr bloomfilter_type;
+extern zeek::OpaqueTypePtr cuckoofilter_type;
 extern zeek::OpaqueTypePtr x509_opaque_type;
 extern zeek::OpaqueTypePtr ocsp_resp_opaque_type;
 extern zeek::OpaqueTypePtr paraglob_type;
+extern zeek::OpaqueTypePtr pattern_set_type;
+extern zeek::OpaqueTypePtr base64_decoder_type;
 
 using BroType [[deprecated("Remove in v4.1. Use zeek::Type instead.")]] = zeek::Type;
 using TypeList [[deprecated("Remove in v4.1. Use zeek::TypeList instead.")]] = zeek::TypeList;
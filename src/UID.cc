@@ -4,8 +4,11 @@
 #include "Reporter.h"
 #include "util.h"
 
+#include <algorithm>
 #include <cstdlib>
 
+#include "3rdparty/doctest.h"
+
 using namespace std;
 
 namespace zeek {
@@ -23,8 +26,13 @@ void UID::Set(bro_uint_t bits, const uint64_t* v, size_t n)
 	div_t res = div(bits, 64);
 	size_t size = res.rem ? res.quot + 1 : res.quot;
 
-	for ( size_t i = 0; i < size; ++i )
-		uid[i] = v && i < n ? v[i] : util::calculate_unique_id();
+	size_t given = v ? std::min(n, size) : 0;
+
+	for ( size_t i = 0; i < given; ++i )
+		uid[i] = v[i];
+
+	if ( given < size )
+		util::calculate_unique_ids(UID_POOL_DEFAULT_INTERNAL, uid + given, size - given);
 
 	if ( res.rem )
 		uid[0] >>= 64 - res.rem;
@@ -35,11 +43,37 @@ std::string UID::Base62(std::string prefix) const
 	if ( ! initialized )
 		reporter->InternalError("use of uninitialized UID");
 
-	char tmp[sizeof(uid) * 8 + 1];  // enough for even binary representation
+	static constexpr char dig[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+	// 11 digits cover 64 bits. Like util::uitoa_n(), which this used
+	// to call, the digits go least significant first.
+	char tmp[BRO_UID_LEN * 11];
+	char* p = tmp;
+
 	for ( size_t i = 0; i < BRO_UID_LEN; ++i )
-		prefix.append(util::uitoa_n(uid[i], tmp, sizeof(tmp), 62));
+		{
+		uint64_t v = uid[i];
 
+		do {
+			*p++ = dig[v % 62];
+			v /= 62;
+		} while ( v );
+		}
+
+	prefix.append(tmp, p - tmp);
 	return prefix;
 	}
 
+TEST_CASE("uid base62")
+	{
+	uint64_t v[] = {0, 61};
+	CHECK(UID(128, v, 2).Base62("C") == "C0Z");
+
+	// Matches the digits util::uitoa_n() produces.
+	uint64_t w[] = {UINT64_MAX, 1234567890123};
+	char a[65], b[65];
+	CHECK(UID(128, w, 2).Base62() ==
+	      std::string(util::uitoa_n(w[0], a, sizeof(a), 62)) + util::uitoa_n(w[1], b, sizeof(b), 62));
+	}
+
 } // namespace zeek
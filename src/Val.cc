@@ -13,9 +13,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <chrono>
 #include <cmath>
 #include <set>
 
+#include "AllocationProfiler.h"
+#include "ValArena.h"
+#include "LoopTrace.h"
 #include "Attr.h"
 #include "ZeekString.h"
 #include "CompHash.h"
@@ -31,9 +35,13 @@
 #include "NetVar.h"
 #include "Expr.h"
 #include "PrefixTable.h"
+#include "OrderedIndex.h"
+#include "CompactSet.h"
+#include "ExpireIndex.h"
 #include "Conn.h"
 #include "Reporter.h"
 #include "IPAddr.h"
+#include "plugin/Manager.h"
 #include "ID.h"
 
 #include "broker/Data.h"
@@ -72,6 +80,9 @@ Val::Val(FilePtr f)
 
 Val::~Val()
 	{
+	if ( plugin::detail::val_dtor_types & (1u << type->Tag()) )
+		NotifyPluginsOnDtor();
+
 	if ( type->InternalType() == TYPE_INTERNAL_STRING )
 		delete val.string_val;
 
@@ -86,6 +97,23 @@ Val::~Val()
 #endif
 	}
 
+void* Val::operator new(size_t size)
+	{
+	if ( detail::val_arena )
+		if ( void* p = detail::val_arena->Allocate(size) )
+			return p;
+
+	return ::operator new(size);
+	}
+
+void Val::operator delete(void* ptr, size_t size)
+	{
+	if ( detail::val_arena && detail::val_arena->Owns(ptr) )
+		detail::val_arena->Free(ptr);
+	else
+		::operator delete(ptr);
+	}
+
 #define CONVERTER(tag, ctype, name) \
 	ctype name() \
 		{ \
@@ -327,6 +355,19 @@ unsigned int Val::MemoryAllocation() const
 	return padded_sizeof(*this);
 	}
 
+uint64_t Val::Footprint(std::unordered_set<const void*>* seen) const
+	{
+	if ( ! seen->insert(this).second )
+		return 0;
+
+	return ComputeFootprint(seen);
+	}
+
+uint64_t Val::ComputeFootprint(std::unordered_set<const void*>* seen) const
+	{
+	return MemoryAllocation();
+	}
+
 bool Val::AddTo(Val* v, bool is_first_init) const
 	{
 	Error("+= initializer only applies to aggregate values");
@@ -567,6 +608,18 @@ static void BuildJSON(threading::formatter::JSON::NullDoubleWriter& writer, Val*
 			auto* table = val->AsTable();
 			auto* tval = val->AsTableVal();
 
+			if ( auto cs = tval->CompactStorage() )
+				{
+				writer.StartArray();
+				size_t pos = 0;
+
+				while ( auto index = cs->Next(&pos) )
+					BuildJSON(writer, index.get(), only_loggable, re);
+
+				writer.EndArray();
+				break;
+				}
+
 			if ( tval->GetType()->IsSet() )
 				writer.StartArray();
 			else
@@ -1335,6 +1388,17 @@ unsigned int ListVal::MemoryAllocation() const
 	return size + padded_sizeof(*this) + type->MemoryAllocation();
 	}
 
+uint64_t ListVal::ComputeFootprint(std::unordered_set<const void*>* seen) const
+	{
+	uint64_t size = padded_sizeof(*this)
+		+ util::pad_size(vals.capacity() * sizeof(decltype(vals)::value_type));
+
+	for ( const auto& val : vals )
+		size += val->Footprint(seen);
+
+	return size;
+	}
+
 TableEntryVal* TableEntryVal::Clone(Val::CloneState* state)
 	{
 	auto rval = new TableEntryVal(val ? val->Clone(state) : nullptr);
@@ -1407,11 +1471,37 @@ static void find_nested_record_types(const TypePtr& t, std::set<RecordType*>* fo
 	}
 	}
 
+// Whether values of the given type never change once created, so that
+// copy-on-write clones of containers holding them can share them.
+static bool is_immutable_type(const TypePtr& t)
+	{
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+	case TYPE_PORT:
+	case TYPE_ENUM:
+	case TYPE_ADDR:
+	case TYPE_SUBNET:
+	case TYPE_STRING:
+		return true;
+	default:
+		return false;
+	}
+	}
+
 TableVal::TableVal(TableTypePtr t, detail::AttributesPtr a) : Val(t)
 	{
 	Init(std::move(t));
 	SetAttrs(std::move(a));
 
+	if ( detail::alloc_profiler )
+		detail::alloc_profiler->Allocated(this);
+
 	if ( ! run_state::is_parsing )
 		return;
 
@@ -1444,34 +1534,120 @@ void TableVal::Init(TableTypePtr t)
 	table_hash = new detail::CompositeHash(table_type->GetIndices());
 	val.table_val = new PDict<TableEntryVal>;
 	val.table_val->SetDeleteFunc(table_entry_val_delete_func);
+	val.table_val->SetMemoryTag(detail::MemoryTag::Tables);
 	}
 
 TableVal::~TableVal()
 	{
+	if ( detail::alloc_profiler )
+		detail::alloc_profiler->Freed(this);
+
 	if ( timer )
 		detail::timer_mgr->Cancel(timer);
 
 	delete table_hash;
-	delete AsTable();
+
+	if ( ! shared_table )
+		delete AsTable();
+
 	delete subnets;
+	delete ordered_index;
+	delete expire_index;
+	}
+
+detail::TableUsage* TableVal::CountUsage()
+	{
+	if ( ! detail::table_profiling )
+		return nullptr;
+
+	if ( ! usage )
+		usage = std::make_unique<detail::TableUsage>();
+
+	return usage.get();
+	}
+
+void TableVal::CountIterations(uint64_t n)
+	{
+	if ( auto u = CountUsage() )
+		u->iterations += n;
+	}
+
+bool TableVal::CanShareStorage() const
+	{
+	// Expiration updates entries on access, and the prefix table
+	// points right at them.
+	if ( expire_time || subnets )
+		return false;
+
+	return table_type->IsSet() || is_immutable_type(table_type->Yield());
+	}
+
+void TableVal::Unshare()
+	{
+	if ( compact )
+		{
+		if ( compact.use_count() > 1 )
+			compact = std::make_shared<detail::CompactSet>(*compact);
+
+		return;
+		}
+
+	// Once all clones are gone, the storage is ours alone again.
+	if ( ! shared_table || shared_table.use_count() == 1 )
+		return;
+
+	auto tbl = new PDict<TableEntryVal>;
+	tbl->SetDeleteFunc(table_entry_val_delete_func);
+	tbl->SetMemoryTag(detail::MemoryTag::Tables);
+
+	IterCookie* cookie = val.table_val->InitForIteration();
+	detail::HashKey* key;
+	TableEntryVal* v;
+
+	while ( (v = val.table_val->NextEntry(key, cookie)) )
+		{
+		// The values are immutable, so the copy can share them.
+		tbl->Insert(key, new TableEntryVal(*v));
+		delete key;
+		}
+
+	val.table_val = tbl;
+	shared_table.reset();
 	}
 
 void TableVal::RemoveAll()
 	{
+	if ( compact )
+		compact = std::make_shared<detail::CompactSet>(compact->Tag());
+
 	// Here we take the brute force approach.
-	delete AsTable();
+	if ( shared_table )
+		shared_table.reset();
+	else
+		delete AsTable();
+
 	val.table_val = new PDict<TableEntryVal>;
 	val.table_val->SetDeleteFunc(table_entry_val_delete_func);
+	val.table_val->SetMemoryTag(detail::MemoryTag::Tables);
+
+	if ( ordered_index )
+		ordered_index->Clear();
+
+	if ( expire_index )
+		expire_index->Clear();
 	}
 
 int TableVal::Size() const
 	{
+	if ( compact )
+		return compact->Size();
+
 	return AsTable()->Length();
 	}
 
 int TableVal::RecursiveSize() const
 	{
-	int n = AsTable()->Length();
+	int n = Size();
 
 	if ( GetType()->IsSet() ||
 	     GetType()->AsTableType()->Yield()->Tag() != TYPE_TABLE )
@@ -1511,6 +1687,21 @@ void TableVal::SetAttrs(detail::AttributesPtr a)
 	if ( cf )
 		change_func = cf->GetExpr();
 
+	if ( attrs->Find(detail::ATTR_ORDERED_INDEX) && ! ordered_index )
+		{
+		ordered_index = new detail::OrderedIndex;
+
+		const PDict<TableEntryVal>* tbl = AsTable();
+		IterCookie* c = tbl->InitForIteration();
+		detail::HashKey* k;
+
+		while ( tbl->NextEntry(k, c) )
+			{
+			ordered_index->Insert(RecreateIndex(*k));
+			delete k;
+			}
+		}
+
 	auto bs = attrs->Find(detail::ATTR_BROKER_STORE);
 	if ( bs && broker_store.empty() )
 		{
@@ -1520,6 +1711,29 @@ void TableVal::SetAttrs(detail::AttributesPtr a)
 		broker_store = c->AsStringVal()->AsString()->CheckString();
 		broker_mgr->AddForwardedStore(broker_store, {NewRef{}, this});
 		}
+
+	// Attributes following &compact haven't been checked against it, so
+	// this makes sure none of them needs regular entries.
+	if ( attrs->Find(detail::ATTR_COMPACT) && ! compact &&
+	     detail::CompactSet::IsCompactable(table_type.get()) &&
+	     ! expire_time && ! expire_func && ! change_func && ! ordered_index &&
+	     broker_store.empty() && ! attrs->Find(detail::ATTR_BACKEND) )
+		{
+		auto cs = std::make_shared<detail::CompactSet>(table_type->GetIndexTypes()[0]->Tag());
+
+		const PDict<TableEntryVal>* tbl = AsTable();
+		IterCookie* c = tbl->InitForIteration();
+		detail::HashKey* k;
+
+		while ( tbl->NextEntry(k, c) )
+			{
+			cs->Insert(*RecreateIndex(*k)->Idx(0));
+			delete k;
+			}
+
+		RemoveAll();
+		compact = std::move(cs);
+		}
 	}
 
 void TableVal::CheckExpireAttr(detail::AttrTag at)
@@ -1550,6 +1764,9 @@ void TableVal::CheckExpireAttr(detail::AttrTag at)
 
 bool TableVal::Assign(ValPtr index, ValPtr new_val, bool broker_forward)
 	{
+	if ( compact )
+		return AssignCompact(*index);
+
 	auto k = MakeHashKey(*index);
 
 	if ( ! k )
@@ -1569,15 +1786,31 @@ bool TableVal::Assign(Val* index, Val* new_val)
 bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k,
                       ValPtr new_val, bool broker_forward)
 	{
+	if ( compact )
+		return AssignCompact(index ? *index : *RecreateIndex(*k));
+
 	bool is_set = table_type->IsSet();
 
 	if ( (is_set && new_val) || (! is_set && ! new_val) )
 		InternalWarning("bad set/table in TableVal::Assign");
 
+	Unshare();
+
+	auto u = CountUsage();
+	int capacity = u ? AsTable()->Capacity() : 0;
+
 	TableEntryVal* new_entry_val = new TableEntryVal(std::move(new_val));
 	detail::HashKey k_copy(k->Key(), k->Size(), k->Hash());
 	TableEntryVal* old_entry_val = AsNonConstTable()->Insert(k.get(), new_entry_val);
 
+	if ( u )
+		{
+		++u->inserts;
+
+		if ( AsTable()->Capacity() != capacity )
+			++u->resizes;
+		}
+
 	// If the dictionary index already existed, the insert may free up the
 	// memory allocated to the key bytes, so have to assume k is invalid
 	// from here on out.
@@ -1594,11 +1827,27 @@ bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k,
 			subnets->Insert(index.get(), new_entry_val);
 		}
 
+	if ( ordered_index )
+		{
+		if ( index && index->GetType()->Tag() == TYPE_LIST )
+			ordered_index->Insert({NewRef{}, index->AsListVal()});
+		else
+			ordered_index->Insert(RecreateIndex(k_copy));
+		}
+
 	// Keep old expiration time if necessary.
 	if ( old_entry_val && attrs && attrs->Find(detail::ATTR_EXPIRE_CREATE) )
 		new_entry_val->SetExpireAccess(old_entry_val->ExpireAccessTime());
 
-	Modified();
+	if ( expire_index )
+		{
+		if ( old_entry_val )
+			expire_index->Remove(old_entry_val);
+
+		expire_index->Insert(new_entry_val, k_copy);
+		}
+
+	Modified(k_copy.Hash());
 
 	if ( change_func || ( broker_forward && ! broker_store.empty() ) )
 		{
@@ -1625,6 +1874,50 @@ bool TableVal::Assign(Val* index, detail::HashKey* k, Val* new_val)
 	return Assign({NewRef{}, index}, std::unique_ptr<detail::HashKey>{k}, {AdoptRef{}, new_val});
 	}
 
+// Returns the element of a compact set an index refers to.
+static const Val* compact_element(const Val& index)
+	{
+	if ( index.GetType()->Tag() == TYPE_LIST && index.AsListVal()->Length() == 1 )
+		return index.AsListVal()->Idx(0).get();
+
+	return &index;
+	}
+
+bool TableVal::AssignCompact(const Val& index)
+	{
+	auto v = compact_element(index);
+
+	if ( v->GetType()->Tag() != compact->Tag() )
+		{
+		index.Error("index type doesn't match table", table_type->GetIndices().get());
+		return false;
+		}
+
+	if ( auto u = CountUsage() )
+		++u->inserts;
+
+	if ( ! compact->Contains(*v) )
+		{
+		Unshare();
+		compact->Insert(*v);
+		}
+
+	Modified();
+	return true;
+	}
+
+bool TableVal::HasIndex(const Val& index) const
+	{
+	if ( compact )
+		{
+		auto v = compact_element(index);
+		return v->GetType()->Tag() == compact->Tag() && compact->Contains(*v);
+		}
+
+	auto k = MakeHashKey(index);
+	return k && AsTable()->Lookup(k.get());
+	}
+
 ValPtr TableVal::SizeVal() const
 	{
 	return val_mgr->Count(Size());
@@ -1651,6 +1944,28 @@ bool TableVal::AddTo(Val* val, bool is_first_init, bool propagate_ops) const
 		return false;
 		}
 
+	if ( compact )
+		{
+		// Holding on to the elements keeps them unchanged if t is
+		// this set.
+		auto elems = compact;
+		size_t pos = 0;
+
+		while ( auto index = elems->Next(&pos) )
+			{
+			if ( is_first_init && t->HasIndex(*index) )
+				{
+				index->Warn("multiple initializations for index");
+				continue;
+				}
+
+			if ( ! t->Assign(std::move(index), nullptr) )
+				return false;
+			}
+
+		return true;
+		}
+
 	const PDict<TableEntryVal>* tbl = AsTable();
 	IterCookie* c = tbl->InitForIteration();
 
@@ -1699,6 +2014,17 @@ bool TableVal::RemoveFrom(Val* val) const
 		return false;
 		}
 
+	if ( compact )
+		{
+		auto elems = compact;
+		size_t pos = 0;
+
+		while ( auto index = elems->Next(&pos) )
+			t->Remove(*index);
+
+		return true;
+		}
+
 	const PDict<TableEntryVal>* tbl = AsTable();
 	IterCookie* c = tbl->InitForIteration();
 
@@ -1721,6 +2047,25 @@ TableValPtr TableVal::Intersection(const TableVal& tv) const
 	{
 	auto result = make_intrusive<TableVal>(table_type);
 
+	if ( compact || tv.compact )
+		{
+		// Hash keys don't help with compact sets, so this goes
+		// through the elements of the smaller set instead.
+		const TableVal* t0 = this;
+		const TableVal* t1 = &tv;
+
+		if ( t1->Size() > t0->Size() )
+			std::swap(t0, t1);
+
+		auto indices = t1->ToPureListVal();
+
+		for ( const auto& index : indices->Vals() )
+			if ( t0->HasIndex(*index) )
+				result->Assign(index, nullptr);
+
+		return result;
+		}
+
 	const PDict<TableEntryVal>* t0 = AsTable();
 	const PDict<TableEntryVal>* t1 = tv.AsTable();
 	PDict<TableEntryVal>* t2 = result->AsNonConstTable();
@@ -1750,6 +2095,9 @@ TableValPtr TableVal::Intersection(const TableVal& tv) const
 
 bool TableVal::EqualTo(const TableVal& tv) const
 	{
+	if ( compact || tv.compact )
+		return Size() == tv.Size() && IsSubsetOf(tv);
+
 	const PDict<TableEntryVal>* t0 = AsTable();
 	const PDict<TableEntryVal>* t1 = tv.AsTable();
 
@@ -1777,6 +2125,20 @@ bool TableVal::EqualTo(const TableVal& tv) const
 
 bool TableVal::IsSubsetOf(const TableVal& tv) const
 	{
+	if ( compact || tv.compact )
+		{
+		if ( Size() > tv.Size() )
+			return false;
+
+		auto indices = ToPureListVal();
+
+		for ( const auto& index : indices->Vals() )
+			if ( ! tv.HasIndex(*index) )
+				return false;
+
+		return true;
+		}
+
 	const PDict<TableEntryVal>* t0 = AsTable();
 	const PDict<TableEntryVal>* t1 = tv.AsTable();
 
@@ -1940,13 +2302,24 @@ ValPtr TableVal::Default(const ValPtr& index)
 
 const ValPtr& TableVal::Find(const ValPtr& index)
 	{
+	if ( auto u = CountUsage() )
+		++u->lookups;
+
+	if ( compact )
+		{
+		if ( HasIndex(*index) )
+			return val_mgr->True();
+
+		return Val::nil;
+		}
+
 	if ( subnets )
 		{
 		TableEntryVal* v = (TableEntryVal*) subnets->Lookup(index.get());
 		if ( v )
 			{
 			if ( attrs && attrs->Find(detail::ATTR_EXPIRE_READ) )
-				v->SetExpireAccess(run_state::network_time);
+				TouchEntry(v, run_state::network_time);
 
 			if ( v->GetVal() )
 				return v->GetVal();
@@ -1970,7 +2343,7 @@ const ValPtr& TableVal::Find(const ValPtr& index)
 			if ( v )
 				{
 				if ( attrs && attrs->Find(detail::ATTR_EXPIRE_READ) )
-					v->SetExpireAccess(run_state::network_time);
+					TouchEntry(v, run_state::network_time);
 
 				if ( v->GetVal() )
 					return v->GetVal();
@@ -2053,13 +2426,51 @@ TableValPtr TableVal::LookupSubnetValues(const SubNetVal* search)
 		if ( entry )
 			{
 			if ( attrs && attrs->Find(detail::ATTR_EXPIRE_READ) )
-				entry->SetExpireAccess(run_state::network_time);
+				TouchEntry(entry, run_state::network_time);
 			}
 		}
 
 	return nt;
 	}
 
+TableValPtr TableVal::LookupPrefixValues(const std::vector<const Val*>& prefix)
+	{
+	if ( ! ordered_index )
+		reporter->InternalError("LookupPrefixValues called on wrong table type");
+
+	return CopyEntries(ordered_index->FindPrefix(prefix));
+	}
+
+TableValPtr TableVal::LookupRangeValues(const Val* lo, const Val* hi)
+	{
+	if ( ! ordered_index )
+		reporter->InternalError("LookupRangeValues called on wrong table type");
+
+	return CopyEntries(ordered_index->FindRange(lo, hi));
+	}
+
+TableValPtr TableVal::CopyEntries(const std::vector<ListValPtr>& indices)
+	{
+	auto nt = make_intrusive<TableVal>(this->GetType<TableType>());
+	bool expire_read = attrs && attrs->Find(detail::ATTR_EXPIRE_READ);
+
+	for ( const auto& idx : indices )
+		{
+		auto k = MakeHashKey(*idx);
+		TableEntryVal* entry = k ? AsTable()->Lookup(k.get()) : nullptr;
+
+		if ( ! entry )
+			continue;
+
+		nt->Assign(idx, entry->GetVal());
+
+		if ( expire_read )
+			TouchEntry(entry, run_state::network_time);
+		}
+
+	return nt;
+	}
+
 bool TableVal::UpdateTimestamp(Val* index)
 	{
 	TableEntryVal* v;
@@ -2079,7 +2490,7 @@ bool TableVal::UpdateTimestamp(Val* index)
 	if ( ! v )
 		return false;
 
-	v->SetExpireAccess(run_state::network_time);
+	TouchEntry(v, run_state::network_time);
 
 	return true;
 	}
@@ -2089,6 +2500,11 @@ ListValPtr TableVal::RecreateIndex(const detail::HashKey& k) const
 	return table_hash->RecoverVals(k);
 	}
 
+void TableVal::RecreateIndex(const detail::HashKey& k, ValPtr* vals) const
+	{
+	table_hash->RecoverVals(k, vals);
+	}
+
 void TableVal::CallChangeFunc(const ValPtr& index,
                               const ValPtr& old_value,
                               OnChangeType tpe)
@@ -2160,11 +2576,31 @@ void TableVal::CallChangeFunc(const ValPtr& index,
 	in_change_func = false;
 	}
 
-void TableVal::SendToStore(const Val* index, const TableEntryVal* new_entry_val, OnChangeType tpe)
+void TableVal::SendToStore(const Val* index, const TableEntryVal* new_entry_val, OnChangeType tpe,
+                           bool flushing)
 	{
 	if ( broker_store.empty() || ! index )
 		return;
 
+	if ( ! flushing && broker_mgr->TableStoreFlushInterval() > 0 )
+		{
+		auto k = MakeHashKey(*index);
+
+		if ( ! k )
+			return;
+
+		std::string key(static_cast<const char*>(k->Key()), k->Size());
+
+		if ( tpe != ELEMENT_REMOVED )
+			{
+			pending_store_updates.emplace(std::move(key), ValPtr{NewRef{}, const_cast<Val*>(index)});
+			return;
+			}
+
+		// A pending update must not resurrect the entry.
+		pending_store_updates.erase(key);
+		}
+
 	try
 		{
 		auto handle = broker_mgr->LookupStore(broker_store);
@@ -2272,22 +2708,77 @@ void TableVal::SendToStore(const Val* index, const TableEntryVal* new_entry_val,
 		}
 	}
 
+void TableVal::FlushStoreUpdates()
+	{
+	if ( pending_store_updates.empty() )
+		return;
+
+	auto pending = std::move(pending_store_updates);
+	pending_store_updates.clear();
+
+	for ( const auto& p : pending )
+		{
+		auto k = MakeHashKey(*p.second);
+
+		if ( ! k )
+			continue;
+
+		// Skip entries that expired in the meantime.
+		if ( auto entry = AsTable()->Lookup(k.get()) )
+			SendToStore(p.second.get(), entry, ELEMENT_CHANGED, true);
+		}
+	}
+
 ValPtr TableVal::Remove(const Val& index, bool broker_forward)
 	{
+	if ( compact )
+		{
+		ValPtr va;
+
+		if ( HasIndex(index) )
+			{
+			Unshare();
+			compact->Remove(*compact_element(index));
+			va = IntrusivePtr{NewRef{}, this};
+
+			if ( auto u = CountUsage() )
+				++u->deletes;
+			}
+
+		Modified();
+		return va;
+		}
+
 	auto k = MakeHashKey(index);
 
+	Unshare();
+
 	TableEntryVal* v = k ? AsNonConstTable()->RemoveEntry(k.get()) : nullptr;
 	ValPtr va;
 
 	if ( v )
+		{
 		va = v->GetVal() ? v->GetVal() : IntrusivePtr{NewRef{}, this};
 
+		if ( auto u = CountUsage() )
+			++u->deletes;
+		}
+
 	if ( subnets && ! subnets->Remove(&index) )
 		reporter->InternalWarning("index not in prefix table");
 
+	if ( ordered_index && v )
+		ordered_index->Remove(RecreateIndex(*k).get());
+
+	if ( expire_index && v )
+		expire_index->Remove(v);
+
 	delete v;
 
-	Modified();
+	if ( k )
+		Modified(k->Hash());
+	else
+		Modified();
 
 	if ( broker_forward && ! broker_store.empty() )
 		SendToStore(&index, nullptr, ELEMENT_REMOVED);
@@ -2304,12 +2795,22 @@ ValPtr TableVal::Remove(const Val& index, bool broker_forward)
 
 ValPtr TableVal::Remove(const detail::HashKey& k)
 	{
+	if ( compact )
+		return Remove(*RecreateIndex(k));
+
+	Unshare();
+
 	TableEntryVal* v = AsNonConstTable()->RemoveEntry(k);
 	ValPtr va;
 
 	if ( v )
+		{
 		va = v->GetVal() ? v->GetVal() : IntrusivePtr{NewRef{}, this};
 
+		if ( auto u = CountUsage() )
+			++u->deletes;
+		}
+
 	if ( subnets )
 		{
 		auto index = table_hash->RecoverVals(k);
@@ -2318,9 +2819,15 @@ ValPtr TableVal::Remove(const detail::HashKey& k)
 			reporter->InternalWarning("index not in prefix table");
 		}
 
+	if ( ordered_index && v )
+		ordered_index->Remove(RecreateIndex(k).get());
+
+	if ( expire_index && v )
+		expire_index->Remove(v);
+
 	delete v;
 
-	Modified();
+	Modified(k.Hash());
 
 	if ( va && ( change_func || ! broker_store.empty() ) )
 		{
@@ -2339,6 +2846,25 @@ ListValPtr TableVal::ToListVal(TypeTag t) const
 	{
 	auto l = make_intrusive<ListVal>(t);
 
+	if ( compact )
+		{
+		size_t pos = 0;
+
+		while ( auto index = compact->Next(&pos) )
+			{
+			if ( t == TYPE_ANY )
+				{
+				auto lv = make_intrusive<ListVal>(TYPE_ANY);
+				lv->Append(std::move(index));
+				l->Append(std::move(lv));
+				}
+			else
+				l->Append(std::move(index));
+			}
+
+		return l;
+		}
+
 	const PDict<TableEntryVal>* tbl = AsTable();
 	IterCookie* c = tbl->InitForIteration();
 
@@ -2393,6 +2919,16 @@ const detail::AttrPtr& TableVal::GetAttr(detail::AttrTag t) const
 
 void TableVal::Describe(ODesc* d) const
 	{
+	if ( compact )
+		{
+		// Describes a copy with regular entries. Sets to describe
+		// tend to be small, unlike the ones worth keeping compact.
+		auto tv = make_intrusive<TableVal>(table_type);
+		AddTo(tv.get(), false);
+		tv->Describe(d);
+		return;
+		}
+
 	const PDict<TableEntryVal>* tbl = AsTable();
 	int n = tbl->Length();
 
@@ -2555,8 +3091,6 @@ void TableVal::DoExpire(double t)
 	if ( ! type )
 		return; // FIX ME ###
 
-	PDict<TableEntryVal>* tbl = AsNonConstTable();
-
 	double timeout = GetExpireTime();
 
 	if ( timeout < 0 )
@@ -2564,98 +3098,183 @@ void TableVal::DoExpire(double t)
 		// error, it has been reported already.
 		return;
 
-	if ( ! expire_cookie )
-		{
-		expire_cookie = tbl->InitForIteration();
-		tbl->MakeRobustCookie(expire_cookie);
-		}
+	auto u = CountUsage();
+	auto start = u ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
 
-	detail::HashKey* k = nullptr;
-	TableEntryVal* v = nullptr;
-	TableEntryVal* v_saved = nullptr;
-	bool modified = false;
+	// Script-land is done setting up tables by the first pass, which
+	// is when table_expire_index is known.
+	if ( ! expire_index )
+		InitExpireIndex();
 
-	for ( int i = 0; i < zeek::detail::table_incremental_step &&
-		      (v = tbl->NextEntry(k, expire_cookie)); ++i )
+	uint32_t num_expired = 0;
+	bool done;
+
+	if ( expire_index )
 		{
-		if ( v->ExpireAccessTime() == 0 )
+		// The index holds the entries by age, so this can stop at the
+		// first one that isn't due.
+		std::unique_ptr<detail::HashKey> k;
+		TableEntryVal* v;
+		int i = 0;
+
+		for ( ; i < zeek::detail::table_incremental_step &&
+			      (v = expire_index->Oldest(&k)); ++i )
 			{
-			// This happens when we insert val while network_time
-			// hasn't been initialized yet (e.g. in zeek_init()), and
-			// also when bro_start_network_time hasn't been initialized
-			// (e.g. before first packet).  The expire_access_time is
-			// correct, so we just need to wait.
+			// The entries from before network time got initialized
+			// need to wait, like below.
+			if ( v->ExpireAccessTime() == 0 || v->ExpireAccessTime() + timeout >= t )
+				break;
+
+			if ( ExpireEntry(*k, v, timeout) )
+				++num_expired;
 			}
 
-		else if ( v->ExpireAccessTime() + timeout < t )
-			{
-			ListValPtr idx = nullptr;
+		done = i < zeek::detail::table_incremental_step;
+		}
 
-			if ( expire_func )
-				{
-				idx = RecreateIndex(*k);
-				double secs = CallExpireFunc(idx);
-
-				// It's possible that the user-provided
-				// function modified or deleted the table
-				// value, so look it up again.
-				v_saved = v;
-				v = tbl->Lookup(k);
-
-				if ( ! v )
-					{ // user-provided function deleted it
-					v = v_saved;
-					delete k;
-					continue;
-					}
+	else
+		{
+		PDict<TableEntryVal>* tbl = AsNonConstTable();
 
-				if ( secs > 0 )
-					{
-					// User doesn't want us to expire
-					// this now.
-					v->SetExpireAccess(run_state::network_time - timeout + secs);
-					delete k;
-					continue;
-					}
+		if ( ! expire_cookie )
+			{
+			expire_cookie = tbl->InitForIteration();
+			tbl->MakeRobustCookie(expire_cookie);
+			}
 
-				}
+		detail::HashKey* k = nullptr;
+		TableEntryVal* v = nullptr;
 
-			if ( subnets )
+		for ( int i = 0; i < zeek::detail::table_incremental_step &&
+			      (v = tbl->NextEntry(k, expire_cookie)); ++i )
+			{
+			if ( v->ExpireAccessTime() == 0 )
 				{
-				if ( ! idx )
-					idx = RecreateIndex(*k);
-				if ( ! subnets->Remove(idx.get()) )
-					reporter->InternalWarning("index not in prefix table");
+				// This happens when we insert val while network_time
+				// hasn't been initialized yet (e.g. in zeek_init()), and
+				// also when bro_start_network_time hasn't been initialized
+				// (e.g. before first packet).  The expire_access_time is
+				// correct, so we just need to wait.
 				}
 
-			tbl->RemoveEntry(k);
-			if ( change_func )
-				{
-				if ( ! idx )
-					idx = RecreateIndex(*k);
+			else if ( v->ExpireAccessTime() + timeout < t &&
+			          ExpireEntry(*k, v, timeout) )
+				++num_expired;
 
-				CallChangeFunc(idx, v->GetVal(), ELEMENT_EXPIRED);
-				}
-
-			delete v;
-			modified = true;
+			delete k;
 			}
 
-		delete k;
+		done = ! v;
+
+		if ( done )
+			expire_cookie = nullptr;
 		}
 
-	if ( modified )
+	if ( num_expired )
 		Modified();
 
-	if ( ! v )
+	if ( detail::loop_trace && num_expired )
+		detail::loop_trace->Record(detail::LoopTraceType::TABLE_EXPIRE, num_expired, 0);
+
+	if ( u )
 		{
-		expire_cookie = nullptr;
-		InitTimer(zeek::detail::table_expire_interval);
+		++u->expire_steps;
+		u->expirations += num_expired;
+		u->expire_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 		}
+
+	if ( done )
+		InitTimer(zeek::detail::table_expire_interval);
 	else
 		InitTimer(zeek::detail::table_expire_delay);
 	}
 
+bool TableVal::ExpireEntry(const detail::HashKey& k, TableEntryVal* v, double timeout)
+	{
+	PDict<TableEntryVal>* tbl = AsNonConstTable();
+	ListValPtr idx = nullptr;
+
+	if ( expire_func )
+		{
+		idx = RecreateIndex(k);
+		double secs = CallExpireFunc(idx);
+
+		// It's possible that the user-provided
+		// function modified or deleted the table
+		// value, so look it up again.
+		v = tbl->Lookup(&k);
+
+		if ( ! v )
+			// user-provided function deleted it
+			return false;
+
+		if ( secs > 0 )
+			{
+			// User doesn't want us to expire
+			// this now.
+			TouchEntry(v, run_state::network_time - timeout + secs);
+			return false;
+			}
+		}
+
+	if ( subnets )
+		{
+		if ( ! idx )
+			idx = RecreateIndex(k);
+		if ( ! subnets->Remove(idx.get()) )
+			reporter->InternalWarning("index not in prefix table");
+		}
+
+	if ( ordered_index )
+		{
+		if ( ! idx )
+			idx = RecreateIndex(k);
+		ordered_index->Remove(idx.get());
+		}
+
+	if ( expire_index )
+		expire_index->Remove(v);
+
+	tbl->RemoveEntry(k);
+	if ( change_func )
+		{
+		if ( ! idx )
+			idx = RecreateIndex(k);
+
+		CallChangeFunc(idx, v->GetVal(), ELEMENT_EXPIRED);
+		}
+
+	delete v;
+	return true;
+	}
+
+void TableVal::TouchEntry(TableEntryVal* v, double time)
+	{
+	if ( expire_index )
+		expire_index->Touch(v, time);
+	else
+		v->SetExpireAccess(time);
+	}
+
+void TableVal::InitExpireIndex()
+	{
+	if ( ! detail::table_expire_index )
+		return;
+
+	expire_index = new detail::ExpireIndex;
+
+	const PDict<TableEntryVal>* tbl = AsTable();
+	IterCookie* c = tbl->InitForIteration();
+	detail::HashKey* k;
+	TableEntryVal* v;
+
+	while ( (v = tbl->NextEntry(k, c)) )
+		{
+		expire_index->Insert(v, *k);
+		delete k;
+		}
+	}
+
 double TableVal::GetExpireTime()
 	{
 	if ( ! expire_time )
@@ -2678,6 +3297,9 @@ double TableVal::GetExpireTime()
 
 	expire_time = nullptr;
 
+	delete expire_index;
+	expire_index = nullptr;
+
 	if ( timer )
 		detail::timer_mgr->Cancel(timer);
 
@@ -2734,8 +3356,14 @@ double TableVal::CallExpireFunc(ListValPtr idx)
 				vl.emplace_back(std::move(idx));
 			}
 
+		auto u = CountUsage();
+		auto start = u ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
 		auto result = f->Invoke(&vl);
 
+		if ( u )
+			u->expire_func_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
 		if ( result )
 			secs = result->AsInterval();
 		}
@@ -2752,27 +3380,48 @@ ValPtr TableVal::DoClone(CloneState* state)
 	auto tv = make_intrusive<TableVal>(table_type);
 	state->NewClone(this, tv);
 
-	const PDict<TableEntryVal>* tbl = AsTable();
-	IterCookie* cookie = tbl->InitForIteration();
+	if ( compact )
+		{
+		// Either of them copies the elements once modified.
+		tv->compact = compact;
+		}
 
-	detail::HashKey* key;
-	TableEntryVal* val;
-	while ( (val = tbl->NextEntry(key, cookie)) )
+	else if ( detail::copy_on_write_clones && CanShareStorage() )
 		{
-		TableEntryVal* nval = val->Clone(state);
-		tv->AsNonConstTable()->Insert(key, nval);
+		if ( ! shared_table )
+			shared_table.reset(AsNonConstTable());
 
-		if ( subnets )
+		delete tv->AsNonConstTable();
+		tv->val.table_val = val.table_val;
+		tv->shared_table = shared_table;
+		}
+	else
+		{
+		const PDict<TableEntryVal>* tbl = AsTable();
+		IterCookie* cookie = tbl->InitForIteration();
+
+		detail::HashKey* key;
+		TableEntryVal* val;
+		while ( (val = tbl->NextEntry(key, cookie)) )
 			{
-			auto idx = RecreateIndex(*key);
-			tv->subnets->Insert(idx.get(), nval);
-			}
+			TableEntryVal* nval = val->Clone(state);
+			tv->AsNonConstTable()->Insert(key, nval);
 
-		delete key;
+			if ( subnets )
+				{
+				auto idx = RecreateIndex(*key);
+				tv->subnets->Insert(idx.get(), nval);
+				}
+
+			delete key;
+			}
 		}
 
 	tv->attrs = attrs;
 
+	if ( ordered_index )
+		tv->ordered_index = new detail::OrderedIndex(*ordered_index);
+
 	if ( expire_time )
 		{
 		tv->expire_time = expire_time;
@@ -2807,10 +3456,42 @@ unsigned int TableVal::MemoryAllocation() const
 		size += padded_sizeof(TableEntryVal);
 		}
 
+	if ( compact )
+		size += compact->MemoryAllocation();
+
 	return size + padded_sizeof(*this) + val.table_val->MemoryAllocation()
 		+ table_hash->MemoryAllocation();
 	}
 
+uint64_t TableVal::ComputeFootprint(std::unordered_set<const void*>* seen) const
+	{
+	uint64_t size = padded_sizeof(*this) + table_hash->MemoryAllocation();
+	PDict<TableEntryVal>* v = val.table_val;
+
+	// Clones share the elements of compact sets as well.
+	if ( compact && seen->insert(compact.get()).second )
+		size += compact->MemoryAllocation();
+
+	// Copy-on-write clones share the storage.
+	if ( ! seen->insert(v).second )
+		return size;
+
+	size += v->MemoryAllocation();
+
+	IterCookie* c = v->InitForIteration();
+	TableEntryVal* tv;
+
+	while ( (tv = v->NextEntry(c)) )
+		{
+		size += padded_sizeof(TableEntryVal);
+
+		if ( tv->GetVal() )
+			size += tv->GetVal()->Footprint(seen);
+		}
+
+	return size;
+	}
+
 detail::HashKey* TableVal::ComputeHash(const Val* index) const
 	{ return MakeHashKey(*index).release(); }
 
@@ -2889,8 +3570,10 @@ RecordVal::RecordVal(RecordTypePtr t, bool init_fields) : Val(std::move(t))
 	origin = nullptr;
 	auto rt = GetType()->AsRecordType();
 	int n = rt->NumFields();
-	auto vl = val.record_val = new std::vector<ValPtr>;
-	vl->reserve(n);
+	fields.reserve(n);
+
+	if ( detail::alloc_profiler )
+		detail::alloc_profiler->Allocated(this);
 
 	if ( run_state::is_parsing )
 		parse_time_records[rt].emplace_back(NewRef{}, this);
@@ -2916,7 +3599,9 @@ RecordVal::RecordVal(RecordTypePtr t, bool init_fields) : Val(std::move(t))
 				if ( run_state::is_parsing )
 					parse_time_records[rt].pop_back();
 
-				delete AsNonConstRecord();
+				if ( detail::alloc_profiler )
+					detail::alloc_profiler->Freed(this);
+
 				throw;
 				}
 
@@ -2947,13 +3632,82 @@ RecordVal::RecordVal(RecordTypePtr t, bool init_fields) : Val(std::move(t))
 				def = make_intrusive<VectorVal>(cast_intrusive<VectorType>(type));
 			}
 
-		vl->emplace_back(std::move(def));
+		fields.emplace_back(MakeField(type, std::move(def)));
 		}
 	}
 
 RecordVal::~RecordVal()
 	{
-	delete AsNonConstRecord();
+	if ( detail::alloc_profiler )
+		detail::alloc_profiler->Freed(this);
+	}
+
+RecordVal::Field RecordVal::MakeField(const TypePtr& t, ValPtr v)
+	{
+	Field f;
+
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		f.tag = t->Tag();
+		break;
+
+	default:
+		break;
+	}
+
+	SetField(f, std::move(v));
+	return f;
+	}
+
+void RecordVal::SetField(Field& f, ValPtr v)
+	{
+	f.is_set = v && f.tag != TYPE_VOID;
+
+	if ( f.is_set )
+		{
+		if ( f.tag == TYPE_COUNT )
+			f.uint_val = v->CoerceToUnsigned();
+		else if ( f.tag == TYPE_BOOL || f.tag == TYPE_INT )
+			f.int_val = v->CoerceToInt();
+		else
+			f.double_val = v->CoerceToDouble();
+		}
+
+	f.boxed = std::move(v);
+	}
+
+ValPtr RecordVal::Box(const Field& f)
+	{
+	switch ( f.tag ) {
+	case TYPE_BOOL:	return val_mgr->Bool(f.int_val);
+	case TYPE_INT:	return val_mgr->Int(f.int_val);
+	case TYPE_COUNT:	return val_mgr->Count(f.uint_val);
+	case TYPE_DOUBLE:	return make_intrusive<DoubleVal>(f.double_val);
+	case TYPE_TIME:	return make_intrusive<TimeVal>(f.double_val);
+	case TYPE_INTERVAL:	return make_intrusive<IntervalVal>(f.double_val);
+
+	default:
+		reporter->InternalError("bad unboxed record field");
+	}
+	}
+
+RecordVal::Field& RecordVal::AssignUnboxed(int field)
+	{
+	auto& f = fields[field];
+
+	if ( f.tag == TYPE_VOID )
+		reporter->InternalError("unboxed assignment to record field of type %s",
+		                        type_name(GetType()->AsRecordType()->GetFieldType(field)->Tag()));
+
+	f.boxed = nullptr;
+	f.is_set = true;
+	Modified();
+	return f;
 	}
 
 ValPtr RecordVal::SizeVal() const
@@ -2963,7 +3717,7 @@ ValPtr RecordVal::SizeVal() const
 
 void RecordVal::Assign(int field, ValPtr new_val)
 	{
-	(*AsNonConstRecord())[field] = std::move(new_val);
+	SetField(fields[field], std::move(new_val));
 	Modified();
 	}
 
@@ -2974,9 +3728,7 @@ void RecordVal::Assign(int field, Val* new_val)
 
 ValPtr RecordVal::GetFieldOrDefault(int field) const
 	{
-	const auto& val = (*AsRecord())[field];
-
-	if ( val )
+	if ( const auto& val = GetField(field) )
 		return val;
 
 	return GetType()->AsRecordType()->FieldDefault(field);
@@ -2993,16 +3745,16 @@ void RecordVal::ResizeParseTimeRecords(RecordType* rt)
 
 	for ( auto& rv : rvs )
 		{
-		auto vs = rv->val.record_val;
-		int current_length = vs->size();
+		auto& vs = rv->fields;
+		int current_length = vs.size();
 		auto required_length = rt->NumFields();
 
 		if ( required_length > current_length )
 			{
-			vs->reserve(required_length);
+			vs.reserve(required_length);
 
 			for ( auto i = current_length; i < required_length; ++i )
-				vs->emplace_back(rt->FieldDefault(i));
+				vs.emplace_back(MakeField(rt->GetFieldType(i), rt->FieldDefault(i)));
 			}
 		}
 	}
@@ -3111,8 +3863,7 @@ TableValPtr RecordVal::GetRecordFieldsVal() const
 
 void RecordVal::Describe(ODesc* d) const
 	{
-	auto vl = AsRecord();
-	auto n = vl->size();
+	auto n = fields.size();
 	auto record_type = GetType()->AsRecordType();
 
 	if ( d->IsBinary() || d->IsPortable() )
@@ -3135,7 +3886,7 @@ void RecordVal::Describe(ODesc* d) const
 		if ( ! d->IsBinary() )
 			d->Add("=");
 
-		const auto& v = (*vl)[i];
+		const auto& v = GetField(i);
 
 		if ( v )
 			v->Describe(d);
@@ -3149,8 +3900,7 @@ void RecordVal::Describe(ODesc* d) const
 
 void RecordVal::DescribeReST(ODesc* d) const
 	{
-	auto vl = AsRecord();
-	auto n = vl->size();
+	auto n = fields.size();
 	auto record_type = GetType()->AsRecordType();
 
 	d->Add("{");
@@ -3164,7 +3914,7 @@ void RecordVal::DescribeReST(ODesc* d) const
 		d->Add(record_type->FieldName(i));
 		d->Add("=");
 
-		const auto& v = (*vl)[i];
+		const auto& v = GetField(i);
 
 		if ( v )
 			v->Describe(d);
@@ -3187,10 +3937,24 @@ ValPtr RecordVal::DoClone(CloneState* state)
 	rv->origin = nullptr;
 	state->NewClone(this, rv);
 
-	for ( const auto& vlv : *val.record_val)
+	rv->fields.reserve(fields.size());
+
+	for ( const auto& f : fields )
 		{
-		auto v = vlv ? vlv->Clone(state) : nullptr;
-  		rv->val.record_val->emplace_back(std::move(v));
+		// Atomic values are immutable, no need to clone them.
+		if ( f.tag != TYPE_VOID )
+			rv->fields.emplace_back(f);
+		else
+			{
+			auto& c = rv->fields.emplace_back();
+
+			if ( f.boxed && detail::copy_on_write_clones &&
+			     f.boxed->GetType()->Tag() == TYPE_STRING )
+				// Immutable as well, see copy_on_write_clones.
+				c.boxed = f.boxed;
+			else
+				c.boxed = f.boxed ? f.boxed->Clone(state) : nullptr;
+			}
 		}
 
 	return rv;
@@ -3199,19 +3963,28 @@ ValPtr RecordVal::DoClone(CloneState* state)
 unsigned int RecordVal::MemoryAllocation() const
 	{
 	unsigned int size = 0;
-	const auto& vl = *AsRecord();
 
-	for ( const auto& v : vl )
+	for ( const auto& f : fields )
 		{
-		if ( v )
-		    size += v->MemoryAllocation();
+		if ( f.boxed )
+		    size += f.boxed->MemoryAllocation();
 		}
 
-	size += util::pad_size(vl.capacity() * sizeof(ValPtr));
-	size += padded_sizeof(vl);
+	size += util::pad_size(fields.capacity() * sizeof(Field));
 	return size + padded_sizeof(*this);
 	}
 
+uint64_t RecordVal::ComputeFootprint(std::unordered_set<const void*>* seen) const
+	{
+	uint64_t size = padded_sizeof(*this) + util::pad_size(fields.capacity() * sizeof(Field));
+
+	for ( const auto& f : fields )
+		if ( f.boxed )
+			size += f.boxed->Footprint(seen);
+
+	return size;
+	}
+
 ValPtr EnumVal::SizeVal() const
 	{
 	return val_mgr->Int(val.int_val);
@@ -3239,11 +4012,47 @@ VectorVal::VectorVal(VectorType* t) : VectorVal({NewRef{}, t})
 VectorVal::VectorVal(VectorTypePtr t) : Val(std::move(t))
 	{
 	val.vector_val = new vector<ValPtr>();
+
+	if ( detail::alloc_profiler )
+		detail::alloc_profiler->Allocated(this);
 	}
 
 VectorVal::~VectorVal()
 	{
-	delete val.vector_val;
+	if ( detail::alloc_profiler )
+		detail::alloc_profiler->Freed(this);
+
+	if ( ! shared_vector )
+		delete val.vector_val;
+	}
+
+void VectorVal::Unshare()
+	{
+	// Once all clones are gone, the storage is ours alone again.
+	if ( ! shared_vector || shared_vector.use_count() == 1 )
+		return;
+
+	// The elements are immutable, so the copy can share them.
+	val.vector_val = new vector<ValPtr>(*val.vector_val);
+	shared_vector.reset();
+	}
+
+uint64_t VectorVal::ComputeFootprint(std::unordered_set<const void*>* seen) const
+	{
+	uint64_t size = padded_sizeof(*this);
+	const auto* vec = val.vector_val;
+
+	// Copy-on-write clones share the storage.
+	if ( ! seen->insert(vec).second )
+		return size;
+
+	size += padded_sizeof(*vec) + util::pad_size(vec->capacity() * sizeof(ValPtr));
+
+	for ( const auto& e : *vec )
+		if ( e )
+			size += e->Footprint(seen);
+
+	return size;
 	}
 
 ValPtr VectorVal::SizeVal() const
@@ -3257,6 +4066,8 @@ bool VectorVal::Assign(unsigned int index, ValPtr element)
 	     ! same_type(element->GetType(), GetType()->AsVectorType()->Yield(), false) )
 		return false;
 
+	Unshare();
+
 	if ( index >= val.vector_val->size() )
 		val.vector_val->resize(index + 1);
 
@@ -3286,6 +4097,8 @@ bool VectorVal::Insert(unsigned int index, ValPtr element)
 		return false;
 		}
 
+	Unshare();
+
 	vector<ValPtr>::iterator it;
 
 	if ( index < val.vector_val->size() )
@@ -3304,6 +4117,8 @@ bool VectorVal::Remove(unsigned int index)
 	if ( index >= val.vector_val->size() )
 		return false;
 
+	Unshare();
+
 	auto it = std::next(val.vector_val->begin(), index);
 	val.vector_val->erase(it);
 
@@ -3345,6 +4160,8 @@ const ValPtr& VectorVal::At(unsigned int index) const
 
 unsigned int VectorVal::Resize(unsigned int new_num_elements)
 	{
+	Unshare();
+
 	unsigned int oldsize = val.vector_val->size();
 	val.vector_val->reserve(new_num_elements);
 	val.vector_val->resize(new_num_elements);
@@ -3363,9 +4180,22 @@ unsigned int VectorVal::ResizeAtLeast(unsigned int new_num_elements)
 ValPtr VectorVal::DoClone(CloneState* state)
 	{
 	auto vv = make_intrusive<VectorVal>(GetType<VectorType>());
-	vv->val.vector_val->reserve(val.vector_val->size());
 	state->NewClone(this, vv);
 
+	if ( detail::copy_on_write_clones &&
+	     is_immutable_type(GetType()->AsVectorType()->Yield()) )
+		{
+		if ( ! shared_vector )
+			shared_vector.reset(val.vector_val);
+
+		delete vv->val.vector_val;
+		vv->val.vector_val = val.vector_val;
+		vv->shared_vector = shared_vector;
+		return vv;
+		}
+
+	vv->val.vector_val->reserve(val.vector_val->size());
+
 	for ( unsigned int i = 0; i < val.vector_val->size(); ++i )
 		{
 		auto v = (*val.vector_val)[i]->Clone(state);
@@ -3712,6 +4542,30 @@ StringVal* ValManager::GetEmptyString() const
 	return empty_string->Ref()->AsStringVal();
 	}
 
+StringValPtr ValManager::InternedString(int len, const char* s)
+	{
+	if ( len > MAX_INTERNED_LEN )
+		return make_intrusive<StringVal>(len, s);
+
+	std::string key(s, len);
+	auto it = interned_strings.find(key);
+
+	if ( it != interned_strings.end() )
+		return it->second;
+
+	auto v = make_intrusive<StringVal>(len, s);
+
+	if ( interned_strings.size() < MAX_INTERNED )
+		interned_strings.emplace(std::move(key), v);
+
+	return v;
+	}
+
+StringValPtr ValManager::InternedString(const char* s)
+	{
+	return InternedString(strlen(s), s);
+	}
+
 const PortValPtr& ValManager::Port(uint32_t port_num, TransportProto port_type) const
 	{
 	if ( port_num >= 65536 )
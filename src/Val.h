@@ -5,13 +5,16 @@
 #include "IntrusivePtr.h"
 #include "Type.h"
 #include "Timer.h"
+#include "MemoryTag.h"
 #include "Notifier.h"
 #include "net_util.h"
 
+#include <memory>
 #include <vector>
 #include <list>
 #include <array>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <sys/types.h> // for u_char
 
@@ -48,6 +51,10 @@ namespace zeek::detail { class ScriptFunc; }
 using BroFunc [[deprecated("Remove in v4.1. Use zeek::detail::ScriptFunc instead.")]] = zeek::detail::ScriptFunc;
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(PrefixTable, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(OrderedIndex, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(CompactSet, zeek::detail);
+ZEEK_FORWARD_DECLARE_NAMESPACED(ExpireIndex, zeek::detail);
+namespace zeek::detail { struct ExpireNode; }
 ZEEK_FORWARD_DECLARE_NAMESPACED(RE_Matcher, zeek);
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(CompositeHash, zeek::detail);
@@ -110,7 +117,6 @@ union BroValUnion {
 	File* file_val;
 	RE_Matcher* re_val;
 	PDict<TableEntryVal>* table_val;
-	std::vector<ValPtr>* record_val;
 	std::vector<ValPtr>* vector_val;
 
 	BroValUnion() = default;
@@ -180,6 +186,11 @@ public:
 
 	~Val() override;
 
+	// Values created during event dispatch come from the event value
+	// arena if it's active, see detail::ValArena.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	Val* Ref()			{ zeek::Ref(this); return this; }
 	ValPtr Clone();
 
@@ -201,6 +212,17 @@ public:
 	// Bytes in total value object.
 	virtual unsigned int MemoryAllocation() const;
 
+	/**
+	 * Returns the memory the value occupies including everything it
+	 * references. Unlike MemoryAllocation(), this counts values and
+	 * storage referenced more than once only the first time it comes
+	 * across them, and includes the elements of vectors.
+	 *
+	 * @param seen The values and storage counted already, which this
+	 * adds to.
+	 */
+	uint64_t Footprint(std::unordered_set<const void*>* seen) const;
+
 	// Add this value to the given value (if appropriate).
 	// Returns true if succcessful.  is_first_init is true only if
 	// this is the *first* initialization of the value, not
@@ -247,7 +269,6 @@ public:
 	CONST_ACCESSOR(TYPE_STRING, String*, string_val, AsString)
 	CONST_ACCESSOR(TYPE_FUNC, Func*, func_val, AsFunc)
 	CONST_ACCESSOR(TYPE_TABLE, PDict<TableEntryVal>*, table_val, AsTable)
-	CONST_ACCESSOR(TYPE_RECORD, std::vector<ValPtr>*, record_val, AsRecord)
 	CONST_ACCESSOR(TYPE_FILE, File*, file_val, AsFile)
 	CONST_ACCESSOR(TYPE_PATTERN, RE_Matcher*, re_val, AsPattern)
 	CONST_ACCESSOR(TYPE_VECTOR, std::vector<ValPtr>*, vector_val, AsVector)
@@ -306,6 +327,9 @@ public:
 	bro_int_t ForceAsInt() const		{ return val.int_val; }
 	bro_uint_t ForceAsUInt() const		{ return val.uint_val; }
 
+	// Same for double, time, or interval.
+	double ForceAsDouble() const		{ return val.double_val; }
+
 	PatternVal* AsPatternVal();
 	const PatternVal* AsPatternVal() const;
 
@@ -372,6 +396,10 @@ protected:
 	virtual void ValDescribe(ODesc* d) const;
 	virtual void ValDescribeReST(ODesc* d) const;
 
+	// Computes Footprint() for a value not counted yet. The default
+	// returns MemoryAllocation().
+	virtual uint64_t ComputeFootprint(std::unordered_set<const void*>* seen) const;
+
 	static ValPtr MakeBool(bool b);
 	static ValPtr MakeInt(bro_int_t i);
 	static ValPtr MakeCount(bro_uint_t u);
@@ -391,7 +419,6 @@ protected:
 		{}
 
 	ACCESSOR(TYPE_TABLE, PDict<TableEntryVal>*, table_val, AsNonConstTable)
-	ACCESSOR(TYPE_RECORD, std::vector<ValPtr>*, record_val, AsNonConstRecord)
 
 	// For internal use by the Val::Clone() methods.
 	struct CloneState {
@@ -480,6 +507,17 @@ public:
 	inline const StringValPtr& EmptyString() const
 		{ return empty_string; }
 
+	// Returns a shared value for a string that's likely to recur, like
+	// a header name or request method, saving an allocation each time
+	// it shows up. The value must not be modified. Strings longer than
+	// MAX_INTERNED_LEN, and new ones once MAX_INTERNED are held, get a
+	// value of their own.
+	StringValPtr InternedString(int len, const char* s);
+	StringValPtr InternedString(const char* s);
+
+	static constexpr int MAX_INTERNED_LEN = 32;
+	static constexpr size_t MAX_INTERNED = 4096;
+
 	// Port number given in host order.
 	[[deprecated("Remove in v4.1.  Use zeek::val_mgr->Port() instead.")]]
 	PortVal* GetPort(uint32_t port_num, TransportProto port_type) const;
@@ -500,6 +538,7 @@ private:
 	std::array<ValPtr, PREALLOCATED_COUNTS> counts;
 	std::array<ValPtr, PREALLOCATED_INTS> ints;
 	StringValPtr empty_string;
+	std::unordered_map<std::string, StringValPtr> interned_strings;
 	ValPtr b_true;
 	ValPtr b_false;
 };
@@ -722,12 +761,13 @@ public:
 
 protected:
 	ValPtr DoClone(CloneState* state) override;
+	uint64_t ComputeFootprint(std::unordered_set<const void*>* seen) const override;
 
 	std::vector<ValPtr> vals;
 	TypeTag tag;
 };
 
-class TableEntryVal {
+class TableEntryVal : public detail::MemoryTagged<detail::MemoryTag::Tables> {
 public:
 	explicit TableEntryVal(ValPtr v)
 		: val(std::move(v))
@@ -736,6 +776,11 @@ public:
 			int(run_state::network_time - run_state::zeek_start_network_time);
 		}
 
+	// Copies belong to no expiration index.
+	TableEntryVal(const TableEntryVal& other)
+		: val(other.val), expire_access_time(other.expire_access_time)
+		{}
+
 	TableEntryVal* Clone(Val::CloneState* state);
 
 	[[deprecated("Remove in v4.1.  Use GetVal().")]]
@@ -752,6 +797,7 @@ public:
 
 protected:
 	friend class TableVal;
+	friend class detail::ExpireIndex;
 
 	ValPtr val;
 
@@ -759,6 +805,9 @@ protected:
 	// to save a few bytes, as we do not need a high resolution for these
 	// anyway.
 	int expire_access_time;
+
+	// Our place in the table's expiration index, if it has one.
+	detail::ExpireNode* expire_node = nullptr;
 };
 
 class TableValTimer final : public detail::Timer {
@@ -774,6 +823,23 @@ protected:
 	TableVal* table;
 };
 
+namespace detail {
+
+// Operations on a single table, collected if table_profiling is set.
+struct TableUsage {
+	uint64_t lookups = 0;
+	uint64_t inserts = 0;
+	uint64_t deletes = 0;
+	uint64_t expirations = 0;
+	uint64_t resizes = 0;
+	uint64_t iterations = 0;	// Entries visited by for loops.
+	uint64_t expire_steps = 0;	// Calls of DoExpire().
+	double expire_time = 0;	// Seconds spent in DoExpire(), including expire_func_time.
+	double expire_func_time = 0;	// Seconds spent in &expire_func.
+};
+
+}
+
 class TableVal final : public Val, public notifier::detail::Modifiable {
 public:
 	explicit TableVal(TableTypePtr t, detail::AttributesPtr attrs = nullptr);
@@ -926,6 +992,16 @@ public:
 	// Causes an internal error if called for any other kind of table.
 	TableValPtr LookupSubnetValues(const SubNetVal* s);
 
+	// For a table with the &ordered_index attribute, return a new table
+	// that only contains the entries whose leading index components equal
+	// the given values.
+	// Causes an internal error if called for any other kind of table.
+	TableValPtr LookupPrefixValues(const std::vector<const Val*>& prefix);
+
+	// Same, but for the entries whose first index component lies within
+	// [lo, hi].
+	TableValPtr LookupRangeValues(const Val* lo, const Val* hi);
+
 	// Sets the timestamp for the given index to network time.
 	// Returns false if index does not exist.
 	bool UpdateTimestamp(Val* index);
@@ -935,6 +1011,12 @@ public:
 	 */
 	ListValPtr RecreateIndex(const detail::HashKey& k) const;
 
+	/**
+	 * Same, but stores the index's values in *vals*, which needs room
+	 * for one per index type, rather than building a ListVal.
+	 */
+	void RecreateIndex(const detail::HashKey& k, ValPtr* vals) const;
+
 	[[deprecated("Remove in v4.1.  Use RecreateIndex().")]]
 	ListVal* RecoverIndex(const detail::HashKey* k) const
 		{ return RecreateIndex(*k).release(); }
@@ -997,6 +1079,10 @@ public:
 	// type that the general Table API does not allow.
 	const detail::PrefixTable* Subnets() const { return subnets; }
 
+	// Returns the sorted index kept for the &ordered_index attribute (if
+	// present).
+	const detail::OrderedIndex* GetOrderedIndex() const { return ordered_index; }
+
 	void Describe(ODesc* d) const override;
 
 	void InitTimer(double delay);
@@ -1046,6 +1132,14 @@ public:
 	 */
 	void SetBrokerStore(const std::string& store) { broker_store = store; }
 
+	/**
+	 * Sends the updates to the Broker store backing this table that have
+	 * been held back to coalesce them, see
+	 * :zeek:see:`Broker::table_store_flush_interval`. Each changed entry
+	 * goes out once, with its current value.
+	 */
+	void FlushStoreUpdates();
+
 	/**
 	 * Disable change notification processing of &on_change until re-enabled.
 	 */
@@ -1056,9 +1150,64 @@ public:
 	 */
 	void EnableChangeNotifications() { in_change_func = false; }
 
+	/**
+	 * Returns the storage this table shares with copy-on-write clones,
+	 * or null if it doesn't share it. Holding on to it keeps the current
+	 * entries alive even if the table detaches from them on modification,
+	 * as needed when iterating over them while running script code.
+	 */
+	std::shared_ptr<PDict<TableEntryVal>> SharedStorage() const
+		{ return shared_table; }
+
+	/**
+	 * Returns the elements of a set with the &compact attribute, or null
+	 * if the table keeps regular entries. A compact set's dictionary
+	 * stays empty. Holding on to the storage keeps the current elements
+	 * alive even if the set moves on to a copy on modification, as
+	 * needed when iterating over them while running script code.
+	 */
+	std::shared_ptr<const detail::CompactSet> CompactStorage() const
+		{ return compact; }
+
+	/**
+	 * Returns the operations counted on this table, or null if there
+	 * were none since :zeek:see:`table_profiling` is off.
+	 */
+	const detail::TableUsage* Usage() const
+		{ return usage.get(); }
+
+	/**
+	 * Counts entries visited by iterating over the table, if
+	 * :zeek:see:`table_profiling` is set.
+	 *
+	 * @param n The number of entries visited.
+	 */
+	void CountIterations(uint64_t n);
+
 protected:
 	void Init(TableTypePtr t);
 
+	uint64_t ComputeFootprint(std::unordered_set<const void*>* seen) const override;
+
+	// Returns true if clones of this table may share its storage
+	// until modified, see copy_on_write_clones.
+	bool CanShareStorage() const;
+
+	// Gives the table its own storage if it still shares it with a
+	// copy-on-write clone. Must be called before any modification of
+	// the table's entries.
+	void Unshare();
+
+	// Returns a new table with the entries for the given indices.
+	TableValPtr CopyEntries(const std::vector<ListValPtr>& indices);
+
+	// Adds an element to a compact set.
+	bool AssignCompact(const Val& index);
+
+	// Returns true if the table has an entry for the index, without
+	// counting it as a lookup.
+	bool HasIndex(const Val& index) const;
+
 	using TableRecordDependencies = std::unordered_map<RecordType*, std::vector<TableValPtr>>;
 
 	using ParseTimeTableState = std::vector<std::pair<ValPtr, ValPtr>>;
@@ -1085,6 +1234,22 @@ protected:
 	// Calls &expire_func and returns its return interval;
 	double CallExpireFunc(ListValPtr idx);
 
+	// Expires an entry that's due, unless &expire_func postpones it.
+	// Returns true if the entry was removed.
+	bool ExpireEntry(const detail::HashKey& k, TableEntryVal* v, double timeout);
+
+	// Sets an entry's expiration access time, keeping the expiration
+	// index up to date.
+	void TouchEntry(TableEntryVal* v, double time);
+
+	// Creates the expiration index, if enabled by table_expire_index,
+	// and adds the current entries to it.
+	void InitExpireIndex();
+
+	// Returns the usage to count operations in if table_profiling is
+	// set, otherwise null.
+	detail::TableUsage* CountUsage();
+
 	// Enum for the different kinds of changes an &on_change handler can see
 	enum OnChangeType { ELEMENT_NEW, ELEMENT_CHANGED, ELEMENT_REMOVED, ELEMENT_EXPIRED };
 
@@ -1092,8 +1257,10 @@ protected:
 	void CallChangeFunc(const ValPtr& index, const ValPtr& old_value,
 	                    OnChangeType tpe);
 
-	// Sends data on to backing Broker Store
-	void SendToStore(const Val* index, const TableEntryVal* new_entry_val, OnChangeType tpe);
+	// Sends data on to backing Broker Store. Unless flushing, new and
+	// changed entries may be held back for FlushStoreUpdates().
+	void SendToStore(const Val* index, const TableEntryVal* new_entry_val, OnChangeType tpe,
+	                 bool flushing = false);
 
 	ValPtr DoClone(CloneState* state) override;
 
@@ -1105,11 +1272,23 @@ protected:
 	TableValTimer* timer;
 	IterCookie* expire_cookie;
 	detail::PrefixTable* subnets;
+	detail::OrderedIndex* ordered_index = nullptr;
+	detail::ExpireIndex* expire_index = nullptr;
 	ValPtr def_val;
 	detail::ExprPtr change_func;
 	std::string broker_store;
+	// Entries changed since the last FlushStoreUpdates(), with their
+	// indices, by hash key.
+	std::unordered_map<std::string, ValPtr> pending_store_updates;
+	// Once the table has been cloned copy-on-write, owns val.table_val.
+	std::shared_ptr<PDict<TableEntryVal>> shared_table;
+	// The elements of a &compact set, shared with clones and iterations
+	// until modified.
+	std::shared_ptr<detail::CompactSet> compact;
 	// prevent recursion of change functions
 	bool in_change_func = false;
+	// Only allocated once there's something to count.
+	std::unique_ptr<detail::TableUsage> usage;
 
 	static TableRecordDependencies parse_time_table_record_dependencies;
 	static ParseTimeTableStates parse_time_table_states;
@@ -1149,17 +1328,106 @@ public:
 	void Assign(int field, std::nullptr_t)
 		{ Assign(field, ValPtr{}); }
 
+	/**
+	 * Assigns a value to a field of type bool, without creating a
+	 * \a Val for it.
+	 * @param field  The field index to assign.
+	 * @param b  The value to assign.
+	 */
+	void AssignBool(int field, bool b)
+		{ AssignUnboxed(field).int_val = b; }
+
+	/**
+	 * Assigns a value to a field of type int, without creating a
+	 * \a Val for it.
+	 * @param field  The field index to assign.
+	 * @param i  The value to assign.
+	 */
+	void AssignInt(int field, bro_int_t i)
+		{ AssignUnboxed(field).int_val = i; }
+
+	/**
+	 * Assigns a value to a field of type count, without creating a
+	 * \a Val for it.
+	 * @param field  The field index to assign.
+	 * @param u  The value to assign.
+	 */
+	void AssignCount(int field, bro_uint_t u)
+		{ AssignUnboxed(field).uint_val = u; }
+
+	/**
+	 * Assigns a value to a field of type double, time or interval,
+	 * without creating a \a Val for it.
+	 * @param field  The field index to assign.
+	 * @param d  The value to assign.
+	 */
+	void AssignDouble(int field, double d)
+		{ AssignUnboxed(field).double_val = d; }
+
 	[[deprecated("Remove in v4.1.  Use GetField().")]]
 	Val* Lookup(int field) const	// Does not Ref() value.
-		{ return (*AsRecord())[field].get(); }
+		{ return GetField(field).get(); }
 
 	/**
-	 * Returns the value of a given field index.
+	 * Returns the value of a given field index. For fields of atomic
+	 * type, this creates the field's \a Val on first access.
 	 * @param field  The field index to retrieve.
 	 * @return  The value at the given field index.
 	 */
 	const ValPtr& GetField(int field) const
-		{ return (*AsRecord())[field]; }
+		{
+		const auto& s = fields[field];
+
+		if ( s.is_set && ! s.boxed )
+			s.boxed = Box(s);
+
+		return s.boxed;
+		}
+
+	/**
+	 * Returns whether a given field index holds a value.
+	 * @param field  The field index to check.
+	 * @return  True if the field has been assigned, not counting any
+	 * &default.
+	 */
+	bool HasField(int field) const
+		{ return fields[field].is_set || fields[field].boxed; }
+
+	/**
+	 * Returns the value of a field of type bool or int, without creating
+	 * a \a Val for it. The field must hold a value.
+	 * @param field  The field index to retrieve.
+	 * @return  The value at the given field index.
+	 */
+	bro_int_t GetFieldInt(int field) const
+		{
+		const auto& s = fields[field];
+		return s.tag == TYPE_VOID ? s.boxed->InternalInt() : s.int_val;
+		}
+
+	/**
+	 * Returns the value of a field of type count, without creating a
+	 * \a Val for it. The field must hold a value.
+	 * @param field  The field index to retrieve.
+	 * @return  The value at the given field index.
+	 */
+	bro_uint_t GetFieldCount(int field) const
+		{
+		const auto& s = fields[field];
+		return s.tag == TYPE_VOID ? s.boxed->InternalUnsigned() : s.uint_val;
+		}
+
+	/**
+	 * Returns the value of a field of type double, time or interval,
+	 * without creating a \a Val for it. The field must hold a value.
+	 * @param field  The field index to retrieve.
+	 * @return  The value at the given field index.
+	 */
+	double GetFieldDouble(int field) const
+		{
+		const auto& s = fields[field];
+		return s.tag == TYPE_VOID ? s.boxed->InternalDouble() : s.double_val;
+		}
 
 	/**
 	 * Returns the value of a given field index as cast to type @c T.
@@ -1279,8 +1547,34 @@ public:
 
 protected:
 	ValPtr DoClone(CloneState* state) override;
+	uint64_t ComputeFootprint(std::unordered_set<const void*>* seen) const override;
+
+	// Storage for a single field. Fields of atomic type (bool, int,
+	// count, double, time, interval) keep their value in the union and
+	// only get a Val once someone asks for one, which we then cache in
+	// *boxed*. Fields of any other type just use *boxed*.
+	struct Field {
+		union {
+			bro_int_t int_val;
+			bro_uint_t uint_val;
+			double double_val;
+		};
+
+		mutable ValPtr boxed;
+		TypeTag tag = TYPE_VOID;	// TYPE_VOID if not stored unboxed.
+		bool is_set = false;	// Whether the union holds a value.
+	};
+
+	static Field MakeField(const TypePtr& t, ValPtr v);
+	static void SetField(Field& f, ValPtr v);
+	static ValPtr Box(const Field& f);
+
+	// Prepares an unboxed assignment, returning the field so that the
+	// caller can fill in the value.
+	Field& AssignUnboxed(int field);
 
 	Obj* origin;
+	std::vector<Field> fields;
 
 	using RecordTypeValMap = std::unordered_map<RecordType*, std::vector<RecordValPtr>>;
 	static RecordTypeValMap parse_time_records;
@@ -1404,9 +1698,20 @@ public:
 	// Removes an element at a specific position.
 	bool Remove(unsigned int index);
 
+	/**
+	 * Gives the vector its own storage if it still shares it with a
+	 * copy-on-write clone. Must be called before modifying elements
+	 * through AsVector().
+	 */
+	void Unshare();
+
 protected:
 	void ValDescribe(ODesc* d) const override;
 	ValPtr DoClone(CloneState* state) override;
+	uint64_t ComputeFootprint(std::unordered_set<const void*>* seen) const override;
+
+	// Once the vector has been cloned copy-on-write, owns val.vector_val.
+	std::shared_ptr<std::vector<ValPtr>> shared_vector;
 };
 
 // Checks the given value for consistency with the given type.  If an
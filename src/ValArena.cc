@@ -0,0 +1,78 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "ValArena.h"
+
+#include <sys/mman.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <new>
+
+#include "Reporter.h"
+
+namespace zeek::detail {
+
+ValArena* val_arena = nullptr;
+
+ValArena::ValArena(uint64_t size)
+	{
+	size = (size + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE;
+
+	// Only reserve the range; pages get backed as chunks take them.
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+	               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if ( p == MAP_FAILED )
+		{
+		reporter->Error("failed to reserve %" PRIu64 " bytes for the event value arena: %s",
+		                size, strerror(errno));
+		return;
+		}
+
+	base = static_cast<char*>(p);
+	limit = base + size;
+	}
+
+bool ValArena::NewChunk()
+	{
+	if ( cur )
+		{
+		if ( cur->live == 0 )
+			{
+			// Everything in it died already, start over.
+			next = reinterpret_cast<char*>(cur) + HEADER_SIZE;
+			return true;
+			}
+
+		cur->retired = true;
+		cur = nullptr;
+		next = end = nullptr;
+		}
+
+	if ( ! free_chunks.empty() )
+		{
+		cur = free_chunks.back();
+		free_chunks.pop_back();
+		}
+
+	else if ( base && base + (num_chunks + 1) * CHUNK_SIZE <= limit )
+		{
+		cur = new (base + num_chunks * CHUNK_SIZE) Chunk();
+		++num_chunks;
+		}
+
+	else
+		return false;
+
+	next = reinterpret_cast<char*>(cur) + HEADER_SIZE;
+	end = reinterpret_cast<char*>(cur) + CHUNK_SIZE;
+	return true;
+	}
+
+void ValArena::Release(Chunk* c)
+	{
+	c->retired = false;
+	free_chunks.push_back(c);
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,163 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * Bump-allocates the values created while an event gets dispatched, so
+ * that the temporaries that die before the handler returns cost neither
+ * a heap allocation nor a heap free. Memory comes in chunks, each of which
+ * counts its live values. Once the outermost dispatch ends and all values
+ * of the current chunk are gone again, the chunk starts over from the
+ * beginning, which releases all of them at once.
+ *
+ * Values outliving their dispatch, because something still holds a
+ * reference or stored them in a global, keep their chunk alive; their
+ * chunk just fills up with further values and gets retired when full.
+ * A retired chunk becomes available again when its last value dies.
+ * Chunks come from a single address range reserved up front, which bounds
+ * the memory that long-lived values can pin. When it runs out, values come
+ * from the heap as usual.
+ *
+ * The arena is active when event_val_arena_size is non-zero.
+ */
+class ValArena {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param size The size of the address range to reserve for chunks.
+	 */
+	explicit ValArena(uint64_t size);
+
+	/**
+	 * Returns memory for a value, or nullptr if it should come from the
+	 * heap: outside of event dispatch, for large values, and once all
+	 * chunks are in use.
+	 */
+	void* Allocate(size_t size)
+		{
+		if ( ! depth || size > MAX_OBJ_SIZE )
+			return nullptr;
+
+		size = (size + ALIGN - 1) & ~(ALIGN - 1);
+
+		if ( static_cast<size_t>(end - next) < size && ! NewChunk() )
+			{
+			++num_heap_fallbacks;
+			return nullptr;
+			}
+
+		void* p = next;
+		next += size;
+		++cur->live;
+		return p;
+		}
+
+	/**
+	 * Returns true if the memory has come from the arena.
+	 */
+	bool Owns(const void* p) const
+		{ return p >= base && p < limit; }
+
+	/**
+	 * Releases memory that has come from the arena.
+	 */
+	void Free(void* p)
+		{
+		auto c = ChunkOf(p);
+
+		if ( --c->live == 0 && c->retired )
+			Release(c);
+		}
+
+	/**
+	 * Marks the start of an event's dispatch. Dispatches may nest.
+	 */
+	void BeginDispatch()	{ ++depth; }
+
+	/**
+	 * Marks the end of an event's dispatch.
+	 */
+	void EndDispatch()
+		{
+		if ( --depth == 0 && cur && cur->live == 0 )
+			next = reinterpret_cast<char*>(cur) + HEADER_SIZE;
+		}
+
+	/**
+	 * Returns the number of chunks holding live values.
+	 */
+	size_t ChunksInUse() const	{ return num_chunks - free_chunks.size(); }
+
+	/**
+	 * Returns the number of allocations that went to the heap because
+	 * all chunks were in use.
+	 */
+	uint64_t HeapFallbacks() const	{ return num_heap_fallbacks; }
+
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+	static constexpr size_t MAX_OBJ_SIZE = 512;
+
+private:
+	struct Chunk {
+		uint32_t live = 0;
+		bool retired = false;
+	};
+
+	static constexpr size_t ALIGN = alignof(std::max_align_t);
+	static constexpr size_t HEADER_SIZE = (sizeof(Chunk) + ALIGN - 1) & ~(ALIGN - 1);
+
+	Chunk* ChunkOf(const void* p) const
+		{
+		auto offset = static_cast<const char*>(p) - base;
+		return reinterpret_cast<Chunk*>(base + offset / CHUNK_SIZE * CHUNK_SIZE);
+		}
+
+	// Retires the current chunk and continues in a new one. Returns false
+	// if there's none left.
+	bool NewChunk();
+
+	// Makes a retired chunk available again.
+	void Release(Chunk* c);
+
+	char* base = nullptr;
+	char* limit = nullptr;
+	size_t num_chunks = 0;
+	std::vector<Chunk*> free_chunks;
+
+	Chunk* cur = nullptr;
+	char* next = nullptr;
+	char* end = nullptr;
+
+	int depth = 0;
+	uint64_t num_heap_fallbacks = 0;
+};
+
+// Only set if the arena is active.
+extern ValArena* val_arena;
+
+/**
+ * Brackets an event's dispatch for the arena.
+ */
+class ValArenaScope {
+public:
+	ValArenaScope()
+		{
+		if ( val_arena )
+			val_arena->BeginDispatch();
+		}
+
+	~ValArenaScope()
+		{
+		if ( val_arena )
+			val_arena->EndDispatch();
+		}
+};
+
+} // namespace zeek::detail
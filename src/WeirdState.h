@@ -2,20 +2,23 @@
 
 #pragma once
 
-#include <string>
+#include <cstdint>
 #include <unordered_map>
 
 namespace zeek::detail {
 
+// Weird names are interned by the reporter, see Reporter::InternWeird().
+using WeirdID = uint32_t;
+
 struct WeirdState {
 	WeirdState() = default;
 	uint64_t count = 0;
 	double sampling_start_time = 0;
 };
 
-using WeirdStateMap = std::unordered_map<std::string, WeirdState>;
+using WeirdStateMap = std::unordered_map<WeirdID, WeirdState>;
 
-bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold,
+bool PermitWeird(WeirdStateMap& wsm, WeirdID id, uint64_t threshold,
                  uint64_t rate, double duration);
 
 } // namespace zeek::detail
@@ -4,13 +4,12 @@
 
 #include <vector>
 #include "ZeekList.h"
+#include "IntrusivePtr.h"
 
 namespace zeek {
 
 class VectorVal;
 class RecordType;
-template <class T> class IntrusivePtr;
-
 using ValPtr = IntrusivePtr<Val>;
 using VectorValPtr = IntrusivePtr<VectorVal>;
 using RecordTypePtr = IntrusivePtr<RecordType>;
@@ -27,6 +26,23 @@ using Args = std::vector<ValPtr>;
  */
 Args val_list_to_args(const ValPList& vl);
 
+/**
+ * Builds an argument list from individual arguments, moving those passed
+ * as rvalues into place. Brace-initializing an Args instead goes through a
+ * std::initializer_list, whose elements can only be copied out, which
+ * costs a reference count increment and decrement per argument.
+ * @param args  the arguments, each convertible to ValPtr
+ * @return  the argument list
+ */
+template <class... Ts>
+Args make_args(Ts&&... args)
+	{
+	Args vl;
+	vl.reserve(sizeof...(Ts));
+	(vl.emplace_back(std::forward<Ts>(args)), ...);
+	return vl;
+	}
+
 /**
  * Creates a vector of "call_argument" meta data describing the arguments to
  * function/event invocation.
@@ -4,7 +4,9 @@
 #include "ZeekString.h"
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <string>
 #include <ctype.h>
 
 #include "Val.h"
@@ -12,6 +14,8 @@
 #include "Reporter.h"
 #include "util.h"
 
+#include "3rdparty/doctest.h"
+
 #ifdef DEBUG
 #define DEBUG_STR(msg) DBG_LOG(zeek::DBG_STRING, msg)
 #else
@@ -66,7 +70,9 @@ String::String()
 
 void String::Reset()
 	{
-	if ( use_free_to_delete )
+	if ( b == small )
+		; // Nothing to release.
+	else if ( use_free_to_delete )
 		free(b);
 	else
 		delete [] b;
@@ -77,11 +83,19 @@ void String::Reset()
 	use_free_to_delete = false;
 	}
 
+byte_vec String::Allocate(int size)
+	{
+	return size <= SMALL_SIZE + 1 ? small : new u_char[size];
+	}
+
 const String& String::operator=(const String &bs)
 	{
+	if ( this == &bs )
+		return *this;
+
 	Reset();
 	n = bs.n;
-	b = new u_char[n+1];
+	b = Allocate(n+1);
 
 	memcpy(b, bs.b, n);
 	b[n] = '\0';
@@ -118,7 +132,7 @@ void String::Set(const u_char* str, int len, bool add_NUL)
 	Reset();
 
 	n = len;
-	b = new u_char[add_NUL ? n + 1 : n];
+	b = Allocate(add_NUL ? n + 1 : n);
 	memcpy(b, str, n);
 	final_NUL = add_NUL;
 
@@ -135,7 +149,7 @@ void String::Set(const char* str)
 	if ( str )
 		{
 		n = strlen(str);
-		b = new u_char[n+1];
+		b = Allocate(n+1);
 		memcpy(b, str, n+1);
 		final_NUL = true;
 		use_free_to_delete = false;
@@ -147,7 +161,7 @@ void String::Set(const std::string& str)
 	Reset();
 
 	n = str.size();
-	b = new u_char[n+1];
+	b = Allocate(n+1);
 	memcpy(b, str.c_str(), n+1);
 	final_NUL = true;
 	use_free_to_delete = false;
@@ -187,9 +201,27 @@ char* String::Render(int format, int* len) const
 	char* s = new char[n*4 + 1];	// +1 is for final '\0'
 	char* sp = s;
 	int tmp_len;
+	static constexpr char hex[] = "0123456789abcdef";
 
 	for ( int i = 0; i < n; ++i )
 		{
+		// Copy runs of bytes that never need escaping in one go.
+		int j = i;
+
+		while ( j < n && b[j] >= ' ' && b[j] <= 126 &&
+		        b[j] != '\\' && b[j] != '\'' && b[j] != '"' )
+			++j;
+
+		if ( j > i )
+			{
+			memcpy(sp, b + i, j - i);
+			sp += j - i;
+			i = j;
+
+			if ( i == n )
+				break;
+			}
+
 		if ( b[i] == '\\' && (format & ESC_ESC) )
 			{
 			*sp++ = '\\'; *sp++ = '\\';
@@ -202,11 +234,8 @@ char* String::Render(int format, int* len) const
 
 		else if ( (b[i] < ' ' || b[i] > 126) && (format & ESC_HEX) )
 			{
-			char hex_fmt[16];
-
 			*sp++ = '\\'; *sp++ = 'x';
-			sprintf(hex_fmt, "%02x", b[i]);
-			*sp++ = hex_fmt[0]; *sp++ = hex_fmt[1];
+			*sp++ = hex[b[i] >> 4]; *sp++ = hex[b[i] & 0xf];
 			}
 
 		else if ( (b[i] < ' ' || b[i] > 126) && (format & ESC_DOT) )
@@ -282,6 +311,9 @@ void String::ToUpper()
 
 unsigned int String::MemoryAllocation() const
 	{
+	if ( b == small )
+		return padded_sizeof(*this);
+
 	return padded_sizeof(*this) + util::pad_size(n + final_NUL);
 	}
 
@@ -496,4 +528,90 @@ void delete_strings(std::vector<const String*>& v)
 	v.clear();
 	}
 
+TEST_CASE("string inline storage")
+	{
+	String small("GET");
+	String large("a string too long to be stored inline");
+
+	CHECK(small.Len() == 3);
+	CHECK(std::string(small.CheckString()) == "GET");
+	CHECK(small.MemoryAllocation() < large.MemoryAllocation());
+
+	String copy(small);
+	CHECK(copy == small);
+	CHECK(copy.Bytes() != small.Bytes());
+
+	copy = large;
+	CHECK(copy == large);
+
+	copy.Set("POST");
+	CHECK(std::string(copy.CheckString()) == "POST");
+
+	copy = copy;
+	CHECK(std::string(copy.CheckString()) == "POST");
+
+	small.Set(reinterpret_cast<const u_char*>("exactly fifteen"), 15, true);
+	CHECK(std::string(small.CheckString()) == "exactly fifteen");
+	}
+
+TEST_CASE("string render")
+	{
+	String s("ab\\c\"d\x01\xff" "e");
+	int len;
+
+	char* r = s.Render(String::EXPANDED_STRING, &len);
+	CHECK(std::string(r) == "ab\\c\"d\\x01\\xffe");
+	CHECK(len == int(strlen(r)) + 1);
+	delete [] r;
+
+	r = s.Render(String::BRO_STRING_LITERAL);
+	CHECK(std::string(r) == "ab\\\\c\\\"d\\x01\\xffe");
+	delete [] r;
+
+	r = s.Render(String::ESC_DOT);
+	CHECK(std::string(r) == "ab\\c\"d..e");
+	delete [] r;
+
+	String plain("plain text");
+	r = plain.Render(String::BRO_STRING_LITERAL);
+	CHECK(std::string(r) == "plain text");
+	delete [] r;
+
+	String empty("");
+	r = empty.Render();
+	CHECK(std::string(r) == "");
+	delete [] r;
+	}
+
+TEST_CASE("string primitives benchmark" * doctest::skip())
+	{
+	std::string text;
+	uint32_t state = 1;
+
+	// Mostly printable text with the occasional byte to escape.
+	while ( text.size() < 16 * 1024 * 1024 )
+		{
+		state = state * 1103515245 + 12345;
+		auto c = (state >> 16) & 0xff;
+		text += (c < 250) ? char(' ' + c % 95) : char(c);
+		}
+
+	String s(reinterpret_cast<const u_char*>(text.data()), text.size(), false);
+	using ms = std::chrono::milliseconds;
+
+	auto start = std::chrono::steady_clock::now();
+	char* r = s.Render(String::BRO_STRING_LITERAL);
+	auto end = std::chrono::steady_clock::now();
+	delete [] r;
+	MESSAGE("Render: " << std::chrono::duration_cast<ms>(end - start).count() << " ms");
+
+	const char* needle = "needle in a haystack";
+	start = std::chrono::steady_clock::now();
+	auto pos = util::strstr_n(s.Len(), s.Bytes(), strlen(needle),
+	                          reinterpret_cast<const u_char*>(needle));
+	end = std::chrono::steady_clock::now();
+	CHECK(pos == -1);
+	MESSAGE("strstr_n: " << std::chrono::duration_cast<ms>(end - start).count() << " ms");
+	}
+
 } // namespace zeek
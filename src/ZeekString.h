@@ -145,10 +145,19 @@ public:
 protected:
 	void Reset();
 
+	// Points to a buffer for the given number of bytes, which is
+	// the inline one if they fit.
+	byte_vec Allocate(int size);
+
+	// Strings copied in with their final NUL and at most this long
+	// live in the inline buffer instead of a separate allocation.
+	static constexpr int SMALL_SIZE = 15;
+
 	byte_vec b;
 	int n;
 	bool final_NUL;	// whether we have added a final NUL
 	bool use_free_to_delete;	// free() vs. operator delete
+	u_char small[SMALL_SIZE + 1];
 };
 
 // A comparison class that sorts pointers to String's according to
@@ -9,6 +9,7 @@
 #include "analyzer/protocol/pia/PIA.h"
 #include "../ZeekString.h"
 #include "../Event.h"
+#include "../Stats.h"
 
 namespace zeek::analyzer {
 
@@ -79,6 +80,12 @@ void Analyzer::SetAnalyzerTag(const Tag& arg_tag)
 	{
 	assert(! tag || tag == arg_tag);
 	tag = arg_tag;
+
+	if ( zeek::detail::analyzer_accounting && ! usage && ! finished )
+		{
+		usage = zeek::detail::analyzer_accounting->Usage(false, analyzer_mgr->GetComponentName(tag));
+		++usage->instances;
+		}
 	}
 
 bool Analyzer::IsAnalyzer(const char* name)
@@ -124,12 +131,24 @@ void Analyzer::CtorInit(const Tag& arg_tag, Connection* arg_conn)
 	resp_supporters = nullptr;
 	signature = nullptr;
 	output_handler = nullptr;
+	plan_stale = false;
+	usage = nullptr;
+
+	if ( zeek::detail::analyzer_accounting && tag )
+		{
+		usage = zeek::detail::analyzer_accounting->Usage(false, analyzer_mgr->GetComponentName(tag));
+		++usage->instances;
+		}
 	}
 
 Analyzer::~Analyzer()
 	{
 	assert(finished);
+	DeleteTree();
+	}
 
+void Analyzer::DeleteTree()
+	{
 	// Make sure any late entries into the analyzer tree are handled (e.g.
 	// from some Done() implementation).
 	LOOP_OVER_GIVEN_CHILDREN(i, new_children)
@@ -142,10 +161,14 @@ Analyzer::~Analyzer()
 	// implementation tries to inspect analyzer tree w/ assumption that
 	// all analyzers are still valid.
 	LOOP_OVER_GIVEN_CHILDREN(i, new_children)
-		delete *i;
+		analyzer_mgr->DisposeAnalyzer(*i);
 
 	LOOP_OVER_CHILDREN(i)
-		delete *i;
+		analyzer_mgr->DisposeAnalyzer(*i);
+
+	children.clear();
+	new_children.clear();
+	delivery_plan.clear();
 
 	SupportAnalyzer* next = nullptr;
 
@@ -161,7 +184,23 @@ Analyzer::~Analyzer()
 		delete a;
 		}
 
+	orig_supporters = resp_supporters = nullptr;
+
 	delete output_handler;
+	output_handler = nullptr;
+	}
+
+void Analyzer::Reset()
+	{
+	assert(finished);
+	DeleteTree();
+	prevented.clear();
+	timers.clear();
+	}
+
+void Analyzer::Reuse(Connection* arg_conn)
+	{
+	CtorInit(tag, arg_conn);
 	}
 
 void Analyzer::Init()
@@ -205,6 +244,9 @@ void Analyzer::Done()
 		if ( ! a->finished )
 			a->Done();
 
+	if ( usage )
+		--usage->instances;
+
 	finished = true;
 	}
 
@@ -214,6 +256,7 @@ void Analyzer::NextPacket(int len, const u_char* data, bool is_orig, uint64_t se
 	if ( skip )
 		return;
 
+	zeek::detail::AnalyzerUsageTimer usage_timer(usage, len);
 	SupportAnalyzer* next_sibling = FirstSupportAnalyzer(is_orig);
 
 	if ( next_sibling )
@@ -237,6 +280,7 @@ void Analyzer::NextStream(int len, const u_char* data, bool is_orig)
 	if ( skip )
 		return;
 
+	zeek::detail::AnalyzerUsageTimer usage_timer(usage, len);
 	SupportAnalyzer* next_sibling = FirstSupportAnalyzer(is_orig);
 
 	if ( next_sibling )
@@ -294,50 +338,52 @@ void Analyzer::NextEndOfData(bool is_orig)
 void Analyzer::ForwardPacket(int len, const u_char* data, bool is_orig,
 				uint64_t seq, const IP_Hdr* ip, int caplen)
 	{
+	zeek::detail::StageTimer stage(zeek::detail::STAGE_APP_ANALYZERS);
+
 	if ( output_handler )
 		output_handler->DeliverPacket(len, data, is_orig, seq,
 						ip, caplen);
 
-	AppendNewChildren();
+	if ( plan_stale )
+		UpdateDeliveryPlan();
 
 	// Pass to all children.
-	analyzer_list::iterator next;
-	for ( analyzer_list::iterator i = children.begin();
-	      i != children.end(); i = next )
+	for ( size_t i = 0; i < delivery_plan.size(); ++i )
 		{
-		Analyzer* current = *i;
-		next = ++i;
+		Analyzer* current = delivery_plan[i];
 
 		if ( ! (current->finished || current->removing ) )
 			current->NextPacket(len, data, is_orig, seq, ip, caplen);
 		else
-			DeleteChild(--i);
+			plan_stale = true;
 		}
 
-	AppendNewChildren();
+	if ( plan_stale )
+		UpdateDeliveryPlan();
 	}
 
 void Analyzer::ForwardStream(int len, const u_char* data, bool is_orig)
 	{
+	zeek::detail::StageTimer stage(zeek::detail::STAGE_APP_ANALYZERS);
+
 	if ( output_handler )
 		output_handler->DeliverStream(len, data, is_orig);
 
-	AppendNewChildren();
+	if ( plan_stale )
+		UpdateDeliveryPlan();
 
-	analyzer_list::iterator next;
-	for ( analyzer_list::iterator i = children.begin();
-	      i != children.end(); i = next )
+	for ( size_t i = 0; i < delivery_plan.size(); ++i )
 		{
-		Analyzer* current = *i;
-		next = ++i;
+		Analyzer* current = delivery_plan[i];
 
 		if ( ! (current->finished || current->removing ) )
 			current->NextStream(len, data, is_orig);
 		else
-			DeleteChild(--i);
+			plan_stale = true;
 		}
 
-	AppendNewChildren();
+	if ( plan_stale )
+		UpdateDeliveryPlan();
 	}
 
 void Analyzer::ForwardUndelivered(uint64_t seq, int len, bool is_orig)
@@ -345,42 +391,40 @@ void Analyzer::ForwardUndelivered(uint64_t seq, int len, bool is_orig)
 	if ( output_handler )
 		output_handler->Undelivered(seq, len, is_orig);
 
-	AppendNewChildren();
+	if ( plan_stale )
+		UpdateDeliveryPlan();
 
-	analyzer_list::iterator next;
-	for ( analyzer_list::iterator i = children.begin();
-	      i != children.end(); i = next )
+	for ( size_t i = 0; i < delivery_plan.size(); ++i )
 		{
-		Analyzer* current = *i;
-		next = ++i;
+		Analyzer* current = delivery_plan[i];
 
 		if ( ! (current->finished || current->removing ) )
 			current->NextUndelivered(seq, len, is_orig);
 		else
-			DeleteChild(--i);
+			plan_stale = true;
 		}
 
-	AppendNewChildren();
+	if ( plan_stale )
+		UpdateDeliveryPlan();
 	}
 
 void Analyzer::ForwardEndOfData(bool orig)
 	{
-	AppendNewChildren();
+	if ( plan_stale )
+		UpdateDeliveryPlan();
 
-	analyzer_list::iterator next;
-	for ( analyzer_list::iterator i = children.begin();
-	      i != children.end(); i = next )
+	for ( size_t i = 0; i < delivery_plan.size(); ++i )
 		{
-		Analyzer* current = *i;
-		next = ++i;
+		Analyzer* current = delivery_plan[i];
 
 		if ( ! (current->finished || current->removing ) )
 			current->NextEndOfData(orig);
 		else
-			DeleteChild(--i);
+			plan_stale = true;
 		}
 
-	AppendNewChildren();
+	if ( plan_stale )
+		UpdateDeliveryPlan();
 	}
 
 bool Analyzer::AddChildAnalyzer(Analyzer* analyzer, bool init)
@@ -392,7 +436,7 @@ bool Analyzer::AddChildAnalyzer(Analyzer* analyzer, bool init)
 	if ( HasChildAnalyzer(t) || prevent )
 		{
 		analyzer->Done();
-		delete analyzer;
+		analyzer_mgr->DisposeAnalyzer(analyzer);
 		return false;
 		}
 
@@ -404,6 +448,7 @@ bool Analyzer::AddChildAnalyzer(Analyzer* analyzer, bool init)
 
 	analyzer->parent = this;
 	new_children.push_back(analyzer);
+	plan_stale = true;
 
 	if ( init )
 		analyzer->Init();
@@ -450,6 +495,7 @@ bool Analyzer::RemoveChild(const analyzer_list& children, ID id)
 		// something not true because of a violation that
 		// triggered the removal in the first place.
 		i->removing = true;
+		plan_stale = true;
 		return true;
 		}
 
@@ -558,7 +604,8 @@ void Analyzer::DeleteChild(analyzer_list::iterator i)
 		fmt_analyzer(this).c_str(), fmt_analyzer(child).c_str());
 
 	children.erase(i);
-	delete child;
+	analyzer_mgr->DisposeAnalyzer(child);
+	plan_stale = true;
 	}
 
 void Analyzer::AddSupportAnalyzer(SupportAnalyzer* analyzer)
@@ -728,8 +775,8 @@ void Analyzer::AddTimer(analyzer_timer_func timer, double t,
 	zeek::detail::Timer* analyzer_timer = new
 		AnalyzerTimer(this, timer, t, do_expire, type);
 
-	zeek::detail::timer_mgr->Add(analyzer_timer);
 	timers.push_back(analyzer_timer);
+	conn->ScheduleTimer(analyzer_timer);
 	}
 
 void Analyzer::RemoveTimer(zeek::detail::Timer* t)
@@ -748,7 +795,7 @@ void Analyzer::CancelTimers()
 
 	// TODO: could be a for_each
 	for ( auto timer : tmp )
-		zeek::detail::timer_mgr->Cancel(timer);
+		conn->CancelTimer(timer);
 
 	timers_canceled = true;
 	timers.clear();
@@ -756,9 +803,38 @@ void Analyzer::CancelTimers()
 
 void Analyzer::AppendNewChildren()
 	{
+	if ( new_children.empty() )
+		return;
+
 	LOOP_OVER_GIVEN_CHILDREN(i, new_children)
 		children.push_back(*i);
 	new_children.clear();
+	plan_stale = true;
+	}
+
+void Analyzer::UpdateDeliveryPlan()
+	{
+	AppendNewChildren();
+	plan_stale = false;
+
+	// Deleting a child may change the tree again, e.g., through its
+	// Done() adding another child, which then marks the plan as stale
+	// for the next round.
+	analyzer_list::iterator next;
+	for ( analyzer_list::iterator i = children.begin();
+	      i != children.end(); i = next )
+		{
+		next = std::next(i);
+
+		if ( (*i)->finished || (*i)->removing )
+			{
+			bool stale = plan_stale;
+			DeleteChild(i);
+			plan_stale = stale;
+			}
+		}
+
+	delivery_plan.assign(children.begin(), children.end());
 	}
 
 unsigned int Analyzer::MemoryAllocation() const
@@ -778,6 +854,75 @@ unsigned int Analyzer::MemoryAllocation() const
 	return mem;
 	}
 
+void Analyzer::AccountMemory() const
+	{
+	// MemoryAllocation() includes children and support analyzers, which
+	// account their memory themselves.
+	uint64_t nested = 0;
+
+	LOOP_OVER_CONST_CHILDREN(i)
+		{
+		nested += (*i)->MemoryAllocation();
+		(*i)->AccountMemory();
+		}
+
+	for ( SupportAnalyzer* a = orig_supporters; a; a = a->sibling )
+		{
+		nested += a->MemoryAllocation();
+		a->AccountMemory();
+		}
+
+	for ( SupportAnalyzer* a = resp_supporters; a; a = a->sibling )
+		{
+		nested += a->MemoryAllocation();
+		a->AccountMemory();
+		}
+
+	if ( usage )
+		usage->memory += MemoryAllocation() - nested;
+	}
+
+bool Analyzer::CanCompact() const
+	{
+	if ( skip || finished || removing )
+		return true;
+
+	if ( ! IsResumable() )
+		return false;
+
+	LOOP_OVER_CONST_CHILDREN(i)
+		if ( ! (*i)->CanCompact() )
+			return false;
+
+	LOOP_OVER_GIVEN_CONST_CHILDREN(i, new_children)
+		if ( ! (*i)->CanCompact() )
+			return false;
+
+	for ( SupportAnalyzer* a = orig_supporters; a; a = a->sibling )
+		if ( ! a->CanCompact() )
+			return false;
+
+	for ( SupportAnalyzer* a = resp_supporters; a; a = a->sibling )
+		if ( ! a->CanCompact() )
+			return false;
+
+	return true;
+	}
+
+void Analyzer::Compact()
+	{
+	UpdateDeliveryPlan();
+
+	for ( auto child : delivery_plan )
+		child->Compact();
+
+	for ( SupportAnalyzer* a = orig_supporters; a; a = a->sibling )
+		a->Compact();
+
+	for ( SupportAnalyzer* a = resp_supporters; a; a = a->sibling )
+		a->Compact();
+	}
+
 void Analyzer::UpdateConnVal(RecordVal *conn_val)
 	{
 	LOOP_OVER_CHILDREN(i)
@@ -15,6 +15,7 @@
 #include "../EventHandler.h"
 #include "../Timer.h"
 #include "../IntrusivePtr.h"
+#include "../MemoryTag.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Connection, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Rule, zeek::detail);
@@ -22,6 +23,8 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(IP_Hdr, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(TCP_ApplicationAnalyzer, zeek, analyzer::tcp);
 ZEEK_FORWARD_DECLARE_NAMESPACED(PIA, zeek, analyzer::pia);
 
+namespace zeek::detail { struct AnalyzerUsage; }
+
 namespace zeek {
 using RecordValPtr = zeek::IntrusivePtr<RecordVal>;
 class File;
@@ -86,7 +89,7 @@ public:
  * When overiding any of the class' methods, always make sure to call the
  * base-class version first.
  */
-class Analyzer {
+class Analyzer : public zeek::detail::MemoryTagged<zeek::detail::MemoryTag::Connections> {
 public:
 	/**
 	 * Constructor.
@@ -613,7 +616,7 @@ public:
 		std::is_convertible_v<
 			std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	EnqueueConnEvent(EventHandlerPtr h, Args&&... args)
-		{ return EnqueueConnEvent(h, zeek::Args{std::forward<Args>(args)...}); }
+		{ return EnqueueConnEvent(h, zeek::make_args(std::forward<Args>(args)...)); }
 
 	/**
 	 * Convenience function that forwards directly to the corresponding
@@ -626,6 +629,44 @@ public:
 	 */
 	virtual unsigned int MemoryAllocation() const;
 
+	/**
+	 * Adds the memory of the analyzer and, recursively, of its children
+	 * and support analyzers to their entries with analyzer accounting.
+	 * Internal method.
+	 */
+	void AccountMemory() const;
+
+	/**
+	 * Returns true if the analyzer can pick up where it left off after
+	 * Compact() released its state while the connection was idle, see
+	 * \c connection_compaction_interval. Analyzers need to declare that by
+	 * overriding this; the default returns false.
+	 */
+	virtual bool IsResumable() const	{ return false; }
+
+	/**
+	 * Returns true if the analyzer's state may get compacted, which is
+	 * if it's disabled already, or if it and all its children and support
+	 * analyzers are resumable.
+	 */
+	bool CanCompact() const;
+
+	/**
+	 * Releases the state the analyzer can do without while its connection
+	 * is idle, and deletes children that are done. Only to be called if
+	 * CanCompact() returns true. Overrides must call the parent's version.
+	 */
+	virtual void Compact();
+
+	/**
+	 * Returns true if instances of the analyzer can get reused for further
+	 * connections once done with one, through Reset() and Reuse(). The
+	 * analyzer manager then keeps a pool of finished instances, see
+	 * \c analyzer_pool_size. Analyzers need to declare that by overriding
+	 * this; the default returns false.
+	 */
+	virtual bool IsReusable() const	{ return false; }
+
 protected:
 	friend class AnalyzerTimer;
 	friend class Manager;
@@ -668,6 +709,24 @@ protected:
 	 */
 	void CancelTimers();
 
+	/**
+	 * Releases all the state of a finished analyzer that belongs to its
+	 * connection, before it goes into its pool. The connection is still
+	 * around at this point. Only called if IsReusable() returns true.
+	 * Overrides must call the parent's version, which removes all child
+	 * and support analyzers.
+	 */
+	virtual void Reset();
+
+	/**
+	 * Prepares an analyzer taken from its pool for a new connection,
+	 * leaving it in the same state as its constructor would. Overrides
+	 * must call the parent's version first.
+	 *
+	 * @param conn The new connection.
+	 */
+	virtual void Reuse(Connection* conn);
+
 	/**
 	 * Removes a given timer. This is an internal method and shouldn't be
 	 * used by derived class. It does not cancel the timer.
@@ -723,9 +782,17 @@ private:
 	// already Done().
 	void DeleteChild(analyzer_list::iterator i);
 
+	// Brings the child list up to date, deleting children that are done
+	// and appending new ones, and rebuilds the delivery plan from it.
+	void UpdateDeliveryPlan();
+
 	// Helper for the ctors.
 	void CtorInit(const Tag& tag, Connection* conn);
 
+	// Disposes of all child and support analyzers, for the dtor and
+	// Reset().
+	void DeleteTree();
+
 	Tag tag;
 	ID id;
 
@@ -741,6 +808,12 @@ private:
 	analyzer_list new_children;
 	std::vector<Tag> prevented;
 
+	// The children that the Forward*() methods pass data to, as an array
+	// so that forwarding doesn't chase list nodes. It only changes along
+	// with the tree, which marks it stale until the next forwarding.
+	std::vector<Analyzer*> delivery_plan;
+	bool plan_stale;
+
 	bool protocol_confirmed;
 
 	TimerPList timers;
@@ -749,6 +822,9 @@ private:
 	bool finished;
 	bool removing;
 
+	// Set if analyzer_accounting is.
+	zeek::detail::AnalyzerUsage* usage;
+
 	static ID id_counter;
 };
 
@@ -2,12 +2,13 @@
 
 #include "Manager.h"
 
+#include <algorithm>
+
 #include "Hash.h"
 #include "Val.h"
 #include "IntrusivePtr.h"
 #include "RunState.h"
 
-#include "protocol/conn-size/ConnSize.h"
 #include "protocol/icmp/ICMP.h"
 #include "protocol/pia/PIA.h"
 #include "protocol/stepping-stone/SteppingStone.h"
@@ -20,43 +21,11 @@
 
 namespace zeek::analyzer {
 
-Manager::ConnIndex::ConnIndex(const IPAddr& _orig, const IPAddr& _resp,
-                              uint16_t _resp_p, uint16_t _proto)
-	{
-	if ( _orig == IPAddr::v4_unspecified )
-		// don't use the IPv4 mapping, use the literal unspecified address
-		// to indicate a wildcard
-		orig = IPAddr::v6_unspecified;
-	else
-		orig = _orig;
-
-	resp = _resp;
-	resp_p = _resp_p;
-	proto = _proto;
-	}
-
-Manager::ConnIndex::ConnIndex()
+size_t Manager::RespIndexHash::operator()(const RespIndex& i) const
 	{
-	orig = resp = IPAddr::v4_unspecified;
-	resp_p = 0;
-	proto = 0;
-	}
-
-bool Manager::ConnIndex::operator<(const ConnIndex& other) const
-	{
-	if ( orig != other.orig )
-		return orig < other.orig;
-
-	if ( resp != other.resp )
-		return resp < other.resp;
-
-	if ( proto != other.proto )
-		return proto < other.proto;
-
-	if ( resp_p != other.resp_p )
-		return resp_p < other.resp_p;
-
-	return false;
+	size_t h = std::hash<IPAddr>{}(i.resp);
+	h ^= (static_cast<size_t>(i.resp_p) << 16 | i.proto) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	return h;
 	}
 
 Manager::Manager()
@@ -73,12 +42,13 @@ Manager::~Manager()
 		delete i->second;
 
 	// Clean up expected-connection table.
-	while ( conns_by_timeout.size() )
-		{
-		ScheduledAnalyzer* a = conns_by_timeout.top();
-		conns_by_timeout.pop();
-		delete a;
-		}
+	for ( auto& slot : expiry_wheel )
+		for ( auto a : slot )
+			delete a;
+
+	for ( auto& p : pools )
+		for ( auto a : p.second )
+			delete a;
 	}
 
 void Manager::InitPreScript()
@@ -101,6 +71,8 @@ void Manager::InitPostScript()
 
 	for ( auto i = 0; i < port_list->Length(); ++i )
 		vxlan_ports.emplace_back(port_list->Idx(i)->AsPortVal()->Port());
+
+	pool_size = id::find_val("analyzer_pool_size")->AsCount();
 	}
 
 void Manager::DumpDebug()
@@ -304,6 +276,16 @@ Analyzer* Manager::InstantiateAnalyzer(const Tag& tag, Connection* conn)
 		return nullptr;
 		}
 
+	auto p = pools.find(tag);
+
+	if ( p != pools.end() && ! p->second.empty() )
+		{
+		Analyzer* a = p->second.back();
+		p->second.pop_back();
+		a->Reuse(conn);
+		return a;
+		}
+
 	Analyzer* a = c->Factory()(conn);
 
 	if ( ! a )
@@ -323,6 +305,26 @@ Analyzer* Manager::InstantiateAnalyzer(const char* name, Connection* conn)
 	return tag ? InstantiateAnalyzer(tag, conn) : nullptr;
 	}
 
+void Manager::DisposeAnalyzer(Analyzer* a)
+	{
+	if ( ! (pool_size && a->IsFinished() && a->IsReusable()) )
+		{
+		delete a;
+		return;
+		}
+
+	auto& pool = pools[a->GetAnalyzerTag()];
+
+	if ( pool.size() >= pool_size )
+		{
+		delete a;
+		return;
+		}
+
+	a->Reset();
+	pool.push_back(a);
+	}
+
 Manager::tag_set* Manager::LookupPort(TransportProto proto, uint32_t port, bool add_if_not_found)
 	{
 	analyzer_map_by_port* m = nullptr;
@@ -473,18 +475,11 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 			// Add TCPStats analyzer. This needs to see packets so
 			// we cannot add it as a normal child.
 			tcp->AddChildPacketAnalyzer(new analyzer::tcp::TCPStats_Analyzer(conn));
-
-		if ( IsEnabled(analyzer_connsize) )
-			// Add ConnSize analyzer. Needs to see packets, not stream.
-			tcp->AddChildPacketAnalyzer(new analyzer::conn_size::ConnSize_Analyzer(conn));
 		}
 
-	else
-		{
-		if ( IsEnabled(analyzer_connsize) )
-			// Add ConnSize analyzer. Needs to see packets, not stream.
-			root->AddChildAnalyzer(new analyzer::conn_size::ConnSize_Analyzer(conn));
-		}
+	if ( IsEnabled(analyzer_connsize) )
+		// The transport-layer analyzers do the counting.
+		conn->EnableConnSize();
 
 	if ( pia )
 		root->AddChildAnalyzer(pia->AsAnalyzer());
@@ -498,41 +493,73 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 	return true;
 	}
 
+void Manager::AddToExpiryWheel(ScheduledAnalyzer* a)
+	{
+	auto second = static_cast<int64_t>(a->timeout);
+	expiry_wheel[second % EXPIRY_WHEEL_SLOTS].push_back(a);
+	}
+
+void Manager::RemoveScheduled(ScheduledAnalyzer* a)
+	{
+	auto i = conns.find(a->resp);
+	assert(i != conns.end());
+
+	auto& list = i->second;
+	auto j = std::find(list.begin(), list.end(), a);
+	assert(j != list.end());
+
+	*j = list.back();
+	list.pop_back();
+
+	if ( list.empty() )
+		conns.erase(i);
+
+	--num_scheduled;
+
+	DBG_LOG(DBG_ANALYZER, "Expiring expected analyzer %s for connection %s",
+	        analyzer_mgr->GetComponentName(a->analyzer).c_str(),
+	        fmt_conn_id(a->orig, 0, a->resp.resp, a->resp.resp_p));
+
+	delete a;
+	}
+
 void Manager::ExpireScheduledAnalyzers()
 	{
 	if ( ! run_state::network_time )
 		return;
 
-	while ( conns_by_timeout.size() )
-		{
-		ScheduledAnalyzer* a = conns_by_timeout.top();
-
-		if ( a->timeout > run_state::network_time )
-			return;
+	auto now = static_cast<int64_t>(run_state::network_time);
 
-		conns_by_timeout.pop();
+	if ( ! num_scheduled )
+		{
+		expiry_next_second = now;
+		return;
+		}
 
-		std::pair<conns_map::iterator, conns_map::iterator> all = conns.equal_range(a->conn);
+	// A single turn covers all slots, however long ago the last visit was.
+	if ( now - expiry_next_second > EXPIRY_WHEEL_SLOTS )
+		expiry_next_second = now - EXPIRY_WHEEL_SLOTS;
 
-		bool found = false;
+	// Only seconds that have fully passed, so that all analyzers in a
+	// slot from the current turn are due.
+	for ( ; expiry_next_second < now; ++expiry_next_second )
+		{
+		auto& slot = expiry_wheel[expiry_next_second % EXPIRY_WHEEL_SLOTS];
 
-		for ( conns_map::iterator i = all.first; i != all.second; i++ )
+		for ( size_t i = 0; i < slot.size(); )
 			{
-			if ( i->second != a )
-				continue;
-
-			conns.erase(i);
+			ScheduledAnalyzer* a = slot[i];
 
-			DBG_LOG(DBG_ANALYZER, "Expiring expected analyzer %s for connection %s",
-			        analyzer_mgr->GetComponentName(a->analyzer).c_str(),
-			        fmt_conn_id(a->conn.orig, 0, a->conn.resp, a->conn.resp_p));
+			if ( a->timeout > run_state::network_time )
+				{
+				++i;
+				continue;
+				}
 
-			delete a;
-			found = true;
-			break;
+			slot[i] = slot.back();
+			slot.pop_back();
+			RemoveScheduled(a);
 			}
-
-		assert(found);
 		}
 	}
 
@@ -553,12 +580,17 @@ void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp,
 	ExpireScheduledAnalyzers();
 
 	ScheduledAnalyzer* a = new ScheduledAnalyzer;
-	a->conn = ConnIndex(orig, resp, resp_p, proto);
+
+	// Don't use the IPv4 mapping, use the literal unspecified address
+	// to indicate a wildcard.
+	a->orig = orig == IPAddr::v4_unspecified ? IPAddr::v6_unspecified : orig;
+	a->resp = {resp, resp_p, static_cast<uint16_t>(proto)};
 	a->analyzer = analyzer;
 	a->timeout = run_state::network_time + timeout;
 
-	conns.insert(std::make_pair(a->conn, a));
-	conns_by_timeout.push(a);
+	conns[a->resp].push_back(a);
+	AddToExpiryWheel(a);
+	++num_scheduled;
 	}
 
 void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp,
@@ -582,24 +614,28 @@ void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp, PortVal*
 
 Manager::tag_set Manager::GetScheduled(const Connection* conn)
 	{
-	ConnIndex c(conn->OrigAddr(), conn->RespAddr(),
-		    ntohs(conn->RespPort()), conn->ConnTransport());
+	tag_set result;
 
-	std::pair<conns_map::iterator, conns_map::iterator> all = conns.equal_range(c);
+	auto i = conns.find({conn->RespAddr(), ntohs(conn->RespPort()),
+	                     static_cast<uint16_t>(conn->ConnTransport())});
 
-	tag_set result;
+	if ( i == conns.end() )
+		return result;
 
-	for ( conns_map::iterator i = all.first; i != all.second; i++ )
-		result.insert(i->second->analyzer);
+	IPAddr orig = conn->OrigAddr();
 
-	// Try wildcard for originator.
-	c.orig = IPAddr::v6_unspecified;
-	all = conns.equal_range(c);
+	if ( orig == IPAddr::v4_unspecified )
+		orig = IPAddr::v6_unspecified;
 
-	for ( conns_map::iterator i = all.first; i != all.second; i++ )
+	for ( auto a : i->second )
 		{
-		if ( i->second->timeout > run_state::network_time )
-			result.insert(i->second->analyzer);
+		if ( a->orig == orig )
+			result.insert(a->analyzer);
+
+		// Wildcard for originator.
+		else if ( a->orig == IPAddr::v6_unspecified &&
+		          a->timeout > run_state::network_time )
+			result.insert(a->analyzer);
 		}
 
 	// We don't delete scheduled analyzers here. They will be expired
@@ -607,6 +643,49 @@ Manager::tag_set Manager::GetScheduled(const Connection* conn)
 	return result;
 	}
 
+bool Manager::IsScheduled(const IPAddr& orig, const IPAddr& resp, uint16_t resp_p,
+                          TransportProto proto) const
+	{
+	auto i = conns.find({resp, resp_p, static_cast<uint16_t>(proto)});
+
+	if ( i == conns.end() )
+		return false;
+
+	const IPAddr& o = orig == IPAddr::v4_unspecified ? IPAddr::v6_unspecified : orig;
+
+	for ( auto a : i->second )
+		{
+		if ( a->orig == o )
+			return true;
+
+		if ( a->orig == IPAddr::v6_unspecified &&
+		     a->timeout > run_state::network_time )
+			return true;
+		}
+
+	return false;
+	}
+
+bool Manager::HasAnalyzerFor(const IPAddr& a, uint32_t a_p, const IPAddr& b, uint32_t b_p,
+                             TransportProto proto)
+	{
+	if ( proto == TRANSPORT_TCP || proto == TRANSPORT_UDP )
+		{
+		for ( auto p : {a_p, b_p} )
+			{
+			auto ports = LookupPort(proto, p, false);
+
+			if ( ports && ! ports->empty() )
+				return true;
+			}
+		}
+
+	if ( conns.empty() )
+		return false;
+
+	return IsScheduled(a, b, b_p, proto) || IsScheduled(b, a, a_p, proto);
+	}
+
 bool Manager::ApplyScheduledAnalyzers(Connection* conn, bool init, TransportLayerAnalyzer* parent)
 	{
 	if ( ! parent )
@@ -20,7 +20,7 @@
  */
 #pragma once
 
-#include <queue>
+#include <unordered_map>
 #include <vector>
 
 #include "Analyzer.h"
@@ -238,6 +238,16 @@ public:
 	 */
 	Analyzer* InstantiateAnalyzer(const char* name, Connection* c);
 
+	/**
+	 * Gets rid of an analyzer that's no longer part of any analyzer tree.
+	 * Instances of reusable analyzers go back into their type's pool, if
+	 * there's room, for InstantiateAnalyzer() to hand out again; all
+	 * others get deleted.
+	 *
+	 * @param a The analyzer. Takes ownership.
+	 */
+	void DisposeAnalyzer(Analyzer* a);
+
 	/**
 	 * Given the first packet of a connection, builds its initial
 	 * analyzer tree.
@@ -337,6 +347,25 @@ public:
 	void ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp, PortVal* resp_p,
 	                      Val* analyzer, double timeout);
 
+	/**
+	 * Returns whether a connection between two endpoints would get an
+	 * application-layer analyzer from the start, either because one of
+	 * its ports is registered for one or because one is scheduled for
+	 * it. Either endpoint may turn out to be the responder.
+	 *
+	 * @param a The first endpoint's address.
+	 *
+	 * @param a_p The first endpoint's port, in host order.
+	 *
+	 * @param b The second endpoint's address.
+	 *
+	 * @param b_p The second endpoint's port, in host order.
+	 *
+	 * @param proto The connection's transport protocol.
+	 */
+	bool HasAnalyzerFor(const IPAddr& a, uint32_t a_p, const IPAddr& b, uint32_t b_p,
+	                    TransportProto proto);
+
 	/**
 	 * @return the UDP port numbers to be associated with VXLAN traffic.
 	 */
@@ -352,6 +381,8 @@ private:
 	tag_set* LookupPort(TransportProto proto, uint32_t port, bool add_if_not_found);
 
 	tag_set GetScheduled(const Connection* conn);
+	bool IsScheduled(const IPAddr& orig, const IPAddr& resp, uint16_t resp_p,
+	                 TransportProto proto) const;
 	void ExpireScheduledAnalyzers();
 
 	analyzer_map_by_port analyzers_by_port_tcp;
@@ -361,42 +392,56 @@ private:
 	Tag analyzer_stepping;
 	Tag analyzer_tcpstats;
 
+	// Finished instances of reusable analyzers, by type.
+	std::map<Tag, std::vector<Analyzer*>> pools;
+	uint64_t pool_size = 0;
+
 	//// Data structures to track analyzed scheduled for future connections.
 
-	// The index for a scheduled connection.
-	struct ConnIndex {
-		IPAddr orig;
+	// The responder side of a scheduled connection. Lookups always know
+	// it, while the originator may be a wildcard.
+	struct RespIndex {
 		IPAddr resp;
 		uint16_t resp_p;
 		uint16_t proto;
 
-		ConnIndex(const IPAddr& _orig, const IPAddr& _resp,
-			     uint16_t _resp_p, uint16_t _proto);
-		ConnIndex();
+		bool operator==(const RespIndex& other) const
+			{ return resp_p == other.resp_p && proto == other.proto && resp == other.resp; }
+	};
 
-		bool operator<(const ConnIndex& other) const;
+	struct RespIndexHash {
+		size_t operator()(const RespIndex& i) const;
 	};
 
 	// Information associated with a scheduled connection.
 	struct ScheduledAnalyzer {
-		ConnIndex conn;
+		IPAddr orig;	// IPAddr::v6_unspecified for any originator.
+		RespIndex resp;
 		Tag analyzer;
 		double timeout;
-
-		struct Comparator {
-			bool operator() (ScheduledAnalyzer* a, ScheduledAnalyzer* b) {
-				return a->timeout > b->timeout;
-			}
-		};
 	};
 
-	using conns_map = std::multimap<ConnIndex, ScheduledAnalyzer*>;
-	using conns_queue = std::priority_queue<ScheduledAnalyzer*,
-	                                        std::vector<ScheduledAnalyzer*>,
-	                                        ScheduledAnalyzer::Comparator>;
+	using scheduled_list = std::vector<ScheduledAnalyzer*>;
+
+	// Adds the analyzer to the wheel slot of its timeout.
+	void AddToExpiryWheel(ScheduledAnalyzer* a);
+
+	// Removes the analyzer from the index and deletes it.
+	void RemoveScheduled(ScheduledAnalyzer* a);
+
+	// Scheduled analyzers by responder, each with a short list of
+	// originators to scan.
+	std::unordered_map<RespIndex, scheduled_list, RespIndexHash> conns;
+	size_t num_scheduled = 0;
+
+	// Expiration runs off a wheel of one-second slots. An analyzer sits
+	// in the slot of its timeout's second, and a slot gets visited once
+	// network time has passed that second. Analyzers timing out more than
+	// a full turn ahead stay in their slot for a later turn.
+	static constexpr int EXPIRY_WHEEL_SLOTS = 256;
+	scheduled_list expiry_wheel[EXPIRY_WHEEL_SLOTS];
+	int64_t expiry_next_second = 0;	// The next second to visit.
 
-	conns_map conns;
-	conns_queue conns_by_timeout;
 	std::vector<uint16_t> vxlan_ports;
 };
 
@@ -53,7 +53,7 @@ void AYIYA_Analyzer::DeliverPacket(int len, const u_char* data, bool orig, uint6
 		std:shared_ptr<EncapsulationStack> e = Conn()->GetEncapsulation();
 		EncapsulatingConn ec(Conn(), BifEnum::Tunnel::AYIYA);
 		packet_analysis::IPTunnel::ip_tunnel_analyzer->ProcessEncapsulatedPacket(
-			run_state::network_time, nullptr, inner, e, ec);
+			run_state::network_time, nullptr, inner, encap_cache.Get(e, ec));
 		}
 	else if ( result == -2 )
 		ProtocolViolation("AYIYA next header internal mismatch",
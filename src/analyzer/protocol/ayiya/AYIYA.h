@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ayiya_pac.h"
+#include "TunnelEncapsulation.h"
 
 namespace binpac::AYIYA { class AYIYA_Conn; }
 
@@ -28,6 +29,7 @@ protected:
 	binpac::AYIYA::AYIYA_Conn* interp;
 	int inner_packet_offset = -1;
 	uint8_t next_header = 0;
+	EncapsulationCache encap_cache;
 };
 
 } // namespace zeek::analyzer::ayiya
@@ -1,6 +1,5 @@
 // See the file  in the main distribution directory for copyright.
 
-#include "ConnSize.h"
 #include "plugin/Plugin.h"
 #include "analyzer/Component.h"
 
@@ -10,7 +9,9 @@ class Plugin : public zeek::plugin::Plugin {
 public:
 	zeek::plugin::Configuration Configure() override
 		{
-		AddComponent(new zeek::analyzer::Component("ConnSize", zeek::analyzer::conn_size::ConnSize_Analyzer::Instantiate));
+		// Connections themselves keep the counts, the component only
+		// provides the tag for enabling and disabling them.
+		AddComponent(new zeek::analyzer::Component("ConnSize", nullptr));
 
 		zeek::plugin::Configuration config;
 		config.name = "Zeek::ConnSize";
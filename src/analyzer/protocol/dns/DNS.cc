@@ -39,6 +39,9 @@ void DNS_Interpreter::ParseMessage(const u_char* data, int len, int is_query)
 
 	detail::DNS_MsgInfo msg((detail::DNS_RawMsgHdr*) data, is_query);
 
+	name_cache.clear();
+	name_cache_data.clear();
+
 	if ( first_message && msg.QR && is_query == 1 )
 		{
 		is_query = msg.is_query = 0;
@@ -240,7 +243,7 @@ bool DNS_Interpreter::ParseAnswer(detail::DNS_MsgInfo* msg,
 	// Note that the exact meaning of some of these fields will be
 	// re-interpreted by other, more adventurous RR types.
 
-	msg->query_name = make_intrusive<StringVal>(new String(name, name_end - name, true));
+	msg->SetQueryName(name, name_end - name);
 	msg->atype = detail::RR_Type(ExtractShort(data, len));
 	msg->aclass = ExtractShort(data, len);
 	msg->ttl = ExtractLong(data, len);
@@ -413,7 +416,10 @@ bool DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
                                    const u_char* msg_start)
 	{
 	if ( len <= 0 )
+		{
+		++label_errors;
 		return false;
+		}
 
 	const u_char* orig_data = data;
 	int label_len = data[0];
@@ -422,7 +428,10 @@ bool DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 	--len;
 
 	if ( len <= 0 )
+		{
+		++label_errors;
 		return false;
+		}
 
 	if ( label_len == 0 )
 		// Found terminating label.
@@ -448,16 +457,34 @@ bool DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 			//  sometimes compression points to compression.)
 
 			analyzer->Weird("DNS_label_forward_compress_offset");
+			++label_errors;
 			return false;
 			}
 
-		// Recursively resolve name.
+		// Recursively resolve name, unless an earlier pointer to the
+		// same place already did.
 		const u_char* recurse_data = msg_start + offset;
 		int recurse_max_len = orig_data - recurse_data;
 
+		if ( const auto* c = LookupName(offset, recurse_max_len, name_len) )
+			{
+			memcpy(name, name_cache_data.data() + c->start, c->len);
+			name_len -= c->len;
+			name += c->len;
+			return false;
+			}
+
+		int errors = label_errors;
+		int max_len = recurse_max_len;
+
 		u_char* name_end = ExtractName(recurse_data, recurse_max_len,
 						name, name_len, msg_start);
 
+		// A name decoded right up to its limit might decode
+		// differently under another one.
+		if ( label_errors == errors && recurse_max_len > 0 )
+			CacheName(offset, max_len - recurse_max_len, name, name_end - name);
+
 		name_len -= name_end - name;
 		name = name_end;
 
@@ -467,6 +494,7 @@ bool DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 	if ( label_len > len )
 		{
 		analyzer->Weird("DNS_label_len_gt_pkt");
+		++label_errors;
 		data += len;	// consume the rest of the packet
 		len = 0;
 		return false;
@@ -477,12 +505,14 @@ bool DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 		ntohs(analyzer->Conn()->RespPort()) != 137 )
 		{
 		analyzer->Weird("DNS_label_too_long");
+		++label_errors;
 		return false;
 		}
 
 	if ( label_len >= name_len )
 		{
 		analyzer->Weird("DNS_label_len_gt_name_len");
+		++label_errors;
 		return false;
 		}
 
@@ -498,6 +528,30 @@ bool DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 	return true;
 	}
 
+const DNS_Interpreter::CachedName* DNS_Interpreter::LookupName(int offset, int max_len,
+                                                               int name_len) const
+	{
+	for ( const auto& c : name_cache )
+		{
+		// The decoding must not have come close to the current
+		// limits, or it might have failed under them.
+		if ( c.offset == offset && c.span < max_len && c.len < name_len )
+			return &c;
+		}
+
+	return nullptr;
+	}
+
+void DNS_Interpreter::CacheName(int offset, int span, const u_char* name, int len)
+	{
+	// Messages rarely point to more than a few places.
+	if ( name_cache.size() >= 32 )
+		return;
+
+	name_cache.push_back({offset, span, int(name_cache_data.size()), len});
+	name_cache_data.insert(name_cache_data.end(), name, name + len);
+	}
+
 uint16_t DNS_Interpreter::ExtractShort(const u_char*& data, int& len)
 	{
 	if ( len < 2 )
@@ -540,20 +594,6 @@ bool DNS_Interpreter::ParseRR_Name(detail::DNS_MsgInfo* msg,
                                    const u_char*& data, int& len, int rdlength,
                                    const u_char* msg_start)
 	{
-	const u_char* data_start = data;
-
-	u_char name[513];
-	int name_len = sizeof(name) - 1;
-
-	u_char* name_end = ExtractName(data, len, name, name_len, msg_start);
-	if ( ! name_end )
-		return false;
-
-	if ( data - data_start != rdlength )
-		{
-		analyzer->Weird("DNS_RR_length_mismatch");
-		}
-
 	EventHandlerPtr reply_event;
 	switch ( msg->atype ) {
 		case detail::TYPE_NS:
@@ -575,13 +615,33 @@ bool DNS_Interpreter::ParseRR_Name(detail::DNS_MsgInfo* msg,
 			reply_event = nullptr;
 	}
 
-	if ( reply_event && ! msg->skip_event )
-		analyzer->EnqueueConnEvent(reply_event,
-			analyzer->ConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
-			make_intrusive<StringVal>(new String(name, name_end - name, true))
-		);
+	if ( ! reply_event || msg->skip_event )
+		{
+		data += rdlength;
+		len -= rdlength;
+		return true;
+		}
+
+	const u_char* data_start = data;
+
+	u_char name[513];
+	int name_len = sizeof(name) - 1;
+
+	u_char* name_end = ExtractName(data, len, name, name_len, msg_start);
+	if ( ! name_end )
+		return false;
+
+	if ( data - data_start != rdlength )
+		{
+		analyzer->Weird("DNS_RR_length_mismatch");
+		}
+
+	analyzer->EnqueueConnEvent(reply_event,
+		analyzer->ConnVal(),
+		msg->BuildHdrVal(),
+		msg->BuildAnswerVal(),
+		make_intrusive<StringVal>(new String(name, name_end - name, true))
+	);
 
 	return true;
 	}
@@ -590,6 +650,13 @@ bool DNS_Interpreter::ParseRR_SOA(detail::DNS_MsgInfo* msg,
                                   const u_char*& data, int& len, int rdlength,
                                   const u_char* msg_start)
 	{
+	if ( ! dns_SOA_reply || msg->skip_event )
+		{
+		data += rdlength;
+		len -= rdlength;
+		return true;
+		}
+
 	const u_char* data_start = data;
 
 	u_char mname[513];
@@ -618,25 +685,22 @@ bool DNS_Interpreter::ParseRR_SOA(detail::DNS_MsgInfo* msg,
 	if ( data - data_start != rdlength )
 		analyzer->Weird("DNS_RR_length_mismatch");
 
-	if ( dns_SOA_reply && ! msg->skip_event )
-		{
-		static auto dns_soa = id::find_type<RecordType>("dns_soa");
-		auto r = make_intrusive<RecordVal>(dns_soa);
-		r->Assign(0, make_intrusive<StringVal>(new String(mname, mname_end - mname, true)));
-		r->Assign(1, make_intrusive<StringVal>(new String(rname, rname_end - rname, true)));
-		r->Assign(2, val_mgr->Count(serial));
-		r->Assign(3, make_intrusive<IntervalVal>(double(refresh), Seconds));
-		r->Assign(4, make_intrusive<IntervalVal>(double(retry), Seconds));
-		r->Assign(5, make_intrusive<IntervalVal>(double(expire), Seconds));
-		r->Assign(6, make_intrusive<IntervalVal>(double(minimum), Seconds));
-
-		analyzer->EnqueueConnEvent(dns_SOA_reply,
-			analyzer->ConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
-			std::move(r)
-		);
-		}
+	static auto dns_soa = id::find_type<RecordType>("dns_soa");
+	auto r = make_intrusive<RecordVal>(dns_soa);
+	r->Assign(0, make_intrusive<StringVal>(new String(mname, mname_end - mname, true)));
+	r->Assign(1, make_intrusive<StringVal>(new String(rname, rname_end - rname, true)));
+	r->Assign(2, val_mgr->Count(serial));
+	r->Assign(3, make_intrusive<IntervalVal>(double(refresh), Seconds));
+	r->Assign(4, make_intrusive<IntervalVal>(double(retry), Seconds));
+	r->Assign(5, make_intrusive<IntervalVal>(double(expire), Seconds));
+	r->Assign(6, make_intrusive<IntervalVal>(double(minimum), Seconds));
+
+	analyzer->EnqueueConnEvent(dns_SOA_reply,
+		analyzer->ConnVal(),
+		msg->BuildHdrVal(),
+		msg->BuildAnswerVal(),
+		std::move(r)
+	);
 
 	return true;
 	}
@@ -645,6 +709,13 @@ bool DNS_Interpreter::ParseRR_MX(detail::DNS_MsgInfo* msg,
                                  const u_char*& data, int& len, int rdlength,
                                  const u_char* msg_start)
 	{
+	if ( ! dns_MX_reply || msg->skip_event )
+		{
+		data += rdlength;
+		len -= rdlength;
+		return true;
+		}
+
 	const u_char* data_start = data;
 
 	int preference = ExtractShort(data, len);
@@ -659,14 +730,13 @@ bool DNS_Interpreter::ParseRR_MX(detail::DNS_MsgInfo* msg,
 	if ( data - data_start != rdlength )
 		analyzer->Weird("DNS_RR_length_mismatch");
 
-	if ( dns_MX_reply && ! msg->skip_event )
-		analyzer->EnqueueConnEvent(dns_MX_reply,
-			analyzer->ConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
-			make_intrusive<StringVal>(new String(name, name_end - name, true)),
-			val_mgr->Count(preference)
-		);
+	analyzer->EnqueueConnEvent(dns_MX_reply,
+		analyzer->ConnVal(),
+		msg->BuildHdrVal(),
+		msg->BuildAnswerVal(),
+		make_intrusive<StringVal>(new String(name, name_end - name, true)),
+		val_mgr->Count(preference)
+	);
 
 	return true;
 	}
@@ -684,6 +754,13 @@ bool DNS_Interpreter::ParseRR_SRV(detail::DNS_MsgInfo* msg,
                                   const u_char*& data, int& len, int rdlength,
                                   const u_char* msg_start)
 	{
+	if ( ! dns_SRV_reply || msg->skip_event )
+		{
+		data += rdlength;
+		len -= rdlength;
+		return true;
+		}
+
 	const u_char* data_start = data;
 
 	unsigned int priority = ExtractShort(data, len);
@@ -700,16 +777,15 @@ bool DNS_Interpreter::ParseRR_SRV(detail::DNS_MsgInfo* msg,
 	if ( data - data_start != rdlength )
 		analyzer->Weird("DNS_RR_length_mismatch");
 
-	if ( dns_SRV_reply && ! msg->skip_event )
-		analyzer->EnqueueConnEvent(dns_SRV_reply,
-			analyzer->ConnVal(),
-			msg->BuildHdrVal(),
-			msg->BuildAnswerVal(),
-			make_intrusive<StringVal>(new String(name, name_end - name, true)),
-			val_mgr->Count(priority),
-			val_mgr->Count(weight),
-			val_mgr->Count(port)
-		);
+	analyzer->EnqueueConnEvent(dns_SRV_reply,
+		analyzer->ConnVal(),
+		msg->BuildHdrVal(),
+		msg->BuildAnswerVal(),
+		make_intrusive<StringVal>(new String(name, name_end - name, true)),
+		val_mgr->Count(priority),
+		val_mgr->Count(weight),
+		val_mgr->Count(port)
+	);
 
 	return true;
 	}
@@ -1794,6 +1870,21 @@ DNS_MsgInfo::DNS_MsgInfo(DNS_RawMsgHdr* hdr, int arg_is_query)
 	skip_event = 0;
 	}
 
+void DNS_MsgInfo::SetQueryName(const u_char* name, int len)
+	{
+	query_name_data = name;
+	query_name_len = len;
+	query_name = nullptr;
+	}
+
+const StringValPtr& DNS_MsgInfo::QueryName()
+	{
+	if ( ! query_name && query_name_data )
+		query_name = make_intrusive<StringVal>(new String(query_name_data, query_name_len, true));
+
+	return query_name;
+	}
+
 RecordValPtr DNS_MsgInfo::BuildHdrVal()
 	{
 	static auto dns_msg = id::find_type<RecordType>("dns_msg");
@@ -1822,7 +1913,7 @@ RecordValPtr DNS_MsgInfo::BuildAnswerVal()
 	auto r = make_intrusive<RecordVal>(dns_answer);
 
 	r->Assign(0, val_mgr->Count(int(answer_type)));
-	r->Assign(1, query_name);
+	r->Assign(1, QueryName());
 	r->Assign(2, val_mgr->Count(atype));
 	r->Assign(3, val_mgr->Count(aclass));
 	r->Assign(4, make_intrusive<IntervalVal>(double(ttl), Seconds));
@@ -1838,7 +1929,7 @@ RecordValPtr DNS_MsgInfo::BuildEDNS_Val()
 	auto r = make_intrusive<RecordVal>(dns_edns_additional);
 
 	r->Assign(0, val_mgr->Count(int(answer_type)));
-	r->Assign(1, query_name);
+	r->Assign(1, QueryName());
 
 	// type = 0x29 or 41 = EDNS
 	r->Assign(2, val_mgr->Count(atype));
@@ -1910,7 +2001,7 @@ RecordValPtr DNS_MsgInfo::BuildTSIG_Val(struct TSIG_DATA* tsig)
 	double rtime = tsig->time_s + tsig->time_ms / 1000.0;
 
 	// r->Assign(0, val_mgr->Count(int(answer_type)));
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, make_intrusive<StringVal>(tsig->alg_name));
 	r->Assign(3, make_intrusive<StringVal>(tsig->sig));
@@ -1928,7 +2019,7 @@ RecordValPtr DNS_MsgInfo::BuildRRSIG_Val(RRSIG_DATA* rrsig)
 	static auto dns_rrsig_rr = id::find_type<RecordType>("dns_rrsig_rr");
 	auto r = make_intrusive<RecordVal>(dns_rrsig_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(rrsig->type_covered));
 	r->Assign(3, val_mgr->Count(rrsig->algorithm));
@@ -1949,7 +2040,7 @@ RecordValPtr DNS_MsgInfo::BuildDNSKEY_Val(DNSKEY_DATA* dnskey)
 	static auto dns_dnskey_rr = id::find_type<RecordType>("dns_dnskey_rr");
 	auto r = make_intrusive<RecordVal>(dns_dnskey_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(dnskey->dflags));
 	r->Assign(3, val_mgr->Count(dnskey->dprotocol));
@@ -1965,7 +2056,7 @@ RecordValPtr DNS_MsgInfo::BuildNSEC3_Val(NSEC3_DATA* nsec3)
 	static auto dns_nsec3_rr = id::find_type<RecordType>("dns_nsec3_rr");
 	auto r = make_intrusive<RecordVal>(dns_nsec3_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(nsec3->nsec_flags));
 	r->Assign(3, val_mgr->Count(nsec3->nsec_hash_algo));
@@ -1985,7 +2076,7 @@ RecordValPtr DNS_MsgInfo::BuildNSEC3PARAM_Val(NSEC3PARAM_DATA* nsec3param)
 	static auto dns_nsec3param_rr = id::find_type<RecordType>("dns_nsec3param_rr");
 	auto r = make_intrusive<RecordVal>(dns_nsec3param_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(nsec3param->nsec_flags));
 	r->Assign(3, val_mgr->Count(nsec3param->nsec_hash_algo));
@@ -2002,7 +2093,7 @@ RecordValPtr DNS_MsgInfo::BuildDS_Val(DS_DATA* ds)
 	static auto dns_ds_rr = id::find_type<RecordType>("dns_ds_rr");
 	auto r = make_intrusive<RecordVal>(dns_ds_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(ds->key_tag));
 	r->Assign(3, val_mgr->Count(ds->algorithm));
@@ -2018,7 +2109,7 @@ RecordValPtr DNS_MsgInfo::BuildBINDS_Val(BINDS_DATA* binds)
 	static auto dns_binds_rr = id::find_type<RecordType>("dns_binds_rr");
 	auto r = make_intrusive<RecordVal>(dns_binds_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(binds->algorithm));
 	r->Assign(3, val_mgr->Count(binds->key_id));
@@ -2034,7 +2125,7 @@ RecordValPtr DNS_MsgInfo::BuildLOC_Val(LOC_DATA* loc)
 	static auto dns_loc_rr = id::find_type<RecordType>("dns_loc_rr");
 	auto r = make_intrusive<RecordVal>(dns_loc_rr);
 
-	r->Assign(0, query_name);
+	r->Assign(0, QueryName());
 	r->Assign(1, val_mgr->Count(int(answer_type)));
 	r->Assign(2, val_mgr->Count(loc->version));
 	r->Assign(3, val_mgr->Count(loc->size));
@@ -2148,12 +2239,22 @@ DNS_Analyzer::DNS_Analyzer(Connection* conn)
 : analyzer::tcp::TCP_ApplicationAnalyzer("DNS", conn)
 	{
 	interp = new detail::DNS_Interpreter(this);
+	SetupTransport();
+	}
+
+DNS_Analyzer::~DNS_Analyzer()
+	{
+	delete interp;
+	}
+
+void DNS_Analyzer::SetupTransport()
+	{
 	contents_dns_orig = contents_dns_resp = nullptr;
 
 	if ( Conn()->ConnTransport() == TRANSPORT_TCP )
 		{
-		contents_dns_orig = new Contents_DNS(conn, true, interp);
-		contents_dns_resp = new Contents_DNS(conn, false, interp);
+		contents_dns_orig = new Contents_DNS(Conn(), true, interp);
+		contents_dns_resp = new Contents_DNS(Conn(), false, interp);
 		AddSupportAnalyzer(contents_dns_orig);
 		AddSupportAnalyzer(contents_dns_resp);
 		}
@@ -2165,9 +2266,19 @@ DNS_Analyzer::DNS_Analyzer(Connection* conn)
 		}
 	}
 
-DNS_Analyzer::~DNS_Analyzer()
+void DNS_Analyzer::Reset()
 	{
-	delete interp;
+	analyzer::tcp::TCP_ApplicationAnalyzer::Reset();
+
+	// The support analyzers are gone with that.
+	contents_dns_orig = contents_dns_resp = nullptr;
+	}
+
+void DNS_Analyzer::Reuse(Connection* conn)
+	{
+	analyzer::tcp::TCP_ApplicationAnalyzer::Reuse(conn);
+	interp->Reset();
+	SetupTransport();
 	}
 
 void DNS_Analyzer::Init()
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "analyzer/protocol/tcp/TCP.h"
 #include "binpac_zeek.h"
 
@@ -264,6 +266,18 @@ public:
 	RecordValPtr BuildBINDS_Val(struct BINDS_DATA*);
 	RecordValPtr BuildLOC_Val(struct LOC_DATA*);
 
+	/**
+	 * Sets the owner name of the RR currently being parsed. The name
+	 * must remain valid until the next call; its script value is only
+	 * built once something asks for it.
+	 */
+	void SetQueryName(const u_char* name, int len);
+
+	/**
+	 * Returns the owner name of the RR currently being parsed.
+	 */
+	const StringValPtr& QueryName();
+
 	int id;
 	int opcode;	///< query type, see DNS_Opcode
 	int rcode;	///< return code, see DNS_Code
@@ -279,7 +293,6 @@ public:
 	int arcount;	///< number of additional RRs
 	int is_query;	///< whether it came from the session initiator
 
-	StringValPtr query_name;
 	RR_Type atype;
 	int aclass;	///< normally = 1, inet
 	uint32_t ttl;
@@ -290,6 +303,11 @@ public:
 				///< identical answer, there may be problems
 	// uint32* addr;	///< cache value to pass back results
 				///< for forward lookups
+
+private:
+	const u_char* query_name_data = nullptr;
+	int query_name_len = 0;
+	StringValPtr query_name;
 };
 
 class DNS_Interpreter {
@@ -300,6 +318,8 @@ public:
 
 	void Timeout()	{ }
 
+	void Reset()	{ first_message = true; }
+
 protected:
 	void EndMessage(detail::DNS_MsgInfo* msg);
 
@@ -402,8 +422,28 @@ protected:
 	                            String* question_name,
 	                            String* original_name);
 
+	// Names that compression pointers of the current message resolved
+	// to, so that further pointers to the same place don't need to
+	// decode them again.
+	struct CachedName {
+		int offset;	// Pointed to in the message.
+		int span;	// Message bytes decoded from there on.
+		int start;	// Of the name in name_cache_data.
+		int len;
+	};
+
+	const CachedName* LookupName(int offset, int max_len, int name_len) const;
+	void CacheName(int offset, int span, const u_char* name, int len);
+
 	analyzer::Analyzer* analyzer;
 	bool first_message;
+
+	std::vector<CachedName> name_cache;
+	std::vector<u_char> name_cache_data;
+
+	// Counts the labels that failed to decode; names decoded without
+	// any failures can go into the cache.
+	int label_errors = 0;
 };
 
 enum TCP_DNS_state {
@@ -453,10 +493,19 @@ public:
 	                      analyzer::tcp::TCP_Endpoint* peer, bool gen_event) override;
 	void ExpireTimer(double t);
 
+	// From Analyzer.h
+	bool IsReusable() const override	{ return true; }
+
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new DNS_Analyzer(conn); }
 
 protected:
+	void Reset() override;
+	void Reuse(Connection* conn) override;
+
+	// Sets up what depends on the connection's transport.
+	void SetupTransport();
+
 	detail::DNS_Interpreter* interp;
 	Contents_DNS* contents_dns_orig;
 	Contents_DNS* contents_dns_resp;
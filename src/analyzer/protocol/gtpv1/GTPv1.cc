@@ -65,7 +65,7 @@ void GTPv1_Analyzer::DeliverPacket(int len, const u_char* data, bool orig, uint6
 		std::shared_ptr<zeek::EncapsulationStack> e = Conn()->GetEncapsulation();
 		EncapsulatingConn ec(Conn(), BifEnum::Tunnel::GTPv1);
 		zeek::packet_analysis::IPTunnel::ip_tunnel_analyzer->ProcessEncapsulatedPacket(
-			run_state::network_time, nullptr, inner, e, ec);
+			run_state::network_time, nullptr, inner, encap_cache.Get(e, ec));
 		}
 	else if ( result == -2 )
 		ProtocolViolation("Invalid IP version in wrapped packet",
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gtpv1_pac.h"
+#include "TunnelEncapsulation.h"
 
 namespace binpac::GTPv1 { class GTPv1_Conn; }
 
@@ -30,6 +31,7 @@ protected:
 	int inner_packet_offset = -1;
 	uint8_t next_header = 0;
 	RecordValPtr gtp_hdr_val;
+	EncapsulationCache encap_cache;
 };
 
 } // namespace zeek::analyzer::gtpv1
@@ -838,6 +838,11 @@ void HTTP_Message::Weird(const char* msg)
 
 HTTP_Analyzer::HTTP_Analyzer(Connection* conn)
 : analyzer::tcp::TCP_ApplicationAnalyzer("HTTP", conn)
+	{
+	InitState(conn);
+	}
+
+void HTTP_Analyzer::InitState(Connection* conn)
 	{
 	num_requests = num_replies = 0;
 	num_request_lines = num_reply_lines = 0;
@@ -852,6 +857,11 @@ HTTP_Analyzer::HTTP_Analyzer(Connection* conn)
 
 	reply_ongoing = 0;
 	reply_code = 0;
+	reply_reason_phrase = nullptr;
+
+	request_version = reply_version = {};
+	request_method = request_URI = unescaped_URI = nullptr;
+	unanswered_requests = {};
 
 	connect_request = false;
 	pia = nullptr;
@@ -867,6 +877,22 @@ HTTP_Analyzer::HTTP_Analyzer(Connection* conn)
 	AddSupportAnalyzer(content_line_resp);
 	}
 
+void HTTP_Analyzer::Reset()
+	{
+	analyzer::tcp::TCP_ApplicationAnalyzer::Reset();
+
+	// Done() took care of the messages already, and the support
+	// analyzers are gone with the above.
+	content_line_orig = content_line_resp = nullptr;
+	pia = nullptr;
+	}
+
+void HTTP_Analyzer::Reuse(Connection* conn)
+	{
+	analyzer::tcp::TCP_ApplicationAnalyzer::Reuse(conn);
+	InitState(conn);
+	}
+
 void HTTP_Analyzer::Done()
 	{
 	if ( IsFinished() )
@@ -1253,7 +1279,7 @@ int HTTP_Analyzer::HTTP_RequestLine(const char* line, const char* end_of_line)
 		return -1;
 		}
 
-	request_method = make_intrusive<StringVal>(end_of_method - line, line);
+	request_method = val_mgr->InternedString(end_of_method - line, line);
 
 	Conn()->Match(zeek::detail::Rule::HTTP_REQUEST,
 			(const u_char*) unescaped_URI->AsString()->Bytes(),
@@ -1409,7 +1435,7 @@ void HTTP_Analyzer::HTTP_Request()
 			request_method,
 			TruncateURI(request_URI),
 			TruncateURI(unescaped_URI),
-			make_intrusive<StringVal>(util::fmt("%.1f", request_version.ToDouble()))
+			val_mgr->InternedString(util::fmt("%.1f", request_version.ToDouble()))
 		);
 	}
 
@@ -1418,7 +1444,7 @@ void HTTP_Analyzer::HTTP_Reply()
 	if ( http_reply )
 		EnqueueConnEvent(http_reply,
 			ConnVal(),
-			make_intrusive<StringVal>(util::fmt("%.1f", reply_version.ToDouble())),
+			val_mgr->InternedString(util::fmt("%.1f", reply_version.ToDouble())),
 			val_mgr->Count(reply_code),
 			reply_reason_phrase ?
 				reply_reason_phrase :
@@ -1646,14 +1672,11 @@ void HTTP_Analyzer::HTTP_Header(bool is_orig, analyzer::mime::MIME_Header* h)
 		if ( DEBUG_http )
 			DEBUG_MSG("%.6f http_header\n", run_state::network_time);
 
-		auto upper_hn = analyzer::mime::to_string_val(h->get_name());
-		upper_hn->ToUpper();
-
 		EnqueueConnEvent(http_header,
 			ConnVal(),
 			val_mgr->Bool(is_orig),
 			analyzer::mime::to_string_val(h->get_name()),
-			std::move(upper_hn),
+			analyzer::mime::to_upper_string_val(h->get_name()),
 			analyzer::mime::to_string_val(h->get_value())
 		);
 		}
@@ -1811,7 +1834,18 @@ String* unescape_URI(const u_char* line, const u_char* line_end,
 			}
 
 		else
-			*URI_p++ = *line;
+			{
+			// Copy everything up to the next escape in one go.
+			auto next = static_cast<const u_char*>(memchr(line, '%', line_end - line));
+
+			if ( ! next )
+				next = line_end;
+
+			memcpy(URI_p, line, next - line);
+			URI_p += next - line;
+			line = next;
+			continue;
+			}
 
 		++line;
 		}
@@ -167,6 +167,7 @@ public:
 	void Done() override;
 	void DeliverStream(int len, const u_char* data, bool orig) override;
 	void Undelivered(uint64_t seq, int len, bool orig) override;
+	bool IsReusable() const override	{ return true; }
 
 	// Overriden from analyzer::tcp::TCP_ApplicationAnalyzer
 	void EndpointEOF(bool is_orig) override;
@@ -205,6 +206,12 @@ public:
 			http_event || http_stats); }
 
 protected:
+	void Reset() override;
+	void Reuse(Connection* conn) override;
+
+	// Puts the analyzer into its initial state for a connection.
+	void InitState(Connection* conn);
+
 	void GenStats();
 
 	int HTTP_RequestLine(const char* line, const char* end_of_line);
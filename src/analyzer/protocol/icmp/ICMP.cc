@@ -49,7 +49,8 @@ void ICMP_Analyzer::DeliverPacket(int len, const u_char* data,
 
 	const struct icmp* icmpp = (const struct icmp*) data;
 
-	if ( ! zeek::detail::ignore_checksums && 
+	if ( ! run_state::current_pkt->l4_checksummed &&
+	     ! zeek::detail::ignore_checksums && 
 	     ! zeek::id::find_val<TableVal>("ignore_checksums_nets")->Contains(ip->IPHeaderSrcAddr()) &&
 	     caplen >= len )
 		{
@@ -113,7 +114,10 @@ void ICMP_Analyzer::DeliverPacket(int len, const u_char* data,
 
 
 	if ( caplen >= len )
+		{
+		Conn()->CountPacket(is_orig, ip->TotalLen());
 		ForwardPacket(len, data, is_orig, seq, ip, caplen);
+		}
 
 	if ( zeek::detail::rule_matcher )
 		matcher_state.Match(zeek::detail::Rule::PAYLOAD, data, len, is_orig,
@@ -347,9 +351,9 @@ RecordValPtr ICMP_Analyzer::ExtractICMP4Context(int len, const u_char*& data)
 		{
 		bad_hdr_len = 0;
 		ip_len = ip_hdr->TotalLen();
-		bad_checksum = ! run_state::current_pkt->l3_checksummed &&
-		  (detail::in_cksum(reinterpret_cast<const uint8_t*>(ip_hdr->IP4_Hdr()),
-		                    ip_hdr_len) != 0xffff);
+		// Offloading only covers the outer headers, not the quoted one.
+		bad_checksum = detail::in_cksum(reinterpret_cast<const uint8_t*>(ip_hdr->IP4_Hdr()),
+		                                ip_hdr_len) != 0xffff;
 
 		src_addr = ip_hdr->SrcAddr();
 		dst_addr = ip_hdr->DstAddr();
@@ -477,8 +481,9 @@ void ICMP_Analyzer::Describe(ODesc* d) const
 
 void ICMP_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	{
-	const auto& orig_endp = conn_val->GetField("orig");
-	const auto& resp_endp = conn_val->GetField("resp");
+	// Fields 1 and 2 are $orig and $resp, see Connection::ConnVal().
+	const auto& orig_endp = conn_val->GetField(1);
+	const auto& resp_endp = conn_val->GetField(2);
 
 	UpdateEndpointVal(orig_endp, true);
 	UpdateEndpointVal(resp_endp, false);
@@ -25,6 +25,7 @@ public:
 	explicit ICMP_Analyzer(Connection* conn);
 
 	void UpdateConnVal(RecordVal *conn_val) override;
+	bool IsResumable() const override	{ return true; }
 
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new ICMP_Analyzer(conn); }
@@ -1,6 +1,11 @@
 #include "zeek-config.h"
 
 #include "MIME.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "NetVar.h"
 #include "Base64.h"
 #include "Reporter.h"
@@ -23,6 +28,49 @@ namespace zeek::analyzer::mime {
 
 static const data_chunk_t null_data_chunk = { 0, nullptr };
 
+// Returns the number of bytes at the start of the data that
+// quoted-printable decoding passes on as they are: the printable
+// characters other than '=', and whitespace.
+static int qp_literal_run(const char* data, int len)
+	{
+	int i = 0;
+
+#if defined(__SSE2__)
+	const __m128i above_space = _mm_set1_epi8(32);
+	const __m128i below_del = _mm_set1_epi8(127);
+	const __m128i equals = _mm_set1_epi8('=');
+	const __m128i ht = _mm_set1_epi8(HT);
+	const __m128i sp = _mm_set1_epi8(SP);
+
+	for ( ; i + 16 <= len; i += 16 )
+		{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+		// Bytes above 127 compare as negative.
+		__m128i printable = _mm_andnot_si128(_mm_cmpeq_epi8(v, equals),
+		                                     _mm_and_si128(_mm_cmpgt_epi8(v, above_space),
+		                                                   _mm_cmpgt_epi8(below_del, v)));
+		__m128i literal = _mm_or_si128(printable, _mm_or_si128(_mm_cmpeq_epi8(v, ht),
+		                                                       _mm_cmpeq_epi8(v, sp)));
+
+		int mask = _mm_movemask_epi8(literal);
+
+		if ( mask != 0xffff )
+			return i + __builtin_ctz(~mask);
+		}
+#endif
+
+	for ( ; i < len; ++i )
+		{
+		unsigned char c = data[i];
+
+		if ( ! ((c >= 33 && c <= 126 && c != '=') || c == HT || c == SP) )
+			break;
+		}
+
+	return i;
+	}
+
 int mime_header_only = 0;
 int mime_decode_data = 1;
 int mime_submit_data = 1;
@@ -132,6 +180,16 @@ StringValPtr to_string_val(const data_chunk_t buf)
 	return to_string_val(buf.length, buf.data);
 	}
 
+StringValPtr to_upper_string_val(const data_chunk_t buf)
+	{
+	std::string upper(buf.data, buf.length);
+
+	for ( auto& c : upper )
+		c = toupper(c);
+
+	return val_mgr->InternedString(upper.size(), upper.data());
+	}
+
 static data_chunk_t get_data_chunk(String* s)
 	{
 	data_chunk_t b;
@@ -455,11 +513,16 @@ void MIME_Multiline::append(int len, const char* data)
 	buffer.push_back(new String((const u_char*) data, len, true));
 	}
 
-String* MIME_Multiline::get_concatenated_line()
+const String* MIME_Multiline::get_concatenated_line()
 	{
 	if ( buffer.empty() )
 		return nullptr;
 
+	// Most headers fit on a single line, which then doesn't need
+	// another copy.
+	if ( buffer.size() == 1 )
+		return buffer[0];
+
 	delete line;
 	line = concatenate(buffer);
 
@@ -472,7 +535,7 @@ MIME_Header::MIME_Header(MIME_Multiline* hl)
 	lines = hl;
 	name = value = value_token = rest_value = null_data_chunk;
 
-	String* s = hl->get_concatenated_line();
+	const String* s = hl->get_concatenated_line();
 	int len = s->Len();
 	const char* data = (const char*) s->Bytes();
 
@@ -807,10 +870,8 @@ bool MIME_Entity::ParseContentTypeField(MIME_Header* h)
 	data += offset;
 	len -= offset;
 
-	content_type_str = make_intrusive<StringVal>(ty.length, ty.data);
-	content_type_str->ToUpper();
-	content_subtype_str = make_intrusive<StringVal>(subty.length, subty.data);
-	content_subtype_str->ToUpper();
+	content_type_str = to_upper_string_val(ty);
+	content_subtype_str = to_upper_string_val(subty);
 
 	ParseContentType(ty, subty);
 
@@ -1026,7 +1087,11 @@ void MIME_Entity::DecodeDataLine(int len, const char* data, bool trailing_CRLF)
 			DecodeBinary(len, data, trailing_CRLF);
 			break;
 	}
-	FlushData();
+
+	// Base64 mostly carries attachments, whose data doesn't need to go
+	// out line by line. EndOfData() flushes what's left.
+	if ( content_encoding != CONTENT_ENCODING_BASE64 )
+		FlushData();
 	}
 
 void MIME_Entity::DecodeBinary(int len, const char* data, bool trailing_CRLF)
@@ -1074,6 +1139,16 @@ void MIME_Entity::DecodeQuotedPrintable(int len, const char* data)
 
 	for ( i = 0; i <= end_of_line; ++i )
 		{
+		// Pass on runs of literal characters at once.
+		int n = qp_literal_run(data + i, end_of_line + 1 - i);
+
+		if ( n > 0 )
+			{
+			DataOctets(n, data + i);
+			i += n - 1;
+			continue;
+			}
+
 		if ( data[i] == '=' )
 			{
 			if ( i == end_of_line )
@@ -1300,9 +1375,7 @@ RecordValPtr MIME_Message::ToHeaderVal(MIME_Header* h)
 	static auto mime_header_rec = id::find_type<RecordType>("mime_header_rec");
 	auto header_record = make_intrusive<RecordVal>(mime_header_rec);
 	header_record->Assign(0, to_string_val(h->get_name()));
-	auto upper_hn = to_string_val(h->get_name());
-	upper_hn->ToUpper();
-	header_record->Assign(1, std::move(upper_hn));
+	header_record->Assign(1, to_upper_string_val(h->get_name()));
 	header_record->Assign(2, to_string_val(h->get_value()));
 	return header_record;
 	}
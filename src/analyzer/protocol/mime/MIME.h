@@ -61,7 +61,7 @@ public:
 	~MIME_Multiline();
 
 	void append(int len, const char* data);
-	String* get_concatenated_line();
+	const String* get_concatenated_line();
 
 protected:
 	std::vector<const String*> buffer;
@@ -286,6 +286,9 @@ extern StringVal* new_string_val(const data_chunk_t buf);
 extern StringValPtr to_string_val(int length, const char* data);
 extern StringValPtr to_string_val(const char* data, const char* end_of_data);
 extern StringValPtr to_string_val(const data_chunk_t buf);
+// Returns the data in upper case, as a shared value from
+// ValManager::InternedString() that must not be modified.
+extern StringValPtr to_upper_string_val(const data_chunk_t buf);
 extern int fputs(data_chunk_t b, FILE* fp);
 extern bool istrequal(data_chunk_t s, const char* t);
 extern bool is_lws(char ch);
@@ -11,6 +11,8 @@
 
 namespace zeek::analyzer::pia {
 
+uint64_t PIA::total_buffered = 0;
+
 PIA::PIA(analyzer::Analyzer* arg_as_analyzer)
 	: state(INIT), as_analyzer(arg_as_analyzer), conn(), current_packet()
 	{
@@ -28,7 +30,15 @@ void PIA::ClearBuffer(Buffer* buffer)
 		{
 		next = b->next;
 		delete b->ip;
-		delete [] b->data;
+
+		if ( b->data )
+			{
+			total_buffered -= b->len;
+
+			if ( ! b->pin )
+				delete [] b->data;
+			}
+
 		delete b;
 		}
 
@@ -36,20 +46,39 @@ void PIA::ClearBuffer(Buffer* buffer)
 	buffer->size = 0;
 	}
 
+void PIA::PIA_Compact()
+	{
+	// Past buffering, nothing gets replayed from the buffer anymore.
+	if ( pkt_buffer.state == MATCHING_ONLY || pkt_buffer.state == SKIPPING )
+		ClearBuffer(&pkt_buffer);
+	}
+
 void PIA::AddToBuffer(Buffer* buffer, uint64_t seq, int len, const u_char* data,
                       bool is_orig, const IP_Hdr* ip)
 	{
-	u_char* tmp = nullptr;
+	DataBlock* b = new DataBlock;
 
 	if ( data )
 		{
-		tmp = new u_char[len];
-		memcpy(tmp, data, len);
+		// Chances are the data sits in packet memory the reassembler
+		// or the packet source holds on to anyway.
+		b->pin = Reassembler::PinDelivered(data, len);
+
+		if ( b->pin )
+			b->data = data;
+		else
+			{
+			u_char* tmp = new u_char[len];
+			memcpy(tmp, data, len);
+			b->data = tmp;
+			}
+
+		total_buffered += len;
 		}
+	else
+		b->data = nullptr;
 
-	DataBlock* b = new DataBlock;
 	b->ip = ip ? ip->Copy() : nullptr;
-	b->data = tmp;
 	b->is_orig = is_orig;
 	b->len = len;
 	b->seq = seq;
@@ -72,6 +101,16 @@ void PIA::AddToBuffer(Buffer* buffer, int len, const u_char* data, bool is_orig,
 	AddToBuffer(buffer, -1, len, data, is_orig, ip);
 	}
 
+bool PIA::BufferBudgetExceeded()
+	{
+	if ( ! zeek::detail::dpd_buffer_memory_budget ||
+	     total_buffered <= zeek::detail::dpd_buffer_memory_budget )
+		return false;
+
+	as_analyzer->Weird("dpd_buffer_memory_budget_exceeded");
+	return true;
+	}
+
 void PIA::ReplayPacketBuffer(analyzer::Analyzer* analyzer)
 	{
 	DBG_LOG(DBG_ANALYZER, "PIA replaying %d total packet bytes", pkt_buffer.size);
@@ -105,7 +144,7 @@ void PIA::PIA_DeliverPacket(int len, const u_char* data, bool is_orig, uint64_t
 	     len > 0 )
 		{
 		AddToBuffer(&pkt_buffer, seq, len, data, is_orig, ip);
-		if ( pkt_buffer.size > zeek::detail::dpd_buffer_size )
+		if ( pkt_buffer.size > zeek::detail::dpd_buffer_size || BufferBudgetExceeded() )
 			new_state = zeek::detail::dpd_match_only_beginning ?
 						SKIPPING : MATCHING_ONLY;
 		}
@@ -113,6 +152,13 @@ void PIA::PIA_DeliverPacket(int len, const u_char* data, bool is_orig, uint64_t
 	// FIXME: I'm not sure why it does not work with eol=true...
 	DoMatch(data, len, is_orig, true, false, false, ip);
 
+	// Usually the first bytes of each side already rule out all the
+	// signatures, in which case there's no point in buffering further.
+	// Clearing the state in between packets starts matching over,
+	// though.
+	if ( new_state == BUFFERING && ! clear_state && PayloadMatchingExhausted() )
+		new_state = SKIPPING;
+
 	if ( clear_state )
 		zeek::detail::RuleMatcherState::ClearMatchState(is_orig);
 
@@ -192,6 +238,16 @@ PIA_TCP::~PIA_TCP()
 	ClearBuffer(&stream_buffer);
 	}
 
+void PIA_TCP::Compact()
+	{
+	PIA_Compact();
+
+	if ( stream_buffer.state == MATCHING_ONLY || stream_buffer.state == SKIPPING )
+		ClearBuffer(&stream_buffer);
+
+	analyzer::tcp::TCP_ApplicationAnalyzer::Compact();
+	}
+
 void PIA_TCP::Init()
 	{
 	analyzer::tcp::TCP_ApplicationAnalyzer::Init();
@@ -280,13 +336,16 @@ void PIA_TCP::DeliverStream(int len, const u_char* data, bool is_orig)
 	if ( stream_buffer.state == BUFFERING || new_state == BUFFERING )
 		{
 		AddToBuffer(&stream_buffer, len, data, is_orig);
-		if ( stream_buffer.size > zeek::detail::dpd_buffer_size )
+		if ( stream_buffer.size > zeek::detail::dpd_buffer_size || BufferBudgetExceeded() )
 			new_state = zeek::detail::dpd_match_only_beginning ?
 						SKIPPING : MATCHING_ONLY;
 		}
 
 	DoMatch(data, len, is_orig, false, false, false, nullptr);
 
+	if ( new_state == BUFFERING && PayloadMatchingExhausted() )
+		new_state = SKIPPING;
+
 	stream_buffer.state = new_state;
 	}
 
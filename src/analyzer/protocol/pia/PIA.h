@@ -4,6 +4,7 @@
 
 #include "analyzer/Analyzer.h"
 #include "analyzer/protocol/tcp/TCP.h"
+#include "iosource/PacketBuffer.h"
 #include "RuleMatcher.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(RuleEndpointState, zeek::detail);
@@ -41,6 +42,7 @@ public:
 
 protected:
 	void PIA_Done();
+	void PIA_Compact();
 	void PIA_DeliverPacket(int len, const u_char* data, bool is_orig,
 				uint64_t seq, const IP_Hdr* ip, int caplen, bool clear_state);
 
@@ -55,6 +57,10 @@ protected:
 		int len;
 		uint64_t seq;
 		DataBlock* next;
+
+		// If set, data points into this packet memory, which we
+		// then hold on to rather than having our own copy.
+		PacketBufferPtr pin;
 	};
 
 	struct Buffer {
@@ -72,6 +78,10 @@ protected:
 	                 const u_char* data, bool is_orig, const IP_Hdr* ip = nullptr);
 	void ClearBuffer(Buffer* buffer);
 
+	// Returns true if the buffers of all PIAs together hold more than
+	// dpd_buffer_memory_budget, reporting a weird if so.
+	bool BufferBudgetExceeded();
+
 	DataBlock* CurrentPacket()	{ return &current_packet; }
 
 	void DoMatch(const u_char* data, int len, bool is_orig, bool bol,
@@ -85,6 +95,9 @@ private:
 	analyzer::Analyzer* as_analyzer;
 	Connection* conn;
 	DataBlock current_packet;
+
+	// Bytes of data in the buffers of all PIAs.
+	static uint64_t total_buffered;
 };
 
 // PIA for UDP.
@@ -95,6 +108,14 @@ public:
 		{ SetConn(conn); }
 	~PIA_UDP() override { }
 
+	// From Analyzer.h
+	bool IsResumable() const override	{ return true; }
+	void Compact() override
+		{
+		PIA_Compact();
+		Analyzer::Compact();
+		}
+
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new PIA_UDP(conn); }
 
@@ -140,6 +161,10 @@ public:
 
 	void ReplayStreamBuffer(analyzer::Analyzer* analyzer);
 
+	// From Analyzer.h
+	bool IsResumable() const override	{ return true; }
+	void Compact() override;
+
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new PIA_TCP(conn); }
 
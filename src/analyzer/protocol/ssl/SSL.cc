@@ -1,10 +1,15 @@
 
 #include "SSL.h"
+
+#include <algorithm>
+#include <cstring>
+
 #include "analyzer/protocol/tcp/TCP_Reassembler.h"
 #include "Reporter.h"
 #include "util.h"
 
 #include "events.bif.h"
+#include "consts.bif.h"
 #include "ssl_pac.h"
 #include "tls-handshake_pac.h"
 
@@ -24,6 +29,27 @@ SSL_Analyzer::~SSL_Analyzer()
 	delete handshake_interp;
 	}
 
+void SSL_Analyzer::Reset()
+	{
+	analyzer::tcp::TCP_ApplicationAnalyzer::Reset();
+
+	// The binpac parsers have no way to start over, so only the
+	// analyzer itself gets recycled.
+	delete interp;
+	delete handshake_interp;
+	interp = nullptr;
+	handshake_interp = nullptr;
+	}
+
+void SSL_Analyzer::Reuse(Connection* conn)
+	{
+	analyzer::tcp::TCP_ApplicationAnalyzer::Reuse(conn);
+	interp = new binpac::SSL::SSL_Conn(this);
+	handshake_interp = new binpac::TLSHandshake::Handshake_Conn(this);
+	had_gap = false;
+	trackers[0] = trackers[1] = RecordTracker();
+	}
+
 void SSL_Analyzer::Done()
 	{
 	analyzer::tcp::TCP_ApplicationAnalyzer::Done();
@@ -61,9 +87,89 @@ void SSL_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 		// deliver data to the other side if the script layer can handle this.
 		return;
 
+	DeliverRecords(len, data, orig);
+	}
+
+bool SSL_Analyzer::CanSkip() const
+	{
+	return BifConst::SSL::skip_encrypted_data && ! ssl_encrypted_data &&
+	       interp->isEstablished();
+	}
+
+void SSL_Analyzer::DeliverRecords(int len, const u_char* data, bool orig)
+	{
+	auto& t = trackers[orig];
+	const u_char* end = data + len;
+
+	// The start of the bytes that still need to go to binpac.
+	const u_char* run = data;
+
+	while ( data < end && ! t.lost )
+		{
+		if ( t.remaining > 0 )
+			{
+			auto n = std::min(t.remaining, static_cast<uint64_t>(end - data));
+			data += n;
+			t.remaining -= n;
+
+			if ( t.skipping )
+				run = data;
+
+			continue;
+			}
+
+		if ( t.header_len == 0 )
+			{
+			// Once records may get skipped, their headers get held back
+			// until it's clear whether binpac needs to see the record.
+			// Everything before goes to binpac first, so that it ends on
+			// a record boundary.
+			t.holding = CanSkip();
+
+			if ( t.holding )
+				{
+				ParseRecords(run, data, orig);
+				run = data;
+				}
+			}
+
+		auto n = std::min(static_cast<ptrdiff_t>(sizeof(t.header) - t.header_len), end - data);
+		memcpy(t.header + t.header_len, data, n);
+		t.header_len += n;
+		data += n;
+
+		if ( t.holding )
+			run = data;
+
+		if ( t.header_len < static_cast<int>(sizeof(t.header)) )
+			break;
+
+		t.header_len = 0;
+		t.remaining = (t.header[3] << 8) | t.header[4];
+
+		// SSLv2 records, and whatever binpac is going to complain about,
+		// aren't something to follow.
+		if ( t.header[0] < binpac::SSL::CHANGE_CIPHER_SPEC ||
+		     t.header[0] > binpac::SSL::HEARTBEAT || t.header[1] != 3 )
+			t.lost = true;
+
+		t.skipping = t.holding && ! t.lost && t.header[0] == binpac::SSL::APPLICATION_DATA;
+
+		if ( t.holding && ! t.skipping )
+			ParseRecords(t.header, t.header + sizeof(t.header), orig);
+		}
+
+	ParseRecords(run, end, orig);
+	}
+
+void SSL_Analyzer::ParseRecords(const u_char* begin, const u_char* end, bool orig)
+	{
+	if ( begin == end )
+		return;
+
 	try
 		{
-		interp->NewData(orig, data, data + len);
+		interp->NewData(orig, begin, end);
 		}
 	catch ( const binpac::Exception& e )
 		{
@@ -19,6 +19,7 @@ public:
 	void Done() override;
 	void DeliverStream(int len, const u_char* data, bool orig) override;
 	void Undelivered(uint64_t seq, int len, bool orig) override;
+	bool IsReusable() const override	{ return true; }
 
 	void SendHandshake(uint16_t raw_tls_version, const u_char* begin, const u_char* end, bool orig);
 
@@ -32,9 +33,34 @@ public:
 		{ return new SSL_Analyzer(conn); }
 
 protected:
+	void Reset() override;
+	void Reuse(Connection* conn) override;
+
+	// Follows one direction's record layer, handing everything to the
+	// binpac parser except for the application data records that
+	// CanSkip() allows to skip.
+	void DeliverRecords(int len, const u_char* data, bool orig);
+
+	// Returns true if application data records no longer need parsing:
+	// the connection is established and nobody wants to see them.
+	bool CanSkip() const;
+
+	void ParseRecords(const u_char* begin, const u_char* end, bool orig);
+
+	// The record layer state of one direction.
+	struct RecordTracker {
+		u_char header[5];
+		int header_len = 0;
+		uint64_t remaining = 0;	// Bytes left of the current record.
+		bool holding = false;	// The header is held back from binpac.
+		bool skipping = false;	// The current record gets skipped.
+		bool lost = false;	// Not a record layer we can follow.
+	};
+
 	binpac::SSL::SSL_Conn* interp;
 	binpac::TLSHandshake::Handshake_Conn* handshake_interp;
 	bool had_gap;
+	RecordTracker trackers[2];
 
 };
 
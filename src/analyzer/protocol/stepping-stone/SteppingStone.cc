@@ -71,14 +71,16 @@ bool SteppingStoneEndpoint::DataSent(double t, uint64_t seq, int len, int caplen
 		return false;
 
 	double tmin = t - zeek::detail::stp_delta;
+	auto& endps = stp_manager->OrderedEndpoints();
 
-	while ( stp_manager->OrderedEndpoints().length() > 0 )
+	while ( ! endps.empty() )
 		{
-	    auto e = stp_manager->OrderedEndpoints().front();
+		auto e = endps.front();
 
 		if ( e->stp_resume_time < tmin )
 			{
-			stp_manager->OrderedEndpoints().pop_front();
+			endps.pop_front();
+			e->stp_queued = false;
 			e->Done();
 			Unref(e);
 			}
@@ -105,26 +107,32 @@ bool SteppingStoneEndpoint::DataSent(double t, uint64_t seq, int len, int caplen
 	stp_last_time = stp_resume_time = t;
 
 	Event(stp_resume_endp, stp_id);
-	for ( auto ep : stp_manager->OrderedEndpoints() )
+
+	// Move to the end, keeping the list's reference, so that this only
+	// looks at other endpoints and the list stays ordered.
+	if ( stp_queued )
+		endps.erase(stp_pos);
+	else
+		Ref(this);
+
+	for ( auto ep : endps )
 		{
-		if ( ep->endp->TCP() != endp->TCP() )
-			{
-			Ref(ep);
-			Ref(this);
+		// Skip the connection's other endpoint, and pairs that are
+		// still correlated from an earlier resume.
+		if ( ep->endp->TCP() == endp->TCP() ||
+		     ! stp_inbound_endps.emplace(ep->stp_id, ep).second )
+			continue;
 
-			stp_inbound_endps[ep->stp_id] = ep;
-			ep->stp_outbound_endps[stp_id] = this;
+		Ref(ep);
+		Ref(this);
 
-			Event(stp_correlate_pair, ep->stp_id, stp_id);
-			}
+		ep->stp_outbound_endps[stp_id] = this;
 
-		else
-			{ // ep and this belong to same connection
-			}
+		Event(stp_correlate_pair, ep->stp_id, stp_id);
 		}
 
-	stp_manager->OrderedEndpoints().push_back(this);
-	Ref(this);
+	stp_pos = endps.insert(endps.end(), this);
+	stp_queued = true;
 
 	return true;
 	}
@@ -2,7 +2,8 @@
 
 #pragma once
 
-#include "Queue.h"
+#include <list>
+
 #include "analyzer/protocol/tcp/TCP.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(NetSessions, zeek);
@@ -38,6 +39,10 @@ protected:
 	int stp_id;
 	std::map<int, SteppingStoneEndpoint*> stp_inbound_endps;
 	std::map<int, SteppingStoneEndpoint*> stp_outbound_endps;
+
+	// The endpoint's place in the manager's list, if it's in there.
+	std::list<SteppingStoneEndpoint*>::iterator stp_pos;
+	bool stp_queued = false;
 };
 
 class SteppingStone_Analyzer : public analyzer::tcp::TCP_ApplicationAnalyzer {
@@ -70,14 +75,16 @@ protected:
 class SteppingStoneManager {
 public:
 
-	PQueue<SteppingStoneEndpoint>& OrderedEndpoints()
+	// The endpoints that resumed within the last stp_delta, each one
+	// once and ordered by its latest resume time.
+	std::list<SteppingStoneEndpoint*>& OrderedEndpoints()
 		{ return ordered_endps; }
 
 	// Use postfix ++, since the first ID needs to be even.
 	int NextID()			{ return endp_cnt++; }
 
 protected:
-	PQueue<SteppingStoneEndpoint> ordered_endps;
+	std::list<SteppingStoneEndpoint*> ordered_endps;
 	int endp_cnt = 0;
 };
 
@@ -1,4 +1,16 @@
 #include "ContentLine.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "TCP.h"
 #include "Reporter.h"
 
@@ -6,6 +18,76 @@
 
 namespace zeek::analyzer::tcp {
 
+// Returns the number of bytes at the start of the data that are neither
+// CR nor LF, nor NUL if stop_at_nul is set, i.e., that the line splitter
+// just copies.
+static int plain_run(const u_char* data, int len, bool stop_at_nul)
+	{
+	// Without NULs to stop at, the third comparison just repeats the
+	// first one.
+	const char third = stop_at_nul ? '\0' : '\r';
+	int i = 0;
+
+#if defined(__AVX2__)
+	const __m256i cr32 = _mm256_set1_epi8('\r');
+	const __m256i lf32 = _mm256_set1_epi8('\n');
+	const __m256i third32 = _mm256_set1_epi8(third);
+
+	for ( ; i + 32 <= len; i += 32 )
+		{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr32),
+		                                                  _mm256_cmpeq_epi8(v, lf32)),
+		                                  _mm256_cmpeq_epi8(v, third32));
+
+		if ( unsigned int mask = _mm256_movemask_epi8(special) )
+			return i + __builtin_ctz(mask);
+		}
+#endif
+
+#if defined(__SSE2__)
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i third16 = _mm_set1_epi8(third);
+
+	for ( ; i + 16 <= len; i += 16 )
+		{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, cr),
+		                                            _mm_cmpeq_epi8(v, lf)),
+		                               _mm_cmpeq_epi8(v, third16));
+
+		if ( int mask = _mm_movemask_epi8(special) )
+			return i + __builtin_ctz(mask);
+		}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16_t cr = vdupq_n_u8('\r');
+	const uint8x16_t lf = vdupq_n_u8('\n');
+	const uint8x16_t third16 = vdupq_n_u8(third);
+
+	for ( ; i + 16 <= len; i += 16 )
+		{
+		uint8x16_t v = vld1q_u8(data + i);
+		uint8x16_t special = vorrq_u8(vorrq_u8(vceqq_u8(v, cr), vceqq_u8(v, lf)),
+		                              vceqq_u8(v, third16));
+
+		// The scalar loop below pinpoints it.
+		if ( vmaxvq_u8(special) )
+			break;
+		}
+#endif
+
+	for ( ; i < len; ++i )
+		{
+		u_char c = data[i];
+
+		if ( c == '\r' || c == '\n' || c == third )
+			break;
+		}
+
+	return i;
+	}
+
 ContentLine_Analyzer::ContentLine_Analyzer(Connection* conn, bool orig, int max_line_length)
 : TCP_SupportAnalyzer("CONTENTLINE", conn, orig), max_line_length(max_line_length)
 	{
@@ -25,6 +107,8 @@ void ContentLine_Analyzer::InitState()
 	skip_deliveries = false;
 	skip_partial = false;
 	buf = nullptr;
+	offset = 0;
+	last_char = 0;
 	seq_delivered_in_lines = 0;
 	skip_pending = 0;
 	seq = 0;
@@ -54,11 +138,6 @@ void ContentLine_Analyzer::InitBuffer(int size)
 			memcpy(b, buf, offset);
 		delete [] buf;
 		}
-	else
-		{
-		offset = 0;
-		last_char = 0;
-		}
 
 	buf = b;
 	buf_len = size;
@@ -74,6 +153,19 @@ bool ContentLine_Analyzer::HasPartialLine() const
 	return buf && offset > 0;
 	}
 
+void ContentLine_Analyzer::Compact()
+	{
+	if ( ! HasPartialLine() )
+		{
+		// DoDeliverOnce() allocates anew.
+		delete [] buf;
+		buf = nullptr;
+		buf_len = 0;
+		}
+
+	TCP_SupportAnalyzer::Compact();
+	}
+
 void ContentLine_Analyzer::DeliverStream(int len, const u_char* data,
 						bool is_orig)
 	{
@@ -269,14 +361,31 @@ int ContentLine_Analyzer::DoDeliverOnce(int len, const u_char* data)
 
 		case '\0':
 			if ( flag_NULs )
+				{
 				CheckNUL();
-			else
-				buf[offset++] = c;
-			break;
+				break;
+				}
+
+			// Otherwise a NUL is a plain byte.
+			// fallthrough
 
 		default:
-			buf[offset++] = c;
+			{
+			// Take the whole run of plain bytes at once, up to
+			// where the line would exceed its maximum length.
+			int n = std::min(plain_run(data, len, flag_NULs),
+			                 max_line_length - offset);
+
+			if ( offset + n > buf_len )
+				InitBuffer(std::max(buf_len * 2, offset + n));
+
+			memcpy(buf + offset, data, n);
+			offset += n;
+			data += n - 1;
+			len -= n - 1;
+			c = data[0];
 			break;
+			}
 		}
 
 		if ( last_char == '\r' )
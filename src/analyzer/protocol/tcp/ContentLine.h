@@ -37,6 +37,11 @@ public:
 
 	bool HasPartialLine() const;
 
+	// From Analyzer.h. Without a partial line, the buffer gets released
+	// until the next delivery.
+	bool IsResumable() const override	{ return true; }
+	void Compact() override;
+
 	bool SkipDeliveries() const
 		{ return skip_deliveries; }
 
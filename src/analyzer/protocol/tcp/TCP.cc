@@ -6,6 +6,7 @@
 
 #include "analyzer/protocol/tcp/TCP_Reassembler.h"
 #include "analyzer/protocol/pia/PIA.h"
+#include "analyzer/Manager.h"
 
 #include "IP.h"
 #include "RunState.h"
@@ -149,7 +150,7 @@ TCP_Analyzer::TCP_Analyzer(Connection* conn)
 TCP_Analyzer::~TCP_Analyzer()
 	{
 	LOOP_OVER_GIVEN_CHILDREN(i, packet_children)
-		delete *i;
+		analyzer_mgr->DisposeAnalyzer(*i);
 
 	delete orig;
 	delete resp;
@@ -275,7 +276,7 @@ const struct tcphdr* TCP_Analyzer::ExtractTCP_Header(const u_char*& data,
 bool TCP_Analyzer::ValidateChecksum(const IP_Hdr* ip, const struct tcphdr* tp,
 				TCP_Endpoint* endpoint, int len, int caplen)
 	{
-	if ( ! run_state::current_pkt->l3_checksummed &&
+	if ( ! run_state::current_pkt->l4_checksummed &&
 	     ! detail::ignore_checksums && 
 	     ! zeek::id::find_val<TableVal>("ignore_checksums_nets")->Contains(ip->IPHeaderSrcAddr()) &&
 	     caplen >= len && ! endpoint->ValidChecksum(tp, len, ip->IP4_Hdr()) )
@@ -1245,7 +1246,7 @@ void TCP_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
 			DBG_LOG(DBG_ANALYZER, "%s deleted child %s",
 			        fmt_analyzer(this).c_str(), fmt_analyzer(child).c_str());
 			i = packet_children.erase(i);
-			delete child;
+			analyzer_mgr->DisposeAnalyzer(child);
 			}
 		else
 			{
@@ -1254,6 +1255,8 @@ void TCP_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
 			}
 		}
 
+	Conn()->CountPacket(is_orig, ip->TotalLen());
+
 	if ( ! reassembling )
 		ForwardPacket(len, data, is_orig, rel_data_seq, ip, caplen);
 	}
@@ -1282,13 +1285,14 @@ void TCP_Analyzer::FlipRoles()
 
 void TCP_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	{
-	RecordVal* orig_endp_val = conn_val->GetField("orig")->AsRecordVal();
-	RecordVal* resp_endp_val = conn_val->GetField("resp")->AsRecordVal();
+	// Fields 1 and 2 are $orig and $resp, see Connection::ConnVal().
+	RecordVal* orig_endp_val = conn_val->GetField(1)->AsRecordVal();
+	RecordVal* resp_endp_val = conn_val->GetField(2)->AsRecordVal();
 
-	orig_endp_val->Assign(0, val_mgr->Count(orig->Size()));
-	orig_endp_val->Assign(1, val_mgr->Count(int(orig->state)));
-	resp_endp_val->Assign(0, val_mgr->Count(resp->Size()));
-	resp_endp_val->Assign(1, val_mgr->Count(int(resp->state)));
+	orig_endp_val->AssignCount(0, orig->Size());
+	orig_endp_val->AssignCount(1, int(orig->state));
+	resp_endp_val->AssignCount(0, resp->Size());
+	resp_endp_val->AssignCount(1, int(resp->state));
 
 	// Call children's UpdateConnVal
 	Analyzer::UpdateConnVal(conn_val);
@@ -1298,6 +1302,34 @@ void TCP_Analyzer::UpdateConnVal(RecordVal *conn_val)
 		(*i)->UpdateConnVal(conn_val);
 	}
 
+bool TCP_Analyzer::IsResumable() const
+	{
+	// Data waiting above a hole can't go anywhere.
+	if ( orig->HasUndeliveredData() || resp->HasUndeliveredData() )
+		return false;
+
+	for ( const auto& child : packet_children )
+		if ( ! child->CanCompact() )
+			return false;
+
+	return true;
+	}
+
+void TCP_Analyzer::Compact()
+	{
+	// The data already delivered is only kept for checking
+	// retransmissions against.
+	for ( auto endp : { orig, resp } )
+		if ( endp->contents_processor )
+			endp->contents_processor->ClearOldBlocks();
+
+	for ( auto child : packet_children )
+		if ( ! (child->IsFinished() || child->Removing()) )
+			child->Compact();
+
+	Analyzer::Compact();
+	}
+
 int TCP_Analyzer::ParseTCPOptions(const struct tcphdr* tcp, bool is_orig)
 	{
 	// Parse TCP options.
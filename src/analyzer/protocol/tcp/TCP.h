@@ -65,6 +65,8 @@ public:
 
 	// From Analyzer.h
 	void UpdateConnVal(RecordVal *conn_val) override;
+	bool IsResumable() const override;
+	void Compact() override;
 
 	int ParseTCPOptions(const struct tcphdr* tcp, bool is_orig);
 
@@ -240,6 +242,13 @@ public:
 	//  delete them when done with them.
 	virtual void SetEnv(bool orig, char* name, char* val);
 
+protected:
+	void Reuse(Connection* conn) override
+		{
+		Analyzer::Reuse(conn);
+		tcp = nullptr;
+		}
+
 private:
 	TCP_Analyzer* tcp;
 };
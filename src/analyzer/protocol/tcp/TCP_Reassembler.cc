@@ -408,33 +408,62 @@ void TCP_Reassembler::BlockInserted(DataBlockMap::const_iterator it)
 			if ( record_contents_file )
 				RecordBlock(b, record_contents_file);
 
+			auto prev_pin = delivery_pin;
+			delivery_pin = b.PinnedBuffer();
 			DeliverBlock(seq, len, b.block);
+			delivery_pin = prev_pin;
 			}
 
 		++it;
 		}
 
+	if ( ! HoldDelivered() )
+		TrimToSeq(last_reassem_seq);
+
+	// Note: don't make an EOF check here, because then we'd miss it
+	// for FIN packets that don't carry any payload (and thus
+	// endpoint->DataSent is not called).  Instead, do the check in
+	// TCP_Connection::NextPacket.
+	}
+
+bool TCP_Reassembler::DeliverInOrder(uint64_t seq, uint64_t len, const u_char* data)
+	{
+	// Contents files get written from blocks, so keep using those
+	// when recording.
+	if ( record_contents_file || HoldDelivered() )
+		return false;
+
+	last_reassem_seq += len;
+	DeliverBlock(seq, len, data);
+	return true;
+	}
+
+void TCP_Reassembler::Evict()
+	{
+	tcp_analyzer->Weird("reassembly_memory_budget_exceeded");
+	Reassembler::Evict();
+	}
+
+bool TCP_Reassembler::HoldDelivered() const
+	{
 	TCP_Endpoint* e = endp;
 
 	if ( ! e->peer->HasContents() )
 		// Our endpoint's peer doesn't do reassembly and so
 		// (presumably) isn't processing acks.  So don't hold
 		// the now-delivered data.
-		TrimToSeq(last_reassem_seq);
+		return false;
 
-	else if ( e->NoDataAcked() && zeek::detail::tcp_max_initial_window &&
-		  e->Size() > static_cast<uint64_t>(zeek::detail::tcp_max_initial_window) )
+	if ( e->NoDataAcked() && zeek::detail::tcp_max_initial_window &&
+	     e->Size() > static_cast<uint64_t>(zeek::detail::tcp_max_initial_window) )
 		// We've sent quite a bit of data, yet none of it has
 		// been acked.  Presume that we're not seeing the peer's
 		// acks (perhaps due to filtering or split routing) and
 		// don't hang onto the data further, as we may wind up
 		// carrying it all the way until this connection ends.
-		TrimToSeq(last_reassem_seq);
+		return false;
 
-	// Note: don't make an EOF check here, because then we'd miss it
-	// for FIN packets that don't carry any payload (and thus
-	// endpoint->DataSent is not called).  Instead, do the check in
-	// TCP_Connection::NextPacket.
+	return true;
 	}
 
 void TCP_Reassembler::Overlap(const u_char* b1, const u_char* b2, uint64_t n)
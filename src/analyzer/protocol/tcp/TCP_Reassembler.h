@@ -90,6 +90,11 @@ private:
 	void RecordGap(uint64_t start_seq, uint64_t upper_seq, const FilePtr& f);
 
 	void BlockInserted(DataBlockMap::const_iterator it) override;
+	bool DeliverInOrder(uint64_t seq, uint64_t len, const u_char* data) override;
+	void Evict() override;
+
+	// Whether delivered data needs to stay around until it gets acked.
+	bool HoldDelivered() const;
 	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
 
 	TCP_Endpoint* endp;
@@ -235,7 +235,7 @@ void Teredo_Analyzer::DeliverPacket(int len, const u_char* data, bool orig,
 	EncapsulatingConn ec(Conn(), BifEnum::Tunnel::TEREDO);
 
 	packet_analysis::IPTunnel::ip_tunnel_analyzer->ProcessEncapsulatedPacket(
-		run_state::network_time, nullptr, inner, e, ec);
+		run_state::network_time, nullptr, inner, encap_cache.Get(e, ec));
 	}
 
 } // namespace zeek::analyzer::teredo
@@ -3,6 +3,7 @@
 #include "analyzer/Analyzer.h"
 #include "NetVar.h"
 #include "Reporter.h"
+#include "TunnelEncapsulation.h"
 
 namespace zeek::analyzer::teredo {
 
@@ -48,6 +49,7 @@ public:
 protected:
 	bool valid_orig;
 	bool valid_resp;
+	EncapsulationCache encap_cache;
 };
 
 namespace detail {
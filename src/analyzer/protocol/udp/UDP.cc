@@ -63,7 +63,7 @@ void UDP_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
 	int chksum = up->uh_sum;
 
 	auto validate_checksum = 
-		! run_state::current_pkt->l3_checksummed && 
+		! run_state::current_pkt->l4_checksummed && 
 		! zeek::detail::ignore_checksums && 
 		! zeek::id::find_val<TableVal>("ignore_checksums_nets")->Contains(ip->IPHeaderSrcAddr()) &&
 		caplen >=len;
@@ -215,13 +215,17 @@ void UDP_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
 		}
 
 	if ( caplen >= len )
+		{
+		Conn()->CountPacket(is_orig, ip->TotalLen());
 		ForwardPacket(len, data, is_orig, seq, ip, caplen);
+		}
 	}
 
 void UDP_Analyzer::UpdateConnVal(RecordVal* conn_val)
 	{
-	RecordVal* orig_endp = conn_val->GetField("orig")->AsRecordVal();
-	RecordVal* resp_endp = conn_val->GetField("resp")->AsRecordVal();
+	// Fields 1 and 2 are $orig and $resp, see Connection::ConnVal().
+	RecordVal* orig_endp = conn_val->GetField(1)->AsRecordVal();
+	RecordVal* resp_endp = conn_val->GetField(2)->AsRecordVal();
 
 	UpdateEndpointVal(orig_endp, true);
 	UpdateEndpointVal(resp_endp, false);
@@ -235,14 +239,14 @@ void UDP_Analyzer::UpdateEndpointVal(RecordVal* endp, bool is_orig)
 	bro_int_t size = is_orig ? request_len : reply_len;
 	if ( size < 0 )
 		{
-		endp->Assign(0, val_mgr->Count(0));
-		endp->Assign(1, val_mgr->Count(int(UDP_INACTIVE)));
+		endp->AssignCount(0, 0);
+		endp->AssignCount(1, int(UDP_INACTIVE));
 		}
 
 	else
 		{
-		endp->Assign(0, val_mgr->Count(size));
-		endp->Assign(1, val_mgr->Count(int(UDP_ACTIVE)));
+		endp->AssignCount(0, size);
+		endp->AssignCount(1, int(UDP_ACTIVE));
 		}
 	}
 
@@ -19,6 +19,7 @@ public:
 
 	void Init() override;
 	void UpdateConnVal(RecordVal *conn_val) override;
+	bool IsResumable() const override	{ return true; }
 
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new UDP_Analyzer(conn); }
@@ -56,12 +56,6 @@ void VXLAN_Analyzer::DeliverPacket(int len, const u_char* data, bool orig,
 		return;
 		}
 
-	if ( ! outer )
-		outer = std::make_shared<EncapsulationStack>();
-
-	EncapsulatingConn inner(Conn(), BifEnum::Tunnel::VXLAN);
-	outer->Add(inner);
-
 	int vni = (data[4] << 16) + (data[5] << 8) + (data[6] << 0);
 
 	// Skip over the VXLAN header and create a new packet.
@@ -73,7 +67,7 @@ void VXLAN_Analyzer::DeliverPacket(int len, const u_char* data, bool orig,
 	ts.tv_sec = (time_t) run_state::current_timestamp;
 	ts.tv_usec = (suseconds_t) ((run_state::current_timestamp - (double)ts.tv_sec) * 1000000);
 	Packet pkt(DLT_EN10MB, &ts, caplen, len, data);
-	pkt.encap = outer;
+	pkt.encap = encap_cache.Get(outer, EncapsulatingConn(Conn(), BifEnum::Tunnel::VXLAN));
 
 	if ( ! packet_mgr->ProcessInnerPacket(&pkt) )
 		{
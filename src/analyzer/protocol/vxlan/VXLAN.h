@@ -3,6 +3,7 @@
 #pragma once
 
 #include "analyzer/Analyzer.h"
+#include "TunnelEncapsulation.h"
 
 namespace zeek::analyzer::vxlan {
 
@@ -19,6 +20,9 @@ public:
 
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new VXLAN_Analyzer(conn); }
+
+protected:
+	EncapsulationCache encap_cache;
 };
 
 } // namespace zeek::analyzer::vxlan
@@ -0,0 +1,140 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "zeek-setup.h"
+#include "Options.h"
+#include "util.h"
+
+namespace zeek::benchmark {
+
+struct Entry {
+	const char* name;
+	Function func;
+};
+
+static std::vector<Entry>& registry()
+	{
+	static std::vector<Entry> entries;
+	return entries;
+	}
+
+Registration::Registration(const char* name, Function func)
+	{
+	registry().push_back({name, func});
+	}
+
+// Runs a benchmark with growing iteration counts until a run takes at
+// least min_time seconds, and returns the state of that run.
+static State run(const Entry& e, double min_time)
+	{
+	uint64_t n = 1;
+
+	while ( true )
+		{
+		State state(n);
+		e.func(state);
+
+		double secs = state.Seconds();
+
+		if ( secs >= min_time || n >= 1000000000 )
+			return state;
+
+		// Aim a bit beyond min_time, growing at most tenfold.
+		double factor = secs > 0 ? 1.4 * min_time / secs : 10;
+		factor = std::min(std::max(factor, 2.0), 10.0);
+		n = static_cast<uint64_t>(n * factor);
+		}
+	}
+
+static void usage()
+	{
+	fprintf(stderr, "usage: zeek-bench [--filter=<regex>] [--min-time=<seconds>] [--csv] [--list]\n");
+	exit(1);
+	}
+
+} // namespace zeek::benchmark
+
+int main(int argc, char** argv)
+	{
+	using namespace zeek::benchmark;
+
+	std::regex filter(".*");
+	double min_time = 0.5;
+	bool csv = false;
+	bool list = false;
+
+	for ( int i = 1; i < argc; ++i )
+		{
+		if ( strncmp(argv[i], "--filter=", 9) == 0 )
+			filter = std::regex(argv[i] + 9);
+		else if ( strncmp(argv[i], "--min-time=", 11) == 0 )
+			min_time = atof(argv[i] + 11);
+		else if ( strcmp(argv[i], "--csv") == 0 )
+			csv = true;
+		else if ( strcmp(argv[i], "--list") == 0 )
+			list = true;
+		else
+			usage();
+		}
+
+	if ( list )
+		{
+		for ( const auto& e : registry() )
+			printf("%s\n", e.name);
+
+		return 0;
+		}
+
+	// The benchmarks use the core's types and values, so initialize it
+	// with the bare scripts and without any I/O.
+	zeek::Options options;
+	options.bare_mode = true;
+	options.deterministic_mode = true;
+
+	if ( zeek::detail::setup(1, argv, &options).code )
+		return 1;
+
+	if ( csv )
+		printf("name,iterations,ns_per_iteration,items_per_second,bytes_per_second\n");
+	else
+		printf("%-40s %12s %14s %16s\n", "benchmark", "iterations", "ns/iteration", "throughput");
+
+	for ( const auto& e : registry() )
+		{
+		if ( ! std::regex_search(e.name, filter) )
+			continue;
+
+		auto state = run(e, min_time);
+		double ns = state.Seconds() * 1e9 / state.Iterations();
+		double items = state.Items() / state.Seconds();
+		double bytes = state.Bytes() / state.Seconds();
+
+		if ( csv )
+			{
+			printf("%s,%llu,%.1f,%.0f,%.0f\n", e.name,
+			       (unsigned long long) state.Iterations(), ns, items, bytes);
+			continue;
+			}
+
+		std::string throughput;
+
+		if ( state.Bytes() )
+			throughput = zeek::util::fmt("%.1f MB/s", bytes / 1e6);
+		else if ( state.Items() )
+			throughput = zeek::util::fmt("%.2f M items/s", items / 1e6);
+
+		printf("%-40s %12llu %14.1f %16s\n", e.name,
+		       (unsigned long long) state.Iterations(), ns, throughput.c_str());
+		}
+
+	return zeek::detail::cleanup(false);
+	}
@@ -0,0 +1,164 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace zeek::benchmark {
+
+/**
+ * The state a benchmark function runs with, modeled after Google
+ * Benchmark's: a benchmark does its setup, then loops over the state,
+ * which runs the body as many times as needed for a stable measurement
+ * and times only the loop.
+ *
+ *     ZEEK_BENCHMARK(table_lookup)
+ *         {
+ *         ... setup ...
+ *
+ *         for ( auto _ : state )
+ *             DoNotOptimize(table->Find(key));
+ *
+ *         state.SetItemsProcessed(state.Iterations());
+ *         }
+ */
+class State {
+public:
+	explicit State(uint64_t iterations) : iterations(iterations)
+		{}
+
+	struct Iterator {
+		State* state;
+		uint64_t remaining;
+
+		bool operator!=(const Iterator&) const
+			{
+			if ( remaining > 0 )
+				return true;
+
+			state->StopTiming();
+			return false;
+			}
+
+		Iterator& operator++()
+			{ --remaining; return *this; }
+
+		int operator*() const	{ return 0; }
+	};
+
+	Iterator begin()
+		{
+		StartTiming();
+		return {this, iterations};
+		}
+
+	Iterator end()	{ return {this, 0}; }
+
+	/**
+	 * Stops the clock, for per-iteration setup that shouldn't count.
+	 */
+	void PauseTiming()	{ StopTiming(); }
+
+	/**
+	 * Restarts the clock after PauseTiming().
+	 */
+	void ResumeTiming()	{ StartTiming(); }
+
+	/**
+	 * Returns the number of times the loop runs.
+	 */
+	uint64_t Iterations() const	{ return iterations; }
+
+	/**
+	 * Reports the number of items, like packets or segments, that the
+	 * loop processed in total, for a throughput figure.
+	 */
+	void SetItemsProcessed(uint64_t n)	{ items = n; }
+
+	/**
+	 * Reports the number of bytes the loop processed in total, for a
+	 * throughput figure.
+	 */
+	void SetBytesProcessed(uint64_t n)	{ bytes = n; }
+
+	double Seconds() const	{ return elapsed.count(); }
+	uint64_t Items() const	{ return items; }
+	uint64_t Bytes() const	{ return bytes; }
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	void StartTiming()	{ start = clock::now(); }
+	void StopTiming()	{ elapsed += clock::now() - start; }
+
+	uint64_t iterations;
+	uint64_t items = 0;
+	uint64_t bytes = 0;
+	clock::time_point start;
+	std::chrono::duration<double> elapsed{0};
+};
+
+using Function = void (*)(State&);
+
+/**
+ * Registers a benchmark at startup, see ZEEK_BENCHMARK.
+ */
+class Registration {
+public:
+	Registration(const char* name, Function func);
+};
+
+/**
+ * A fast deterministic random number generator, so that workloads are
+ * the same on each run.
+ */
+class Random {
+public:
+	explicit Random(uint64_t seed = 1) : x(seed)
+		{}
+
+	uint64_t Next()
+		{
+		// splitmix64
+		uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+		}
+
+	/**
+	 * Returns a number below n, with smaller ones much more likely,
+	 * like hosts in traffic, where few see most of the connections.
+	 */
+	uint64_t Skewed(uint64_t n)
+		{
+		// The product of two uniform numbers is skewed toward zero.
+		double u = (Next() >> 11) * (1.0 / 9007199254740992.0);
+		double v = (Next() >> 11) * (1.0 / 9007199254740992.0);
+		return static_cast<uint64_t>(u * v * n);
+		}
+
+private:
+	uint64_t x;
+};
+
+/**
+ * Keeps the compiler from optimizing away the computation of a value.
+ */
+template <typename T>
+inline void DoNotOptimize(const T& value)
+	{
+	asm volatile("" : : "r,m"(value) : "memory");
+	}
+
+} // namespace zeek::benchmark
+
+/**
+ * Defines and registers a benchmark function, which receives a
+ * zeek::benchmark::State named *state*.
+ */
+#define ZEEK_BENCHMARK(name) \
+	static void name(zeek::benchmark::State& state); \
+	static zeek::benchmark::Registration name##_registration(#name, name); \
+	static void name(zeek::benchmark::State& state)
@@ -0,0 +1,67 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Conversion of script values to Broker data, as done for every event
+// and store operation sent to a peer.
+
+#include <vector>
+
+#include "Benchmark.h"
+#include "ID.h"
+#include "IPAddr.h"
+#include "Type.h"
+#include "Val.h"
+#include "broker/Data.h"
+
+namespace zeek::benchmark {
+
+
+static std::vector<RecordValPtr> make_conn_ids(int n)
+	{
+	Random rnd;
+	std::vector<RecordValPtr> ids;
+
+	for ( int i = 0; i < n; ++i )
+		{
+		uint32_t orig = htonl(0x0a000000 | rnd.Skewed(1 << 16));
+		uint32_t resp = htonl(rnd.Next() & 0xffffffff);
+
+		auto id = make_intrusive<RecordVal>(id::conn_id);
+		id->Assign(0, make_intrusive<AddrVal>(IPAddr(IPv4, &orig, IPAddr::Network)));
+		id->Assign(1, val_mgr->Port(1024 + rnd.Next() % 60000, TRANSPORT_TCP));
+		id->Assign(2, make_intrusive<AddrVal>(IPAddr(IPv4, &resp, IPAddr::Network)));
+		id->Assign(3, val_mgr->Port(rnd.Next() % 2 ? 80 : 443, TRANSPORT_TCP));
+		ids.emplace_back(std::move(id));
+		}
+
+	return ids;
+	}
+
+ZEEK_BENCHMARK(broker_val_to_data_record)
+	{
+	auto ids = make_conn_ids(1024);
+
+	for ( auto _ : state )
+		for ( const auto& id : ids )
+			DoNotOptimize(Broker::detail::val_to_data(id.get()));
+
+	state.SetItemsProcessed(state.Iterations() * ids.size());
+	}
+
+ZEEK_BENCHMARK(broker_val_to_data_table)
+	{
+	// A table[conn_id] of count, like a cluster-synchronized table.
+	auto tl = make_intrusive<TypeList>(id::conn_id);
+	tl->Append(id::conn_id);
+	auto t = make_intrusive<TableVal>(make_intrusive<TableType>(std::move(tl), base_type(TYPE_COUNT)));
+	auto ids = make_conn_ids(1024);
+
+	for ( size_t i = 0; i < ids.size(); ++i )
+		t->Assign(ids[i], val_mgr->Count(i));
+
+	for ( auto _ : state )
+		DoNotOptimize(Broker::detail::val_to_data(t.get()));
+
+	state.SetItemsProcessed(state.Iterations() * ids.size());
+	}
+
+} // namespace zeek::benchmark
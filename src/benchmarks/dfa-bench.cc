@@ -0,0 +1,134 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// DFA matching of payload against pattern sets like those of signatures,
+// and against single script-level patterns.
+
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "RE.h"
+#include "ZeekString.h"
+#include "util.h"
+
+namespace zeek::benchmark {
+
+using namespace zeek::detail;
+
+// Patterns in the style of protocol detection and exploit signatures.
+static const char* signature_patterns[] = {
+	"^[[:space:]]*(GET|HEAD|POST|PUT|DELETE|OPTIONS)[[:space:]]+",
+	"^HTTP/1\\.[01] [0-9][0-9][0-9]",
+	"^SSH-[12]\\.",
+	"^\\x16\\x03[\\x00-\\x03]..\\x01",
+	"^(220|230)[ -].*FTP",
+	"^[ \\t]*(EHLO|HELO) ",
+	".*/etc/(passwd|shadow)",
+	".*cmd\\.exe",
+	".*\\.\\./\\.\\./",
+	".*<script[^>]*>",
+	".*union[[:space:]]+select",
+	".*User-Agent: (sqlmap|nikto|masscan)",
+	".*\\x90\\x90\\x90\\x90\\x90\\x90\\x90\\x90",
+	".*/wp-(admin|login)\\.php",
+	".*(\\$\\{jndi:|%24%7Bjndi)",
+	".*Content-Type: application/x-shockwave-flash",
+};
+
+// A mix of HTTP requests, responses and binary data.
+static std::vector<std::string> make_payloads()
+	{
+	Random rnd;
+	std::vector<std::string> payloads;
+
+	for ( int i = 0; i < 256; ++i )
+		{
+		std::string p;
+
+		switch ( i % 4 ) {
+		case 0:
+			p = util::fmt("GET /index%d.html HTTP/1.1\r\nHost: www.example%d.com\r\n"
+			              "User-Agent: Mozilla/5.0 (X11; Linux x86_64)\r\n"
+			              "Accept: */*\r\n\r\n", i, i % 7);
+			break;
+
+		case 1:
+			p = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 1024\r\n\r\n";
+			p.append(1024, 'a' + i % 26);
+			break;
+
+		case 2:
+			p = util::fmt("POST /api/v%d/items HTTP/1.1\r\nContent-Type: application/json\r\n\r\n"
+			              "{\"id\": %d, \"name\": \"item\"}", i % 3, i);
+			break;
+
+		case 3:
+			for ( int j = 0; j < 1400; ++j )
+				p += static_cast<char>(rnd.Next());
+			break;
+		}
+
+		payloads.emplace_back(std::move(p));
+		}
+
+	return payloads;
+	}
+
+ZEEK_BENCHMARK(dfa_signature_set)
+	{
+	Specific_RE_Matcher m(MATCH_EXACTLY);
+	string_list set;
+	int_list idx;
+	int i = 0;
+
+	for ( auto p : signature_patterns )
+		{
+		set.push_back(util::copy_string(p));
+		idx.push_back(++i);
+		}
+
+	m.CompileSet(set, idx);
+
+	for ( auto p : set )
+		delete [] p;
+
+	auto payloads = make_payloads();
+	uint64_t bytes = 0;
+
+	for ( const auto& p : payloads )
+		bytes += p.size();
+
+	RE_Match_State ms(&m);
+
+	for ( auto _ : state )
+		for ( const auto& p : payloads )
+			DoNotOptimize(ms.Match(reinterpret_cast<const u_char*>(p.data()),
+			                       p.size(), true, true, true));
+
+	state.SetBytesProcessed(state.Iterations() * bytes);
+	}
+
+ZEEK_BENCHMARK(dfa_script_pattern)
+	{
+	// As in a script's "if ( /.../ in c$http$uri )".
+	Specific_RE_Matcher m(MATCH_ANYWHERE);
+	m.AddPat("(\\.php|\\.asp|\\.jsp)(\\?|$)|/cgi-bin/");
+	m.Compile();
+
+	std::vector<zeek::String> payloads;
+	uint64_t bytes = 0;
+
+	for ( const auto& p : make_payloads() )
+		{
+		payloads.emplace_back(p);
+		bytes += p.size();
+		}
+
+	for ( auto _ : state )
+		for ( const auto& p : payloads )
+			DoNotOptimize(m.Match(&p));
+
+	state.SetBytesProcessed(state.Iterations() * bytes);
+	}
+
+} // namespace zeek::benchmark
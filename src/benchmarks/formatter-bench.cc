@@ -0,0 +1,182 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Rendering of log rows by the ASCII and JSON formatters, for rows shaped
+// like those of conn.log.
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Desc.h"
+#include "threading/SerialTypes.h"
+#include "threading/formatters/Ascii.h"
+#include "threading/formatters/JSON.h"
+#include "util.h"
+
+namespace zeek::benchmark {
+
+using namespace zeek::threading;
+
+namespace {
+
+struct Rows {
+	std::vector<Field*> fields;
+	std::vector<std::vector<Value*>> rows;
+
+	~Rows()
+		{
+		for ( auto f : fields )
+			delete f;
+
+		for ( auto& r : rows )
+			for ( auto v : r )
+				delete v;
+		}
+};
+
+}
+
+static Value* string_value(const char* s)
+	{
+	auto v = new Value(TYPE_STRING);
+	v->val.string_val.data = util::copy_string(s);
+	v->val.string_val.length = strlen(s);
+	return v;
+	}
+
+static Value* addr_value(uint32_t a)
+	{
+	auto v = new Value(TYPE_ADDR);
+	v->val.addr_val.family = IPv4;
+	v->val.addr_val.in.in4.s_addr = htonl(a);
+	return v;
+	}
+
+static Value* port_value(bro_uint_t p)
+	{
+	auto v = new Value(TYPE_PORT);
+	v->val.port_val.port = p;
+	v->val.port_val.proto = TRANSPORT_TCP;
+	return v;
+	}
+
+static Value* count_value(bro_uint_t c)
+	{
+	auto v = new Value(TYPE_COUNT);
+	v->val.uint_val = c;
+	return v;
+	}
+
+static Value* double_value(TypeTag t, double d)
+	{
+	auto v = new Value(t);
+	v->val.double_val = d;
+	return v;
+	}
+
+static Value* enum_value(const char* s)
+	{
+	auto v = string_value(s);
+	v->type = TYPE_ENUM;
+	return v;
+	}
+
+static Value* unset_value(TypeTag t)
+	{
+	return new Value(t, false);
+	}
+
+static Value* string_set_value(const std::vector<const char*>& elems)
+	{
+	auto v = new Value(TYPE_TABLE, TYPE_STRING);
+	v->val.set_val.size = elems.size();
+	v->val.set_val.vals = new Value*[elems.size()];
+
+	for ( size_t i = 0; i < elems.size(); ++i )
+		v->val.set_val.vals[i] = string_value(elems[i]);
+
+	return v;
+	}
+
+static void make_conn_rows(Rows* r)
+	{
+	r->fields = {
+		new Field("ts", nullptr, TYPE_TIME, TYPE_VOID, false),
+		new Field("uid", nullptr, TYPE_STRING, TYPE_VOID, false),
+		new Field("id.orig_h", nullptr, TYPE_ADDR, TYPE_VOID, false),
+		new Field("id.orig_p", nullptr, TYPE_PORT, TYPE_VOID, false),
+		new Field("id.resp_h", nullptr, TYPE_ADDR, TYPE_VOID, false),
+		new Field("id.resp_p", nullptr, TYPE_PORT, TYPE_VOID, false),
+		new Field("proto", nullptr, TYPE_ENUM, TYPE_VOID, false),
+		new Field("service", nullptr, TYPE_STRING, TYPE_VOID, true),
+		new Field("duration", nullptr, TYPE_INTERVAL, TYPE_VOID, true),
+		new Field("orig_bytes", nullptr, TYPE_COUNT, TYPE_VOID, true),
+		new Field("resp_bytes", nullptr, TYPE_COUNT, TYPE_VOID, true),
+		new Field("conn_state", nullptr, TYPE_STRING, TYPE_VOID, true),
+		new Field("history", nullptr, TYPE_STRING, TYPE_VOID, true),
+		new Field("tunnel_parents", nullptr, TYPE_TABLE, TYPE_STRING, true),
+	};
+
+	Random rnd;
+
+	for ( int i = 0; i < 1000; ++i )
+		{
+		bool established = rnd.Next() % 4;
+
+		r->rows.push_back({
+			double_value(TYPE_TIME, 1600000000.0 + i * 0.001234),
+			string_value(util::fmt("C%08llx%07llx", (unsigned long long) rnd.Next() & 0xffffffff,
+			                       (unsigned long long) rnd.Next() & 0xfffffff)),
+			addr_value(0x0a000000 | rnd.Skewed(1 << 16)),
+			port_value(1024 + rnd.Next() % 60000),
+			addr_value(rnd.Next() & 0xffffffff),
+			port_value(rnd.Next() % 2 ? 80 : 443),
+			enum_value("tcp"),
+			established ? string_value(i % 2 ? "http" : "ssl") : unset_value(TYPE_STRING),
+			established ? double_value(TYPE_INTERVAL, (rnd.Next() % 100000) / 1000.0) : unset_value(TYPE_INTERVAL),
+			established ? count_value(rnd.Next() % 10000) : unset_value(TYPE_COUNT),
+			established ? count_value(rnd.Next() % 1000000) : unset_value(TYPE_COUNT),
+			string_value(established ? "SF" : "S0"),
+			string_value(established ? "ShADadFf" : "S"),
+			string_set_value({}),
+		});
+		}
+	}
+
+static void run_formatter(State& state, const Formatter& formatter)
+	{
+	Rows r;
+	make_conn_rows(&r);
+
+	ODesc desc;
+	desc.SetStyle(RAW_STYLE);
+	uint64_t bytes = 0;
+
+	for ( auto _ : state )
+		for ( auto& row : r.rows )
+			{
+			desc.Clear();
+			formatter.Describe(&desc, r.fields.size(), r.fields.data(), row.data());
+			bytes += desc.Len();
+			}
+
+	DoNotOptimize(bytes);
+	state.SetItemsProcessed(state.Iterations() * r.rows.size());
+	state.SetBytesProcessed(bytes);
+	}
+
+ZEEK_BENCHMARK(formatter_ascii_conn)
+	{
+	formatter::Ascii::SeparatorInfo info("\t", ",", "-", "(empty)");
+	formatter::Ascii f(nullptr, info);
+	run_formatter(state, f);
+	}
+
+ZEEK_BENCHMARK(formatter_json_conn)
+	{
+	formatter::JSON f(nullptr, formatter::JSON::TS_EPOCH);
+	run_formatter(state, f);
+	}
+
+} // namespace zeek::benchmark
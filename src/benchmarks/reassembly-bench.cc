@@ -0,0 +1,153 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Stream reassembly of TCP-like segments, in order and with the reordering
+// and retransmissions seen on real links.
+
+#include <algorithm>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Reassem.h"
+
+namespace zeek::benchmark {
+
+
+namespace {
+
+class BenchReassembler final : public Reassembler {
+public:
+	BenchReassembler() : Reassembler(0, REASSEM_TCP)
+		{}
+
+	uint64_t Delivered() const	{ return delivered; }
+
+protected:
+	bool DeliverInOrder(uint64_t seq, uint64_t len, const u_char* data) override
+		{
+		delivered += len;
+		last_reassem_seq += len;
+		return true;
+		}
+
+	void BlockInserted(DataBlockMap::const_iterator it) override
+		{
+		const auto& start_block = it->second;
+
+		if ( start_block.seq > last_reassem_seq ||
+		     start_block.upper <= last_reassem_seq )
+			return;
+
+		while ( it != block_list.End() )
+			{
+			const auto& b = it->second;
+
+			if ( b.seq > last_reassem_seq )
+				break;
+
+			if ( b.upper > last_reassem_seq )
+				{
+				delivered += b.upper - last_reassem_seq;
+				last_reassem_seq = b.upper;
+				}
+
+			++it;
+			}
+
+		TrimToSeq(last_reassem_seq);
+		}
+
+	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override
+		{}
+
+private:
+	uint64_t delivered = 0;
+};
+
+struct Segment {
+	uint64_t seq;
+	uint64_t len;
+};
+
+}
+
+static constexpr uint64_t MSS = 1460;
+static constexpr uint64_t FLOW_SIZE = 1 << 20;
+
+// Returns the segments of a flow. With reorder_every > 0, about one in
+// that many segments arrives a few segments late, and as many get
+// retransmitted.
+static std::vector<Segment> make_flow(int reorder_every)
+	{
+	Random rnd;
+	std::vector<Segment> segs;
+
+	for ( uint64_t seq = 0; seq < FLOW_SIZE; seq += MSS )
+		segs.push_back({seq, std::min(MSS, FLOW_SIZE - seq)});
+
+	if ( ! reorder_every )
+		return segs;
+
+	size_t n = segs.size();
+
+	for ( size_t i = 0; i + 4 < n; ++i )
+		{
+		if ( rnd.Next() % reorder_every == 0 )
+			std::swap(segs[i], segs[i + 1 + rnd.Next() % 3]);
+
+		if ( rnd.Next() % reorder_every == 0 )
+			segs.push_back(segs[i]);
+		}
+
+	// Move the retransmissions close to their originals.
+	std::stable_sort(segs.begin() + n, segs.end(),
+	                 [](const Segment& a, const Segment& b) { return a.seq < b.seq; });
+
+	std::vector<Segment> merged;
+	size_t r = n;
+
+	for ( size_t i = 0; i < n; ++i )
+		{
+		merged.push_back(segs[i]);
+
+		while ( r < segs.size() && segs[r].seq + 8 * MSS <= segs[i].seq )
+			merged.push_back(segs[r++]);
+		}
+
+	merged.insert(merged.end(), segs.begin() + r, segs.end());
+	return merged;
+	}
+
+static void run_flow(State& state, int reorder_every)
+	{
+	auto segs = make_flow(reorder_every);
+	std::vector<u_char> payload(MSS, 'x');
+
+	for ( auto _ : state )
+		{
+		BenchReassembler r;
+
+		for ( const auto& s : segs )
+			r.NewBlock(0, s.seq, s.len, payload.data());
+
+		DoNotOptimize(r.Delivered());
+		}
+
+	state.SetBytesProcessed(state.Iterations() * FLOW_SIZE);
+	}
+
+ZEEK_BENCHMARK(reassembly_in_order)
+	{
+	run_flow(state, 0);
+	}
+
+ZEEK_BENCHMARK(reassembly_reordered)
+	{
+	run_flow(state, 20);
+	}
+
+ZEEK_BENCHMARK(reassembly_heavily_reordered)
+	{
+	run_flow(state, 3);
+	}
+
+} // namespace zeek::benchmark
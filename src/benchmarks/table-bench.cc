@@ -0,0 +1,142 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Tables keyed by addresses and connection tuples, as in the scripts
+// tracking hosts and connections, which exercise CompHash and Dictionary.
+
+#include <vector>
+
+#include "Benchmark.h"
+#include "CompHash.h"
+#include "Hash.h"
+#include "IPAddr.h"
+#include "Type.h"
+#include "Val.h"
+
+namespace zeek::benchmark {
+
+
+static constexpr int NUM_HOSTS = 100000;
+
+// Addresses as seen in traffic: mostly local hosts, a few of them busy,
+// and a long tail of remote ones.
+static std::vector<AddrValPtr> make_addrs(int n)
+	{
+	Random rnd;
+	std::vector<AddrValPtr> addrs;
+
+	for ( int i = 0; i < n; ++i )
+		{
+		uint32_t a;
+
+		if ( rnd.Next() % 4 )
+			a = 0x0a000000 | rnd.Skewed(1 << 16);	// 10.0.0.0/16
+		else
+			a = rnd.Next() & 0xffffffff;
+
+		a = htonl(a);
+		addrs.emplace_back(make_intrusive<AddrVal>(IPAddr(IPv4, &a, IPAddr::Network)));
+		}
+
+	return addrs;
+	}
+
+static TableTypePtr addr_table_type()
+	{
+	auto tl = make_intrusive<TypeList>(base_type(TYPE_ADDR));
+	tl->Append(base_type(TYPE_ADDR));
+	return make_intrusive<TableType>(std::move(tl), base_type(TYPE_COUNT));
+	}
+
+ZEEK_BENCHMARK(table_addr_insert)
+	{
+	auto addrs = make_addrs(NUM_HOSTS);
+	auto tt = addr_table_type();
+
+	for ( auto _ : state )
+		{
+		state.PauseTiming();
+		auto t = make_intrusive<TableVal>(tt);
+		state.ResumeTiming();
+
+		for ( const auto& a : addrs )
+			t->Assign(a, val_mgr->Count(1));
+
+		state.PauseTiming();
+		t = nullptr;
+		state.ResumeTiming();
+		}
+
+	state.SetItemsProcessed(state.Iterations() * addrs.size());
+	}
+
+ZEEK_BENCHMARK(table_addr_lookup)
+	{
+	auto addrs = make_addrs(NUM_HOSTS);
+	auto t = make_intrusive<TableVal>(addr_table_type());
+
+	for ( size_t i = 0; i < addrs.size(); i += 2 )
+		t->Assign(addrs[i], val_mgr->Count(i));
+
+	for ( auto _ : state )
+		for ( const auto& a : addrs )
+			DoNotOptimize(t->Find(a).get());
+
+	state.SetItemsProcessed(state.Iterations() * addrs.size());
+	}
+
+ZEEK_BENCHMARK(table_addr_churn)
+	{
+	// Hosts come and go, like with table expiration.
+	auto addrs = make_addrs(NUM_HOSTS);
+	auto t = make_intrusive<TableVal>(addr_table_type());
+	size_t window = addrs.size() / 4;
+
+	for ( size_t i = 0; i < window; ++i )
+		t->Assign(addrs[i], val_mgr->Count(i));
+
+	size_t next = window;
+
+	for ( auto _ : state )
+		{
+		t->Remove(*addrs[next - window]);
+		t->Assign(addrs[next % addrs.size()], val_mgr->Count(next));
+
+		if ( ++next == addrs.size() + window )
+			next = window;
+		}
+
+	state.SetItemsProcessed(state.Iterations());
+	}
+
+ZEEK_BENCHMARK(comphash_conn_tuple)
+	{
+	// The index of a table[addr, port, addr, port].
+	auto tl = make_intrusive<TypeList>();
+	tl->Append(base_type(TYPE_ADDR));
+	tl->Append(base_type(TYPE_PORT));
+	tl->Append(base_type(TYPE_ADDR));
+	tl->Append(base_type(TYPE_PORT));
+	detail::CompositeHash ch(tl);
+
+	auto addrs = make_addrs(1024);
+	Random rnd;
+	std::vector<ListValPtr> keys;
+
+	for ( int i = 0; i < 1024; ++i )
+		{
+		auto lv = make_intrusive<ListVal>(TYPE_ANY);
+		lv->Append(addrs[i]);
+		lv->Append(val_mgr->Port(1024 + rnd.Next() % 60000, TRANSPORT_TCP));
+		lv->Append(addrs[rnd.Skewed(addrs.size())]);
+		lv->Append(val_mgr->Port(rnd.Next() % 2 ? 80 : 443, TRANSPORT_TCP));
+		keys.emplace_back(std::move(lv));
+		}
+
+	for ( auto _ : state )
+		for ( const auto& k : keys )
+			DoNotOptimize(ch.MakeHashKey(*k, true));
+
+	state.SetItemsProcessed(state.Iterations() * keys.size());
+	}
+
+} // namespace zeek::benchmark
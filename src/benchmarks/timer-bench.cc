@@ -0,0 +1,104 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Connection-style timers: most get canceled and re-armed as packets come
+// in, only idle connections' timers expire.
+
+#include <vector>
+
+#include "Benchmark.h"
+#include "PriorityQueue.h"
+#include "Timer.h"
+
+namespace zeek::benchmark {
+
+using namespace zeek::detail;
+
+namespace {
+
+class BenchTimer final : public Timer {
+public:
+	BenchTimer(double t, BenchTimer** slot)
+		: Timer(t, TIMER_CONN_INACTIVITY), slot(slot)
+		{}
+
+	void Dispatch(double, bool) override
+		{ *slot = nullptr; }
+
+private:
+	BenchTimer** slot;
+};
+
+class Element final : public PQ_Element {
+public:
+	explicit Element(double t) : PQ_Element(t)
+		{}
+
+	void Reschedule(double t)	{ time = t; }
+};
+
+}
+
+static constexpr int NUM_CONNS = 100000;
+
+template <typename Mgr>
+static void run_conn_timers(State& state, Mgr* mgr)
+	{
+	Random rnd;
+	std::vector<BenchTimer*> timers(NUM_CONNS, nullptr);
+	double now = 1000;
+
+	for ( auto _ : state )
+		{
+		// One packet: re-arm its connection's inactivity timer, with
+		// a few connections taking most of the packets.
+		now += 0.00001;
+		auto i = rnd.Skewed(NUM_CONNS);
+
+		if ( timers[i] )
+			mgr->Cancel(timers[i]);
+
+		timers[i] = new BenchTimer(now + 5 + (rnd.Next() % 1000) / 1000.0, &timers[i]);
+		mgr->Add(timers[i]);
+
+		if ( (rnd.Next() & 0xff) == 0 )
+			mgr->Advance(now, 0);
+		}
+
+	mgr->Expire();
+	state.SetItemsProcessed(state.Iterations());
+	}
+
+ZEEK_BENCHMARK(timer_pq_conn)
+	{
+	PQ_TimerMgr mgr;
+	run_conn_timers(state, &mgr);
+	}
+
+ZEEK_BENCHMARK(timer_wheel_conn)
+	{
+	Wheel_TimerMgr mgr;
+	run_conn_timers(state, &mgr);
+	}
+
+ZEEK_BENCHMARK(priority_queue_add_remove)
+	{
+	Random rnd;
+	PriorityQueue q;
+
+	for ( int i = 0; i < NUM_CONNS; ++i )
+		q.Add(new Element(rnd.Next() % 1000000));
+
+	for ( auto _ : state )
+		{
+		auto e = static_cast<Element*>(q.Remove());
+		e->Reschedule(e->Time() + rnd.Next() % 1000000);
+		q.Add(e);
+		}
+
+	while ( auto e = q.Remove() )
+		delete e;
+
+	state.SetItemsProcessed(state.Iterations());
+	}
+
+} // namespace zeek::benchmark
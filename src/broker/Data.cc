@@ -5,6 +5,7 @@
 #include "Data.h"
 #include "File.h"
 #include "Desc.h"
+#include "CompactSet.h"
 #include "IntrusivePtr.h"
 #include "RE.h"
 #include "ID.h"
@@ -882,6 +883,25 @@ broker::expected<broker::data> val_to_data(const Val* v)
 		auto is_set = v->GetType()->IsSet();
 		auto table = v->AsTable();
 		auto table_val = v->AsTableVal();
+
+		if ( auto cs = table_val->CompactStorage() )
+			{
+			broker::set rval;
+			size_t pos = 0;
+
+			while ( auto index = cs->Next(&pos) )
+				{
+				auto key = val_to_data(index.get());
+
+				if ( ! key )
+					return broker::ec::invalid_data;
+
+				rval.emplace(move(*key));
+				}
+
+			return {std::move(rval)};
+			}
+
 		broker::data rval;
 
 		if ( is_set )
@@ -1029,6 +1049,542 @@ RecordValPtr make_data_val(broker::data d)
 	return rval;
 	}
 
+// The direct encoding of event arguments, see pack_event_args(). Values
+// are written without any type information, in little-endian byte order;
+// the receiver decodes them according to its own declaration of the
+// event's parameters.
+
+static constexpr const char* PACKED_ARGS_TAG = "Broker::packed_args";
+
+static void wire_put(std::string* out, uint64_t x, int n)
+	{
+	for ( int i = 0; i < n; i++ )
+		out->push_back(static_cast<char>(x >> (8 * i)));
+	}
+
+static void wire_put_double(std::string* out, double d)
+	{
+	uint64_t x;
+	memcpy(&x, &d, sizeof(x));
+	wire_put(out, x, 8);
+	}
+
+static void wire_put_bytes(std::string* out, const char* s, size_t len)
+	{
+	wire_put(out, len, 4);
+	out->append(s, len);
+	}
+
+static void wire_put_addr(std::string* out, const IPAddr& a)
+	{
+	in6_addr tmp;
+	a.CopyIPv6(&tmp);
+	out->append(reinterpret_cast<const char*>(&tmp), sizeof(tmp));
+	}
+
+static bool val_to_wire(const Val* v, Type* t, std::string* out)
+	{
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+		out->push_back(v->AsBool() ? 1 : 0);
+		return true;
+
+	case TYPE_INT:
+		wire_put(out, v->AsInt(), 8);
+		return true;
+
+	case TYPE_COUNT:
+		wire_put(out, v->AsCount(), 8);
+		return true;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		wire_put_double(out, v->ForceAsDouble());
+		return true;
+
+	case TYPE_PORT:
+		{
+		auto p = v->AsPortVal();
+		wire_put(out, p->Port(), 4);
+		out->push_back(static_cast<char>(p->PortType()));
+		return true;
+		}
+
+	case TYPE_ADDR:
+		wire_put_addr(out, v->AsAddr());
+		return true;
+
+	case TYPE_SUBNET:
+		{
+		const auto& s = v->AsSubNet();
+		wire_put_addr(out, s.Prefix());
+		out->push_back(static_cast<char>(s.Length()));
+		return true;
+		}
+
+	case TYPE_STRING:
+		{
+		auto s = v->AsString();
+		wire_put_bytes(out, reinterpret_cast<const char*>(s->Bytes()), s->Len());
+		return true;
+		}
+
+	case TYPE_ENUM:
+		{
+		auto name = t->AsEnumType()->Lookup(v->AsEnum());
+
+		if ( ! name )
+			return false;
+
+		wire_put_bytes(out, name, strlen(name));
+		return true;
+		}
+
+	case TYPE_PATTERN:
+		{
+		const RE_Matcher* p = v->AsPattern();
+		wire_put_bytes(out, p->PatternText(), strlen(p->PatternText()));
+		wire_put_bytes(out, p->AnywherePatternText(), strlen(p->AnywherePatternText()));
+		return true;
+		}
+
+	case TYPE_TABLE:
+		{
+		auto tt = t->AsTableType();
+		const auto& index_types = tt->GetIndices()->GetTypes();
+		auto table = v->AsTable();
+		auto table_val = v->AsTableVal();
+
+		if ( auto cs = table_val->CompactStorage() )
+			{
+			wire_put(out, cs->Size(), 4);
+			size_t pos = 0;
+
+			while ( auto index = cs->Next(&pos) )
+				if ( ! val_to_wire(index.get(), index_types[0].get(), out) )
+					return false;
+
+			return true;
+			}
+
+		wire_put(out, table->Length(), 4);
+
+		zeek::detail::HashKey* hk;
+		TableEntryVal* entry;
+		auto c = table->InitForIteration();
+
+		while ( (entry = table->NextEntry(hk, c)) )
+			{
+			auto vl = table_val->RecreateIndex(*hk);
+			delete hk;
+
+			for ( auto k = 0; k < vl->Length(); ++k )
+				if ( ! val_to_wire(vl->Idx(k).get(), index_types[k].get(), out) )
+					{
+					table->StopIteration(c);
+					return false;
+					}
+
+			if ( ! tt->IsSet() && ! val_to_wire(entry->GetVal().get(), tt->Yield().get(), out) )
+				{
+				table->StopIteration(c);
+				return false;
+				}
+			}
+
+		return true;
+		}
+
+	case TYPE_VECTOR:
+		{
+		auto vec = v->AsVectorVal();
+		const auto& yield = t->AsVectorType()->Yield();
+
+		wire_put(out, vec->Size(), 4);
+
+		for ( auto i = 0u; i < vec->Size(); ++i )
+			{
+			const auto& item_val = vec->At(i);
+			out->push_back(item_val ? 1 : 0);
+
+			if ( item_val && ! val_to_wire(item_val.get(), yield.get(), out) )
+				return false;
+			}
+
+		return true;
+		}
+
+	case TYPE_RECORD:
+		{
+		auto rt = t->AsRecordType();
+		auto rec = v->AsRecordVal();
+
+		wire_put(out, rt->NumFields(), 4);
+
+		for ( auto i = 0; i < rt->NumFields(); ++i )
+			{
+			auto item_val = rec->GetFieldOrDefault(i);
+			out->push_back(item_val ? 1 : 0);
+
+			if ( item_val && ! val_to_wire(item_val.get(), rt->GetFieldType(i).get(), out) )
+				return false;
+			}
+
+		return true;
+		}
+
+	default:
+		// Includes any, which the receiver couldn't decode without
+		// type information.
+		return false;
+	}
+	}
+
+namespace {
+
+class WireReader {
+public:
+	WireReader(const std::string& buf) : p(buf.data()), end(buf.data() + buf.size())	{}
+
+	bool AtEnd() const	{ return p == end; }
+
+	bool Get(uint64_t* x, int n)
+		{
+		if ( end - p < n )
+			return false;
+
+		*x = 0;
+
+		for ( int i = 0; i < n; i++ )
+			*x |= uint64_t(static_cast<unsigned char>(*p++)) << (8 * i);
+
+		return true;
+		}
+
+	bool GetDouble(double* d)
+		{
+		uint64_t x;
+
+		if ( ! Get(&x, 8) )
+			return false;
+
+		memcpy(d, &x, sizeof(x));
+		return true;
+		}
+
+	bool GetBytes(std::string_view* s)
+		{
+		uint64_t len;
+
+		if ( ! Get(&len, 4) || static_cast<uint64_t>(end - p) < len )
+			return false;
+
+		*s = std::string_view(p, len);
+		p += len;
+		return true;
+		}
+
+	bool GetAddr(IPAddr* a)
+		{
+		in6_addr tmp;
+
+		if ( static_cast<size_t>(end - p) < sizeof(tmp) )
+			return false;
+
+		memcpy(&tmp, p, sizeof(tmp));
+		p += sizeof(tmp);
+		*a = IPAddr(tmp);
+		return true;
+		}
+
+private:
+	const char* p;
+	const char* end;
+};
+
+} // namespace
+
+static ValPtr wire_to_val(WireReader* in, Type* t)
+	{
+	uint64_t x;
+
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+		if ( ! in->Get(&x, 1) )
+			return nullptr;
+
+		return val_mgr->Bool(x);
+
+	case TYPE_INT:
+		if ( ! in->Get(&x, 8) )
+			return nullptr;
+
+		return val_mgr->Int(static_cast<int64_t>(x));
+
+	case TYPE_COUNT:
+		if ( ! in->Get(&x, 8) )
+			return nullptr;
+
+		return val_mgr->Count(x);
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		{
+		double d;
+
+		if ( ! in->GetDouble(&d) )
+			return nullptr;
+
+		if ( t->Tag() == TYPE_TIME )
+			return make_intrusive<TimeVal>(d);
+
+		if ( t->Tag() == TYPE_INTERVAL )
+			return make_intrusive<IntervalVal>(d);
+
+		return make_intrusive<DoubleVal>(d);
+		}
+
+	case TYPE_PORT:
+		{
+		uint64_t proto;
+
+		if ( ! in->Get(&x, 4) || ! in->Get(&proto, 1) || x > 65535 || proto > TRANSPORT_ICMP )
+			return nullptr;
+
+		return val_mgr->Port(x, static_cast<TransportProto>(proto));
+		}
+
+	case TYPE_ADDR:
+		{
+		IPAddr a;
+
+		if ( ! in->GetAddr(&a) )
+			return nullptr;
+
+		return make_intrusive<AddrVal>(a);
+		}
+
+	case TYPE_SUBNET:
+		{
+		IPAddr a;
+
+		if ( ! in->GetAddr(&a) || ! in->Get(&x, 1) )
+			return nullptr;
+
+		if ( x > (a.GetFamily() == IPv4 ? 32 : 128) )
+			return nullptr;
+
+		return make_intrusive<SubNetVal>(IPPrefix(a, x));
+		}
+
+	case TYPE_STRING:
+		{
+		std::string_view s;
+
+		if ( ! in->GetBytes(&s) )
+			return nullptr;
+
+		return make_intrusive<StringVal>(s.size(), s.data());
+		}
+
+	case TYPE_ENUM:
+		{
+		std::string_view s;
+
+		if ( ! in->GetBytes(&s) )
+			return nullptr;
+
+		auto etype = t->AsEnumType();
+		auto i = etype->Lookup(zeek::detail::GLOBAL_MODULE_NAME, std::string(s).c_str());
+
+		if ( i == -1 )
+			return nullptr;
+
+		return etype->GetEnumVal(i);
+		}
+
+	case TYPE_PATTERN:
+		{
+		std::string_view exact, anywhere;
+
+		if ( ! in->GetBytes(&exact) || ! in->GetBytes(&anywhere) )
+			return nullptr;
+
+		std::string exact_text(exact);
+		std::string anywhere_text(anywhere);
+		auto* re = new RE_Matcher(exact_text.c_str(), anywhere_text.c_str());
+
+		if ( ! re->Compile() )
+			{
+			reporter->Error("failed compiling unserialized pattern: %s, %s",
+			                exact_text.c_str(), anywhere_text.c_str());
+			delete re;
+			return nullptr;
+			}
+
+		return make_intrusive<PatternVal>(re);
+		}
+
+	case TYPE_TABLE:
+		{
+		auto tt = t->AsTableType();
+		const auto& index_types = tt->GetIndices()->GetTypes();
+		auto rval = make_intrusive<TableVal>(IntrusivePtr{NewRef{}, tt});
+
+		if ( ! in->Get(&x, 4) )
+			return nullptr;
+
+		for ( uint64_t n = 0; n < x; ++n )
+			{
+			auto list_val = make_intrusive<ListVal>(TYPE_ANY);
+
+			for ( const auto& it : index_types )
+				{
+				auto index_val = wire_to_val(in, it.get());
+
+				if ( ! index_val )
+					return nullptr;
+
+				list_val->Append(std::move(index_val));
+				}
+
+			ValPtr value_val;
+
+			if ( ! tt->IsSet() )
+				{
+				value_val = wire_to_val(in, tt->Yield().get());
+
+				if ( ! value_val )
+					return nullptr;
+				}
+
+			rval->Assign(std::move(list_val), std::move(value_val));
+			}
+
+		return rval;
+		}
+
+	case TYPE_VECTOR:
+		{
+		auto vt = t->AsVectorType();
+		auto rval = make_intrusive<VectorVal>(IntrusivePtr{NewRef{}, vt});
+
+		if ( ! in->Get(&x, 4) )
+			return nullptr;
+
+		for ( uint64_t i = 0; i < x; ++i )
+			{
+			uint64_t present;
+
+			if ( ! in->Get(&present, 1) )
+				return nullptr;
+
+			if ( ! present )
+				{
+				rval->Assign(i, nullptr);
+				continue;
+				}
+
+			auto item_val = wire_to_val(in, vt->Yield().get());
+
+			if ( ! item_val )
+				return nullptr;
+
+			rval->Assign(i, std::move(item_val));
+			}
+
+		return rval;
+		}
+
+	case TYPE_RECORD:
+		{
+		auto rt = t->AsRecordType();
+		auto rval = make_intrusive<RecordVal>(IntrusivePtr{NewRef{}, rt});
+
+		// Unlike with Broker data, we can't skip fields the sender has
+		// in addition to ours.
+		if ( ! in->Get(&x, 4) || x != static_cast<uint64_t>(rt->NumFields()) )
+			return nullptr;
+
+		for ( auto i = 0; i < rt->NumFields(); ++i )
+			{
+			uint64_t present;
+
+			if ( ! in->Get(&present, 1) )
+				return nullptr;
+
+			if ( ! present )
+				continue;
+
+			auto item_val = wire_to_val(in, rt->GetFieldType(i).get());
+
+			if ( ! item_val )
+				return nullptr;
+
+			rval->Assign(i, std::move(item_val));
+			}
+
+		return rval;
+		}
+
+	default:
+		return nullptr;
+	}
+	}
+
+std::optional<broker::vector> pack_event_args(const std::vector<const Val*>& args,
+                                              const std::vector<TypePtr>& types)
+	{
+	if ( args.size() != types.size() )
+		return {};
+
+	std::string packed;
+
+	for ( size_t i = 0; i < args.size(); ++i )
+		if ( ! val_to_wire(args[i], types[i].get(), &packed) )
+			return {};
+
+	broker::vector rval;
+	rval.reserve(2);
+	rval.emplace_back(broker::enum_value(PACKED_ARGS_TAG));
+	rval.emplace_back(std::move(packed));
+	return rval;
+	}
+
+bool is_packed_event_args(const broker::vector& args)
+	{
+	if ( args.size() != 2 )
+		return false;
+
+	auto tag = caf::get_if<broker::enum_value>(&args[0]);
+	return tag && tag->name == PACKED_ARGS_TAG && caf::get_if<std::string>(&args[1]);
+	}
+
+std::optional<Args> unpack_event_args(const broker::vector& args,
+                                      const std::vector<TypePtr>& types)
+	{
+	WireReader in(caf::get<std::string>(args[1]));
+	Args rval;
+	rval.reserve(types.size());
+
+	for ( const auto& t : types )
+		{
+		auto v = wire_to_val(&in, t.get());
+
+		if ( ! v )
+			return {};
+
+		rval.emplace_back(std::move(v));
+		}
+
+	if ( ! in.AtEnd() )
+		return {};
+
+	return rval;
+	}
+
 struct data_type_getter {
 	using result_type = EnumValPtr;
 
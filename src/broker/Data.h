@@ -1,9 +1,12 @@
 #pragma once
 
+#include <optional>
+
 #include "OpaqueVal.h"
 #include "Reporter.h"
 #include "Frame.h"
 #include "Expr.h"
+#include "ZeekArgs.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(ODesc, zeek);
 namespace zeek::threading {
@@ -67,6 +70,37 @@ broker::expected<broker::data> val_to_data(const Val* v);
  */
 ValPtr data_to_val(broker::data d, Type* type);
 
+/**
+ * Encode the arguments of an event directly into a compact binary form,
+ * rather than converting each into a Broker data value. The result takes
+ * the place of the arguments in the event's message. Receivers recognize
+ * it through is_packed_event_args() and decode it according to their own
+ * declaration of the event's parameters.
+ * @param args the argument values.
+ * @param types the types of the event's parameters.
+ * @return the packed arguments, or nothing if one of the types isn't
+ * supported by the encoding (any, func, file, and opaque types aren't),
+ * in which case the arguments need to go through val_to_data().
+ */
+std::optional<broker::vector> pack_event_args(const std::vector<const Val*>& args,
+                                              const std::vector<TypePtr>& types);
+
+/**
+ * Check if an event message's arguments were encoded by pack_event_args().
+ * @param args the arguments of the event message.
+ */
+bool is_packed_event_args(const broker::vector& args);
+
+/**
+ * Decode the arguments of an event message encoded by pack_event_args().
+ * @param args the arguments of the event message, which must satisfy
+ * is_packed_event_args().
+ * @param types the types of the event's parameters.
+ * @return the argument values, or nothing if they don't match the types.
+ */
+std::optional<Args> unpack_event_args(const broker::vector& args,
+                                      const std::vector<TypePtr>& types);
+
 /**
  * Convert a zeek::threading::Field to a Broker data value.
  * @param f a zeek::threading::Field.
@@ -2,9 +2,11 @@
 
 #include <broker/broker.hh>
 #include <broker/zeek.hh>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "Func.h"
 #include "Data.h"
@@ -14,6 +16,7 @@
 #include "Desc.h"
 #include "Reporter.h"
 #include "IntrusivePtr.h"
+#include "LoopTrace.h"
 #include "broker/comm.bif.h"
 #include "broker/data.bif.h"
 #include "broker/messaging.bif.h"
@@ -23,6 +26,7 @@
 #include "iosource/Manager.h"
 #include "SerializationFormat.h"
 #include "RunState.h"
+#include "MemoryTag.h"
 
 using namespace std;
 
@@ -131,6 +135,12 @@ Manager::Manager(bool arg_use_real_time)
 	use_real_time = arg_use_real_time;
 	peer_count = 0;
 	log_batch_size = 0;
+	log_batch_packing = false;
+	log_batch_compression_level = 0;
+	event_args_packing = false;
+	event_batch_size = 0;
+	max_messages_per_iteration = 0;
+	table_store_flush_interval = 0;
 	log_topic_func = nullptr;
 	log_id_type = nullptr;
 	writer_id_type = nullptr;
@@ -145,12 +155,27 @@ void Manager::InitPostScript()
 	DBG_LOG(DBG_BROKER, "Initializing");
 
 	log_batch_size = get_option("Broker::log_batch_size")->AsCount();
+	log_batch_packing = get_option("Broker::log_batch_packing")->AsBool();
+	log_batch_compression_level =
+	    std::min(get_option("Broker::log_batch_compression_level")->AsCount(),
+	             static_cast<bro_uint_t>(Z_BEST_COMPRESSION));
+	event_args_packing = get_option("Broker::event_args_packing")->AsBool();
+	event_batch_size = get_option("Broker::event_batch_size")->AsCount();
+	max_messages_per_iteration = get_option("Broker::max_messages_per_iteration")->AsCount();
+
+	auto prefixes = get_option("Broker::priority_topic_prefixes")->AsVectorVal();
+
+	for ( unsigned int i = 0; i < prefixes->Size(); ++i )
+		priority_topic_prefixes.emplace_back(prefixes->At(i)->AsString()->CheckString());
+
 	default_log_topic_prefix =
 	    get_option("Broker::default_log_topic_prefix")->AsString()->CheckString();
 	log_topic_func = get_option("Broker::log_topic")->AsFunc();
 	log_id_type = id::find_type("Log::ID")->AsEnumType();
 	writer_id_type = id::find_type("Log::Writer")->AsEnumType();
 	zeek_table_manager = get_option("Broker::table_store_master")->AsBool();
+	table_store_flush_interval =
+	    get_option("Broker::table_store_flush_interval")->AsInterval();
 	zeek_table_db_directory = get_option("Broker::table_store_db_directory")->AsString()->CheckString();
 
 	detail::opaque_of_data_type = make_intrusive<OpaqueType>("Broker::Data");
@@ -265,6 +290,8 @@ void Manager::InitializeBrokerStoreForwarding()
 
 void Manager::Terminate()
 	{
+	FlushTableStores();
+	FlushEventBuffers();
 	FlushLogBuffers();
 
 	iosource_mgr->UnregisterFd(bstate->subscriber.fd(), this);
@@ -395,6 +422,7 @@ void Manager::Unpeer(const string& addr, uint16_t port)
 	DBG_LOG(DBG_BROKER, "Stopping to peer with %s:%" PRIu16,
 	        addr.c_str(), port);
 
+	FlushEventBuffers();
 	FlushLogBuffers();
 	bstate->endpoint.unpeer_nosync(addr, port);
 	}
@@ -423,8 +451,26 @@ bool Manager::PublishEvent(string topic, std::string name, broker::vector args)
 	DBG_LOG(DBG_BROKER, "Publishing event: %s",
 		RenderEvent(topic, name, args).c_str());
 	broker::zeek::Event ev(std::move(name), std::move(args));
-	bstate->endpoint.publish(move(topic), ev.move_data());
 	++statistics.num_events_outgoing;
+
+	if ( event_batch_size <= 1 )
+		{
+		bstate->endpoint.publish(move(topic), ev.move_data());
+		return true;
+		}
+
+	auto& pending_batch = event_buffers[topic];
+	pending_batch.emplace_back(ev.move_data());
+
+	if ( pending_batch.size() >= event_batch_size )
+		{
+		broker::vector batch;
+		batch.reserve(event_batch_size);
+		pending_batch.swap(batch);
+		broker::zeek::Batch msg(std::move(batch));
+		bstate->endpoint.publish(move(topic), msg.move_data());
+		}
+
 	return true;
 	}
 
@@ -454,6 +500,44 @@ bool Manager::PublishEvent(string topic, RecordVal* args)
 	return PublishEvent(std::move(topic), event_name, std::move(xs));
 	}
 
+bool Manager::PublishEvent(string topic, ValPList* args, zeek::detail::Frame* frame)
+	{
+	if ( event_args_packing && peer_count > 0 && args->length() > 0 &&
+	     (*args)[0]->GetType()->Tag() == TYPE_FUNC )
+		{
+		auto func = (*args)[0]->AsFunc();
+		const auto& arg_types = func->GetType()->ParamList()->GetTypes();
+
+		if ( func->Flavor() == FUNC_FLAVOR_EVENT &&
+		     arg_types.size() == static_cast<size_t>(args->length() - 1) )
+			{
+			std::vector<const Val*> vals;
+			vals.reserve(arg_types.size());
+
+			for ( size_t i = 0; i < arg_types.size(); ++i )
+				{
+				auto v = (*args)[i + 1];
+
+				if ( ! same_type(v->GetType(), arg_types[i]) )
+					break;
+
+				vals.emplace_back(v);
+				}
+
+			if ( vals.size() == arg_types.size() )
+				if ( auto xs = detail::pack_event_args(vals, arg_types) )
+					return PublishEvent(std::move(topic), func->Name(), std::move(*xs));
+			}
+		}
+
+	// Anything we can't pack takes the regular path, which also reports
+	// invalid arguments.
+	auto ev = MakeEvent(args, frame);
+	auto rval = PublishEvent(std::move(topic), ev);
+	Unref(ev);
+	return rval;
+	}
+
 bool Manager::PublishIdentifier(std::string topic, std::string id)
 	{
 	if ( bstate->endpoint.is_shutdown() )
@@ -582,9 +666,8 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
 
 	fmt.StartWrite();
 
-	bool success = fmt.Write(num_fields, "num_fields");
-
-	if ( ! success )
+	// Packed records share the field count stored with their pack.
+	if ( ! log_batch_packing && ! fmt.Write(num_fields, "num_fields") )
 		{
 		reporter->Error("Failed to remotely log stream %s: num_fields serialization failed", stream_id);
 		return false;
@@ -600,8 +683,6 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
 		}
 
 	len = fmt.EndWrite(&data);
-	std::string serial_data(data, len);
-	free(data);
 
 	auto v = log_topic_func->Invoke(IntrusivePtr{NewRef{}, stream},
 	                                make_intrusive<StringVal>(path));
@@ -611,33 +692,130 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
 		reporter->Error("Failed to remotely log: log_topic func did not return"
 		                " a value for stream %s at path %s", stream_id,
 		                path.data());
+		free(data);
 		return false;
 		}
 
 	std::string topic = v->AsString()->CheckString();
 
-	auto bstream_id = broker::enum_value(move(stream_id));
-	auto bwriter_id = broker::enum_value(move(writer_id));
-	broker::zeek::LogWrite msg(move(bstream_id), move(bwriter_id), move(path),
-	                           move(serial_data));
-
-	DBG_LOG(DBG_BROKER, "Buffering log record: %s", RenderMessage(topic, msg.as_data()).c_str());
-
 	if ( log_buffers.size() <= (unsigned int)stream_id_num )
 		log_buffers.resize(stream_id_num + 1);
 
 	auto& lb = log_buffers[stream_id_num];
+	size_t msg_bytes = len;
+
+	if ( log_batch_packing )
+		{
+		auto& pack = lb.packs[topic + '\0' + writer_id + '\0' + path];
+
+		if ( ! pack.num_records )
+			{
+			if ( lb.stream_id.empty() )
+				lb.stream_id = stream_id;
+
+			pack.topic = topic;
+			pack.writer_id = writer_id;
+			pack.path = path;
+			pack.num_fields = num_fields;
+			msg_bytes += path.size() + topic.size();
+			}
+
+		pack.records.append(data, len);
+		++pack.num_records;
+		free(data);
+
+		DBG_LOG(DBG_BROKER, "Packing log record for stream %s at path %s",
+		        stream_id, pack.path.c_str());
+		}
+	else
+		{
+		std::string serial_data(data, len);
+		free(data);
+
+		msg_bytes += path.size() + topic.size();
+		auto bstream_id = broker::enum_value(move(stream_id));
+		auto bwriter_id = broker::enum_value(move(writer_id));
+		broker::zeek::LogWrite msg(move(bstream_id), move(bwriter_id), move(path),
+		                           move(serial_data));
+
+		DBG_LOG(DBG_BROKER, "Buffering log record: %s", RenderMessage(topic, msg.as_data()).c_str());
+
+		auto& pending_batch = lb.msgs[topic];
+		pending_batch.emplace_back(msg.move_data());
+		}
+
 	++lb.message_count;
-	auto& pending_batch = lb.msgs[topic];
-	pending_batch.emplace_back(msg.move_data());
+	lb.bytes += msg_bytes;
+	zeek::detail::memory_tag_alloc(zeek::detail::MemoryTag::Broker, msg_bytes);
 
 	if ( lb.message_count >= log_batch_size )
-		statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size);
+		statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size,
+		                                         log_batch_compression_level);
 
 	return true;
 	}
 
-size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_size)
+// Takes the place of the field count that starts a single record's
+// LogWrite payload in a packed one.
+static constexpr int LOG_PACK_MARKER = -1;
+
+std::string Manager::LogPack::Serialize(int compression_level) const
+	{
+	std::string compressed;
+	const std::string* payload = &records;
+
+	if ( compression_level > 0 )
+		{
+		uLongf n = compressBound(records.size());
+		compressed.resize(n);
+
+		auto rc = compress2(reinterpret_cast<Bytef*>(&compressed[0]), &n,
+		                    reinterpret_cast<const Bytef*>(records.data()),
+		                    records.size(), compression_level);
+
+		// Incompressible records go out as they are.
+		if ( rc == Z_OK && n < records.size() )
+			{
+			compressed.resize(n);
+			payload = &compressed;
+			}
+		}
+
+	zeek::detail::BinarySerializationFormat fmt;
+	fmt.StartWrite();
+	fmt.Write(LOG_PACK_MARKER, "marker");
+	fmt.Write(num_fields, "num_fields");
+	fmt.Write(num_records, "num_records");
+	fmt.Write(static_cast<uint32_t>(records.size()), "size");
+	fmt.Write(payload != &records, "compressed");
+
+	char* data;
+	auto len = fmt.EndWrite(&data);
+	std::string rval;
+	rval.reserve(len + payload->size());
+	rval.append(data, len);
+	rval.append(*payload);
+	free(data);
+	return rval;
+	}
+
+void Manager::LogBuffer::FlushPacks(int compression_level)
+	{
+	for ( auto& kv : packs )
+		{
+		auto& pack = kv.second;
+		broker::zeek::LogWrite msg(broker::enum_value(stream_id),
+		                           broker::enum_value(move(pack.writer_id)),
+		                           move(pack.path),
+		                           pack.Serialize(compression_level));
+		msgs[pack.topic].emplace_back(msg.move_data());
+		}
+
+	packs.clear();
+	}
+
+size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_size,
+                                 int compression_level)
 	{
 	if ( endpoint.is_shutdown() )
 		return 0;
@@ -646,6 +824,8 @@ size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_si
 		// No logs buffered for this stream.
 		return 0;
 
+	FlushPacks(compression_level);
+
 	for ( auto& kv : msgs )
 		{
 		auto& topic = kv.first;
@@ -657,6 +837,9 @@ size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_si
 		endpoint.publish(topic, msg.move_data());
 		}
 
+	zeek::detail::memory_tag_free(zeek::detail::MemoryTag::Broker, bytes);
+	bytes = 0;
+
 	auto rval = message_count;
 	message_count = 0;
 	return rval;
@@ -668,12 +851,51 @@ size_t Manager::FlushLogBuffers()
 	auto rval = 0u;
 
 	for ( auto& lb : log_buffers )
-		rval += lb.Flush(bstate->endpoint, log_batch_size);
+		rval += lb.Flush(bstate->endpoint, log_batch_size,
+		                 log_batch_compression_level);
 
 	statistics.num_logs_outgoing += rval;
 	return rval;
 	}
 
+size_t Manager::FlushEventBuffers()
+	{
+	DBG_LOG(DBG_BROKER, "Flushing all event buffers");
+	size_t rval = 0;
+
+	for ( auto& kv : event_buffers )
+		{
+		auto& topic = kv.first;
+		auto& pending_batch = kv.second;
+
+		if ( pending_batch.empty() )
+			continue;
+
+		rval += pending_batch.size();
+
+		if ( pending_batch.size() == 1 )
+			{
+			bstate->endpoint.publish(topic, std::move(pending_batch[0]));
+			pending_batch.clear();
+			continue;
+			}
+
+		broker::vector batch;
+		batch.reserve(event_batch_size);
+		pending_batch.swap(batch);
+		broker::zeek::Batch msg(std::move(batch));
+		bstate->endpoint.publish(topic, msg.move_data());
+		}
+
+	return rval;
+	}
+
+void Manager::FlushTableStores()
+	{
+	for ( auto& kv : forwarded_stores )
+		kv.second->FlushStoreUpdates();
+	}
+
 void Manager::Error(const char* format, ...)
 	{
 	va_list args;
@@ -849,6 +1071,7 @@ bool Manager::Forward(string topic_prefix)
 	DBG_LOG(DBG_BROKER, "Forwarding topic prefix %s", topic_prefix.c_str());
 	Subscribe(topic_prefix);
 	forwarded_prefixes.emplace_back(std::move(topic_prefix));
+	forwarded_topics.clear();
 	return true;
 	}
 
@@ -859,6 +1082,7 @@ bool Manager::Unsubscribe(const string& topic_prefix)
 			{
 			DBG_LOG(DBG_BROKER, "Unforwading topic prefix %s", topic_prefix.c_str());
 			forwarded_prefixes.erase(forwarded_prefixes.begin() + i);
+			forwarded_topics.clear();
 			break;
 			}
 
@@ -925,6 +1149,7 @@ void Manager::Process()
 		run_state::detail::update_network_time(util::current_time());
 
 	bool had_input = false;
+	auto start_time = util::current_time();
 
 	auto status_msgs = bstate->status_subscriber.poll();
 
@@ -947,7 +1172,32 @@ void Manager::Process()
 		reporter->InternalWarning("ignoring status_subscriber message with unexpected type");
 		}
 
-	auto messages = bstate->subscriber.poll();
+	// Anything beyond the budget stays queued, and since the subscriber's
+	// descriptor remains ready, will be picked up in the next iteration.
+	auto num_messages = bstate->subscriber.available();
+	statistics.num_messages_backlog = num_messages;
+
+	if ( max_messages_per_iteration > 0 && num_messages > max_messages_per_iteration )
+		{
+		num_messages = max_messages_per_iteration;
+		++statistics.num_budget_exhausted;
+		}
+
+	std::vector<broker::data_message> messages;
+
+	if ( num_messages > 0 )
+		messages = bstate->subscriber.get(num_messages);
+
+	if ( ! priority_topic_prefixes.empty() )
+		std::stable_partition(messages.begin(), messages.end(),
+		                      [this](const broker::data_message& m)
+		                      { return IsPriorityTopic(broker::get_topic(m)); });
+
+	statistics.num_messages_processed += messages.size();
+
+	if ( zeek::detail::loop_trace && ! messages.empty() )
+		zeek::detail::loop_trace->Record(zeek::detail::LoopTraceType::BROKER, messages.size(),
+		                                 statistics.num_messages_backlog);
 
 	for ( auto& message : messages )
 		{
@@ -994,6 +1244,11 @@ void Manager::Process()
 
 	if ( had_input )
 		{
+		auto elapsed = util::current_time() - start_time;
+		++statistics.num_process_iterations;
+		statistics.processing_time += elapsed;
+		statistics.max_processing_time = std::max(statistics.max_processing_time, elapsed);
+
 		if ( run_state::network_time == 0 )
 			// If we're getting Broker messages, but still haven't initialized
 			// run_state::network_time, may as well do so now because otherwise the
@@ -1002,6 +1257,17 @@ void Manager::Process()
 		}
 	}
 
+bool Manager::IsPriorityTopic(const broker::topic& topic) const
+	{
+	const auto& s = topic.string();
+
+	for ( const auto& prefix : priority_topic_prefixes )
+		if ( s.compare(0, prefix.size(), prefix) == 0 )
+			return true;
+
+	return false;
+	}
+
 void Manager::ProcessStoreEventInsertUpdate(const TableValPtr& table,
                                             const std::string& store_id,
                                             const broker::data& key,
@@ -1137,6 +1403,31 @@ void Manager::ProcessStoreEvent(broker::data msg)
 		}
 	}
 
+bool Manager::IsForwardedTopic(const std::string& topic)
+	{
+	if ( auto it = forwarded_topics.find(topic); it != forwarded_topics.end() )
+		return it->second;
+
+	bool forwarded = false;
+
+	for ( const auto& p : forwarded_prefixes )
+		{
+		if ( p.size() <= topic.size() &&
+		     strncmp(p.data(), topic.data(), p.size()) == 0 )
+			{
+			forwarded = true;
+			break;
+			}
+		}
+
+	// Topics are few in practice, but nothing guarantees that.
+	if ( forwarded_topics.size() >= 1000 )
+		forwarded_topics.clear();
+
+	forwarded_topics.emplace(topic, forwarded);
+	return forwarded;
+	}
+
 void Manager::ProcessEvent(const broker::topic& topic, broker::zeek::Event ev)
 	{
 	if ( ! ev.valid() )
@@ -1157,16 +1448,8 @@ void Manager::ProcessEvent(const broker::topic& topic, broker::zeek::Event ev)
 	if ( ! handler )
 		return;
 
-	auto& topic_string = topic.string();
-
-	for ( const auto& p : forwarded_prefixes )
+	if ( ! forwarded_prefixes.empty() && IsForwardedTopic(topic.string()) )
 		{
-		if ( p.size() > topic_string.size() )
-			continue;
-
-		if ( strncmp(p.data(), topic_string.data(), p.size()) != 0 )
-			continue;
-
 		DBG_LOG(DBG_BROKER, "Skip processing of forwarded event: %s %s",
 		        name.data(), RenderMessage(args).data());
 		return;
@@ -1174,6 +1457,21 @@ void Manager::ProcessEvent(const broker::topic& topic, broker::zeek::Event ev)
 
 	const auto& arg_types = handler->GetType(false)->ParamList()->GetTypes();
 
+	if ( detail::is_packed_event_args(args) )
+		{
+		auto vl = detail::unpack_event_args(args, arg_types);
+
+		if ( ! vl )
+			{
+			reporter->Warning("failed to unpack arguments of remote event '%s'",
+			                  name.data());
+			return;
+			}
+
+		event_mgr.Enqueue(handler, std::move(*vl), util::detail::SOURCE_BROKER);
+		return;
+		}
+
 	if ( arg_types.size() != args.size() )
 		{
 		reporter->Warning("got event message '%s' with invalid # of args,"
@@ -1294,7 +1592,6 @@ bool Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 		return false;
 		}
 
-	++statistics.num_logs_incoming;
 	auto& stream_id_name = lw.stream_id().name;
 
 	// Get stream ID.
@@ -1343,6 +1640,17 @@ bool Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 		return false;
 		}
 
+	if ( num_fields == LOG_PACK_MARKER )
+		{
+		auto num_records = UnpackLogWrites(&fmt, *serial_data, stream_id->AsEnumVal(),
+		                                   writer_id->AsEnumVal(), *path,
+		                                   stream_id_name.data());
+		statistics.num_logs_incoming += num_records;
+		fmt.EndRead();
+		return num_records > 0;
+		}
+
+	++statistics.num_logs_incoming;
 	auto vals = new threading::Value* [num_fields];
 
 	for ( int i = 0; i < num_fields; ++i )
@@ -1367,6 +1675,83 @@ bool Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 	return true;
 	}
 
+size_t Manager::UnpackLogWrites(zeek::detail::BinarySerializationFormat* fmt,
+                                const std::string& serial_data, EnumVal* stream_id,
+                                EnumVal* writer_id, const std::string& path,
+                                const char* stream_id_name)
+	{
+	int num_fields;
+	uint32_t num_records;
+	uint32_t size;
+	bool compressed;
+
+	if ( ! (fmt->Read(&num_fields, "num_fields") &&
+	        fmt->Read(&num_records, "num_records") &&
+	        fmt->Read(&size, "size") &&
+	        fmt->Read(&compressed, "compressed")) || num_fields < 0 )
+		{
+		reporter->Warning("failed to unserialize remote log pack header for stream: %s", stream_id_name);
+		return 0;
+		}
+
+	const char* data = serial_data.data() + fmt->BytesRead();
+	size_t len = serial_data.size() - fmt->BytesRead();
+	std::string uncompressed;
+
+	if ( compressed )
+		{
+		uncompressed.resize(size);
+		uLongf n = size;
+
+		if ( uncompress(reinterpret_cast<Bytef*>(&uncompressed[0]), &n,
+		                reinterpret_cast<const Bytef*>(data), len) != Z_OK || n != size )
+			{
+			reporter->Warning("failed to uncompress remote log pack for stream: %s", stream_id_name);
+			return 0;
+			}
+
+		data = uncompressed.data();
+		len = size;
+		}
+
+	zeek::detail::BinarySerializationFormat rfmt;
+	rfmt.StartRead(data, len);
+
+	// Don't trust the record count for the reservation, every record
+	// takes at least a byte.
+	std::vector<threading::Value**> records;
+	records.reserve(std::min(static_cast<size_t>(num_records), len));
+
+	for ( uint32_t r = 0; r < num_records; ++r )
+		{
+		auto vals = new threading::Value* [num_fields];
+
+		for ( int i = 0; i < num_fields; ++i )
+			{
+			vals[i] = new threading::Value;
+
+			if ( ! vals[i]->Read(&rfmt) )
+				{
+				threading::Value::delete_value_ptr_array(vals, i + 1);
+
+				for ( auto rec : records )
+					threading::Value::delete_value_ptr_array(rec, num_fields);
+
+				reporter->Warning("failed to unserialize remote log field %d of record %" PRIu32 " for stream: %s",
+				                  i, r, stream_id_name);
+				return 0;
+				}
+			}
+
+		records.push_back(vals);
+		}
+
+	rfmt.EndRead();
+
+	log_mgr->WriteFromRemote(stream_id, writer_id, path, num_fields, &records);
+	return num_records;
+	}
+
 bool Manager::ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu)
 	{
 	DBG_LOG(DBG_BROKER, "Received id-update: %s", RenderMessage(iu.as_data()).c_str());
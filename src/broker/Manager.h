@@ -26,6 +26,7 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(Func, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Frame, zeek::detail);
 ZEEK_FORWARD_DECLARE_NAMESPACED(VectorType, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(TableVal, zeek);
+ZEEK_FORWARD_DECLARE_NAMESPACED(BinarySerializationFormat, zeek::detail);
 
 namespace zeek {
 using VectorTypePtr = IntrusivePtr<VectorType>;
@@ -62,6 +63,18 @@ struct Stats {
 	size_t num_ids_incoming = 0;
 	// Number of total identifiers sent.
 	size_t num_ids_outgoing = 0;
+	// Number of main loop iterations that processed Broker input.
+	size_t num_process_iterations = 0;
+	// Number of total messages processed.
+	size_t num_messages_processed = 0;
+	// Number of iterations that deferred messages to the next one.
+	size_t num_budget_exhausted = 0;
+	// Number of messages waiting at the start of the last iteration.
+	size_t num_messages_backlog = 0;
+	// Total seconds spent processing input.
+	double processing_time = 0;
+	// Max seconds spent processing input in a single iteration.
+	double max_processing_time = 0;
 };
 
 /**
@@ -172,6 +185,29 @@ public:
 	 */
 	bool PublishEvent(std::string topic, RecordVal* ev);
 
+	/**
+	 * Send an event to any interested peers. If
+	 * :zeek:see:`Broker::event_args_packing` is set, its arguments get
+	 * encoded directly through pack_event_args(), as far as their types
+	 * support that. Otherwise, or if they don't, this goes through
+	 * MakeEvent().
+	 * @param topic a topic string associated with the message.
+	 * Peers advertise interest by registering a subscription to some prefix
+	 * of this topic name.
+	 * @param args the event and its arguments.  The event is always the first
+	 * elements in the list.
+	 * @param frame the calling frame, used to report location info upon error
+	 * @return true if the message is sent successfully.
+	 */
+	bool PublishEvent(std::string topic, ValPList* args, zeek::detail::Frame* frame);
+
+	/**
+	 * @return true if events published by this node have their arguments
+	 * packed, see :zeek:see:`Broker::event_args_packing`.
+	 */
+	bool PacksEventArgs() const
+		{ return event_args_packing; }
+
 	/**
 	 * Send a message to create a log stream to any interested peers.
 	 * The log stream may or may not already exist on the receiving side.
@@ -336,6 +372,26 @@ public:
 	 */
 	size_t FlushLogBuffers();
 
+	/**
+	 * Send all event messages held back for batching, see
+	 * :zeek:see:`Broker::event_batch_size`.
+	 * @return the number of messages sent.
+	 */
+	size_t FlushEventBuffers();
+
+	/**
+	 * Send the updates of all Broker store backed tables that are held
+	 * back for coalescing, see :zeek:see:`Broker::table_store_flush_interval`.
+	 */
+	void FlushTableStores();
+
+	/**
+	 * @return the interval at which updates of Broker store backed tables
+	 * are sent, or zero if they are sent right away.
+	 */
+	double TableStoreFlushInterval() const
+		{ return table_store_flush_interval; }
+
 	/**
 	 * Flushes all pending data store queries and also clears all contents.
 	 */
@@ -359,13 +415,22 @@ public:
 private:
 
 	void DispatchMessage(const broker::topic& topic, broker::data msg);
+	bool IsPriorityTopic(const broker::topic& topic) const;
 	// Process events used for Broker store backed zeek tables
 	void ProcessStoreEvent(broker::data msg);
 	// Common functionality for processing insert and update events.
 	void ProcessStoreEventInsertUpdate(const TableValPtr& table, const std::string& store_id, const broker::data& key, const broker::data& data, const broker::data& old_value, bool insert);
 	void ProcessEvent(const broker::topic& topic, broker::zeek::Event ev);
+	// Whether the topic falls under forwarded_prefixes, cached per topic.
+	bool IsForwardedTopic(const std::string& topic);
 	bool ProcessLogCreate(broker::zeek::LogCreate lc);
 	bool ProcessLogWrite(broker::zeek::LogWrite lw);
+	// Hands the records of a packed LogWrite to the logging manager,
+	// returning their number, or zero if they didn't unpack.
+	size_t UnpackLogWrites(zeek::detail::BinarySerializationFormat* fmt,
+	                       const std::string& serial_data, EnumVal* stream_id,
+	                       EnumVal* writer_id, const std::string& path,
+	                       const char* stream_id_name);
 	bool ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu);
 	void ProcessStatus(broker::status stat);
 	void ProcessError(broker::error err);
@@ -387,12 +452,31 @@ private:
 	const char* Tag() override	{ return "Broker::Manager"; }
 	double GetNextTimeout() override	{ return -1; }
 
+	// Log entries of the same topic, writer and path, packed into the
+	// payload of a single LogWrite message.
+	struct LogPack {
+		std::string topic;
+		std::string writer_id;
+		std::string path;
+		int num_fields = 0;
+		uint32_t num_records = 0;
+		std::string records;	// The records' serialized values.
+
+		std::string Serialize(int compression_level) const;
+	};
+
 	struct LogBuffer {
 		// Indexed by topic string.
 		std::unordered_map<std::string, broker::vector> msgs;
+		// Indexed by topic, writer and path, NUL-separated.
+		std::unordered_map<std::string, LogPack> packs;
+		std::string stream_id;
 		size_t message_count;
+		size_t bytes = 0;	// Buffered, as accounted to MemoryTag::Broker.
 
-		size_t Flush(broker::endpoint& endpoint, size_t batch_size);
+		size_t Flush(broker::endpoint& endpoint, size_t batch_size,
+		             int compression_level);
+		void FlushPacks(int compression_level);
 	};
 
 	// Data stores
@@ -409,6 +493,11 @@ private:
 	};
 
 	std::vector<LogBuffer> log_buffers; // Indexed by stream ID enum.
+	std::unordered_map<std::string, broker::vector> event_buffers; // Indexed by topic.
+	size_t event_batch_size;
+	size_t max_messages_per_iteration;
+	std::vector<std::string> priority_topic_prefixes;
+	double table_store_flush_interval;
 	std::string default_log_topic_prefix;
 	std::shared_ptr<BrokerState> bstate;
 	std::unordered_map<std::string, detail::StoreHandleVal*> data_stores;
@@ -417,6 +506,10 @@ private:
 	                   query_id_hasher> pending_queries;
 	std::vector<std::string> forwarded_prefixes;
 
+	// Whether topics of incoming events fall under forwarded_prefixes,
+	// so that the prefixes don't have to be compared per event.
+	std::unordered_map<std::string, bool> forwarded_topics;
+
 	Stats statistics;
 
 	uint16_t bound_port;
@@ -424,6 +517,9 @@ private:
 	int peer_count;
 
 	size_t log_batch_size;
+	bool log_batch_packing;
+	int log_batch_compression_level;
+	bool event_args_packing;
 	Func* log_topic_func;
 	VectorTypePtr vector_of_data_type;
 	EnumType* log_id_type;
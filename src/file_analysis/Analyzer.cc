@@ -3,6 +3,7 @@
 #include "Analyzer.h"
 #include "Manager.h"
 #include "Val.h"
+#include "Stats.h"
 
 namespace zeek::file_analysis {
 
@@ -12,12 +13,25 @@ Analyzer::~Analyzer()
 	{
 	DBG_LOG(DBG_FILE_ANALYSIS, "Destroy file analyzer %s",
 	        file_mgr->GetComponentName(tag).c_str());
+
+	if ( usage )
+		--usage->instances;
 	}
 
 void Analyzer::SetAnalyzerTag(const file_analysis::Tag& arg_tag)
 	{
 	assert(! tag || tag == arg_tag);
 	tag = arg_tag;
+	InitUsage();
+	}
+
+void Analyzer::InitUsage()
+	{
+	if ( ! zeek::detail::analyzer_accounting || usage || ! tag )
+		return;
+
+	usage = zeek::detail::analyzer_accounting->Usage(true, file_mgr->GetComponentName(tag));
+	++usage->instances;
 	}
 
 Analyzer::Analyzer(file_analysis::Tag arg_tag,
@@ -27,9 +41,11 @@ Analyzer::Analyzer(file_analysis::Tag arg_tag,
 	  args(std::move(arg_args)),
 	  file(arg_file),
 	  got_stream_delivery(false),
-	  skip(false)
+	  skip(false),
+	  usage(nullptr)
 	{
 	id = ++id_counter;
+	InitUsage();
 	}
 
 Analyzer::Analyzer(RecordValPtr arg_args, File* arg_file)
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Tag.h"
+#include "MemoryTag.h"
 
 #include <sys/types.h> // for u_char
 
@@ -13,6 +14,8 @@ using RecordValPtr = IntrusivePtr<RecordVal>;
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(File, zeek, file_analysis);
 
+namespace zeek::detail { struct AnalyzerUsage; }
+
 namespace zeek::file_analysis {
 
 using ID = uint32_t;
@@ -20,7 +23,7 @@ using ID = uint32_t;
 /**
  * Base class for analyzers that can be attached to file_analysis::File objects.
  */
-class Analyzer {
+class Analyzer : public zeek::detail::MemoryTagged<zeek::detail::MemoryTag::FileAnalysis> {
 public:
 
 	/**
@@ -62,6 +65,15 @@ public:
 	virtual bool DeliverStream(const u_char* data, uint64_t len)
 		{ return true; }
 
+	/**
+	 * Subclasses only processing DeliverChunk() may override this method
+	 * to tell that they don't need DeliverStream(), so that out-of-order
+	 * file data doesn't need to be reassembled for them.
+	 * @return true if the analyzer needs the file's contents in order.
+	 */
+	virtual bool NeedsStream() const
+		{ return true; }
+
 	/**
 	 * Subclasses may override this method to specifically handle an EOF signal,
 	 * which means no more data is going to be incoming and the analyzer
@@ -145,6 +157,12 @@ public:
 	 */
 	bool Skipping() const			{ return skip; }
 
+	/**
+	 * Returns the analyzer's entry with analyzer accounting, or null if
+	 * that's not enabled.
+	 */
+	zeek::detail::AnalyzerUsage* Usage() const	{ return usage; }
+
 protected:
 
 	/**
@@ -174,6 +192,8 @@ protected:
 	Analyzer(RecordVal* arg_args, File* arg_file);
 
 private:
+	// Sets up analyzer accounting, once the tag is known.
+	void InitUsage();
 
 	ID id;	/**< Unique instance ID. */
 	file_analysis::Tag tag;	/**< The particular type of the analyzer instance. */
@@ -181,6 +201,7 @@ private:
 	File* file;	/**< The file to which the analyzer is attached. */
 	bool got_stream_delivery;
 	bool skip;
+	zeek::detail::AnalyzerUsage* usage;
 
 	static ID id_counter;
 };
@@ -2,10 +2,11 @@
 
 #include "File.h"
 
+#include <algorithm>
+#include <iterator>
 #include <utility>
 
 #include "FileReassembler.h"
-#include "FileTimer.h"
 #include "Analyzer.h"
 #include "Manager.h"
 #include "Reporter.h"
@@ -13,6 +14,7 @@
 #include "Type.h"
 #include "Event.h"
 #include "RuleMatcher.h"
+#include "Stats.h"
 
 #include "analyzer/Analyzer.h"
 #include "analyzer/Manager.h"
@@ -85,7 +87,8 @@ File::File(const std::string& file_id, const std::string& source_name, Connectio
 	: id(file_id), val(nullptr), file_reassembler(nullptr), stream_offset(0),
 	  reassembly_max_buffer(0), did_metadata_inference(false),
 	  reassembly_enabled(false), postpone_timeout(false), done(false),
-	  analyzers(this)
+	  ignored(false), last_active(0.0), idle_prev(nullptr),
+	  idle_next(nullptr), analyzers(this)
 	{
 	StaticInit();
 
@@ -115,7 +118,14 @@ File::~File()
 
 void File::UpdateLastActivityTime()
 	{
-	val->Assign(last_active_idx, make_intrusive<TimeVal>(run_state::network_time));
+	// Chunks of a file often arrive at the same time, so spare the
+	// allocation.
+	if ( last_active == run_state::network_time && val->GetField(last_active_idx) )
+		return;
+
+	last_active = run_state::network_time;
+	val->Assign(last_active_idx, make_intrusive<TimeVal>(last_active));
+	file_mgr->MarkActive(this);
 	}
 
 double File::GetLastActivityTime() const
@@ -201,6 +211,7 @@ double File::GetTimeoutInterval() const
 void File::SetTimeoutInterval(double interval)
 	{
 	val->Assign(timeout_interval_idx, make_intrusive<IntervalVal>(interval));
+	file_mgr->NoteTimeoutInterval(interval);
 	}
 
 bool File::SetExtractionLimit(RecordVal* args, uint64_t bytes)
@@ -248,11 +259,6 @@ bool File::IsComplete() const
 	return false;
 	}
 
-void File::ScheduleInactivityTimer() const
-	{
-	zeek::detail::timer_mgr->Add(new detail::FileTimer(run_state::network_time, id, GetTimeoutInterval()));
-	}
-
 bool File::AddAnalyzer(file_analysis::Tag tag, RecordVal* args)
 	{ return AddAnalyzer(tag, {NewRef{}, args}); }
 
@@ -361,6 +367,7 @@ bool File::BufferBOF(const u_char* data, uint64_t len)
 
 	bof_buffer.chunks.push_back(new String(data, len, false));
 	bof_buffer.size += len;
+	zeek::detail::memory_tag_alloc(zeek::detail::MemoryTag::FileAnalysis, len);
 
 	if ( bof_buffer.size < desired_size )
 		return true;
@@ -416,6 +423,8 @@ void File::DeliverStream(const u_char* data, uint64_t len)
 				{
 				if ( ! a->Skipping() )
 					{
+					zeek::detail::AnalyzerUsageTimer usage_timer(a->Usage(), bof_buffer.chunks[i]->Len());
+
 					if ( ! a->DeliverStream(bof_buffer.chunks[i]->Bytes(),
 								bof_buffer.chunks[i]->Len()) )
 						{
@@ -434,6 +443,8 @@ void File::DeliverStream(const u_char* data, uint64_t len)
 
 		if ( ! a->Skipping() )
 			{
+			zeek::detail::AnalyzerUsageTimer usage_timer(a->Usage(), len);
+
 			if ( ! a->DeliverStream(data, len) )
 				{
 				a->SetSkip(true);
@@ -476,11 +487,20 @@ void File::DeliverChunk(const u_char* data, uint64_t len, uint64_t offset)
 		// This is the normal case where a file is transferred linearly.
 		// Nothing special should be done here.
 		DeliverStream(data, len);
+		SkipSparseRanges();
+		}
+	else if ( reassembly_enabled && ! NeedsReassembly() )
+		{
+		// Only the chunk-wise analyzers below care about this data, so
+		// there's no point in buffering it.
+		IncrementByteCount(AddSparseRange(offset, len), seen_bytes_idx);
+		SkipSparseRanges();
 		}
 	else if ( reassembly_enabled )
 		{
 		// This is data that doesn't match the offset and the reassembler
 		// needs to be enabled.
+		sparse_ranges.clear();
 		file_reassembler = new FileReassembler(this, stream_offset);
 		file_reassembler->NewBlock(run_state::network_time, offset, len, data);
 		}
@@ -505,6 +525,8 @@ void File::DeliverChunk(const u_char* data, uint64_t len, uint64_t offset)
 		DBG_LOG(DBG_FILE_ANALYSIS, "chunk delivery to analyzer %s", file_mgr->GetComponentName(a->Tag()).c_str());
 		if ( ! a->Skipping() )
 			{
+			zeek::detail::AnalyzerUsageTimer usage_timer(a->Usage(), len);
+
 			if ( ! a->DeliverChunk(data, len, offset) )
 				{
 				a->SetSkip(true);
@@ -517,6 +539,70 @@ void File::DeliverChunk(const u_char* data, uint64_t len, uint64_t offset)
 		EndOfFile();
 	}
 
+bool File::NeedsReassembly()
+	{
+	if ( ! bof_buffer.full )
+		return true;
+
+	bool needed = false;
+	file_analysis::Analyzer* a = nullptr;
+	IterCookie* c = analyzers.InitForIteration();
+
+	// Iterate through the end so that the cookie gets released.
+	while ( (a = analyzers.NextEntry(c)) )
+		{
+		if ( ! a->Skipping() && a->NeedsStream() )
+			needed = true;
+		}
+
+	return needed;
+	}
+
+uint64_t File::AddSparseRange(uint64_t offset, uint64_t len)
+	{
+	uint64_t start = std::max(offset, stream_offset);
+	uint64_t end = offset + len;
+
+	if ( end <= start )
+		return 0;
+
+	uint64_t new_bytes = end - start;
+	uint64_t merged_start = start;
+	uint64_t merged_end = end;
+
+	// Find the first range overlapping or adjoining the new one.
+	auto it = sparse_ranges.upper_bound(start);
+
+	if ( it != sparse_ranges.begin() && std::prev(it)->second >= start )
+		--it;
+
+	while ( it != sparse_ranges.end() && it->first <= end )
+		{
+		uint64_t overlap_start = std::max(it->first, start);
+		uint64_t overlap_end = std::min(it->second, end);
+
+		if ( overlap_end > overlap_start )
+			new_bytes -= overlap_end - overlap_start;
+
+		merged_start = std::min(merged_start, it->first);
+		merged_end = std::max(merged_end, it->second);
+		it = sparse_ranges.erase(it);
+		}
+
+	sparse_ranges.emplace(merged_start, merged_end);
+	return new_bytes;
+	}
+
+void File::SkipSparseRanges()
+	{
+	while ( ! sparse_ranges.empty() &&
+	        sparse_ranges.begin()->first <= stream_offset )
+		{
+		stream_offset = std::max(stream_offset, sparse_ranges.begin()->second);
+		sparse_ranges.erase(sparse_ranges.begin());
+		}
+	}
+
 void File::DoneWithAnalyzer(Analyzer* analyzer)
 	{
 	done_analyzers.push_back(analyzer);
@@ -614,7 +700,7 @@ void File::Gap(uint64_t offset, uint64_t len)
 
 bool File::FileEventAvailable(EventHandlerPtr h)
 	{
-	return h && ! file_mgr->IsIgnored(id);
+	return h && ! ignored;
 	}
 
 void File::FileEvent(EventHandlerPtr h)
@@ -650,10 +736,10 @@ void File::FileEvent(EventHandlerPtr h, Args args)
 		}
 	}
 
-bool File::PermitWeird(const char* name, uint64_t threshold, uint64_t rate,
+bool File::PermitWeird(zeek::detail::WeirdID id, uint64_t threshold, uint64_t rate,
                        double duration)
 	{
-	return zeek::detail::PermitWeird(weird_state, name, threshold, rate, duration);
+	return zeek::detail::PermitWeird(weird_state, id, threshold, rate, duration);
 	}
 
 } // namespace zeek::file_analysis
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <list>
+#include <map>
 #include <string>
 #include <utility>
 
@@ -12,6 +13,7 @@
 #include "ZeekList.h" // for ValPList
 #include "ZeekArgs.h"
 #include "WeirdState.h"
+#include "MemoryTag.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(Connection, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(EventHandlerPtr, zeek);
@@ -30,7 +32,7 @@ namespace zeek::file_analysis {
 /**
  * Wrapper class around \c fa_file record values from script layer.
  */
-class File {
+class File : public zeek::detail::MemoryTagged<zeek::detail::MemoryTag::FileAnalysis> {
 public:
 
 	/**
@@ -113,11 +115,11 @@ public:
 	bool IsComplete() const;
 
 	/**
-	 * Create a timer to be dispatched after the amount of time indicated by
-	 * the "timeout_interval" field of the #val record in order to check if
-	 * "last_active" field is old enough to timeout analysis of the file.
+	 * Formerly scheduled a timer checking the file for inactivity. The
+	 * file analysis manager now sweeps all files for that periodically.
 	 */
-	void ScheduleInactivityTimer() const;
+	[[deprecated("Remove in v4.1. Inactivity gets checked by file_analysis::Manager.")]]
+	void ScheduleInactivityTimer() const	{ }
 
 	/**
 	 * Queues attaching an analyzer.  Only one analyzer per type can be attached
@@ -234,7 +236,7 @@ public:
 	 * Whether to permit a weird to carry on through the full reporter/weird
 	 * framework.
 	 */
-	bool PermitWeird(const char* name, uint64_t threshold, uint64_t rate,
+	bool PermitWeird(zeek::detail::WeirdID id, uint64_t threshold, uint64_t rate,
 	                 double duration);
 
 protected:
@@ -334,6 +336,28 @@ protected:
 	 */
 	void DeliverChunk(const u_char* data, uint64_t len, uint64_t offset);
 
+	/**
+	 * Returns whether out-of-order data needs to be reassembled, which is
+	 * the case as long as the BOF buffer isn't full or while an analyzer
+	 * needs stream-wise delivery.
+	 */
+	bool NeedsReassembly();
+
+	/**
+	 * Records data received ahead of the stream offset that doesn't get
+	 * reassembled.
+	 * @param offset the byte offset within the file that the data starts.
+	 * @param len the number of bytes received.
+	 * @return the number of bytes not received before.
+	 */
+	uint64_t AddSparseRange(uint64_t offset, uint64_t len);
+
+	/**
+	 * Advances the stream offset past the ranges recorded by
+	 * AddSparseRange() that it has caught up with.
+	 */
+	void SkipSparseRanges();
+
 	/**
 	 * Lookup a record field index/offset by name.
 	 * @param field_name the name of the record field.
@@ -355,17 +379,25 @@ protected:
 	FileReassembler* file_reassembler; /**< A reassembler for the file if it's needed. */
 	uint64_t stream_offset;      /**< The offset of the file which has been forwarded. */
 	uint64_t reassembly_max_buffer;      /**< Maximum allowed buffer for reassembly. */
+	std::map<uint64_t, uint64_t> sparse_ranges; /**< Start and end offsets of data received ahead of #stream_offset without reassembly. */
 	bool did_metadata_inference;        /**< Whether the metadata inference has already been attempted. */
 	bool reassembly_enabled;           /**< Whether file stream reassembly is needed. */
 	bool postpone_timeout;     /**< Whether postponing timeout is requested. */
 	bool done;                 /**< If this object is about to be deleted. */
+	bool ignored;              /**< If analysis is being ignored until the file's removal. */
+	double last_active;        /**< The "last_active" field last assigned to #val. */
+	File* idle_prev;           /**< Next less recently active file. */
+	File* idle_next;           /**< Next more recently active file. */
 	detail::AnalyzerSet analyzers;     /**< A set of attached file analyzers. */
 	std::list<Analyzer *> done_analyzers; /**< Analyzers we're done with, remembered here until they can be safely deleted. */
 
 	struct BOF_Buffer {
 		BOF_Buffer() : full(false), size(0) {}
 		~BOF_Buffer()
-			{ for ( size_t i = 0; i < chunks.size(); ++i ) delete chunks[i]; }
+			{
+			for ( size_t i = 0; i < chunks.size(); ++i ) delete chunks[i];
+			zeek::detail::memory_tag_free(zeek::detail::MemoryTag::FileAnalysis, size);
+			}
 
 		bool full;
 		uint64_t size;
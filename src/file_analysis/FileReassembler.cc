@@ -2,6 +2,7 @@
 
 #include "FileReassembler.h"
 #include "File.h"
+#include "Reporter.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(File, zeek, file_analysis);
 
@@ -107,6 +108,13 @@ void FileReassembler::Undelivered(uint64_t up_to_seq)
 		}
 	}
 
+void FileReassembler::Evict()
+	{
+	reporter->Weird(the_file, "reassembly_memory_budget_exceeded");
+	Flush();
+	ClearOldBlocks();
+	}
+
 void FileReassembler::Overlap(const u_char* b1, const u_char* b2, uint64_t n)
 	{
 	// Not doing anything here yet.
@@ -2,13 +2,12 @@
 
 #pragma once
 
-#include <string>
 #include "Timer.h"
 
 namespace zeek::file_analysis::detail {
 
 /**
- * Timer to periodically check if file analysis for a given file is inactive.
+ * Timer to periodically sweep the files for inactive ones.
  */
 class FileTimer final : public zeek::detail::Timer {
 public:
@@ -16,21 +15,17 @@ public:
 	/**
 	 * Constructor, nothing interesting about it.
 	 * @param t unix time at which the timer should start ticking.
-	 * @param id the file identifier which will be checked for inactivity.
-	 * @param interval amount of time after \a t to check for inactivity.
+	 * @param interval amount of time after \a t to sweep.
 	 */
-	FileTimer(double t, const std::string& id, double interval);
+	FileTimer(double t, double interval);
 
 	/**
-	 * Check inactivity of file_analysis::File corresponding to #file_id,
-	 * reschedule if active, else call file_analysis::Manager::Timeout.
+	 * Time out the files that have been inactive for too long through
+	 * file_analysis::Manager::SweepInactive.
 	 * @param t current unix time
 	 * @param is_expire true if all pending timers are being expired.
 	 */
 	void Dispatch(double t, bool is_expire) override;
-
-private:
-	std::string file_id;
 };
 
 } // namespace zeek::file_analysis::detail
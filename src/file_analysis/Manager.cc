@@ -11,6 +11,8 @@
 #include "analyzer/Manager.h"
 #include "file_analysis/file_analysis.bif.h"
 
+#include <algorithm>
+
 #include <openssl/md5.h>
 
 using namespace std;
@@ -59,6 +61,9 @@ void Manager::Terminate()
 	for ( const auto& entry : id_map )
 		keys.push_back(entry.first);
 
+	// Time out files in a well-defined order.
+	std::sort(keys.begin(), keys.end());
+
 	for ( const string& key : keys )
 		Timeout(key, true);
 
@@ -88,7 +93,13 @@ void Manager::SetHandle(const string& handle)
 		}
 #endif
 
-	current_file_id = HashHandle(handle);
+	if ( handle != last_handle )
+		{
+		last_handle = handle;
+		last_handle_id = HashHandle(handle);
+		}
+
+	current_file_id = last_handle_id;
 	}
 
 string Manager::DataIn(const u_char* data, uint64_t len, uint64_t offset,
@@ -311,11 +322,11 @@ File* Manager::GetFile(const string& file_id, Connection* conn,
 	if ( file_id.empty() )
 		return nullptr;
 
-	if ( IsIgnored(file_id) )
-		return nullptr;
-
 	File* rval = LookupFile(file_id);
 
+	if ( rval && rval->ignored )
+		return nullptr;
+
 	if ( ! rval )
 		{
 		rval = new File(file_id,
@@ -328,7 +339,7 @@ File* Manager::GetFile(const string& file_id, Connection* conn,
 		if ( id_map.size() > max_files )
 			max_files = id_map.size();
 
-		rval->ScheduleInactivityTimer();
+		NoteTimeoutInterval(rval->GetTimeoutInterval());
 
 		// Generate file_new after inserting it into manager's mapping
 		// in case script-layer calls back in to core from the event.
@@ -336,7 +347,7 @@ File* Manager::GetFile(const string& file_id, Connection* conn,
 		// Same for file_over_new_connection.
 		rval->RaiseFileOverNewConnection(conn, is_orig);
 
-		if ( IsIgnored(file_id) )
+		if ( rval->ignored )
 			return nullptr;
 		}
 	else
@@ -375,7 +386,6 @@ void Manager::Timeout(const string& file_id, bool is_terminating)
 		DBG_LOG(DBG_FILE_ANALYSIS, "Postpone file analysis timeout for %s",
 		        file->GetID().c_str());
 		file->UpdateLastActivityTime();
-		file->ScheduleInactivityTimer();
 		return;
 		}
 
@@ -387,12 +397,14 @@ void Manager::Timeout(const string& file_id, bool is_terminating)
 
 bool Manager::IgnoreFile(const string& file_id)
 	{
-	if ( ! LookupFile(file_id) )
+	File* f = LookupFile(file_id);
+
+	if ( ! f )
 		return false;
 
 	DBG_LOG(DBG_FILE_ANALYSIS, "Ignore FileID %s", file_id.c_str());
 
-	ignored.insert(file_id);
+	f->ignored = true;
 	return true;
 	}
 
@@ -411,14 +423,111 @@ bool Manager::RemoveFile(const string& file_id)
 	f->EndOfFile();
 
 	id_map.erase(file_id);
-	ignored.erase(file_id);
+	UnmarkActive(f);
 	delete f;
 	return true;
 	}
 
+void Manager::MarkActive(File* f)
+	{
+	if ( f == most_active )
+		return;
+
+	UnmarkActive(f);
+
+	f->idle_prev = most_active;
+
+	if ( most_active )
+		most_active->idle_next = f;
+	else
+		least_active = f;
+
+	most_active = f;
+	ScheduleSweep();
+	}
+
+void Manager::UnmarkActive(File* f)
+	{
+	if ( f->idle_prev )
+		f->idle_prev->idle_next = f->idle_next;
+	else if ( least_active == f )
+		least_active = f->idle_next;
+	else
+		// Not in the list.
+		return;
+
+	if ( f->idle_next )
+		f->idle_next->idle_prev = f->idle_prev;
+	else
+		most_active = f->idle_prev;
+
+	f->idle_prev = f->idle_next = nullptr;
+	}
+
+void Manager::NoteTimeoutInterval(double interval)
+	{
+	if ( min_timeout_interval < 0 || interval < min_timeout_interval )
+		min_timeout_interval = interval;
+	}
+
+void Manager::SweepInactive(double t, bool is_expire)
+	{
+	sweep_scheduled = false;
+
+	// Evaluating the timeout policy raises file_timeout, whose handlers
+	// may remove or touch any file, so collect the candidates first.
+	std::vector<std::string> timed_out;
+	File* last = most_active;
+
+	for ( File* f = least_active; f; )
+		{
+		File* next = f->idle_next;
+		double inactive_time = t > f->last_active ? t - f->last_active : 0.0;
+
+		if ( f->last_active == 0.0 )
+			// Was created when network_time was zero, so start counting
+			// with a valid time.
+			f->UpdateLastActivityTime();
+
+		// All files from here on have been active more recently than
+		// any timeout interval would allow for.
+		else if ( inactive_time < min_timeout_interval )
+			break;
+
+		else if ( inactive_time >= f->GetTimeoutInterval() )
+			timed_out.push_back(f->GetID());
+
+		if ( f == last )
+			break;
+
+		f = next;
+		}
+
+	DBG_LOG(DBG_FILE_ANALYSIS, "Inactivity sweep found %zu file(s) to time out",
+	        timed_out.size());
+
+	for ( const auto& id : timed_out )
+		Timeout(id);
+
+	if ( ! is_expire && least_active )
+		ScheduleSweep();
+	}
+
+void Manager::ScheduleSweep()
+	{
+	if ( sweep_scheduled || run_state::terminating )
+		return;
+
+	static auto sweep_interval = id::find_val("file_timeout_sweep_interval")->AsInterval();
+	sweep_scheduled = true;
+	zeek::detail::timer_mgr->Add(new detail::FileTimer(run_state::network_time,
+	                                                   sweep_interval));
+	}
+
 bool Manager::IsIgnored(const string& file_id)
 	{
-	return ignored.find(file_id) != ignored.end();
+	File* f = LookupFile(file_id);
+	return f && f->ignored;
 	}
 
 string Manager::GetFileID(const analyzer::Tag& tag, Connection* c, bool is_orig)
@@ -5,6 +5,7 @@
 #include <string>
 #include <set>
 #include <map>
+#include <unordered_map>
 
 #include "Component.h"
 #include "RunState.h"
@@ -349,8 +350,44 @@ public:
 		{ return cumulative_files; }
 
 protected:
+	friend class File;
 	friend class detail::FileTimer;
 
+	/**
+	 * Moves a file to the end of the list of files ordered by their last
+	 * activity, making sure that the next sweep for inactive files is
+	 * scheduled.
+	 * @param f the file that just saw activity.
+	 */
+	void MarkActive(File* f);
+
+	/**
+	 * Takes a file off the list of files ordered by their last activity.
+	 * @param f the file that's going away.
+	 */
+	void UnmarkActive(File* f);
+
+	/**
+	 * Notes a timeout interval in use, so that sweeps know how far into
+	 * the list of files ordered by their last activity they need to look.
+	 * @param interval a file's timeout interval.
+	 */
+	void NoteTimeoutInterval(double interval);
+
+	/**
+	 * Evaluates the timeout policy for all files that have been inactive
+	 * for longer than their timeout interval, starting with the least
+	 * recently active ones, and schedules the next sweep.
+	 * @param t the current time.
+	 * @param is_expire true if all pending timers are being expired.
+	 */
+	void SweepInactive(double t, bool is_expire);
+
+	/**
+	 * Schedules the next sweep for inactive files, unless already pending.
+	 */
+	void ScheduleSweep();
+
 	/**
 	 * Create a new file to be analyzed or retrieve an existing one.
 	 * @param file_id the file identifier/hash.
@@ -419,9 +456,10 @@ private:
 
 	TagSet* LookupMIMEType(const std::string& mtype, bool add_if_not_found);
 
-	std::map<std::string, File*> id_map;  /**< Map file ID to file_analysis::File records. */
-	std::set<std::string> ignored; /**< Ignored files.  Will be finally removed on EOF. */
+	std::unordered_map<std::string, File*> id_map;  /**< Map file ID to file_analysis::File records. */
 	std::string current_file_id;	/**< Hash of what get_file_handle event sets. */
+	std::string last_handle;	/**< The handle last set, usually the same for all chunks of a file. */
+	std::string last_handle_id;	/**< Hash of #last_handle. */
 	zeek::detail::RuleFileMagicState* magic_state;	/**< File magic signature match state. */
 	MIMEMap mime_types;/**< Mapping of MIME types to analyzers. */
 
@@ -430,6 +468,11 @@ private:
 
 	size_t cumulative_files;
 	size_t max_files;
+
+	File* least_active = nullptr;	/**< Head of the list of files ordered by last activity. */
+	File* most_active = nullptr;	/**< Tail of that list. */
+	double min_timeout_interval = -1.0;	/**< Shortest timeout interval noted, if any. */
+	bool sweep_scheduled = false;	/**< Whether a FileTimer is pending. */
 };
 
 /**
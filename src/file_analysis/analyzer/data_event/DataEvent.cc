@@ -22,8 +22,11 @@ DataEvent::DataEvent(RecordValPtr args, file_analysis::File* file,
 file_analysis::Analyzer* DataEvent::Instantiate(RecordValPtr args,
                                                 file_analysis::File* file)
 	{
-	const auto& chunk_val = args->GetField("chunk_event");
-	const auto& stream_val = args->GetField("stream_event");
+	static RecordFieldHandle chunk_field{"Files::AnalyzerArgs", "chunk_event"};
+	static RecordFieldHandle stream_field{"Files::AnalyzerArgs", "stream_event"};
+
+	const auto& chunk_val = args->GetField(chunk_field);
+	const auto& stream_val = args->GetField(stream_field);
 
 	if ( ! chunk_val && ! stream_val ) return nullptr;
 
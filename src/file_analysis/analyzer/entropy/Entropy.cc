@@ -13,7 +13,8 @@ Entropy::Entropy(RecordValPtr args, file_analysis::File* file)
 	: file_analysis::Analyzer(file_mgr->GetComponentTag("ENTROPY"),
 	                          std::move(args), file)
 	{
-	entropy = new EntropyVal;
+	static bool histogram_only = id::find_val("file_entropy_histogram_only")->AsBool();
+	entropy = new EntropyVal(histogram_only);
 	fed = false;
 	}
 
@@ -1,5 +1,6 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <algorithm>
 #include <string>
 #include <fcntl.h>
 
@@ -14,9 +15,22 @@ Extract::Extract(RecordValPtr args, file_analysis::File* file,
                  const std::string& arg_filename, uint64_t arg_limit)
     : file_analysis::Analyzer(file_mgr->GetComponentTag("EXTRACT"),
                               std::move(args), file),
-      filename(arg_filename), limit(arg_limit), depth(0)
+      filename(arg_filename), limit(arg_limit), depth(0),
+      writer(nullptr), limit_reported(false)
 	{
-	fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
+	static bool sparse_files = id::find_val("FileExtract::sparse")->AsBool();
+	sparse = sparse_files;
+
+	// Writing at offsets happens directly, not through the writer thread.
+	if ( ! sparse )
+		writer = ExtractWriter::Get();
+
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+	if ( ! sparse )
+		flags |= O_APPEND;
+
+	fd = open(filename.c_str(), flags, 0666);
 
 	if ( fd < 0 )
 		{
@@ -29,7 +43,18 @@ Extract::Extract(RecordValPtr args, file_analysis::File* file,
 
 Extract::~Extract()
 	{
-	if ( fd )
+	if ( ! fd )
+		return;
+
+	if ( writer )
+		{
+		// Normally already flushed at the end of the file.
+		if ( ! batch.empty() )
+			writer->Write(fd, batch);
+
+		writer->Close(fd);
+		}
+	else
 		util::safe_close(fd);
 	}
 
@@ -88,6 +113,10 @@ bool Extract::DeliverStream(const u_char* data, uint64_t len)
 	if ( ! fd )
 		return false;
 
+	// Everything also arrives through DeliverChunk().
+	if ( sparse )
+		return true;
+
 	uint64_t towrite = 0;
 	bool limit_exceeded = check_limit_exceeded(limit, depth, len, &towrite);
 
@@ -107,24 +136,111 @@ bool Extract::DeliverStream(const u_char* data, uint64_t len)
 
 	if ( towrite > 0 )
 		{
-		util::safe_write(fd, reinterpret_cast<const char*>(data), towrite);
+		if ( ! Write(reinterpret_cast<const char*>(data), towrite) )
+			return false;
+
 		depth += towrite;
 		}
 
 	return ( ! limit_exceeded );
 	}
 
+bool Extract::DeliverChunk(const u_char* data, uint64_t len, uint64_t offset)
+	{
+	if ( ! fd )
+		return false;
+
+	if ( ! sparse )
+		return true;
+
+	uint64_t towrite = 0;
+	bool limit_exceeded = check_limit_exceeded(limit, offset, len, &towrite);
+
+	// Data before the limit may still be outstanding, so keep going, but
+	// raise the event just once.
+	if ( limit_exceeded && ! limit_reported && file_extraction_limit )
+		{
+		limit_reported = true;
+		file_analysis::File* f = GetFile();
+		f->FileEvent(file_extraction_limit, {
+			f->ToVal(),
+			GetArgs(),
+			val_mgr->Count(limit),
+			val_mgr->Count(len)
+		});
+
+		// Limit may have been modified by a BIF, re-check it.
+		limit_exceeded = check_limit_exceeded(limit, offset, len, &towrite);
+		limit_reported = limit_exceeded;
+		}
+
+	if ( towrite > 0 )
+		{
+		util::safe_pwrite(fd, data, towrite, offset);
+		depth = std::max(depth, offset + towrite);
+		}
+
+	return true;
+	}
+
 bool Extract::Undelivered(uint64_t offset, uint64_t len)
 	{
-	if ( depth == offset )
+	// Sparse files leave the holes for gaps.
+	if ( sparse )
+		return true;
+
+	if ( fd && depth == offset )
 		{
-		char* tmp = new char[len]();
-		util::safe_write(fd, tmp, len);
-		delete [] tmp;
+		if ( writer )
+			{
+			batch.append(len, '\0');
+
+			if ( batch.size() >= ExtractWriter::BatchSize() && ! Flush() )
+				return false;
+			}
+		else
+			{
+			char* tmp = new char[len]();
+			util::safe_write(fd, tmp, len);
+			delete [] tmp;
+			}
+
 		depth += len;
 		}
 
 	return true;
 	}
 
+bool Extract::EndOfFile()
+	{
+	return ! fd || Flush();
+	}
+
+bool Extract::Write(const char* data, uint64_t len)
+	{
+	if ( ! writer )
+		return util::safe_write(fd, data, len);
+
+	batch.append(data, len);
+
+	if ( batch.size() < ExtractWriter::BatchSize() )
+		return true;
+
+	return Flush();
+	}
+
+bool Extract::Flush()
+	{
+	if ( batch.empty() || writer->Write(fd, batch) )
+		return true;
+
+	// Rather than holding up packet processing, give up on the file.
+	reporter->Weird(GetFile(), "file_extraction_buffer_full", filename.c_str());
+	batch.clear();
+	batch.shrink_to_fit();
+	writer->Close(fd);
+	fd = 0;
+	return false;
+	}
+
 } // namespace zeek::file_analysis::detail
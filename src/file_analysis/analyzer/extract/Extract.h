@@ -7,6 +7,7 @@
 #include "Val.h"
 #include "File.h"
 #include "Analyzer.h"
+#include "ExtractWriter.h"
 
 #include "analyzer/extract/events.bif.h"
 
@@ -32,14 +33,39 @@ public:
 	 */
 	bool DeliverStream(const u_char* data, uint64_t len) override;
 
+	/**
+	 * Write a chunk of file data to the local extraction file at its
+	 * offset, if extracting into sparse files as configured by
+	 * :zeek:see:`FileExtract::sparse`.
+	 * @param data pointer to a chunk of file data.
+	 * @param len number of bytes in the data chunk.
+	 * @param offset the byte offset within the file of the data chunk.
+	 * @return false if there was no extraction file open, else true.
+	 */
+	bool DeliverChunk(const u_char* data, uint64_t len, uint64_t offset) override;
+
+	/**
+	 * @return false when extracting into sparse files, which doesn't need
+	 *         the file contents in order.
+	 */
+	bool NeedsStream() const override
+		{ return ! sparse; }
+
 	/**
 	 * Report undelivered bytes.
 	 * @param offset distance into the file where the gap occurred.
 	 * @param len number of bytes undelivered.
-	 * @return true
+	 * @return true unless extraction got stopped.
 	 */
 	bool Undelivered(uint64_t offset, uint64_t len) override;
 
+	/**
+	 * Hands what's still batched to the writer thread, if writing through
+	 * that.
+	 * @return false if extraction got stopped, else true.
+	 */
+	bool EndOfFile() override;
+
 	/**
 	 * Create a new instance of an Extract analyzer.
 	 * @param args the \c AnalyzerArgs value which represents the analyzer.
@@ -71,10 +97,29 @@ protected:
 	        const std::string& arg_filename, uint64_t arg_limit);
 
 private:
+	/**
+	 * Appends file contents, batching them up for the writer thread if
+	 * writing through that.
+	 * @return false if the writer thread is too far behind, in which case
+	 *         extraction stops.
+	 */
+	bool Write(const char* data, uint64_t len);
+
+	/**
+	 * Queues the batched contents to the writer thread.
+	 * @return false if the writer thread is too far behind, in which case
+	 *         extraction stops.
+	 */
+	bool Flush();
+
 	std::string filename;
 	int fd;
 	uint64_t limit;
 	uint64_t depth;
+	ExtractWriter* writer;	// Null when writing directly.
+	bool sparse;	// Writing chunks at their offsets.
+	bool limit_reported;	// Only used when sparse.
+	std::string batch;
 };
 
 } // namespace zeek::file_analysis::detail
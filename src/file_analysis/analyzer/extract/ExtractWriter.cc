@@ -0,0 +1,100 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "ExtractWriter.h"
+
+#include "ID.h"
+#include "Val.h"
+#include "util.h"
+
+namespace zeek::file_analysis::detail {
+
+ExtractWriter* ExtractWriter::Get()
+	{
+	static std::unique_ptr<ExtractWriter> writer;
+	static bool initialized = false;
+
+	if ( ! initialized )
+		{
+		initialized = true;
+		auto size = id::find_val("FileExtract::async_buffer_size")->AsCount();
+
+		if ( size > 0 )
+			writer.reset(new ExtractWriter(size));
+		}
+
+	return writer.get();
+	}
+
+ExtractWriter::ExtractWriter(uint64_t arg_max_pending)
+	: max_pending(arg_max_pending), thread(&ExtractWriter::Run, this)
+	{
+	}
+
+ExtractWriter::~ExtractWriter()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+		}
+
+	cv.notify_one();
+	thread.join();
+	}
+
+bool ExtractWriter::Write(int fd, std::string& data)
+	{
+		{
+		std::lock_guard<std::mutex> lock(mtx);
+
+		if ( pending + data.size() > max_pending )
+			return false;
+
+		pending += data.size();
+		queue.push_back({fd, std::move(data)});
+		}
+
+	cv.notify_one();
+	data.clear();
+	return true;
+	}
+
+void ExtractWriter::Close(int fd)
+	{
+		{
+		std::lock_guard<std::mutex> lock(mtx);
+		queue.push_back({fd, {}});
+		}
+
+	cv.notify_one();
+	}
+
+void ExtractWriter::Run()
+	{
+	util::detail::set_thread_name("zk.extract");
+
+	std::unique_lock<std::mutex> lock(mtx);
+
+	while ( true )
+		{
+		cv.wait(lock, [&] { return stopping || ! queue.empty(); });
+
+		// Drain the queue before stopping, so that nothing extracted
+		// gets lost at shutdown.
+		if ( queue.empty() )
+			return;
+
+		auto op = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+
+		if ( op.data.empty() )
+			util::safe_close(op.fd);
+		else
+			util::safe_write(op.fd, op.data.data(), op.data.size());
+
+		lock.lock();
+		pending -= op.data.size();
+		}
+	}
+
+} // namespace zeek::file_analysis::detail
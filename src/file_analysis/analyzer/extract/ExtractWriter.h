@@ -0,0 +1,76 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace zeek::file_analysis::detail {
+
+/**
+ * A thread writing extracted file contents to disk, so that slow storage
+ * doesn't stall the main thread. Writes get queued in order, with the
+ * amount of data in memory bounded by
+ * :zeek:see:`FileExtract::async_buffer_size`. Extractions that would
+ * exceed it are expected to give up rather than wait.
+ */
+class ExtractWriter {
+public:
+	/**
+	 * Returns the writer, starting it if needed, or nullptr if file
+	 * contents get written directly as configured.
+	 */
+	static ExtractWriter* Get();
+
+	/**
+	 * Writes what's still queued and stops the thread.
+	 */
+	~ExtractWriter();
+
+	/**
+	 * Queues data to get appended to a file.
+	 *
+	 * @param fd The file's descriptor.
+	 * @param data The data to write, which gets moved from.
+	 *
+	 * @return false if the data doesn't fit into the buffer, in which
+	 * case it isn't queued.
+	 */
+	bool Write(int fd, std::string& data);
+
+	/**
+	 * Queues closing a file once everything queued before has been
+	 * written to it.
+	 */
+	void Close(int fd);
+
+	/**
+	 * Returns the size of the writes to batch file contents into.
+	 */
+	static constexpr size_t BatchSize()	{ return 64 * 1024; }
+
+private:
+	explicit ExtractWriter(uint64_t max_pending);
+
+	void Run();
+
+	struct Op {
+		int fd;
+		std::string data;	// Empty for closing.
+	};
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<Op> queue;
+	uint64_t pending = 0;	// Bytes queued and not yet written.
+	uint64_t max_pending;
+	bool stopping = false;
+	std::thread thread;
+};
+
+} // namespace zeek::file_analysis::detail
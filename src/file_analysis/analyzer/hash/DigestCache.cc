@@ -0,0 +1,83 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "DigestCache.h"
+
+#include <memory>
+
+#include "ID.h"
+#include "Val.h"
+#include "digest.h"
+
+namespace zeek::file_analysis::detail {
+
+DigestCache* DigestCache::Get()
+	{
+	static std::unique_ptr<DigestCache> cache;
+	static bool initialized = false;
+
+	if ( ! initialized )
+		{
+		initialized = true;
+		auto size = id::find_val("FileHash::dedup_cache_size")->AsCount();
+		auto prefix = id::find_val("FileHash::dedup_prefix_size")->AsCount();
+
+		if ( size > 0 && prefix > 0 )
+			cache.reset(new DigestCache(size, prefix));
+		}
+
+	return cache.get();
+	}
+
+DigestCache::DigestCache(size_t arg_max_entries, uint64_t arg_prefix_size)
+	: max_entries(arg_max_entries), prefix_size(arg_prefix_size)
+	{
+	}
+
+std::string DigestCache::Key(const char* kind, const std::string& prefix,
+                             uint64_t total_bytes)
+	{
+	u_char digest[SHA256_DIGEST_LENGTH];
+	zeek::detail::calculate_digest(zeek::detail::Hash_SHA256,
+	                               reinterpret_cast<const u_char*>(prefix.data()),
+	                               prefix.size(), digest);
+
+	std::string key(kind);
+	key.push_back('\0');
+	key.append(reinterpret_cast<const char*>(digest), sizeof(digest));
+	key.append(reinterpret_cast<const char*>(&total_bytes), sizeof(total_bytes));
+	return key;
+	}
+
+StringValPtr DigestCache::Lookup(const std::string& key)
+	{
+	auto it = index.find(key);
+
+	if ( it == index.end() )
+		return nullptr;
+
+	lru.splice(lru.begin(), lru, it->second);
+	return it->second->second;
+	}
+
+void DigestCache::Insert(const std::string& key, StringValPtr digest)
+	{
+	auto it = index.find(key);
+
+	if ( it != index.end() )
+		{
+		it->second->second = std::move(digest);
+		lru.splice(lru.begin(), lru, it->second);
+		return;
+		}
+
+	if ( lru.size() >= max_entries )
+		{
+		index.erase(lru.back().first);
+		lru.pop_back();
+		}
+
+	lru.emplace_front(key, std::move(digest));
+	index.emplace(key, lru.begin());
+	}
+
+} // namespace zeek::file_analysis::detail
@@ -0,0 +1,70 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "IntrusivePtr.h"
+
+namespace zeek { class StringVal; }
+
+namespace zeek::file_analysis::detail {
+
+/**
+ * Remembers the digests of recently hashed files by a fingerprint of
+ * their beginning and their size, so that a file seen again doesn't need
+ * to be hashed again. The fingerprint doesn't cover the whole file, so a
+ * file that only shares its beginning and size with an earlier one gets
+ * the earlier one's digest: that's the trade-off the cache is for.
+ */
+class DigestCache {
+public:
+	/**
+	 * Returns the cache, or nullptr if it's disabled as configured by
+	 * :zeek:see:`FileHash::dedup_cache_size`.
+	 */
+	static DigestCache* Get();
+
+	/**
+	 * Returns the number of bytes that the fingerprint covers.
+	 */
+	uint64_t PrefixSize() const	{ return prefix_size; }
+
+	/**
+	 * Computes the key for a file.
+	 *
+	 * @param kind The kind of digest.
+	 * @param prefix The file's first PrefixSize() bytes.
+	 * @param total_bytes The file's size.
+	 */
+	static std::string Key(const char* kind, const std::string& prefix,
+	                       uint64_t total_bytes);
+
+	/**
+	 * Returns the digest remembered for a key, or nullptr if none.
+	 */
+	IntrusivePtr<StringVal> Lookup(const std::string& key);
+
+	/**
+	 * Remembers a digest, evicting the least recently used one if the
+	 * cache is full.
+	 */
+	void Insert(const std::string& key, IntrusivePtr<StringVal> digest);
+
+private:
+	DigestCache(size_t max_entries, uint64_t prefix_size);
+
+	using Entry = std::pair<std::string, IntrusivePtr<StringVal>>;
+	using LRU = std::list<Entry>;
+
+	LRU lru;	// Most recently used first.
+	std::unordered_map<std::string, LRU::iterator> index;
+	size_t max_entries;
+	uint64_t prefix_size;
+};
+
+} // namespace zeek::file_analysis::detail
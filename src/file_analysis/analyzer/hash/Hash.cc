@@ -1,25 +1,59 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <algorithm>
 #include <string>
 
 #include "Hash.h"
+#include "DigestCache.h"
 #include "util.h"
 #include "Event.h"
 #include "file_analysis/Manager.h"
 
 namespace zeek::file_analysis::detail {
 
+// The chunk last queued to the hashing threads. The hash analyzers of a
+// file get the same data one after the other, so they can share a copy.
+static struct {
+	std::string file_id;
+	uint64_t offset = 0;
+	const u_char* data = nullptr;
+	HashPool::Chunk chunk;
+} last_chunk;
+
+static HashPool::Chunk share_chunk(const std::string& file_id, uint64_t offset,
+                                   const u_char* data, uint64_t len)
+	{
+	auto& c = last_chunk;
+
+	if ( c.chunk && c.data == data && c.offset == offset &&
+	     c.chunk->size() == len && c.file_id == file_id )
+		return c.chunk;
+
+	c.file_id = file_id;
+	c.offset = offset;
+	c.data = data;
+	c.chunk = std::make_shared<const std::string>(reinterpret_cast<const char*>(data), len);
+	return c.chunk;
+	}
+
 Hash::Hash(RecordValPtr args, file_analysis::File* file,
            HashVal* hv, const char* arg_kind)
 	: file_analysis::Analyzer(file_mgr->GetComponentTag(util::to_upper(arg_kind).c_str()),
 	                                std::move(args), file),
-	  hash(hv), fed(false), kind(arg_kind)
+	  hash(hv), fed(false), kind(arg_kind), offset(0),
+	  dedup(DigestCache::Get() != nullptr), cache_total(0)
 	{
 	hash->Init();
+
+	if ( auto pool = HashPool::Get() )
+		job = pool->NewJob(hash);
 	}
 
 Hash::~Hash()
 	{
+	if ( job )
+		HashPool::Get()->Wait(job, true);
+
 	Unref(hash);
 	}
 
@@ -31,7 +65,24 @@ bool Hash::DeliverStream(const u_char* data, uint64_t len)
 	if ( ! fed )
 		fed = len > 0;
 
-	hash->Feed(data, len);
+	if ( dedup )
+		CheckCache(data, len);
+
+	if ( cached )
+		{
+		offset += len;
+		return true;
+		}
+
+	if ( job )
+		{
+		if ( len > 0 )
+			HashPool::Get()->Submit(job, share_chunk(GetFile()->GetID(), offset, data, len));
+		}
+	else
+		hash->Feed(data, len);
+
+	offset += len;
 	return true;
 	}
 
@@ -46,18 +97,62 @@ bool Hash::Undelivered(uint64_t offset, uint64_t len)
 	return false;
 	}
 
+void Hash::CheckCache(const u_char* data, uint64_t len)
+	{
+	auto cache = DigestCache::Get();
+	auto n = std::min(len, cache->PrefixSize() - prefix.size());
+	prefix.append(reinterpret_cast<const char*>(data), n);
+
+	if ( prefix.size() < cache->PrefixSize() )
+		return;
+
+	dedup = false;
+
+	// Without knowing the size up front, the file can't be told apart
+	// from others starting the same.
+	static RecordFieldHandle total_bytes{"fa_file", "total_bytes"};
+
+	if ( const auto& total = GetFile()->ToVal()->GetField(total_bytes) )
+		{
+		cache_total = total->AsCount();
+		cache_key = DigestCache::Key(kind, prefix, cache_total);
+		cached = cache->Lookup(cache_key);
+
+		// What's queued won't be needed anymore.
+		if ( cached && job )
+			HashPool::Get()->Wait(job, true);
+		}
+
+	prefix.clear();
+	prefix.shrink_to_fit();
+	}
+
 void Hash::Finalize()
 	{
+	if ( job )
+		HashPool::Get()->Wait(job);
+
 	if ( ! hash->IsValid() || ! fed )
 		return;
 
 	if ( ! file_hash )
 		return;
 
+	StringValPtr digest = cached;
+
+	if ( ! digest )
+		{
+		digest = hash->Get();
+
+		// Only remember digests of files seen in full.
+		if ( ! cache_key.empty() && offset == cache_total )
+			DigestCache::Get()->Insert(cache_key, digest);
+		}
+
 	event_mgr.Enqueue(file_hash,
 	                  GetFile()->ToVal(),
 	                  make_intrusive<StringVal>(kind),
-	                  hash->Get()
+	                  std::move(digest)
 	);
 	}
 
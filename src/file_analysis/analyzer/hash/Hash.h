@@ -8,6 +8,7 @@
 #include "OpaqueVal.h"
 #include "File.h"
 #include "Analyzer.h"
+#include "HashPool.h"
 
 #include "events.bif.h"
 
@@ -25,7 +26,9 @@ public:
 	~Hash() override;
 
 	/**
-	 * Incrementally hash next chunk of file contents.
+	 * Incrementally hash next chunk of file contents. With
+	 * :zeek:see:`FileHash::async_threads` set, the chunk only gets queued
+	 * to the hashing threads.
 	 * @param data pointer to start of a chunk of a file data.
 	 * @param len number of bytes in the data chunk.
 	 * @return false if the digest is in an invalid state, else true.
@@ -60,14 +63,30 @@ protected:
 
 	/**
 	 * If some file contents have been seen, finalizes the hash of them and
-	 * raises the "file_hash" event with the results.
+	 * raises the "file_hash" event with the results. Waits for the hashing
+	 * threads to catch up on the file first, if it got queued to them.
 	 */
 	void Finalize();
 
+	/**
+	 * Collects the beginning of the file and once complete, looks for the
+	 * digest in the cache of :zeek:see:`FileHash::dedup_cache_size`.
+	 * @param data pointer to start of a chunk of a file data.
+	 * @param len number of bytes in the data chunk.
+	 */
+	void CheckCache(const u_char* data, uint64_t len);
+
 private:
 	HashVal* hash;
 	bool fed;
 	const char* kind;
+	HashPool::JobPtr job;	// Null when hashing synchronously.
+	uint64_t offset;	// Of the next chunk.
+	bool dedup;	// Still collecting the prefix for the cache.
+	std::string prefix;
+	std::string cache_key;	// Empty if not cacheable.
+	uint64_t cache_total;
+	StringValPtr cached;	// The digest from the cache, if any.
 };
 
 /**
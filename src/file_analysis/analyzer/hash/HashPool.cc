@@ -0,0 +1,138 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "HashPool.h"
+
+#include "ID.h"
+#include "Val.h"
+#include "OpaqueVal.h"
+#include "util.h"
+
+namespace zeek::file_analysis::detail {
+
+HashPool* HashPool::Get()
+	{
+	static std::unique_ptr<HashPool> pool;
+	static bool initialized = false;
+
+	if ( ! initialized )
+		{
+		initialized = true;
+		auto num_threads = id::find_val("FileHash::async_threads")->AsCount();
+		auto max_pending = id::find_val("FileHash::async_max_pending")->AsCount();
+
+		if ( num_threads > 0 )
+			pool.reset(new HashPool(num_threads, max_pending));
+		}
+
+	return pool.get();
+	}
+
+HashPool::HashPool(int num_threads, uint64_t arg_max_pending)
+	: max_pending(arg_max_pending)
+	{
+	for ( int i = 0; i < num_threads; ++i )
+		threads.emplace_back(&HashPool::Run, this);
+	}
+
+HashPool::~HashPool()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+		}
+
+	work_cv.notify_all();
+	done_cv.notify_all();
+
+	for ( auto& t : threads )
+		t.join();
+	}
+
+HashPool::JobPtr HashPool::NewJob(HashVal* hv)
+	{
+	auto job = std::make_shared<Job>();
+	job->hash = hv;
+	return job;
+	}
+
+void HashPool::Submit(const JobPtr& job, Chunk chunk)
+	{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	// Don't let a slow digest fall arbitrarily far behind.
+	done_cv.wait(lock, [&] {
+		return stopping || max_pending == 0 || job->pending_bytes < max_pending;
+		});
+
+	job->pending_bytes += chunk->size();
+	job->pending.emplace_back(std::move(chunk));
+
+	if ( ! job->scheduled )
+		{
+		job->scheduled = true;
+		ready.push_back(job);
+		lock.unlock();
+		work_cv.notify_one();
+		}
+	}
+
+void HashPool::Wait(const JobPtr& job, bool discard)
+	{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	if ( discard )
+		{
+		for ( const auto& c : job->pending )
+			job->pending_bytes -= c->size();
+
+		job->pending.clear();
+		}
+
+	done_cv.wait(lock, [&] { return stopping || ! job->scheduled; });
+	}
+
+void HashPool::Run()
+	{
+	util::detail::set_thread_name("zk.hash");
+
+	std::unique_lock<std::mutex> lock(mtx);
+
+	while ( true )
+		{
+		work_cv.wait(lock, [&] { return stopping || ! ready.empty(); });
+
+		if ( stopping )
+			return;
+
+		auto job = std::move(ready.front());
+		ready.pop_front();
+
+		// The job got discarded while waiting for a thread.
+		if ( job->pending.empty() )
+			{
+			job->scheduled = false;
+			done_cv.notify_all();
+			continue;
+			}
+
+		auto chunk = std::move(job->pending.front());
+		job->pending.pop_front();
+
+		lock.unlock();
+		job->hash->Feed(chunk->data(), chunk->size());
+		lock.lock();
+
+		job->pending_bytes -= chunk->size();
+
+		// Go to the back of the line, so that a large file doesn't
+		// hold up the others.
+		if ( job->pending.empty() )
+			job->scheduled = false;
+		else
+			ready.push_back(std::move(job));
+
+		done_cv.notify_all();
+		}
+	}
+
+} // namespace zeek::file_analysis::detail
@@ -0,0 +1,85 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zeek { class HashVal; }
+
+namespace zeek::file_analysis::detail {
+
+/**
+ * A small pool of threads feeding file contents into hash digests off the
+ * main thread. Each digest gets a job that its chunks get queued to; only
+ * one thread works on a job at a time, so the chunks of a file get hashed
+ * in the order they were submitted. The digest must not be touched by
+ * the main thread while its job has chunks pending, see Wait().
+ */
+class HashPool {
+public:
+	using Chunk = std::shared_ptr<const std::string>;
+
+	struct Job;
+	using JobPtr = std::shared_ptr<Job>;
+
+	/**
+	 * Returns the pool, starting it if needed, or nullptr if hashing
+	 * happens synchronously as configured by
+	 * :zeek:see:`FileHash::async_threads`.
+	 */
+	static HashPool* Get();
+
+	~HashPool();
+
+	/**
+	 * Creates a job that feeds a digest. The caller keeps its reference
+	 * to the digest and has to wait for the job before releasing it.
+	 */
+	JobPtr NewJob(HashVal* hv);
+
+	/**
+	 * Queues a chunk to get fed into a job's digest. Blocks while the
+	 * job is too far behind, as configured by
+	 * :zeek:see:`FileHash::async_max_pending`.
+	 */
+	void Submit(const JobPtr& job, Chunk chunk);
+
+	/**
+	 * Blocks until all the chunks queued to a job have been fed into
+	 * its digest.
+	 *
+	 * @param discard If true, chunks not being worked on yet get dropped
+	 * instead.
+	 */
+	void Wait(const JobPtr& job, bool discard = false);
+
+private:
+	HashPool(int num_threads, uint64_t max_pending);
+
+	void Run();
+
+	std::mutex mtx;
+	std::condition_variable work_cv;	// Signals workers.
+	std::condition_variable done_cv;	// Signals the main thread.
+
+	std::deque<JobPtr> ready;	// Jobs with chunks and no worker.
+	std::vector<std::thread> threads;
+	uint64_t max_pending;
+	bool stopping = false;
+};
+
+struct HashPool::Job {
+	HashVal* hash;
+	std::deque<Chunk> pending;
+	uint64_t pending_bytes = 0;
+	bool scheduled = false;	// Ready or being worked on.
+};
+
+} // namespace zeek::file_analysis::detail
@@ -1,16 +1,49 @@
 #include "PE.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Event.h"
 #include "file_analysis/Manager.h"
+#include "events.bif.h"
 
 namespace zeek::file_analysis::detail {
 
+// Mirrors the limit in pe-file-headers.pac.
+static constexpr uint32_t MAX_DOS_CODE_LENGTH = 4 * 1024 * 1024;
+
+static uint16_t get_le16(const u_char* p)
+	{
+	return p[0] | (p[1] << 8);
+	}
+
+static uint32_t get_le32(const u_char* p)
+	{
+	return get_le16(p) | (uint32_t(get_le16(p + 2)) << 16);
+	}
+
 PE::PE(RecordValPtr args, file_analysis::File* file)
 	: file_analysis::Analyzer(file_mgr->GetComponentTag("PE"),
 	                          std::move(args),
 	                          file)
 	{
-	conn = new binpac::PE::MockConnection(this);
-	interp = new binpac::PE::File(conn);
+	static bool section_table_only = id::find_val("PE::section_table_only")->AsBool();
+
+	if ( section_table_only )
+		{
+		conn = nullptr;
+		interp = nullptr;
+		}
+	else
+		{
+		conn = new binpac::PE::MockConnection(this);
+		interp = new binpac::PE::File(conn);
+		}
+
 	done = false;
+	state = DOS_HEADER;
+	skip = 0;
+	sections_left = 0;
 	}
 
 PE::~PE()
@@ -21,6 +54,9 @@ PE::~PE()
 
 bool PE::DeliverStream(const u_char* data, uint64_t len)
 	{
+	if ( ! interp )
+		return DeliverSectionTable(data, len);
+
 	if ( conn->is_done() )
 		return false;
 
@@ -36,6 +72,108 @@ bool PE::DeliverStream(const u_char* data, uint64_t len)
 	return ! conn->is_done();
 	}
 
+bool PE::DeliverSectionTable(const u_char* data, uint64_t len)
+	{
+	while ( ! done && len > 0 )
+		{
+		if ( skip > 0 )
+			{
+			auto n = std::min(skip, len);
+			data += n;
+			len -= n;
+			skip -= n;
+			continue;
+			}
+
+		size_t needed = state == DOS_HEADER ? 64 : state == NT_HEADERS ? 24 : 40;
+		auto n = std::min(uint64_t(needed - header.size()), len);
+		header.append(reinterpret_cast<const char*>(data), n);
+		data += n;
+		len -= n;
+
+		if ( header.size() < needed )
+			break;
+
+		done = ! ProcessHeader();
+		header.clear();
+		}
+
+	return ! done;
+	}
+
+bool PE::ProcessHeader()
+	{
+	auto h = reinterpret_cast<const u_char*>(header.data());
+
+	switch ( state ) {
+	case DOS_HEADER:
+		{
+		auto new_exe_header = get_le32(h + 60);
+
+		if ( new_exe_header < 64 || new_exe_header - 64 >= MAX_DOS_CODE_LENGTH )
+			return false;
+
+		skip = new_exe_header - 64;
+		state = NT_HEADERS;
+		return true;
+		}
+
+	case NT_HEADERS:
+		{
+		// Skip the "PE\0\0" signature.
+		h += 4;
+
+		if ( pe_file_header )
+			{
+			auto fh = make_intrusive<RecordVal>(BifType::Record::PE::FileHeader);
+			fh->Assign(0, val_mgr->Count(get_le16(h)));
+			fh->Assign(1, make_intrusive<TimeVal>(static_cast<double>(get_le32(h + 4))));
+			fh->Assign(2, val_mgr->Count(get_le32(h + 8)));
+			fh->Assign(3, val_mgr->Count(get_le32(h + 12)));
+			fh->Assign(4, val_mgr->Count(get_le16(h + 16)));
+			fh->Assign(5, binpac::PE::characteristics_to_zeek(get_le16(h + 18), 16));
+
+			event_mgr.Enqueue(pe_file_header, GetFile()->ToVal(), std::move(fh));
+			}
+
+		// Skip the optional header.
+		skip = get_le16(h + 16);
+		sections_left = get_le16(h + 2);
+		state = SECTION_HEADER;
+		return sections_left > 0;
+		}
+
+	case SECTION_HEADER:
+		{
+		if ( pe_section_header )
+			{
+			auto sh = make_intrusive<RecordVal>(BifType::Record::PE::SectionHeader);
+
+			// Strip null characters from the end of the section name.
+			auto first_null = static_cast<const u_char*>(memchr(h, 0, 8));
+			auto name_len = first_null ? first_null - h : 8;
+			sh->Assign(0, make_intrusive<StringVal>(name_len, reinterpret_cast<const char*>(h)));
+
+			sh->Assign(1, val_mgr->Count(get_le32(h + 8)));
+			sh->Assign(2, val_mgr->Count(get_le32(h + 12)));
+			sh->Assign(3, val_mgr->Count(get_le32(h + 16)));
+			sh->Assign(4, val_mgr->Count(get_le32(h + 20)));
+			sh->Assign(5, val_mgr->Count(get_le32(h + 24)));
+			sh->Assign(6, val_mgr->Count(get_le32(h + 28)));
+			sh->Assign(7, val_mgr->Count(get_le16(h + 32)));
+			sh->Assign(8, val_mgr->Count(get_le16(h + 34)));
+			sh->Assign(9, binpac::PE::characteristics_to_zeek(get_le32(h + 36), 32));
+
+			event_mgr.Enqueue(pe_section_header, GetFile()->ToVal(), std::move(sh));
+			}
+
+		return --sections_left > 0;
+		}
+	}
+
+	return false;
+	}
+
 bool PE::EndOfFile()
 	{
 	return false;
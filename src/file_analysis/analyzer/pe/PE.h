@@ -25,9 +25,32 @@ public:
 
 protected:
 	PE(RecordValPtr args, file_analysis::File* file);
+
+	/**
+	 * Parses the file header and the section table directly from the
+	 * stream, as configured by :zeek:see:`PE::section_table_only`.
+	 *
+	 * @return false once the section table is done or the file turns
+	 * out not to be parseable.
+	 */
+	bool DeliverSectionTable(const u_char* data, uint64_t len);
+
+	/**
+	 * Processes a header buffered by DeliverSectionTable().
+	 *
+	 * @return false if there's nothing left to parse.
+	 */
+	bool ProcessHeader();
+
 	binpac::PE::File* interp;
 	binpac::PE::MockConnection* conn;
 	bool done;
+
+	// State of DeliverSectionTable().
+	enum { DOS_HEADER, NT_HEADERS, SECTION_HEADER } state;
+	std::string header;	// The part of the current header seen so far.
+	uint64_t skip;	// Bytes to skip before the next header.
+	uint16_t sections_left;
 };
 
 } // namespace zeek::file_analysis::detail
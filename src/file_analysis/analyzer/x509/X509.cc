@@ -1,9 +1,11 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <memory>
 #include <string>
 
 #include "X509.h"
 #include "Event.h"
+#include "ID.h"
 
 #include "events.bif.h"
 #include "types.bif.h"
@@ -42,16 +44,40 @@ bool X509::Undelivered(uint64_t offset, uint64_t len)
 	return false;
 	}
 
+// Returns the cache of parsed certificates, or nullptr if disabled.
+static CertificateParseCache* parse_cache()
+	{
+	static std::unique_ptr<CertificateParseCache> cache;
+	static bool initialized = false;
+
+	if ( ! initialized )
+		{
+		initialized = true;
+		auto size = id::find_val("X509::parse_cache_size")->AsCount();
+
+		if ( size > 0 )
+			cache = std::make_unique<CertificateParseCache>(size);
+		}
+
+	return cache.get();
+	}
+
 bool X509::EndOfFile()
 	{
 	const unsigned char* cert_char = reinterpret_cast<const unsigned char*>(cert_data.data());
-	if ( certificate_cache )
+	auto cache = parse_cache();
+	unsigned char buf[SHA256_DIGEST_LENGTH];
+
+	if ( certificate_cache || cache )
 		{
-		// first step - let's see if the certificate has been cached.
-		unsigned char buf[SHA256_DIGEST_LENGTH];
 		auto ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
 		zeek::detail::hash_update(ctx, cert_char, cert_data.size());
 		zeek::detail::hash_final(ctx, buf);
+		}
+
+	if ( certificate_cache )
+		{
+		// first step - let's see if the certificate has been cached.
 		std::string cert_sha256 = zeek::detail::sha256_digest_print(buf);
 		auto index = make_intrusive<StringVal>(cert_sha256);
 		const auto& entry = certificate_cache->Find(index);
@@ -70,6 +96,21 @@ bool X509::EndOfFile()
 			}
 		}
 
+	std::string digest;
+
+	if ( cache )
+		{
+		// Raise what parsing the certificate raised before, if it has
+		// been seen recently.
+		digest.assign(reinterpret_cast<const char*>(buf), sizeof(buf));
+
+		if ( auto events = cache->Lookup(digest) )
+			{
+			ReplayEvents(*events);
+			return false;
+			}
+		}
+
 	// ok, now we can try to parse the certificate with openssl. Should
 	// be rather straightforward...
 	::X509* ssl_cert = d2i_X509(NULL, &cert_char, cert_data.size());
@@ -81,15 +122,18 @@ bool X509::EndOfFile()
 
 	X509Val* cert_val = new X509Val(ssl_cert); // cert_val takes ownership of ssl_cert
 
+	ParsedEvents events;
+
+	if ( cache )
+		recorded_events = &events;
+
 	// parse basic information into record.
 	auto cert_record = ParseCertificate(cert_val, GetFile());
 
 	// and send the record on to scriptland
 	if ( x509_certificate )
-		event_mgr.Enqueue(x509_certificate,
-		                  GetFile()->ToVal(),
-		                  IntrusivePtr{NewRef{}, cert_val},
-		                  cert_record);
+		EnqueueFileEvent(x509_certificate,
+		                 {IntrusivePtr{NewRef{}, cert_val}, cert_record});
 
 	// after parsing the certificate - parse the extensions...
 
@@ -110,6 +154,12 @@ bool X509::EndOfFile()
 
 	Unref(cert_val); // Same for cert_val
 
+	if ( cache )
+		{
+		recorded_events = nullptr;
+		cache->Insert(digest, std::make_shared<const ParsedEvents>(std::move(events)));
+		}
+
 	return false;
 	}
 
@@ -297,10 +347,7 @@ void X509::ParseBasicConstraints(X509_EXTENSION* ex)
 			if ( constr->pathlen )
 				pBasicConstraint->Assign(1, val_mgr->Count((int32_t) ASN1_INTEGER_get(constr->pathlen)));
 
-			event_mgr.Enqueue(x509_ext_basic_constraints,
-			                  GetFile()->ToVal(),
-			                  std::move(pBasicConstraint)
-			);
+			EnqueueFileEvent(x509_ext_basic_constraints, {std::move(pBasicConstraint)});
 			}
 
 		BASIC_CONSTRAINTS_free(constr);
@@ -438,9 +485,7 @@ void X509::ParseSAN(X509_EXTENSION* ext)
 
 		sanExt->Assign(4, val_mgr->Bool(otherfields));
 
-		event_mgr.Enqueue(x509_ext_subject_alternative_name,
-		                        GetFile()->ToVal(),
-		                        std::move(sanExt));
+		EnqueueFileEvent(x509_ext_subject_alternative_name, {std::move(sanExt)});
 	GENERAL_NAMES_free(altname);
 	}
 
@@ -3,6 +3,9 @@
 #include "X509Common.h"
 #include "x509-extension_pac.h"
 #include "Reporter.h"
+#include "Event.h"
+#include "Val.h"
+#include "file_analysis/File.h"
 
 #include "events.bif.h"
 #include "ocsp_events.bif.h"
@@ -16,6 +19,33 @@
 
 namespace zeek::file_analysis::detail {
 
+std::shared_ptr<const ParsedEvents> CertificateParseCache::Lookup(const std::string& digest)
+	{
+	auto it = index.find(digest);
+
+	if ( it == index.end() )
+		return nullptr;
+
+	lru.splice(lru.begin(), lru, it->second);
+	return it->second->second;
+	}
+
+void CertificateParseCache::Insert(const std::string& digest,
+                                   std::shared_ptr<const ParsedEvents> events)
+	{
+	if ( max_entries == 0 || index.count(digest) )
+		return;
+
+	if ( lru.size() >= max_entries )
+		{
+		index.erase(lru.back().first);
+		lru.pop_back();
+		}
+
+	lru.emplace_front(digest, std::move(events));
+	index.emplace(digest, lru.begin());
+	}
+
 X509Common::X509Common(const file_analysis::Tag& arg_tag,
                        RecordValPtr arg_args,
                        file_analysis::File* arg_file)
@@ -289,11 +319,9 @@ void X509Common::ParseExtension(X509_EXTENSION* ex, const EventHandlerPtr& h, bo
 	// but I am not sure if there is a better way to do it...
 
 	if ( h == ocsp_extension )
-		event_mgr.Enqueue(h, GetFile()->ToVal(),
-		                  std::move(pX509Ext),
-		                  val_mgr->Bool(global));
+		EnqueueFileEvent(h, {std::move(pX509Ext), val_mgr->Bool(global)});
 	else
-		event_mgr.Enqueue(h, GetFile()->ToVal(), std::move(pX509Ext));
+		EnqueueFileEvent(h, {std::move(pX509Ext)});
 
 	// let individual analyzers parse more.
 	ParseExtensionsSpecific(ex, global, ext_asn, oid);
@@ -340,4 +368,30 @@ StringValPtr X509Common::GetExtensionFromBIO(BIO* bio, file_analysis::File* f)
 	return ext_val;
 	}
 
+void X509Common::EnqueueFileEvent(const EventHandlerPtr& h, zeek::Args args)
+	{
+	if ( recorded_events )
+		recorded_events->emplace_back(h, args);
+
+	args.insert(args.begin(), GetFile()->ToVal());
+	event_mgr.Enqueue(h, std::move(args));
+	}
+
+void X509Common::ReplayEvents(const ParsedEvents& events)
+	{
+	for ( const auto& [h, cached_args] : events )
+		{
+		zeek::Args args;
+		args.reserve(cached_args.size() + 1);
+		args.emplace_back(GetFile()->ToVal());
+
+		// Scripts may modify the records they get, so each file gets
+		// its own copies.
+		for ( const auto& a : cached_args )
+			args.emplace_back(a->GetType()->Tag() == TYPE_RECORD ? a->Clone() : a);
+
+		event_mgr.Enqueue(h, std::move(args));
+		}
+	}
+
 } // namespace zeek::file_analysis::detail
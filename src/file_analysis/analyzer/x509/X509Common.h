@@ -6,11 +6,19 @@
 #pragma once
 
 #include "file_analysis/Analyzer.h"
+#include "EventHandler.h"
+#include "ZeekArgs.h"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <openssl/x509.h>
 #include <openssl/asn1.h>
 
-ZEEK_FORWARD_DECLARE_NAMESPACED(EventHandlerPtr, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Reporter, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(StringVal, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(File, zeek, file_analysis);
@@ -23,6 +31,42 @@ using StringValPtr = IntrusivePtr<StringVal>;
 
 namespace zeek::file_analysis::detail {
 
+/**
+ * The events that parsing a certificate raised, without their leading
+ * \c fa_file argument, for raising them again for the same certificate.
+ */
+using ParsedEvents = std::vector<std::pair<EventHandlerPtr, zeek::Args>>;
+
+/**
+ * A bounded cache of the events raised for recently parsed certificates,
+ * keyed by the certificates' SHA256 digests. Least recently used entries
+ * get evicted first.
+ */
+class CertificateParseCache {
+public:
+	explicit CertificateParseCache(size_t arg_max_entries)
+		: max_entries(arg_max_entries)
+		{ }
+
+	/**
+	 * Returns the events of a certificate, or nullptr if it's not cached.
+	 */
+	std::shared_ptr<const ParsedEvents> Lookup(const std::string& digest);
+
+	/**
+	 * Caches the events of a certificate.
+	 */
+	void Insert(const std::string& digest, std::shared_ptr<const ParsedEvents> events);
+
+private:
+	using Entry = std::pair<std::string, std::shared_ptr<const ParsedEvents>>;
+	using LRU = std::list<Entry>;
+
+	LRU lru;	// Most recently used first.
+	std::unordered_map<std::string, LRU::iterator> index;
+	size_t max_entries;
+};
+
 class X509Common : public file_analysis::Analyzer {
 public:
 	~X509Common() override {};
@@ -43,6 +87,17 @@ public:
 	static double GetTimeFromAsn1(const ASN1_TIME* atime, file_analysis::File* f,
 	                              Reporter* reporter);
 
+	/**
+	 * Raises an event about the analyzer's file, which gets prepended to
+	 * the arguments as the event's first one. The event also gets recorded
+	 * if a certificate's events are being collected for caching.
+	 *
+	 * @param h the event to raise.
+	 *
+	 * @param args the arguments following the file.
+	 */
+	void EnqueueFileEvent(const EventHandlerPtr& h, zeek::Args args);
+
 protected:
 	X509Common(const file_analysis::Tag& arg_tag,
 	           RecordValPtr arg_args,
@@ -51,6 +106,15 @@ protected:
 	void ParseExtension(X509_EXTENSION* ex, const EventHandlerPtr& h, bool global);
 	void ParseSignedCertificateTimestamps(X509_EXTENSION* ext);
 	virtual void ParseExtensionsSpecific(X509_EXTENSION* ex, bool, ASN1_OBJECT*, const char*) = 0;
+
+	/**
+	 * Raises the events cached for a certificate again for this
+	 * analyzer's file.
+	 */
+	void ReplayEvents(const ParsedEvents& events);
+
+	// Where EnqueueFileEvent() records events, if anywhere.
+	ParsedEvents* recorded_events = nullptr;
 };
 
 } // namespace zeek::file_analysis
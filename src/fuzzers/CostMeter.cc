@@ -0,0 +1,85 @@
+#include "CostMeter.h"
+
+#include <unistd.h>
+#include <time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace zeek::detail {
+
+CostMeter::CostMeter()
+	{
+#ifdef __linux__
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	// Fails in containers and VMs that don't expose the counters, or
+	// with a restrictive perf_event_paranoid.
+	perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+
+	auto limit = getenv("ZEEK_FUZZ_MAX_COST_PER_BYTE");
+
+	if ( limit )
+		max_cost_per_byte = atof(limit);
+	else if ( CountsInstructions() )
+		max_cost_per_byte = DEFAULT_MAX_INSTRUCTIONS_PER_BYTE;
+	else
+		max_cost_per_byte = DEFAULT_MAX_NS_PER_BYTE;
+	}
+
+CostMeter::~CostMeter()
+	{
+	if ( perf_fd >= 0 )
+		close(perf_fd);
+	}
+
+uint64_t CostMeter::Read() const
+	{
+	if ( perf_fd >= 0 )
+		{
+		uint64_t n;
+
+		if ( read(perf_fd, &n, sizeof(n)) == sizeof(n) )
+			return n;
+		}
+
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	}
+
+void CostMeter::Start()
+	{
+	start = Read();
+	}
+
+uint64_t CostMeter::Stop(size_t size)
+	{
+	auto cost = Read() - start;
+	auto per_byte = static_cast<double>(cost) / (size + BASE_SIZE);
+
+	if ( max_cost_per_byte > 0 && per_byte > max_cost_per_byte )
+		{
+		fprintf(stderr, "input of %zu bytes cost %.0f %s per byte, limit is %.0f\n",
+		        size, per_byte, CountsInstructions() ? "instructions" : "ns",
+		        max_cost_per_byte);
+		abort();
+		}
+
+	return cost;
+	}
+
+} // namespace zeek::detail
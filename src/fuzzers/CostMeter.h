@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace zeek::detail {
+
+/**
+ * Measures what processing a fuzzer input costs, to find inputs that take
+ * disproportionately long rather than ones that crash. The cost is the
+ * number of instructions the calling thread retires where the kernel lets
+ * us count them, and its CPU time in nanoseconds otherwise.
+ *
+ * An input's cost per byte is its cost divided by its size plus
+ * BASE_SIZE, which absorbs what any input costs regardless of its size.
+ * Inputs exceeding the limit get reported and abort the process, so that
+ * fuzzing engines keep them like they keep crashing ones. The limit comes
+ * from the ZEEK_FUZZ_MAX_COST_PER_BYTE environment variable, and defaults
+ * to DEFAULT_MAX_INSTRUCTIONS_PER_BYTE or DEFAULT_MAX_NS_PER_BYTE.
+ */
+class CostMeter {
+public:
+	static constexpr size_t BASE_SIZE = 256;
+	static constexpr double DEFAULT_MAX_INSTRUCTIONS_PER_BYTE = 500000;
+	static constexpr double DEFAULT_MAX_NS_PER_BYTE = 200000;
+
+	CostMeter();
+	~CostMeter();
+
+	/**
+	 * @return  whether the cost is a count of instructions rather than
+	 * CPU time.
+	 */
+	bool CountsInstructions() const
+		{ return perf_fd >= 0; }
+
+	/**
+	 * Starts measuring an input.
+	 */
+	void Start();
+
+	/**
+	 * Stops measuring an input, and aborts if its cost per byte exceeds
+	 * the limit.
+	 * @param size  size of the input.
+	 * @return  the input's cost.
+	 */
+	uint64_t Stop(size_t size);
+
+private:
+	uint64_t Read() const;
+
+	int perf_fd = -1;
+	double max_cost_per_byte;
+	uint64_t start = 0;
+};
+
+} // namespace zeek::detail
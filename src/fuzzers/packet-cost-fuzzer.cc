@@ -0,0 +1,58 @@
+#include "binpac.h"
+
+#include "iosource/Packet.h"
+#include "Event.h"
+#include "packet_analysis/Manager.h"
+
+#include "CostMeter.h"
+#include "FuzzBuffer.h"
+#include "fuzzer-setup.h"
+
+extern "C" {
+#include <pcap.h>
+}
+
+// Runs inputs through the same path as the packet fuzzer, but looks for
+// ones that are expensive to process rather than ones that crash. See
+// CostMeter for how the cost is measured and limited.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+	{
+	static zeek::detail::CostMeter meter;
+
+	zeek::detail::FuzzBuffer fb{data, size};
+
+	if ( ! fb.Valid() )
+		return 0;
+
+	meter.Start();
+
+	for ( ; ;  )
+		{
+		auto chunk = fb.Next();
+
+		if ( ! chunk )
+			break;
+
+		zeek::Packet pkt;
+		auto timestamp = 42;
+		pkt_timeval ts = {timestamp, 0};
+		pkt.Init(DLT_RAW, &ts, chunk->size, chunk->size, chunk->data.get(), false, "");
+
+		try
+			{
+			zeek::packet_mgr->ProcessPacket(&pkt);
+			}
+		catch ( binpac::Exception const &e )
+			{
+			}
+
+		chunk = {};
+		zeek::event_mgr.Drain();
+		}
+
+	// Analyzers may do much of their work only once their connection
+	// goes away, so that's part of the cost.
+	zeek::detail::fuzzer_cleanup_one_input();
+	meter.Stop(size);
+	return 0;
+	}
@@ -1,141 +1,201 @@
-// Modified from tcpdump v4.9.3's in_cksum.c (which itself was a modified
-// version of FreeBSD's in_cksum.c).
-
-/* in_cksum.c
- * 4.4-Lite-2 Internet checksum routine, modified to take a vector of
- * pointers/lengths giving the pieces to be checksummed.  Also using
- * Tahoe/CGI version of ADDCARRY(x) macro instead of from portable version.
- */
-
-/*
- * Copyright (c) 1988, 1992, 1993
- *	The Regents of the University of California.  All rights reserved.
- *
- * Redistribution and use in source and binary forms, with or without
- * modification, are permitted provided that the following conditions
- * are met:
- * 1. Redistributions of source code must retain the above copyright
- *    notice, this list of conditions and the following disclaimer.
- * 2. Redistributions in binary form must reproduce the above copyright
- *    notice, this list of conditions and the following disclaimer in the
- *    documentation and/or other materials provided with the distribution.
- * 3. Neither the name of the University nor the names of its contributors
- *    may be used to endorse or promote products derived from this software
- *    without specific prior written permission.
- *
- * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
- * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
- * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
- * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
- * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
- * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
- * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
- * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
- * SUCH DAMAGE.
- *
- *	@(#)in_cksum.c	8.1 (Berkeley) 6/10/93
- */
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// The Internet checksum (RFC 1071) over a vector of blocks. The one's
+// complement sum doesn't depend on the order in which 16-bit words get
+// added, nor on byte order beyond a final swap, so each block gets summed
+// in host byte order with the widest loads available and the per-block
+// sums get combined afterwards, swapped for blocks starting at an odd
+// offset.
+
+#include "zeek-config.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "net_util.h"
+#include "3rdparty/doctest.h"
 
 namespace zeek::detail {
 
-#define ADDCARRY(x)  {if ((x) > 65535) (x) -= 65535;}
-#define REDUCE {l_util.l = sum; sum = l_util.s[0] + l_util.s[1]; ADDCARRY(sum);}
-
-uint16_t in_cksum(const struct checksum_block *vec, int veclen)
-{
-	const uint16_t *w;
-	int sum = 0;
-	int mlen = 0;
-	int byte_swapped = 0;
-
-	union {
-		uint8_t		c[2];
-		uint16_t	s;
-	} s_util;
-	union {
-		uint16_t	s[2];
-		uint32_t	l;
-	} l_util;
-
-	for (; veclen != 0; vec++, veclen--) {
-		if (vec->len == 0)
-			continue;
-		w = (const uint16_t *)(const void *)vec->block;
-		if (mlen == -1) {
-			/*
-			 * The first byte of this chunk is the continuation
-			 * of a word spanning between this chunk and the
-			 * last chunk.
-			 *
-			 * s_util.c[0] is already saved when scanning previous
-			 * chunk.
-			 */
-			s_util.c[1] = *(const uint8_t *)w;
-			sum += s_util.s;
-			w = (const uint16_t *)(const void *)((const uint8_t *)w + 1);
-			mlen = vec->len - 1;
-		} else
-			mlen = vec->len;
-		/*
-		 * Force to even boundary.
-		 */
-		if ((1 & (uintptr_t) w) && (mlen > 0)) {
-			REDUCE;
-			sum <<= 8;
-			s_util.c[0] = *(const uint8_t *)w;
-			w = (const uint16_t *)(const void *)((const uint8_t *)w + 1);
-			mlen--;
-			byte_swapped = 1;
+static inline uint16_t fold(uint64_t sum)
+	{
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return static_cast<uint16_t>(sum);
+	}
+
+// Returns the sum of a block's 16-bit words in host byte order, not yet
+// folded. A trailing odd byte counts as the first byte of a zero-padded
+// word.
+static uint64_t sum_block(const uint8_t* p, int len)
+	{
+	uint64_t sum = 0;
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+	// Each 32-bit lane takes two words per iteration, so it can absorb
+	// 2^15 iterations before overflowing. Flush it well before that.
+	constexpr int max_iterations = 1 << 14;
+
+	while ( len >= 16 )
+		{
+		int n = std::min(len / 16, max_iterations);
+
+#if defined(__SSE2__)
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc = _mm_setzero_si128();
+
+		for ( int i = 0; i < n; ++i, p += 16 )
+			{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+			acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+			}
+
+		uint32_t lanes[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+#else
+		uint32x4_t acc = vdupq_n_u32(0);
+
+		for ( int i = 0; i < n; ++i, p += 16 )
+			acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(p)));
+
+		uint32_t lanes[4];
+		vst1q_u32(lanes, acc);
+#endif
+
+		sum += uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		len -= n * 16;
 		}
-		/*
-		 * Unroll the loop to make overhead from
-		 * branches &c small.
-		 */
-		while ((mlen -= 32) >= 0) {
-			sum += w[0]; sum += w[1]; sum += w[2]; sum += w[3];
-			sum += w[4]; sum += w[5]; sum += w[6]; sum += w[7];
-			sum += w[8]; sum += w[9]; sum += w[10]; sum += w[11];
-			sum += w[12]; sum += w[13]; sum += w[14]; sum += w[15];
-			w += 16;
+#endif
+
+	// Summing 32-bit words is equivalent modulo 2^16 - 1, as their two
+	// halves get added up once folded.
+	while ( len >= 8 )
+		{
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+		sum += (w & 0xffffffff) + (w >> 32);
+		p += 8;
+		len -= 8;
+		}
+
+	while ( len >= 2 )
+		{
+		uint16_t w;
+		memcpy(&w, p, sizeof(w));
+		sum += w;
+		p += 2;
+		len -= 2;
 		}
-		mlen += 32;
-		while ((mlen -= 8) >= 0) {
-			sum += w[0]; sum += w[1]; sum += w[2]; sum += w[3];
-			w += 4;
+
+	if ( len == 1 )
+		{
+		uint8_t last[2] = { *p, 0 };
+		uint16_t w;
+		memcpy(&w, last, sizeof(w));
+		sum += w;
 		}
-		mlen += 8;
-		if (mlen == 0 && byte_swapped == 0)
+
+	return sum;
+	}
+
+uint16_t in_cksum(const checksum_block* blocks, int num_blocks)
+	{
+	uint64_t sum = 0;
+	bool odd = false;
+
+	for ( int i = 0; i < num_blocks; ++i )
+		{
+		const auto& b = blocks[i];
+
+		if ( b.len <= 0 )
 			continue;
-		REDUCE;
-		while ((mlen -= 2) >= 0) {
-			sum += *w++;
+
+		uint16_t s = fold(sum_block(b.block, b.len));
+
+		// A block continuing at an odd offset has its bytes in the
+		// opposite halves of the words they actually belong to.
+		if ( odd )
+			s = static_cast<uint16_t>((s >> 8) | (s << 8));
+
+		sum += s;
+
+		if ( b.len & 1 )
+			odd = ! odd;
 		}
-		if (byte_swapped) {
-			REDUCE;
-			sum <<= 8;
-			byte_swapped = 0;
-			if (mlen == -1) {
-				s_util.c[1] = *(const uint8_t *)w;
-				sum += s_util.s;
-				mlen = 0;
-			} else
-				mlen = -1;
-		} else if (mlen == -1)
-			s_util.c[0] = *(const uint8_t *)w;
+
+	return fold(sum);
 	}
-	if (mlen == -1) {
-		/* The last mbuf has odd # of bytes. Follow the
-		   standard (the odd byte may be shifted left by 8 bits
-		   or not as determined by endian-ness of the machine) */
-		s_util.c[1] = 0;
-		sum += s_util.s;
+
+// The byte-at-a-time definition, to check the kernels against.
+static uint16_t reference_cksum(const uint8_t* data, int len)
+	{
+	uint32_t sum = 0;
+
+	for ( int i = 0; i < len; i += 2 )
+		{
+		uint8_t w[2] = { data[i], i + 1 < len ? data[i + 1] : uint8_t(0) };
+		uint16_t v;
+		memcpy(&v, w, sizeof(v));
+		sum += v;
+		}
+
+	while ( sum > 0xffff )
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return static_cast<uint16_t>(sum);
+	}
+
+TEST_CASE("in_cksum")
+	{
+	uint8_t buf[1500 + 1];
+	uint32_t x = 0x12345678;
+
+	for ( auto& c : buf )
+		{
+		x = x * 1103515245 + 12345;
+		c = static_cast<uint8_t>(x >> 16);
+		}
+
+	SUBCASE("single blocks")
+		{
+		// Cover all the tail lengths and unaligned starts.
+		for ( int off = 0; off < 2; ++off )
+			for ( int len = 0; len <= 1500; len += (len < 64 ? 1 : 37) )
+				CHECK(in_cksum(buf + off, len) == reference_cksum(buf + off, len));
+		}
+
+	SUBCASE("split blocks")
+		{
+		for ( int split : { 0, 1, 7, 12, 13, 40, 997 } )
+			{
+			checksum_block blocks[3] = {
+				{ buf, split },
+				{ buf + split, 3 },
+				{ buf + split + 3, 1000 - split - 3 },
+				};
+
+			CHECK(in_cksum(blocks, 3) == reference_cksum(buf, 1000));
+			}
+		}
+
+	SUBCASE("all ones")
+		{
+		uint8_t ones[64];
+		memset(ones, 0xff, sizeof(ones));
+		CHECK(in_cksum(ones, sizeof(ones)) == 0xffff);
+
+		uint8_t zeros[64] = { 0 };
+		CHECK(in_cksum(zeros, sizeof(zeros)) == 0);
+		}
 	}
-	REDUCE;
-	return sum;
-}
 
-} // namespace zeek
+} // namespace zeek::detail
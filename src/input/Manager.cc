@@ -704,6 +704,16 @@ bool Manager::CreateTableStream(RecordVal* fval)
 	stream->want_record = ( want_record->InternalInt() == 1 );
 
 	assert(stream->reader);
+
+	if ( fval->GetFieldOrDefault("bulk_load")->AsBool() )
+		{
+		if ( stream->pred )
+			reporter->Warning("Input stream %s: Bulk loading does not support predicates, loading as usual",
+			                  stream_name.c_str());
+		else
+			stream->reader->EnableBulkLoad(idxfields);
+		}
+
 	stream->reader->Init(fieldsV.size(), fields );
 
 	readers[stream->reader] = stream;
@@ -1412,6 +1422,133 @@ void Manager::EndCurrentSend(ReaderFrontend* reader)
 	SendEndOfData(i);
 	}
 
+void Manager::SendBulk(ReaderFrontend* reader, BulkSend* bulk)
+	{
+	Stream *i = FindStream(reader);
+
+	if ( i == nullptr )
+		{
+		reporter->InternalWarning("Unknown reader %s in SendBulk",
+		                          reader->Name());
+		return;
+		}
+
+	assert(i->stream_type == TABLE_STREAM);
+	TableStream* stream = (TableStream*) i;
+
+	DBG_LOG(DBG_INPUT, "Got bulk send for stream %s: %zu new or changed, %zu removed entries",
+	        i->name.c_str(), bulk->entries.size(), bulk->removed.size());
+
+	for ( auto& e : bulk->entries )
+		{
+		SendBulkEntry(stream, e);
+		Value::delete_value_ptr_array(e.vals, bulk->num_fields);
+		e.vals = nullptr;
+		}
+
+	// In bulk mode, lastDict holds all entries currently in the table.
+	for ( auto idxhash : bulk->removed )
+		{
+		InputHash* ih = stream->lastDict->Lookup(idxhash);
+
+		if ( ! ih )
+			// Didn't make it into the table.
+			continue;
+
+		if ( stream->event )
+			{
+			auto idx = stream->tab->RecreateIndex(*ih->idxkey);
+			assert(idx != nullptr);
+			auto val = stream->tab->FindOrDefault(idx);
+			assert(val != nullptr);
+			int startpos = 0;
+			Val* predidx = ListValToRecordVal(idx.get(), stream->itype, &startpos);
+			auto ev = BifType::Enum::Input::Event->GetEnumVal(BifEnum::Input::EVENT_REMOVED);
+
+			if ( stream->num_val_fields == 0 )
+				SendEvent(stream->event, 3, stream->description->Ref(), ev.release(), predidx);
+			else
+				SendEvent(stream->event, 4, stream->description->Ref(), ev.release(), predidx,
+				          val.release());
+			}
+
+		stream->tab->Remove(*ih->idxkey);
+		delete stream->lastDict->RemoveEntry(idxhash);
+		}
+
+	SendEndOfData(i);
+	}
+
+void Manager::SendBulkEntry(TableStream* stream, const BulkSend::Entry& entry)
+	{
+	const Value* const* vals = entry.vals;
+	int position = stream->num_idx_fields;
+	bool convert_error = false;
+	Val* valval;
+
+	if ( stream->num_val_fields == 0 )
+		valval = nullptr;
+
+	else if ( stream->num_val_fields == 1 && ! stream->want_record )
+		valval = ValueToVal(stream, vals[position], stream->rtype->GetFieldType(0).get(), convert_error);
+
+	else
+		valval = ValueToRecordVal(stream, vals, stream->rtype, &position, convert_error);
+
+	Val* idxval = ValueToIndexVal(stream, stream->num_idx_fields, stream->itype, vals, convert_error);
+
+	if ( convert_error )
+		{
+		Unref(valval);
+		Unref(idxval);
+		return;
+		}
+
+	ValPtr oldval;
+
+	if ( entry.changed && stream->event )
+		oldval = stream->tab->Find({NewRef{}, idxval});
+
+	auto k = stream->tab->MakeHashKey(*idxval);
+
+	if ( ! k )
+		reporter->InternalError("could not hash");
+
+	InputHash* ih = new InputHash();
+	ih->idxkey = new zeek::detail::HashKey(k->Key(), k->Size(), k->Hash());
+	ih->valhash = entry.valhash;
+
+	stream->tab->Assign({AdoptRef{}, idxval}, std::move(k), {AdoptRef{}, valval});
+	delete stream->lastDict->Insert(entry.idxhash, ih);
+
+	if ( ! stream->event )
+		return;
+
+	int startpos = 0;
+	Val* predidx = ValueToRecordVal(stream, vals, stream->itype, &startpos, convert_error);
+
+	if ( convert_error )
+		{
+		Unref(predidx);
+		return;
+		}
+
+	if ( oldval )
+		{
+		auto ev = BifType::Enum::Input::Event->GetEnumVal(BifEnum::Input::EVENT_CHANGED);
+		SendEvent(stream->event, 4, stream->description->Ref(), ev.release(), predidx, oldval.release());
+		}
+	else
+		{
+		auto ev = BifType::Enum::Input::Event->GetEnumVal(BifEnum::Input::EVENT_NEW);
+
+		if ( stream->num_val_fields == 0 )
+			SendEvent(stream->event, 3, stream->description->Ref(), ev.release(), predidx);
+		else
+			SendEvent(stream->event, 4, stream->description->Ref(), ev.release(), predidx, valval->Ref());
+		}
+	}
+
 void Manager::SendEndOfData(ReaderFrontend* reader)
 	{
 	Stream *i = FindStream(reader);
@@ -1826,7 +1963,10 @@ void Manager::SendEvent(EventHandlerPtr ev, const int numvals, ...) const
 	va_end(lP);
 
 	if ( ev )
+		{
+		EventMgr::LaneScope lane(EventMgr::LANE_INPUT);
 		event_mgr.Enqueue(ev, std::move(vl), util::detail::SOURCE_LOCAL);
+		}
 	}
 
 void Manager::SendEvent(EventHandlerPtr ev, list<Val*> events) const
@@ -1843,7 +1983,10 @@ void Manager::SendEvent(EventHandlerPtr ev, list<Val*> events) const
 		vl.emplace_back(AdoptRef{}, *i);
 
 	if ( ev )
+		{
+		EventMgr::LaneScope lane(EventMgr::LANE_INPUT);
 		event_mgr.Enqueue(ev, std::move(vl), util::detail::SOURCE_LOCAL);
+		}
 	}
 
 // Convert a bro list value to a bro record value.
@@ -11,6 +11,7 @@
 #include "plugin/ComponentManager.h"
 #include "threading/SerialTypes.h"
 #include "Tag.h"
+#include "ReaderBackend.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(RecordVal, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(ReaderFrontend, zeek, input);
@@ -124,6 +125,8 @@ protected:
 	friend class DisableMessage;
 	friend class EndOfDataMessage;
 	friend class ReaderErrorMessage;
+	friend class BulkSendMessage;
+	friend class ReaderBackend;	// For HashValues().
 
 	// For readers to write to input stream in direct mode (reporting
 	// new/deleted values directly). Functions take ownership of
@@ -141,6 +144,11 @@ protected:
 	void SendEntry(ReaderFrontend* reader, threading::Value* *vals);
 	void EndCurrentSend(ReaderFrontend* reader);
 
+	// For readers loading table streams in bulk: applies the changes
+	// since the previous read and ends the current one. Takes ownership
+	// of the values sent, leaving the rest of the batch to the caller.
+	void SendBulk(ReaderFrontend* reader, BulkSend* bulk);
+
 	// Instantiates a new ReaderBackend of the given type (note that
 	// doing so creates a new thread!).
 	ReaderBackend* CreateBackend(ReaderFrontend* frontend, EnumVal* tag);
@@ -190,6 +198,9 @@ private:
 	// SendEntry implementation for Table stream.
 	int SendEntryTable(Stream* i, const threading::Value* const *vals);
 
+	// SendBulk implementation for a single new or changed entry.
+	void SendBulkEntry(TableStream* stream, const BulkSend::Entry& entry);
+
 	// Put implementation for Table stream.
 	int PutTable(Stream* i, const threading::Value* const *vals);
 
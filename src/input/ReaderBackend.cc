@@ -90,6 +90,24 @@ private:
 	Value* *val;
 };
 
+class BulkSendMessage final : public threading::OutputMessage<ReaderFrontend> {
+public:
+	BulkSendMessage(ReaderFrontend* reader, BulkSend* bulk)
+		: threading::OutputMessage<ReaderFrontend>("BulkSend", reader),
+		bulk(bulk) {}
+
+	~BulkSendMessage() override	{ delete bulk; }
+
+	bool Process() override
+		{
+		input_mgr->SendBulk(Object(), bulk);
+		return true;
+		}
+
+private:
+	BulkSend* bulk;
+};
+
 class EndCurrentSendMessage final : public threading::OutputMessage<ReaderFrontend> {
 public:
 	EndCurrentSendMessage(ReaderFrontend* reader)
@@ -174,6 +192,20 @@ bool ReaderErrorMessage::Process()
 
 using namespace input;
 
+BulkSend::~BulkSend()
+	{
+	for ( auto& e : entries )
+		{
+		if ( e.vals )
+			Value::delete_value_ptr_array(e.vals, num_fields);
+
+		delete e.idxhash;
+		}
+
+	for ( auto k : removed )
+		delete k;
+	}
+
 ReaderBackend::ReaderBackend(ReaderFrontend* arg_frontend) : MsgThread()
 	{
 	disabled = true; // disabled will be set correcty in init.
@@ -187,6 +219,7 @@ ReaderBackend::ReaderBackend(ReaderFrontend* arg_frontend) : MsgThread()
 
 ReaderBackend::~ReaderBackend()
 	{
+	delete bulk_send;
 	delete info;
 	}
 
@@ -202,12 +235,77 @@ void ReaderBackend::Delete(Value* *val)
 
 void ReaderBackend::Clear()
 	{
+	// The table starts over.
+	bulk_known.clear();
+	ForgetRecords();
 	SendOut(new ClearMessage(frontend));
 	}
 
 void ReaderBackend::EndCurrentSend()
 	{
-	SendOut(new EndCurrentSendMessage(frontend));
+	if ( bulk_idx_fields < 0 )
+		{
+		SendOut(new EndCurrentSendMessage(frontend));
+		return;
+		}
+
+	if ( ! bulk_send )
+		bulk_send = new BulkSend;
+
+	// What's left from the previous read is gone.
+	for ( const auto& k : bulk_known )
+		{
+		auto key = new zeek::detail::HashKey(k.first.data(), k.first.size());
+		key->Hash();
+		bulk_send->removed.push_back(key);
+		}
+
+	bulk_known.clear();
+	bulk_known.swap(bulk_current);
+	bulk_records.clear();
+	bulk_records.swap(bulk_current_records);
+	have_pending_record = false;
+	bulk_send->num_fields = num_fields;
+
+	SendOut(new BulkSendMessage(frontend, bulk_send));
+	bulk_send = nullptr;
+	}
+
+void ReaderBackend::EnableBulkLoad(int num_idx_fields)
+	{
+	bulk_idx_fields = num_idx_fields;
+	}
+
+bool ReaderBackend::SkipUnchangedRecord(const void* data, size_t len)
+	{
+	if ( bulk_idx_fields < 0 )
+		return false;
+
+	zeek::detail::KeyedHash::Hash128(data, len, &pending_record.h);
+	have_pending_record = true;
+
+	auto r = bulk_records.find(pending_record);
+
+	if ( r == bulk_records.end() )
+		return false;
+
+	// The entry may have been read already from another record.
+	auto known = bulk_known.extract(r->second);
+
+	if ( ! known )
+		return false;
+
+	bulk_current.insert(std::move(known));
+	bulk_current_records.insert(bulk_records.extract(r));
+	have_pending_record = false;
+	return true;
+	}
+
+void ReaderBackend::ForgetRecords()
+	{
+	bulk_records.clear();
+	bulk_current_records.clear();
+	have_pending_record = false;
 	}
 
 void ReaderBackend::EndOfData()
@@ -217,7 +315,72 @@ void ReaderBackend::EndOfData()
 
 void ReaderBackend::SendEntry(Value* *vals)
 	{
-	SendOut(new SendEntryMessage(frontend, vals));
+	if ( bulk_idx_fields < 0 )
+		{
+		SendOut(new SendEntryMessage(frontend, vals));
+		return;
+		}
+
+	// The manager's hashing only looks at the values, so it's fine to
+	// use from here. Computing the hashes right away spares the main
+	// thread that, too.
+	auto idxhash = input_mgr->HashValues(bulk_idx_fields, vals);
+
+	if ( ! idxhash )
+		{
+		Warning("Could not hash line. Ignoring");
+		have_pending_record = false;
+		Value::delete_value_ptr_array(vals, num_fields);
+		return;
+		}
+
+	zeek::detail::hash_t valhash = 0;
+	int num_val_fields = num_fields - bulk_idx_fields;
+
+	if ( num_val_fields > 0 )
+		{
+		if ( auto valhashkey = input_mgr->HashValues(num_val_fields, vals + bulk_idx_fields) )
+			{
+			valhash = valhashkey->Hash();
+			delete valhashkey;
+			}
+		}
+
+	std::string key(static_cast<const char*>(idxhash->Key()), idxhash->Size());
+
+	if ( have_pending_record )
+		{
+		bulk_current_records[pending_record] = key;
+		have_pending_record = false;
+		}
+
+	bool changed = false;
+	auto known = bulk_known.find(key);
+
+	if ( known != bulk_known.end() )
+		{
+		bool same = (known->second == valhash);
+		bulk_current.emplace(std::move(key), valhash);
+		bulk_known.erase(known);
+
+		if ( same )
+			{
+			// Unchanged, nothing for the main thread to do.
+			Value::delete_value_ptr_array(vals, num_fields);
+			delete idxhash;
+			return;
+			}
+
+		changed = true;
+		}
+	else
+		bulk_current[std::move(key)] = valhash;
+
+	if ( ! bulk_send )
+		bulk_send = new BulkSend;
+
+	idxhash->Hash();
+	bulk_send->entries.push_back({vals, idxhash, valhash, changed});
 	}
 
 bool ReaderBackend::Init(const int arg_num_fields,
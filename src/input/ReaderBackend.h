@@ -2,7 +2,12 @@
 
 #pragma once
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "ZeekString.h"
+#include "Hash.h"
 
 #include "threading/SerialTypes.h"
 #include "threading/MsgThread.h"
@@ -43,6 +48,26 @@ enum ReaderMode {
 	MODE_NONE
 };
 
+/**
+ * The changes to a table stream's contents since the previous complete
+ * read of its source, as a reader thread loading in bulk determined them.
+ * See ReaderBackend::EnableBulkLoad().
+ */
+struct BulkSend {
+	struct Entry {
+		threading::Value** vals;
+		zeek::detail::HashKey* idxhash;	// Of the index values, as hashed by the input manager.
+		zeek::detail::hash_t valhash;	// Of the other values, zero if none.
+		bool changed;	// If false, the entry is new.
+	};
+
+	int num_fields = 0;
+	std::vector<Entry> entries;	// New and changed entries, in the order read.
+	std::vector<zeek::detail::HashKey*> removed;	// Index hashes of the removed ones.
+
+	~BulkSend();
+};
+
 /**
  * Base class for reader implementation. When the input:Manager creates a new
  * input stream, it instantiates a ReaderFrontend. That then in turn creates
@@ -152,6 +177,50 @@ public:
 	 */
 	bool Init(int num_fields, const threading::Field* const* fields);
 
+	/**
+	 * Switches SendEntry() and EndCurrentSend() of a table stream to
+	 * bulk loading: rather than sending each entry to the main thread,
+	 * they hash them right here, compare them to the previous read of the
+	 * source, and send all changes at once when the read ends.
+	 *
+	 * @param num_idx_fields The number of leading fields that form the
+	 * table index.
+	 */
+	void EnableBulkLoad(int num_idx_fields);
+
+	/**
+	 * For readers loading a table in bulk: checks whether a raw record
+	 * of the source, like a line of a file, is the same as one of the
+	 * previous read, so that the reader can skip parsing it. If so, the
+	 * entry that record produced counts as read again. If not, the entry
+	 * passed to SendEntry() next becomes associated with the record.
+	 *
+	 * Readers need to call ForgetRecords() whenever something other than
+	 * a record's own content changes the entry they'd parse from it,
+	 * such as a new header.
+	 *
+	 * @param data The record's raw content.
+	 *
+	 * @param len The length of *data*.
+	 *
+	 * @return True if the reader may skip the record. Always false when
+	 * not loading in bulk.
+	 */
+	bool SkipUnchangedRecord(const void* data, size_t len);
+
+	/**
+	 * Returns true if loading a table in bulk, see EnableBulkLoad().
+	 * Readers can use this to avoid preparing records for
+	 * SkipUnchangedRecord() when it'd skip none anyway.
+	 */
+	bool BulkLoading() const	{ return bulk_idx_fields >= 0; }
+
+	/**
+	 * Forgets the records of the previous read, so that all of the next
+	 * read get parsed again. See SkipUnchangedRecord().
+	 */
+	void ForgetRecords();
+
 	/**
 	 * Force trigger an update of the input stream. The action that will
 	 * be taken depends on the current read mode and the individual input
@@ -362,6 +431,34 @@ private:
 	// this is an internal indicator in case the read is currently in a failed state
 	// it's used to suppress duplicate error messages.
 	bool suppress_warnings = false;
+
+	// Bulk loading state: the index hashes of the entries of the
+	// previous read with the hashes of their values, those seen so far
+	// in the current read, and the changes found.
+	int bulk_idx_fields = -1;	// Negative when not loading in bulk.
+	std::unordered_map<std::string, zeek::detail::hash_t> bulk_known;
+	std::unordered_map<std::string, zeek::detail::hash_t> bulk_current;
+	BulkSend* bulk_send = nullptr;
+
+	// The source's raw records of the previous and the current read,
+	// by a hash of their content, each with the index hash of the entry
+	// it produced.
+	struct RecordHash {
+		zeek::detail::hash128_t h;
+
+		bool operator==(const RecordHash& other) const
+			{ return h[0] == other.h[0] && h[1] == other.h[1]; }
+	};
+
+	struct RecordHashHasher {
+		size_t operator()(const RecordHash& r) const	{ return r.h[0]; }
+	};
+
+	using RecordMap = std::unordered_map<RecordHash, std::string, RecordHashHasher>;
+	RecordMap bulk_records;
+	RecordMap bulk_current_records;
+	RecordHash pending_record;	// Waiting for its entry.
+	bool have_pending_record = false;
 };
 
 } // namespace zeek::input
@@ -24,6 +24,23 @@ private:
 	const threading::Field* const* fields;
 };
 
+class EnableBulkLoadMessage final : public threading::InputMessage<ReaderBackend>
+{
+public:
+	EnableBulkLoadMessage(ReaderBackend* backend, int num_idx_fields)
+		: threading::InputMessage<ReaderBackend>("EnableBulkLoad", backend),
+		num_idx_fields(num_idx_fields) { }
+
+	bool Process() override
+		{
+		Object()->EnableBulkLoad(num_idx_fields);
+		return true;
+		}
+
+private:
+	const int num_idx_fields;
+};
+
 class UpdateMessage final : public threading::InputMessage<ReaderBackend>
 {
 public:
@@ -78,6 +95,14 @@ void ReaderFrontend::Init(const int arg_num_fields,
 	backend->SendIn(new InitMessage(backend, num_fields, fields));
 	}
 
+void ReaderFrontend::EnableBulkLoad(int num_idx_fields)
+	{
+	if ( disabled )
+		return;
+
+	backend->SendIn(new EnableBulkLoadMessage(backend, num_idx_fields));
+	}
+
 void ReaderFrontend::Update()
 	{
 	if ( disabled )
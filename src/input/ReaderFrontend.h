@@ -54,6 +54,14 @@ public:
 	 */
 	void Init(const int arg_num_fields, const threading::Field* const* fields);
 
+	/**
+	 * Has the reader send the entries of table streams in bulk, see
+	 * ReaderBackend::EnableBulkLoad(). Must be called before Init().
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	void EnableBulkLoad(int num_idx_fields);
+
 	/**
 	 * Force an update of the current input source. Actual action depends
 	 * on the opening mode and on the input source.
@@ -1,11 +1,15 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include <sstream>
+#include <cstring>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <arpa/inet.h>
 
 #include "Ascii.h"
 #include "ascii.bif.h"
@@ -53,6 +57,7 @@ Ascii::Ascii(ReaderFrontend *frontend) : ReaderBackend(frontend)
 	ino = 0;
 	fail_on_file_problem = false;
 	fail_on_invalid_lines = false;
+	use_mmap = false;
 	}
 
 Ascii::~Ascii()
@@ -85,6 +90,8 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
 	path_prefix.assign((const char*) BifConst::InputAscii::path_prefix->Bytes(),
 	                   BifConst::InputAscii::path_prefix->Len());
 
+	use_mmap = BifConst::InputAscii::use_mmap;
+
 	// Set per-filter configuration options.
 	for ( ReaderInfo::config_map::const_iterator i = info.config.begin(); i != info.config.end(); i++ )
 		{
@@ -105,6 +112,9 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
 
 		else if ( strcmp(i->first, "fail_on_file_problem") == 0 )
 			fail_on_file_problem = (strncmp(i->second, "T", 1) == 0);
+
+		else if ( strcmp(i->first, "use_mmap") == 0 )
+			use_mmap = (strncmp(i->second, "T", 1) == 0);
 		}
 
 	if ( separator.size() != 1 )
@@ -177,6 +187,10 @@ bool Ascii::ReadHeader(bool useCached)
 			return false;
 			}
 
+		// Other columns parse each line differently.
+		if ( line != headerline )
+			ForgetRecords();
+
 		headerline = line;
 		}
 
@@ -267,6 +281,322 @@ bool Ascii::GetLine(string& str)
 	return false;
 	}
 
+bool Ascii::ReadMapped(bool* ok)
+	{
+	// Continue right after the header, which has been read already.
+	auto offset = file.tellg();
+
+	if ( offset < 0 )
+		// Nothing left after it.
+		return true;
+
+	int fd = open(fname.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		return false;
+
+	struct stat sb;
+
+	if ( fstat(fd, &sb) < 0 )
+		{
+		close(fd);
+		return false;
+		}
+
+	if ( sb.st_size <= offset )
+		{
+		close(fd);
+		return true;
+		}
+
+	size_t size = sb.st_size;
+	void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if ( map == MAP_FAILED )
+		return false;
+
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	const char* p = static_cast<const char*>(map) + offset;
+	const char* end = static_cast<const char*>(map) + size;
+
+	// Same as GetLine(), just without copying the lines.
+	while ( *ok && p < end )
+		{
+		auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		auto eol = nl ? nl : end;
+		std::string_view line(p, eol - p);
+		p = nl ? nl + 1 : end;
+
+		if ( line.empty() )
+			continue;
+
+		if ( line.back() == '\r' )
+			line.remove_suffix(1);
+
+		if ( ! line.empty() && line[0] == '#' )
+			{
+			if ( line.size() > 8 && line.compare(0, 7, "#fields") == 0 && line[7] == separator[0] )
+				line.remove_prefix(8);
+			else
+				continue;
+			}
+
+		*ok = ProcessLine(line);
+		}
+
+	munmap(map, size);
+	return true;
+	}
+
+bool Ascii::ProcessLine(std::string_view line)
+	{
+	// When rereading in bulk, lines seen before need no parsing.
+	if ( SkipUnchangedRecord(line.data(), line.size()) )
+		return true;
+
+	// split on tabs
+	line_fields.clear();
+
+	const char* p = line.data();
+	const char* end = p + line.size();
+
+	while ( p < end )
+		{
+		auto sep = static_cast<const char*>(memchr(p, separator[0], end - p));
+
+		if ( ! sep )
+			{
+			line_fields.emplace_back(p, end - p);
+			break;
+			}
+
+		line_fields.emplace_back(p, sep - p);
+		p = sep + 1;
+		}
+
+	int pos = line_fields.size() - 1; // for easy comparisons of max element.
+	int len = line.size();
+
+	Value** fields = new Value*[NumFields()];
+
+	int fpos = 0;
+	for ( vector<FieldMapping>::iterator fit = columnMap.begin();
+		fit != columnMap.end();
+		fit++ )
+		{
+
+		if ( ! fit->present )
+			{
+			// add non-present field
+			fields[fpos] = new Value((*fit).type, false);
+			fpos++;
+			continue;
+			}
+
+		assert(fit->position >= 0 );
+
+		if ( (*fit).position > pos || (*fit).secondary_position > pos )
+			{
+			FailWarn(fail_on_invalid_lines, Fmt("Not enough fields in line '%.*s' of %s. Found %d fields, want positions %d and %d",
+			                                    len, line.data(), fname.c_str(), pos, (*fit).position, (*fit).secondary_position));
+
+			for ( int i = 0; i < fpos; i++ )
+				delete fields[i];
+
+			delete [] fields;
+
+			return ! fail_on_invalid_lines;
+			}
+
+		Value* val = ParseField(*fit, line_fields[(*fit).position]);
+
+		if ( ! val )
+			{
+			Warning(Fmt("Could not convert line '%.*s' of %s to Val. Ignoring line.", len, line.data(), fname.c_str()));
+
+			// Encountered non-fatal error, ignoring line. But
+			// first, delete all successfully read fields and the
+			// array structure.
+
+			for ( int i = 0; i < fpos; i++ )
+				delete fields[i];
+
+			delete [] fields;
+			return true;
+			}
+
+		if ( (*fit).secondary_position != -1 )
+			{
+			// we have a port definition :)
+			assert(val->type == TYPE_PORT );
+			//	Error(Fmt("Got type %d != PORT with secondary position!", val->type));
+
+			val->val.port_val.proto = formatter->ParseProto(string(line_fields[(*fit).secondary_position]));
+			}
+
+		fields[fpos] = val;
+
+		fpos++;
+		}
+
+	//printf("fpos: %d, second.num_fields: %d\n", fpos, (*it).second.num_fields);
+	assert ( fpos == NumFields() );
+
+	if ( Info().mode == MODE_STREAM )
+		Put(fields);
+	else
+		SendEntry(fields);
+
+	return true;
+	}
+
+// Parses an unsigned decimal number of up to max_digits digits, nothing
+// else around it.
+static bool parse_digits(std::string_view s, size_t max_digits, uint64_t* result)
+	{
+	if ( s.empty() || s.size() > max_digits )
+		return false;
+
+	uint64_t n = 0;
+
+	for ( auto c : s )
+		{
+		if ( c < '0' || c > '9' )
+			return false;
+
+		n = n * 10 + (c - '0');
+		}
+
+	*result = n;
+	return true;
+	}
+
+Value* Ascii::ParseField(const FieldMapping& field, std::string_view s) const
+	{
+	// The common cases of well-formed numbers, ports, and addresses are
+	// parsed right here, without any copies. Anything else, including
+	// all that would need a warning, goes through the formatter.
+	if ( s != unset_field )
+		{
+		uint64_t n;
+		char buf[INET6_ADDRSTRLEN + 1];
+
+		switch ( field.type ) {
+		case TYPE_COUNT:
+			if ( parse_digits(s, 19, &n) )
+				{
+				auto val = new Value(field.type, true);
+				val->val.uint_val = n;
+				return val;
+				}
+			break;
+
+		case TYPE_INT:
+			{
+			bool negative = ! s.empty() && s[0] == '-';
+
+			if ( parse_digits(negative ? s.substr(1) : s, 18, &n) )
+				{
+				auto val = new Value(field.type, true);
+				val->val.int_val = negative ? -static_cast<bro_int_t>(n) : static_cast<bro_int_t>(n);
+				return val;
+				}
+			break;
+			}
+
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			{
+			if ( s.empty() || s.size() >= sizeof(buf) || isspace(s[0]) )
+				break;
+
+			memcpy(buf, s.data(), s.size());
+			buf[s.size()] = '\0';
+
+			char* end;
+			errno = 0;
+			double d = strtod(buf, &end);
+
+			if ( end == buf + s.size() && errno == 0 )
+				{
+				auto val = new Value(field.type, true);
+				val->val.double_val = d;
+				return val;
+				}
+			break;
+			}
+
+		case TYPE_PORT:
+			{
+			auto slash = s.find('/');
+			TransportProto proto = TRANSPORT_UNKNOWN;
+
+			if ( slash != std::string_view::npos )
+				{
+				auto p = s.substr(slash + 1);
+
+				if ( p == "tcp" )
+					proto = TRANSPORT_TCP;
+				else if ( p == "udp" )
+					proto = TRANSPORT_UDP;
+				else if ( p == "icmp" )
+					proto = TRANSPORT_ICMP;
+				else if ( p != "unknown" )
+					break;
+				}
+
+			if ( parse_digits(s.substr(0, slash), 5, &n) && n <= 65535 )
+				{
+				auto val = new Value(field.type, true);
+				val->val.port_val.port = n;
+				val->val.port_val.proto = proto;
+				return val;
+				}
+			break;
+			}
+
+		case TYPE_ADDR:
+			{
+			if ( s.empty() || s.size() >= sizeof(buf) ||
+			     s.find_first_not_of("0123456789abcdefABCDEF.:") != std::string_view::npos )
+				break;
+
+			memcpy(buf, s.data(), s.size());
+			buf[s.size()] = '\0';
+
+			Value::addr_t addr;
+
+			if ( s.find(':') == std::string_view::npos )
+				{
+				addr.family = IPv4;
+
+				if ( inet_aton(buf, &addr.in.in4) <= 0 )
+					break;
+				}
+			else
+				{
+				addr.family = IPv6;
+
+				if ( inet_pton(AF_INET6, buf, addr.in.in6.s6_addr) <= 0 )
+					break;
+				}
+
+			auto val = new Value(field.type, true);
+			val->val.addr_val = addr;
+			return val;
+			}
+
+		default:
+			break;
+		}
+		}
+
+	return formatter->ParseValue(string(s), field.name, field.type, field.subtype);
+	}
+
 // read the entire file and send appropriate thingies back to InputMgr
 bool Ascii::DoUpdate()
 	{
@@ -332,114 +662,21 @@ bool Ascii::DoUpdate()
 
 		}
 
-	string line;
-
-	file.sync();
+	bool ok = true;
 
-	while ( GetLine(line) )
+	if ( ! use_mmap || Info().mode == MODE_STREAM || ! ReadMapped(&ok) )
 		{
-		// split on tabs
-		bool error = false;
-		istringstream splitstream(line);
-
-		map<int, string> stringfields;
-		int pos = 0;
-		while ( splitstream )
-			{
-			string s;
-			if ( ! getline(splitstream, s, separator[0]) )
-				break;
-
-			stringfields[pos] = s;
-			pos++;
-			}
-
-		pos--; // for easy comparisons of max element.
-
-		Value** fields = new Value*[NumFields()];
-
-		int fpos = 0;
-		for ( vector<FieldMapping>::iterator fit = columnMap.begin();
-			fit != columnMap.end();
-			fit++ )
-			{
-
-			if ( ! fit->present )
-				{
-				// add non-present field
-				fields[fpos] = new Value((*fit).type, false);
-				fpos++;
-				continue;
-				}
-
-			assert(fit->position >= 0 );
-
-			if ( (*fit).position > pos || (*fit).secondary_position > pos )
-				{
-				FailWarn(fail_on_invalid_lines, Fmt("Not enough fields in line '%s' of %s. Found %d fields, want positions %d and %d",
-				                                    line.c_str(), fname.c_str(), pos, (*fit).position, (*fit).secondary_position));
-
-				if ( fail_on_invalid_lines )
-					{
-					for ( int i = 0; i < fpos; i++ )
-						delete fields[i];
-
-					delete [] fields;
-
-					return false;
-					}
-				else
-					{
-					error = true;
-					break;
-					}
-				}
+		string line;
 
-			Value* val = formatter->ParseValue(stringfields[(*fit).position], (*fit).name, (*fit).type, (*fit).subtype);
+		file.sync();
 
-			if ( ! val )
-				{
-				Warning(Fmt("Could not convert line '%s' of %s to Val. Ignoring line.", line.c_str(), fname.c_str()));
-				error = true;
-				break;
-				}
-
-			if ( (*fit).secondary_position != -1 )
-				{
-				// we have a port definition :)
-				assert(val->type == TYPE_PORT );
-				//	Error(Fmt("Got type %d != PORT with secondary position!", val->type));
-
-				val->val.port_val.proto = formatter->ParseProto(stringfields[(*fit).secondary_position]);
-				}
-
-			fields[fpos] = val;
-
-			fpos++;
-			}
-
-		if ( error )
-			{
-			// Encountered non-fatal error, ignoring line. But
-			// first, delete all successfully read fields and the
-			// array structure.
-
-			for ( int i = 0; i < fpos; i++ )
-				delete fields[i];
-
-			delete [] fields;
-			continue;
-			}
-
-		//printf("fpos: %d, second.num_fields: %d\n", fpos, (*it).second.num_fields);
-		assert ( fpos == NumFields() );
-
-		if ( Info().mode == MODE_STREAM )
-			Put(fields);
-		else
-			SendEntry(fields);
+		while ( ok && GetLine(line) )
+			ok = ProcessLine(line);
 		}
 
+	if ( ! ok )
+		return false;
+
 	if ( Info().mode != MODE_STREAM )
 		EndCurrentSend();
 
@@ -6,6 +6,7 @@
 #include <vector>
 #include <fstream>
 #include <memory>
+#include <string_view>
 #include <sys/types.h>
 
 #include "input/ReaderBackend.h"
@@ -58,6 +59,19 @@ private:
 	bool GetLine(std::string& str);
 	bool OpenFile();
 
+	// Reads the lines remaining after the header straight out of a
+	// memory mapping of the file. Returns false if the file could not
+	// be mapped, leaving it to the caller to read it normally.
+	bool ReadMapped(bool* ok);
+
+	// Splits a line into fields, converts them, and sends the entry
+	// on. Returns false if that failed fatally.
+	bool ProcessLine(std::string_view line);
+
+	// Converts a field, parsing common types directly from the line
+	// and deferring everything else to the formatter.
+	threading::Value* ParseField(const FieldMapping& field, std::string_view s) const;
+
 	std::ifstream file;
 	time_t mtime;
 	ino_t ino;
@@ -70,6 +84,9 @@ private:
 	// map columns in the file to columns to send back to the manager
 	std::vector<FieldMapping> columnMap;
 
+	// the fields of the line currently being processed, pointing into it
+	std::vector<std::string_view> line_fields;
+
 	// keep a copy of the headerline to determine field locations when stream descriptions change
 	std::string headerline;
 
@@ -81,6 +98,7 @@ private:
 	bool fail_on_invalid_lines;
 	bool fail_on_file_problem;
 	std::string path_prefix;
+	bool use_mmap;
 
 	std::unique_ptr<threading::Formatter> formatter;
 };
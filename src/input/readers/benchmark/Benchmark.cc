@@ -28,6 +28,13 @@ Benchmark::Benchmark(ReaderFrontend *frontend) : ReaderBackend(frontend)
 	timedspread = double(BifConst::InputBenchmark::timedspread);
 	heartbeatstarttime = 0;
 	heartbeat_interval = double(BifConst::Threading::heartbeat_interval);
+	string_length = int(BifConst::InputBenchmark::string_length);
+	max_container_size = BifConst::InputBenchmark::max_container_size;
+	burst_size = int(BifConst::InputBenchmark::burst_size);
+	burst_pause = int(BifConst::InputBenchmark::burst_pause * 1e6);
+	probe_every = int(BifConst::InputBenchmark::probe_every);
+	lines_in_burst = 0;
+	lines_since_probe = 0;
 
 	ascii = new threading::formatter::Ascii(this, threading::formatter::Ascii::SeparatorInfo());
 	}
@@ -98,6 +105,20 @@ bool Benchmark::DoUpdate()
 		else
 			SendEntry(field);
 
+		if ( probe_every != 0 && ++lines_since_probe >= probe_every )
+			{
+			SendProbe();
+			lines_since_probe = 0;
+			}
+
+		if ( burst_size != 0 && ++lines_in_burst >= burst_size )
+			{
+			if ( burst_pause != 0 )
+				usleep(burst_pause);
+
+			lines_in_burst = 0;
+			}
+
 		if ( stopspreadat == 0 || num_lines < stopspreadat )
 			{
 			if ( spread != 0 )
@@ -124,6 +145,20 @@ bool Benchmark::DoUpdate()
 	return true;
 }
 
+void Benchmark::SendProbe()
+	{
+	// The probe queues up behind the lines sent so far, so the script
+	// layer sees it once it has caught up with them.
+	threading::Value** v = new threading::Value*[2];
+	v[0] = new threading::Value(TYPE_STRING, true);
+	v[0]->val.string_val.data = util::copy_string(Info().name);
+	v[0]->val.string_val.length = strlen(Info().name);
+	v[1] = new threading::Value(TYPE_TIME, true);
+	v[1]->val.double_val = CurrTime();
+
+	SendEvent("InputBenchmark::latency_probe", 2, v);
+	}
+
 threading::Value* Benchmark::EntryToVal(TypeTag type, TypeTag subtype)
 	{
 	auto* val = new threading::Value(type, subtype, true);
@@ -136,7 +171,7 @@ threading::Value* Benchmark::EntryToVal(TypeTag type, TypeTag subtype)
 
 	case TYPE_STRING:
 		{
-		std::string rnd = RandomString(10);
+		std::string rnd = RandomString(string_length);
 		val->val.string_val.data = util::copy_string(rnd.c_str());
 		val->val.string_val.length = rnd.size();
 		break;
@@ -187,7 +222,7 @@ threading::Value* Benchmark::EntryToVal(TypeTag type, TypeTag subtype)
 		// Then - common stuff
 		{
 		// how many entries do we have...
-		unsigned int length = random() / (RAND_MAX / 15);
+		unsigned int length = max_container_size ? random() / (RAND_MAX / max_container_size) : 0;
 
 		threading::Value** lvals = new threading::Value* [length];
 
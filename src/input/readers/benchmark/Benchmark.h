@@ -27,6 +27,7 @@ private:
 	double CurrTime();
 	std::string RandomString(const int len);
 	threading::Value* EntryToVal(TypeTag Type, TypeTag subtype);
+	void SendProbe();
 
 	int num_lines;
 	double multiplication_factor;
@@ -38,6 +39,13 @@ private:
 	double heartbeatstarttime;
 	double timedspread;
 	double heartbeat_interval;
+	int string_length;
+	unsigned int max_container_size;
+	int burst_size;
+	int burst_pause;
+	int probe_every;
+	int lines_in_burst;
+	int lines_since_probe;
 
 	threading::formatter::Ascii* ascii;
 };
@@ -26,6 +26,7 @@ void Plugin::InitPreScript()
 
 void Plugin::Done()
 	{
+	pool.Shutdown();
 	}
 
 std::unique_lock<std::mutex> Plugin::ForkMutex()
@@ -7,6 +7,7 @@
 #include "plugin/Plugin.h"
 
 #include "Raw.h"
+#include "ProcessPool.h"
 
 namespace zeek::plugin::detail::Zeek_RawReader {
 
@@ -21,8 +22,11 @@ public:
 
 	std::unique_lock<std::mutex> ForkMutex();
 
+	zeek::input::reader::detail::ProcessPool& Pool()	{ return pool; }
+
 private:
 	std::mutex fork_mutex;
+	zeek::input::reader::detail::ProcessPool pool;
 
 };
 
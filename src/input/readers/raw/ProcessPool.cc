@@ -0,0 +1,186 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "ProcessPool.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+
+#include "Plugin.h"
+#include "util.h"
+
+extern "C" {
+#include "setsignal.h"
+}
+
+namespace zeek::input::reader::detail {
+
+PoolWorker::~PoolWorker()
+	{
+	if ( to_child >= 0 )
+		util::safe_close(to_child);
+
+	if ( from_child >= 0 )
+		util::safe_close(from_child);
+
+	if ( pid > 0 )
+		{
+		// Workers don't keep any state we care about, so there's no need
+		// to wait for them to wind down.
+		kill(-pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+		}
+	}
+
+std::unique_ptr<PoolWorker> ProcessPool::Acquire(const std::string& cmd, size_t max_workers,
+                                                 std::string* error)
+	{
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& c = commands[cmd];
+
+		if ( ! c.idle.empty() )
+			{
+			auto w = std::move(c.idle.back());
+			c.idle.pop_back();
+			return w;
+			}
+
+		if ( shut_down || c.running >= max_workers )
+			return nullptr;
+
+		++c.running;
+		}
+
+	auto w = Start(cmd, error);
+
+	if ( ! w )
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		--commands[cmd].running;
+		}
+
+	return w;
+	}
+
+void ProcessPool::Release(const std::string& cmd, std::unique_ptr<PoolWorker> w, bool reuse)
+	{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& c = commands[cmd];
+
+	if ( reuse && ! shut_down )
+		{
+		c.idle.push_back(std::move(w));
+		return;
+		}
+
+	--c.running;
+	w.reset();
+	}
+
+void ProcessPool::Shutdown()
+	{
+	std::lock_guard<std::mutex> lock(mutex);
+	shut_down = true;
+
+	for ( auto& [cmd, c] : commands )
+		{
+		c.running -= c.idle.size();
+		c.idle.clear();
+		}
+	}
+
+std::unique_ptr<PoolWorker> ProcessPool::Start(const std::string& cmd, std::string* error)
+	{
+	// See Raw::Execute() for why this is serialized.
+	auto lock = plugin::detail::Zeek_RawReader::plugin.ForkMutex();
+	lock.lock();
+
+	int to_child[2];
+	int from_child[2];
+
+	if ( pipe(to_child) != 0 )
+		{
+		*error = util::fmt("could not open pipe: %s", strerror(errno));
+		return nullptr;
+		}
+
+	if ( pipe(from_child) != 0 )
+		{
+		*error = util::fmt("could not open pipe: %s", strerror(errno));
+		close(to_child[0]);
+		close(to_child[1]);
+		return nullptr;
+		}
+
+	pid_t pid = fork();
+
+	if ( pid < 0 )
+		{
+		*error = util::fmt("could not create worker process: %s", strerror(errno));
+
+		for ( int fd : {to_child[0], to_child[1], from_child[0], from_child[1]} )
+			close(fd);
+
+		return nullptr;
+		}
+
+	if ( pid == 0 )
+		{
+		// We are the child.
+		if ( setpgid(0, 0) == -1 )
+			_exit(251);
+
+		if ( dup2(to_child[0], STDIN_FILENO) == -1 ||
+		     dup2(from_child[1], STDOUT_FILENO) == -1 )
+			_exit(252);
+
+		// Workers stay around, so they mustn't hold on to the pipes of
+		// other workers or of the commands that the raw reader runs
+		// directly, which would then never see an EOF.
+		long max_fd = sysconf(_SC_OPEN_MAX);
+
+		for ( long fd = STDERR_FILENO + 1; fd < max_fd; ++fd )
+			close(fd);
+
+		setsignal(SIGPIPE, SIG_DFL);
+		sigset_t mask;
+		sigfillset(&mask);
+		sigprocmask(SIG_UNBLOCK, &mask, 0);
+
+		execl("/bin/sh", "sh", "-c", cmd.c_str(), (char*) NULL);
+		fprintf(stderr, "Exec failed :(......\n");
+		_exit(255);
+		}
+
+	// We are the parent. The child does this as well, so a failure
+	// just means it got there first.
+	setpgid(pid, pid);
+
+	lock.unlock();
+
+	close(to_child[0]);
+	close(from_child[1]);
+
+	auto w = std::make_unique<PoolWorker>();
+	w->pid = pid;
+	w->to_child = to_child[1];
+	w->from_child = from_child[0];
+
+	// The worker's answers get polled for, and no other child should
+	// inherit our ends.
+	if ( fcntl(w->from_child, F_SETFL, O_NONBLOCK) == -1 ||
+	     fcntl(w->to_child, F_SETFD, FD_CLOEXEC) == -1 ||
+	     fcntl(w->from_child, F_SETFD, FD_CLOEXEC) == -1 )
+		{
+		*error = util::fmt("failed to set fd flags: %s", strerror(errno));
+		return nullptr;
+		}
+
+	return w;
+	}
+
+} // namespace zeek::input::reader::detail
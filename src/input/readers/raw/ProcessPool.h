@@ -0,0 +1,84 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace zeek::input::reader::detail {
+
+/**
+ * A worker process of a ProcessPool, along with our ends of its stdin and
+ * stdout.
+ */
+struct PoolWorker {
+	pid_t pid = -1;
+	int to_child = -1;
+	int from_child = -1;
+
+	~PoolWorker();
+};
+
+/**
+ * Keeps worker processes running across raw reader streams, so that
+ * commands run through a pool pay for fork and exec only once per worker
+ * rather than once per stream.
+ *
+ * A worker gets each request on its stdin as the payload's length in
+ * decimal, a newline, and the payload, and has to answer on its stdout
+ * the same way before reading the next request.
+ *
+ * The pool is shared by all reader threads.
+ */
+class ProcessPool {
+public:
+	/**
+	 * Returns an idle worker running the command, and starts a new one
+	 * if less than max_workers of them are running.
+	 *
+	 * @param cmd The command line, run through /bin/sh.
+	 *
+	 * @param max_workers The maximum number of workers for the command.
+	 *
+	 * @param error Set to a description of the problem if starting a
+	 * new worker failed.
+	 *
+	 * @return The worker, or null if all are busy or starting one failed.
+	 */
+	std::unique_ptr<PoolWorker> Acquire(const std::string& cmd, size_t max_workers,
+	                                    std::string* error);
+
+	/**
+	 * Returns a worker obtained from Acquire().
+	 *
+	 * @param reuse If false, the worker gets killed, for example because
+	 * it didn't stick to the framing or its stream went away in the
+	 * middle of a request.
+	 */
+	void Release(const std::string& cmd, std::unique_ptr<PoolWorker> w, bool reuse);
+
+	/**
+	 * Kills all idle workers. Workers released afterwards get killed
+	 * as well.
+	 */
+	void Shutdown();
+
+private:
+	struct Command {
+		std::vector<std::unique_ptr<PoolWorker>> idle;
+		size_t running = 0;
+	};
+
+	std::unique_ptr<PoolWorker> Start(const std::string& cmd, std::string* error);
+
+	std::mutex mutex;
+	std::map<std::string, Command> commands;
+	bool shut_down = false;
+};
+
+} // namespace zeek::input::reader::detail
@@ -9,6 +9,8 @@
 #include <errno.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <poll.h>
+#include <algorithm>
 
 #include "Raw.h"
 #include "Plugin.h"
@@ -27,6 +29,13 @@ namespace zeek::input::reader::detail {
 
 const int Raw::block_size = 4096; // how big do we expect our chunks of data to be.
 
+// How long an update waits for a pool worker's answer. Lookups tend to be
+// quick, and otherwise the next heartbeat picks it up.
+static constexpr int POOL_POLL_MSEC = 200;
+
+// The size of the reads from pool workers.
+static constexpr size_t POOL_READ_SIZE = 64 * 1024;
+
 Raw::Raw(ReaderFrontend *frontend) : ReaderBackend(frontend), file(nullptr, fclose), stderrfile(nullptr, fclose)
 	{
 	execute = false;
@@ -47,6 +56,8 @@ Raw::Raw(ReaderFrontend *frontend) : ReaderBackend(frontend), file(nullptr, fclo
 	stderr_fileno = fileno(stderr);
 
 	childpid = -1;
+	pool_size = 0;
+	answered = false;
 
 	stdin_towrite = 0; // by default do not open stdin
 	use_stderr = false;
@@ -59,6 +70,10 @@ Raw::~Raw()
 
 void Raw::DoClose()
 	{
+	if ( worker )
+		// It may be in the middle of answering.
+		plugin::detail::Zeek_RawReader::plugin.Pool().Release(fname, std::move(worker), false);
+
 	if ( file )
 		CloseInput();
 
@@ -283,6 +298,9 @@ bool Raw::OpenInput()
 			return false;
 			}
 
+		// Fewer, larger reads for rereads and streaming.
+		setvbuf(file.get(), nullptr, _IOFBF, POOL_READ_SIZE);
+
 		if ( ! SetFDFlags(fileno(file.get()), F_SETFD, FD_CLOEXEC) )
 			Warning(Fmt("Init: cannot set close-on-exec for %s", fname.c_str()));
 		}
@@ -377,6 +395,18 @@ bool Raw::DoInit(const ReaderInfo& info, int num_fields, const Field* const* fie
 		forcekill = true;
 		}
 
+	it = info.config.find("pool"); // run the command through persistent workers
+	if ( it != info.config.end() )
+		{
+		pool_size = strtoull(it->second, 0, 10);
+
+		if ( ! execute || Info().mode != MODE_STREAM || pool_size == 0 )
+			{
+			Error("Pool only is supported for executing a command in MODE_STREAM, with at least one worker");
+			return false;
+			}
+		}
+
 	it = info.config.find("offset"); // we want to seek to a given offset inside the file
 	if ( it != info.config.end() && ! execute && (Info().mode == MODE_STREAM ||
 	                                              Info().mode == MODE_MANUAL) )
@@ -417,6 +447,12 @@ bool Raw::DoInit(const ReaderInfo& info, int num_fields, const Field* const* fie
 		}
 
 
+	if ( pool_size )
+		{
+		PoolUpdate();
+		return true;
+		}
+
 	result = OpenInput();
 
 	if ( result == false )
@@ -541,6 +577,9 @@ void Raw::WriteToStdin()
 // read the entire file and send appropriate thingies back to InputMgr
 bool Raw::DoUpdate()
 	{
+	if ( pool_size )
+		return PoolUpdate();
+
 	if ( firstrun )
 		firstrun = false;
 
@@ -677,28 +716,9 @@ bool Raw::DoUpdate()
 		else
 			assert(false);
 
-		Value** vals = new Value*[4];
-		vals[0] = new Value(TYPE_STRING, true);
-		vals[0]->val.string_val.data = util::copy_string(Info().name);
-		vals[0]->val.string_val.length = strlen(Info().name);
-		vals[1] = new Value(TYPE_STRING, true);
-		vals[1]->val.string_val.data = util::copy_string(Info().source);
-		vals[1]->val.string_val.length = strlen(Info().source);
-		vals[2] = new Value(TYPE_COUNT, true);
-		vals[2]->val.int_val = code;
-		vals[3] = new Value(TYPE_BOOL, true);
-		vals[3]->val.int_val = signal;
-
-		// and in this case we can signal end_of_data even for the streaming reader
-		if ( Info().mode == MODE_STREAM )
-			EndCurrentSend();
-
-		SendEvent("InputRaw::process_finished", 4, vals);
-		return false;
+		return ProcessFinished(code, signal);
 		}
 
-
-
 #ifdef DEBUG
 	Debug(DBG_INPUT, "DoUpdate finished successfully");
 #endif
@@ -706,6 +726,195 @@ bool Raw::DoUpdate()
 	return true;
 	}
 
+bool Raw::ProcessFinished(int code, bool signal)
+	{
+	Value** vals = new Value*[4];
+	vals[0] = new Value(TYPE_STRING, true);
+	vals[0]->val.string_val.data = util::copy_string(Info().name);
+	vals[0]->val.string_val.length = strlen(Info().name);
+	vals[1] = new Value(TYPE_STRING, true);
+	vals[1]->val.string_val.data = util::copy_string(Info().source);
+	vals[1]->val.string_val.length = strlen(Info().source);
+	vals[2] = new Value(TYPE_COUNT, true);
+	vals[2]->val.int_val = code;
+	vals[3] = new Value(TYPE_BOOL, true);
+	vals[3]->val.int_val = signal;
+
+	// and in this case we can signal end_of_data even for the streaming reader
+	if ( Info().mode == MODE_STREAM )
+		EndCurrentSend();
+
+	SendEvent("InputRaw::process_finished", 4, vals);
+	return false;
+	}
+
+void Raw::PutRecord(const char* data, int64_t length)
+	{
+	Value** fields = new Value*[2];
+
+	Value* val = new Value(TYPE_STRING, true);
+	val->val.string_val.data = new char[length];
+	memcpy(val->val.string_val.data, data, length);
+	val->val.string_val.length = length;
+	fields[0] = val;
+
+	if ( use_stderr )
+		{
+		// Workers' stderr isn't captured.
+		Value* bval = new Value(TYPE_BOOL, true);
+		bval->val.int_val = 0;
+		fields[1] = bval;
+		}
+
+	Put(fields);
+	}
+
+bool Raw::PoolRequest()
+	{
+	std::string request = std::to_string(stdin_string.size()) + "\n" + stdin_string;
+	const char* data = request.data();
+	size_t len = request.size();
+
+	while ( len > 0 )
+		{
+		auto n = write(worker->to_child, data, len);
+
+		if ( n < 0 )
+			{
+			if ( errno == EINTR )
+				continue;
+
+			char buf[256];
+			util::zeek_strerror_r(errno, buf, sizeof(buf));
+			Error(Fmt("Writing request to worker failed: %s", buf));
+			return false;
+			}
+
+		data += n;
+		len -= n;
+		}
+
+	return true;
+	}
+
+bool Raw::PoolUpdate()
+	{
+	if ( answered )
+		return false;
+
+	auto& pool = plugin::detail::Zeek_RawReader::plugin.Pool();
+
+	if ( ! worker )
+		{
+		std::string error;
+		worker = pool.Acquire(fname, pool_size, &error);
+
+		if ( ! worker )
+			{
+			if ( error.empty() )
+				// All of them are busy, try again with the next update.
+				return true;
+
+			Error(Fmt("Could not start worker for %s: %s", fname.c_str(), error.c_str()));
+			answered = true;
+			return ProcessFinished(1, false);
+			}
+
+		if ( ! PoolRequest() )
+			{
+			pool.Release(fname, std::move(worker), false);
+			answered = true;
+			return ProcessFinished(1, false);
+			}
+
+		response.clear();
+		}
+
+	struct pollfd pfd = {worker->from_child, POLLIN, 0};
+	poll(&pfd, 1, POOL_POLL_MSEC);
+
+	for ( ;; )
+		{
+		auto prev = response.size();
+		response.resize(prev + POOL_READ_SIZE);
+		auto n = read(worker->from_child, &response[prev], POOL_READ_SIZE);
+		response.resize(prev + std::max(n, ssize_t(0)));
+
+		if ( n > 0 )
+			continue;
+
+		if ( n < 0 && errno == EINTR )
+			continue;
+
+		if ( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+			break;
+
+		// The worker went away. Report its exit like for a command that
+		// runs directly.
+		int status = 0;
+		waitpid(worker->pid, &status, 0);
+		worker->pid = -1;
+		pool.Release(fname, std::move(worker), false);
+		answered = true;
+
+		if ( WIFSIGNALED(status) )
+			{
+			Error(Fmt("Worker exited due to signal %d", WTERMSIG(status)));
+			return ProcessFinished(WTERMSIG(status), true);
+			}
+
+		int code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+		Error(Fmt("Worker exited before answering, with return code %d", code));
+		return ProcessFinished(code, false);
+		}
+
+	auto nl = response.find('\n');
+
+	if ( nl == std::string::npos )
+		{
+		if ( response.size() <= 20 )
+			return true;
+		}
+
+	else if ( nl > 0 && nl <= 20 &&
+	          response.find_first_not_of("0123456789") == nl )
+		{
+		auto length = strtoull(response.c_str(), 0, 10);
+		auto start = nl + 1;
+
+		if ( response.size() - start < length )
+			return true;
+
+		if ( response.size() - start == length )
+			{
+			pool.Release(fname, std::move(worker), true);
+			answered = true;
+
+			const char* data = response.data() + start;
+			const char* end = data + length;
+
+			while ( data < end )
+				{
+				auto found = util::strstr_n(end - data, (const u_char*) data,
+				                           sep_length, (const u_char*) separator.c_str());
+
+				if ( found < 0 )
+					found = end - data;
+
+				PutRecord(data, found);
+				data += found + sep_length;
+				}
+
+			return ProcessFinished(0, false);
+			}
+		}
+
+	Error(Fmt("Worker for %s sent a malformed answer", fname.c_str()));
+	pool.Release(fname, std::move(worker), false);
+	answered = true;
+	return ProcessFinished(1, false);
+	}
+
 bool Raw::DoHeartbeat(double network_time, double current_time)
 	{
 	switch ( Info().mode ) {
@@ -8,6 +8,7 @@
 #include <sys/types.h>
 
 #include "input/ReaderBackend.h"
+#include "ProcessPool.h"
 
 namespace zeek::input::reader::detail {
 
@@ -45,6 +46,17 @@ private:
 	bool Execute();
 	void WriteToStdin();
 
+	// Reports the command's end to the script-level, which also ends
+	// the stream. Returns false.
+	bool ProcessFinished(int code, bool signal);
+
+	// DoUpdate() for commands running through the ProcessPool: sends
+	// the request to a worker, and once the answer is complete, passes
+	// it on.
+	bool PoolUpdate();
+	bool PoolRequest();
+	void PutRecord(const char* data, int64_t length);
+
 	std::string fname; // Source with a potential "|" removed.
 	std::unique_ptr<FILE, int(*)(FILE*)> file;
 	std::unique_ptr<FILE, int(*)(FILE*)> stderrfile;
@@ -77,6 +89,13 @@ private:
 	int pipes[6];
 	pid_t childpid;
 
+	// Set if the command runs through the ProcessPool, with at most
+	// that many workers.
+	size_t pool_size;
+	std::unique_ptr<PoolWorker> worker;
+	std::string response;	// What the worker has answered so far.
+	bool answered;
+
 	enum IoChannels {
 		stdout_in = 0,
 		stdout_out = 1,
@@ -248,18 +248,12 @@ Value* SQLite::EntryToVal(sqlite3_stmt *st, const threading::Field *field, int p
 
 	}
 
-bool SQLite::DoUpdate()
+bool SQLite::MapColumns()
 	{
+	// The statement's columns stay the same for every time we run it.
 	int numcolumns = sqlite3_column_count(st);
-	int *mapping = new int [num_fields];
-	int *submapping = new int [num_fields];
-
-	// first set them all to -1
-	for ( unsigned int i = 0; i < num_fields; ++i )
-		{
-		mapping[i] = -1;
-		submapping[i] = -1;
-		}
+	mapping.assign(num_fields, -1);
+	submapping.assign(num_fields, -1);
 
 	for ( int i = 0; i < numcolumns; ++i )
 		{
@@ -272,8 +266,6 @@ bool SQLite::DoUpdate()
 				if ( mapping[j] != -1 )
 					{
 					Error(Fmt("SQLite statement returns several columns with name %s! Cannot decide which to choose, aborting", name));
-					delete [] mapping;
-					delete [] submapping;
 					return false;
 					}
 
@@ -286,8 +278,6 @@ bool SQLite::DoUpdate()
 				if ( submapping[j] != -1 )
 					{
 					Error(Fmt("SQLite statement returns several columns with name %s! Cannot decide which to choose, aborting", name));
-					delete [] mapping;
-					delete [] submapping;
 					return false;
 					}
 
@@ -301,15 +291,78 @@ bool SQLite::DoUpdate()
 		if ( mapping[i] == -1 )
 			{
 			Error(Fmt("Required field %s not found after SQLite statement", fields[i]->name));
-			delete [] mapping;
-			delete [] submapping;
 			return false;
 			}
 		}
 
+	return true;
+	}
+
+bool SQLite::SkipUnchangedRow()
+	{
+	if ( ! BulkLoading() )
+		return false;
+
+	// Collect the row's raw column values for recognizing it when
+	// reading again. These accessors don't convert the values, so the
+	// column types remain as EntryToVal() expects them.
+	row.clear();
+	int numcolumns = sqlite3_column_count(st);
+
+	for ( int i = 0; i < numcolumns; ++i )
+		{
+		int type = sqlite3_column_type(st, i);
+		row.push_back(type);
+
+		switch ( type ) {
+		case SQLITE_INTEGER:
+			{
+			sqlite3_int64 v = sqlite3_column_int64(st, i);
+			row.append(reinterpret_cast<const char*>(&v), sizeof(v));
+			break;
+			}
+
+		case SQLITE_FLOAT:
+			{
+			double v = sqlite3_column_double(st, i);
+			row.append(reinterpret_cast<const char*>(&v), sizeof(v));
+			break;
+			}
+
+		case SQLITE_TEXT:
+		case SQLITE_BLOB:
+			{
+			const void* data = sqlite3_column_blob(st, i);
+			int len = sqlite3_column_bytes(st, i);
+			row.append(reinterpret_cast<const char*>(&len), sizeof(len));
+			row.append(static_cast<const char*>(data), len);
+			break;
+			}
+
+		default:
+			break;
+		}
+		}
+
+	return SkipUnchangedRecord(row.data(), row.size());
+	}
+
+bool SQLite::DoUpdate()
+	{
+	if ( mapping.empty() && ! MapColumns() )
+		{
+		mapping.clear();
+		return false;
+		}
+
+	// Rows come in one at a time from the cursor. When loading in bulk,
+	// ReaderBackend collects them for sending all changes at once.
 	int errorcode;
 	while ( ( errorcode = sqlite3_step(st)) == SQLITE_ROW )
 		{
+		if ( SkipUnchangedRow() )
+			continue;
+
 		Value** ofields = new Value*[num_fields];
 
 		for ( unsigned int j = 0; j < num_fields; ++j)
@@ -321,8 +374,6 @@ bool SQLite::DoUpdate()
 					delete ofields[k];
 
 				delete [] ofields;
-				delete [] mapping;
-				delete [] submapping;
 				return false;
 				}
 			}
@@ -330,9 +381,6 @@ bool SQLite::DoUpdate()
 		SendEntry(ofields);
 		}
 
-	delete [] mapping;
-	delete [] submapping;
-
 	if ( checkError(errorcode) ) // check the last error code returned by sqlite
 		return false;
 
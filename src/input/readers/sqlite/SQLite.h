@@ -29,6 +29,8 @@ protected:
 private:
 	bool checkError(int code);
 
+	bool MapColumns();
+	bool SkipUnchangedRow();
 	threading::Value* EntryToVal(sqlite3_stmt *st, const threading::Field *field, int pos, int subpos);
 
 	const threading::Field* const * fields; // raw mapping
@@ -40,6 +42,12 @@ private:
 	sqlite3_stmt *st;
 	threading::formatter::Ascii* io;
 
+	// The columns of the query's result that fields come from.
+	std::vector<int> mapping;
+	std::vector<int> submapping;	// For the protocol of ports.
+
+	std::string row;	// Raw content of the current row for bulk loading.
+
 	std::string set_separator;
 	std::string unset_field;
 	std::string empty_field;
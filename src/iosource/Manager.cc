@@ -1,7 +1,13 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include "zeek-config.h"
+
 #include <sys/types.h>
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#else
 #include <sys/event.h>
+#endif
 #include <sys/time.h>
 #include <unistd.h>
 #include <assert.h>
@@ -46,9 +52,15 @@ void Manager::WakeupHandler::Ping(const std::string& where)
 
 Manager::Manager()
 	{
+#ifdef HAVE_EPOLL
+	event_queue = epoll_create1(EPOLL_CLOEXEC);
+	if ( event_queue == -1 )
+		reporter->FatalError("Failed to initialize epoll: %s", strerror(errno));
+#else
 	event_queue = kqueue();
 	if ( event_queue == -1 )
 		reporter->FatalError("Failed to initialize kqueue: %s", strerror(errno));
+#endif
 	}
 
 Manager::~Manager()
@@ -184,6 +196,43 @@ void Manager::FindReadySources(std::vector<IOSource*>* ready)
 		Poll(ready, timeout, timeout_src);
 	}
 
+#ifdef HAVE_EPOLL
+
+void Manager::Poll(std::vector<IOSource*>* ready, double timeout, IOSource* timeout_src)
+	{
+	// epoll_wait() refuses an empty output buffer.
+	if ( events.empty() )
+		events.resize(1);
+
+	int ret = epoll_wait(event_queue, events.data(), events.size(), ConvertTimeout(timeout));
+	if ( ret == -1 )
+		{
+		// Ignore interrupts since we may catch one during shutdown and we don't want the
+		// error to get printed.
+		if ( errno != EINTR )
+			reporter->InternalWarning("Error calling epoll_wait: %s", strerror(errno));
+		}
+	else if ( ret == 0 )
+		{
+		if ( timeout_src )
+			ready->push_back(timeout_src);
+		}
+	else
+		{
+		// epoll_wait returns the number of events that are ready, so we only need
+		// to loop over that many of them. Errors and hangups count as ready, too,
+		// so that the source gets to notice them.
+		for ( int i = 0; i < ret; i++ )
+			{
+			std::map<int, IOSource*>::const_iterator it = fd_map.find(events[i].data.fd);
+			if ( it != fd_map.end() )
+				ready->push_back(it->second);
+			}
+		}
+	}
+
+#else
+
 void Manager::Poll(std::vector<IOSource*>* ready, double timeout, IOSource* timeout_src)
 	{
 	struct timespec kqueue_timeout;
@@ -218,6 +267,8 @@ void Manager::Poll(std::vector<IOSource*>* ready, double timeout, IOSource* time
 		}
 	}
 
+#endif
+
 void Manager::ConvertTimeout(double timeout, struct timespec& spec)
 	{
 	// If timeout ended up -1, set it to some nominal value just to keep the loop
@@ -235,11 +286,34 @@ void Manager::ConvertTimeout(double timeout, struct timespec& spec)
 		}
 	}
 
+int Manager::ConvertTimeout(double timeout)
+	{
+	// Same nominal value as above for the case of no timeout.
+	if ( timeout < 0 )
+		return 100;
+
+	// We round down so that very short timeouts (like the one packet
+	// sources without a file descriptor use) keep the loop spinning
+	// rather than blocking for a full millisecond.
+	return static_cast<int>(timeout * 1e3);
+	}
+
 bool Manager::RegisterFd(int fd, IOSource* src)
 	{
+#ifdef HAVE_EPOLL
+	struct epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	int ret = epoll_ctl(event_queue, EPOLL_CTL_ADD, fd, &event);
+
+	// Like kqueue's EV_ADD, just update an existing registration.
+	if ( ret == -1 && errno == EEXIST )
+		ret = epoll_ctl(event_queue, EPOLL_CTL_MOD, fd, &event);
+#else
 	struct kevent event;
 	EV_SET(&event, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
 	int ret = kevent(event_queue, &event, 1, NULL, 0, NULL);
+#endif
 	if ( ret != -1 )
 		{
 		events.push_back({});
@@ -260,9 +334,13 @@ bool Manager::UnregisterFd(int fd, IOSource* src)
 	{
 	if ( fd_map.find(fd) != fd_map.end() )
 		{
+#ifdef HAVE_EPOLL
+		int ret = epoll_ctl(event_queue, EPOLL_CTL_DEL, fd, NULL);
+#else
 		struct kevent event;
 		EV_SET(&event, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
 		int ret = kevent(event_queue, &event, 1, NULL, 0, NULL);
+#endif
 		if ( ret != -1 )
 			DBG_LOG(DBG_MAINLOOP, "Unregistered fd %d from %s", fd, src->Tag());
 
@@ -12,7 +12,11 @@
 #include "Flare.h"
 
 struct timespec;
+#ifdef HAVE_EPOLL
+struct epoll_event;
+#else
 struct kevent;
+#endif
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(PktSrc, zeek, iosource);
 ZEEK_FORWARD_DECLARE_NAMESPACED(PktDumper, zeek, iosource);
@@ -153,6 +157,12 @@ private:
 	 */
 	void ConvertTimeout(double timeout, struct timespec& spec);
 
+	/**
+	 * Converts a double timeout value into the number of milliseconds
+	 * used for calls to epoll_wait().
+	 */
+	int ConvertTimeout(double timeout);
+
 	/**
 	 * Specialized registration method for packet sources.
 	 */
@@ -205,9 +215,13 @@ private:
 	int event_queue = -1;
 	std::map<int, IOSource*> fd_map;
 
-	// This is only used for the output of the call to kqueue in FindReadySources().
-	// The actual events are stored as part of the queue.
+	// This is only used for the output of the call to kqueue/epoll in
+	// FindReadySources(). The actual events are stored as part of the queue.
+#ifdef HAVE_EPOLL
+	std::vector<struct epoll_event> events;
+#else
 	std::vector<struct kevent> events;
+#endif
 };
 
 } // namespace iosource
@@ -27,26 +27,25 @@ void Packet::Init(int arg_link_type, pkt_timeval *arg_ts, uint32_t arg_caplen,
 		  uint32_t arg_len, const u_char *arg_data, bool arg_copy,
 		  std::string arg_tag)
 	{
-	if ( data && copy )
-		delete [] data;
-
 	link_type = arg_link_type;
 	ts = *arg_ts;
 	cap_len = arg_caplen;
 	len = arg_len;
 	tag = std::move(arg_tag);
 
-	copy = arg_copy;
-
 	if ( arg_data && arg_copy )
 		{
-		data = new u_char[arg_caplen];
-		memcpy(const_cast<u_char *>(data), arg_data, arg_caplen);
+		buffer = make_intrusive<PacketBuffer>(arg_data, arg_caplen);
+		data = buffer->Data();
 		}
 	else
+		{
+		buffer = nullptr;
 		data = arg_data;
+		}
 
 	dump_packet = false;
+	meta = PacketMetadata();
 
 	time = ts.tv_sec + double(ts.tv_usec) / 1e6;
 	eth_type = 0;
@@ -59,6 +58,7 @@ void Packet::Init(int arg_link_type, pkt_timeval *arg_ts, uint32_t arg_caplen,
 
 	l3_proto = L3_UNKNOWN;
 	l3_checksummed = false;
+	l4_checksummed = false;
 
 	encap.reset();
 	ip_hdr.reset();
@@ -71,8 +71,14 @@ void Packet::Init(int arg_link_type, pkt_timeval *arg_ts, uint32_t arg_caplen,
 
 Packet::~Packet()
 	{
-	if ( copy )
-		delete [] data;
+	}
+
+PacketBufferPtr Packet::Pin(const u_char* p, uint64_t len) const
+	{
+	if ( buffer && buffer->Pinnable() && buffer->Contains(p, len) )
+		return buffer;
+
+	return nullptr;
 	}
 
 void Packet::Weird(const char* name)
@@ -17,6 +17,7 @@ typedef struct timeval pkt_timeval;
 #include "zeek/NetVar.h" // For BifEnum::Tunnel
 #include "zeek/TunnelEncapsulation.h"
 #include "zeek/IP.h"
+#include "iosource/PacketBuffer.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(ODesc, zeek);
 ZEEK_FORWARD_DECLARE_NAMESPACED(Val, zeek);
@@ -40,6 +41,39 @@ enum Layer3Proto : int32_t {
 	L3_ARP = 3,			/// Layer 3 is ARP.
 };
 
+/**
+ * Information a packet source obtained along with a packet from the NIC or
+ * the kernel, rather than from the packet's data. Sources fill in what
+ * they have after \a Packet::Init(), which clears it.
+ */
+struct PacketMetadata {
+	/**
+	 * A hash over the packet's flow computed by the NIC, such as its RSS
+	 * hash. Only valid if \a have_flow_hash is set.
+	 */
+	uint32_t flow_hash = 0;
+	bool have_flow_hash = false;
+
+	/**
+	 * Set if \a flow_hash comes out the same for both directions of a
+	 * flow, as with a symmetric RSS key. Only a symmetric hash identifies
+	 * a connection.
+	 */
+	bool symmetric_flow_hash = false;
+
+	/**
+	 * The VLAN IDs of tags the NIC removed from the packet's data,
+	 * outermost first, or 0 if none.
+	 */
+	uint32_t stripped_vlan = 0;
+	uint32_t stripped_inner_vlan = 0;
+
+	/**
+	 * Set if the packet's timestamp was taken by the NIC.
+	 */
+	bool hardware_timestamp = false;
+};
+
 /**
  * A link-layer packet.
  */
@@ -126,6 +160,22 @@ public:
 	// Wrapper to generate a packet-level weird. Has to be public for llanalyzers to use it.
 	void Weird(const char* name);
 
+	/**
+	 * Returns a reference that keeps the given range of the packet's
+	 * data valid beyond the lifetime of the packet (and beyond the
+	 * source's \a DoneWithPacket()), so that the caller doesn't need
+	 * to copy it.
+	 *
+	 * @param p The start of the range, which must point into the
+	 * packet's data.
+	 *
+	 * @param len The length of the range.
+	 *
+	 * @return The reference, or null if the packet's memory can't be
+	 * pinned. In that case the caller needs to copy the data.
+	 */
+	PacketBufferPtr Pin(const u_char* p, uint64_t len) const;
+
 	/**
 	 * Maximal length of a layer 2 address.
 	 */
@@ -189,11 +239,26 @@ public:
 	 */
 	bool l3_checksummed;
 
+	/**
+	 * Indicates whether the layer 4 (TCP, UDP, ICMP) checksum was
+	 * validated by the hardware/kernel before being received by zeek.
+	 * Packet sources set this for NICs with receive checksum offload, so
+	 * that Zeek doesn't need to make a pass over the payload itself.
+	 * Only applies to the outermost headers, never to tunneled packets.
+	 */
+	bool l4_checksummed;
+
 	/**
 	 * Indicates whether this packet should be recorded.
 	 */
 	mutable bool dump_packet;
 
+	/**
+	 * NIC metadata provided by the packet source, if any. Only ever set
+	 * for the outermost packet.
+	 */
+	PacketMetadata meta;
+
 	// These are fields passed between various packet analyzers. They're best
 	// stored with the packet so they stay available as the packet is passed
 	// around.
@@ -238,13 +303,16 @@ public:
 	 */
 	int gre_link_type = DLT_RAW;
 
+	/**
+	 * The buffer holding the packet's data, if any. Packet sources that
+	 * support pinning their memory set this after \a Init(). It's also
+	 * set if the packet made its own copy of the data. See \a Pin().
+	 */
+	PacketBufferPtr buffer;
+
 private:
 	// Renders an MAC address into its ASCII representation.
 	ValPtr FmtEUI48(const u_char* mac) const;
-
-	// True if we need to delete associated packet memory upon
-	// destruction.
-	bool copy;
 };
 
 } // namespace zeek
@@ -0,0 +1,113 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstring>
+#include <cstdint>
+
+#include "IntrusivePtr.h"
+
+namespace zeek {
+
+/**
+ * A reference-counted region of memory holding packet data. Packet
+ * sources attach one to the packets they hand out, so that consumers
+ * that need the data to outlive \a PktSrc::DoneWithPacket() (such as
+ * the reassemblers) can pin the capture memory instead of copying it.
+ * The memory stays valid for as long as a reference exists.
+ *
+ * The default implementation owns a heap copy of the data. Sources
+ * with their own buffer management (e.g., memory-mapped rings)
+ * override \a Release() to recycle the memory once the last reference
+ * is gone, and \a Pinnable() to refuse pins when they run short on
+ * buffer space.
+ */
+class PacketBuffer {
+public:
+	/**
+	 * Creates a buffer owning a copy of the given data.
+	 */
+	PacketBuffer(const u_char* arg_data, uint64_t arg_size)
+		: data(new u_char[arg_size]), size(arg_size), owned(true)
+		{
+		memcpy(const_cast<u_char*>(data), arg_data, arg_size);
+		}
+
+	virtual ~PacketBuffer()
+		{
+		if ( owned )
+			delete [] data;
+		}
+
+	PacketBuffer(const PacketBuffer&) = delete;
+	PacketBuffer& operator=(const PacketBuffer&) = delete;
+
+	/**
+	 * Returns the start of the buffer's memory.
+	 */
+	const u_char* Data() const	{ return data; }
+
+	/**
+	 * Returns the size of the buffer's memory.
+	 */
+	uint64_t Size() const	{ return size; }
+
+	/**
+	 * Returns true if the range [p, p + len) lies within the buffer.
+	 */
+	bool Contains(const u_char* p, uint64_t len) const
+		{ return p >= data && p + len <= data + size; }
+
+	/**
+	 * Returns true if the buffer is willing to hand out further
+	 * references beyond the lifetime of the current packet. If not,
+	 * consumers need to copy the data.
+	 */
+	virtual bool Pinnable() const	{ return true; }
+
+	/**
+	 * Returns the current number of references.
+	 */
+	int RefCnt() const	{ return ref_cnt; }
+
+	friend inline void Ref(PacketBuffer* b);
+	friend inline void Unref(PacketBuffer* b);
+
+protected:
+	/**
+	 * Creates a buffer referring to memory managed by the caller.
+	 * Derived classes must override \a Release() to take care of it.
+	 */
+	PacketBuffer(const u_char* arg_data, uint64_t arg_size, int arg_ref_cnt)
+		: data(arg_data), size(arg_size), owned(false), ref_cnt(arg_ref_cnt)
+		{ }
+
+	/**
+	 * Called when the last reference goes away. The default
+	 * implementation deletes the buffer.
+	 */
+	virtual void Release()	{ delete this; }
+
+	const u_char* data;
+	uint64_t size;
+
+private:
+	bool owned;
+	int ref_cnt = 1;
+};
+
+inline void Ref(PacketBuffer* b)
+	{
+	++b->ref_cnt;
+	}
+
+inline void Unref(PacketBuffer* b)
+	{
+	if ( b && --b->ref_cnt == 0 )
+		b->Release();
+	}
+
+using PacketBufferPtr = IntrusivePtr<PacketBuffer>;
+
+} // namespace zeek
@@ -7,8 +7,10 @@
 
 #include "util.h"
 #include "Hash.h"
+#include "NetVar.h"
 #include "RunState.h"
 #include "Sessions.h"
+#include "Stats.h"
 #include "broker/Manager.h"
 #include "iosource/Manager.h"
 #include "packet_analysis/Manager.h"
@@ -24,11 +26,13 @@ PktSrc::Properties::Properties()
 	link_type = -1;
 	netmask = NETMASK_UNKNOWN;
 	is_live = false;
+	batch_size = 1;
 	}
 
 PktSrc::PktSrc()
 	{
 	have_packet = false;
+	batch_len = batch_pos = 0;
 	errbuf = "";
 	SetClosed(true);
 	}
@@ -85,6 +89,13 @@ void PktSrc::Opened(const Properties& arg_props)
 	props = arg_props;
 	SetClosed(false);
 
+	batch_len = batch_pos = 0;
+
+	if ( props.is_live && props.batch_size > 1 )
+		batch.reset(new Packet[props.batch_size]);
+	else
+		batch.reset();
+
 	if ( ! PrecompileFilter(0, "") || ! SetFilter(0) )
 		{
 		Close();
@@ -112,6 +123,9 @@ void PktSrc::Closed()
 	{
 	SetClosed(true);
 
+	// Any packets left in the current batch belonged to the source.
+	batch_len = batch_pos = 0;
+
 	if ( props.is_live && props.selectable_fd != -1 )
 		iosource_mgr->UnregisterFd(props.selectable_fd, this);
 
@@ -159,6 +173,12 @@ void PktSrc::Process()
 	if ( ! IsOpen() )
 		return;
 
+	if ( batch )
+		{
+		ProcessBatch();
+		return;
+		}
+
 	if ( ! ExtractNextPacketInternal() )
 		return;
 
@@ -168,6 +188,67 @@ void PktSrc::Process()
 	DoneWithPacket();
 	}
 
+void PktSrc::ProcessBatch()
+	{
+	if ( batch_pos == batch_len )
+		{
+		// Don't return any packets if processing is suspended (except for the
+		// very first packet which we need to set up times).
+		if ( run_state::is_processing_suspended() && run_state::detail::first_timestamp )
+			return;
+
+		zeek::detail::StageTimer stage(zeek::detail::STAGE_CAPTURE);
+		batch_len = ExtractNextPackets(batch.get(), props.batch_size);
+		stage.Done();
+		batch_pos = 0;
+
+		if ( ! batch_len )
+			return;
+
+		if ( zeek::detail::prefetch_connections )
+			{
+			for ( size_t i = 0; i < batch_len; ++i )
+				packet_mgr->PrefetchPacket(&batch[i]);
+			}
+		}
+
+	while ( batch_pos < batch_len )
+		{
+		Packet* pkt = &batch[batch_pos];
+
+		// Pull the next packet's headers into the cache while this one
+		// is being analyzed.
+		if ( batch_pos + 1 < batch_len )
+			__builtin_prefetch(batch[batch_pos + 1].data);
+
+		if ( pkt->time < 0 )
+			Weird("negative_packet_timestamp", pkt);
+		else
+			{
+			if ( ! run_state::detail::first_timestamp )
+				run_state::detail::first_timestamp = pkt->time;
+
+			have_packet = true;
+			run_state::detail::dispatch_packet(pkt, this);
+			have_packet = false;
+			}
+
+		// The source may have been closed while processing the packet,
+		// which also invalidates the rest of the batch.
+		if ( ! IsOpen() )
+			return;
+
+		++batch_pos;
+
+		// Keep the remaining packets for when processing resumes.
+		if ( run_state::is_processing_suspended() && batch_pos < batch_len )
+			return;
+		}
+
+	DoneWithPackets(batch_len);
+	batch_len = batch_pos = 0;
+	}
+
 const char* PktSrc::Tag()
 	{
 	return "PktSrc";
@@ -188,7 +269,11 @@ bool PktSrc::ExtractNextPacketInternal()
 	if ( run_state::pseudo_realtime )
 		run_state::detail::current_wallclock = util::current_time(true);
 
-	if ( ExtractNextPacket(&current_packet) )
+	zeek::detail::StageTimer stage(zeek::detail::STAGE_CAPTURE);
+	bool have_next = ExtractNextPacket(&current_packet);
+	stage.Done();
+
+	if ( have_next )
 		{
 		if ( current_packet.time < 0 )
 			{
@@ -247,6 +332,33 @@ bool PktSrc::PrecompileBPFFilter(int index, const std::string& filter)
 	return true;
 	}
 
+std::string PktSrc::ShuntBPFFilter(const ConnTuple& t)
+	{
+	bool v6 = t.src_addr.GetFamily() == IPv6;
+	auto src = t.src_addr.AsString();
+	auto dst = t.dst_addr.AsString();
+
+	switch ( t.proto ) {
+	case TRANSPORT_TCP:
+	case TRANSPORT_UDP:
+		{
+		const char* proto = t.proto == TRANSPORT_TCP ? "tcp" : "udp";
+		return util::fmt("%s and ((src host %s and src port %u and dst host %s and dst port %u) or "
+		                 "(src host %s and src port %u and dst host %s and dst port %u))",
+		                 proto,
+		                 src.c_str(), t.src_port, dst.c_str(), t.dst_port,
+		                 dst.c_str(), t.dst_port, src.c_str(), t.src_port);
+		}
+
+	case TRANSPORT_ICMP:
+		return util::fmt("%s and host %s and host %s", v6 ? "icmp6" : "icmp",
+		                 src.c_str(), dst.c_str());
+
+	default:
+		return util::fmt("host %s and host %s", src.c_str(), dst.c_str());
+	}
+	}
+
 detail::BPF_Program* PktSrc::GetBPFFilter(int index)
 	{
 	if ( index < 0 )
@@ -277,10 +389,24 @@ bool PktSrc::GetCurrentPacket(const Packet** pkt)
 	if ( ! have_packet )
 		return false;
 
-	*pkt = &current_packet;
+	*pkt = batch_pos < batch_len ? &batch[batch_pos] : &current_packet;
 	return true;
 	}
 
+size_t PktSrc::ExtractNextPackets(Packet* pkts, size_t max)
+	{
+	if ( max == 0 || ! ExtractNextPacket(pkts) )
+		return 0;
+
+	return 1;
+	}
+
+void PktSrc::DoneWithPackets(size_t num)
+	{
+	for ( size_t i = 0; i < num; i++ )
+		DoneWithPacket();
+	}
+
 double PktSrc::GetNextTimeout()
 	{
 	// If there's no file descriptor for the source, which is the case for some interfaces like
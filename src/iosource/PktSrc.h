@@ -2,10 +2,14 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "IOSource.h"
+#include "IPAddr.h"
 #include "Packet.h"
+#include "net_util.h"
 
 #include <sys/types.h> // for u_char
 
@@ -49,6 +53,17 @@ public:
 		Stats()	{ received = dropped = link = bytes_received = 0; }
 	};
 
+	/**
+	 * A flow for \a ShuntFlow(). Which side is which doesn't matter.
+	 */
+	struct ConnTuple {
+		IPAddr src_addr;
+		IPAddr dst_addr;
+		uint16_t src_port = 0;	// In host order. ICMP has none.
+		uint16_t dst_port = 0;
+		TransportProto proto = TRANSPORT_UNKNOWN;
+	};
+
 	/**
 	 * Constructor.
 	 */
@@ -122,6 +137,13 @@ public:
 	 */
 	bool PrecompileBPFFilter(int index, const std::string& filter);
 
+	/**
+	 * Returns a BPF expression matching both directions of a flow. This
+	 * is a helper for packet sources implementing \a ShuntFlow() by
+	 * excluding flows in their BPF filter.
+	 */
+	static std::string ShuntBPFFilter(const ConnTuple& tuple);
+
 	/**
 	 * Returns the precompiled BPF filter associated with a given index,
 	 * if any, as compiled by \a PrecompileBPFFilter().
@@ -194,6 +216,25 @@ public:
 	 */
 	virtual bool SetFilter(int index) = 0;
 
+	/**
+	 * Asks the source to drop all further packets of a flow, in both
+	 * directions, before capturing them, for example in the kernel or on
+	 * the NIC.
+	 *
+	 * Derived classes can override this if they support it. The default
+	 * implementation doesn't.
+	 *
+	 * @param tuple The flow.
+	 *
+	 * @param timeout For how many seconds to drop the flow's packets, or
+	 * zero for as long as the source is open.
+	 *
+	 * @return True if the source now drops the flow, false if it
+	 * can't.
+	 */
+	virtual bool ShuntFlow(const ConnTuple& tuple, double timeout)
+		{ return false; }
+
 	/**
 	 * Returns current statistics about the source.
 	 *
@@ -254,6 +295,14 @@ protected:
 		 */
 		bool is_live;
 
+		/**
+		 * The maximum number of packets the source can hand out in a
+		 * single call to \a ExtractNextPackets(). A value of one (the
+		 * default) disables batched processing. Batching is only used
+		 * for live sources.
+		 */
+		size_t batch_size;
+
 		Properties();
 	};
 
@@ -331,6 +380,9 @@ protected:
 	 * guaranetee that it stays available at least until \a
 	 * DoneWithPacket() is called.  It is guaranteed that no two calls to
 	 * this method will hapen with \a DoneWithPacket() in between.
+	 * Sources that get NIC metadata along with the packet, such as a
+	 * flow hash or stripped VLAN tags, pass it on in the packet's \a
+	 * meta field after initializing it.
 	 *
 	 * @return True if a packet is available and *pkt* filled in. False
 	 * if not packet is available or an error occured (which must be
@@ -344,11 +396,48 @@ protected:
 	 */
 	virtual void DoneWithPacket() = 0;
 
+	/**
+	 * Provides up to *max* packets from the source at once. This is
+	 * only called if the source announced a \a Properties::batch_size
+	 * larger than one.
+	 *
+	 * Derived classes that can hand out several packets without copying
+	 * them (e.g., from a memory-mapped ring) should override this. The
+	 * default implementation returns at most one packet through \a
+	 * ExtractNextPacket().
+	 *
+	 * @param pkts An array of *max* packet structures to fill in. The
+	 * callee keeps ownership of the data, but must guarantee that it
+	 * stays available at least until \a DoneWithPackets() is called.
+	 * It is guaranteed that no two calls to this method will happen
+	 * without \a DoneWithPackets() in between.
+	 *
+	 * @param max The maximum number of packets to return.
+	 *
+	 * @return The number of packets filled in, which may be zero if no
+	 * packet is available or an error occurred (which must be flagged
+	 * via Error()).
+	 */
+	virtual size_t ExtractNextPackets(Packet* pkts, size_t max);
+
+	/**
+	 * Signals that the data of the packets returned by the previous
+	 * call to \a ExtractNextPackets() will no longer be needed. The
+	 * default implementation calls \a DoneWithPacket() once per packet.
+	 *
+	 * @param num The number of packets the previous call returned.
+	 */
+	virtual void DoneWithPackets(size_t num);
+
 private:
 
 	// Internal helper for ExtractNextPacket().
 	bool ExtractNextPacketInternal();
 
+	// Internal helper for Process() when the source delivers packets
+	// in batches.
+	void ProcessBatch();
+
 	// IOSource interface implementation.
 	void InitSource() override;
 	void Done() override;
@@ -360,6 +449,12 @@ private:
 	bool have_packet;
 	Packet current_packet;
 
+	// For batched extraction. The current batch is batch[0..batch_len),
+	// of which the first batch_pos packets have been dispatched already.
+	std::unique_ptr<Packet[]> batch;
+	size_t batch_len;
+	size_t batch_pos;
+
 	// For BPF filtering support.
 	std::vector<detail::BPF_Program *> filters;
 
@@ -0,0 +1,421 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "AF_Packet.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "iosource/BPF_Program.h"
+#include "iosource/pcap/pcap.bif.h"
+#include "ID.h"
+#include "Val.h"
+#include "Reporter.h"
+#include "RunState.h"
+
+namespace zeek::iosource::af_packet {
+
+AF_PacketSource::~AF_PacketSource()
+	{
+	Close();
+	}
+
+AF_PacketSource::AF_PacketSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+
+	socket_fd = -1;
+	if_index = 0;
+	}
+
+void AF_PacketSource::Open()
+	{
+	uint64_t buffer_size = id::find_val("AF_Packet::buffer_size")->AsCount();
+	uint64_t block_size = id::find_val("AF_Packet::block_size")->AsCount();
+	double block_timeout = id::find_val("AF_Packet::block_timeout")->AsInterval();
+	bool enable_fanout = id::find_val("AF_Packet::enable_fanout")->AsBool();
+	bool enable_defrag = id::find_val("AF_Packet::enable_defrag")->AsBool();
+
+	socket_fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+	if ( socket_fd < 0 )
+		{
+		Error(util::fmt("unable to create socket: %s", strerror(errno)));
+		return;
+		}
+
+	int version = TPACKET_V3;
+
+	if ( setsockopt(socket_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 )
+		{
+		Error(util::fmt("unable to set TPACKET_V3: %s", strerror(errno)));
+		close(socket_fd);
+		socket_fd = -1;
+		return;
+		}
+
+	try
+		{
+		rx_ring = std::make_unique<detail::RX_Ring>(socket_fd, buffer_size, block_size,
+		                                            static_cast<int>(block_timeout * 1000));
+		}
+	catch ( detail::RX_RingException& e )
+		{
+		Error(util::fmt("unable to create RX ring: %s", e.what()));
+		close(socket_fd);
+		socket_fd = -1;
+		return;
+		}
+
+	if ( ! BindInterface() )
+		{
+		Error(util::fmt("unable to bind to interface %s: %s", props.path.c_str(), strerror(errno)));
+		rx_ring.reset();
+		close(socket_fd);
+		socket_fd = -1;
+		return;
+		}
+
+	if ( ! EnablePromiscMode() )
+		{
+		Error(util::fmt("unable to enter promiscuous mode: %s", strerror(errno)));
+		rx_ring.reset();
+		close(socket_fd);
+		socket_fd = -1;
+		return;
+		}
+
+	if ( ! ConfigureFanoutGroup(enable_fanout, enable_defrag) )
+		{
+		Error(util::fmt("unable to join fanout group: %s", strerror(errno)));
+		rx_ring.reset();
+		close(socket_fd);
+		socket_fd = -1;
+		return;
+		}
+
+	props.netmask = NETMASK_UNKNOWN;
+	props.selectable_fd = socket_fd;
+	props.is_live = true;
+	props.link_type = id::find_val("AF_Packet::link_type")->AsCount();
+	props.batch_size = id::find_val("AF_Packet::batch_size")->AsCount();
+
+	stats.received = stats.dropped = stats.link = stats.bytes_received = 0;
+
+	Opened(props);
+	}
+
+bool AF_PacketSource::BindInterface()
+	{
+	struct ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+
+	if ( props.path.size() >= sizeof(ifr.ifr_name) )
+		{
+		errno = ENAMETOOLONG;
+		return false;
+		}
+
+	memcpy(ifr.ifr_name, props.path.c_str(), props.path.size());
+
+	if ( ioctl(socket_fd, SIOCGIFINDEX, &ifr) < 0 )
+		return false;
+
+	if_index = ifr.ifr_ifindex;
+
+	struct sockaddr_ll saddr_ll;
+	memset(&saddr_ll, 0, sizeof(saddr_ll));
+	saddr_ll.sll_family = AF_PACKET;
+	saddr_ll.sll_protocol = htons(ETH_P_ALL);
+	saddr_ll.sll_ifindex = if_index;
+
+	return bind(socket_fd, (struct sockaddr*) &saddr_ll, sizeof(saddr_ll)) >= 0;
+	}
+
+bool AF_PacketSource::EnablePromiscMode()
+	{
+	struct packet_mreq mreq;
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.mr_ifindex = if_index;
+	mreq.mr_type = PACKET_MR_PROMISC;
+
+	return setsockopt(socket_fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) >= 0;
+	}
+
+bool AF_PacketSource::ConfigureFanoutGroup(bool enabled, bool defrag)
+	{
+	if ( ! enabled )
+		return true;
+
+	uint32_t fanout_id = id::find_val("AF_Packet::fanout_id")->AsCount();
+	uint32_t fanout_arg = (fanout_id & 0xffff) | (GetFanoutMode() << 16);
+
+	if ( defrag )
+		fanout_arg |= (PACKET_FANOUT_FLAG_DEFRAG << 16);
+
+	return setsockopt(socket_fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) >= 0;
+	}
+
+uint32_t AF_PacketSource::GetFanoutMode() const
+	{
+	// Must stay in line with AF_Packet::FanoutMode in init-bare.zeek.
+	switch ( id::find_val("AF_Packet::fanout_mode")->AsEnum() ) {
+	case 1: return PACKET_FANOUT_LB;
+	case 2: return PACKET_FANOUT_CPU;
+	case 3: return PACKET_FANOUT_QM;
+	default: return PACKET_FANOUT_HASH;
+	}
+	}
+
+void AF_PacketSource::Close()
+	{
+	if ( socket_fd < 0 )
+		return;
+
+	rx_ring.reset();
+	close(socket_fd);
+	socket_fd = -1;
+
+	Closed();
+	}
+
+bool AF_PacketSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( ! rx_ring )
+		return false;
+
+	struct tpacket3_hdr* hdr;
+
+	while ( true )
+		{
+		if ( ! rx_ring->GetNextPacket(&hdr) )
+			return false;
+
+		pkt_timeval ts = { static_cast<time_t>(hdr->tp_sec),
+		                   static_cast<suseconds_t>(hdr->tp_nsec / 1000) };
+		const u_char* data = reinterpret_cast<const u_char*>(hdr) + hdr->tp_mac;
+
+		pkt->Init(props.link_type, &ts, hdr->tp_snaplen, hdr->tp_len, data);
+		pkt->buffer = rx_ring->CurrentBlock();
+
+		if ( hdr->tp_len == 0 || hdr->tp_snaplen == 0 )
+			{
+			Weird("empty_af_packet_header", pkt);
+			rx_ring->ReleasePacket();
+			continue;
+			}
+
+		// The kernel strips the outermost 802.1Q tag and hands it to us
+		// out-of-band.
+		if ( hdr->tp_status & TP_STATUS_VLAN_VALID )
+			pkt->vlan = hdr->hv1.tp_vlan_tci & 0x0fff;
+
+		if ( next_shunt_expiry && pkt->time >= next_shunt_expiry )
+			ExpireShunts(pkt->time);
+
+		++stats.received;
+		stats.bytes_received += hdr->tp_len;
+		return true;
+		}
+	}
+
+void AF_PacketSource::DoneWithPacket()
+	{
+	if ( rx_ring )
+		rx_ring->ReleasePacket();
+	}
+
+size_t AF_PacketSource::ExtractNextPackets(Packet* pkts, size_t max)
+	{
+	// A batch never spans more than the current ring block, as the
+	// block can only go back to the kernel as a whole.
+	size_t num = 0;
+
+	while ( num < max && ExtractNextPacket(&pkts[num]) )
+		++num;
+
+	return num;
+	}
+
+void AF_PacketSource::DoneWithPackets(size_t num)
+	{
+	if ( ! rx_ring )
+		return;
+
+	for ( size_t i = 0; i < num; i++ )
+		rx_ring->ReleasePacket();
+	}
+
+bool AF_PacketSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	if ( ! PktSrc::PrecompileBPFFilter(index, filter) )
+		return false;
+
+	filter_texts[index] = filter;
+	return true;
+	}
+
+bool AF_PacketSource::SetFilter(int index)
+	{
+	if ( socket_fd < 0 )
+		return true; // Prevent error message.
+
+	iosource::detail::BPF_Program* code = GetBPFFilter(index);
+
+	if ( ! code )
+		{
+		Error(util::fmt("No precompiled filter for index %d", index));
+		return false;
+		}
+
+	current_filter = index;
+
+	if ( ! shunts.empty() )
+		return InstallShunts();
+
+	return AttachFilter(code->GetProgram());
+	}
+
+bool AF_PacketSource::AttachFilter(struct bpf_program* program)
+	{
+	// The kernel's classic BPF uses the same instruction layout as
+	// libpcap's compiled programs, so we can attach them directly and
+	// never see packets the filter rejects.
+	struct sock_fprog fprog;
+	fprog.len = program->bf_len;
+	fprog.filter = reinterpret_cast<struct sock_filter*>(program->bf_insns);
+
+	if ( setsockopt(socket_fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0 )
+		{
+		Error(util::fmt("unable to attach BPF filter: %s", strerror(errno)));
+		return false;
+		}
+
+	return true;
+	}
+
+bool AF_PacketSource::InstallShunts()
+	{
+	std::string filter;
+
+	if ( current_filter >= 0 )
+		filter = filter_texts[current_filter];
+
+	std::string excluded;
+
+	for ( const auto& s : shunts )
+		excluded += (excluded.empty() ? "(" : " or (") + s.filter + ")";
+
+	if ( ! excluded.empty() )
+		{
+		if ( filter.empty() )
+			filter = "not (" + excluded + ")";
+		else
+			filter = "(" + filter + ") and not (" + excluded + ")";
+		}
+
+	iosource::detail::BPF_Program code;
+	char errbuf[PCAP_ERRBUF_SIZE];
+
+	if ( ! code.Compile(BifConst::Pcap::snaplen, props.link_type, filter.c_str(),
+	                    props.netmask, errbuf, sizeof(errbuf)) )
+		{
+		reporter->Error("unable to compile AF_Packet filter with shunts: %s", errbuf);
+		return false;
+		}
+
+	return AttachFilter(code.GetProgram());
+	}
+
+bool AF_PacketSource::ShuntFlow(const ConnTuple& tuple, double timeout)
+	{
+	if ( socket_fd < 0 )
+		return false;
+
+	// Every shunt makes the program longer, which the kernel limits as
+	// well as runs for every packet.
+	static auto max_shunts = id::find_val("AF_Packet::max_shunts")->AsCount();
+
+	if ( shunts.size() >= max_shunts )
+		return false;
+
+	double expire = timeout > 0 ? run_state::network_time + timeout : 0;
+	shunts.push_back({ShuntBPFFilter(tuple), expire});
+
+	if ( ! InstallShunts() )
+		{
+		// The previous program stays attached.
+		shunts.pop_back();
+		return false;
+		}
+
+	if ( expire && (! next_shunt_expiry || expire < next_shunt_expiry) )
+		next_shunt_expiry = expire;
+
+	return true;
+	}
+
+void AF_PacketSource::ExpireShunts(double t)
+	{
+	next_shunt_expiry = 0;
+
+	for ( auto it = shunts.begin(); it != shunts.end(); )
+		{
+		if ( it->expire && it->expire <= t )
+			{
+			it = shunts.erase(it);
+			continue;
+			}
+
+		if ( it->expire && (! next_shunt_expiry || it->expire < next_shunt_expiry) )
+			next_shunt_expiry = it->expire;
+
+		++it;
+		}
+
+	InstallShunts();
+	}
+
+void AF_PacketSource::Statistics(Stats* s)
+	{
+	if ( socket_fd < 0 )
+		{
+		s->received = s->dropped = s->link = s->bytes_received = 0;
+		return;
+		}
+
+	// The kernel resets its counters on every read, so we accumulate.
+	struct tpacket_stats_v3 tp_stats;
+	socklen_t len = sizeof(tp_stats);
+
+	if ( getsockopt(socket_fd, SOL_PACKET, PACKET_STATISTICS, &tp_stats, &len) < 0 )
+		reporter->Error("unable to retrieve AF_Packet statistics: %s", strerror(errno));
+	else
+		{
+		// tp_packets includes tp_drops.
+		stats.link += tp_stats.tp_packets;
+		stats.dropped += tp_stats.tp_drops;
+		}
+
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->dropped = stats.dropped;
+	s->link = stats.link;
+	}
+
+iosource::PktSrc* AF_PacketSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new AF_PacketSource(path, is_live);
+	}
+
+} // namespace zeek::iosource::af_packet
@@ -0,0 +1,77 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+extern "C" {
+#include <linux/if_packet.h>
+}
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "iosource/PktSrc.h"
+#include "RX_Ring.h"
+
+namespace zeek::iosource::af_packet {
+
+/**
+ * Packet source reading from a Linux AF_PACKET socket through a
+ * memory-mapped TPACKET_V3 ring. Interfaces are given with the
+ * ``af_packet::`` prefix, e.g. ``zeek -i af_packet::eth0``.
+ *
+ * Configuration happens through the options in the ``AF_Packet``
+ * script module, see ``init-bare.zeek``.
+ */
+class AF_PacketSource : public PktSrc {
+public:
+	AF_PacketSource(const std::string& path, bool is_live);
+	~AF_PacketSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	size_t ExtractNextPackets(Packet* pkts, size_t max) override;
+	void DoneWithPackets(size_t num) override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	bool ShuntFlow(const ConnTuple& tuple, double timeout) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	bool BindInterface();
+	bool EnablePromiscMode();
+	bool ConfigureFanoutGroup(bool enabled, bool defrag);
+	uint32_t GetFanoutMode() const;
+	bool AttachFilter(struct bpf_program* program);
+	bool InstallShunts();
+	void ExpireShunts(double t);
+
+	Properties props;
+	Stats stats;
+
+	int socket_fd;
+	int if_index;
+
+	std::unique_ptr<detail::RX_Ring> rx_ring;
+
+	// The kernel takes a single filter program, so shunted flows get
+	// excluded from the capture filter, which we need the text of.
+	struct Shunt {
+		std::string filter;
+		double expire;	// Zero if never.
+	};
+
+	std::map<int, std::string> filter_texts;
+	int current_filter = -1;
+	std::vector<Shunt> shunts;
+	double next_shunt_expiry = 0;
+};
+
+} // namespace zeek::iosource::af_packet
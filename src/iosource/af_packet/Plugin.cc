@@ -0,0 +1,24 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "AF_Packet.h"
+#include "plugin/Plugin.h"
+#include "iosource/Component.h"
+
+namespace zeek::plugin::detail::Zeek_AF_Packet {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure() override
+		{
+		AddComponent(new iosource::PktSrcComponent(
+			             "AF_PacketReader", "af_packet", iosource::PktSrcComponent::LIVE,
+			             iosource::af_packet::AF_PacketSource::Instantiate));
+
+		plugin::Configuration config;
+		config.name = "Zeek::AF_Packet";
+		config.description = "Packet acquisition via AF_PACKET with TPACKET_V3 rings";
+		return config;
+		}
+} plugin;
+
+} // namespace zeek::plugin::detail::Zeek_AF_Packet
@@ -0,0 +1,200 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "RX_Ring.h"
+
+#include <cstring>
+#include <cerrno>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace zeek::iosource::af_packet::detail {
+
+RX_Ring::RX_Ring(int sock, size_t bufsize, size_t blocksize, int blocktimeout_msec)
+	{
+	int ret;
+	InitLayout(bufsize, blocksize, blocktimeout_msec);
+
+	ret = setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &layout, sizeof(layout));
+
+	if ( ret == -1 )
+		throw RX_RingException(std::string("unable to set ring layout: ") + strerror(errno));
+
+	// Map the ring into memory.
+	size = static_cast<size_t>(layout.tp_block_size) * layout.tp_block_nr;
+	void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+	                 MAP_SHARED | MAP_LOCKED | MAP_NORESERVE, sock, 0);
+
+	if ( mem == MAP_FAILED )
+		{
+		// MAP_LOCKED requires enough RLIMIT_MEMLOCK; retry without.
+		mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+		           MAP_SHARED | MAP_NORESERVE, sock, 0);
+
+		if ( mem == MAP_FAILED )
+			throw RX_RingException(std::string("unable to map ring memory: ") + strerror(errno));
+		}
+
+	ring = static_cast<uint8_t*>(mem);
+
+	blocks = new tpacket_block_desc*[layout.tp_block_nr];
+
+	buffers.reserve(layout.tp_block_nr);
+
+	for ( unsigned int i = 0; i < layout.tp_block_nr; i++ )
+		{
+		blocks[i] = reinterpret_cast<tpacket_block_desc*>(ring + i * layout.tp_block_size);
+		buffers.push_back(new BlockBuffer(this, i, ring + i * layout.tp_block_size,
+		                                  layout.tp_block_size));
+		}
+
+	num_pinned = 0;
+	block_num = 0;
+	read_num = 0;
+	release_num = 0;
+	packet = nullptr;
+	}
+
+RX_Ring::~RX_Ring()
+	{
+	// Blocks still pinned keep their part of the mapping alive; the
+	// buffer unmaps it once the last reference goes away.
+	for ( auto b : buffers )
+		{
+		if ( b->RefCnt() > 0 )
+			b->ring = nullptr;
+		else
+			{
+			munmap(const_cast<u_char*>(b->Data()), b->Size());
+			delete b;
+			}
+		}
+
+	buffers.clear();
+	delete [] blocks;
+
+	blocks = nullptr;
+	size = 0;
+	}
+
+bool RX_Ring::GetNextPacket(tpacket3_hdr** hdr)
+	{
+	struct tpacket_hdr_v1* block_hdr = &(blocks[block_num]->hdr.bh1);
+
+	if ( (block_hdr->block_status & TP_STATUS_USER) == 0 )
+		return false;
+
+	if ( read_num == 0 )
+		{
+		// Still pinned from its previous round through the ring.
+		if ( buffers[block_num]->RefCnt() > 0 )
+			return false;
+
+		if ( block_hdr->num_pkts == 0 )
+			{
+			// A retired but empty block; give it back right away.
+			NextBlock();
+			return false;
+			}
+
+		// New block: start with its first packet.
+		packet = reinterpret_cast<tpacket3_hdr*>(
+			reinterpret_cast<uint8_t*>(blocks[block_num]) + block_hdr->offset_to_first_pkt);
+		}
+
+	else if ( read_num >= block_hdr->num_pkts )
+		// Everything handed out already, waiting for releases.
+		return false;
+
+	*hdr = packet;
+
+	if ( ++read_num < block_hdr->num_pkts )
+		packet = reinterpret_cast<tpacket3_hdr*>(
+			reinterpret_cast<uint8_t*>(packet) + packet->tp_next_offset);
+
+	return true;
+	}
+
+void RX_Ring::ReleasePacket()
+	{
+	struct tpacket_hdr_v1* block_hdr = &(blocks[block_num]->hdr.bh1);
+
+	if ( release_num >= read_num )
+		return;
+
+	if ( ++release_num == block_hdr->num_pkts )
+		NextBlock();
+	}
+
+void RX_Ring::InitLayout(size_t bufsize, size_t blocksize, int blocktimeout_msec)
+	{
+	memset(&layout, 0, sizeof(layout));
+	layout.tp_block_size = blocksize;
+	layout.tp_frame_size = TPACKET_ALIGNMENT << 7; // Seems to be irrelevant for V3
+	layout.tp_block_nr = bufsize / layout.tp_block_size;
+	layout.tp_frame_nr = (layout.tp_block_size / layout.tp_frame_size) * layout.tp_block_nr;
+	layout.tp_retire_blk_tov = blocktimeout_msec;
+	layout.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+	}
+
+void RX_Ring::NextBlock()
+	{
+	// Hand the whole block back to the kernel, unless some of its
+	// packet data is still pinned. In that case Unpinned() does so
+	// later.
+	if ( buffers[block_num]->RefCnt() > 0 )
+		++num_pinned;
+	else
+		ReturnBlock(block_num);
+
+	block_num = (block_num + 1) % layout.tp_block_nr;
+	read_num = 0;
+	release_num = 0;
+	packet = nullptr;
+	}
+
+void RX_Ring::ReturnBlock(unsigned int idx)
+	{
+	struct tpacket_hdr_v1* block_hdr = &(blocks[idx]->hdr.bh1);
+	__sync_synchronize();
+	block_hdr->block_status = TP_STATUS_KERNEL;
+	}
+
+bool RX_Ring::CanPin() const
+	{
+	// Leave at least half of the ring to the kernel, otherwise we start
+	// dropping packets. Beyond that, consumers need to copy.
+	return num_pinned < layout.tp_block_nr / 2;
+	}
+
+void RX_Ring::Unpinned(unsigned int idx)
+	{
+	// The block we're currently reading from goes back through
+	// NextBlock().
+	if ( idx == block_num && read_num > 0 )
+		return;
+
+	--num_pinned;
+	ReturnBlock(idx);
+	}
+
+bool BlockBuffer::Pinnable() const
+	{
+	return ring && ring->CanPin();
+	}
+
+void BlockBuffer::Release()
+	{
+	if ( ring )
+		{
+		ring->Unpinned(idx);
+		return;
+		}
+
+	munmap(const_cast<u_char*>(data), size);
+	delete this;
+	}
+
+} // namespace zeek::iosource::af_packet::detail
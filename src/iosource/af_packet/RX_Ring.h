@@ -0,0 +1,127 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+extern "C" {
+#include <linux/if_packet.h>
+}
+
+#include <stdexcept>
+#include <cstdint>
+#include <vector>
+
+#include "iosource/PacketBuffer.h"
+
+namespace zeek::iosource::af_packet::detail {
+
+/**
+ * Thrown by RX_Ring if the memory-mapped ring cannot be set up.
+ */
+class RX_RingException : public std::runtime_error {
+public:
+	explicit RX_RingException(const std::string& what_arg) : std::runtime_error(what_arg) {}
+};
+
+class RX_Ring;
+
+/**
+ * A reference to one block of the ring. Packets carry it so that their
+ * data can be pinned beyond DoneWithPacket(); the block goes back to
+ * the kernel only once all references are gone.
+ */
+class BlockBuffer : public PacketBuffer {
+public:
+	BlockBuffer(RX_Ring* arg_ring, unsigned int arg_idx, const u_char* data, uint64_t size)
+		: PacketBuffer(data, size, 0), ring(arg_ring), idx(arg_idx)
+		{ }
+
+	bool Pinnable() const override;
+
+protected:
+	void Release() override;
+
+private:
+	friend class RX_Ring;
+
+	RX_Ring* ring;	// Null once the ring has gone away.
+	unsigned int idx;
+};
+
+/**
+ * A memory-mapped TPACKET_V3 receive ring attached to an AF_PACKET
+ * socket. Packets are handed out one at a time, but ownership of the
+ * ring memory is returned to the kernel one block at a time once all
+ * packets of the block have been consumed.
+ */
+class RX_Ring {
+public:
+	/**
+	 * Sets up the ring on the given socket and maps it into memory.
+	 * Throws RX_RingException on failure.
+	 *
+	 * @param sock An AF_PACKET socket already switched to TPACKET_V3.
+	 *
+	 * @param bufsize The total size of the ring in bytes.
+	 *
+	 * @param blocksize The size of an individual block in bytes. Must
+	 * be a multiple of the page size.
+	 *
+	 * @param blocktimeout_msec Timeout after which the kernel retires a
+	 * block even if it hasn't filled up yet.
+	 */
+	RX_Ring(int sock, size_t bufsize, size_t blocksize, int blocktimeout_msec);
+	~RX_Ring();
+
+	RX_Ring(const RX_Ring&) = delete;
+	RX_Ring& operator=(const RX_Ring&) = delete;
+
+	/**
+	 * Returns the next packet header from the current block, or false
+	 * if the kernel hasn't filled in any more packets yet. Several
+	 * packets may be retrieved before releasing them, but never more
+	 * than the current block holds. The returned header and its data
+	 * remain valid until the packet is released.
+	 */
+	bool GetNextPacket(tpacket3_hdr** hdr);
+
+	/**
+	 * Signals that the oldest packet returned by GetNextPacket() has
+	 * been processed. Once the last packet of a block is released, the
+	 * whole block is handed back to the kernel.
+	 */
+	void ReleasePacket();
+
+	/**
+	 * Returns a new reference to the block holding the packets
+	 * currently handed out.
+	 */
+	PacketBufferPtr CurrentBlock() const
+		{ return {NewRef{}, buffers[block_num]}; }
+
+protected:
+	friend class BlockBuffer;
+
+	void InitLayout(size_t bufsize, size_t blocksize, int blocktimeout_msec);
+	void NextBlock();
+	void ReturnBlock(unsigned int idx);
+
+	// Callbacks from BlockBuffer.
+	bool CanPin() const;
+	void Unpinned(unsigned int idx);
+
+private:
+	struct tpacket_req3 layout;
+	struct tpacket_block_desc** blocks;
+	std::vector<BlockBuffer*> buffers;
+	unsigned int num_pinned;	// Consumed blocks still referenced.
+	struct tpacket3_hdr* packet;
+
+	unsigned int block_num;
+	unsigned int read_num;		// Packets handed out from the current block.
+	unsigned int release_num;	// Packets released from the current block.
+
+	uint8_t* ring;
+	size_t size;
+};
+
+} // namespace zeek::iosource::af_packet::detail
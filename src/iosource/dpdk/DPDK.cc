@@ -0,0 +1,698 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "DPDK.h"
+
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_mbuf_dyn.h>
+
+#include <cstring>
+#include <new>
+
+#include <sys/time.h>
+
+#include "ID.h"
+#include "RunState.h"
+#include "Val.h"
+#include "Reporter.h"
+
+namespace zeek::iosource::dpdk {
+
+// A Toeplitz key that hashes both directions of a flow the same, see
+// "Scalable TCP Session Monitoring with Symmetric Receive-side Scaling"
+// by Woo and Park.
+static uint8_t symmetric_rss_key[40] = {
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+};
+
+namespace detail {
+
+bool MbufBuffer::Pinnable() const
+	{
+	// Leave most of the pool to the NIC, otherwise it starts dropping
+	// packets. Beyond that, consumers need to copy.
+	return rte_mempool_avail_count(mbuf->pool) > mbuf->pool->size / 4;
+	}
+
+void MbufBuffer::Release()
+	{
+	rte_mbuf* m = mbuf;
+	this->~MbufBuffer();
+	rte_pktmbuf_free(m);
+	}
+
+} // namespace detail
+
+DPDKSource::~DPDKSource()
+	{
+	Close();
+	}
+
+DPDKSource::DPDKSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	}
+
+bool DPDKSource::ParsePath()
+	{
+	// "<port>[:<queue>]", where the port may be a device name with
+	// colons of its own, like a PCI address.
+	port_name = props.path;
+	queue = 0;
+
+	auto i = port_name.rfind(':');
+
+	if ( i != std::string::npos )
+		{
+		std::string q = port_name.substr(i + 1);
+
+		if ( q.compare(0, 5, "queue") == 0 )
+			q = q.substr(5);
+
+		if ( ! q.empty() && q.find_first_not_of("0123456789") == std::string::npos )
+			{
+			queue = static_cast<uint16_t>(std::stoul(q));
+			port_name = port_name.substr(0, i);
+			}
+		}
+
+	return ! port_name.empty();
+	}
+
+bool DPDKSource::InitEAL()
+	{
+	// The EAL can only be initialized once per process, and keeps
+	// referring to its arguments.
+	static bool initialized = false;
+	static std::vector<std::string> args;
+	static std::vector<char*> argv;
+
+	if ( initialized )
+		return true;
+
+	args.emplace_back("zeek");
+
+	auto eal_args = id::find_val<VectorVal>("DPDK::eal_args");
+
+	for ( unsigned int i = 0; i < eal_args->Size(); ++i )
+		args.emplace_back(eal_args->At(i)->AsString()->CheckString());
+
+	for ( auto& a : args )
+		argv.push_back(a.data());
+
+	argv.push_back(nullptr);
+
+	if ( rte_eal_init(static_cast<int>(args.size()), argv.data()) < 0 )
+		{
+		Error(util::fmt("unable to initialize DPDK: %s", rte_strerror(rte_errno)));
+		return false;
+		}
+
+	initialized = true;
+	return true;
+	}
+
+bool DPDKSource::LookupPort()
+	{
+	std::string id = port_name;
+
+	if ( id.compare(0, 4, "port") == 0 )
+		id = id.substr(4);
+
+	if ( ! id.empty() && id.find_first_not_of("0123456789") == std::string::npos )
+		port = static_cast<uint16_t>(std::stoul(id));
+
+	else if ( rte_eth_dev_get_port_by_name(port_name.c_str(), &port) != 0 )
+		return false;
+
+	return rte_eth_dev_is_valid_port(port);
+	}
+
+bool DPDKSource::SetupPort()
+	{
+	uint16_t num_queues = id::find_val("DPDK::num_queues")->AsCount();
+	uint16_t num_rxd = id::find_val("DPDK::ring_size")->AsCount();
+	uint16_t num_txd = 64;
+	unsigned int num_mbufs = id::find_val("DPDK::num_mbufs")->AsCount();
+	bool strip_vlan = id::find_val("DPDK::strip_vlan")->AsBool();
+	bool hw_timestamps = id::find_val("DPDK::hw_timestamps")->AsBool();
+
+	struct rte_eth_dev_info info;
+
+	if ( rte_eth_dev_info_get(port, &info) != 0 )
+		{
+		Error(util::fmt("unable to query DPDK port %u", port));
+		return false;
+		}
+
+	struct rte_eth_conf conf;
+	memset(&conf, 0, sizeof(conf));
+
+	// RSS spreads flows across the queues, and gives us a flow hash even
+	// with just one.
+	uint64_t rss_hf = (RTE_ETH_RSS_IP | RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP) & info.flow_type_rss_offloads;
+
+	if ( rss_hf )
+		{
+		conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+		conf.rx_adv_conf.rss_conf.rss_key = symmetric_rss_key;
+		conf.rx_adv_conf.rss_conf.rss_key_len = sizeof(symmetric_rss_key);
+		conf.rx_adv_conf.rss_conf.rss_hf = rss_hf;
+
+		if ( info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_RSS_HASH )
+			conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_RSS_HASH;
+		}
+
+	else if ( num_queues > 1 )
+		{
+		Error(util::fmt("DPDK port %u doesn't support RSS across queues", port));
+		return false;
+		}
+
+	if ( strip_vlan && (info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_VLAN_STRIP) )
+		conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_VLAN_STRIP;
+
+	// Drivers look for the timestamp field when setting up queues.
+	if ( hw_timestamps && (info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_TIMESTAMP) &&
+	     rte_mbuf_dyn_rx_timestamp_register(&timestamp_offset, &timestamp_flag) == 0 )
+		conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+
+	// We never transmit, but not all drivers can do without a TX queue.
+	int rc = rte_eth_dev_configure(port, num_queues, 1, &conf);
+
+	if ( rc == 0 )
+		rc = rte_eth_dev_adjust_nb_rx_tx_desc(port, &num_rxd, &num_txd);
+
+	if ( rc != 0 )
+		{
+		Error(util::fmt("unable to configure DPDK port %u: %s", port, rte_strerror(-rc)));
+		return false;
+		}
+
+	int socket = rte_eth_dev_socket_id(port);
+
+	// Each queue gets its own pool, with room for our buffer in front of
+	// every mbuf.
+	auto priv_size = RTE_ALIGN(sizeof(detail::MbufBuffer), RTE_MBUF_PRIV_ALIGN);
+
+	for ( uint16_t q = 0; q < num_queues; ++q )
+		{
+		auto name = util::fmt("zeek_rx_%u_%u", port, q);
+		auto pool = rte_mempool_lookup(name);
+
+		if ( ! pool )
+			pool = rte_pktmbuf_pool_create(name, num_mbufs, RTE_MEMPOOL_CACHE_MAX_SIZE,
+			                               priv_size, RTE_MBUF_DEFAULT_BUF_SIZE, socket);
+
+		if ( ! pool )
+			{
+			Error(util::fmt("unable to create mbuf pool for DPDK port %u: %s", port,
+			                rte_strerror(rte_errno)));
+			return false;
+			}
+
+		struct rte_eth_rxconf rxconf = info.default_rxconf;
+		rxconf.offloads = conf.rxmode.offloads;
+
+		rc = rte_eth_rx_queue_setup(port, q, num_rxd, socket, &rxconf, pool);
+
+		if ( rc != 0 )
+			{
+			Error(util::fmt("unable to set up queue %u of DPDK port %u: %s", q, port,
+			                rte_strerror(-rc)));
+			return false;
+			}
+		}
+
+	rc = rte_eth_tx_queue_setup(port, 0, num_txd, socket, nullptr);
+
+	if ( rc == 0 )
+		rc = rte_eth_dev_start(port);
+
+	if ( rc != 0 )
+		{
+		Error(util::fmt("unable to start DPDK port %u: %s", port, rte_strerror(-rc)));
+		return false;
+		}
+
+	if ( id::find_val("DPDK::promisc")->AsBool() && rte_eth_promiscuous_enable(port) != 0 )
+		reporter->Warning("unable to enable promiscuous mode on DPDK port %u", port);
+
+	return true;
+	}
+
+void DPDKSource::SetupTimestamps()
+	{
+	if ( ! id::find_val("DPDK::hw_timestamps")->AsBool() )
+		return;
+
+	if ( rte_mbuf_dyn_rx_timestamp_register(&timestamp_offset, &timestamp_flag) != 0 )
+		{
+		reporter->Warning("DPDK port %u: hardware timestamps not available", port);
+		timestamp_offset = -1;
+		return;
+		}
+
+	// The NIC stamps packets with ticks of its own clock. Work out its
+	// rate and offset against ours.
+	uint64_t c0, c1;
+	struct timeval t0, t1;
+
+	gettimeofday(&t0, nullptr);
+
+	if ( rte_eth_read_clock(port, &c0) != 0 )
+		{
+		reporter->Warning("DPDK port %u: unable to read the NIC clock, not using hardware timestamps", port);
+		timestamp_offset = -1;
+		return;
+		}
+
+	rte_delay_ms(100);
+	rte_eth_read_clock(port, &c1);
+	gettimeofday(&t1, nullptr);
+
+	time_base = t0.tv_sec + t0.tv_usec / 1e6;
+	clock_base = c0;
+	clock_hz = (c1 - c0) / ((t1.tv_sec + t1.tv_usec / 1e6) - time_base);
+
+	if ( clock_hz <= 0 )
+		timestamp_offset = -1;
+	}
+
+void DPDKSource::SetupXStats()
+	{
+	// These are the generic ones every driver provides.
+	static const char* names[NUM_XSTATS] = {
+		"rx_good_packets", "rx_missed_errors", "rx_mbuf_allocation_errors"
+	};
+
+	have_xstats = true;
+
+	for ( int i = 0; i < NUM_XSTATS; ++i )
+		if ( rte_eth_xstats_get_id_by_name(port, names[i], &xstat_ids[i]) != 0 )
+			have_xstats = false;
+	}
+
+void DPDKSource::Open()
+	{
+	if ( ! ParsePath() )
+		{
+		Error(util::fmt("invalid DPDK interface '%s', expected <port>[:<queue>]", props.path.c_str()));
+		return;
+		}
+
+	if ( ! InitEAL() )
+		return;
+
+	if ( ! LookupPort() )
+		{
+		Error(util::fmt("no DPDK port '%s'", port_name.c_str()));
+		return;
+		}
+
+	// Only the primary process owns the port's configuration, others
+	// just read from their queue.
+	if ( rte_eal_process_type() == RTE_PROC_PRIMARY && ! SetupPort() )
+		return;
+
+	struct rte_eth_dev_info info;
+
+	if ( rte_eth_dev_info_get(port, &info) != 0 || queue >= info.nb_rx_queues )
+		{
+		Error(util::fmt("DPDK port %u has no queue %u", port, queue));
+		return;
+		}
+
+	SetupTimestamps();
+	SetupXStats();
+
+	burst.resize(id::find_val("DPDK::burst_size")->AsCount());
+	burst_len = burst_pos = 0;
+
+	props.netmask = NETMASK_UNKNOWN;
+	props.selectable_fd = -1;
+	props.is_live = true;
+	props.link_type = DLT_EN10MB;
+	props.batch_size = burst.size();
+
+	stats.received = stats.dropped = stats.link = stats.bytes_received = 0;
+
+	is_open = true;
+	Opened(props);
+	}
+
+void DPDKSource::Close()
+	{
+	if ( ! is_open )
+		return;
+
+	DestroyShunts();
+
+	// The port keeps running for other processes sharing it.
+	for ( ; burst_pos < burst_len; ++burst_pos )
+		rte_pktmbuf_free(burst[burst_pos]);
+
+	burst_len = burst_pos = 0;
+	is_open = false;
+
+	Closed();
+	}
+
+void DPDKSource::FillPacket(Packet* pkt, rte_mbuf* m)
+	{
+	pkt_timeval ts = burst_time;
+	bool hw_ts = timestamp_offset >= 0 && (m->ol_flags & timestamp_flag);
+
+	if ( hw_ts )
+		{
+		auto ticks = *RTE_MBUF_DYNFIELD(m, timestamp_offset, rte_mbuf_timestamp_t*);
+		double t = time_base + (double(ticks) - double(clock_base)) / clock_hz;
+		ts.tv_sec = static_cast<time_t>(t);
+		ts.tv_usec = static_cast<suseconds_t>((t - ts.tv_sec) * 1e6);
+		}
+
+	if ( m->nb_segs == 1 )
+		{
+		// The packet's buffer holds the mbuf from here on.
+		auto b = new (rte_mbuf_to_priv(m)) detail::MbufBuffer(m);
+		pkt->Init(props.link_type, &ts, rte_pktmbuf_data_len(m), rte_pktmbuf_pkt_len(m),
+		          b->Data());
+		pkt->buffer = {NewRef{}, b};
+		}
+
+	else
+		{
+		// Jumbo frames may span several mbufs. Those are rare enough to
+		// just copy.
+		uint32_t len = rte_pktmbuf_pkt_len(m);
+		scratch.resize(len);
+		auto data = static_cast<const u_char*>(rte_pktmbuf_read(m, 0, len, scratch.data()));
+		pkt->Init(props.link_type, &ts, len, len, data, true);
+		}
+
+	auto& meta = pkt->meta;
+
+	if ( m->ol_flags & RTE_MBUF_F_RX_RSS_HASH )
+		{
+		meta.flow_hash = m->hash.rss;
+		meta.have_flow_hash = true;
+		meta.symmetric_flow_hash = true;
+		}
+
+	if ( m->ol_flags & RTE_MBUF_F_RX_QINQ_STRIPPED )
+		{
+		meta.stripped_vlan = m->vlan_tci_outer & 0x0fff;
+		meta.stripped_inner_vlan = m->vlan_tci & 0x0fff;
+		}
+
+	else if ( m->ol_flags & RTE_MBUF_F_RX_VLAN_STRIPPED )
+		meta.stripped_vlan = m->vlan_tci & 0x0fff;
+
+	meta.hardware_timestamp = hw_ts;
+
+	if ( m->nb_segs != 1 )
+		rte_pktmbuf_free(m);
+	}
+
+bool DPDKSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( ! is_open )
+		return false;
+
+	while ( true )
+		{
+		if ( burst_pos == burst_len )
+			{
+			burst_len = rte_eth_rx_burst(port, queue, burst.data(), burst.size());
+			burst_pos = 0;
+
+			if ( burst_len == 0 )
+				return false;
+
+			gettimeofday(&burst_time, nullptr);
+
+			if ( next_shunt_expiry && burst_time.tv_sec >= next_shunt_expiry )
+				ExpireShunts(burst_time.tv_sec + burst_time.tv_usec / 1e6);
+			}
+
+		FillPacket(pkt, burst[burst_pos++]);
+
+		// There's no kernel to filter for us.
+		if ( current_filter >= 0 )
+			{
+			struct pcap_pkthdr hdr;
+			hdr.ts = pkt->ts;
+			hdr.caplen = pkt->cap_len;
+			hdr.len = pkt->len;
+
+			if ( ! ApplyBPFFilter(current_filter, &hdr, pkt->data) )
+				{
+				pkt->buffer = nullptr;
+
+				if ( ! is_open )
+					return false;
+
+				continue;
+				}
+			}
+
+		++stats.received;
+		stats.bytes_received += pkt->len;
+		return true;
+		}
+	}
+
+void DPDKSource::DoneWithPacket()
+	{
+	// Nothing to do, the mbuf goes back to its pool once the packet's
+	// buffer is gone.
+	}
+
+bool DPDKSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	return PktSrc::PrecompileBPFFilter(index, filter);
+	}
+
+bool DPDKSource::SetFilter(int index)
+	{
+	if ( ! GetBPFFilter(index) )
+		{
+		Error(util::fmt("No precompiled filter for index %d", index));
+		return false;
+		}
+
+	current_filter = index;
+	return true;
+	}
+
+rte_flow* DPDKSource::CreateDropRule(const ConnTuple& t, bool reverse)
+	{
+	const IPAddr& src = reverse ? t.dst_addr : t.src_addr;
+	const IPAddr& dst = reverse ? t.src_addr : t.dst_addr;
+	uint16_t src_port = reverse ? t.dst_port : t.src_port;
+	uint16_t dst_port = reverse ? t.src_port : t.dst_port;
+
+	rte_flow_item pattern[4];
+	memset(pattern, 0, sizeof(pattern));
+	pattern[0].type = RTE_FLOW_ITEM_TYPE_ETH;
+
+	rte_flow_item_ipv4 ip4_spec, ip4_mask;
+	rte_flow_item_ipv6 ip6_spec, ip6_mask;
+	memset(&ip4_spec, 0, sizeof(ip4_spec));
+	memset(&ip4_mask, 0, sizeof(ip4_mask));
+	memset(&ip6_spec, 0, sizeof(ip6_spec));
+	memset(&ip6_mask, 0, sizeof(ip6_mask));
+
+	uint8_t proto = t.proto == TRANSPORT_TCP ? IPPROTO_TCP :
+	                t.proto == TRANSPORT_UDP ? IPPROTO_UDP : 0;
+
+	if ( src.GetFamily() == IPv4 )
+		{
+		const uint32_t* bytes;
+		src.GetBytes(&bytes);
+		ip4_spec.hdr.src_addr = bytes[0];
+		dst.GetBytes(&bytes);
+		ip4_spec.hdr.dst_addr = bytes[0];
+		ip4_mask.hdr.src_addr = ip4_mask.hdr.dst_addr = 0xffffffff;
+
+		if ( t.proto == TRANSPORT_ICMP )
+			proto = IPPROTO_ICMP;
+
+		ip4_spec.hdr.next_proto_id = proto;
+		ip4_mask.hdr.next_proto_id = proto ? 0xff : 0;
+
+		pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
+		pattern[1].spec = &ip4_spec;
+		pattern[1].mask = &ip4_mask;
+		}
+	else
+		{
+		src.CopyIPv6(reinterpret_cast<in6_addr*>(&ip6_spec.hdr.src_addr));
+		dst.CopyIPv6(reinterpret_cast<in6_addr*>(&ip6_spec.hdr.dst_addr));
+		memset(&ip6_mask.hdr.src_addr, 0xff, sizeof(ip6_mask.hdr.src_addr));
+		memset(&ip6_mask.hdr.dst_addr, 0xff, sizeof(ip6_mask.hdr.dst_addr));
+
+		if ( t.proto == TRANSPORT_ICMP )
+			proto = IPPROTO_ICMPV6;
+
+		ip6_spec.hdr.proto = proto;
+		ip6_mask.hdr.proto = proto ? 0xff : 0;
+
+		pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV6;
+		pattern[1].spec = &ip6_spec;
+		pattern[1].mask = &ip6_mask;
+		}
+
+	rte_flow_item_tcp tcp_spec, tcp_mask;
+	rte_flow_item_udp udp_spec, udp_mask;
+	memset(&tcp_spec, 0, sizeof(tcp_spec));
+	memset(&tcp_mask, 0, sizeof(tcp_mask));
+	memset(&udp_spec, 0, sizeof(udp_spec));
+	memset(&udp_mask, 0, sizeof(udp_mask));
+
+	if ( t.proto == TRANSPORT_TCP )
+		{
+		tcp_spec.hdr.src_port = rte_cpu_to_be_16(src_port);
+		tcp_spec.hdr.dst_port = rte_cpu_to_be_16(dst_port);
+		tcp_mask.hdr.src_port = tcp_mask.hdr.dst_port = 0xffff;
+		pattern[2].type = RTE_FLOW_ITEM_TYPE_TCP;
+		pattern[2].spec = &tcp_spec;
+		pattern[2].mask = &tcp_mask;
+		pattern[3].type = RTE_FLOW_ITEM_TYPE_END;
+		}
+	else if ( t.proto == TRANSPORT_UDP )
+		{
+		udp_spec.hdr.src_port = rte_cpu_to_be_16(src_port);
+		udp_spec.hdr.dst_port = rte_cpu_to_be_16(dst_port);
+		udp_mask.hdr.src_port = udp_mask.hdr.dst_port = 0xffff;
+		pattern[2].type = RTE_FLOW_ITEM_TYPE_UDP;
+		pattern[2].spec = &udp_spec;
+		pattern[2].mask = &udp_mask;
+		pattern[3].type = RTE_FLOW_ITEM_TYPE_END;
+		}
+	else
+		pattern[2].type = RTE_FLOW_ITEM_TYPE_END;
+
+	rte_flow_action actions[2];
+	memset(actions, 0, sizeof(actions));
+	actions[0].type = RTE_FLOW_ACTION_TYPE_DROP;
+	actions[1].type = RTE_FLOW_ACTION_TYPE_END;
+
+	rte_flow_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.ingress = 1;
+
+	rte_flow_error error;
+	rte_flow* flow = rte_flow_create(port, &attr, pattern, actions, &error);
+
+	if ( ! flow )
+		reporter->Warning("DPDK port %s cannot shunt flow: %s", port_name.c_str(),
+		                  error.message ? error.message : rte_strerror(rte_errno));
+
+	return flow;
+	}
+
+bool DPDKSource::ShuntFlow(const ConnTuple& tuple, double timeout)
+	{
+	if ( ! is_open )
+		return false;
+
+	// Flow rules apply to the whole port, so this also takes the flow
+	// away from processes reading other queues, which is what we want:
+	// with symmetric RSS it doesn't reach them anyway.
+	rte_flow* fwd = CreateDropRule(tuple, false);
+
+	if ( ! fwd )
+		return false;
+
+	rte_flow* rev = CreateDropRule(tuple, true);
+
+	if ( ! rev )
+		{
+		rte_flow_error error;
+		rte_flow_destroy(port, fwd, &error);
+		return false;
+		}
+
+	double expire = timeout > 0 ? run_state::network_time + timeout : 0;
+	shunts.push_back({{fwd, rev}, expire});
+
+	if ( expire && (! next_shunt_expiry || expire < next_shunt_expiry) )
+		next_shunt_expiry = expire;
+
+	return true;
+	}
+
+void DPDKSource::ExpireShunts(double t)
+	{
+	next_shunt_expiry = 0;
+	rte_flow_error error;
+
+	for ( auto it = shunts.begin(); it != shunts.end(); )
+		{
+		if ( it->expire && it->expire <= t )
+			{
+			rte_flow_destroy(port, it->flows[0], &error);
+			rte_flow_destroy(port, it->flows[1], &error);
+			it = shunts.erase(it);
+			continue;
+			}
+
+		if ( it->expire && (! next_shunt_expiry || it->expire < next_shunt_expiry) )
+			next_shunt_expiry = it->expire;
+
+		++it;
+		}
+	}
+
+void DPDKSource::DestroyShunts()
+	{
+	rte_flow_error error;
+
+	for ( auto& s : shunts )
+		{
+		rte_flow_destroy(port, s.flows[0], &error);
+		rte_flow_destroy(port, s.flows[1], &error);
+		}
+
+	shunts.clear();
+	next_shunt_expiry = 0;
+	}
+
+void DPDKSource::Statistics(Stats* s)
+	{
+	if ( ! is_open )
+		{
+		s->received = s->dropped = s->link = s->bytes_received = 0;
+		return;
+		}
+
+	// Drops and the link count are for the whole port, across all of its
+	// queues.
+	uint64_t values[NUM_XSTATS];
+
+	if ( have_xstats && rte_eth_xstats_get_by_id(port, xstat_ids, values, NUM_XSTATS) == NUM_XSTATS )
+		{
+		stats.dropped = values[XSTAT_MISSED] + values[XSTAT_NO_MBUF];
+		stats.link = values[XSTAT_GOOD] + stats.dropped;
+		}
+
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->dropped = stats.dropped;
+	s->link = stats.link;
+	}
+
+iosource::PktSrc* DPDKSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new DPDKSource(path, is_live);
+	}
+
+} // namespace zeek::iosource::dpdk
@@ -0,0 +1,126 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <rte_ethdev.h>
+#include <rte_flow.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iosource/PktSrc.h"
+
+namespace zeek::iosource::dpdk {
+
+namespace detail {
+
+/**
+ * The buffer of a packet received into an mbuf. It lives in the mbuf's
+ * private area, so that handing out packets doesn't allocate. The mbuf
+ * goes back to its pool once the last reference is gone.
+ */
+class MbufBuffer : public PacketBuffer {
+public:
+	explicit MbufBuffer(rte_mbuf* arg_mbuf)
+		: PacketBuffer(rte_pktmbuf_mtod(arg_mbuf, const u_char*),
+		               rte_pktmbuf_data_len(arg_mbuf), 0),
+		  mbuf(arg_mbuf)
+		{ }
+
+	bool Pinnable() const override;
+
+protected:
+	void Release() override;
+
+private:
+	rte_mbuf* mbuf;
+};
+
+} // namespace detail
+
+/**
+ * Packet source polling one receive queue of a DPDK port, bypassing the
+ * kernel. Interfaces are given as ``dpdk::<port>[:<queue>]``, e.g.
+ * ``zeek -i dpdk::port0:queue3`` or ``zeek -i dpdk::0:3``. Packets stay
+ * in their mbufs until processed.
+ *
+ * Several Zeek processes can share a port by reading from different
+ * queues as DPDK multi-process instances: the first one to start sets
+ * up the port and all of its queues. Configuration happens through the
+ * options in the ``DPDK`` script module, see ``init-bare.zeek``.
+ */
+class DPDKSource : public PktSrc {
+public:
+	DPDKSource(const std::string& path, bool is_live);
+	~DPDKSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	bool ShuntFlow(const ConnTuple& tuple, double timeout) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	bool ParsePath();
+	bool InitEAL();
+	bool LookupPort();
+	bool SetupPort();
+	void SetupTimestamps();
+	void SetupXStats();
+	void FillPacket(Packet* pkt, rte_mbuf* m);
+	rte_flow* CreateDropRule(const ConnTuple& tuple, bool reverse);
+	void ExpireShunts(double t);
+	void DestroyShunts();
+
+	Properties props;
+	Stats stats;
+
+	std::string port_name;
+	uint16_t port = 0;
+	uint16_t queue = 0;
+	bool is_open = false;
+	int current_filter = -1;
+
+	// Received mbufs not yet handed out, and the time they arrived at
+	// unless the NIC timestamps them.
+	std::vector<rte_mbuf*> burst;
+	size_t burst_len = 0;
+	size_t burst_pos = 0;
+	pkt_timeval burst_time;
+
+	// For copying packets spanning several mbufs.
+	std::vector<u_char> scratch;
+
+	// For turning NIC clock ticks into timestamps, if enabled.
+	int timestamp_offset = -1;
+	uint64_t timestamp_flag = 0;
+	uint64_t clock_base = 0;
+	double time_base = 0.0;
+	double clock_hz = 0.0;
+
+	// The port-wide extended statistics we report.
+	enum { XSTAT_GOOD, XSTAT_MISSED, XSTAT_NO_MBUF, NUM_XSTATS };
+	uint64_t xstat_ids[NUM_XSTATS];
+	bool have_xstats = false;
+
+	// The NIC drops shunted flows, with one rule for each direction.
+	struct Shunt {
+		rte_flow* flows[2];
+		double expire;	// Zero if never.
+	};
+
+	std::vector<Shunt> shunts;
+	double next_shunt_expiry = 0;
+};
+
+} // namespace zeek::iosource::dpdk
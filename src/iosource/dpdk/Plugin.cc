@@ -0,0 +1,24 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "DPDK.h"
+#include "plugin/Plugin.h"
+#include "iosource/Component.h"
+
+namespace zeek::plugin::detail::Zeek_DPDK {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure() override
+		{
+		AddComponent(new iosource::PktSrcComponent(
+			             "DPDKReader", "dpdk", iosource::PktSrcComponent::LIVE,
+			             iosource::dpdk::DPDKSource::Instantiate));
+
+		plugin::Configuration config;
+		config.name = "Zeek::DPDK";
+		config.description = "Packet acquisition via DPDK poll-mode drivers";
+		return config;
+		}
+} plugin;
+
+} // namespace zeek::plugin::detail::Zeek_DPDK
@@ -0,0 +1,376 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "AsyncDumper.h"
+#include "FlowShard.h"
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+
+#include "../Packet.h"
+#include "../../Reporter.h"
+#include "../../RunState.h"
+#include "../../Val.h"
+#include "../../ID.h"
+
+#include "pcap.bif.h"
+
+namespace zeek::iosource::pcap {
+
+// Writes and the ring stay aligned to this, as O_DIRECT requires.
+static constexpr uint64_t BLOCK_SIZE = 4096;
+
+// The largest single write.
+static constexpr uint64_t MAX_WRITE_SIZE = 1024 * 1024;
+
+// How long data may sit in the ring before it gets written regardless of
+// its amount.
+static constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(500);
+
+// The on-disk equivalents of pcap's file and packet headers.
+struct FileHeader {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+};
+
+struct RecordHeader {
+	uint32_t ts_sec;
+	uint32_t ts_usec;
+	uint32_t caplen;
+	uint32_t len;
+};
+
+PcapAsyncDumper::Stats PcapAsyncDumper::total_stats;
+
+// A ring with a single producer, the main thread, and a single consumer,
+// the writer thread. Head and tail count bytes ever put in and taken out.
+struct PcapAsyncDumper::Shard {
+	std::string path;
+	int fd = -1;
+	bool direct = false;
+
+	u_char* ring = nullptr;
+	uint64_t size = 0;
+	std::atomic<uint64_t> head{0};
+	std::atomic<uint64_t> tail{0};
+
+	// The head at the last wakeup of the writer, main thread only.
+	uint64_t notified = 0;
+
+	~Shard()
+		{
+		if ( fd >= 0 )
+			close(fd);
+
+		free(ring);
+		}
+};
+
+static uint64_t round_up(uint64_t n, uint64_t to)
+	{
+	return (n + to - 1) / to * to;
+	}
+
+// Inserts the shard number before the path's extension.
+static std::string shard_path(const std::string& path, size_t i)
+	{
+	auto dot = path.rfind('.');
+	auto slash = path.rfind('/');
+
+	if ( dot == std::string::npos || dot == 0 ||
+	     (slash != std::string::npos && dot < slash) )
+		return path + "." + std::to_string(i);
+
+	return path.substr(0, dot) + "." + std::to_string(i) + path.substr(dot);
+	}
+
+PcapAsyncDumper::PcapAsyncDumper(const std::string& path, bool arg_append)
+	{
+	append = arg_append;
+	props.path = path;
+	}
+
+PcapAsyncDumper::~PcapAsyncDumper()
+	{
+	Close();
+	}
+
+void PcapAsyncDumper::Open()
+	{
+	if ( props.path.empty() )
+		{
+		Error("no filename given");
+		return;
+		}
+
+	uint64_t num_shards = std::max(id::find_val("Pcap::async_dump_shards")->AsCount(), uint64_t(1));
+	uint64_t buffer_size = id::find_val("Pcap::async_dump_buffer_size")->AsCount();
+	uint64_t ring_size = round_up(std::max(buffer_size / num_shards, 4 * BLOCK_SIZE), BLOCK_SIZE);
+
+	write_size = std::max(std::min(MAX_WRITE_SIZE, ring_size / 4 / BLOCK_SIZE * BLOCK_SIZE), BLOCK_SIZE);
+
+	for ( uint64_t i = 0; i < num_shards; ++i )
+		{
+		auto s = std::make_unique<Shard>();
+		auto path = num_shards > 1 ? shard_path(props.path, i) : props.path;
+
+		if ( ! OpenShard(s.get(), path, ring_size) )
+			{
+			shards.clear();
+			return;
+			}
+
+		shards.push_back(std::move(s));
+		}
+
+	writer = std::thread(&PcapAsyncDumper::Run, this);
+
+	props.open_time = run_state::network_time;
+	Opened(props);
+	}
+
+bool PcapAsyncDumper::OpenShard(Shard* s, const std::string& path, uint64_t ring_size)
+	{
+	s->path = path;
+
+	struct stat st;
+	bool exists = false;
+
+	if ( append )
+		{
+		// See if output file already exists (and is non-empty).
+		if ( stat(path.c_str(), &st) == 0 )
+			exists = st.st_size > 0;
+
+		else if ( errno != ENOENT )
+			{
+			Error(util::fmt("can't stat file %s: %s", path.c_str(), strerror(errno)));
+			return false;
+			}
+		}
+
+	int flags = O_WRONLY | O_CREAT | (exists ? O_APPEND : O_TRUNC);
+
+#ifdef O_DIRECT
+	// Direct writes need block-aligned file offsets, which an existing
+	// file's end may not be.
+	if ( id::find_val("Pcap::async_dump_direct")->AsBool() &&
+	     (! exists || st.st_size % BLOCK_SIZE == 0) )
+		{
+		s->fd = open(path.c_str(), flags | O_DIRECT, 0666);
+
+		// Not all file systems support it.
+		s->direct = s->fd >= 0;
+		}
+#endif
+
+	if ( s->fd < 0 )
+		s->fd = open(path.c_str(), flags, 0666);
+
+	if ( s->fd < 0 )
+		{
+		Error(util::fmt("can't open dump %s: %s", path.c_str(), strerror(errno)));
+		return false;
+		}
+
+	void* ring;
+
+	if ( posix_memalign(&ring, BLOCK_SIZE, ring_size) != 0 )
+		{
+		Error(util::fmt("can't allocate %" PRIu64 " bytes of dump buffer", ring_size));
+		return false;
+		}
+
+	s->ring = static_cast<u_char*>(ring);
+	s->size = ring_size;
+
+	if ( ! exists )
+		{
+		FileHeader hdr = {0xa1b2c3d4, 2, 4, 0, 0,
+		                  static_cast<uint32_t>(BifConst::Pcap::snaplen), DLT_EN10MB};
+		Put(s, &hdr, sizeof(hdr));
+		}
+
+	return true;
+	}
+
+void PcapAsyncDumper::Close()
+	{
+	if ( shards.empty() )
+		return;
+
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+		}
+
+	cv.notify_one();
+	writer.join();
+
+	if ( stats.dropped )
+		reporter->Warning("dropped %" PRIu64 " of %" PRIu64 " packets written to %s because the dump buffer was full",
+		                  stats.dropped, stats.packets + stats.dropped, props.path.c_str());
+
+	if ( int err = write_errno.load() )
+		Error(util::fmt("write to %s failed: %s", props.path.c_str(), strerror(err)));
+
+	shards.clear();
+	Closed();
+	}
+
+size_t PcapAsyncDumper::ShardFor(const Packet* pkt) const
+	{
+	return flow_shard(pkt->link_type, pkt->data, pkt->cap_len, shards.size());
+	}
+
+bool PcapAsyncDumper::Put(Shard* s, const void* data, uint64_t len)
+	{
+	auto head = s->head.load(std::memory_order_relaxed);
+	auto tail = s->tail.load(std::memory_order_acquire);
+
+	if ( len > s->size - (head - tail) )
+		return false;
+
+	auto pos = head % s->size;
+	auto n = std::min(len, s->size - pos);
+	memcpy(s->ring + pos, data, n);
+	memcpy(s->ring, static_cast<const u_char*>(data) + n, len - n);
+
+	s->head.store(head + len, std::memory_order_release);
+	return true;
+	}
+
+bool PcapAsyncDumper::Dump(const Packet* pkt)
+	{
+	if ( shards.empty() )
+		return false;
+
+	if ( int err = write_errno.load(std::memory_order_relaxed) )
+		{
+		Error(util::fmt("write to %s failed: %s", props.path.c_str(), strerror(err)));
+		return false;
+		}
+
+	auto s = shards[ShardFor(pkt)].get();
+	uint64_t len = sizeof(RecordHeader) + pkt->cap_len;
+	auto head = s->head.load(std::memory_order_relaxed);
+
+	if ( len > s->size - (head - s->tail.load(std::memory_order_acquire)) )
+		{
+		// Dropping beats stalling the main loop on the disk.
+		++stats.dropped;
+		++total_stats.dropped;
+		return true;
+		}
+
+	RecordHeader hdr = {static_cast<uint32_t>(pkt->ts.tv_sec),
+	                    static_cast<uint32_t>(pkt->ts.tv_usec),
+	                    pkt->cap_len, pkt->len};
+	Put(s, &hdr, sizeof(hdr));
+	Put(s, pkt->data, pkt->cap_len);
+
+	++stats.packets;
+	++total_stats.packets;
+	stats.bytes += len;
+	total_stats.bytes += len;
+
+	if ( head + len - s->notified >= write_size )
+		{
+		s->notified = head + len;
+
+			{
+			std::lock_guard<std::mutex> lock(mutex);
+			wakeup = true;
+			}
+
+		cv.notify_one();
+		}
+
+	return true;
+	}
+
+void PcapAsyncDumper::Run()
+	{
+	for ( ;; )
+		{
+		bool stopping;
+		bool timed_out;
+
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+			timed_out = ! cv.wait_for(lock, FLUSH_INTERVAL, [this] { return wakeup || done; });
+			wakeup = false;
+			stopping = done;
+			}
+
+		for ( auto& s : shards )
+			{
+#ifdef O_DIRECT
+			// The tail end of the file won't be a full block.
+			if ( stopping && s->direct )
+				{
+				fcntl(s->fd, F_SETFL, fcntl(s->fd, F_GETFL) & ~O_DIRECT);
+				s->direct = false;
+				}
+#endif
+
+			Flush(s.get(), timed_out || stopping);
+			}
+
+		if ( stopping )
+			return;
+		}
+	}
+
+void PcapAsyncDumper::Flush(Shard* s, bool all)
+	{
+	auto tail = s->tail.load(std::memory_order_relaxed);
+	auto avail = s->head.load(std::memory_order_acquire) - tail;
+
+	if ( ! all && avail < write_size )
+		return;
+
+	while ( avail > 0 && ! write_errno.load(std::memory_order_relaxed) )
+		{
+		auto pos = tail % s->size;
+		auto n = std::min({avail, s->size - pos, MAX_WRITE_SIZE});
+
+		if ( s->direct )
+			{
+			n -= n % BLOCK_SIZE;
+
+			if ( n == 0 )
+				return;
+			}
+
+		auto rc = write(s->fd, s->ring + pos, n);
+
+		if ( rc < 0 )
+			{
+			if ( errno != EINTR )
+				write_errno = errno;
+
+			continue;
+			}
+
+		tail += rc;
+		avail -= rc;
+		s->tail.store(tail, std::memory_order_release);
+		}
+	}
+
+} // namespace zeek::iosource::pcap
@@ -0,0 +1,93 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../PktDumper.h"
+
+namespace zeek::iosource::pcap {
+
+/**
+ * A pcap dumper that keeps disk latency out of the main loop. Dump()
+ * only copies a packet into an in-memory ring, and a writer thread
+ * moves the ring's contents to disk in large, block-aligned writes,
+ * optionally with O_DIRECT. When the ring is full, packets get dropped
+ * and counted rather than stalling packet processing.
+ *
+ * With Pcap::async_dump_shards set, packets go into that many files
+ * instead of one, chosen by the packet's pair of IP addresses, so that
+ * all packets of a connection end up in the same file.
+ *
+ * PcapDumper::Instantiate() returns this dumper when Pcap::async_dump
+ * is set.
+ */
+class PcapAsyncDumper : public PktDumper {
+public:
+	struct Stats {
+		uint64_t packets = 0;	// Packets copied into the ring.
+		uint64_t bytes = 0;	// Bytes copied into the ring.
+		uint64_t dropped = 0;	// Packets dropped because the ring was full.
+	};
+
+	PcapAsyncDumper(const std::string& path, bool append);
+	~PcapAsyncDumper() override;
+
+	/**
+	 * Returns the dumper's statistics.
+	 */
+	const Stats& GetStats() const	{ return stats; }
+
+	/**
+	 * Returns the statistics summed over all asynchronous dumpers
+	 * ever opened.
+	 */
+	static const Stats& TotalStats()	{ return total_stats; }
+
+protected:
+	// PktDumper interface.
+	void Open() override;
+	void Close() override;
+	bool Dump(const Packet* pkt) override;
+
+private:
+	struct Shard;
+
+	bool OpenShard(Shard* s, const std::string& path, uint64_t ring_size);
+	size_t ShardFor(const Packet* pkt) const;
+	bool Put(Shard* s, const void* data, uint64_t len);
+
+	// The writer thread.
+	void Run();
+
+	// Writes the shard's pending data once there's at least a write's
+	// worth of it, or always if all is set. Called by the writer thread.
+	void Flush(Shard* s, bool all);
+
+	Properties props;
+	bool append;
+
+	std::vector<std::unique_ptr<Shard>> shards;
+	uint64_t write_size = 0;
+	Stats stats;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool wakeup = false;	// Protected by mutex.
+	bool done = false;	// Protected by mutex.
+
+	// Set by the writer thread when a write fails.
+	std::atomic<int> write_errno{0};
+
+	static Stats total_stats;
+};
+
+} // namespace zeek::iosource::pcap
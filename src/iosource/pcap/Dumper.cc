@@ -4,8 +4,11 @@
 #include <errno.h>
 
 #include "Dumper.h"
+#include "AsyncDumper.h"
 #include "../PktSrc.h"
 #include "../../RunState.h"
+#include "../../ID.h"
+#include "../../Val.h"
 
 #include "pcap.bif.h"
 
@@ -114,6 +117,9 @@ bool PcapDumper::Dump(const Packet* pkt)
 
 iosource::PktDumper* PcapDumper::Instantiate(const std::string& path, bool append)
 	{
+	if ( id::find_val("Pcap::async_dump")->AsBool() )
+		return new PcapAsyncDumper(path, append);
+
 	return new PcapDumper(path, append);
 	}
 
@@ -0,0 +1,94 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "FlowShard.h"
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include <algorithm>
+#include <cstring>
+
+namespace zeek::iosource::pcap {
+
+size_t flow_shard(int link_type, const u_char* p, uint32_t len, size_t num_shards)
+	{
+	if ( num_shards <= 1 )
+		return 0;
+
+	uint32_t ethertype;
+
+	if ( link_type == DLT_EN10MB )
+		{
+		if ( len < 14 )
+			return 0;
+
+		ethertype = (p[12] << 8) | p[13];
+		p += 14;
+		len -= 14;
+
+		while ( (ethertype == 0x8100 || ethertype == 0x88a8) && len >= 4 )
+			{
+			ethertype = (p[2] << 8) | p[3];
+			p += 4;
+			len -= 4;
+			}
+		}
+
+	else if ( link_type == DLT_LINUX_SLL )
+		{
+		if ( len < 16 )
+			return 0;
+
+		ethertype = (p[14] << 8) | p[15];
+		p += 16;
+		len -= 16;
+		}
+
+	else if ( (link_type == DLT_RAW || link_type == DLT_NULL) && len > 0 )
+		{
+		if ( link_type == DLT_NULL )
+			{
+			// The protocol family comes in host order, which isn't
+			// worth finding out. The IP version says it all.
+			if ( len <= 4 )
+				return 0;
+
+			p += 4;
+			len -= 4;
+			}
+
+		ethertype = (p[0] >> 4) == 6 ? 0x86dd : 0x0800;
+		}
+
+	else
+		return 0;
+
+	uint64_t a = 0;
+	uint64_t b = 0;
+
+	if ( ethertype == 0x0800 && len >= 20 )
+		{
+		uint32_t src, dst;
+		memcpy(&src, p + 12, 4);
+		memcpy(&dst, p + 16, 4);
+		a = src;
+		b = dst;
+		}
+
+	else if ( ethertype == 0x86dd && len >= 40 )
+		{
+		uint64_t w[4];
+		memcpy(w, p + 8, sizeof(w));
+		a = w[0] * 0x9e3779b97f4a7c15ULL ^ w[1];
+		b = w[2] * 0x9e3779b97f4a7c15ULL ^ w[3];
+		}
+
+	else
+		return 0;
+
+	uint64_t h = (std::min(a, b) * 0x9e3779b97f4a7c15ULL ^ std::max(a, b)) * 0x9e3779b97f4a7c15ULL;
+	return (h >> 32) % num_shards;
+	}
+
+} // namespace zeek::iosource::pcap
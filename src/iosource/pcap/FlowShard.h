@@ -0,0 +1,30 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+
+#include <cstddef>
+#include <cstdint>
+
+namespace zeek::iosource::pcap {
+
+/**
+ * Picks one of several shards for a packet by its pair of IP addresses,
+ * the same for both directions. Leaving out the ports keeps fragments
+ * with the rest of their connection.
+ *
+ * @param link_type The packet's DLT link type.
+ *
+ * @param data The packet, starting at the link layer.
+ *
+ * @param len The captured length of the packet.
+ *
+ * @param num_shards The number of shards.
+ *
+ * @return The shard, or 0 for packets that aren't IP or whose link
+ * layer isn't known.
+ */
+size_t flow_shard(int link_type, const u_char* data, uint32_t len, size_t num_shards);
+
+} // namespace zeek::iosource::pcap
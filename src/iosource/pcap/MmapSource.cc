@@ -0,0 +1,301 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "MmapSource.h"
+#include "FlowShard.h"
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "iosource/Packet.h"
+#include "iosource/BPF_Program.h"
+
+#include "Event.h"
+#include "Reporter.h"
+#include "util.h"
+
+#include "pcap.bif.h"
+
+namespace zeek::iosource::pcap {
+
+// The pcap file format's magic numbers, as they read in the byte order
+// of the writer.
+static constexpr uint32_t MAGIC_USECS = 0xa1b2c3d4;
+static constexpr uint32_t MAGIC_NSECS = 0xa1b23c4d;
+
+static constexpr size_t FILE_HEADER_SIZE = 24;
+static constexpr size_t RECORD_HEADER_SIZE = 16;
+
+// How far to ask the kernel to read ahead of the current position.
+static constexpr size_t READAHEAD = 16 * 1024 * 1024;
+
+PcapMmapSource::PcapMmapSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	}
+
+PcapMmapSource::~PcapMmapSource()
+	{
+	Close();
+	}
+
+void PcapMmapSource::Open()
+	{
+	if ( props.is_live )
+		{
+		Error("memory-mapped reading only works for trace files");
+		return;
+		}
+
+	util::tokenize_string(props.path, ":", &files);
+
+	if ( files.empty() )
+		{
+		Error("no trace file given");
+		return;
+		}
+
+	num_shards = std::max(BifConst::Pcap::read_shards, static_cast<bro_uint_t>(1));
+	shard = BifConst::Pcap::read_shard;
+
+	if ( shard >= num_shards )
+		{
+		Error(util::fmt("Pcap::read_shard %zu isn't below Pcap::read_shards %zu",
+		                shard, num_shards));
+		return;
+		}
+
+	if ( ! OpenFile() )
+		return;
+
+	props.selectable_fd = fd;
+	Opened(props);
+	}
+
+bool PcapMmapSource::OpenFile()
+	{
+	if ( next_file == files.size() )
+		return false;
+
+	const auto& path = files[next_file++];
+
+	fd = open(path.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		Error(util::fmt("can't open %s: %s", path.c_str(), strerror(errno)));
+		return false;
+		}
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || ! S_ISREG(st.st_mode) )
+		{
+		Error(util::fmt("%s is not a regular file, use the pcap:: source instead", path.c_str()));
+		CloseFile();
+		return false;
+		}
+
+	if ( static_cast<size_t>(st.st_size) < FILE_HEADER_SIZE )
+		{
+		Error(util::fmt("%s is too short for a pcap file", path.c_str()));
+		CloseFile();
+		return false;
+		}
+
+	map_len = st.st_size;
+	void* m = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if ( m == MAP_FAILED )
+		{
+		Error(util::fmt("can't map %s: %s", path.c_str(), strerror(errno)));
+		map_len = 0;
+		CloseFile();
+		return false;
+		}
+
+	map = static_cast<const u_char*>(m);
+	madvise(m, map_len, MADV_SEQUENTIAL);
+	advised = 0;
+
+	uint32_t magic;
+	memcpy(&magic, map, sizeof(magic));
+
+	swapped = magic == __builtin_bswap32(MAGIC_USECS) || magic == __builtin_bswap32(MAGIC_NSECS);
+	nanosecs = magic == MAGIC_NSECS || magic == __builtin_bswap32(MAGIC_NSECS);
+
+	if ( ! swapped && magic != MAGIC_USECS && magic != MAGIC_NSECS )
+		{
+		Error(util::fmt("%s is not a pcap file, use the pcap:: source for pcapng", path.c_str()));
+		CloseFile();
+		return false;
+		}
+
+	int link_type = Read32(map + 20);
+
+	if ( props.link_type >= 0 && link_type != props.link_type )
+		{
+		Error(util::fmt("%s has a different link type than the files before", path.c_str()));
+		CloseFile();
+		return false;
+		}
+
+	props.link_type = link_type;
+	pos = FILE_HEADER_SIZE;
+	return true;
+	}
+
+void PcapMmapSource::CloseFile()
+	{
+	if ( map )
+		{
+		munmap(const_cast<u_char*>(map), map_len);
+		map = nullptr;
+		map_len = 0;
+
+		if ( Pcap::file_done )
+			event_mgr.Enqueue(Pcap::file_done, make_intrusive<StringVal>(files[next_file - 1]));
+		}
+
+	if ( fd >= 0 )
+		{
+		close(fd);
+		fd = -1;
+		}
+	}
+
+void PcapMmapSource::Close()
+	{
+	if ( ! IsOpen() )
+		return;
+
+	CloseFile();
+	Closed();
+	}
+
+uint32_t PcapMmapSource::Read32(const u_char* p) const
+	{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? __builtin_bswap32(v) : v;
+	}
+
+bool PcapMmapSource::ExtractNextPacket(Packet* pkt)
+	{
+	while ( fd >= 0 )
+		{
+		if ( map_len - pos < RECORD_HEADER_SIZE ||
+		     Read32(map + pos + 8) > map_len - pos - RECORD_HEADER_SIZE )
+			{
+			if ( pos != map_len )
+				reporter->Warning("%s ends with a truncated packet", files[next_file - 1].c_str());
+
+			CloseFile();
+
+			if ( ! OpenFile() )
+				{
+				if ( IsError() )
+					reporter->FatalError("problem with trace file (%s)", ErrorMsg());
+
+				Close();
+				return false;
+				}
+
+			continue;
+			}
+
+		if ( pos + READAHEAD / 2 > advised && advised < map_len )
+			{
+			// madvise() wants page-aligned addresses.
+			static const size_t page_size = sysconf(_SC_PAGESIZE);
+			size_t start = advised / page_size * page_size;
+			advised = std::min(map_len, pos + READAHEAD);
+			madvise(const_cast<u_char*>(map) + start, advised - start, MADV_WILLNEED);
+			}
+
+		const u_char* hdr = map + pos;
+		uint32_t caplen = Read32(hdr + 8);
+		uint32_t len = Read32(hdr + 12);
+
+		const u_char* data = hdr + RECORD_HEADER_SIZE;
+		pos += RECORD_HEADER_SIZE + caplen;
+
+		if ( num_shards > 1 &&
+		     flow_shard(props.link_type, data, caplen, num_shards) != shard )
+			continue;
+
+		pcap_pkthdr phdr;
+		phdr.ts.tv_sec = Read32(hdr);
+		phdr.ts.tv_usec = nanosecs ? Read32(hdr + 4) / 1000 : Read32(hdr + 4);
+		phdr.caplen = caplen;
+		phdr.len = len;
+
+		if ( filter && ! filter->MatchesAnything() &&
+		     ! pcap_offline_filter(filter->GetProgram(), &phdr, data) )
+			continue;
+
+		pkt->Init(props.link_type, &phdr.ts, caplen, len, data);
+
+		if ( len == 0 || caplen == 0 )
+			{
+			Weird("empty_pcap_header", pkt);
+			return false;
+			}
+
+		++stats.received;
+		stats.bytes_received += len;
+		return true;
+		}
+
+	return false;
+	}
+
+void PcapMmapSource::DoneWithPacket()
+	{
+	// Nothing to do, the packet stays in the mapping.
+	}
+
+bool PcapMmapSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	return PktSrc::PrecompileBPFFilter(index, filter);
+	}
+
+bool PcapMmapSource::SetFilter(int index)
+	{
+	auto code = GetBPFFilter(index);
+
+	if ( ! code )
+		{
+		Error(util::fmt("No precompiled pcap filter for index %d", index));
+		return false;
+		}
+
+	// NFLOG does not support BPF filters, see PcapSource::SetFilter().
+	filter = LinkType() == DLT_NFLOG ? nullptr : code;
+	return true;
+	}
+
+void PcapMmapSource::Statistics(Stats* s)
+	{
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->dropped = s->link = 0;
+	}
+
+iosource::PktSrc* PcapMmapSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new PcapMmapSource(path, is_live);
+	}
+
+} // namespace zeek::iosource::pcap
@@ -0,0 +1,76 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include "../PktSrc.h"
+
+#include <sys/types.h> // for u_char
+
+#include <string>
+#include <vector>
+
+namespace zeek::iosource::pcap {
+
+/**
+ * A packet source reading pcap files through a memory mapping rather than
+ * through libpcap's stdio-based reader. Packets get handed out straight
+ * from the mapping, and the kernel is told to read ahead sequentially.
+ *
+ * The path may list several files separated by colons, which get read
+ * one after the other as a single trace, e.g. consecutive rotated dumps.
+ * Only the classic pcap format is supported, not pcapng.
+ *
+ * With Pcap::read_shards set, the source only returns the packets of
+ * shard Pcap::read_shard, chosen by the packet's pair of IP addresses.
+ * That's how the processes started for ``-j`` with ``-r`` split a trace
+ * among themselves.
+ *
+ * The source is available with the ``mmap::`` prefix.
+ */
+class PcapMmapSource : public PktSrc {
+public:
+	PcapMmapSource(const std::string& path, bool is_live);
+	~PcapMmapSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	// Maps the next file of the list. Returns false at the end of the
+	// list or if that fails, which also sets the error.
+	bool OpenFile();
+	void CloseFile();
+
+	uint32_t Read32(const u_char* p) const;
+
+	Properties props;
+	Stats stats;
+
+	std::vector<std::string> files;
+	size_t next_file = 0;
+
+	int fd = -1;
+	const u_char* map = nullptr;
+	size_t map_len = 0;
+	size_t pos = 0;
+	size_t advised = 0;	// End of the range we've asked to be read ahead.
+
+	bool swapped = false;	// Whether the file's byte order isn't ours.
+	bool nanosecs = false;	// Whether the file has nanosecond timestamps.
+
+	detail::BPF_Program* filter = nullptr;
+
+	size_t num_shards = 1;
+	size_t shard = 0;
+};
+
+} // namespace zeek::iosource::pcap
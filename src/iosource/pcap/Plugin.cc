@@ -1,6 +1,7 @@
 // See the file  in the main distribution directory for copyright.
 
 #include "Source.h"
+#include "MmapSource.h"
 #include "Dumper.h"
 #include "plugin/Plugin.h"
 #include "iosource/Component.h"
@@ -14,6 +15,9 @@ public:
 		AddComponent(new iosource::PktSrcComponent(
 			             "PcapReader", "pcap", iosource::PktSrcComponent::BOTH,
 			             iosource::pcap::PcapSource::Instantiate));
+		AddComponent(new iosource::PktSrcComponent(
+			             "PcapMmapReader", "mmap", iosource::PktSrcComponent::TRACE,
+			             iosource::pcap::PcapMmapSource::Instantiate));
 		AddComponent(new iosource::PktDumperComponent(
 			             "PcapWriter", "pcap", iosource::pcap::PcapDumper::Instantiate));
 
@@ -10,6 +10,8 @@ extern "C" {
 
 #include <sys/types.h> // for u_char
 
+#include <vector>
+
 namespace zeek::iosource::pcap {
 
 class PcapSource : public PktSrc {
@@ -34,10 +36,28 @@ private:
 	void OpenOffline();
 	void PcapError(const char* where = nullptr);
 
+	// Benchmark mode reads the whole trace into memory on the first
+	// packet, i.e. once the scripts have installed their filter, and
+	// then replays it run_state::detail::bench_loops times.
+	void Preload();
+	bool ExtractPreloadedPacket(Packet* pkt);
+
 	Properties props;
 	Stats stats;
 
 	pcap_t *pd;
+
+	struct PreloadedPacket {
+		pcap_pkthdr hdr;
+		size_t offset;	// Into preloaded_data.
+	};
+
+	std::vector<PreloadedPacket> preloaded;
+	std::vector<u_char> preloaded_data;
+	bool preload_done = false;
+	size_t preload_pos = 0;
+	int preload_loop = 0;
+	time_t preload_span = 0;	// Seconds to shift each loop by.
 };
 
 } // namespace zeek::iosource::pcap
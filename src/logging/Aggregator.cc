@@ -0,0 +1,337 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "Aggregator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "util.h"
+
+#include "3rdparty/doctest.h"
+
+using zeek::threading::Field;
+using zeek::threading::Value;
+
+namespace zeek::logging {
+
+static bool is_string_type(TypeTag t)
+	{
+	return t == TYPE_STRING || t == TYPE_ENUM || t == TYPE_FILE || t == TYPE_FUNC;
+	}
+
+// Copies an atomic value, including the data it owns.
+static Value* copy_value(const Value* v)
+	{
+	auto c = new Value(v->type, v->subtype, v->present);
+
+	if ( ! v->present )
+		return c;
+
+	if ( is_string_type(v->type) )
+		{
+		int len = v->val.string_val.length;
+		c->val.string_val.data = new char[len + 1];
+		memcpy(c->val.string_val.data, v->val.string_val.data, len);
+		c->val.string_val.data[len] = '\0';
+		c->val.string_val.length = len;
+		}
+
+	else if ( v->type == TYPE_PATTERN )
+		c->val.pattern_text_val = util::copy_string(v->val.pattern_text_val);
+
+	else
+		c->val = v->val;
+
+	return c;
+	}
+
+Aggregator::Aggregator(const WriterBackend::WriterInfo& info, int num_fields,
+                       const Field* const* fields)
+	: interval(info.aggregate_interval)
+	{
+	for ( auto i : info.aggregate_by )
+		{
+		if ( i < 0 || i >= num_fields )
+			{
+			error = util::fmt("no field #%d to aggregate by", i);
+			return;
+			}
+
+		TypeTag t = fields[i]->type;
+
+		if ( t == TYPE_TABLE || t == TYPE_VECTOR )
+			{
+			error = util::fmt("cannot aggregate by field '%s' of type %s",
+			                  fields[i]->name, type_name(t));
+			return;
+			}
+
+		by.push_back(i);
+		out_fields.push_back(fields[i]);
+		}
+
+	for ( const auto& r : info.aggregate_reduce )
+		{
+		int i = r.first;
+
+		if ( i < 0 || i >= num_fields || r.second < SUM || r.second > MAX )
+			{
+			error = util::fmt("invalid reduction of field #%d", i);
+			return;
+			}
+
+		switch ( fields[i]->type ) {
+		case TYPE_COUNT:
+		case TYPE_INT:
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			break;
+
+		default:
+			error = util::fmt("cannot reduce field '%s' of type %s",
+			                  fields[i]->name, type_name(fields[i]->type));
+			return;
+		}
+
+		reducers.push_back({i, static_cast<Reduction>(r.second)});
+		out_fields.push_back(fields[i]);
+		}
+
+	count_field = new Field(info.aggregate_count_field.c_str(), nullptr,
+	                        TYPE_COUNT, TYPE_VOID, false);
+	out_fields.push_back(count_field);
+
+	StartInterval(info.network_time);
+	}
+
+Aggregator::~Aggregator()
+	{
+	for ( auto vals : groups )
+		Value::delete_value_ptr_array(vals, NumFields());
+
+	delete count_field;
+	}
+
+void Aggregator::StartInterval(double network_time)
+	{
+	// Align intervals to multiples of their length, like rotation does.
+	if ( interval > 0 )
+		interval_end = (std::floor(network_time / interval) + 1) * interval;
+	}
+
+void Aggregator::AppendKey(const Value* v)
+	{
+	key.push_back(v->present ? 1 : 0);
+
+	if ( ! v->present )
+		return;
+
+	auto append = [this](const void* data, size_t len)
+		{ key.append(static_cast<const char*>(data), len); };
+
+	switch ( v->type ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+		append(&v->val.int_val, sizeof(v->val.int_val));
+		break;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		append(&v->val.double_val, sizeof(v->val.double_val));
+		break;
+
+	case TYPE_PORT:
+		append(&v->val.port_val.port, sizeof(v->val.port_val.port));
+		append(&v->val.port_val.proto, sizeof(v->val.port_val.proto));
+		break;
+
+	case TYPE_ADDR:
+		append(&v->val.addr_val.family, sizeof(v->val.addr_val.family));
+
+		if ( v->val.addr_val.family == IPv4 )
+			append(&v->val.addr_val.in.in4, sizeof(v->val.addr_val.in.in4));
+		else
+			append(&v->val.addr_val.in.in6, sizeof(v->val.addr_val.in.in6));
+		break;
+
+	case TYPE_SUBNET:
+		append(&v->val.subnet_val.prefix.family, sizeof(v->val.subnet_val.prefix.family));
+
+		if ( v->val.subnet_val.prefix.family == IPv4 )
+			append(&v->val.subnet_val.prefix.in.in4, sizeof(v->val.subnet_val.prefix.in.in4));
+		else
+			append(&v->val.subnet_val.prefix.in.in6, sizeof(v->val.subnet_val.prefix.in.in6));
+
+		append(&v->val.subnet_val.length, sizeof(v->val.subnet_val.length));
+		break;
+
+	case TYPE_PATTERN:
+		key.append(v->val.pattern_text_val, strlen(v->val.pattern_text_val) + 1);
+		break;
+
+	default:
+		// The string types. The length keeps keys of several fields
+		// unambiguous.
+		append(&v->val.string_val.length, sizeof(v->val.string_val.length));
+		key.append(v->val.string_val.data, v->val.string_val.length);
+		break;
+	}
+	}
+
+Value** Aggregator::NewRecord(const Value* const* vals) const
+	{
+	auto out = new Value*[NumFields()];
+	size_t n = 0;
+
+	for ( auto i : by )
+		out[n++] = copy_value(vals[i]);
+
+	for ( const auto& r : reducers )
+		out[n++] = copy_value(vals[r.field]);
+
+	out[n] = new Value(TYPE_COUNT);
+	out[n]->val.uint_val = 1;
+	return out;
+	}
+
+void Aggregator::Reduce(Value** out, const Value* const* vals) const
+	{
+	size_t n = by.size();
+
+	for ( const auto& r : reducers )
+		{
+		Value* o = out[n++];
+		const Value* v = vals[r.field];
+
+		if ( ! v->present )
+			continue;
+
+		if ( ! o->present )
+			{
+			o->present = true;
+			o->val = v->val;
+			continue;
+			}
+
+		switch ( o->type ) {
+		case TYPE_COUNT:
+			{
+			auto& a = o->val.uint_val;
+			auto b = v->val.uint_val;
+			a = r.reduction == SUM ? a + b : r.reduction == MIN ? std::min(a, b) : std::max(a, b);
+			break;
+			}
+
+		case TYPE_INT:
+			{
+			auto& a = o->val.int_val;
+			auto b = v->val.int_val;
+			a = r.reduction == SUM ? a + b : r.reduction == MIN ? std::min(a, b) : std::max(a, b);
+			break;
+			}
+
+		default:
+			{
+			auto& a = o->val.double_val;
+			auto b = v->val.double_val;
+			a = r.reduction == SUM ? a + b : r.reduction == MIN ? std::min(a, b) : std::max(a, b);
+			break;
+			}
+		}
+		}
+
+	++out[n]->val.uint_val;
+	}
+
+void Aggregator::Add(const Value* const* vals)
+	{
+	key.clear();
+
+	for ( auto i : by )
+		AppendKey(vals[i]);
+
+	auto g = group_index.emplace(key, groups.size());
+
+	if ( g.second )
+		groups.push_back(NewRecord(vals));
+	else
+		Reduce(groups[g.first->second], vals);
+	}
+
+std::vector<Value**> Aggregator::Take(double network_time)
+	{
+	std::vector<Value**> result;
+	result.swap(groups);
+	group_index.clear();
+	StartInterval(network_time);
+	return result;
+	}
+
+TEST_CASE("logging aggregator")
+	{
+	Field f0("host", nullptr, TYPE_STRING, TYPE_VOID, false);
+	Field f1("bytes", nullptr, TYPE_COUNT, TYPE_VOID, false);
+	Field f2("duration", nullptr, TYPE_INTERVAL, TYPE_VOID, true);
+	const Field* fields[] = {&f0, &f1, &f2};
+
+	WriterBackend::WriterInfo info;
+	info.aggregate = true;
+	info.aggregate_by = {0};
+	info.aggregate_reduce = {{1, Aggregator::SUM}, {2, Aggregator::MAX}};
+	info.aggregate_interval = 60;
+	info.aggregate_count_field = "n";
+	info.network_time = 90;
+
+	Aggregator a(info, 3, fields);
+	REQUIRE(a.Error().empty());
+	CHECK(a.NumFields() == 4);
+	CHECK(strcmp(a.Fields()[3]->name, "n") == 0);
+	CHECK_FALSE(a.Due(119));
+	CHECK(a.Due(120));
+
+	auto add = [&a](const char* host, bro_uint_t bytes, double duration)
+		{
+		Value s(TYPE_STRING);
+		s.val.string_val.data = const_cast<char*>(host);
+		s.val.string_val.length = strlen(host);
+		Value b(TYPE_COUNT);
+		b.val.uint_val = bytes;
+		Value d(TYPE_INTERVAL, duration >= 0);
+		d.val.double_val = duration;
+		const Value* vals[] = {&s, &b, &d};
+		a.Add(vals);
+
+		// Not owned by the values.
+		s.val.string_val.data = nullptr;
+		};
+
+	add("a", 10, -1);
+	add("b", 5, 2.5);
+	add("a", 7, 1.5);
+	add("a", 1, 0.5);
+
+	auto recs = a.Take(130);
+	REQUIRE(recs.size() == 2);
+	CHECK(std::string(recs[0][0]->val.string_val.data) == "a");
+	CHECK(recs[0][1]->val.uint_val == 18);
+	CHECK(recs[0][2]->present);
+	CHECK(recs[0][2]->val.double_val == 1.5);
+	CHECK(recs[0][3]->val.uint_val == 3);
+	CHECK(recs[1][3]->val.uint_val == 1);
+	CHECK_FALSE(a.Due(179));
+	CHECK(a.Due(180));
+	CHECK(a.Take(180).empty());
+
+	for ( auto vals : recs )
+		Value::delete_value_ptr_array(vals, a.NumFields());
+
+	info.aggregate_by = {4};
+	Aggregator b(info, 3, fields);
+	CHECK_FALSE(b.Error().empty());
+	}
+
+} // namespace zeek::logging
@@ -0,0 +1,114 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "threading/SerialTypes.h"
+
+#include "WriterBackend.h"
+
+namespace zeek::logging {
+
+/**
+ * Pre-aggregates log records inside a writer thread, as configured by a
+ * filter's aggregation settings. Records with the same values in the
+ * fields aggregated by fold into a single one, comprising those fields,
+ * the reduced fields, and a count of the records folded. The writer
+ * receives the aggregated records once per aggregation interval, as
+ * well as before rotating and when finishing.
+ */
+class Aggregator {
+public:
+	/**
+	 * The reductions applicable to a numeric field.
+	 */
+	enum Reduction { SUM, MIN, MAX };
+
+	/**
+	 * Constructor.
+	 *
+	 * @param info The writer's information, with the aggregation
+	 * settings.
+	 *
+	 * @param num_fields The number of fields of the incoming records.
+	 *
+	 * @param fields The fields of the incoming records. They must stay
+	 * around for the lifetime of the aggregator.
+	 */
+	Aggregator(const WriterBackend::WriterInfo& info, int num_fields,
+	           const threading::Field* const* fields);
+
+	/**
+	 * Destructor. Discards all records not yet taken.
+	 */
+	~Aggregator();
+
+	Aggregator(const Aggregator&) = delete;
+	Aggregator& operator=(const Aggregator&) = delete;
+
+	/**
+	 * Returns a description of what's wrong with the aggregation
+	 * settings, or an empty string if they are fine.
+	 */
+	const std::string& Error() const	{ return error; }
+
+	/**
+	 * Returns the number of fields of the aggregated records.
+	 */
+	int NumFields() const	{ return static_cast<int>(out_fields.size()); }
+
+	/**
+	 * Returns the fields of the aggregated records.
+	 */
+	const threading::Field* const* Fields() const	{ return out_fields.data(); }
+
+	/**
+	 * Folds an incoming record into the aggregates. The aggregator
+	 * copies what it needs.
+	 */
+	void Add(const threading::Value* const* vals);
+
+	/**
+	 * Returns true if the current aggregation interval has ended by a
+	 * given network time.
+	 */
+	bool Due(double network_time) const
+		{ return interval > 0 && network_time >= interval_end; }
+
+	/**
+	 * Hands over the aggregated records, in the order their groups first
+	 * showed up, and starts a new aggregation interval. The caller takes
+	 * ownership of the records.
+	 *
+	 * @param network_time The current network time.
+	 */
+	std::vector<threading::Value**> Take(double network_time);
+
+private:
+	void StartInterval(double network_time);
+	void AppendKey(const threading::Value* v);
+	threading::Value** NewRecord(const threading::Value* const* vals) const;
+	void Reduce(threading::Value** out, const threading::Value* const* vals) const;
+
+	struct Reducer {
+		int field;
+		Reduction reduction;
+	};
+
+	std::vector<int> by;
+	std::vector<Reducer> reducers;
+	std::vector<const threading::Field*> out_fields;
+	threading::Field* count_field = nullptr;
+	double interval;
+	double interval_end = 0;
+	std::string error;
+
+	std::string key;	// Scratch space for a record's group key.
+	std::unordered_map<std::string, size_t> group_index;
+	std::vector<threading::Value**> groups;
+};
+
+} // namespace zeek::logging
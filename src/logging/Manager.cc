@@ -2,12 +2,15 @@
 
 #include "Manager.h"
 
+#include <algorithm>
 #include <utility>
 
 #include "Event.h"
 #include "EventHandler.h"
 #include "NetVar.h"
 #include "RunState.h"
+#include "Stats.h"
+#include "telemetry/Manager.h"
 #include "Type.h"
 #include "File.h"
 #include "input.h"
@@ -21,7 +24,11 @@
 #include "Desc.h"
 #include "WriterFrontend.h"
 #include "WriterBackend.h"
+#include "WriteBatch.h"
+#include "Aggregator.h"
+#include "RotationPostProcessor.h"
 #include "logging.bif.h"
+#include "const.bif.h"
 #include "plugin/Plugin.h"
 #include "plugin/Manager.h"
 
@@ -31,6 +38,16 @@ using namespace std;
 
 namespace zeek::logging {
 
+// Initial arena size of the batch shared by filters, after which writes
+// move on to a new one.
+static constexpr size_t SHARED_BATCH_SIZE = 64 * 1024;
+
+// Converts a Val of a particular type into a threading::Value allocated
+// in a write batch.
+typedef threading::Value* (*ValConverter)(WriteBatch* batch, Val* val);
+
+static ValConverter converter(TypeTag t);
+
 struct Manager::Filter {
 	Val* fval;
 	string name;
@@ -52,13 +69,34 @@ struct Manager::Filter {
 	double interval;
 	Func* postprocessor;
 
+	bool aggregate;
+	vector<int> aggregate_by;
+	vector<pair<int, int>> aggregate_reduce;
+	double aggregate_interval;
+	string aggregate_count_field;
+
+	bro_uint_t sample_rate;
+	bro_uint_t sample_count;
+
 	int num_fields;
 	threading::Field** fields;
 
-	// Vector indexed by field number. Each element is a list of record
-	// indices defining a path leading to the value across potential
-	// sub-records.
-	vector<list<int> > indices;
+	// How to get at the value of a field in a log record and convert
+	// it, worked out when creating the filter.
+	struct Extractor {
+		// The record indices defining a path leading to the value
+		// across potential sub-records.
+		vector<int> path;
+		TypeTag type;
+		ValConverter convert;
+
+		// The stream column the value comes from, or -1 for
+		// extension fields.
+		int column;
+	};
+
+	// Vector indexed by field number.
+	vector<Extractor> extractors;
 
 	~Filter();
 };
@@ -85,6 +123,10 @@ struct Manager::Stream {
 	Func* policy;
 	list<Filter*> filters;
 
+	// Paths of all the columns that the stream's filters log, see
+	// Filter::Extractor::column.
+	vector<vector<int>> column_paths;
+
 	typedef pair<int, string> WriterPathPair;
 
 	typedef map<WriterPathPair, WriterInfo*> WriterMap;
@@ -148,6 +190,11 @@ Manager::~Manager()
 void Manager::InitPostScript()
 	{
 	rotation_format_func = id::find_func("Log::rotation_format_func");
+
+	post_processing.compression_level =
+		std::min(BifConst::Log::rotation_compression_level, static_cast<bro_uint_t>(9));
+	post_processing.destination_dir = BifConst::Log::rotation_destination_dir->CheckString();
+	post_processing.checksum = BifConst::Log::rotation_checksum;
 	}
 
 WriterBackend* Manager::CreateBackend(WriterFrontend* frontend, EnumVal* tag)
@@ -507,7 +554,21 @@ bool Manager::TraverseRecord(Stream* stream, Filter* filter, RecordType* rt,
 			}
 
 		// Alright, we want this field.
-		filter->indices.push_back(new_indices);
+		vector<int> field_path(new_indices.begin(), new_indices.end());
+		int column = -1;
+
+		// Extension fields come first, see RecordToFilterVals().
+		if ( static_cast<int>(filter->extractors.size()) >= filter->num_ext_fields )
+			{
+			auto& paths = stream->column_paths;
+			column = std::find(paths.begin(), paths.end(), field_path) - paths.begin();
+
+			if ( column == static_cast<int>(paths.size()) )
+				paths.push_back(field_path);
+			}
+
+		filter->extractors.push_back({std::move(field_path), t->Tag(),
+		                              converter(t->Tag()), column});
 
 		void* tmp =
 			realloc(filter->fields,
@@ -640,6 +701,15 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 		filter->path_val = nullptr;
 		}
 
+	if ( ! InitFilterAggregation(filter, fval) )
+		{
+		delete filter;
+		return false;
+		}
+
+	filter->sample_rate = fval->GetFieldOrDefault("sample_rate")->AsCount();
+	filter->sample_count = 0;
+
 	// Remove any filter with the same name we might already have.
 	RemoveFilter(id, filter->name);
 
@@ -670,6 +740,125 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 	return true;
 	}
 
+bool Manager::InitFilterAggregation(Filter* filter, RecordVal* fval)
+	{
+	filter->aggregate = false;
+	filter->aggregate_interval = fval->GetFieldOrDefault("aggregate_interval")->AsInterval();
+	filter->aggregate_count_field = fval->GetFieldOrDefault("aggregate_count_field")->AsString()->CheckString();
+
+	const auto& aggregate_by = fval->GetField("aggregate_by");
+	auto aggregate = fval->GetFieldOrDefault("aggregate")->AsTableVal();
+
+	if ( ! aggregate_by )
+		{
+		if ( aggregate->Size() > 0 )
+			{
+			reporter->Error("filter '%s' reduces fields without aggregating by any",
+			                filter->name.c_str());
+			return false;
+			}
+
+		return true;
+		}
+
+	// The names refer to the fields as logged, before any renaming.
+	auto field_index = [filter](const char* name)
+		{
+		for ( int i = 0; i < filter->num_fields; ++i )
+			{
+			if ( strcmp(filter->fields[i]->name, name) == 0 )
+				return i;
+			}
+
+		return -1;
+		};
+
+	auto by = aggregate_by->AsTableVal()->ToPureListVal();
+
+	for ( int i = 0; i < by->Length(); ++i )
+		{
+		const char* name = by->Idx(i)->AsString()->CheckString();
+		int idx = field_index(name);
+
+		if ( idx < 0 )
+			{
+			reporter->Error("filter '%s' aggregates by field '%s' that it doesn't log",
+			                filter->name.c_str(), name);
+			return false;
+			}
+
+		TypeTag t = filter->fields[idx]->type;
+
+		if ( t == TYPE_TABLE || t == TYPE_VECTOR )
+			{
+			reporter->Error("filter '%s' cannot aggregate by field '%s' of type %s",
+			                filter->name.c_str(), name, type_name(t));
+			return false;
+			}
+
+		filter->aggregate_by.push_back(idx);
+		}
+
+	zeek::detail::HashKey* k;
+	IterCookie* c = aggregate->AsTable()->InitForIteration();
+
+	TableEntryVal* v;
+	while ( (v = aggregate->AsTable()->NextEntry(k, c)) )
+		{
+		auto index = aggregate->RecreateIndex(*k);
+		delete k;
+
+		const char* name = index->Idx(0)->AsString()->CheckString();
+		int idx = field_index(name);
+
+		const auto& fby = filter->aggregate_by;
+
+		if ( idx < 0 || std::find(fby.begin(), fby.end(), idx) != fby.end() )
+			{
+			aggregate->AsTable()->StopIteration(c);
+			reporter->Error("filter '%s' cannot reduce field '%s' that it %s",
+			                filter->name.c_str(), name,
+			                idx < 0 ? "doesn't log" : "aggregates by");
+			return false;
+			}
+
+		switch ( filter->fields[idx]->type ) {
+		case TYPE_COUNT:
+		case TYPE_INT:
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			break;
+
+		default:
+			aggregate->AsTable()->StopIteration(c);
+			reporter->Error("filter '%s' cannot reduce field '%s' of type %s",
+			                filter->name.c_str(), name, type_name(filter->fields[idx]->type));
+			return false;
+		}
+
+		auto r = v->GetVal()->AsEnumVal();
+		string rname = r->GetType()->AsEnumType()->Lookup(r->InternalInt());
+		int reduction;
+
+		if ( rname == "Log::SUM" )
+			reduction = Aggregator::SUM;
+		else if ( rname == "Log::MIN" )
+			reduction = Aggregator::MIN;
+		else
+			reduction = Aggregator::MAX;
+
+		filter->aggregate_reduce.emplace_back(idx, reduction);
+		}
+
+	// Output fields keep their order in the log.
+	std::sort(filter->aggregate_by.begin(), filter->aggregate_by.end());
+	std::sort(filter->aggregate_reduce.begin(), filter->aggregate_reduce.end());
+
+	filter->aggregate = true;
+	return true;
+	}
+
 bool Manager::RemoveFilter(EnumVal* id, StringVal* name)
 	{
 	return RemoveFilter(id, name->AsString()->CheckString());
@@ -704,6 +893,11 @@ bool Manager::RemoveFilter(EnumVal* id, const string& name)
 
 bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 	{
+	zeek::detail::StageTimer stage(zeek::detail::STAGE_LOGGING);
+
+	if ( telemetry_mgr )
+		telemetry_mgr->log_writes->Inc();
+
 	Stream* stream = FindStream(id);
 	if ( ! stream )
 		return false;
@@ -723,6 +917,28 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 	if ( stream->event )
 		event_mgr.Enqueue(stream->event, columns);
 
+	// Filters logging the same column share its value, converted once
+	// into an arena that their batches all keep alive. Since every
+	// filter runs script code that may alter the record, the shared
+	// values only hold until the next such call.
+	std::shared_ptr<WriteBatch> shared;
+	vector<threading::Value*> shared_vals;
+
+	if ( stream->filters.size() > 1 )
+		{
+		if ( ! shared_batch || shared_batch->ArenaBytes() >= SHARED_BATCH_SIZE )
+			shared_batch = std::make_shared<WriteBatch>(0, SHARED_BATCH_SIZE);
+
+		// A local reference, in case a nested write replaces it.
+		shared = shared_batch;
+		shared_vals.resize(stream->column_paths.size());
+		}
+
+	auto record_may_change = [&shared_vals]()
+		{
+		std::fill(shared_vals.begin(), shared_vals.end(), nullptr);
+		};
+
 	// Send to each of our filters.
 	for ( list<Filter*>::iterator i = stream->filters.begin();
 	      i != stream->filters.end(); ++i )
@@ -740,6 +956,10 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 			auto v = filter->policy->Invoke(columns,
 							IntrusivePtr{NewRef{}, id},
 							IntrusivePtr{NewRef{}, filter->fval});
+
+			if ( filter->policy->HasBodies() )
+				record_may_change();
+
 			if ( v  && ! v->AsBool() )
 				continue;
 			}
@@ -751,11 +971,16 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 			// See whether the predicate indicates that we want
 			// to log this record.
 			auto v = filter->pred->Invoke(columns);
+			record_may_change();
 
 			if ( v && ! v->AsBool() )
 				continue;
 			}
 
+		// Sampling precedes all the work to come.
+		if ( filter->sample_rate > 1 && ++filter->sample_count % filter->sample_rate != 0 )
+			continue;
+
 		if ( filter->path_func )
 			{
 			ValPtr path_arg;
@@ -777,6 +1002,7 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 			auto v = filter->path_func->Invoke(IntrusivePtr{NewRef{}, id},
 			                                   std::move(path_arg),
 			                                   std::move(rec_arg));
+			record_may_change();
 
 			if ( ! v )
 				return false;
@@ -885,6 +1111,11 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 			info = new WriterBackend::WriterInfo;
 			info->path = util::copy_string(path.c_str());
 			info->network_time = run_state::network_time;
+			info->aggregate = filter->aggregate;
+			info->aggregate_by = filter->aggregate_by;
+			info->aggregate_reduce = filter->aggregate_reduce;
+			info->aggregate_interval = filter->aggregate_interval;
+			info->aggregate_count_field = filter->aggregate_count_field;
 
 			zeek::detail::HashKey* k;
 			IterCookie* c = filter->config->AsTable()->InitForIteration();
@@ -909,9 +1140,15 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 				return false;
 			}
 
+		// The writer's thread may have too much to do already.
+		if ( ! writer->AdmitWrite() )
+			continue;
+
 		// Alright, can do the write now.
 
-		threading::Value** vals = RecordToFilterVals(stream, filter, columns.get());
+		threading::Value** vals = RecordToFilterVals(stream, filter, columns.get(),
+		                                             writer->Batch(), shared,
+		                                             shared ? shared_vals.data() : nullptr);
 
 		if ( ! PLUGIN_HOOK_WITH_RESULT(HOOK_LOG_WRITE,
 		                               HookLogWrite(filter->writer->GetType()->AsEnumType()->Lookup(filter->writer->InternalInt()),
@@ -920,7 +1157,7 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 		                                            filter->fields, vals),
 		                               true) )
 			{
-			DeleteVals(filter->num_fields, vals);
+			writer->DeleteVals(filter->num_fields, vals);
 
 #ifdef DEBUG
 			DBG_LOG(DBG_LOGGING, "Hook prevented writing to filter '%s' on stream '%s'",
@@ -942,139 +1179,216 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 	return true;
 	}
 
-threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
+static threading::Value* log_val(WriteBatch* batch, Val* val, Type* ty);
+
+static threading::Value* convert_bool(WriteBatch* batch, Val* val)
 	{
-	if ( ! ty )
-		ty = val->GetType().get();
+	threading::Value* lval = batch->NewValue(TYPE_BOOL);
+	lval->val.int_val = val->InternalInt();
+	return lval;
+	}
 
-	if ( ! val )
-		return new threading::Value(ty->Tag(), false);
+static threading::Value* convert_int(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_INT);
+	lval->val.int_val = val->InternalInt();
+	return lval;
+	}
+
+static threading::Value* convert_enum(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_ENUM);
+	const char* s = val->GetType()->AsEnumType()->Lookup(val->InternalInt());
+
+	if ( ! s )
+		{
+		val->GetType()->Error("enum type does not contain value", val);
+		s = "";
+		}
+
+	lval->val.string_val.length = strlen(s);
+	lval->val.string_val.data = batch->NewString(s, lval->val.string_val.length);
+	return lval;
+	}
+
+static threading::Value* convert_count(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_COUNT);
+	lval->val.uint_val = val->InternalUnsigned();
+	return lval;
+	}
+
+static threading::Value* convert_port(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_PORT);
+	lval->val.port_val.port = val->AsPortVal()->Port();
+	lval->val.port_val.proto = val->AsPortVal()->PortType();
+	return lval;
+	}
+
+static threading::Value* convert_subnet(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_SUBNET);
+	val->AsSubNet().ConvertToThreadingValue(&lval->val.subnet_val);
+	return lval;
+	}
+
+static threading::Value* convert_addr(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_ADDR);
+	val->AsAddr().ConvertToThreadingValue(&lval->val.addr_val);
+	return lval;
+	}
+
+static threading::Value* convert_double(WriteBatch* batch, Val* val)
+	{
+	// Also covers time and interval.
+	threading::Value* lval = batch->NewValue(val->GetType()->Tag());
+	lval->val.double_val = val->InternalDouble();
+	return lval;
+	}
+
+static threading::Value* convert_string(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_STRING);
+	const String* s = val->AsString();
+	lval->val.string_val.data =
+		batch->NewString(reinterpret_cast<const char*>(s->Bytes()), s->Len());
+	lval->val.string_val.length = s->Len();
+	return lval;
+	}
+
+static threading::Value* convert_file(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_FILE);
+	const File* f = val->AsFile();
+	string s = f->Name();
+	lval->val.string_val.data = batch->NewString(s.data(), s.size());
+	lval->val.string_val.length = s.size();
+	return lval;
+	}
+
+static threading::Value* convert_func(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_FUNC);
+	ODesc d;
+	const Func* f = val->AsFunc();
+	f->Describe(&d);
+	const char* s = d.Description();
+	lval->val.string_val.length = strlen(s);
+	lval->val.string_val.data = batch->NewString(s, lval->val.string_val.length);
+	return lval;
+	}
+
+static threading::Value* convert_set(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_TABLE);
+	auto set = val->AsTableVal()->ToPureListVal();
+	if ( ! set )
+		// ToPureListVal has reported an internal warning
+		// already. Just keep going by making something up.
+		set = make_intrusive<ListVal>(TYPE_INT);
+
+	lval->val.set_val.size = set->Length();
+	lval->val.set_val.vals = batch->NewValues(lval->val.set_val.size);
 
-	threading::Value* lval = new threading::Value(ty->Tag());
+	for ( bro_int_t i = 0; i < lval->val.set_val.size; i++ )
+		lval->val.set_val.vals[i] = log_val(batch, set->Idx(i).get(), nullptr);
 
-	switch ( lval->type ) {
+	return lval;
+	}
+
+static threading::Value* convert_vector(WriteBatch* batch, Val* val)
+	{
+	threading::Value* lval = batch->NewValue(TYPE_VECTOR);
+	VectorVal* vec = val->AsVectorVal();
+	Type* yield = vec->GetType()->Yield().get();
+	lval->val.vector_val.size = vec->Size();
+	lval->val.vector_val.vals = batch->NewValues(lval->val.vector_val.size);
+
+	for ( bro_int_t i = 0; i < lval->val.vector_val.size; i++ )
+		lval->val.vector_val.vals[i] = log_val(batch, vec->At(i).get(), yield);
+
+	return lval;
+	}
+
+static threading::Value* convert_unsupported(WriteBatch* batch, Val* val)
+	{
+	reporter->InternalError("unsupported type %s for log_write",
+	                        type_name(val->GetType()->Tag()));
+	return nullptr;
+	}
+
+// Returns the function converting values of a type.
+static ValConverter converter(TypeTag t)
+	{
+	switch ( t ) {
 	case TYPE_BOOL:
+		return convert_bool;
+
 	case TYPE_INT:
-		lval->val.int_val = val->InternalInt();
-		break;
+		return convert_int;
 
 	case TYPE_ENUM:
-		{
-		const char* s =
-			val->GetType()->AsEnumType()->Lookup(val->InternalInt());
-
-		if ( s )
-			{
-			lval->val.string_val.data = util::copy_string(s);
-			lval->val.string_val.length = strlen(s);
-			}
-
-		else
-			{
-			val->GetType()->Error("enum type does not contain value", val);
-			lval->val.string_val.data = util::copy_string("");
-			lval->val.string_val.length = 0;
-			}
-		break;
-		}
+		return convert_enum;
 
 	case TYPE_COUNT:
-		lval->val.uint_val = val->InternalUnsigned();
-		break;
+		return convert_count;
 
 	case TYPE_PORT:
-		lval->val.port_val.port = val->AsPortVal()->Port();
-		lval->val.port_val.proto = val->AsPortVal()->PortType();
-		break;
+		return convert_port;
 
 	case TYPE_SUBNET:
-		val->AsSubNet().ConvertToThreadingValue(&lval->val.subnet_val);
-		break;
+		return convert_subnet;
 
 	case TYPE_ADDR:
-		val->AsAddr().ConvertToThreadingValue(&lval->val.addr_val);
-		break;
+		return convert_addr;
 
 	case TYPE_DOUBLE:
 	case TYPE_TIME:
 	case TYPE_INTERVAL:
-		lval->val.double_val = val->InternalDouble();
-		break;
+		return convert_double;
 
 	case TYPE_STRING:
-		{
-		const String* s = val->AsString();
-		char* buf = new char[s->Len()];
-		memcpy(buf, s->Bytes(), s->Len());
-
-		lval->val.string_val.data = buf;
-		lval->val.string_val.length = s->Len();
-		break;
-		}
+		return convert_string;
 
 	case TYPE_FILE:
-		{
-		const File* f = val->AsFile();
-		string s = f->Name();
-		lval->val.string_val.data = util::copy_string(s.c_str());
-		lval->val.string_val.length = s.size();
-		break;
-		}
+		return convert_file;
 
 	case TYPE_FUNC:
-		{
-		ODesc d;
-		const Func* f = val->AsFunc();
-		f->Describe(&d);
-		const char* s = d.Description();
-		lval->val.string_val.data = util::copy_string(s);
-		lval->val.string_val.length = strlen(s);
-		break;
-		}
+		return convert_func;
 
 	case TYPE_TABLE:
-		{
-		auto set = val->AsTableVal()->ToPureListVal();
-		if ( ! set )
-			// ToPureListVal has reported an internal warning
-			// already. Just keep going by making something up.
-			set = make_intrusive<ListVal>(TYPE_INT);
-
-		lval->val.set_val.size = set->Length();
-		lval->val.set_val.vals = new threading::Value* [lval->val.set_val.size];
-
-		for ( bro_int_t i = 0; i < lval->val.set_val.size; i++ )
-			lval->val.set_val.vals[i] = ValToLogVal(set->Idx(i).get());
-
-		break;
-		}
+		return convert_set;
 
 	case TYPE_VECTOR:
-		{
-		VectorVal* vec = val->AsVectorVal();
-		lval->val.vector_val.size = vec->Size();
-		lval->val.vector_val.vals =
-			new threading::Value* [lval->val.vector_val.size];
+		return convert_vector;
 
-		for ( bro_int_t i = 0; i < lval->val.vector_val.size; i++ )
-			{
-			lval->val.vector_val.vals[i] =
-				ValToLogVal(vec->At(i).get(),
-					    vec->GetType()->Yield().get());
-			}
+	default:
+		return convert_unsupported;
+	}
+	}
 
-		break;
-		}
+static threading::Value* log_val(WriteBatch* batch, Val* val, Type* ty)
+	{
+	if ( ! ty )
+		ty = val->GetType().get();
 
-	default:
-		reporter->InternalError("unsupported type %s for log_write", type_name(lval->type));
+	if ( ! val )
+		return batch->NewValue(ty->Tag(), false);
+
+	return converter(ty->Tag())(batch, val);
 	}
 
-	return lval;
+threading::Value* Manager::ValToLogVal(WriteBatch* batch, Val* val, Type* ty)
+	{
+	return log_val(batch, val, ty);
 	}
 
 threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
-                                               RecordVal* columns)
+                                               RecordVal* columns, WriteBatch* batch,
+                                               const std::shared_ptr<WriteBatch>& shared_batch,
+                                               threading::Value** shared_vals)
 	{
 	RecordValPtr ext_rec;
 
@@ -1086,48 +1400,84 @@ threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
 			ext_rec = {AdoptRef{}, res.release()->AsRecordVal()};
 		}
 
-	threading::Value** vals = new threading::Value*[filter->num_fields];
+	// Allocating the array first lets WriteBatch::Discard() give back
+	// all of the record's space.
+	threading::Value** vals = batch->NewValues(filter->num_fields);
 
 	for ( int i = 0; i < filter->num_fields; ++i )
 		{
+		const Filter::Extractor& e = filter->extractors[i];
 		Val* val;
+
 		if ( i < filter->num_ext_fields )
 			{
 			if ( ! ext_rec )
 				{
 				// executing function did not return record. Send empty for all vals.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
+				vals[i] = batch->NewValue(e.type, false);
 				continue;
 				}
 
 			val = ext_rec.get();
 			}
 		else
-			val = columns;
+			{
+			if ( shared_vals && shared_vals[e.column] )
+				{
+				vals[i] = shared_vals[e.column];
+				continue;
+				}
 
-		// For each field, first find the right value, which can
-		// potentially be nested inside other records.
-		list<int>& indices = filter->indices[i];
+			val = columns;
+			}
 
-		for ( list<int>::iterator j = indices.begin(); j != indices.end(); ++j )
+		// First find the right value, which can potentially be nested
+		// inside other records.
+		for ( int idx : e.path )
 			{
-			val = val->AsRecordVal()->GetField(*j).get();
+			val = val->AsRecordVal()->GetField(idx).get();
 
 			if ( ! val )
-				{
 				// Value, or any of its parents, is not set.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
 				break;
-				}
 			}
 
-		if ( val )
-			vals[i] = ValToLogVal(val);
+		if ( shared_vals && i >= filter->num_ext_fields )
+			{
+			WriteBatch* sb = shared_batch.get();
+			vals[i] = val ? e.convert(sb, val) : sb->NewValue(e.type, false);
+			shared_vals[e.column] = vals[i];
+			}
+		else
+			vals[i] = val ? e.convert(batch, val) : batch->NewValue(e.type, false);
 		}
 
+	if ( shared_vals )
+		batch->Retain(shared_batch);
+
 	return vals;
 	}
 
+const Manager::writer_stats_list& Manager::GetWriterStats()
+	{
+	writer_stats.clear();
+
+	for ( const auto& stream : streams )
+		{
+		if ( ! stream )
+			continue;
+
+		for ( const auto& w : stream->writers )
+			{
+			WriterFrontend::Stats s;
+			w.second->writer->GetStats(&s);
+			writer_stats.emplace_back(w.second->writer->Name(), s);
+			}
+		}
+
+	return writer_stats;
+	}
+
 bool Manager::CreateWriterForRemoteLog(EnumVal* id, EnumVal* writer, WriterBackend::WriterInfo* info,
                                        int num_fields, const threading::Field* const* fields)
 	{
@@ -1267,6 +1617,21 @@ void Manager::DeleteVals(int num_fields, threading::Value** vals)
 bool Manager::WriteFromRemote(EnumVal* id, EnumVal* writer, const string& path, int num_fields,
                               threading::Value** vals)
 	{
+	std::vector<threading::Value**> records{vals};
+	return WriteFromRemote(id, writer, path, num_fields, &records);
+	}
+
+bool Manager::WriteFromRemote(EnumVal* id, EnumVal* writer, const string& path, int num_fields,
+                              std::vector<threading::Value**>* records)
+	{
+	auto delete_records = [&]()
+		{
+		for ( auto vals : *records )
+			DeleteVals(num_fields, vals);
+
+		records->clear();
+		};
+
 	Stream* stream = FindStream(id);
 
 	if ( ! stream )
@@ -1278,13 +1643,13 @@ bool Manager::WriteFromRemote(EnumVal* id, EnumVal* writer, const string& path,
 		DBG_LOG(DBG_LOGGING, "unknown stream %s in Manager::Write()",
 			desc.Description());
 #endif
-		DeleteVals(num_fields, vals);
+		delete_records();
 		return false;
 		}
 
 	if ( ! stream->enabled )
 		{
-		DeleteVals(num_fields, vals);
+		delete_records();
 		return true;
 		}
 
@@ -1300,15 +1665,18 @@ bool Manager::WriteFromRemote(EnumVal* id, EnumVal* writer, const string& path,
 		DBG_LOG(DBG_LOGGING, "unknown writer %s in Manager::Write()",
 			desc.Description());
 #endif
-		DeleteVals(num_fields, vals);
+		delete_records();
 		return false;
 		}
 
-	w->second->writer->Write(num_fields, vals);
+	for ( auto vals : *records )
+		w->second->writer->Write(num_fields, vals);
 
 	DBG_LOG(DBG_LOGGING,
-		"Wrote pre-filtered record to path '%s' on stream '%s'",
-		path.c_str(), stream->name.c_str());
+		"Wrote %zu pre-filtered record(s) to path '%s' on stream '%s'",
+		records->size(), path.c_str(), stream->name.c_str());
+
+	records->clear();
 
 	return true;
 	}
@@ -1375,6 +1743,12 @@ bool Manager::Flush(EnumVal* id)
 
 void Manager::Terminate()
 	{
+	// Let the post-processing of rotated files finish, so that their
+	// post-processors still run.
+	while ( post_processor && ! pending_post_processing.empty() &&
+	        post_processor->ProcessReport() )
+		;
+
 	for ( vector<Stream *>::iterator s = streams.begin(); s != streams.end(); ++s )
 		{
 		if ( ! *s )
@@ -1627,13 +2001,47 @@ bool Manager::FinishedRotation(WriterFrontend* writer, const char* new_name, con
 
 	static auto default_ppf = id::find_func("Log::__default_rotation_postprocessor");
 
-	Func* func = winfo->postprocessor;
+	FuncPtr func{NewRef{}, winfo->postprocessor};
 
 	if ( ! func )
-		func = default_ppf.get();
+		func = default_ppf;
 
 	assert(func);
 
+	if ( post_processing.Enabled() )
+		{
+		if ( terminating )
+			{
+			// The thread may not get to report back anymore, so do it
+			// right here.
+			std::string fname = new_name;
+			std::string error;
+
+			if ( ! RotationPostProcessor::PostProcess(post_processing, &fname, &error) )
+				reporter->Error("post-processing rotated log failed: %s", error.c_str());
+
+			info->Assign(1, make_intrusive<StringVal>(fname));
+			}
+		else
+			{
+			if ( ! post_processor )
+				{
+				if ( ! post_processing.destination_dir.empty() &&
+				     ! util::detail::ensure_dir(post_processing.destination_dir.c_str()) )
+					reporter->Error("cannot create directory for rotated logs: %s",
+					                post_processing.destination_dir.c_str());
+
+				post_processor = new RotationPostProcessor(post_processing);
+				post_processor->Start();
+				}
+
+			auto id = ++next_post_processing_id;
+			pending_post_processing[id] = {std::move(info), std::move(func)};
+			post_processor->Queue(id, new_name);
+			return true;
+			}
+		}
+
 	// Call the postprocessor function.
 	int result = 0;
 
@@ -1644,4 +2052,20 @@ bool Manager::FinishedRotation(WriterFrontend* writer, const char* new_name, con
 	return result;
 	}
 
+void Manager::FinishedPostProcessing(uint64_t id, const std::string& fname)
+	{
+	auto i = pending_post_processing.find(id);
+
+	if ( i == pending_post_processing.end() )
+		return;
+
+	auto pending = std::move(i->second);
+	pending_post_processing.erase(i);
+
+	DBG_LOG(DBG_LOGGING, "Finished post-processing rotated log, new name %s", fname.c_str());
+
+	pending.info->Assign(1, make_intrusive<StringVal>(fname));
+	pending.postprocessor->Invoke(std::move(pending.info));
+	}
+
 } // namespace zeek::logging
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string_view>
 
 #include "../Val.h"
@@ -13,6 +14,8 @@
 
 #include "Component.h"
 #include "WriterBackend.h"
+#include "WriterFrontend.h"
+#include "RotationPostProcessor.h"
 
 namespace broker { struct endpoint_info; }
 ZEEK_FORWARD_DECLARE_NAMESPACED(SerializationFormat, zeek::detail);
@@ -24,6 +27,7 @@ namespace zeek {
 namespace logging {
 
 class RotationTimer;
+class PostProcessingFinishedMessage;
 
 /**
  * Singleton class for managing log streams.
@@ -191,6 +195,24 @@ public:
 	bool WriteFromRemote(EnumVal* stream, EnumVal* writer, const std::string& path,
 	                     int num_fields, threading::Value** vals);
 
+	/**
+	 * Writes out a number of log entries received from remote for the
+	 * same stream, writer, and path, looking those up just once.
+	 *
+	 * @param stream The enum value corresponding to the log stream.
+	 *
+	 * @param writer The enum value corresponding to the desired log writer.
+	 *
+	 * @param path The path of the target log stream to write to.
+	 *
+	 * @param num_fields The number of log values of each entry.
+	 *
+	 * @param records The entries' value arrays, each of size num_fields.
+	 * The method takes ownership of them and clears the vector.
+	 */
+	bool WriteFromRemote(EnumVal* stream, EnumVal* writer, const std::string& path,
+	                     int num_fields, std::vector<threading::Value**>* records);
+
 	/**
 	 * Announces all instantiated writers to a given Broker peer.
 	 */
@@ -249,11 +271,24 @@ public:
 	 */
 	RecordType* StreamColumns(EnumVal* stream_id);
 
+	typedef std::list<std::pair<std::string, WriterFrontend::Stats>> writer_stats_list;
+
+	/**
+	 * Returns statistics about the queues of all current writers.
+	 *
+	 * @return A list of statistics, with one entry for each writer.
+	 * Each entry is a tuple of writer name and statistics. The list
+	 * reference remains valid until the next call to this method (or
+	 * termination of the manager).
+	 */
+	const writer_stats_list& GetWriterStats();
+
 protected:
 	friend class WriterFrontend;
 	friend class RotationFinishedMessage;
 	friend class RotationFailedMessage;
 	friend class RotationTimer;
+	friend class PostProcessingFinishedMessage;
 
 	// Instantiates a new WriterBackend of the given type (note that
 	// doing so creates a new thread!).
@@ -271,6 +306,10 @@ protected:
 	bool FinishedRotation(WriterFrontend* writer, const char* new_name, const char* old_name,
 	                      double open, double close, bool success, bool terminating);
 
+	// Runs the post-processor of a rotated file once the native
+	// post-processing finished with it, see RotationPostProcessor.
+	void FinishedPostProcessing(uint64_t id, const std::string& fname);
+
 	// Deletes the values as passed into Write().
 	void DeleteVals(int num_fields, threading::Value** vals);
 
@@ -283,10 +322,14 @@ private:
 	                    TableVal* include, TableVal* exclude,
 	                    const std::string& path, const std::list<int>& indices);
 
+	bool InitFilterAggregation(Filter* filter, RecordVal* fval);
+
 	threading::Value** RecordToFilterVals(Stream* stream, Filter* filter,
-	                                      RecordVal* columns);
+	                                      RecordVal* columns, WriteBatch* batch,
+	                                      const std::shared_ptr<WriteBatch>& shared_batch,
+	                                      threading::Value** shared_vals);
 
-	threading::Value* ValToLogVal(Val* val, Type* ty = nullptr);
+	threading::Value* ValToLogVal(WriteBatch* batch, Val* val, Type* ty = nullptr);
 	Stream* FindStream(EnumVal* id);
 	void RemoveDisabledWriters(Stream* stream);
 	void InstallRotationTimer(WriterInfo* winfo);
@@ -298,6 +341,23 @@ private:
 	std::vector<Stream *> streams;	// Indexed by stream enum.
 	int rotations_pending;	// Number of rotations not yet finished.
 	FuncPtr rotation_format_func;
+
+	// Arena for column values shared by several filters, see Write().
+	std::shared_ptr<WriteBatch> shared_batch;
+
+	writer_stats_list writer_stats;
+
+	// Native post-processing of rotated files, with the thread created
+	// on first use. Files waiting for it are indexed by their ID.
+	struct PendingPostProcessing {
+		RecordValPtr info;
+		FuncPtr postprocessor;
+	};
+
+	RotationPostProcessor::Options post_processing;
+	RotationPostProcessor* post_processor = nullptr;
+	std::unordered_map<uint64_t, PendingPostProcessing> pending_post_processing;
+	uint64_t next_post_processing_id = 0;
 };
 
 } // namespace logging;
@@ -0,0 +1,281 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "RotationPostProcessor.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "digest.h"
+
+#include "Manager.h"
+
+namespace zeek::logging {
+
+class PostProcessMessage final : public threading::InputMessage<RotationPostProcessor>
+{
+public:
+	PostProcessMessage(RotationPostProcessor* processor, uint64_t id, std::string fname)
+		: threading::InputMessage<RotationPostProcessor>("PostProcess", processor),
+		id(id), fname(std::move(fname))	{}
+
+	bool Process() override	{ Object()->DoPostProcess(id, fname); return true; }
+
+private:
+	uint64_t id;
+	std::string fname;
+};
+
+class PostProcessingFinishedMessage final : public threading::OutputMessage<RotationPostProcessor>
+{
+public:
+	PostProcessingFinishedMessage(RotationPostProcessor* processor, uint64_t id,
+	                              std::string fname)
+		: threading::OutputMessage<RotationPostProcessor>("PostProcessingFinished", processor),
+		id(id), fname(std::move(fname))	{}
+
+	bool Process() override
+		{
+		log_mgr->FinishedPostProcessing(id, fname);
+		return true;
+		}
+
+private:
+	uint64_t id;
+	std::string fname;
+};
+
+static const size_t BUFFER_SIZE = 65536;
+
+static bool has_suffix(const std::string& s, const char* suffix)
+	{
+	auto n = strlen(suffix);
+	return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+	}
+
+// These run in the thread, so no util::fmt() and other helpers with
+// static buffers here.
+static std::string errno_error(const char* what, const std::string& fname)
+	{
+	return std::string("cannot ") + what + " " + fname + ": " + strerror(errno);
+	}
+
+static bool compress(int level, std::string* fname, std::string* error)
+	{
+	// Writers may have compressed the file already.
+	if ( has_suffix(*fname, ".gz") || has_suffix(*fname, ".zst") || has_suffix(*fname, ".lz4") )
+		return true;
+
+	auto out_name = *fname + ".gz";
+	FILE* in = fopen(fname->c_str(), "rb");
+
+	if ( ! in )
+		{
+		*error = errno_error("open", *fname);
+		return false;
+		}
+
+	auto mode = "wb" + std::to_string(level);
+	gzFile out = gzopen(out_name.c_str(), mode.c_str());
+
+	if ( ! out )
+		{
+		*error = errno_error("create", out_name);
+		fclose(in);
+		return false;
+		}
+
+	char buf[BUFFER_SIZE];
+	size_t n;
+	bool ok = true;
+
+	while ( ok && (n = fread(buf, 1, sizeof(buf), in)) > 0 )
+		ok = gzwrite(out, buf, n) == static_cast<int>(n);
+
+	ok = ok && ! ferror(in);
+	fclose(in);
+
+	if ( gzclose(out) != Z_OK || ! ok )
+		{
+		*error = "cannot compress " + *fname;
+		unlink(out_name.c_str());
+		return false;
+		}
+
+	unlink(fname->c_str());
+	*fname = std::move(out_name);
+	return true;
+	}
+
+static bool copy_file(const std::string& from, const std::string& to, std::string* error)
+	{
+	FILE* in = fopen(from.c_str(), "rb");
+
+	if ( ! in )
+		{
+		*error = errno_error("open", from);
+		return false;
+		}
+
+	FILE* out = fopen(to.c_str(), "wb");
+
+	if ( ! out )
+		{
+		*error = errno_error("create", to);
+		fclose(in);
+		return false;
+		}
+
+	char buf[BUFFER_SIZE];
+	size_t n;
+	bool ok = true;
+
+	while ( ok && (n = fread(buf, 1, sizeof(buf), in)) > 0 )
+		ok = fwrite(buf, 1, n, out) == n;
+
+	ok = ok && ! ferror(in);
+	fclose(in);
+
+	if ( fclose(out) != 0 || ! ok )
+		{
+		*error = errno_error("write", to);
+		unlink(to.c_str());
+		return false;
+		}
+
+	return true;
+	}
+
+static bool move_file(const std::string& dir, std::string* fname, std::string* error)
+	{
+	auto slash = fname->rfind('/');
+	auto base = slash == std::string::npos ? *fname : fname->substr(slash + 1);
+	auto target = dir + "/" + base;
+
+	if ( rename(fname->c_str(), target.c_str()) != 0 )
+		{
+		if ( errno != EXDEV )
+			{
+			*error = errno_error("move", *fname);
+			return false;
+			}
+
+		// Another file system.
+		if ( ! copy_file(*fname, target, error) )
+			return false;
+
+		unlink(fname->c_str());
+		}
+
+	*fname = std::move(target);
+	return true;
+	}
+
+static bool checksum(const std::string& fname, std::string* error)
+	{
+	FILE* in = fopen(fname.c_str(), "rb");
+
+	if ( ! in )
+		{
+		*error = errno_error("open", fname);
+		return false;
+		}
+
+	auto ctx = detail::hash_init(detail::Hash_SHA256);
+	char buf[BUFFER_SIZE];
+	size_t n;
+
+	while ( (n = fread(buf, 1, sizeof(buf), in)) > 0 )
+		detail::hash_update(ctx, buf, n);
+
+	bool ok = ! ferror(in);
+	fclose(in);
+
+	u_char digest[SHA256_DIGEST_LENGTH];
+	detail::hash_final(ctx, digest);
+
+	if ( ! ok )
+		{
+		*error = errno_error("read", fname);
+		return false;
+		}
+
+	// The format sha256sum -c reads.
+	auto slash = fname.rfind('/');
+	auto base = slash == std::string::npos ? fname : fname.substr(slash + 1);
+	auto sum_name = fname + ".sha256";
+	FILE* out = fopen(sum_name.c_str(), "w");
+
+	if ( ! out )
+		{
+		*error = errno_error("create", sum_name);
+		return false;
+		}
+
+	for ( auto b : digest )
+		fprintf(out, "%02x", b);
+
+	fprintf(out, "  %s\n", base.c_str());
+
+	if ( fclose(out) != 0 )
+		{
+		*error = errno_error("write", sum_name);
+		return false;
+		}
+
+	return true;
+	}
+
+RotationPostProcessor::RotationPostProcessor(const Options& arg_options)
+	: options(arg_options)
+	{
+	SetName("RotationPostProcessor");
+	}
+
+void RotationPostProcessor::Queue(uint64_t id, const std::string& fname)
+	{
+	SendIn(new PostProcessMessage(this, id, fname));
+	}
+
+bool RotationPostProcessor::PostProcess(const Options& options, std::string* fname,
+                                        std::string* error)
+	{
+	if ( options.compression_level > 0 &&
+	     ! compress(options.compression_level, fname, error) )
+		return false;
+
+	if ( ! options.destination_dir.empty() && ! move_file(options.destination_dir, fname, error) )
+		return false;
+
+	if ( options.checksum && ! checksum(*fname, error) )
+		return false;
+
+	return true;
+	}
+
+void RotationPostProcessor::DoPostProcess(uint64_t id, const std::string& fname)
+	{
+	auto name = fname;
+	std::string error;
+
+	if ( ! PostProcess(options, &name, &error) )
+		Error(Fmt("post-processing rotated log failed: %s", error.c_str()));
+
+	SendOut(new PostProcessingFinishedMessage(this, id, std::move(name)));
+	}
+
+bool RotationPostProcessor::ProcessReport()
+	{
+	auto msg = RetrieveOut();
+
+	if ( ! msg )
+		return false;
+
+	msg->Process();
+	delete msg;
+	return true;
+	}
+
+} // namespace zeek::logging
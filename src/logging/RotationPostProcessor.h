@@ -0,0 +1,91 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Native post-processing of rotated logs in a thread of its own.
+
+#pragma once
+
+#include <string>
+
+#include "threading/MsgThread.h"
+
+namespace zeek::logging {
+
+/**
+ * Post-processes rotated log files in a background thread: compresses
+ * them with gzip, moves them into another directory, and writes a
+ * SHA-256 checksum next to them, as configured through the
+ * ``Log::rotation_*`` options. Once done with a file, the thread reports
+ * its final name back to the logging manager, which then runs the
+ * script-level post-processor on it.
+ */
+class RotationPostProcessor : public threading::MsgThread {
+public:
+	/**
+	 * What to do with a rotated file.
+	 */
+	struct Options {
+		int compression_level = 0;	// gzip level, zero for none.
+		std::string destination_dir;	// Empty to leave files in place.
+		bool checksum = false;
+
+		bool Enabled() const
+			{ return compression_level > 0 || ! destination_dir.empty() || checksum; }
+	};
+
+	/**
+	 * Constructor.
+	 *
+	 * @param options What to do with the files.
+	 */
+	explicit RotationPostProcessor(const Options& options);
+
+	/**
+	 * Queues a file for post-processing.
+	 *
+	 * @param id An identifier for the manager to recognize the file by
+	 * once done.
+	 *
+	 * @param fname The name of the rotated file.
+	 */
+	void Queue(uint64_t id, const std::string& fname);
+
+	/**
+	 * Post-processes a file right away, from the calling thread.
+	 *
+	 * @param options What to do with the file.
+	 *
+	 * @param fname The name of the file, updated to follow it through
+	 * the steps taken. On failure, it's the name of the file as left
+	 * behind by the step failing.
+	 *
+	 * @param error Set to a description of the failure.
+	 *
+	 * @return True if all steps succeeded.
+	 */
+	static bool PostProcess(const Options& options, std::string* fname,
+	                        std::string* error);
+
+	/**
+	 * Post-processes a file on behalf of a queued request, reporting the
+	 * result to the manager. Called from the thread.
+	 */
+	void DoPostProcess(uint64_t id, const std::string& fname);
+
+	/**
+	 * Processes the next report from the thread, waiting for one to
+	 * arrive for a few seconds. For termination, when the threading
+	 * manager no longer gets to them.
+	 *
+	 * @return False if there wasn't any.
+	 */
+	bool ProcessReport();
+
+protected:
+	bool OnHeartbeat(double network_time, double current_time) override	{ return true; }
+	bool OnFinish(double network_time) override	{ return true; }
+
+private:
+	Options options;
+};
+
+} // namespace zeek::logging
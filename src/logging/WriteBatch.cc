@@ -0,0 +1,186 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "WriteBatch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include "MemoryTag.h"
+
+#include "3rdparty/doctest.h"
+
+using zeek::threading::Value;
+
+namespace zeek::logging {
+
+// Smallest arena chunk worth allocating.
+static constexpr size_t MIN_CHUNK_SIZE = 4096;
+
+WriteBatch::WriteBatch(int arg_num_fields, size_t size_hint)
+	: num_fields(arg_num_fields), pos(nullptr), end(nullptr), arena_bytes(0)
+	{
+	if ( size_hint > 0 )
+		{
+		size_t size = std::max(size_hint, MIN_CHUNK_SIZE);
+		chunks.push_back({new char[size], size});
+		zeek::detail::memory_tag_alloc(zeek::detail::MemoryTag::Logging, size);
+		pos = chunks.back().data;
+		end = pos + size;
+		}
+	}
+
+WriteBatch::~WriteBatch()
+	{
+	for ( auto vals : heap_records )
+		{
+		// Accounted in Add().
+		zeek::detail::memory_tag_free(zeek::detail::MemoryTag::Logging,
+		                              Value::value_ptr_array_allocation(vals, num_fields));
+		Value::delete_value_ptr_array(vals, num_fields);
+		}
+
+	// Values in the arena don't own anything outside of it, so there's no
+	// need to destruct them.
+	for ( const auto& c : chunks )
+		{
+		zeek::detail::memory_tag_free(zeek::detail::MemoryTag::Logging, c.size);
+		delete [] c.data;
+		}
+	}
+
+void* WriteBatch::Allocate(size_t size, size_t align)
+	{
+	auto aligned = [align](char* p)
+		{
+		auto a = reinterpret_cast<uintptr_t>(p);
+		return reinterpret_cast<char*>((a + align - 1) & ~(uintptr_t(align) - 1));
+		};
+
+	char* p = pos ? aligned(pos) : nullptr;
+
+	if ( ! p || size > static_cast<size_t>(end - p) )
+		{
+		// Grow geometrically, so that a batch far bigger than the
+		// hint still needs only a few chunks.
+		size_t csize = chunks.empty() ? MIN_CHUNK_SIZE : 2 * chunks.back().size;
+		csize = std::max(csize, size + align);
+
+		chunks.push_back({new char[csize], csize});
+		zeek::detail::memory_tag_alloc(zeek::detail::MemoryTag::Logging, csize);
+		pos = chunks.back().data;
+		end = pos + csize;
+		p = aligned(pos);
+		}
+
+	arena_bytes += (p - pos) + size;
+	pos = p + size;
+	return p;
+	}
+
+Value** WriteBatch::NewValues(size_t n)
+	{
+	auto vals = static_cast<Value**>(Allocate(n * sizeof(Value*), alignof(Value*)));
+	std::fill(vals, vals + n, nullptr);
+	return vals;
+	}
+
+Value* WriteBatch::NewValue(TypeTag type, bool present)
+	{
+	return new (Allocate(sizeof(Value), alignof(Value))) Value(type, present);
+	}
+
+char* WriteBatch::NewString(const char* data, size_t len)
+	{
+	auto s = static_cast<char*>(Allocate(len + 1, 1));
+	memcpy(s, data, len);
+	s[len] = '\0';
+	return s;
+	}
+
+bool WriteBatch::Owns(const Value* const* vals) const
+	{
+	auto p = reinterpret_cast<const char*>(vals);
+
+	for ( const auto& c : chunks )
+		{
+		if ( p >= c.data && p < c.data + c.size )
+			return true;
+		}
+
+	return false;
+	}
+
+void WriteBatch::Discard(Value** vals)
+	{
+	auto p = reinterpret_cast<char*>(vals);
+
+	if ( chunks.empty() || p < chunks.back().data || p >= pos )
+		return;
+
+	arena_bytes -= pos - p;
+	pos = p;
+	}
+
+void WriteBatch::Add(Value** vals)
+	{
+	if ( ! Owns(vals) )
+		{
+		// Released in the destructor.
+		zeek::detail::memory_tag_alloc(zeek::detail::MemoryTag::Logging,
+		                               Value::value_ptr_array_allocation(vals, num_fields));
+		heap_records.push_back(vals);
+		}
+
+	records.push_back(vals);
+	}
+
+TEST_CASE("logging write batch")
+	{
+	WriteBatch b(2, 0);
+	CHECK(b.ArenaBytes() == 0);
+
+	auto vals = b.NewValues(2);
+	CHECK(vals[0] == nullptr);
+	vals[0] = b.NewValue(TYPE_COUNT);
+	vals[0]->val.uint_val = 42;
+	vals[1] = b.NewValue(TYPE_STRING);
+	vals[1]->val.string_val.data = b.NewString("hello", 5);
+	vals[1]->val.string_val.length = 5;
+	CHECK(b.Owns(vals));
+	CHECK(strcmp(vals[1]->val.string_val.data, "hello") == 0);
+	CHECK(reinterpret_cast<uintptr_t>(vals[1]) % alignof(Value) == 0);
+	b.Add(vals);
+
+	auto discarded = b.NewValues(2);
+	auto used = b.ArenaBytes();
+	discarded[0] = b.NewValue(TYPE_BOOL, false);
+	b.Discard(discarded);
+	CHECK(b.ArenaBytes() < used);
+	CHECK(b.NewValues(2) == discarded);
+
+	auto heap = new Value*[2];
+	heap[0] = new Value(TYPE_COUNT);
+	heap[1] = new Value(TYPE_STRING, false);
+	CHECK_FALSE(b.Owns(heap));
+	b.Add(heap);
+
+	CHECK(b.Size() == 2);
+	CHECK(b.Records()[0][0]->val.uint_val == 42);
+	CHECK(b.Records()[1] == heap);
+
+	// Allocations beyond the first chunk go into further ones.
+	auto big = b.NewString(std::string(10000, 'x').c_str(), 10000);
+	CHECK(b.Owns(reinterpret_cast<Value**>(big)));
+	CHECK(b.ArenaBytes() > 10000);
+	CHECK(b.Owns(vals));
+
+	auto shared = std::make_shared<WriteBatch>(0, 0);
+	b.Retain(shared);
+	b.Retain(shared);
+	CHECK(shared.use_count() == 2);
+	}
+
+} // namespace zeek::logging
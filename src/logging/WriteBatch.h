@@ -0,0 +1,143 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "threading/SerialTypes.h"
+
+namespace zeek::logging {
+
+/**
+ * A batch of log records on their way from a WriterFrontend to its
+ * backend. The values of the records that the logging manager converts
+ * live in the batch's arena, including their strings and the elements of
+ * sets and vectors. The arena starts out with the space that the writer's
+ * previous batch needed, so it's normally a single allocation per batch.
+ * It gets released as a whole with the batch, without destructing the
+ * values in it.
+ *
+ * Records allocated on the heap, like those arriving from remote, can be
+ * added as well. The batch deletes them individually.
+ *
+ * Records may also point to values in the arena of another batch, which
+ * the logging manager uses to convert a column once for all filters of a
+ * stream. Retain() keeps such an arena around for as long as needed.
+ */
+class WriteBatch {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param num_fields The number of fields of the records.
+	 *
+	 * @param size_hint The number of bytes to reserve for the arena.
+	 */
+	WriteBatch(int num_fields, size_t size_hint);
+
+	/**
+	 * Destructor. Releases the arena and all records added.
+	 */
+	~WriteBatch();
+
+	WriteBatch(const WriteBatch&) = delete;
+	WriteBatch& operator=(const WriteBatch&) = delete;
+
+	/**
+	 * Allocates an array of value pointers in the arena.
+	 *
+	 * @param n The size of the array.
+	 */
+	threading::Value** NewValues(size_t n);
+
+	/**
+	 * Constructs a value in the arena. See threading::Value for the
+	 * arguments.
+	 */
+	threading::Value* NewValue(TypeTag type, bool present = true);
+
+	/**
+	 * Copies a string into the arena, with a terminating NUL.
+	 */
+	char* NewString(const char* data, size_t len);
+
+	/**
+	 * Returns true if a record's value array was allocated in the arena.
+	 */
+	bool Owns(const threading::Value* const* vals) const;
+
+	/**
+	 * Gives back the space of a record allocated in the arena that
+	 * doesn't get added after all. That only frees the space if nothing
+	 * else got allocated since, otherwise it stays in use until the
+	 * batch goes away.
+	 */
+	void Discard(threading::Value** vals);
+
+	/**
+	 * Appends a record to the batch, which takes ownership of it.
+	 *
+	 * @param vals The record's values, allocated either in the arena or,
+	 * along with each value, on the heap.
+	 */
+	void Add(threading::Value** vals);
+
+	/**
+	 * Keeps another batch, and so its arena, alive for as long as this
+	 * one exists. Records referencing values in the other batch's arena
+	 * must not outlive it.
+	 */
+	void Retain(const std::shared_ptr<WriteBatch>& other)
+		{
+		if ( retained.empty() || retained.back() != other )
+			retained.push_back(other);
+		}
+
+	/**
+	 * Returns the number of records in the batch.
+	 */
+	int Size() const	{ return static_cast<int>(records.size()); }
+
+	/**
+	 * Returns the records in the order they got added.
+	 */
+	threading::Value** const* Records() const	{ return records.data(); }
+
+	/**
+	 * Returns the number of bytes allocated in the arena so far.
+	 */
+	size_t ArenaBytes() const	{ return arena_bytes; }
+
+	/**
+	 * Records the time the batch got queued to the writer thread.
+	 */
+	void SetQueueTime(double t)	{ queue_time = t; }
+
+	/**
+	 * Returns the time the batch got queued to the writer thread.
+	 */
+	double QueueTime() const	{ return queue_time; }
+
+private:
+	void* Allocate(size_t size, size_t align);
+
+	struct Chunk {
+		char* data;
+		size_t size;
+	};
+
+	int num_fields;
+	std::vector<Chunk> chunks;	// The last one is the one to allocate from.
+	char* pos;	// Next free byte in the last chunk.
+	char* end;	// End of the last chunk.
+	size_t arena_bytes;
+	double queue_time = 0;
+
+	std::vector<threading::Value**> records;
+	std::vector<threading::Value**> heap_records;	// The ones to delete.
+	std::vector<std::shared_ptr<WriteBatch>> retained;
+};
+
+} // namespace zeek::logging
@@ -1,5 +1,7 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <memory>
+
 #include <broker/data.hh>
 
 #include "util.h"
@@ -8,6 +10,8 @@
 #include "Manager.h"
 #include "WriterBackend.h"
 #include "WriterFrontend.h"
+#include "WriteBatch.h"
+#include "Aggregator.h"
 
 // Messages sent from backend to frontend (i.e., "OutputMessages").
 
@@ -78,7 +82,22 @@ broker::data WriterBackend::WriterInfo::ToBroker() const
 
 	auto bppf = post_proc_func ? post_proc_func : "";
 
-	return broker::vector({path, rotation_base, rotation_interval, network_time, std::move(t), bppf});
+	auto by = broker::vector();
+
+	for ( auto i : aggregate_by )
+		by.emplace_back(static_cast<broker::count>(i));
+
+	auto reduce = broker::vector();
+
+	for ( const auto& r : aggregate_reduce )
+		{
+		reduce.emplace_back(static_cast<broker::count>(r.first));
+		reduce.emplace_back(static_cast<broker::count>(r.second));
+		}
+
+	return broker::vector({path, rotation_base, rotation_interval, network_time, std::move(t), bppf,
+	                       aggregate, std::move(by), std::move(reduce), aggregate_interval,
+	                       aggregate_count_field});
 	}
 
 bool WriterBackend::WriterInfo::FromBroker(broker::data d)
@@ -115,6 +134,44 @@ bool WriterBackend::WriterInfo::FromBroker(broker::data d)
 		config.insert(p);
 		}
 
+	// Peers running older versions don't send aggregation settings.
+	if ( v.size() < 11 )
+		return true;
+
+	auto baggregate = caf::get_if<bool>(&v[6]);
+	auto bby = caf::get_if<broker::vector>(&v[7]);
+	auto breduce = caf::get_if<broker::vector>(&v[8]);
+	auto binterval = caf::get_if<double>(&v[9]);
+	auto bcount_field = caf::get_if<std::string>(&v[10]);
+
+	if ( ! (baggregate && bby && breduce && binterval && bcount_field) ||
+	     breduce->size() % 2 != 0 )
+		return false;
+
+	for ( const auto& i : *bby )
+		{
+		auto c = caf::get_if<broker::count>(&i);
+
+		if ( ! c )
+			return false;
+
+		aggregate_by.push_back(*c);
+		}
+
+	for ( size_t i = 0; i < breduce->size(); i += 2 )
+		{
+		auto f = caf::get_if<broker::count>(&(*breduce)[i]);
+		auto r = caf::get_if<broker::count>(&(*breduce)[i + 1]);
+
+		if ( ! (f && r) )
+			return false;
+
+		aggregate_reduce.emplace_back(*f, *r);
+		}
+
+	aggregate = *baggregate;
+	aggregate_interval = *binterval;
+	aggregate_count_field = *bcount_field;
 	return true;
 	}
 
@@ -122,9 +179,11 @@ WriterBackend::WriterBackend(WriterFrontend* arg_frontend) : MsgThread()
 	{
 	num_fields = 0;
 	fields = nullptr;
+	aggregator = nullptr;
 	buffering = true;
 	frontend = arg_frontend;
 	info = new WriterInfo(frontend->Info());
+	queue_counters = frontend->QueueCounters();
 	rotation_counter = 0;
 
 	SetName(frontend->Name());
@@ -140,21 +199,18 @@ WriterBackend::~WriterBackend()
 		delete [] fields;
 		}
 
+	delete aggregator;
 	delete info;
 	}
 
-void WriterBackend::DeleteVals(int num_writes, Value*** vals)
+int WriterBackend::NumFields() const
 	{
-	for ( int j = 0; j < num_writes; ++j )
-		{
-		// Note this code is duplicated in Manager::DeleteVals().
-		for ( int i = 0; i < num_fields; i++ )
-			delete vals[j][i];
-
-		delete [] vals[j];
-		}
+	return aggregator ? aggregator->NumFields() : num_fields;
+	}
 
-	delete [] vals;
+const Field* const* WriterBackend::Fields() const
+	{
+	return aggregator ? aggregator->Fields() : fields;
 	}
 
 bool WriterBackend::FinishedRotation(const char* new_name, const char* old_name,
@@ -186,7 +242,19 @@ bool WriterBackend::Init(int arg_num_fields, const Field* const* arg_fields)
 	if ( Failed() )
 		return true;
 
-	if ( ! DoInit(*info, arg_num_fields, arg_fields) )
+	if ( info->aggregate )
+		{
+		aggregator = new Aggregator(*info, num_fields, fields);
+
+		if ( ! aggregator->Error().empty() )
+			{
+			Error(Fmt("cannot aggregate: %s", aggregator->Error().c_str()));
+			DisableFrontend();
+			return false;
+			}
+		}
+
+	if ( ! DoInit(*info, NumFields(), Fields()) )
 		{
 		DisableFrontend();
 		return false;
@@ -195,8 +263,30 @@ bool WriterBackend::Init(int arg_num_fields, const Field* const* arg_fields)
 	return true;
 	}
 
-bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
+bool WriterBackend::Write(int arg_num_fields, WriteBatch* batch)
+	{
+	std::unique_ptr<WriteBatch> batch_deleter(batch);
+	bool success = WriteRecords(arg_num_fields, batch);
+
+	auto latency = static_cast<uint64_t>((util::current_time() - batch->QueueTime()) * 1e6);
+	// Only this thread writes the latencies.
+	if ( latency > queue_counters->max_latency_usec )
+		queue_counters->max_latency_usec = latency;
+
+	queue_counters->latency_usec = latency;
+	queue_counters->written += batch->Size();
+	queue_counters->pending_writes -= batch->Size();
+	queue_counters->pending_bytes -= batch->ArenaBytes();
+	--queue_counters->pending_batches;
+
+	return success;
+	}
+
+bool WriterBackend::WriteRecords(int arg_num_fields, WriteBatch* batch)
 	{
+	int num_writes = batch->Size();
+	Value** const* vals = batch->Records();
+
 	// Double-check that the arguments match. If we get this from remote,
 	// something might be mixed up.
 	if ( num_fields != arg_num_fields )
@@ -208,7 +298,6 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 		Debug(DBG_LOGGING, msg);
 #endif
 
-		DeleteVals(num_writes, vals);
 		DisableFrontend();
 		return false;
 		}
@@ -226,7 +315,6 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 				Debug(DBG_LOGGING, msg);
 #endif
 				DisableFrontend();
-				DeleteVals(num_writes, vals);
 				return false;
 				}
 			}
@@ -234,18 +322,16 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 
 	bool success = true;
 
-	if ( ! Failed() )
+	if ( Failed() )
+		return true;
+
+	if ( aggregator )
 		{
 		for ( int j = 0; j < num_writes; j++ )
-			{
-			success = DoWrite(num_fields, fields, vals[j]);
-
-			if ( ! success )
-				break;
-			}
+			aggregator->Add(vals[j]);
 		}
-
-	DeleteVals(num_writes, vals);
+	else
+		success = DoWriteBatch(num_fields, fields, num_writes, vals);
 
 	if ( ! success )
 		DisableFrontend();
@@ -253,6 +339,33 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 	return success;
 	}
 
+bool WriterBackend::DoWriteBatch(int num_fields, const Field* const* fields,
+                                 int num_writes, Value** const* vals)
+	{
+	for ( int j = 0; j < num_writes; j++ )
+		{
+		if ( ! DoWrite(num_fields, fields, vals[j]) )
+			return false;
+		}
+
+	return true;
+	}
+
+bool WriterBackend::WriteAggregates(double network_time)
+	{
+	auto recs = aggregator->Take(network_time);
+	int n = aggregator->NumFields();
+	bool success = true;
+
+	if ( ! recs.empty() )
+		success = DoWriteBatch(n, aggregator->Fields(), recs.size(), recs.data());
+
+	for ( auto vals : recs )
+		Value::delete_value_ptr_array(vals, n);
+
+	return success;
+	}
+
 bool WriterBackend::SetBuf(bool enabled)
 	{
 	if ( enabled == buffering )
@@ -279,6 +392,13 @@ bool WriterBackend::Rotate(const char* rotated_path, double open,
 	if ( Failed() )
 		return true;
 
+	// Aggregates go into the file they accumulated for.
+	if ( aggregator && ! WriteAggregates(close) )
+		{
+		DisableFrontend();
+		return false;
+		}
+
 	rotation_counter = 1;
 
 	if ( ! DoRotate(rotated_path, open, close, terminating) )
@@ -316,6 +436,12 @@ bool WriterBackend::OnFinish(double network_time)
 	if ( Failed() )
 		return true;
 
+	if ( aggregator && ! WriteAggregates(network_time) )
+		{
+		DisableFrontend();
+		return false;
+		}
+
 	return DoFinish(network_time);
 	}
 
@@ -325,6 +451,13 @@ bool WriterBackend::OnHeartbeat(double network_time, double current_time)
 		return true;
 
 	SendOut(new FlushWriteBufferMessage(frontend));
+
+	if ( aggregator && aggregator->Due(network_time) && ! WriteAggregates(network_time) )
+		{
+		DisableFrontend();
+		return false;
+		}
+
 	return DoHeartbeat(network_time, current_time);
 	}
 
@@ -4,6 +4,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "threading/MsgThread.h"
 
 #include "Component.h"
@@ -14,6 +20,23 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(WriterFrontend, zeek, logging);
 
 namespace zeek::logging {
 
+class WriteBatch;
+class Aggregator;
+
+/**
+ * Counters of the writes queued up for a writer thread. The frontend and
+ * backend both update them, and the main thread reads them for
+ * statistics and to bound the queue.
+ */
+struct WriteQueueCounters {
+	std::atomic<uint64_t> pending_writes{0};	// Sent to the thread, not yet written.
+	std::atomic<uint64_t> pending_bytes{0};	// Arena bytes of these.
+	std::atomic<uint64_t> pending_batches{0};	// Batches not yet written.
+	std::atomic<uint64_t> written{0};	// Writes done by the thread.
+	std::atomic<uint64_t> latency_usec{0};	// From sending the last batch to written.
+	std::atomic<uint64_t> max_latency_usec{0};	// Longest of these.
+};
+
 /**
  * Base class for writer implementation. When the logging::Manager creates a
  * new logging filter, it instantiates a WriterFrontend. That then in turn
@@ -91,6 +114,33 @@ public:
 		 */
 		config_map config;
 
+		/**
+		 * True if the writer pre-aggregates records, see Aggregator.
+		 */
+		bool aggregate = false;
+
+		/**
+		 * The indices of the fields to aggregate records by.
+		 */
+		std::vector<int> aggregate_by;
+
+		/**
+		 * The indices of the fields to reduce when aggregating, each
+		 * with an Aggregator::Reduction.
+		 */
+		std::vector<std::pair<int, int>> aggregate_reduce;
+
+		/**
+		 * The interval at which aggregated records get written. Zero
+		 * writes them only when rotating and finishing.
+		 */
+		double aggregate_interval = 0.0;
+
+		/**
+		 * The name of the field counting the records aggregated.
+		 */
+		std::string aggregate_count_field;
+
 		WriterInfo() : path(nullptr), rotation_interval(0.0), rotation_base(0.0),
 		               network_time(0.0)
 			{
@@ -107,6 +157,12 @@ public:
 			for ( config_map::const_iterator i = other.config.begin(); i != other.config.end(); i++ )
 				config.insert(std::make_pair(util::copy_string(i->first),
 				                             util::copy_string(i->second)));
+
+			aggregate = other.aggregate;
+			aggregate_by = other.aggregate_by;
+			aggregate_reduce = other.aggregate_reduce;
+			aggregate_interval = other.aggregate_interval;
+			aggregate_count_field = other.aggregate_count_field;
 			}
 
 		~WriterInfo()
@@ -145,21 +201,21 @@ public:
 	bool Init(int num_fields, const threading::Field* const* fields);
 
 	/**
-	 * Writes one log entry.
+	 * Writes a batch of log entries.
 	 *
 	 * @param num_fields: The number of log fields for this stream. The
 	 * value must match what was passed to Init().
 	 *
-	 * @param An array of size \a num_fields with the log values. Their
-	 * types musst match with the field passed to Init(). The method
-	 * takes ownership of \a vals..
+	 * @param batch The log entries, each an array of size \a num_fields
+	 * with the log values. Their types musst match with the field passed
+	 * to Init(). The method takes ownership of \a batch.
 	 *
 	 * Returns false if an error occured, in which case the writer must
 	 * not be used any further.
 	 *
 	 * @return False if an error occured.
 	 */
-	bool Write(int num_fields, int num_writes, threading::Value*** vals);
+	bool Write(int num_fields, WriteBatch* batch);
 
 	/**
 	 * Sets the buffering status for the writer, assuming the writer
@@ -204,14 +260,16 @@ public:
 	const WriterInfo& Info() const	{ return *info; }
 
 	/**
-	 * Returns the number of log fields as passed into the constructor.
+	 * Returns the number of log fields the writer outputs. That's the
+	 * number passed into Init(), unless the writer pre-aggregates.
 	 */
-	int NumFields() const	{ return num_fields; }
+	int NumFields() const;
 
 	/**
-	 * Returns the log fields as passed into the constructor.
+	 * Returns the log fields the writer outputs. These are the fields
+	 * passed into Init(), unless the writer pre-aggregates.
 	 */
-	const threading::Field* const * Fields() const	{ return fields; }
+	const threading::Field* const * Fields() const;
 
 	/**
 	 * Returns the current buffering state.
@@ -292,6 +350,19 @@ protected:
 	virtual bool DoWrite(int num_fields, const threading::Field* const*  fields,
 			     threading::Value** vals) = 0;
 
+	/**
+	 * Writer-specific output method for a batch of log entries, in the
+	 * order they were written. The default implementation passes them
+	 * to DoWrite() one at a time. Writers that can serialize several
+	 * entries at once may override it. The values remain owned by the
+	 * batch and must not be kept beyond the call.
+	 *
+	 * If it returns false, it will be assumed that a fatal error has
+	 * occured, as with DoWrite().
+	 */
+	virtual bool DoWriteBatch(int num_fields, const threading::Field* const* fields,
+	                          int num_writes, threading::Value** const* vals);
+
 	/**
 	 * Writer-specific method implementing a change of fthe buffering
 	 * state.  If buffering is disabled, the writer should attempt to
@@ -382,10 +453,8 @@ protected:
 	virtual bool DoHeartbeat(double network_time, double current_time) = 0;
 
 private:
-	/**
-	 * Deletes the values as passed into Write().
-	 */
-	void DeleteVals(int num_writes, threading::Value*** vals);
+	bool WriteRecords(int num_fields, WriteBatch* batch);
+	bool WriteAggregates(double network_time);
 
 	// Frontend that instantiated us. This object must not be access from
 	// this class, it's running in a different thread!
@@ -394,6 +463,8 @@ private:
 	const WriterInfo* info;	// Meta information.
 	int num_fields;	// Number of log fields.
 	const threading::Field* const*  fields;	// Log fields.
+	Aggregator* aggregator;	// Set if pre-aggregating.
+	std::shared_ptr<WriteQueueCounters> queue_counters;	// Shared with the frontend.
 	bool buffering;	// True if buffering is enabled.
 
 	int rotation_counter; // Tracks FinishedRotation() calls.
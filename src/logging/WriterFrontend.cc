@@ -1,11 +1,17 @@
 
+#include <algorithm>
+#include <cinttypes>
+
 #include "RunState.h"
+#include "Reporter.h"
+#include "const.bif.h"
 #include "threading/SerialTypes.h"
 #include "broker/Manager.h"
 
 #include "Manager.h"
 #include "WriterFrontend.h"
 #include "WriterBackend.h"
+#include "WriteBatch.h"
 
 using zeek::threading::Value;
 using zeek::threading::Field;
@@ -54,16 +60,15 @@ private:
 class WriteMessage final : public threading::InputMessage<WriterBackend>
 {
 public:
-	WriteMessage(WriterBackend* backend, int num_fields, int num_writes, Value*** vals)
+	WriteMessage(WriterBackend* backend, int num_fields, WriteBatch* batch)
 		: threading::InputMessage<WriterBackend>("Write", backend),
-		num_fields(num_fields), num_writes(num_writes), vals(vals)	{}
+		num_fields(num_fields), batch(batch)	{}
 
-	bool Process() override { return Object()->Write(num_fields, num_writes, vals); }
+	bool Process() override { return Object()->Write(num_fields, batch); }
 
 private:
 	int num_fields;
-	int num_writes;
-	Value ***vals;
+	WriteBatch* batch;
 };
 
 class SetBufMessage final : public threading::InputMessage<WriterBackend>
@@ -105,10 +110,22 @@ WriterFrontend::WriterFrontend(const WriterBackend::WriterInfo& arg_info, EnumVa
 	buf = true;
 	local = arg_local;
 	remote = arg_remote;
-	write_buffer = nullptr;
-	write_buffer_pos = 0;
+	write_batch = nullptr;
+	write_batch_size_hint = 0;
+	write_batch_limit = WRITER_BUFFER_SIZE;
+	max_write_batch_limit = std::max(static_cast<int>(std::min(BifConst::Log::max_write_batch_size,
+	                                                           bro_uint_t(INT_MAX))),
+	                                 WRITER_BUFFER_SIZE);
 	info = new WriterBackend::WriterInfo(arg_info);
 
+	queue_counters = std::make_shared<WriteQueueCounters>();
+	max_pending_writes = BifConst::Log::max_pending_writes;
+	overload_sample_rate = BifConst::Log::overload_sample_rate;
+	overload_writes = 0;
+	overload_dropped = 0;
+	dropped = 0;
+	overloaded = false;
+
 	num_fields = 0;
 	fields = nullptr;
 
@@ -133,6 +150,7 @@ WriterFrontend::~WriterFrontend()
 		delete fields[i];
 
 	delete [] fields;
+	delete write_batch;
 
 	Unref(stream);
 	Unref(writer);
@@ -217,33 +235,53 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals)
 		return;
 		}
 
-	if ( ! write_buffer )
-		{
-		// Need new buffer.
-		write_buffer = new Value**[WRITER_BUFFER_SIZE];
-		write_buffer_pos = 0;
-		}
-
-	write_buffer[write_buffer_pos++] = vals;
+	Batch()->Add(vals);
 
-	if ( write_buffer_pos >= WRITER_BUFFER_SIZE || ! buf || run_state::terminating )
+	if ( write_batch->Size() >= write_batch_limit || ! buf || run_state::terminating )
 		// Buffer full (or no bufferin desired or termiating).
 		FlushWriteBuffer();
 
 	}
 
+WriteBatch* WriterFrontend::Batch()
+	{
+	if ( ! write_batch )
+		write_batch = new WriteBatch(num_fields, write_batch_size_hint);
+
+	return write_batch;
+	}
+
 void WriterFrontend::FlushWriteBuffer()
 	{
-	if ( ! write_buffer_pos )
+	if ( ! write_batch || ! write_batch->Size() )
 		// Nothing to do.
 		return;
 
+	// Size the next batch's arena for a batch like this one.
+	write_batch_size_hint = write_batch->ArenaBytes();
+
 	if ( backend )
-		backend->SendIn(new WriteMessage(backend, num_fields, write_buffer_pos, write_buffer));
+		{
+		// Grow batches while the thread still has earlier ones to
+		// write, to save it per-message work, and shrink them back
+		// once it keeps up.
+		if ( queue_counters->pending_batches > 0 )
+			write_batch_limit = std::min(2 * write_batch_limit, max_write_batch_limit);
+		else
+			write_batch_limit = std::max(write_batch_limit / 2, WRITER_BUFFER_SIZE);
+
+		queue_counters->pending_writes += write_batch->Size();
+		queue_counters->pending_bytes += write_batch->ArenaBytes();
+		++queue_counters->pending_batches;
+
+		write_batch->SetQueueTime(util::current_time());
+		backend->SendIn(new WriteMessage(backend, num_fields, write_batch));
+		}
+	else
+		delete write_batch;
 
-	// Clear buffer (no delete, we pass ownership to child thread.)
-	write_buffer = nullptr;
-	write_buffer_pos = 0;
+	// No delete, we pass ownership to child thread.
+	write_batch = nullptr;
 	}
 
 void WriterFrontend::SetBuf(bool enabled)
@@ -286,8 +324,65 @@ void WriterFrontend::Rotate(const char* rotated_path, double open, double close,
 		log_mgr->FinishedRotation(this, nullptr, nullptr, 0, 0, false, terminating);
 	}
 
+bool WriterFrontend::AdmitWrite()
+	{
+	if ( ! backend || ! max_pending_writes )
+		return true;
+
+	uint64_t pending = queue_counters->pending_writes + (write_batch ? write_batch->Size() : 0);
+
+	if ( pending < max_pending_writes )
+		{
+		if ( overloaded )
+			{
+			reporter->Info("log writer %s caught up after dropping %" PRIu64 " of %" PRIu64 " writes",
+			               name, overload_dropped, overload_writes);
+			overloaded = false;
+			overload_writes = 0;
+			overload_dropped = 0;
+			}
+
+		return true;
+		}
+
+	if ( ! overloaded )
+		{
+		reporter->Warning("log writer %s has %" PRIu64 " writes pending, %s further ones",
+		                  name, pending, overload_sample_rate ? "sampling" : "dropping");
+		overloaded = true;
+		}
+
+	++overload_writes;
+
+	if ( overload_sample_rate && overload_writes % overload_sample_rate == 0 )
+		return true;
+
+	++overload_dropped;
+	++dropped;
+	return false;
+	}
+
+void WriterFrontend::GetStats(Stats* stats) const
+	{
+	stats->pending_writes = queue_counters->pending_writes + (write_batch ? write_batch->Size() : 0);
+	stats->pending_bytes = queue_counters->pending_bytes;
+	stats->pending_batches = queue_counters->pending_batches;
+	stats->written = queue_counters->written;
+	stats->dropped = dropped;
+	stats->latency = queue_counters->latency_usec / 1e6;
+	stats->max_latency = queue_counters->max_latency_usec / 1e6;
+	stats->batch_size = write_batch_limit;
+	}
+
 void WriterFrontend::DeleteVals(int num_fields, Value** vals)
 	{
+	if ( write_batch && write_batch->Owns(vals) )
+		{
+		// Not written after all, give back the space if possible.
+		write_batch->Discard(vals);
+		return;
+		}
+
 	// Note this code is duplicated in Manager::DeleteVals().
 	for ( int i = 0; i < num_fields; i++ )
 		delete vals[i];
@@ -87,7 +87,8 @@ public:
 	 *
 	 * See WriterBackend::Writer() for arguments (except that this method
 	 * takes only a single record, not an array). The method takes
-	 * ownership of \a vals.
+	 * ownership of \a vals, which may have been allocated either in the
+	 * current Batch() or on the heap.
 	 *
 	 * This method must only be called from the main thread.
 	 */
@@ -183,9 +184,53 @@ public:
 	 */
 	const threading::Field* const * Fields() const	{ return fields; }
 
+	/**
+	 * Statistics about the writes queued up for the writer thread.
+	 */
+	struct Stats {
+		uint64_t pending_writes;	//! Writes not yet written, including those still batched up.
+		uint64_t pending_bytes;	//! Arena bytes of the writes queued to the thread.
+		uint64_t pending_batches;	//! Batches queued to the thread.
+		uint64_t written;	//! Writes done by the thread.
+		uint64_t dropped;	//! Writes dropped because of Log::max_pending_writes.
+		double latency;	//! Seconds from queueing the last batch to having written it.
+		double max_latency;	//! Longest such latency.
+		uint64_t batch_size;	//! Current limit on a batch's writes.
+	};
+
+	/**
+	 * Returns statistics about the writes queued up for the writer
+	 * thread.
+	 *
+	 * @param stats A pointer to a structure that will be filled with
+	 * current numbers.
+	 */
+	void GetStats(Stats* stats) const;
+
+	/**
+	 * Returns the queue counters shared with the backend. Only the
+	 * backend's constructor is supposed to call this.
+	 */
+	const std::shared_ptr<WriteQueueCounters>& QueueCounters() const
+		{ return queue_counters; }
+
 protected:
 	friend class Manager;
 
+	/**
+	 * Decides whether the next write gets accepted, which it may not
+	 * when more writes than Log::max_pending_writes are waiting for the
+	 * thread. Counts the writes rejected. The manager asks before
+	 * converting a record.
+	 */
+	bool AdmitWrite();
+
+	/**
+	 * Returns the batch that the next write goes into, for allocating
+	 * the record's values in its arena.
+	 */
+	WriteBatch* Batch();
+
 	void DeleteVals(int num_fields, threading::Value** vals);
 
 	EnumVal* stream;
@@ -203,10 +248,21 @@ protected:
 	int num_fields;	// The number of log fields.
 	const threading::Field* const*  fields;	// The log fields.
 
-	// Buffer for bulk writes.
+	// Batch for bulk writes. Batches grow from the minimum size toward
+	// Log::max_write_batch_size while the thread lags behind.
 	static const int WRITER_BUFFER_SIZE = 1000;
-	int write_buffer_pos;	// Position of next write in buffer.
-	threading::Value*** write_buffer;	// Buffer of size WRITER_BUFFER_SIZE.
+	WriteBatch* write_batch;	// Null if nothing was written since the last flush.
+	size_t write_batch_size_hint;	// Arena size of the previous batch.
+	int write_batch_limit;	// Number of writes at which a batch is full.
+	int max_write_batch_limit;
+
+	std::shared_ptr<WriteQueueCounters> queue_counters;
+	uint64_t max_pending_writes;	// Zero for no limit.
+	uint64_t overload_sample_rate;
+	uint64_t overload_writes;	// Writes arriving while over the limit.
+	uint64_t overload_dropped;	// Writes dropped while over the limit.
+	uint64_t dropped;	// Writes dropped overall.
+	bool overloaded;
 };
 
 } // namespace zeek::logging
@@ -202,6 +202,11 @@ Ascii::Ascii(WriterFrontend* frontend) : WriterBackend(frontend)
 	formatter = nullptr;
 	gzip_level = 0;
 	gzfile = nullptr;
+	compression_level = 0;
+	compression_threads = 1;
+	compression_block_size = 0;
+	compress = false;
+	compression_format = BlockCompressor::GZIP;
 
 	InitConfigOptions();
 	init_options = InitFilterOptions();
@@ -214,6 +219,9 @@ void Ascii::InitConfigOptions()
 	use_json = BifConst::LogAscii::use_json;
 	enable_utf_8 = BifConst::LogAscii::enable_utf_8;
 	gzip_level = BifConst::LogAscii::gzip_level;
+	compression_level = BifConst::LogAscii::compression_level;
+	compression_threads = BifConst::LogAscii::compression_threads;
+	compression_block_size = BifConst::LogAscii::compression_block_size;
 
 	separator.assign(
 			(const char*) BifConst::LogAscii::separator->Bytes(),
@@ -251,6 +259,11 @@ void Ascii::InitConfigOptions()
 		(const char*) BifConst::LogAscii::gzip_file_extension->Bytes(),
 		BifConst::LogAscii::gzip_file_extension->Len()
 		);
+
+	compression.assign(
+		(const char*) BifConst::LogAscii::compression->Bytes(),
+		BifConst::LogAscii::compression->Len()
+		);
 	}
 
 bool Ascii::InitFilterOptions()
@@ -343,14 +356,89 @@ bool Ascii::InitFilterOptions()
 
 		else if ( strcmp(i->first, "gzip_file_extension") == 0 )
 			gzip_file_extension.assign(i->second);
+
+		else if ( strcmp(i->first, "compression") == 0 )
+			compression.assign(i->second);
+
+		else if ( strcmp(i->first, "compression_level") == 0 )
+			compression_level = atoi(i->second);
+
+		else if ( strcmp(i->first, "compression_threads") == 0 )
+			compression_threads = atoi(i->second);
 		}
 
 	if ( ! InitFormatter() )
 		return false;
 
+	if ( ! InitCompression() )
+		return false;
+
+	return true;
+	}
+
+bool Ascii::InitCompression()
+	{
+	compress = false;
+
+	if ( compression.empty() )
+		{
+		if ( gzip_level == 0 )
+			return true;
+
+		compression_format = BlockCompressor::GZIP;
+		compression_level = gzip_level;
+		}
+
+	else
+		{
+		if ( ! BlockCompressor::ParseFormat(compression, &compression_format) )
+			{
+			Error(Fmt("invalid value for 'compression', must be one of \"gzip\", \"zstd\" or \"lz4\": %s",
+			          compression.c_str()));
+			return false;
+			}
+
+		if ( ! BlockCompressor::Available(compression_format) )
+			{
+			Error(Fmt("%s compression is not available in this build", compression.c_str()));
+			return false;
+			}
+		}
+
+	if ( compression_level < 0 ||
+	     compression_level > BlockCompressor::MaxLevel(compression_format) )
+		{
+		Error(Fmt("invalid value for 'compression_level', must be a number between 0 and %d.",
+		          BlockCompressor::MaxLevel(compression_format)));
+		return false;
+		}
+
+	compress = true;
+
+	// Only gzip as per gzip_level without threads retains the
+	// single-stream output.
+	if ( ! compression.empty() || compression_threads > 1 )
+		compressor = std::make_unique<BlockCompressor>(compression_format, compression_level,
+		                                               compression_threads,
+		                                               compression_block_size);
+
 	return true;
 	}
 
+std::string Ascii::CompressionExtension() const
+	{
+	switch ( compression_format ) {
+	case BlockCompressor::ZSTD:
+		return "zst";
+
+	case BlockCompressor::LZ4:
+		return "lz4";
+
+	default:
+		return gzip_file_extension.empty() ? "gz" : gzip_file_extension;
+	}
+	}
+
 bool Ascii::InitFormatter()
 	{
 	delete formatter;
@@ -441,10 +529,10 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const threading::Fiel
 		{
 		std::string ext = "." + LogExt();
 
-		if ( gzip_level > 0 )
+		if ( compress )
 			{
 			ext += ".";
-			ext += gzip_file_extension.empty() ? "gz" : gzip_file_extension;
+			ext += CompressionExtension();
 			}
 
 		fname += ext;
@@ -486,7 +574,7 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const threading::Fiel
 		return false;
 		}
 
-	if ( gzip_level > 0 )
+	if ( compress && ! compressor )
 		{
 		if ( gzip_level < 0 || gzip_level > 9 )
 			{
@@ -650,10 +738,10 @@ bool Ascii::DoRotate(const char* rotated_path, double open, double close, bool t
 
 	string nname = string(rotated_path) + "." + LogExt();
 
-	if ( gzip_level > 0 )
+	if ( compress )
 		{
 		nname += ".";
-		nname += gzip_file_extension.empty() ? "gz" : gzip_file_extension;
+		nname += CompressionExtension();
 		}
 
 	if ( rename(fname.c_str(), nname.c_str()) != 0 )
@@ -871,6 +959,15 @@ string Ascii::Timestamp(double t)
 
 bool Ascii::InternalWrite(int fd, const char* data, int len)
 	{
+	if ( compressor )
+		{
+		if ( compressor->Write(fd, data, len) )
+			return true;
+
+		Error(Fmt("Ascii::InternalWrite error: %s\n", compressor->LastError().c_str()));
+		return false;
+		}
+
 	if ( ! gzfile )
 		return util::safe_write(fd, data, len);
 
@@ -894,6 +991,18 @@ bool Ascii::InternalWrite(int fd, const char* data, int len)
 
 bool Ascii::InternalClose(int fd)
 	{
+	if ( compressor )
+		{
+		bool ok = compressor->Finish(fd);
+		util::safe_close(fd);
+
+		if ( ok )
+			return true;
+
+		Error(Fmt("Ascii::InternalClose error: %s\n", compressor->LastError().c_str()));
+		return false;
+		}
+
 	if ( ! gzfile )
 		{
 		util::safe_close(fd);
@@ -10,6 +10,8 @@
 #include "Desc.h"
 #include "zlib.h"
 
+#include "BlockCompressor.h"
+
 namespace zeek::plugin::detail::Zeek_AsciiWriter { class Plugin; }
 
 namespace zeek::logging::writer::detail {
@@ -49,11 +51,14 @@ private:
 	void InitConfigOptions();
 	bool InitFilterOptions();
 	bool InitFormatter();
+	bool InitCompression();
+	std::string CompressionExtension() const;
 	bool InternalWrite(int fd, const char* data, int len);
 	bool InternalClose(int fd);
 
 	int fd;
 	gzFile gzfile;
+	std::unique_ptr<BlockCompressor> compressor;	// Null unless compressing block-wise.
 	std::string fname;
 	ODesc desc;
 	bool ascii_done;
@@ -71,6 +76,12 @@ private:
 
 	int gzip_level; // level > 0 enables gzip compression
 	std::string gzip_file_extension;
+	std::string compression;	// Empty for gzip as per gzip_level.
+	int compression_level;
+	int compression_threads;
+	size_t compression_block_size;
+	bool compress;	// Derived from the options above.
+	BlockCompressor::Format compression_format;
 	bool use_json;
 	bool enable_utf_8;
 	std::string json_timestamps;
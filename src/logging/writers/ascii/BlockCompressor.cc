@@ -0,0 +1,325 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "zlib.h"
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef USE_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "util.h"
+
+namespace zeek::logging::writer::detail {
+
+bool BlockCompressor::ParseFormat(const std::string& name, Format* format)
+	{
+	if ( name == "gzip" )
+		*format = GZIP;
+	else if ( name == "zstd" )
+		*format = ZSTD;
+	else if ( name == "lz4" )
+		*format = LZ4;
+	else
+		return false;
+
+	return true;
+	}
+
+bool BlockCompressor::Available(Format format)
+	{
+	switch ( format ) {
+	case GZIP:
+		return true;
+
+	case ZSTD:
+#ifdef USE_ZSTD
+		return true;
+#else
+		return false;
+#endif
+
+	case LZ4:
+#ifdef USE_LZ4
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	return false;
+	}
+
+int BlockCompressor::MaxLevel(Format format)
+	{
+	switch ( format ) {
+	case GZIP:
+		return 9;
+
+	case ZSTD:
+#ifdef USE_ZSTD
+		return ZSTD_maxCLevel();
+#else
+		return 0;
+#endif
+
+	case LZ4:
+#ifdef USE_LZ4
+		return LZ4F_compressionLevel_max();
+#else
+		return 0;
+#endif
+	}
+
+	return 0;
+	}
+
+BlockCompressor::BlockCompressor(Format arg_format, int arg_level, int threads,
+                                 size_t arg_block_size)
+	: format(arg_format), level(arg_level), block_size(std::max(arg_block_size, size_t(1)))
+	{
+	current.reserve(block_size);
+
+	if ( threads > 1 )
+		{
+		for ( int i = 0; i < threads; ++i )
+			workers.emplace_back(&BlockCompressor::Work, this);
+		}
+	}
+
+BlockCompressor::~BlockCompressor()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		}
+
+	work_cond.notify_all();
+
+	for ( auto& w : workers )
+		w.join();
+	}
+
+bool BlockCompressor::Compress(Block* b) const
+	{
+	switch ( format ) {
+	case GZIP:
+		{
+		z_stream zs = {};
+
+		// A window size of 15 plus 16 gets a gzip header and trailer.
+		if ( deflateInit2(&zs, level > 0 ? level : Z_DEFAULT_COMPRESSION,
+		                  Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+			{
+			b->error = "cannot initialize gzip compression";
+			return false;
+			}
+
+		b->out.resize(deflateBound(&zs, b->in.size()));
+		zs.next_in = reinterpret_cast<Bytef*>(&b->in[0]);
+		zs.avail_in = b->in.size();
+		zs.next_out = reinterpret_cast<Bytef*>(&b->out[0]);
+		zs.avail_out = b->out.size();
+
+		int res = deflate(&zs, Z_FINISH);
+		b->out.resize(zs.total_out);
+
+		if ( res != Z_STREAM_END )
+			b->error = zs.msg ? zs.msg : "gzip compression failed";
+
+		deflateEnd(&zs);
+		return res == Z_STREAM_END;
+		}
+
+	case ZSTD:
+		{
+#ifdef USE_ZSTD
+		b->out.resize(ZSTD_compressBound(b->in.size()));
+		size_t n = ZSTD_compress(&b->out[0], b->out.size(), b->in.data(), b->in.size(),
+		                         level > 0 ? level : ZSTD_CLEVEL_DEFAULT);
+
+		if ( ZSTD_isError(n) )
+			{
+			b->error = ZSTD_getErrorName(n);
+			return false;
+			}
+
+		b->out.resize(n);
+		return true;
+#else
+		break;
+#endif
+		}
+
+	case LZ4:
+		{
+#ifdef USE_LZ4
+		LZ4F_preferences_t prefs = {};
+		prefs.frameInfo.contentSize = b->in.size();
+		prefs.compressionLevel = level;
+
+		b->out.resize(LZ4F_compressFrameBound(b->in.size(), &prefs));
+		size_t n = LZ4F_compressFrame(&b->out[0], b->out.size(), b->in.data(),
+		                              b->in.size(), &prefs);
+
+		if ( LZ4F_isError(n) )
+			{
+			b->error = LZ4F_getErrorName(n);
+			return false;
+			}
+
+		b->out.resize(n);
+		return true;
+#else
+		break;
+#endif
+		}
+	}
+
+	b->error = "compression format not available";
+	return false;
+	}
+
+void BlockCompressor::Work()
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while ( true )
+		{
+		work_cond.wait(lock, [this] { return stopping || ! todo.empty(); });
+
+		if ( stopping )
+			return;
+
+		Block* b = todo.front();
+		todo.pop_front();
+
+		lock.unlock();
+		bool ok = Compress(b);
+		lock.lock();
+
+		b->ok = ok;
+		b->done = true;
+		done_cond.notify_one();
+		}
+	}
+
+bool BlockCompressor::WriteBlock(int fd, Block* b)
+	{
+	if ( ! b->ok )
+		{
+		error = b->error;
+		return false;
+		}
+
+	if ( ! util::safe_write(fd, b->out.data(), b->out.size()) )
+		{
+		error = util::fmt("write failed: %s", strerror(errno));
+		return false;
+		}
+
+	return true;
+	}
+
+bool BlockCompressor::Submit(int fd)
+	{
+	if ( workers.empty() )
+		{
+		// Swapping keeps both buffers' memory around for the next block.
+		inline_block.in.swap(current);
+		current.clear();
+		inline_block.ok = Compress(&inline_block);
+		return WriteBlock(fd, &inline_block);
+		}
+
+	auto b = std::make_unique<Block>();
+	b->in.swap(current);
+	current.reserve(block_size);
+
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		todo.push_back(b.get());
+		pending.push_back(std::move(b));
+		}
+
+	work_cond.notify_one();
+
+	// Keep the workers busy, but don't let output pile up beyond a
+	// couple of blocks each.
+	return WriteBlocks(fd, 2 * workers.size());
+	}
+
+bool BlockCompressor::WriteBlocks(int fd, size_t max_pending)
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while ( ! pending.empty() )
+		{
+		if ( ! pending.front()->done )
+			{
+			if ( pending.size() <= max_pending )
+				break;
+
+			done_cond.wait(lock, [this] { return pending.front()->done; });
+			}
+
+		auto b = std::move(pending.front());
+		pending.pop_front();
+
+		lock.unlock();
+		bool ok = WriteBlock(fd, b.get());
+		lock.lock();
+
+		if ( ! ok )
+			{
+			// Don't write anything after the missing block, but
+			// wait for the workers to be done with the rest.
+			done_cond.wait(lock, [this] { return todo.empty() &&
+				std::all_of(pending.begin(), pending.end(),
+				            [](const auto& p) { return p->done; }); });
+			pending.clear();
+			return false;
+			}
+		}
+
+	return true;
+	}
+
+bool BlockCompressor::Write(int fd, const char* data, size_t len)
+	{
+	while ( len > 0 )
+		{
+		size_t n = std::min(len, block_size - current.size());
+		current.append(data, n);
+		data += n;
+		len -= n;
+
+		if ( current.size() >= block_size && ! Submit(fd) )
+			return false;
+		}
+
+	return true;
+	}
+
+bool BlockCompressor::Finish(int fd)
+	{
+	if ( ! current.empty() && ! Submit(fd) )
+		{
+		current.clear();
+		return false;
+		}
+
+	return WriteBlocks(fd, 0);
+	}
+
+} // namespace zeek::logging::writer::detail
@@ -0,0 +1,120 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Block-wise, optionally parallel compression of log output.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zeek::logging::writer::detail {
+
+/**
+ * Compresses a stream of output in blocks of a fixed size, each of which
+ * becomes an independent gzip member, zstd frame or LZ4 frame. The
+ * standard tools decompress such concatenations like a file compressed
+ * in one go. Since the blocks don't depend on each other, worker threads
+ * can compress several at once. The compressed blocks still get written
+ * out in order, from the thread calling Write() and Close().
+ *
+ * Only the threads writing and closing are expected to call into an
+ * instance, and only one at a time.
+ */
+class BlockCompressor {
+public:
+	enum Format { GZIP, ZSTD, LZ4 };
+
+	/**
+	 * Parses the name of a format, one of "gzip", "zstd" and "lz4".
+	 * Returns false if unknown.
+	 */
+	static bool ParseFormat(const std::string& name, Format* format);
+
+	/**
+	 * Returns true if Zeek got built with support for a format.
+	 */
+	static bool Available(Format format);
+
+	/**
+	 * Returns the highest compression level of a format.
+	 */
+	static int MaxLevel(Format format);
+
+	/**
+	 * Constructor.
+	 *
+	 * @param format The compression format.
+	 *
+	 * @param level The compression level, with 0 for the format's default.
+	 *
+	 * @param threads The number of threads compressing. With zero or one
+	 * blocks get compressed by the thread writing.
+	 *
+	 * @param block_size The number of bytes going into each block.
+	 */
+	BlockCompressor(Format format, int level, int threads, size_t block_size);
+
+	/**
+	 * Destructor. Discards output not yet written.
+	 */
+	~BlockCompressor();
+
+	BlockCompressor(const BlockCompressor&) = delete;
+	BlockCompressor& operator=(const BlockCompressor&) = delete;
+
+	/**
+	 * Adds output, writing compressed blocks to a file descriptor as they
+	 * become available. Returns false on error, see LastError().
+	 */
+	bool Write(int fd, const char* data, size_t len);
+
+	/**
+	 * Compresses any remaining output and writes out all blocks. The
+	 * compressor may then be used for another file. Returns false on
+	 * error, see LastError().
+	 */
+	bool Finish(int fd);
+
+	/**
+	 * Returns a description of the last error.
+	 */
+	const std::string& LastError() const	{ return error; }
+
+private:
+	struct Block {
+		std::string in;
+		std::string out;
+		bool done = false;
+		bool ok = true;
+		std::string error;
+	};
+
+	bool Compress(Block* b) const;
+	bool Submit(int fd);
+	bool WriteBlocks(int fd, size_t max_pending);
+	bool WriteBlock(int fd, Block* b);
+	void Work();
+
+	Format format;
+	int level;
+	size_t block_size;
+	std::string current;	// Output not yet in a block.
+	std::string error;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable work_cond;	// Signals workers of new blocks.
+	std::condition_variable done_cond;	// Signals the writer of finished ones.
+	std::deque<std::unique_ptr<Block>> pending;	// In output order.
+	std::deque<Block*> todo;	// Blocks waiting for a worker.
+	bool stopping = false;
+	Block inline_block;	// Reused when compressing without workers.
+};
+
+} // namespace zeek::logging::writer::detail
@@ -0,0 +1,324 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "Parquet.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+
+#include <arrow/io/file.h>
+#include <arrow/util/compression.h>
+
+#include "threading/SerialTypes.h"
+#include "threading/Formatter.h"
+#include "ID.h"
+#include "Val.h"
+
+using zeek::threading::Value;
+using zeek::threading::Field;
+
+namespace zeek::logging::writer::detail {
+
+Parquet::Parquet(WriterFrontend* frontend)
+	: WriterBackend(frontend), num_rows(0)
+	{
+	// The options need reading on the main thread, so do it here
+	// rather than in DoInit().
+	const auto* c = id::find_val("LogParquet::compression")->AsStringVal();
+	compression.assign(reinterpret_cast<const char*>(c->Bytes()), c->Len());
+	compression_level = id::find_val("LogParquet::compression_level")->AsInt();
+	batch_size = id::find_val("LogParquet::batch_size")->AsCount();
+	}
+
+Parquet::~Parquet()
+	{
+	// DoFinish() may not have been called.
+	CloseFile();
+	}
+
+std::shared_ptr<arrow::DataType> Parquet::ArrowType(TypeTag type, TypeTag subtype)
+	{
+	switch ( type ) {
+	case TYPE_BOOL:
+		return arrow::boolean();
+
+	case TYPE_INT:
+		return arrow::int64();
+
+	case TYPE_COUNT:
+		return arrow::uint64();
+
+	case TYPE_PORT: // Like the other writers, without the protocol.
+		return arrow::uint16();
+
+	case TYPE_TIME:
+		return arrow::timestamp(arrow::TimeUnit::MICRO);
+
+	case TYPE_INTERVAL:
+	case TYPE_DOUBLE:
+		return arrow::float64();
+
+	case TYPE_ADDR:
+	case TYPE_SUBNET:
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		return arrow::utf8();
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		auto element = ArrowType(subtype, TYPE_VOID);
+
+		if ( ! element )
+			return nullptr;
+
+		return arrow::list(element);
+		}
+
+	default:
+		return nullptr;
+	}
+	}
+
+bool Parquet::CheckStatus(const arrow::Status& status, const char* what)
+	{
+	if ( status.ok() )
+		return true;
+
+	Error(Fmt("Parquet %s failed for %s: %s", what, fname.c_str(),
+	          status.ToString().c_str()));
+	return false;
+	}
+
+bool Parquet::DoInit(const WriterInfo& info, int num_fields,
+                     const Field* const* fields)
+	{
+	auto codec = arrow::util::Codec::GetCompressionType(compression);
+
+	if ( ! codec.ok() )
+		{
+		Error(Fmt("invalid Parquet compression: %s",
+		          codec.status().ToString().c_str()));
+		return false;
+		}
+
+	parquet::WriterProperties::Builder props;
+	props.compression(*codec);
+
+	if ( compression_level != 0 )
+		props.compression_level(compression_level);
+
+	std::vector<std::shared_ptr<arrow::Field>> arrow_fields;
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		auto type = ArrowType(fields[i]->type, fields[i]->subtype);
+
+		if ( ! type )
+			{
+			Error(Fmt("unsupported field format %d for %s", fields[i]->type,
+			          fields[i]->name));
+			return false;
+			}
+
+		// Strings like enums, addresses and names mostly repeat, which
+		// dictionary encoding takes care of. Numbers rarely gain from it.
+		if ( type->id() != arrow::Type::STRING && type->id() != arrow::Type::LIST )
+			props.disable_dictionary(fields[i]->name);
+
+		auto builder = arrow::MakeBuilder(type);
+
+		if ( ! CheckStatus(builder.status(), "setup") )
+			return false;
+
+		builders.push_back(std::move(*builder));
+		arrow_fields.push_back(arrow::field(fields[i]->name, type));
+		}
+
+	schema = arrow::schema(std::move(arrow_fields));
+	properties = props.build();
+
+	fname = std::string(info.path) + "." + LogExt();
+	return OpenFile();
+	}
+
+bool Parquet::OpenFile()
+	{
+	auto sink = arrow::io::FileOutputStream::Open(fname);
+
+	if ( ! CheckStatus(sink.status(), "open") )
+		return false;
+
+	auto file_writer = parquet::arrow::FileWriter::Open(*schema,
+	                                                    arrow::default_memory_pool(),
+	                                                    *sink, properties);
+
+	if ( ! CheckStatus(file_writer.status(), "open") )
+		return false;
+
+	writer = std::move(*file_writer);
+	return true;
+	}
+
+arrow::Status Parquet::Append(arrow::ArrayBuilder* builder, const Value* val)
+	{
+	if ( ! val->present )
+		return builder->AppendNull();
+
+	switch ( val->type ) {
+	case TYPE_BOOL:
+		return static_cast<arrow::BooleanBuilder*>(builder)->Append(val->val.int_val != 0);
+
+	case TYPE_INT:
+		return static_cast<arrow::Int64Builder*>(builder)->Append(val->val.int_val);
+
+	case TYPE_COUNT:
+		return static_cast<arrow::UInt64Builder*>(builder)->Append(val->val.uint_val);
+
+	case TYPE_PORT:
+		return static_cast<arrow::UInt16Builder*>(builder)->Append(
+			static_cast<uint16_t>(val->val.port_val.port));
+
+	case TYPE_TIME:
+		{
+		auto usecs = static_cast<int64_t>(std::round(val->val.double_val * 1e6));
+		return static_cast<arrow::TimestampBuilder*>(builder)->Append(usecs);
+		}
+
+	case TYPE_INTERVAL:
+	case TYPE_DOUBLE:
+		return static_cast<arrow::DoubleBuilder*>(builder)->Append(val->val.double_val);
+
+	case TYPE_ADDR:
+		return static_cast<arrow::StringBuilder*>(builder)->Append(
+			threading::Formatter::Render(val->val.addr_val));
+
+	case TYPE_SUBNET:
+		return static_cast<arrow::StringBuilder*>(builder)->Append(
+			threading::Formatter::Render(val->val.subnet_val));
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		return static_cast<arrow::StringBuilder*>(builder)->Append(
+			val->val.string_val.data, val->val.string_val.length);
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		auto list = static_cast<arrow::ListBuilder*>(builder);
+		const auto& elements = val->type == TYPE_TABLE ? val->val.set_val
+		                                               : val->val.vector_val;
+		ARROW_RETURN_NOT_OK(list->Append());
+
+		for ( bro_int_t i = 0; i < elements.size; ++i )
+			ARROW_RETURN_NOT_OK(Append(list->value_builder(), elements.vals[i]));
+
+		return arrow::Status::OK();
+		}
+
+	default:
+		return arrow::Status::NotImplemented("unsupported field format ", val->type);
+	}
+	}
+
+bool Parquet::DoWrite(int num_fields, const Field* const* fields, Value** vals)
+	{
+	if ( ! writer && ! OpenFile() )
+		return false;
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		if ( ! CheckStatus(Append(builders[i].get(), vals[i]), "write") )
+			return false;
+		}
+
+	if ( static_cast<uint64_t>(++num_rows) >= batch_size )
+		return WriteBatch();
+
+	return true;
+	}
+
+bool Parquet::WriteBatch()
+	{
+	if ( num_rows == 0 )
+		return true;
+
+	std::vector<std::shared_ptr<arrow::Array>> columns;
+	columns.reserve(builders.size());
+
+	for ( auto& b : builders )
+		{
+		std::shared_ptr<arrow::Array> column;
+
+		if ( ! CheckStatus(b->Finish(&column), "write") )
+			return false;
+
+		columns.push_back(std::move(column));
+		}
+
+	auto table = arrow::Table::Make(schema, columns, num_rows);
+	auto rows = num_rows;
+	num_rows = 0;
+
+	// All rows make one row group.
+	return CheckStatus(writer->WriteTable(*table, rows), "write");
+	}
+
+bool Parquet::CloseFile()
+	{
+	if ( ! writer )
+		return true;
+
+	bool ok = WriteBatch();
+	ok = CheckStatus(writer->Close(), "close") && ok;
+	writer.reset();
+	return ok;
+	}
+
+bool Parquet::DoRotate(const char* rotated_path, double open, double close, bool terminating)
+	{
+	// Nothing written since the last rotation.
+	if ( ! writer )
+		{
+		FinishedRotation();
+		return true;
+		}
+
+	if ( ! CloseFile() )
+		{
+		FinishedRotation();
+		return false;
+		}
+
+	std::string nname = std::string(rotated_path) + "." + LogExt();
+
+	if ( rename(fname.c_str(), nname.c_str()) != 0 )
+		{
+		Error(Fmt("failed to rename %s to %s: %s", fname.c_str(),
+		          nname.c_str(), Strerror(errno)));
+		FinishedRotation();
+		return false;
+		}
+
+	// The next file gets opened with the next write.
+	if ( ! FinishedRotation(nname.c_str(), fname.c_str(), open, close, terminating) )
+		{
+		Error(Fmt("error rotating %s to %s", fname.c_str(), nname.c_str()));
+		return false;
+		}
+
+	return true;
+	}
+
+bool Parquet::DoFinish(double network_time)
+	{
+	return CloseFile();
+	}
+
+} // namespace zeek::logging::writer::detail
@@ -0,0 +1,77 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Log writer for columnar Parquet logs.
+
+#pragma once
+
+#include "zeek-config.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+#include <parquet/arrow/writer.h>
+
+#include "logging/WriterBackend.h"
+
+namespace zeek::logging::writer::detail {
+
+/**
+ * Writes logs as Parquet files. Log entries get appended column by
+ * column to Arrow builders, and every LogParquet::batch_size entries go
+ * out as a row group. Parquet readers need the file's footer, so a file
+ * only becomes readable once closed, at rotation or shutdown.
+ */
+class Parquet : public WriterBackend {
+public:
+	explicit Parquet(WriterFrontend* frontend);
+	~Parquet() override;
+
+	static std::string LogExt()	{ return "parquet"; }
+
+	static WriterBackend* Instantiate(WriterFrontend* frontend)
+		{ return new Parquet(frontend); }
+
+protected:
+	bool DoInit(const WriterInfo& info, int num_fields,
+	            const threading::Field* const* fields) override;
+	bool DoWrite(int num_fields, const threading::Field* const* fields,
+	             threading::Value** vals) override;
+	bool DoSetBuf(bool enabled) override { return true; }
+	bool DoRotate(const char* rotated_path, double open,
+	              double close, bool terminating) override;
+	bool DoFlush(double network_time) override { return true; }
+	bool DoFinish(double network_time) override;
+	bool DoHeartbeat(double network_time, double current_time) override { return true; }
+
+private:
+	/**
+	 * Returns the Arrow type for a log field's type, or null if not
+	 * supported.
+	 */
+	static std::shared_ptr<arrow::DataType> ArrowType(TypeTag type, TypeTag subtype);
+
+	/**
+	 * Appends a value to the builder of its column.
+	 */
+	arrow::Status Append(arrow::ArrayBuilder* builder, const threading::Value* val);
+
+	bool OpenFile();
+	bool WriteBatch();
+	bool CloseFile();
+	bool CheckStatus(const arrow::Status& status, const char* what);
+
+	std::string fname;
+	std::shared_ptr<arrow::Schema> schema;
+	std::shared_ptr<parquet::WriterProperties> properties;
+	std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders;
+	std::unique_ptr<parquet::arrow::FileWriter> writer;	// Null while no file is open.
+	int64_t num_rows;	// Rows in the builders.
+
+	std::string compression;
+	int compression_level;
+	uint64_t batch_size;
+};
+
+} // namespace zeek::logging::writer::detail
@@ -4,6 +4,7 @@
 
 #include <string>
 #include <errno.h>
+#include <strings.h>
 #include <vector>
 
 #include "threading/SerialTypes.h"
@@ -17,10 +18,17 @@ using zeek::threading::Field;
 
 namespace zeek::logging::writer::detail {
 
+// How long to wait for another connection's transaction to finish.
+static const int BUSY_TIMEOUT_MSEC = 10000;
+
 SQLite::SQLite(WriterFrontend* frontend)
 	: WriterBackend(frontend),
-	  fields(), num_fields(), db(), st()
+	  fields(), num_fields(), db(), st(), begin_st(), commit_st(),
+	  in_transaction(), transaction_rows(), transaction_start()
 	{
+	batch_size = BifConst::LogSQLite::batch_size;
+	batch_interval = BifConst::LogSQLite::batch_interval;
+
 	set_separator.assign(
 			(const char*) BifConst::LogSQLite::set_separator->Bytes(),
 			BifConst::LogSQLite::set_separator->Len()
@@ -44,7 +52,10 @@ SQLite::~SQLite()
 	{
 	if ( db != 0 )
 		{
+		Commit();
 		sqlite3_finalize(st);
+		sqlite3_finalize(begin_st);
+		sqlite3_finalize(commit_st);
 		if ( ! sqlite3_close(db) )
 			Error("Sqlite could not close connection");
 
@@ -140,16 +151,42 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 	else
 		tablename = it->second;
 
-	if ( checkError(sqlite3_open_v2(
-					fullpath.c_str(),
-					&db,
-					SQLITE_OPEN_READWRITE |
-					SQLITE_OPEN_CREATE |
-					SQLITE_OPEN_NOMUTEX
-					,
-					NULL)) )
+	// With the shared cache, only one connection may have a write
+	// transaction open at a time, failing all others right away. So when
+	// batching, use a cache of our own and wait for any other writer of
+	// the same database to commit instead.
+	int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+
+	if ( batch_size > 1 )
+		flags |= SQLITE_OPEN_PRIVATECACHE;
+
+	if ( checkError(sqlite3_open_v2(fullpath.c_str(), &db, flags, NULL)) )
 		return false;
 
+	if ( batch_size > 1 )
+		sqlite3_busy_timeout(db, BUSY_TIMEOUT_MSEC);
+
+	string journal_mode(
+		(const char*) BifConst::LogSQLite::journal_mode->Bytes(),
+		BifConst::LogSQLite::journal_mode->Len());
+
+	if ( ! journal_mode.empty() )
+		{
+		// Returns the resulting mode as a row, which we don't need.
+		string pragma = "PRAGMA journal_mode=" + journal_mode + ";";
+
+		if ( strcasecmp(journal_mode.c_str(), "WAL") == 0 )
+			pragma += "PRAGMA synchronous=NORMAL;";
+
+		char *errorMsg = 0;
+		if ( sqlite3_exec(db, pragma.c_str(), NULL, NULL, &errorMsg) != SQLITE_OK )
+			{
+			Error(Fmt("Error setting journal mode: %s", errorMsg));
+			sqlite3_free(errorMsg);
+			return false;
+			}
+		}
+
 	string create = "CREATE TABLE IF NOT EXISTS " + tablename + " (\n";
 		//"id SERIAL UNIQUE NOT NULL"; // SQLite has rowids, we do not need a counter here.
 
@@ -233,9 +270,43 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 	if ( checkError(sqlite3_prepare_v2(db, insert.c_str(), insert.size()+1, &st, NULL)) )
 		return false;
 
+	if ( checkError(sqlite3_prepare_v2(db, "BEGIN", -1, &begin_st, NULL)) ||
+	     checkError(sqlite3_prepare_v2(db, "COMMIT", -1, &commit_st, NULL)) )
+		return false;
+
 	return true;
 	}
 
+bool SQLite::Exec(sqlite3_stmt* stmt)
+	{
+	int res = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	return ! checkError(res);
+	}
+
+bool SQLite::Begin()
+	{
+	if ( in_transaction )
+		return true;
+
+	if ( ! Exec(begin_st) )
+		return false;
+
+	in_transaction = true;
+	transaction_rows = 0;
+	transaction_start = util::current_time(true);
+	return true;
+	}
+
+bool SQLite::Commit()
+	{
+	if ( ! in_transaction )
+		return true;
+
+	in_transaction = false;
+	return Exec(commit_st);
+	}
+
 int SQLite::AddParams(Value* val, int pos)
 	{
 	if ( ! val->present )
@@ -334,6 +405,11 @@ int SQLite::AddParams(Value* val, int pos)
 
 bool SQLite::DoWrite(int num_fields, const Field* const * fields, Value** vals)
 	{
+	// Without a transaction of our own, SQLite commits every row right
+	// away, which costs a sync to disk each.
+	if ( batch_size > 1 && IsBuf() && ! Begin() )
+		return false;
+
 	// bind parameters
 	for ( int i = 0; i < num_fields; i++ )
 		{
@@ -352,11 +428,34 @@ bool SQLite::DoWrite(int num_fields, const Field* const * fields, Value** vals)
 	if ( checkError(sqlite3_reset(st)) )
 		return false;
 
+	if ( in_transaction && ++transaction_rows >= batch_size )
+		return Commit();
+
+	return true;
+	}
+
+bool SQLite::DoSetBuf(bool enabled)
+	{
+	// Unbuffered, rows go out one by one.
+	if ( ! enabled )
+		return Commit();
+
+	return true;
+	}
+
+bool SQLite::DoHeartbeat(double network_time, double current_time)
+	{
+	if ( in_transaction && util::current_time(true) - transaction_start >= batch_interval )
+		return Commit();
+
 	return true;
 	}
 
 bool SQLite::DoRotate(const char* rotated_path, double open, double close, bool terminating)
 	{
+	if ( ! Commit() )
+		return false;
+
 	if ( ! FinishedRotation("/dev/null", Info().path, open, close, terminating))
 		{
 		Error(Fmt("error rotating %s", Info().path));
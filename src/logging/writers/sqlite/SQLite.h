@@ -26,16 +26,21 @@ protected:
 			    const threading::Field* const* arg_fields) override;
 	bool DoWrite(int num_fields, const threading::Field* const* fields,
 			     threading::Value** vals) override;
-	bool DoSetBuf(bool enabled) override { return true; }
+	bool DoSetBuf(bool enabled) override;
 	bool DoRotate(const char* rotated_path, double open,
 			      double close, bool terminating) override;
-	bool DoFlush(double network_time) override { return true; }
-	bool DoFinish(double network_time) override { return true; }
-	bool DoHeartbeat(double network_time, double current_time) override { return true; }
+	bool DoFlush(double network_time) override { return Commit(); }
+	bool DoFinish(double network_time) override { return Commit(); }
+	bool DoHeartbeat(double network_time, double current_time) override;
 
 private:
 	bool checkError(int code);
 
+	// Start and end the transaction that batches writes.
+	bool Begin();
+	bool Commit();
+	bool Exec(sqlite3_stmt* stmt);
+
 	int AddParams(threading::Value* val, int pos);
 	std::string GetTableType(int, int);
 
@@ -44,6 +49,14 @@ private:
 
 	sqlite3 *db;
 	sqlite3_stmt *st;
+	sqlite3_stmt *begin_st;
+	sqlite3_stmt *commit_st;
+
+	bro_uint_t batch_size;
+	double batch_interval;
+	bool in_transaction;
+	bro_uint_t transaction_rows;	// Written in the current transaction.
+	double transaction_start;	// Wall clock when it began.
 
 	std::string set_separator;
 	std::string unset_field;
@@ -0,0 +1,164 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Prints the records of a loop trace dump, see LoopTrace.h, with times in
+// milliseconds relative to the dump.
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "LoopTrace.h"
+
+using namespace zeek::detail;
+
+static const char* type_names[] = {
+	"iteration",
+	"source",
+	"timers",
+	"drain",
+	"broker",
+	"dict-resize",
+	"table-expire",
+	"stall",
+};
+
+static_assert(sizeof(type_names) / sizeof(type_names[0]) ==
+              static_cast<size_t>(LoopTraceType::NUM_RECORD_TYPES));
+
+static bool read_name(FILE* f, std::string* name)
+	{
+	int c;
+
+	while ( (c = getc(f)) != EOF )
+		{
+		if ( c == '\0' )
+			return true;
+
+		name->push_back(c);
+		}
+
+	return false;
+	}
+
+static int decode(const char* fn)
+	{
+	FILE* f = fopen(fn, "rb");
+
+	if ( ! f )
+		{
+		fprintf(stderr, "zeek-loop-trace: cannot open %s: %s\n", fn, strerror(errno));
+		return 1;
+		}
+
+	LoopTraceHeader hdr;
+
+	if ( fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, "ZLTR", 4) != 0 )
+		{
+		fprintf(stderr, "zeek-loop-trace: %s is not a loop trace\n", fn);
+		fclose(f);
+		return 1;
+		}
+
+	if ( hdr.version != LOOP_TRACE_VERSION )
+		{
+		fprintf(stderr, "zeek-loop-trace: %s has unsupported version %" PRIu32 "\n",
+		        fn, hdr.version);
+		fclose(f);
+		return 1;
+		}
+
+	std::vector<std::string> sources(hdr.num_sources);
+
+	for ( auto& s : sources )
+		if ( ! read_name(f, &s) )
+			{
+			fprintf(stderr, "zeek-loop-trace: %s is truncated\n", fn);
+			fclose(f);
+			return 1;
+			}
+
+	auto ms = [&hdr](int64_t ticks) { return ticks * 1000.0 / hdr.ticks_per_second; };
+
+	printf("# %s: %" PRIu64 " records, dumped at %.6f\n", fn, hdr.num_records, hdr.dump_time);
+	printf("# %12s  %-12s  %s\n", "ms", "type", "details");
+
+	LoopTraceRecord r;
+
+	for ( uint64_t i = 0; i < hdr.num_records; ++i )
+		{
+		if ( fread(&r, sizeof(r), 1, f) != 1 )
+			{
+			fprintf(stderr, "zeek-loop-trace: %s is truncated\n", fn);
+			fclose(f);
+			return 1;
+			}
+
+		double when = ms(static_cast<int64_t>(r.ticks - hdr.dump_ticks));
+		auto type = static_cast<LoopTraceType>(r.type);
+		const char* name = r.type < static_cast<uint32_t>(LoopTraceType::NUM_RECORD_TYPES) ?
+			type_names[r.type] : "unknown";
+
+		printf("  %12.3f  %-12s  ", when, name);
+
+		switch ( type ) {
+		case LoopTraceType::ITERATION:
+			printf("ready=%" PRIu32 " took=%.3fms\n", r.a, ms(r.b));
+			break;
+
+		case LoopTraceType::SOURCE:
+			printf("source=%s took=%.3fms\n",
+			       r.a < sources.size() ? sources[r.a].c_str() : "<unknown>", ms(r.b));
+			break;
+
+		case LoopTraceType::TIMERS:
+			printf("timers=%" PRIu32 " took=%.3fms\n", r.a, ms(r.b));
+			break;
+
+		case LoopTraceType::DRAIN:
+			printf("events=%" PRIu32 " took=%.3fms\n", r.a, ms(r.b));
+			break;
+
+		case LoopTraceType::BROKER:
+			printf("messages=%" PRIu32 " backlog=%" PRIu64 "\n", r.a, r.b);
+			break;
+
+		case LoopTraceType::DICT_RESIZE:
+			printf("buckets=%" PRIu32 " entries=%" PRIu64 "\n", r.a, r.b);
+			break;
+
+		case LoopTraceType::TABLE_EXPIRE:
+			printf("expired=%" PRIu32 "\n", r.a);
+			break;
+
+		case LoopTraceType::STALL:
+			printf("took=%.3fms\n", ms(r.b));
+			break;
+
+		default:
+			printf("a=%" PRIu32 " b=%" PRIu64 "\n", r.a, r.b);
+			break;
+		}
+		}
+
+	fclose(f);
+	return 0;
+	}
+
+int main(int argc, char** argv)
+	{
+	if ( argc < 2 )
+		{
+		fprintf(stderr, "usage: zeek-loop-trace <dump>...\n");
+		return 1;
+		}
+
+	int rc = 0;
+
+	for ( int i = 1; i < argc; ++i )
+		rc |= decode(argv[i]);
+
+	return rc;
+	}
@@ -6,6 +6,7 @@
 #include "iosource/Manager.h"
 #include "supervisor/Supervisor.h"
 #include "RunState.h"
+#include "Stats.h"
 
 int main(int argc, char** argv)
 	{
@@ -56,8 +57,18 @@ int main(int argc, char** argv)
 			        mem_net_start_malloced / 1024 / 1024);
 			}
 
+		if ( options.bench_loops )
+			zeek::detail::stage_profiler = new zeek::detail::StageProfiler();
+
 		zeek::run_state::detail::run_loop();
 
+		if ( zeek::detail::stage_profiler )
+			{
+			zeek::detail::stage_profiler->Report(stderr);
+			delete zeek::detail::stage_profiler;
+			zeek::detail::stage_profiler = nullptr;
+			}
+
 		double time_net_done = zeek::util::current_time(true);
 
 		uint64_t mem_net_done_total;
@@ -722,7 +722,9 @@ nb_dns_activity(struct nb_dns_info *nd, struct nb_dns_result *nr, char *errstr)
 
 		rdata = ns_rr_rdata(rr);
 		rdlen = ns_rr_rdlen(rr);
-		rttl = ns_rr_ttl(rr);
+		/* The answer is good for as long as all its records are */
+		if (nd->dns_hostent.numaddrs == 0 || ns_rr_ttl(rr) < rttl)
+			rttl = ns_rr_ttl(rr);
 		switch (atype) {
 
 		case T_A:
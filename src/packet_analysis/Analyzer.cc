@@ -64,7 +64,7 @@ bool Analyzer::IsAnalyzer(const char* name)
 	return packet_mgr->GetComponentName(tag) == name;
 	}
 
-AnalyzerPtr Analyzer::Lookup(uint32_t identifier) const
+const AnalyzerPtr& Analyzer::Lookup(uint32_t identifier) const
 	{
 	return dispatcher.Lookup(identifier);
 	}
@@ -72,9 +72,10 @@ AnalyzerPtr Analyzer::Lookup(uint32_t identifier) const
 bool Analyzer::ForwardPacket(size_t len, const uint8_t* data, Packet* packet,
 		uint32_t identifier) const
 	{
-	auto inner_analyzer = Lookup(identifier);
+	// Avoid copying the shared pointers, this runs for every layer.
+	Analyzer* inner_analyzer = Lookup(identifier).get();
 	if ( ! inner_analyzer )
-		inner_analyzer = default_analyzer;
+		inner_analyzer = default_analyzer.get();
 
 	if ( inner_analyzer == nullptr )
 		{
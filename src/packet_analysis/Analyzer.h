@@ -96,6 +96,7 @@ public:
 
 protected:
 	friend class Manager;
+	friend class FastChain;
 
 	/**
 	 * Looks up the analyzer for the encapsulated protocol based on the given
@@ -105,7 +106,7 @@ protected:
 	 * @return The analyzer registered for the given identifier. Returns a
 	 * nullptr if no analyzer is registered.
 	 */
-	AnalyzerPtr Lookup(uint32_t identifier) const;
+	const AnalyzerPtr& Lookup(uint32_t identifier) const;
 
 	/**
 	 * Returns an analyzer based on a script-land definition.
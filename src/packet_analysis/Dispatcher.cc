@@ -55,13 +55,15 @@ void Dispatcher::Register(uint32_t identifier, AnalyzerPtr analyzer)
 	table[index] = std::move(analyzer);
 	}
 
-AnalyzerPtr Dispatcher::Lookup(uint32_t identifier) const
+const AnalyzerPtr& Dispatcher::Lookup(uint32_t identifier) const
 	{
+	static const AnalyzerPtr none;
+
 	int64_t index = identifier - lowest_identifier;
-	if ( index >= 0 && index < static_cast<int64_t>(table.size()) && table[index] != nullptr )
+	if ( index >= 0 && index < static_cast<int64_t>(table.size()) )
 		return table[index];
 
-	return nullptr;
+	return none;
 	}
 
 size_t Dispatcher::Count() const
@@ -35,7 +35,7 @@ public:
 	 * @return The analyzer registered for the given identifier. Returns a
 	 * nullptr if no analyzer is registered.
 	 */
-	AnalyzerPtr Lookup(uint32_t identifier) const;
+	const AnalyzerPtr& Lookup(uint32_t identifier) const;
 
 	/**
 	 * Returns the number of registered analyzers.
@@ -0,0 +1,122 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/packet_analysis/FastChain.h"
+
+#include <typeinfo>
+
+#include "zeek/DebugLogger.h"
+#include "zeek/packet_analysis/protocol/ethernet/Ethernet.h"
+#include "zeek/packet_analysis/protocol/vlan/VLAN.h"
+#include "zeek/packet_analysis/protocol/ip/IP.h"
+
+#include "pcap.h" // For DLT_ constants
+
+namespace zeek::packet_analysis {
+
+// Whether an analyzer is exactly the given built-in one, as a subclass
+// could change what it does.
+template <typename T>
+static T* builtin(const AnalyzerPtr& a)
+	{
+	return a && typeid(*a) == typeid(T) ? static_cast<T*>(a.get()) : nullptr;
+	}
+
+FastChain::Layer FastChain::IPLayer(const Analyzer* a)
+	{
+	Layer l;
+	l.ipv4 = builtin<IP::IPAnalyzer>(a->Lookup(0x0800));
+	l.ipv6 = builtin<IP::IPAnalyzer>(a->Lookup(0x86DD));
+	return l;
+	}
+
+void FastChain::Build(const AnalyzerPtr& root)
+	{
+	ethernet = vlan = Layer();
+
+#ifdef DEBUG
+	// Keep the per-layer debug output of the regular chain.
+	if ( zeek::detail::debug_logger.IsEnabled(DBG_PACKET_ANALYSIS) )
+		return;
+#endif
+
+	auto eth = builtin<Ethernet::EthernetAnalyzer>(root->Lookup(DLT_EN10MB));
+
+	if ( ! eth )
+		return;
+
+	ethernet = IPLayer(eth);
+
+	if ( auto v = builtin<VLAN::VLANAnalyzer>(eth->Lookup(0x8100)) )
+		vlan = IPLayer(v);
+
+	DBG_LOG(DBG_PACKET_ANALYSIS, "Fast chain: Ethernet->IP %s, Ethernet->VLAN->IP %s",
+	        IsActive() ? "on" : "off", vlan.ipv4 || vlan.ipv6 ? "on" : "off");
+	}
+
+bool FastChain::Decode(const Packet* packet, Frame* f) const
+	{
+	if ( packet->link_type != DLT_EN10MB )
+		return false;
+
+	const uint8_t* data = packet->data;
+	size_t len = packet->cap_len;
+
+	// The Ethernet analyzer's minimum, so that it reports any truncation.
+	if ( len <= 16 )
+		return false;
+
+	f->eth_type = (data[12] << 8) + data[13];
+	f->ip = ethernet.ForType(f->eth_type);
+	f->hdr_len = 14;
+	f->vlan_id = 0;
+
+	if ( f->ip )
+		return true;
+
+	if ( f->eth_type != 0x8100 || len <= 14 + 4 )
+		return false;
+
+	f->vlan_id = ((data[14] << 8u) + data[15]) & 0xfff;
+	f->eth_type = (data[16] << 8) + data[17];
+	f->ip = vlan.ForType(f->eth_type);
+	f->hdr_len += 4;
+
+	return f->ip != nullptr;
+	}
+
+bool FastChain::Process(Packet* packet, bool* result) const
+	{
+	Frame f;
+
+	if ( ! Decode(packet, &f) )
+		return false;
+
+	// From here on, this does what the analyzers in between would have.
+	const uint8_t* data = packet->data;
+	packet->l2_dst = data;
+	packet->l2_src = data + 6;
+	packet->eth_type = f.eth_type;
+
+	if ( f.hdr_len > 14 )
+		{
+		auto& vlan_ref = packet->vlan != 0 ? packet->inner_vlan : packet->vlan;
+		vlan_ref = f.vlan_id;
+		}
+
+	*result = f.ip->IP::IPAnalyzer::AnalyzePacket(packet->cap_len - f.hdr_len,
+	                                              data + f.hdr_len, packet);
+	return true;
+	}
+
+const uint8_t* FastChain::IPHeader(const Packet* packet, size_t* len) const
+	{
+	Frame f;
+
+	if ( ! Decode(packet, &f) )
+		return nullptr;
+
+	*len = packet->cap_len - f.hdr_len;
+	return packet->data + f.hdr_len;
+	}
+
+} // namespace zeek::packet_analysis
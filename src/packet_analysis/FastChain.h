@@ -0,0 +1,90 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Dispatcher.h"
+
+namespace zeek { class Packet; }
+namespace zeek::packet_analysis::IP { class IPAnalyzer; }
+
+namespace zeek::packet_analysis {
+
+/**
+ * Decodes the most common link-layer framings, Ethernet and Ethernet with
+ * a single 802.1Q tag in front of IPv4 or IPv6, without going through the
+ * dispatchers and virtual calls of the analyzers in between. The chain
+ * only handles a packet if the configured analyzers are the built-in ones
+ * that it replicates; anything else, including all the corner cases those
+ * handle, goes through the regular analyzer chain.
+ */
+class FastChain {
+public:
+	/**
+	 * Looks at the analyzer configuration below the root analyzer to
+	 * determine which paths can take the fast chain. Must only be called
+	 * once packet protocol registrations are final.
+	 */
+	void Build(const AnalyzerPtr& root);
+
+	/**
+	 * Returns true if any path can take the fast chain.
+	 */
+	bool IsActive() const	{ return ethernet.ipv4 || ethernet.ipv6; }
+
+	/**
+	 * Processes a packet if it takes one of the fast paths.
+	 *
+	 * @param packet The packet to process.
+	 * @param result Set to the outcome of the analysis if the packet was
+	 * processed.
+	 *
+	 * @return false if the packet needs to go through the regular analyzer
+	 * chain, without anything about it having been changed.
+	 */
+	bool Process(Packet* packet, bool* result) const;
+
+	/**
+	 * Locates the IP header of a packet that takes one of the fast
+	 * paths, without processing it.
+	 *
+	 * @param packet The packet to look at.
+	 * @param len Set to the number of bytes from the IP header on.
+	 *
+	 * @return The start of the IP header, or nullptr if the packet
+	 * doesn't take a fast path.
+	 */
+	const uint8_t* IPHeader(const Packet* packet, size_t* len) const;
+
+private:
+	// The link-layer headers of a packet taking a fast path.
+	struct Frame {
+		IP::IPAnalyzer* ip;
+		size_t hdr_len;	// Of the link-layer headers.
+		uint32_t eth_type;
+		uint32_t vlan_id;	// Zero if untagged.
+	};
+
+	bool Decode(const Packet* packet, Frame* f) const;
+
+	// The IP analyzers a layer forwards IPv4 and IPv6 to, if they are
+	// the built-in one.
+	struct Layer {
+		IP::IPAnalyzer* ipv4 = nullptr;
+		IP::IPAnalyzer* ipv6 = nullptr;
+
+		IP::IPAnalyzer* ForType(uint32_t eth_type) const
+			{
+			return eth_type == 0x0800 ? ipv4 : eth_type == 0x86DD ? ipv6 : nullptr;
+			}
+	};
+
+	static Layer IPLayer(const Analyzer* a);
+
+	Layer ethernet;	// Ethernet -> IP
+	Layer vlan;	// Ethernet -> 802.1Q -> IP
+};
+
+} // namespace zeek::packet_analysis
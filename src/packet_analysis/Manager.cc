@@ -53,6 +53,11 @@ void Manager::InitPostScript()
 		}
 	}
 
+void Manager::InitPostZeekInit()
+	{
+	fast_chain.Build(root_analyzer);
+	}
+
 void Manager::Done()
 	{
 	}
@@ -108,9 +113,18 @@ void Manager::ProcessPacket(Packet* packet)
 		dumped_packet = true;
 		}
 
+	// Tags the NIC stripped came before any still in the data.
+	if ( packet->meta.stripped_vlan )
+		{
+		packet->vlan = packet->meta.stripped_vlan;
+		packet->inner_vlan = packet->meta.stripped_inner_vlan;
+		}
+
 	// Start packet analysis
-	root_analyzer->ForwardPacket(packet->cap_len, packet->data,
-	                             packet, packet->link_type);
+	bool result;
+	if ( ! fast_chain.Process(packet, &result) )
+		root_analyzer->ForwardPacket(packet->cap_len, packet->data,
+		                             packet, packet->link_type);
 
 	if ( raw_packet )
 		event_mgr.Enqueue(raw_packet, packet->ToRawPktHdrVal());
@@ -122,9 +136,21 @@ void Manager::ProcessPacket(Packet* packet)
 
 bool Manager::ProcessInnerPacket(Packet* packet)
 	{
+	bool result;
+	if ( fast_chain.Process(packet, &result) )
+		return result;
+
 	return root_analyzer->ForwardPacket(packet->cap_len, packet->data, packet, packet->link_type);
 	}
 
+void Manager::PrefetchPacket(const Packet* packet) const
+	{
+	size_t len;
+
+	if ( auto ip = fast_chain.IPHeader(packet, &len) )
+		sessions->PrefetchConnection(ip, len);
+	}
+
 AnalyzerPtr Manager::InstantiateAnalyzer(const Tag& tag)
 	{
 	Component* c = Lookup(tag);
@@ -7,6 +7,7 @@
 #include "plugin/ComponentManager.h"
 #include "iosource/Packet.h"
 #include "Dispatcher.h"
+#include "FastChain.h"
 
 ZEEK_FORWARD_DECLARE_NAMESPACED(PacketProfiler, zeek::detail);
 
@@ -34,6 +35,13 @@ public:
 	 */
 	void InitPostScript();
 
+	/**
+	 * Third-stage initialization of the manager, called once \c zeek_init
+	 * has finished and packet protocol registrations can no longer change.
+	 * Sets up the fast chain for the common link-layer paths.
+	 */
+	void InitPostZeekInit();
+
 	/**
 	 * Finished the manager's operations.
 	 */
@@ -81,6 +89,15 @@ public:
 	 */
 	bool ProcessInnerPacket(Packet* packet);
 
+	/**
+	 * Prefetches the session state a packet is going to need, to hide the
+	 * cache misses of looking it up by the time the packet gets processed.
+	 * Only covers packets that take the fast chain.
+	 *
+	 * @param packet The packet that's going to get processed.
+	 */
+	void PrefetchPacket(const Packet* packet) const;
+
 	uint64_t PacketsProcessed() const	{ return num_packets_processed; }
 
 	/**
@@ -136,6 +153,7 @@ private:
 
 	std::map<std::string, AnalyzerPtr> analyzers;
 	AnalyzerPtr root_analyzer = nullptr;
+	FastChain fast_chain;
 
 	uint64_t num_packets_processed = 0;
 	detail::PacketProfiler* pkt_profiler = nullptr;
@@ -16,12 +16,9 @@ using namespace zeek::packet_analysis::IP;
 IPAnalyzer::IPAnalyzer()
 	: zeek::packet_analysis::Analyzer("IP")
 	{
+	// Scripts may add discard rules at any time, so the discarder stays
+	// around even when there's nothing to check yet.
 	discarder = new detail::Discarder();
-	if ( ! discarder->IsActive() )
-		{
-		delete discarder;
-		discarder = nullptr;
-		}
 	}
 
 IPAnalyzer::~IPAnalyzer()
@@ -125,7 +122,7 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 	if ( packet_filter && packet_filter->Match(packet->ip_hdr, total_len, len) )
 		 return false;
 
-	if ( ! packet->l2_checksummed && ! detail::ignore_checksums && ip4 &&
+	if ( ! packet->l3_checksummed && ! detail::ignore_checksums && ip4 &&
 	     ! zeek::id::find_val<TableVal>("ignore_checksums_nets")->Contains(packet->ip_hdr->IPHeaderSrcAddr()) &&
 	     detail::in_cksum(reinterpret_cast<const uint8_t*>(ip4), ip_hdr_len) != 0xffff )
 		{
@@ -133,7 +130,7 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 		return false;
 		}
 
-	if ( discarder && discarder->NextPacket(packet->ip_hdr, total_len, len) )
+	if ( discarder->IsActive() && discarder->NextPacket(packet->ip_hdr, total_len, len) )
 		return false;
 
 	detail::FragReassembler* f = nullptr;
@@ -156,6 +153,11 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 			{
 			f = detail::fragment_mgr->NextFragment(run_state::processing_start_time, packet->ip_hdr,
 			                                       packet->data + hdr_size);
+
+			if ( ! f )
+				// Dropped, its source has too many in flight.
+				return false;
+
 			std::unique_ptr<IP_Hdr> ih = f->ReassembledPkt();
 
 			if ( ! ih )
@@ -168,6 +170,9 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 			// fragmented packet.
 			packet->ip_hdr = std::move(ih);
 
+			// The NIC only hashed this one fragment.
+			packet->meta.have_flow_hash = false;
+
 			len = total_len = packet->ip_hdr->TotalLen();
 			ip_hdr_len = packet->ip_hdr->HdrLen();
 			packet->cap_len = total_len + hdr_size;
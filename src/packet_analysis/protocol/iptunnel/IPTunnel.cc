@@ -73,24 +73,25 @@ bool IPTunnelAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* pa
 	else
 		tunnel_idx = IPPair(packet->ip_hdr->DstAddr(), packet->ip_hdr->SrcAddr());
 
-	IPTunnelMap::iterator tunnel_it = ip_tunnels.find(tunnel_idx);
+	auto [tunnel_it, is_new] = ip_tunnels.try_emplace(tunnel_idx);
+	TunnelActivity& tunnel = tunnel_it->second;
 
-	if ( tunnel_it == ip_tunnels.end() )
+	if ( is_new )
 		{
-		EncapsulatingConn ec(packet->ip_hdr->SrcAddr(), packet->ip_hdr->DstAddr(),
-		                     tunnel_type);
-		ip_tunnels[tunnel_idx] = TunnelActivity(ec, run_state::network_time);
+		tunnel.ec = EncapsulatingConn(packet->ip_hdr->SrcAddr(), packet->ip_hdr->DstAddr(),
+		                              tunnel_type);
 		zeek::detail::timer_mgr->Add(new detail::IPTunnelTimer(run_state::network_time, tunnel_idx, this));
 		}
-	else
-		tunnel_it->second.second = zeek::run_state::network_time;
+
+	tunnel.last_active = run_state::network_time;
+
+	const auto& encap = tunnel.encap.Get(packet->encap, tunnel.ec);
 
 	if ( gre_version == 0 )
 		ProcessEncapsulatedPacket(run_state::processing_start_time, packet, len, len, data, gre_link_type,
-		                          packet->encap, ip_tunnels[tunnel_idx].first);
+		                          encap);
 	else
-		ProcessEncapsulatedPacket(run_state::processing_start_time, packet, inner, packet->encap,
-		                          ip_tunnels[tunnel_idx].first);
+		ProcessEncapsulatedPacket(run_state::processing_start_time, packet, inner, encap);
 
 	return true;
 	}
@@ -100,8 +101,7 @@ bool IPTunnelAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* pa
  */
 bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
                                                  const IP_Hdr* inner,
-                                                 std::shared_ptr<EncapsulationStack> prev,
-                                                 const EncapsulatingConn& ec)
+                                                 const std::shared_ptr<EncapsulationStack>& encap)
 	{
 	uint32_t caplen, len;
 	caplen = len = inner->TotalLen();
@@ -125,14 +125,11 @@ bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
 	else
 		data = (const u_char*) inner->IP6_Hdr();
 
-	auto outer = prev ? prev : std::make_shared<EncapsulationStack>();
-	outer->Add(ec);
-
 	// Construct fake packet containing the inner packet so it can be processed
 	// like a normal one.
 	Packet p;
 	p.Init(DLT_RAW, &ts, caplen, len, data, false, "");
-	p.encap = outer;
+	p.encap = encap;
 
 	// Forward the packet back to the IP analyzer.
 	bool return_val = ForwardPacket(len, data, &p);
@@ -148,8 +145,7 @@ bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
 bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
                                                  uint32_t caplen, uint32_t len,
                                                  const u_char* data, int link_type,
-                                                 std::shared_ptr<EncapsulationStack> prev,
-                                                 const EncapsulatingConn& ec)
+                                                 const std::shared_ptr<EncapsulationStack>& encap)
 	{
 	pkt_timeval ts;
 
@@ -162,14 +158,11 @@ bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
 		    ((run_state::network_time - (double)ts.tv_sec) * 1000000);
 		}
 
-	auto outer = prev ? prev : std::make_shared<EncapsulationStack>();
-	outer->Add(ec);
-
 	// Construct fake packet containing the inner packet so it can be processed
 	// like a normal one.
 	Packet p;
 	p.Init(link_type, &ts, caplen, len, data, false, "");
-	p.encap = outer;
+	p.encap = encap;
 
 	// Process the packet as if it was a brand new packet by passing it back
 	// to the packet manager.
@@ -178,6 +171,30 @@ bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
 	return return_val;
 	}
 
+static std::shared_ptr<EncapsulationStack> build_encap(const std::shared_ptr<EncapsulationStack>& prev,
+                                                       const EncapsulatingConn& ec)
+	{
+	EncapsulationCache cache;
+	return cache.Get(prev, ec);
+	}
+
+bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
+                                                 const IP_Hdr* inner,
+                                                 std::shared_ptr<EncapsulationStack> prev,
+                                                 const EncapsulatingConn& ec)
+	{
+	return ProcessEncapsulatedPacket(t, pkt, inner, build_encap(prev, ec));
+	}
+
+bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
+                                                 uint32_t caplen, uint32_t len,
+                                                 const u_char* data, int link_type,
+                                                 std::shared_ptr<EncapsulationStack> prev,
+                                                 const EncapsulatingConn& ec)
+	{
+	return ProcessEncapsulatedPacket(t, pkt, caplen, len, data, link_type, build_encap(prev, ec));
+	}
+
 namespace detail {
 
 IPTunnelTimer::IPTunnelTimer(double t, IPTunnelAnalyzer::IPPair p, IPTunnelAnalyzer* analyzer)
@@ -195,7 +212,7 @@ void IPTunnelTimer::Dispatch(double t, bool is_expire)
 	if ( it == analyzer->ip_tunnels.end() )
 		return;
 
-	double last_active = it->second.second;
+	double last_active = it->second.last_active;
 	double inactive_time = t > last_active ? t - last_active : 0;
 
 	if ( inactive_time >= BifConst::Tunnel::ip_tunnel_timeout )
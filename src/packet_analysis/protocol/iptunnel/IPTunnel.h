@@ -35,6 +35,18 @@ public:
 	 *        are always set to the TotalLength() of \a inner.
 	 * @param inner Pointer to IP header wrapper of the inner packet, ownership
 	 *        of the pointer's memory is assumed by this function.
+	 * @param encap The encapsulation stack of the inner packet, including
+	 *        the most-recently found depth of encapsulation. See
+	 *        EncapsulationCache for keeping one per tunnel.
+	 */
+	bool ProcessEncapsulatedPacket(double t, const Packet *pkt,
+	                               const IP_Hdr* inner,
+	                               const std::shared_ptr<EncapsulationStack>& encap);
+
+	/**
+	 * Like the above, but builds a new encapsulation stack for the inner
+	 * packet.
+	 *
 	 * @param prev Any previous encapsulation stack of the caller, not including
 	 *        the most-recently found depth of encapsulation.
 	 * @param ec The most-recently found depth of encapsulation.
@@ -56,6 +68,18 @@ public:
 	 * @param len Number of bytes remaining as claimed by outer framing
 	 * @param data The remaining packet data
 	 * @param link_type Layer 2 link type used for initializing inner packet
+	 * @param encap The encapsulation stack of the inner packet, including
+	 *        the most-recently found depth of encapsulation.
+	 */
+	bool ProcessEncapsulatedPacket(double t, const Packet* pkt,
+	                               uint32_t caplen, uint32_t len,
+	                               const u_char* data, int link_type,
+	                               const std::shared_ptr<EncapsulationStack>& encap);
+
+	/**
+	 * Like the above, but builds a new encapsulation stack for the inner
+	 * packet.
+	 *
 	 * @param prev Any previous encapsulation stack of the caller, not
 	 *        including the most-recently found depth of encapsulation.
 	 * @param ec The most-recently found depth of encapsulation.
@@ -71,7 +95,13 @@ protected:
 	friend class detail::IPTunnelTimer;
 
 	using IPPair = std::pair<IPAddr, IPAddr>;
-	using TunnelActivity = std::pair<EncapsulatingConn, double>;
+
+	struct TunnelActivity {
+		EncapsulatingConn ec;
+		double last_active = 0.0;
+		EncapsulationCache encap;	// Of the tunnel's inner packets.
+	};
+
 	using IPTunnelMap = std::map<IPPair, TunnelActivity>;
 	IPTunnelMap ip_tunnels;
 
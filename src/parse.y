@@ -25,7 +25,8 @@
 %token TOK_ATTR_DEL_FUNC TOK_ATTR_EXPIRE_FUNC
 %token TOK_ATTR_EXPIRE_CREATE TOK_ATTR_EXPIRE_READ TOK_ATTR_EXPIRE_WRITE
 %token TOK_ATTR_RAW_OUTPUT TOK_ATTR_ON_CHANGE TOK_ATTR_BROKER_STORE
-%token TOK_ATTR_BROKER_STORE_ALLOW_COMPLEX TOK_ATTR_BACKEND
+%token TOK_ATTR_BROKER_STORE_ALLOW_COMPLEX TOK_ATTR_BACKEND TOK_ATTR_ORDERED_INDEX
+%token TOK_ATTR_PERSISTENT TOK_ATTR_COMPACT
 %token TOK_ATTR_PRIORITY TOK_ATTR_LOG TOK_ATTR_ERROR_HANDLER
 %token TOK_ATTR_TYPE_COLUMN TOK_ATTR_DEPRECATED
 
@@ -1411,6 +1412,12 @@ attr:
 			{ $$ = new zeek::detail::Attr(zeek::detail::ATTR_BROKER_STORE_ALLOW_COMPLEX); }
 	|	TOK_ATTR_BACKEND '=' expr
 			{ $$ = new zeek::detail::Attr(zeek::detail::ATTR_BACKEND, {zeek::AdoptRef{}, $3}); }
+	|	TOK_ATTR_ORDERED_INDEX
+			{ $$ = new zeek::detail::Attr(zeek::detail::ATTR_ORDERED_INDEX); }
+	|	TOK_ATTR_PERSISTENT
+			{ $$ = new zeek::detail::Attr(zeek::detail::ATTR_PERSISTENT); }
+	|	TOK_ATTR_COMPACT
+			{ $$ = new zeek::detail::Attr(zeek::detail::ATTR_COMPACT); }
 	|	TOK_ATTR_EXPIRE_FUNC '=' expr
 			{ $$ = new zeek::detail::Attr(zeek::detail::ATTR_EXPIRE_FUNC, {zeek::AdoptRef{}, $3}); }
 	|	TOK_ATTR_EXPIRE_CREATE '=' expr
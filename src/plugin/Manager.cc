@@ -327,6 +327,31 @@ bool Manager::ActivateDynamicPlugins(bool all)
 	return true;
 	}
 
+std::vector<std::string> Manager::DynamicPluginLibraries() const
+	{
+	std::vector<std::string> libs;
+
+	for ( const auto& [name, dir] : dynamic_plugins )
+		{
+		if ( dir.empty() )
+			// Already activated.
+			continue;
+
+		string dypattern = dir + "/lib/*." + HOST_ARCHITECTURE + DYNAMIC_PLUGIN_SUFFIX;
+		glob_t gl;
+
+		if ( glob(dypattern.c_str(), 0, 0, &gl) == 0 )
+			{
+			for ( size_t i = 0; i < gl.gl_pathc; i++ )
+				libs.emplace_back(gl.gl_pathv[i]);
+
+			globfree(&gl);
+			}
+		}
+
+	return libs;
+	}
+
 void Manager::UpdateInputFiles()
 	{
 	for ( file_list::const_reverse_iterator i = scripts_to_load.rbegin();
@@ -547,6 +572,7 @@ void Manager::EnableHook(HookType hook, Plugin* plugin, int prio)
 
 	l->push_back(std::make_pair(prio, plugin));
 	l->sort(hook_cmp);
+	detail::enabled_hooks |= (1u << hook);
 	}
 
 void Manager::DisableHook(HookType hook, Plugin* plugin)
@@ -569,6 +595,7 @@ void Manager::DisableHook(HookType hook, Plugin* plugin)
 		{
 		delete l;
 		hooks[hook] = nullptr;
+		detail::enabled_hooks &= ~(1u << hook);
 		}
 	}
 
@@ -584,6 +611,13 @@ void Manager::RequestBroObjDtor(Obj* obj, Plugin* plugin)
 	obj->NotifyPluginsOnDtor();
 	}
 
+void Manager::RequestBroObjDtor(TypeTag tag, Plugin* plugin)
+	{
+	DBG_LOG(DBG_PLUGINS, "Plugin %s requested destruction of %s values",
+	        plugin->Name().c_str(), type_name(tag));
+	detail::val_dtor_types |= (1u << tag);
+	}
+
 int Manager::HookLoadFile(const Plugin::LoadType type, const string& file, const string& resolved)
 	{
 	HookArgumentList args;
@@ -5,6 +5,7 @@
 #include <utility>
 #include <map>
 #include <string_view>
+#include <vector>
 
 #include "Plugin.h"
 #include "Component.h"
@@ -15,6 +16,31 @@
 namespace zeek {
 namespace plugin {
 
+namespace detail {
+
+// One bit per HookType, set while at least one plugin has the hook enabled.
+// This lives outside of the Manager so that checking for a hook is a single
+// test of a global that the compiler inlines at each hook site.
+inline uint32_t enabled_hooks = 0;
+
+// One bit per TypeTag for which a plugin has requested HookBroObjDtor() for
+// all values of that type.
+inline uint32_t val_dtor_types = 0;
+
+static_assert(NUM_HOOKS <= 32, "enabled_hooks needs more bits");
+static_assert(NUM_TYPES <= 32, "val_dtor_types needs more bits");
+
+} // namespace detail
+
+/**
+ * Returns true if there's at least one plugin interested in a given hook.
+ * Same as Manager::HavePluginForHook(), but usable without the manager.
+ */
+inline bool hook_enabled(HookType hook)
+	{
+	return detail::enabled_hooks & (1u << hook);
+	}
+
 // Macros that trigger plugin hooks. We put this into macros to short-cut the
 // code for the most common case that no plugin defines the hook.
 
@@ -26,7 +52,7 @@ namespace plugin {
  * @param method_call The \a Manager method corresponding to the hook.
  */
 #define PLUGIN_HOOK_VOID(hook, method_call) \
-	{ if ( zeek::plugin_mgr->HavePluginForHook(zeek::plugin::hook) ) zeek::plugin_mgr->method_call; }
+	{ if ( zeek::plugin::hook_enabled(zeek::plugin::hook) ) zeek::plugin_mgr->method_call; }
 
 /**
  * Macro to trigger hooks that return a result.
@@ -39,7 +65,7 @@ namespace plugin {
  * the hook.
  */
 #define PLUGIN_HOOK_WITH_RESULT(hook, method_call, default_result) \
-	(zeek::plugin_mgr->HavePluginForHook(zeek::plugin::hook) ? zeek::plugin_mgr->method_call : (default_result))
+	(zeek::plugin::hook_enabled(zeek::plugin::hook) ? zeek::plugin_mgr->method_call : (default_result))
 
 /**
  * A singleton object managing all plugins.
@@ -103,6 +129,12 @@ public:
 	 */
 	bool ActivateDynamicPlugins(bool all);
 
+	/**
+	 * Returns the paths of the shared libraries of all plugins that
+	 * SearchDynamicPlugins() has discovered and that aren't activated yet.
+	 */
+	std::vector<std::string> DynamicPluginLibraries() const;
+
 	/**
 	 * First-stage initializion of the manager. This is called early on
 	 * during Bro's initialization, before any scripts are processed, and
@@ -168,8 +200,7 @@ public:
 	 */
 	bool HavePluginForHook(HookType hook) const
 		{
-		// Inline to avoid the function call.
-		return hooks[hook] != nullptr;
+		return hook_enabled(hook);
 		}
 
 	/**
@@ -225,6 +256,18 @@ public:
 	 */
 	void RequestBroObjDtor(Obj* obj, Plugin* plugin);
 
+	/**
+	 * Register interest in the destruction of all values of a given type.
+	 * Each value of that type then triggers HookBroObjDtor() when its
+	 * destructor runs. Values of other types do not, regardless of how
+	 * many plugins enable the hook.
+	 *
+	 * @param tag The type of values being interested in.
+	 *
+	 * @param plugin The plugin expressing interest.
+	 */
+	void RequestBroObjDtor(TypeTag tag, Plugin* plugin);
+
 	// Hook entry functions.
 
 	/**
@@ -370,6 +370,11 @@ void Plugin::RequestBroObjDtor(Obj* obj)
 	plugin_mgr->RequestBroObjDtor(obj, this);
 	}
 
+void Plugin::RequestBroObjDtor(TypeTag tag)
+	{
+	plugin_mgr->RequestBroObjDtor(tag, this);
+	}
+
 int Plugin::HookLoadFile(const LoadType type, const std::string& file, const std::string& resolved)
 	{
 	return -1;
@@ -8,6 +8,7 @@
 
 #include "zeek-config.h"
 #include "logging/WriterBackend.h"
+#include "Type.h"
 #include "ZeekArgs.h"
 
 // Increase this when making incompatible changes to the plugin API. Note
@@ -628,6 +629,17 @@ protected:
 	 */
 	void RequestBroObjDtor(Obj* obj);
 
+	/**
+	 * Registers interest in the destruction of all values of a given
+	 * type. When the destructor of such a value runs, \a HookBroObjDtor
+	 * will be called. This is cheaper than enabling the hook for
+	 * individual objects when a plugin cares about a type as a whole:
+	 * destructors of values of other types skip the hook altogether.
+	 *
+	 * @param tag The type of values being interested in.
+	 */
+	void RequestBroObjDtor(TypeTag tag);
+
 	// Hook functions.
 
 	/**
@@ -792,7 +804,8 @@ protected:
 	 * @param fields threading::Field description of the fields being logged.
 	 *
 	 * @param vals threading::Values containing the values being written. Values
-	 *             can be modified in the Hook.
+	 *             can be modified in the Hook, but not deleted or replaced:
+	 *             they live in the memory of the writer's current batch.
 	 *
 	 * @return true if log line should be written, false if log line should be
 	 *         skipped and not passed on to the writer.
@@ -2,14 +2,18 @@
 
 #include "BloomFilter.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 
 #include <broker/data.hh>
 #include <broker/error.hh>
+#include <openssl/sha.h>
 
 #include "CounterVector.h"
 
+#include "../digest.h"
 #include "../util.h"
 #include "../Reporter.h"
 
@@ -70,6 +74,13 @@ std::unique_ptr<BloomFilter> BloomFilter::Unserialize(const broker::data& data)
 	case Counting:
 		bf = std::unique_ptr<BloomFilter>(new CountingBloomFilter());
 		break;
+
+	case Blocked:
+		bf = std::unique_ptr<BloomFilter>(new BlockedBloomFilter());
+		break;
+
+	default:
+		return nullptr;
 	}
 
 	if ( ! bf->DoUnserialize((*v)[2]) )
@@ -301,4 +312,158 @@ bool CountingBloomFilter::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
+BlockedBloomFilter::BlockedBloomFilter()
+	{
+	}
+
+BlockedBloomFilter::BlockedBloomFilter(const detail::Hasher* hasher, size_t cells)
+	: BloomFilter(hasher)
+	{
+	blocks.resize(std::max((cells + BLOCK_BITS - 1) / BLOCK_BITS, size_t(1)), Block{});
+	}
+
+bool BlockedBloomFilter::Empty() const
+	{
+	for ( const auto& b : blocks )
+		for ( auto w : b.words )
+			if ( w )
+				return false;
+
+	return true;
+	}
+
+void BlockedBloomFilter::Clear()
+	{
+	std::fill(blocks.begin(), blocks.end(), Block{});
+	}
+
+bool BlockedBloomFilter::Merge(const BloomFilter* other)
+	{
+	if ( typeid(*this) != typeid(*other) )
+		return false;
+
+	const BlockedBloomFilter* o = static_cast<const BlockedBloomFilter*>(other);
+
+	if ( ! hasher->Equals(o->hasher) )
+		{
+		reporter->Error("incompatible hashers in BlockedBloomFilter merge");
+		return false;
+		}
+
+	else if ( blocks.size() != o->blocks.size() )
+		{
+		reporter->Error("different number of blocks in BlockedBloomFilter merge");
+		return false;
+		}
+
+	for ( size_t i = 0; i < blocks.size(); ++i )
+		for ( size_t j = 0; j < BLOCK_WORDS; ++j )
+			blocks[i].words[j] |= o->blocks[i].words[j];
+
+	return true;
+	}
+
+BlockedBloomFilter* BlockedBloomFilter::Clone() const
+	{
+	BlockedBloomFilter* copy = new BlockedBloomFilter();
+
+	copy->hasher = hasher->Clone();
+	copy->blocks = blocks;
+
+	return copy;
+	}
+
+std::string BlockedBloomFilter::InternalState() const
+	{
+	u_char buf[SHA256_DIGEST_LENGTH];
+	uint64_t digest;
+	EVP_MD_CTX* ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
+
+	for ( const auto& b : blocks )
+		zeek::detail::hash_update(ctx, b.words, sizeof(b.words));
+
+	zeek::detail::hash_final(ctx, buf);
+	memcpy(&digest, buf, sizeof(digest));
+	return util::fmt("%" PRIu64, digest);
+	}
+
+size_t BlockedBloomFilter::Locate(const zeek::detail::HashKey* key, Block* mask) const
+	{
+	detail::Hasher::digest_vector h = hasher->Hash(key);
+	*mask = Block{};
+
+	for ( size_t i = 1; i < h.size(); ++i )
+		{
+		// Take the bit from the upper half, as the lower one determined
+		// the block.
+		auto bit = (h[i] >> 32) % BLOCK_BITS;
+		mask->words[bit / 64] |= uint64_t(1) << (bit % 64);
+		}
+
+	return h[0] % blocks.size();
+	}
+
+void BlockedBloomFilter::Add(const zeek::detail::HashKey* key)
+	{
+	Block mask;
+	auto& b = blocks[Locate(key, &mask)];
+
+	for ( size_t j = 0; j < BLOCK_WORDS; ++j )
+		b.words[j] |= mask.words[j];
+	}
+
+size_t BlockedBloomFilter::Count(const zeek::detail::HashKey* key) const
+	{
+	Block mask;
+	const auto& b = blocks[Locate(key, &mask)];
+
+	// Without early exit, so that the compiler can vectorize this.
+	uint64_t missing = 0;
+
+	for ( size_t j = 0; j < BLOCK_WORDS; ++j )
+		missing |= mask.words[j] & ~b.words[j];
+
+	return missing == 0 ? 1 : 0;
+	}
+
+broker::expected<broker::data> BlockedBloomFilter::DoSerialize() const
+	{
+	broker::vector v = {static_cast<uint64_t>(blocks.size())};
+	v.reserve(1 + blocks.size() * BLOCK_WORDS);
+
+	for ( const auto& b : blocks )
+		for ( auto w : b.words )
+			v.emplace_back(static_cast<uint64_t>(w));
+
+	return {std::move(v)};
+	}
+
+bool BlockedBloomFilter::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && ! v->empty()) )
+		return false;
+
+	auto num_blocks = caf::get_if<uint64_t>(&(*v)[0]);
+
+	if ( ! (num_blocks && *num_blocks > 0 && v->size() == 1 + *num_blocks * BLOCK_WORDS) )
+		return false;
+
+	blocks.resize(*num_blocks);
+
+	for ( size_t i = 0; i < *num_blocks; ++i )
+		for ( size_t j = 0; j < BLOCK_WORDS; ++j )
+			{
+			auto w = caf::get_if<uint64_t>(&(*v)[1 + i * BLOCK_WORDS + j]);
+
+			if ( ! w )
+				return false;
+
+			blocks[i].words[j] = *w;
+			}
+
+	return true;
+	}
+
 } // namespace zeek::probabilistic
@@ -20,7 +20,7 @@ ZEEK_FORWARD_DECLARE_NAMESPACED(CounterVector, zeek, probabilistic, detail);
 namespace zeek::probabilistic {
 
 /** Types of derived BloomFilter classes. */
-enum BloomFilterType { Basic, Counting };
+enum BloomFilterType { Basic, Counting, Blocked };
 
 /**
  * The abstract base class for Bloom filters.
@@ -230,6 +230,66 @@ private:
 	detail::CounterVector* cells;
 };
 
+/**
+ * A blocked Bloom filter. It puts all bits of an element into the same
+ * cache-line sized block, so that adding or looking up an element touches
+ * a single cache line rather than one per hash function. This costs a
+ * slightly higher false-positive rate for the same number of bits.
+ */
+class BlockedBloomFilter : public BloomFilter {
+public:
+	/**
+	 * Constructs a blocked Bloom filter.
+	 *
+	 * @param hasher The hasher to use. Its first digest picks an element's
+	 * block and the remaining ones the bits within, so it needs to produce
+	 * one more digest than the desired number of bits per element.
+	 *
+	 * @param cells The minimum number of cells, which gets rounded up to
+	 * a multiple of the block size.
+	 */
+	BlockedBloomFilter(const detail::Hasher* hasher, size_t cells);
+
+	// Overridden from BloomFilter.
+	bool Empty() const override;
+	void Clear() override;
+	bool Merge(const BloomFilter* other) override;
+	BlockedBloomFilter* Clone() const override;
+	std::string InternalState() const override;
+
+protected:
+	friend class BloomFilter;
+
+	/**
+	 * Default constructor.
+	 */
+	BlockedBloomFilter();
+
+	// Overridden from BloomFilter.
+	void Add(const zeek::detail::HashKey* key) override;
+	size_t Count(const zeek::detail::HashKey* key) const override;
+	broker::expected<broker::data> DoSerialize() const override;
+	bool DoUnserialize(const broker::data& data) override;
+	BloomFilterType Type() const override
+		{ return BloomFilterType::Blocked; }
+
+private:
+	static constexpr size_t BLOCK_WORDS = 8;
+	static constexpr size_t BLOCK_BITS = BLOCK_WORDS * 64;
+
+	struct alignas(64) Block {
+		uint64_t words[BLOCK_WORDS];
+	};
+
+	/**
+	 * Computes the index of an element's block and the mask of its bits
+	 * in there.
+	 */
+	size_t Locate(const zeek::detail::HashKey* key, Block* mask) const;
+
+	std::vector<Block> blocks;
+};
+
 } // namespace zeek::probabilistic
 
 namespace probabilistic {
@@ -4,12 +4,15 @@
 
 #include <math.h>
 #include <stdint.h>
+#include <algorithm>
 #include <utility>
 
 #include <broker/data.hh>
 
 #include "Reporter.h"
 
+#include "3rdparty/doctest.h"
+
 namespace zeek::probabilistic::detail {
 
 int CardinalityCounter::OptimalB(double error, double confidence) const
@@ -57,18 +60,26 @@ void CardinalityCounter::Init(uint64_t size)
 		reporter->InternalError("Invalid size %" PRIu64 ". Size either has to be a power of 2", size);
 
 	p = calc_p;
+	V = m;
 
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
+	// Sparse entries have 24 bits for the bucket index.
+	if ( p > 24 )
+		Densify();
+	}
 
-	assert(buckets.size() == m);
+void CardinalityCounter::Densify()
+	{
+	buckets.assign(m, 0);
 
-	V = m;
+	for ( auto e : sparse )
+		buckets[e >> 8] = e & 0xff;
+
+	sparse.clear();
+	sparse.shrink_to_fit();
 	}
 
 CardinalityCounter::CardinalityCounter(CardinalityCounter& other)
-	: buckets(other.buckets)
+	: buckets(other.buckets), sparse(other.sparse)
 	{
 	V = other.V;
 	alpha_m = other.alpha_m;
@@ -85,6 +96,7 @@ CardinalityCounter::CardinalityCounter(CardinalityCounter&& o) noexcept
 
 	o.m = 0;
 	buckets = std::move(o.buckets);
+	sparse = std::move(o.sparse);
 	}
 
 CardinalityCounter::CardinalityCounter(double error_margin, double confidence)
@@ -103,11 +115,6 @@ CardinalityCounter::CardinalityCounter(uint64_t size)
 CardinalityCounter::CardinalityCounter(uint64_t arg_size, uint64_t arg_V, double arg_alpha_m)
 	{
 	m = arg_size;
-
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
-
 	alpha_m = arg_alpha_m;
 	V = arg_V;
 	p = log2(m);
@@ -131,13 +138,39 @@ void CardinalityCounter::AddElement(uint64_t hash)
 	uint64_t index = hash % m;
 	hash = hash-index;
 
-	if( buckets[index] == 0 )
-		V--;
+	Update(index, Rank(hash));
+	}
+
+void CardinalityCounter::Update(uint64_t index, uint8_t value)
+	{
+	if ( ! IsSparse() )
+		{
+		if ( buckets[index] == 0 )
+			V--;
+
+		if ( value > buckets[index] )
+			buckets[index] = value;
+
+		return;
+		}
+
+	uint32_t key = index << 8;
+	auto it = std::lower_bound(sparse.begin(), sparse.end(), key);
+
+	if ( it != sparse.end() && (*it >> 8) == index )
+		{
+		if ( value > (*it & 0xff) )
+			*it = key | value;
+
+		return;
+		}
 
-	uint8_t temp = Rank(hash);
+	sparse.insert(it, key | value);
+	V--;
 
-	if ( temp > buckets[index] )
-		buckets[index] = temp;
+	// A sparse entry takes four bytes, a dense bucket one.
+	if ( sparse.size() * sizeof(uint32_t) >= m )
+		Densify();
 	}
 
 /**
@@ -152,8 +185,18 @@ void CardinalityCounter::AddElement(uint64_t hash)
 double CardinalityCounter::Size() const
 	{
 	double answer = 0;
-	for ( unsigned int i = 0; i < m; i++ )
-		answer += pow(2, -((int)buckets[i]));
+
+	if ( IsSparse() )
+		{
+		// All buckets not listed are zero.
+		answer = V;
+
+		for ( auto e : sparse )
+			answer += pow(2, -((int)(e & 0xff)));
+		}
+	else
+		for ( unsigned int i = 0; i < m; i++ )
+			answer += pow(2, -((int)buckets[i]));
 
 	answer = 1 / answer;
 	answer = (alpha_m * m * m * answer);
@@ -173,18 +216,24 @@ bool CardinalityCounter::Merge(CardinalityCounter* c)
 	if ( m != c->GetM() )
 		return false;
 
-	const std::vector<uint8_t>& temp = c->GetBuckets();
+	if ( c->IsSparse() )
+		{
+		for ( auto e : c->sparse )
+			Update(e >> 8, e & 0xff);
+
+		return true;
+		}
+
+	if ( IsSparse() )
+		Densify();
 
-	V = 0;
+	const std::vector<uint8_t>& temp = c->GetBuckets();
 
+	// Kept free of branches so that the compiler can vectorize it.
 	for ( size_t i = 0; i < m; i++ )
-		{
-		if ( temp[i] > buckets[i] )
-			buckets[i] = temp[i];
+		buckets[i] = std::max(buckets[i], temp[i]);
 
-		if ( buckets[i] == 0 )
-			++V;
-		}
+	V = std::count(buckets.begin(), buckets.end(), 0);
 
 	return true;
 	}
@@ -202,6 +251,19 @@ uint64_t CardinalityCounter::GetM() const
 broker::expected<broker::data> CardinalityCounter::Serialize() const
 	{
 	broker::vector v = {m, V, alpha_m};
+
+	if ( IsSparse() )
+		{
+		broker::vector s;
+		s.reserve(sparse.size());
+
+		for ( auto e : sparse )
+			s.emplace_back(static_cast<uint64_t>(e));
+
+		v.emplace_back(std::move(s));
+		return {std::move(v)};
+		}
+
 	v.reserve(3 + m);
 
 	for ( size_t i = 0; i < m; ++i )
@@ -222,14 +284,40 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 
 	if ( ! (m && V && alpha_m) )
 		return nullptr;
+
+	if ( v->size() == 4 )
+		{
+		auto s = caf::get_if<broker::vector>(&(*v)[3]);
+
+		if ( ! (s && *m <= (1 << 24) && s->size() < *m) )
+			return nullptr;
+
+		auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(*m, *V, *alpha_m));
+
+		for ( const auto& d : *s )
+			{
+			auto e = caf::get_if<uint64_t>(&d);
+
+			if ( ! (e && (*e >> 8) < *m && (*e & 0xff) > 0) )
+				return nullptr;
+
+			if ( ! cc->sparse.empty() && *e <= cc->sparse.back() )
+				return nullptr;
+
+			cc->sparse.push_back(*e);
+			}
+
+		return cc;
+		}
+
 	if ( v->size() != 3 + *m )
 		return nullptr;
 
 	auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(*m, *V, *alpha_m));
 	if ( *m != cc->m )
 		return nullptr;
-	if ( cc->buckets.size() != * m )
-		return nullptr;
+
+	cc->buckets.assign(*m, 0);
 
 	for ( size_t i = 0; i < *m; ++i )
 		{
@@ -243,6 +331,54 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 	return cc;
 	}
 
+static uint64_t test_hash(uint64_t x)
+	{
+	// splitmix64's finalizer.
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+	}
+
+TEST_CASE("probabilistic cardinality counter sparse")
+	{
+	CardinalityCounter a(uint64_t(1024));
+	CardinalityCounter b(uint64_t(1024));
+
+	for ( uint64_t i = 0; i < 100; ++i )
+		{
+		a.AddElement(test_hash(i + 1));
+		b.AddElement(test_hash(i + 101));
+		}
+
+	CHECK(a.IsSparse());
+	CHECK(fabs(a.Size() - 100) < 10);
+
+	auto d = a.Serialize();
+	REQUIRE(d);
+	auto c = CardinalityCounter::Unserialize(*d);
+	REQUIRE(c);
+	CHECK(c->IsSparse());
+	CHECK(c->Size() == a.Size());
+
+	a.Merge(&b);
+	CHECK(a.IsSparse());
+	CHECK(fabs(a.Size() - 200) < 20);
+
+	for ( uint64_t i = 200; i < 1000; ++i )
+		a.AddElement(test_hash(i + 1));
+
+	CHECK(! a.IsSparse());
+	CHECK(fabs(a.Size() - 1000) < 100);
+
+	// Merging a sparse counter into a dense one, and vice versa.
+	c->Merge(&a);
+	CHECK(! c->IsSparse());
+	CHECK(c->Size() == a.Size());
+	a.Merge(&b);
+	CHECK(c->Size() == a.Size());
+	}
+
 /**
  * The following function is copied from libc/string/flsll.c from the FreeBSD source
  * tree. Original copyright message follows
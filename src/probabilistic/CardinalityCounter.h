@@ -15,6 +15,11 @@ namespace zeek::probabilistic::detail {
 
 /**
  * A probabilistic cardinality counter using the HyperLogLog algorithm.
+ *
+ * Following HyperLogLog++, a counter starts out with a sparse
+ * representation that only stores the buckets set so far, and switches to
+ * the full bucket array once that would take less memory. Counters that
+ * only ever see few elements thus stay small.
  */
 class CardinalityCounter {
 public:
@@ -89,6 +94,11 @@ public:
 	 */
 	bool Merge(CardinalityCounter* c);
 
+	/**
+	 * Returns true if the counter uses the sparse representation.
+	 */
+	bool IsSparse() const	{ return buckets.empty(); }
+
 	broker::expected<broker::data> Serialize() const;
 	static std::unique_ptr<CardinalityCounter> Unserialize(const broker::data& data);
 
@@ -102,7 +112,7 @@ protected:
 
 	/**
 	 * Returns the buckets array that holds all of the rough cardinality
-	 * estimates.
+	 * estimates. This is empty while the counter is sparse.
 	 *
 	 * Use GetM() to determine the size.
 	 *
@@ -143,6 +153,20 @@ private:
 	 */
 	int OptimalB(double error, double confidence) const;
 
+	/**
+	 * Raises a bucket to at least a given value.
+	 *
+	 * @param index the bucket.
+	 *
+	 * @param value the value.
+	 */
+	void Update(uint64_t index, uint8_t value);
+
+	/**
+	 * Switches from the sparse to the dense representation.
+	 */
+	void Densify();
+
 	/**
 	 * Determines at which index (counted from the front) the first one-bit
 	 * appears. The last b bits have to be 0 (the element has to be divisible
@@ -175,6 +199,13 @@ private:
 	 */
 	std::vector<uint8_t> buckets;
 
+	/**
+	 * While the counter is sparse, the non-zero buckets, sorted, each
+	 * encoded as the bucket's index shifted left by 8 bits, ORed with
+	 * its value.
+	 */
+	std::vector<uint32_t> sparse;
+
 	/**
 	 * There are some state constants that need to be kept track of to
 	 * make the final estimate easier. V is the number of values in
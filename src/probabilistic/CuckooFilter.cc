@@ -0,0 +1,477 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "probabilistic/CuckooFilter.h"
+
+#include <broker/error.hh>
+
+#include <algorithm>
+#include <cmath>
+
+#include "broker/Data.h"
+#include "CompHash.h"
+#include "Reporter.h"
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::probabilistic::detail {
+
+CuckooFilter::CuckooFilter(size_t capacity, Hasher::seed_t seed)
+	{
+	hasher = std::make_unique<DefaultHasher>(1, seed);
+
+	// Cuckoo filters with four slots per bucket reach loads of about
+	// 95% before insertions start failing.
+	size_t needed = std::ceil(capacity / (SLOTS * 0.95));
+	size_t n = 1;
+
+	while ( n < needed )
+		n <<= 1;
+
+	buckets.resize(n, Bucket{});
+	}
+
+CuckooFilter::CuckooFilter(const CuckooFilter& other)
+	: hasher(other.hasher->Clone()), buckets(other.buckets),
+	  num_items(other.num_items), has_victim(other.has_victim),
+	  victim_index(other.victim_index), victim_fp(other.victim_fp)
+	{
+	}
+
+void CuckooFilter::Locate(const zeek::detail::HashKey* key, size_t* index, fingerprint* fp) const
+	{
+	auto h = hasher->Hash(key)[0];
+	*index = h & (buckets.size() - 1);
+	*fp = h >> 48;
+
+	// Zero marks empty slots.
+	if ( *fp == 0 )
+		*fp = 1;
+	}
+
+size_t CuckooFilter::AltIndex(size_t index, fingerprint fp) const
+	{
+	// Partial-key cuckoo hashing: the alternate bucket derives from the
+	// fingerprint alone, so we can relocate fingerprints without their
+	// elements. Applying this twice yields the original index.
+	return (index ^ (fp * 0x5bd1e995ULL)) & (buckets.size() - 1);
+	}
+
+bool CuckooFilter::InsertInto(size_t index, fingerprint fp)
+	{
+	for ( auto& s : buckets[index].slots )
+		if ( s == 0 )
+			{
+			s = fp;
+			return true;
+			}
+
+	return false;
+	}
+
+bool CuckooFilter::RemoveFrom(size_t index, fingerprint fp)
+	{
+	for ( auto& s : buckets[index].slots )
+		if ( s == fp )
+			{
+			s = 0;
+			return true;
+			}
+
+	return false;
+	}
+
+bool CuckooFilter::Contains(size_t index, fingerprint fp) const
+	{
+	const auto& b = buckets[index];
+	return b.slots[0] == fp || b.slots[1] == fp || b.slots[2] == fp || b.slots[3] == fp;
+	}
+
+bool CuckooFilter::Insert(size_t index, fingerprint fp)
+	{
+	if ( has_victim )
+		return false;
+
+	if ( InsertInto(index, fp) || InsertInto(AltIndex(index, fp), fp) )
+		{
+		++num_items;
+		return true;
+		}
+
+	// Both buckets are full, so evict fingerprints to their alternate
+	// buckets until one finds room.
+	for ( size_t kick = 0; kick < MAX_KICKS; ++kick )
+		{
+		auto slot = (fp ^ kick) % SLOTS;
+		std::swap(fp, buckets[index].slots[slot]);
+		index = AltIndex(index, fp);
+
+		if ( InsertInto(index, fp) )
+			{
+			++num_items;
+			return true;
+			}
+		}
+
+	// Keep the last evicted fingerprint so that no element gets lost,
+	// but refuse any further additions.
+	has_victim = true;
+	victim_index = index;
+	victim_fp = fp;
+	++num_items;
+	return true;
+	}
+
+bool CuckooFilter::Add(const zeek::detail::HashKey* key)
+	{
+	size_t index;
+	fingerprint fp;
+	Locate(key, &index, &fp);
+	return Insert(index, fp);
+	}
+
+bool CuckooFilter::Remove(const zeek::detail::HashKey* key)
+	{
+	size_t index;
+	fingerprint fp;
+	Locate(key, &index, &fp);
+	auto alt = AltIndex(index, fp);
+
+	if ( has_victim && victim_fp == fp && (victim_index == index || victim_index == alt) )
+		{
+		has_victim = false;
+		--num_items;
+		return true;
+		}
+
+	if ( ! (RemoveFrom(index, fp) || RemoveFrom(alt, fp)) )
+		return false;
+
+	--num_items;
+
+	if ( has_victim )
+		{
+		// There's room again now.
+		has_victim = false;
+		--num_items;
+		Insert(victim_index, victim_fp);
+		}
+
+	return true;
+	}
+
+bool CuckooFilter::Lookup(const zeek::detail::HashKey* key) const
+	{
+	size_t index;
+	fingerprint fp;
+	Locate(key, &index, &fp);
+	auto alt = AltIndex(index, fp);
+
+	if ( has_victim && victim_fp == fp && (victim_index == index || victim_index == alt) )
+		return true;
+
+	return Contains(index, fp) || Contains(alt, fp);
+	}
+
+void CuckooFilter::Clear()
+	{
+	std::fill(buckets.begin(), buckets.end(), Bucket{});
+	num_items = 0;
+	has_victim = false;
+	}
+
+bool CuckooFilter::Merge(const CuckooFilter& other)
+	{
+	if ( buckets.size() != other.buckets.size() || ! hasher->Equals(other.hasher.get()) )
+		return false;
+
+	for ( size_t i = 0; i < other.buckets.size(); ++i )
+		for ( auto s : other.buckets[i].slots )
+			if ( s != 0 && ! Insert(i, s) )
+				return false;
+
+	if ( other.has_victim && ! Insert(other.victim_index, other.victim_fp) )
+		return false;
+
+	return true;
+	}
+
+broker::expected<broker::data> CuckooFilter::Serialize() const
+	{
+	auto h = hasher->Serialize();
+
+	if ( ! h )
+		return broker::ec::invalid_data;
+
+	broker::vector d = {std::move(*h), static_cast<uint64_t>(num_items),
+	                    has_victim, static_cast<uint64_t>(victim_index),
+	                    static_cast<uint64_t>(victim_fp)};
+
+	d.reserve(d.size() + buckets.size());
+
+	// Each bucket packs into one 64-bit word.
+	for ( const auto& b : buckets )
+		{
+		uint64_t w = 0;
+
+		for ( size_t i = 0; i < SLOTS; ++i )
+			w |= static_cast<uint64_t>(b.slots[i]) << (16 * i);
+
+		d.emplace_back(w);
+		}
+
+	return {std::move(d)};
+	}
+
+std::unique_ptr<CuckooFilter> CuckooFilter::Unserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() > 5) )
+		return nullptr;
+
+	auto num_items = caf::get_if<uint64_t>(&(*v)[1]);
+	auto has_victim = caf::get_if<bool>(&(*v)[2]);
+	auto victim_index = caf::get_if<uint64_t>(&(*v)[3]);
+	auto victim_fp = caf::get_if<uint64_t>(&(*v)[4]);
+
+	if ( ! (num_items && has_victim && victim_index && victim_fp) )
+		return nullptr;
+
+	size_t n = v->size() - 5;
+
+	// Indexing relies on a power-of-two number of buckets.
+	if ( (n & (n - 1)) != 0 || *victim_index >= n || *victim_fp > UINT16_MAX )
+		return nullptr;
+
+	auto hasher = Hasher::Unserialize((*v)[0]);
+
+	if ( ! hasher )
+		return nullptr;
+
+	std::unique_ptr<CuckooFilter> cf(new CuckooFilter());
+	cf->hasher = std::move(hasher);
+	cf->buckets.resize(n);
+	cf->num_items = *num_items;
+	cf->has_victim = *has_victim;
+	cf->victim_index = *victim_index;
+	cf->victim_fp = *victim_fp;
+
+	for ( size_t i = 0; i < n; ++i )
+		{
+		auto w = caf::get_if<uint64_t>(&(*v)[5 + i]);
+
+		if ( ! w )
+			return nullptr;
+
+		for ( size_t j = 0; j < SLOTS; ++j )
+			cf->buckets[i].slots[j] = *w >> (16 * j);
+		}
+
+	return cf;
+	}
+
+CuckooFilterVal::CuckooFilterVal() : OpaqueVal(cuckoofilter_type)
+	{
+	}
+
+CuckooFilterVal::CuckooFilterVal(CuckooFilter* cf)
+	: OpaqueVal(cuckoofilter_type), filter(cf)
+	{
+	}
+
+CuckooFilterVal::~CuckooFilterVal()
+	{
+	delete hash;
+	delete filter;
+	}
+
+ValPtr CuckooFilterVal::DoClone(CloneState* state)
+	{
+	auto cf = make_intrusive<CuckooFilterVal>(new CuckooFilter(*filter));
+
+	if ( type )
+		cf->Typify(type);
+
+	return state->NewClone(this, std::move(cf));
+	}
+
+bool CuckooFilterVal::Typify(TypePtr arg_type)
+	{
+	if ( type )
+		return false;
+
+	type = std::move(arg_type);
+
+	auto tl = make_intrusive<TypeList>(type);
+	tl->Append(type);
+	hash = new zeek::detail::CompositeHash(std::move(tl));
+
+	return true;
+	}
+
+bool CuckooFilterVal::Add(const Val* val)
+	{
+	auto key = hash->MakeHashKey(*val, true);
+	return filter->Add(key.get());
+	}
+
+bool CuckooFilterVal::Remove(const Val* val)
+	{
+	auto key = hash->MakeHashKey(*val, true);
+	return filter->Remove(key.get());
+	}
+
+bool CuckooFilterVal::Lookup(const Val* val) const
+	{
+	auto key = hash->MakeHashKey(*val, true);
+	return filter->Lookup(key.get());
+	}
+
+void CuckooFilterVal::Clear()
+	{
+	filter->Clear();
+	}
+
+IntrusivePtr<CuckooFilterVal> CuckooFilterVal::Merge(const CuckooFilterVal* x,
+                                                     const CuckooFilterVal* y)
+	{
+	if ( x->Type() && y->Type() && ! same_type(x->Type(), y->Type()) )
+		{
+		reporter->Error("cannot merge cuckoo filters with different types");
+		return nullptr;
+		}
+
+	auto merged = make_intrusive<CuckooFilterVal>(new CuckooFilter(*x->filter));
+
+	if ( ! merged->filter->Merge(*y->filter) )
+		{
+		reporter->Error("failed to merge cuckoo filters");
+		return nullptr;
+		}
+
+	const auto& t = x->Type() ? x->Type() : y->Type();
+
+	if ( t )
+		merged->Typify(t);
+
+	return merged;
+	}
+
+IMPLEMENT_OPAQUE_VALUE(CuckooFilterVal)
+
+broker::expected<broker::data> CuckooFilterVal::DoSerialize() const
+	{
+	broker::vector d;
+
+	if ( type )
+		{
+		auto t = SerializeType(type);
+		if ( ! t )
+			return broker::ec::invalid_data;
+
+		d.emplace_back(std::move(*t));
+		}
+	else
+		d.emplace_back(broker::none());
+
+	auto cf = filter->Serialize();
+	if ( ! cf )
+		return broker::ec::invalid_data;
+
+	d.emplace_back(std::move(*cf));
+	return {std::move(d)};
+	}
+
+bool CuckooFilterVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 2) )
+		return false;
+
+	auto no_type = caf::get_if<broker::none>(&(*v)[0]);
+	if ( ! no_type )
+		{
+		auto t = UnserializeType((*v)[0]);
+
+		if ( ! (t && Typify(std::move(t))) )
+			return false;
+		}
+
+	auto cf = CuckooFilter::Unserialize((*v)[1]);
+	if ( ! cf )
+		return false;
+
+	filter = cf.release();
+	return true;
+	}
+
+TEST_CASE("probabilistic cuckoo filter")
+	{
+	CuckooFilter cf(1000, {{1, 2}});
+
+	CHECK(cf.Slots() == 2048);
+
+	for ( uint64_t i = 0; i < 1000; ++i )
+		{
+		zeek::detail::HashKey k(static_cast<bro_uint_t>(i));
+		CHECK(cf.Add(&k));
+		}
+
+	CHECK(cf.Size() == 1000);
+
+	for ( uint64_t i = 0; i < 1000; ++i )
+		{
+		zeek::detail::HashKey k(static_cast<bro_uint_t>(i));
+		CHECK(cf.Lookup(&k));
+		}
+
+	size_t false_positives = 0;
+
+	for ( uint64_t i = 1000; i < 11000; ++i )
+		{
+		zeek::detail::HashKey k(static_cast<bro_uint_t>(i));
+		false_positives += cf.Lookup(&k);
+		}
+
+	CHECK(false_positives < 10);
+
+	for ( uint64_t i = 0; i < 500; ++i )
+		{
+		zeek::detail::HashKey k(static_cast<bro_uint_t>(i));
+		CHECK(cf.Remove(&k));
+		}
+
+	CHECK(cf.Size() == 500);
+
+	zeek::detail::HashKey removed(static_cast<bro_uint_t>(42));
+	zeek::detail::HashKey kept(static_cast<bro_uint_t>(542));
+	CHECK(! cf.Lookup(&removed));
+	CHECK(cf.Lookup(&kept));
+
+	CuckooFilter copy(cf);
+	cf.Clear();
+	CHECK(cf.Size() == 0);
+	CHECK(! cf.Lookup(&kept));
+	CHECK(copy.Lookup(&kept));
+	}
+
+TEST_CASE("probabilistic cuckoo filter merge")
+	{
+	CuckooFilter a(100, {{1, 2}});
+	CuckooFilter b(100, {{1, 2}});
+	CuckooFilter c(100, {{3, 4}});
+
+	zeek::detail::HashKey k1(static_cast<bro_uint_t>(1));
+	zeek::detail::HashKey k2(static_cast<bro_uint_t>(2));
+	a.Add(&k1);
+	b.Add(&k2);
+
+	CHECK(! a.Merge(c));
+	CHECK(a.Merge(b));
+	CHECK(a.Size() == 2);
+	CHECK(a.Lookup(&k1));
+	CHECK(a.Lookup(&k2));
+	}
+
+} // namespace zeek::probabilistic::detail
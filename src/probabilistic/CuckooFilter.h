@@ -0,0 +1,183 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "OpaqueVal.h"
+#include "probabilistic/Hasher.h"
+
+ZEEK_FORWARD_DECLARE_NAMESPACED(CompositeHash, zeek::detail);
+
+namespace zeek::probabilistic::detail {
+
+/**
+ * A cuckoo filter, an approximate set membership structure that, unlike a
+ * basic Bloom filter, supports removing elements. It stores a 16-bit
+ * fingerprint of each element in one of two candidate buckets of four
+ * slots each, so lookups touch at most two buckets, and its memory use is a
+ * fraction of a CountingBloomFilter's with a similar false-positive rate.
+ * See Fan et al., "Cuckoo Filter: Practically Better Than Bloom".
+ *
+ * Like a multiset, the filter may hold an element several times, each
+ * needing its own removal. Removing an element that has never been added
+ * may remove another one sharing its fingerprint.
+ */
+class CuckooFilter {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param capacity The number of elements the filter needs to hold.
+	 *
+	 * @param seed The seed for hashing elements. Only filters with the
+	 * same capacity and seed can be merged.
+	 */
+	CuckooFilter(size_t capacity, Hasher::seed_t seed);
+
+	/**
+	 * Copy constructor.
+	 */
+	CuckooFilter(const CuckooFilter& other);
+
+	/**
+	 * Adds an element.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @return False if the filter is full.
+	 */
+	bool Add(const zeek::detail::HashKey* key);
+
+	/**
+	 * Removes an element.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @return False if the element wasn't found.
+	 */
+	bool Remove(const zeek::detail::HashKey* key);
+
+	/**
+	 * Checks whether an element may be in the filter.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @return True if the element may have been added, false if it
+	 * certainly hasn't been.
+	 */
+	bool Lookup(const zeek::detail::HashKey* key) const;
+
+	/**
+	 * Removes all elements.
+	 */
+	void Clear();
+
+	/**
+	 * Adds all elements of another filter.
+	 *
+	 * @param other The filter to merge in, which must have the same
+	 * capacity and seed.
+	 *
+	 * @return False if the filters aren't compatible or this one
+	 * becomes full, which leaves it partially merged.
+	 */
+	bool Merge(const CuckooFilter& other);
+
+	/**
+	 * Returns the number of elements in the filter.
+	 */
+	size_t Size() const	{ return num_items; }
+
+	/**
+	 * Returns the number of slots in the filter. It holds at most about
+	 * 95% of this many elements.
+	 */
+	size_t Slots() const	{ return buckets.size() * SLOTS; }
+
+	broker::expected<broker::data> Serialize() const;
+	static std::unique_ptr<CuckooFilter> Unserialize(const broker::data& data);
+
+private:
+	CuckooFilter() = default;
+
+	using fingerprint = uint16_t;
+
+	static constexpr size_t SLOTS = 4;
+	static constexpr size_t MAX_KICKS = 500;
+
+	struct Bucket {
+		fingerprint slots[SLOTS];
+	};
+
+	void Locate(const zeek::detail::HashKey* key, size_t* index, fingerprint* fp) const;
+	size_t AltIndex(size_t index, fingerprint fp) const;
+	bool Insert(size_t index, fingerprint fp);
+	bool InsertInto(size_t index, fingerprint fp);
+	bool RemoveFrom(size_t index, fingerprint fp);
+	bool Contains(size_t index, fingerprint fp) const;
+
+	std::unique_ptr<Hasher> hasher;
+	std::vector<Bucket> buckets;	// Power-of-two many, empty slots are 0.
+	size_t num_items = 0;
+
+	// A fingerprint that couldn't be placed anymore. Once set, the
+	// filter is full.
+	bool has_victim = false;
+	size_t victim_index = 0;
+	fingerprint victim_fp = 0;
+};
+
+/**
+ * An opaque value holding a CuckooFilter, see cuckoo-filter.bif.
+ */
+class CuckooFilterVal : public OpaqueVal {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param cf The filter, which we take ownership of.
+	 */
+	explicit CuckooFilterVal(CuckooFilter* cf);
+	~CuckooFilterVal() override;
+
+	ValPtr DoClone(CloneState* state) override;
+
+	const TypePtr& Type() const
+		{ return type; }
+
+	bool Typify(TypePtr type);
+
+	bool Add(const Val* val);
+	bool Remove(const Val* val);
+	bool Lookup(const Val* val) const;
+	void Clear();
+	size_t Size() const	{ return filter->Size(); }
+
+	/**
+	 * Merges two filters of the same type into a new one.
+	 *
+	 * @return The merged filter, or null if the filters aren't compatible
+	 * or the result would exceed the capacity.
+	 */
+	static IntrusivePtr<CuckooFilterVal> Merge(const CuckooFilterVal* x,
+	                                           const CuckooFilterVal* y);
+
+protected:
+	CuckooFilterVal();
+
+	DECLARE_OPAQUE_VALUE(CuckooFilterVal)
+
+private:
+	CuckooFilterVal(const CuckooFilterVal&) = delete;
+	CuckooFilterVal& operator=(const CuckooFilterVal&) = delete;
+
+	TypePtr type;
+	zeek::detail::CompositeHash* hash = nullptr;
+	CuckooFilter* filter = nullptr;
+};
+
+} // namespace zeek::probabilistic::detail
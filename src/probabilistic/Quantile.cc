@@ -0,0 +1,258 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "probabilistic/Quantile.h"
+
+#include <broker/error.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "broker/Data.h"
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::probabilistic::detail {
+
+TDigest::TDigest(double arg_compression)
+	{
+	compression = std::max(arg_compression, 10.0);
+	min = std::numeric_limits<double>::infinity();
+	max = -std::numeric_limits<double>::infinity();
+	}
+
+void TDigest::Add(double x, double w)
+	{
+	if ( std::isnan(x) || w <= 0 )
+		return;
+
+	buffer.push_back({x, w});
+	buffered_weight += w;
+	min = std::min(min, x);
+	max = std::max(max, x);
+
+	if ( buffer.size() >= 5 * compression )
+		Compress();
+	}
+
+void TDigest::Merge(const TDigest& other)
+	{
+	buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+	buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+	buffered_weight += other.weight + other.buffered_weight;
+	min = std::min(min, other.min);
+	max = std::max(max, other.max);
+
+	if ( buffer.size() >= 5 * compression )
+		Compress();
+	}
+
+double TDigest::Scale(double q) const
+	{
+	// The k1 scale function of the t-digest paper.
+	return compression / (2 * M_PI) * std::asin(2 * std::min(std::max(q, 0.0), 1.0) - 1);
+	}
+
+void TDigest::Compress()
+	{
+	if ( buffer.empty() )
+		return;
+
+	buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+	std::sort(buffer.begin(), buffer.end(),
+	          [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+	auto total = weight + buffered_weight;
+	centroids.clear();
+
+	auto cur = buffer[0];
+	double before = 0; // Weight of the centroids preceding cur.
+
+	for ( size_t i = 1; i < buffer.size(); ++i )
+		{
+		const auto& c = buffer[i];
+		auto proposed = cur.weight + c.weight;
+
+		// A centroid may only span one unit of the scale function,
+		// which keeps centroids the smaller, the closer they are to
+		// the tails.
+		auto k_left = Scale(before / total);
+		auto k_right = Scale((before + proposed) / total);
+
+		if ( k_right - k_left <= 1 )
+			{
+			cur.mean += (c.mean - cur.mean) * c.weight / proposed;
+			cur.weight = proposed;
+			}
+		else
+			{
+			before += cur.weight;
+			centroids.push_back(cur);
+			cur = c;
+			}
+		}
+
+	centroids.push_back(cur);
+	buffer.clear();
+	weight = total;
+	buffered_weight = 0;
+	}
+
+const std::vector<TDigest::Centroid>& TDigest::Centroids()
+	{
+	Compress();
+	return centroids;
+	}
+
+double TDigest::Quantile(double q)
+	{
+	Compress();
+
+	if ( centroids.empty() )
+		return 0;
+
+	if ( q <= 0 )
+		return min;
+
+	if ( q >= 1 )
+		return max;
+
+	if ( centroids.size() == 1 )
+		return centroids[0].mean;
+
+	auto index = q * weight;
+	const auto& first = centroids.front();
+	const auto& last = centroids.back();
+
+	// Between the extremes and the outermost centroids, interpolate
+	// toward min/max.
+	if ( index < first.weight / 2 )
+		return min + (first.mean - min) * index / (first.weight / 2);
+
+	if ( index > weight - last.weight / 2 )
+		return max - (max - last.mean) * (weight - index) / (last.weight / 2);
+
+	// Otherwise interpolate between the centers of adjacent centroids.
+	double center = first.weight / 2;
+
+	for ( size_t i = 0; i + 1 < centroids.size(); ++i )
+		{
+		const auto& a = centroids[i];
+		const auto& b = centroids[i + 1];
+		auto dist = (a.weight + b.weight) / 2;
+
+		if ( index <= center + dist )
+			return a.mean + (b.mean - a.mean) * (index - center) / dist;
+
+		center += dist;
+		}
+
+	return last.mean;
+	}
+
+QuantileVal::QuantileVal(double compression)
+	: OpaqueVal(quantile_type), digest(compression)
+	{
+	}
+
+QuantileVal::QuantileVal() : OpaqueVal(quantile_type), digest(100)
+	{
+	}
+
+ValPtr QuantileVal::DoClone(CloneState* state)
+	{
+	auto clone = make_intrusive<QuantileVal>(digest.Compression());
+	clone->digest.Merge(digest);
+	return state->NewClone(this, std::move(clone));
+	}
+
+IMPLEMENT_OPAQUE_VALUE(QuantileVal)
+
+broker::expected<broker::data> QuantileVal::DoSerialize() const
+	{
+	broker::vector d = {digest.compression, digest.min, digest.max};
+
+	for ( const auto* cs : {&digest.centroids, &digest.buffer} )
+		for ( const auto& c : *cs )
+			{
+			d.emplace_back(c.mean);
+			d.emplace_back(c.weight);
+			}
+
+	return {std::move(d)};
+	}
+
+bool QuantileVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() >= 3 && v->size() % 2 == 1) )
+		return false;
+
+	auto compression = caf::get_if<double>(&(*v)[0]);
+	auto min = caf::get_if<double>(&(*v)[1]);
+	auto max = caf::get_if<double>(&(*v)[2]);
+
+	if ( ! (compression && min && max) )
+		return false;
+
+	digest = TDigest(*compression);
+
+	for ( size_t i = 3; i < v->size(); i += 2 )
+		{
+		auto mean = caf::get_if<double>(&(*v)[i]);
+		auto weight = caf::get_if<double>(&(*v)[i + 1]);
+
+		if ( ! (mean && weight && *weight > 0) )
+			return false;
+
+		digest.buffer.push_back({*mean, *weight});
+		digest.buffered_weight += *weight;
+		}
+
+	if ( ! digest.buffer.empty() )
+		{
+		digest.min = *min;
+		digest.max = *max;
+		}
+
+	return true;
+	}
+
+TEST_CASE("probabilistic tdigest quantiles")
+	{
+	TDigest d(100);
+
+	CHECK(d.Quantile(0.5) == 0);
+
+	for ( int i = 1; i <= 10000; ++i )
+		d.Add(i);
+
+	CHECK(d.Count() == 10000);
+	CHECK(d.Quantile(0) == 1);
+	CHECK(d.Quantile(1) == 10000);
+	CHECK(std::abs(d.Quantile(0.5) - 5000) < 50);
+	CHECK(std::abs(d.Quantile(0.99) - 9900) < 20);
+	CHECK(d.Centroids().size() <= 200);
+	}
+
+TEST_CASE("probabilistic tdigest merge")
+	{
+	TDigest a(100);
+	TDigest b(100);
+
+	for ( int i = 1; i <= 5000; ++i )
+		{
+		a.Add(i);
+		b.Add(i + 5000);
+		}
+
+	a.Merge(b);
+	CHECK(a.Count() == 10000);
+	CHECK(a.Min() == 1);
+	CHECK(a.Max() == 10000);
+	CHECK(std::abs(a.Quantile(0.5) - 5000) < 50);
+	CHECK(std::abs(a.Quantile(0.01) - 100) < 20);
+	}
+
+} // namespace zeek::probabilistic::detail
@@ -0,0 +1,128 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <vector>
+
+#include "OpaqueVal.h"
+
+namespace zeek::probabilistic::detail {
+
+/**
+ * A t-digest, estimating quantiles of a stream of values in bounded space.
+ * It summarizes the values as weighted centroids, keeping those near the
+ * tails small, so extreme quantiles remain accurate. Digests can be
+ * merged, so that quantiles over values observed on several nodes can be
+ * computed from the nodes' digests. See Dunning and Ertl, "Computing
+ * Extremely Accurate Quantiles Using t-Digests".
+ */
+class TDigest {
+public:
+	struct Centroid {
+		double mean;
+		double weight;
+	};
+
+	/**
+	 * Constructor.
+	 *
+	 * @param compression Bounds the number of centroids kept, which is
+	 * at most about this. Larger values improve accuracy.
+	 */
+	explicit TDigest(double compression);
+
+	/**
+	 * Adds a value.
+	 *
+	 * @param x The value.
+	 *
+	 * @param weight The number of times to count it.
+	 */
+	void Add(double x, double weight = 1);
+
+	/**
+	 * Merges another digest into this one.
+	 */
+	void Merge(const TDigest& other);
+
+	/**
+	 * Estimates a quantile of the values added so far.
+	 *
+	 * @param q The quantile, between 0 and 1.
+	 *
+	 * @return The estimate, or 0 if no values have been added.
+	 */
+	double Quantile(double q);
+
+	/**
+	 * Returns the total weight of the values added so far.
+	 */
+	double Count() const	{ return weight + buffered_weight; }
+
+	/**
+	 * Returns the compression parameter given to the constructor.
+	 */
+	double Compression() const	{ return compression; }
+
+	/**
+	 * Returns the centroids, all values added so far summarized.
+	 */
+	const std::vector<Centroid>& Centroids();
+
+	/**
+	 * Returns the smallest value added so far.
+	 */
+	double Min() const	{ return min; }
+
+	/**
+	 * Returns the largest value added so far.
+	 */
+	double Max() const	{ return max; }
+
+private:
+	friend class QuantileVal;
+
+	double Scale(double q) const;
+	void Compress();
+
+	double compression;
+	std::vector<Centroid> centroids;	// Sorted by mean.
+	std::vector<Centroid> buffer;	// Values not yet merged in.
+	double weight = 0;	// Total weight of the centroids.
+	double buffered_weight = 0;	// Total weight of the buffer.
+	double min;
+	double max;
+};
+
+/**
+ * An opaque value holding a TDigest, see quantile.bif.
+ */
+class QuantileVal : public OpaqueVal {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param compression See TDigest::TDigest().
+	 */
+	explicit QuantileVal(double compression);
+
+	/**
+	 * Returns the digest.
+	 */
+	TDigest* Get()	{ return &digest; }
+
+	ValPtr DoClone(CloneState* state) override;
+
+	DECLARE_OPAQUE_VALUE(QuantileVal)
+
+protected:
+	/**
+	 * Construct an empty QuantileVal. Only used for deserialization.
+	 */
+	QuantileVal();
+
+private:
+	TDigest digest;
+};
+
+} // namespace zeek::probabilistic::detail
@@ -122,7 +122,7 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 				newbucket->bucketPos = buckets.insert(buckets.begin(), newbucket);
 
 				olde->parent = newbucket;
-				newbucket->elements.insert(newbucket->elements.end(), olde);
+				olde->elementPos = newbucket->elements.insert(newbucket->elements.end(), olde);
 
 				elementDict->Insert(key, olde);
 				numElements++;
@@ -301,14 +301,14 @@ void TopkVal::Encountered(ValPtr encountered)
 				b->count = 1;
 				std::list<Bucket*>::iterator pos = buckets.insert(buckets.begin(), b);
 				b->bucketPos = pos;
-				b->elements.insert(b->elements.end(), e);
+				e->elementPos = b->elements.insert(b->elements.end(), e);
 				e->parent = b;
 				}
 			else
 				{
 				Bucket* b = *buckets.begin();
 				assert(b->count == 1);
-				b->elements.insert(b->elements.end(), e);
+				e->elementPos = b->elements.insert(b->elements.end(), e);
 				e->parent = b;
 				}
 
@@ -335,7 +335,7 @@ void TopkVal::Encountered(ValPtr encountered)
 
 			// and add the new one to the end
 			e->epsilon = b->count;
-			b->elements.insert(b->elements.end(), e);
+			e->elementPos = b->elements.insert(b->elements.end(), e);
 			elementDict->Insert(key, e);
 			e->parent = b;
 
@@ -382,16 +382,17 @@ void TopkVal::IncrementCounter(Element* e, unsigned int count)
 		nextBucket = b;
 		}
 
-	// ok, now we have the new bucket in nextBucket. Shift the element over...
-	currBucket->elements.remove(e);
-	nextBucket->elements.insert(nextBucket->elements.end(), e);
+	// ok, now we have the new bucket in nextBucket. Shift the element
+	// over. Splicing keeps elementPos valid and avoids searching through
+	// the current bucket, so that increments take constant time.
+	nextBucket->elements.splice(nextBucket->elements.end(), currBucket->elements, e->elementPos);
 
 	e->parent = nextBucket;
 
 	// if currBucket is empty, we have to delete it now
-	if ( currBucket->elements.size() == 0 )
+	if ( currBucket->elements.empty() )
 		{
-		buckets.remove(currBucket);
+		buckets.erase(currBucket->bucketPos);
 		delete currBucket;
 		currBucket = nullptr;
 		}
@@ -503,8 +504,7 @@ bool TopkVal::DoUnserialize(const broker::data& data)
 			e->epsilon = *epsilon;
 			e->value = std::move(val);
 			e->parent = b;
-
-			b->elements.insert(b->elements.end(), e);
+			e->elementPos = b->elements.insert(b->elements.end(), e);
 
 			zeek::detail::HashKey* key = GetHash(e->value);
 			assert (elementDict->Lookup(key) == nullptr);
@@ -29,6 +29,10 @@ struct Element {
 	uint64_t epsilon;
 	ValPtr value;
 	Bucket* parent;
+
+	// Our position in the parent's element list, so that moving us to
+	// another bucket doesn't need to search for us.
+	std::list<Element*>::iterator elementPos;
 };
 
 class TopkVal : public OpaqueVal {
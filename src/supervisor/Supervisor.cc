@@ -8,6 +8,7 @@
 #include <fcntl.h>
 #include <poll.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <csignal>
 #include <cstdarg>
@@ -1251,6 +1252,13 @@ Supervisor::NodeConfig Supervisor::NodeConfig::FromRecord(const RecordVal* node)
 	if ( affinity_val )
 		rval.cpu_affinity = affinity_val->AsInt();
 
+	auto affinity_set_val = node->GetField("cpu_affinity_set")->AsVectorVal();
+
+	for ( auto i = 0u; i < affinity_set_val->Size(); ++i )
+		rval.cpu_affinity_set.emplace_back(affinity_set_val->At(i)->AsInt());
+
+	rval.auto_cpu_affinity = node->GetField("auto_cpu_affinity")->AsBool();
+
 	auto scripts_val = node->GetField("scripts")->AsVectorVal();
 
 	for ( auto i = 0u; i < scripts_val->Size(); ++i )
@@ -1310,6 +1318,13 @@ Supervisor::NodeConfig Supervisor::NodeConfig::FromJSON(std::string_view json)
 	if ( auto it = j.FindMember("cpu_affinity"); it != j.MemberEnd() )
 		rval.cpu_affinity = it->value.GetInt();
 
+	if ( auto it = j.FindMember("cpu_affinity_set"); it != j.MemberEnd() )
+		for ( auto c = it->value.Begin(); c != it->value.End(); ++c )
+			rval.cpu_affinity_set.emplace_back(c->GetInt());
+
+	if ( auto it = j.FindMember("auto_cpu_affinity"); it != j.MemberEnd() )
+		rval.auto_cpu_affinity = it->value.GetBool();
+
 	auto& scripts = j["scripts"];
 
 	for ( auto it = scripts.Begin(); it != scripts.End(); ++it )
@@ -1366,6 +1381,15 @@ RecordValPtr Supervisor::NodeConfig::ToRecord() const
 	if ( cpu_affinity )
 		rval->Assign(rt->FieldOffset("cpu_affinity"), val_mgr->Int(*cpu_affinity));
 
+	auto at = rt->GetFieldType<VectorType>("cpu_affinity_set");
+	auto affinity_set_val = make_intrusive<VectorVal>(std::move(at));
+
+	for ( auto c : cpu_affinity_set )
+		affinity_set_val->Assign(affinity_set_val->Size(), val_mgr->Int(c));
+
+	rval->Assign(rt->FieldOffset("cpu_affinity_set"), std::move(affinity_set_val));
+	rval->Assign(rt->FieldOffset("auto_cpu_affinity"), val_mgr->Bool(auto_cpu_affinity));
+
 	auto st = rt->GetFieldType<VectorType>("scripts");
 	auto scripts_val = make_intrusive<VectorVal>(std::move(st));
 
@@ -1531,6 +1555,14 @@ void SupervisedNode::Init(Options* options) const
 		{
 		auto res = set_affinity(*config.cpu_affinity);
 
+		if ( ! res )
+			fprintf(stderr, "node '%s' failed to set CPU affinity: %s\n",
+			        node_name.data(), strerror(errno));
+		}
+	else if ( ! config.cpu_affinity_set.empty() )
+		{
+		auto res = set_affinity(config.cpu_affinity_set);
+
 		if ( ! res )
 			fprintf(stderr, "node '%s' failed to set CPU affinity: %s\n",
 			        node_name.data(), strerror(errno));
@@ -1617,12 +1649,59 @@ std::string Supervisor::Create(const Supervisor::NodeConfig& node)
 			                       node.directory->data());
 		}
 
-	auto msg = make_create_message(node);
+	auto config = node;
+
+	if ( config.auto_cpu_affinity && ! config.cpu_affinity &&
+	     config.cpu_affinity_set.empty() )
+		AssignCPUAffinity(&config);
+
+	auto msg = make_create_message(config);
 	util::safe_write(stem_pipe->OutFD(), msg.data(), msg.size() + 1);
-	nodes.emplace(node.name, node);
+	nodes.emplace(config.name, std::move(config));
 	return "";
 	}
 
+void Supervisor::AssignCPUAffinity(NodeConfig* config) const
+	{
+	// Number of nodes reading from an interface pinned to each core.
+	std::map<int, int> capture_cores;
+
+	for ( const auto& n : nodes )
+		if ( n.second.config.interface && n.second.config.cpu_affinity )
+			++capture_cores[*n.second.config.cpu_affinity];
+
+	if ( config->interface )
+		{
+		auto cpus = numa_node_cpus(interface_numa_node(*config->interface));
+
+		if ( cpus.empty() )
+			cpus = online_cpus();
+
+		if ( cpus.empty() )
+			return;
+
+		auto least_used = [&capture_cores](int a, int b)
+			{
+			auto ua = capture_cores.find(a);
+			auto ub = capture_cores.find(b);
+			return (ua == capture_cores.end() ? 0 : ua->second) <
+			       (ub == capture_cores.end() ? 0 : ub->second);
+			};
+
+		config->cpu_affinity = *std::min_element(cpus.begin(), cpus.end(), least_used);
+		DBG_LOG(DBG_SUPERVISOR, "node %s: assigned CPU %d for interface %s",
+		        config->name.data(), *config->cpu_affinity, config->interface->data());
+		return;
+		}
+
+	for ( auto c : online_cpus() )
+		if ( capture_cores.find(c) == capture_cores.end() )
+			config->cpu_affinity_set.emplace_back(c);
+
+	DBG_LOG(DBG_SUPERVISOR, "node %s: assigned %zu CPUs not used for capture",
+	        config->name.data(), config->cpu_affinity_set.size());
+	}
+
 bool Supervisor::Destroy(std::string_view node_name)
 	{
 	auto send_destroy_msg = [this](std::string_view name)
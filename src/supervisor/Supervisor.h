@@ -186,6 +186,16 @@ public:
 		 * A cpu/core number to which the node will try to pin itself.
 		 */
 		std::optional<int> cpu_affinity;
+		/**
+		 * A set of cpus/cores on which the node will try to keep itself,
+		 * if cpu_affinity isn't set.
+		 */
+		std::vector<int> cpu_affinity_set;
+		/**
+		 * Whether the Supervisor picks the node's cpu affinity, see
+		 * Supervisor::AssignCPUAffinity().
+		 */
+		bool auto_cpu_affinity = false;
 		/**
 		 * Additional script filename/paths that the node should load.
 		 */
@@ -308,6 +318,13 @@ private:
 
 	void ReapStem();
 
+	/**
+	 * Picks the cpu affinity for a node configured with auto_cpu_affinity,
+	 * based on the NUMA node local to its interface and the affinities of
+	 * the nodes created so far.
+	 */
+	void AssignCPUAffinity(NodeConfig* config) const;
+
 	const char* Tag() override
 		{ return "zeek::Supervisor"; }
 
@@ -0,0 +1,441 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "telemetry/Manager.h"
+
+#include <cinttypes>
+
+#include "Event.h"
+#include "ID.h"
+#include "Reassem.h"
+#include "Reporter.h"
+#include "RunState.h"
+#include "Sessions.h"
+#include "Timer.h"
+#include "Val.h"
+#include "broker/Manager.h"
+#include "iosource/Manager.h"
+#include "iosource/PktSrc.h"
+#include "logging/Manager.h"
+#include "telemetry/MetricsServer.h"
+#include "util.h"
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::telemetry {
+
+Histogram::Histogram(std::vector<double> arg_bounds)
+	: bounds(std::move(arg_bounds))
+	{
+	for ( auto& s : slots )
+		{
+		s.counts = std::make_unique<std::atomic<uint64_t>[]>(bounds.size() + 1);
+
+		for ( size_t i = 0; i <= bounds.size(); ++i )
+			s.counts[i] = 0;
+		}
+	}
+
+std::vector<uint64_t> Histogram::Counts() const
+	{
+	std::vector<uint64_t> counts(bounds.size() + 1);
+
+	for ( const auto& s : slots )
+		for ( size_t i = 0; i < counts.size(); ++i )
+			counts[i] += s.counts[i].load(std::memory_order_relaxed);
+
+	return counts;
+	}
+
+double Histogram::Sum() const
+	{
+	double sum = 0;
+
+	for ( const auto& s : slots )
+		sum += s.sum.load(std::memory_order_relaxed);
+
+	return sum;
+	}
+
+Manager::Manager()
+	{
+	AddBuiltinMetrics();
+	}
+
+Manager::~Manager()
+	{
+	}
+
+void Manager::InitPostScript()
+	{
+	auto port = id::find_val("Telemetry::metrics_port")->AsPortVal()->Port();
+
+	if ( ! port )
+		return;
+
+	auto addr = id::find_val("Telemetry::metrics_address")->AsAddr();
+	server = new detail::MetricsServer(addr, port);
+
+	if ( ! server->Start() )
+		{
+		delete server;
+		server = nullptr;
+		}
+	}
+
+Manager::Family* Manager::NewFamily(Type type, std::string name, std::string help)
+	{
+	auto f = std::make_unique<Family>();
+	f->type = type;
+	f->name = std::move(name);
+	f->help = std::move(help);
+	families.emplace_back(std::move(f));
+	return families.back().get();
+	}
+
+Counter* Manager::AddCounter(std::string name, std::string help)
+	{
+	auto f = NewFamily(Type::COUNTER, std::move(name), std::move(help));
+	f->counter = std::make_unique<Counter>();
+	return f->counter.get();
+	}
+
+Histogram* Manager::AddHistogram(std::string name, std::string help,
+                                 std::vector<double> bounds,
+                                 std::string labels)
+	{
+	Family* f = nullptr;
+
+	for ( const auto& existing : families )
+		if ( existing->type == Type::HISTOGRAM && existing->name == name )
+			{
+			f = existing.get();
+			break;
+			}
+
+	if ( ! f )
+		f = NewFamily(Type::HISTOGRAM, std::move(name), std::move(help));
+
+	f->histograms.emplace_back(std::move(labels),
+	                           std::make_unique<Histogram>(std::move(bounds)));
+	return f->histograms.back().second.get();
+	}
+
+void Manager::AddCollector(Type type, std::string name, std::string help,
+                           Collector collector)
+	{
+	auto f = NewFamily(type, std::move(name), std::move(help));
+	f->collector = std::move(collector);
+	}
+
+void Manager::AddCallback(Type type, std::string name, std::string help,
+                          std::function<double()> callback)
+	{
+	AddCollector(type, std::move(name), std::move(help),
+	             [callback = std::move(callback)](std::vector<Sample>* samples)
+	             { samples->emplace_back("", callback()); });
+	}
+
+// Formats a sample value, with integral values as such.
+static std::string format_value(double v)
+	{
+	if ( v == static_cast<double>(static_cast<int64_t>(v)) && v > -1e15 && v < 1e15 )
+		return util::fmt("%" PRId64, static_cast<int64_t>(v));
+
+	return util::fmt("%.9g", v);
+	}
+
+static void add_sample(std::string* out, const std::string& name,
+                       const std::string& labels, const std::string& value)
+	{
+	*out += name;
+
+	if ( ! labels.empty() )
+		{
+		*out += '{';
+		*out += labels;
+		*out += '}';
+		}
+
+	*out += ' ';
+	*out += value;
+	*out += '\n';
+	}
+
+std::string Manager::Collect() const
+	{
+	static const char* type_names[] = { "counter", "gauge", "histogram" };
+	std::string out;
+	std::vector<Sample> samples;
+
+	for ( const auto& f : families )
+		{
+		out += util::fmt("# TYPE %s %s\n", f->name.c_str(),
+		                 type_names[static_cast<int>(f->type)]);
+		out += util::fmt("# HELP %s %s\n", f->name.c_str(), f->help.c_str());
+
+		// Counter samples carry a suffix in OpenMetrics.
+		auto sample_name = f->type == Type::COUNTER ? f->name + "_total" : f->name;
+
+		if ( f->counter )
+			add_sample(&out, sample_name, "", format_value(f->counter->Value()));
+
+		else if ( f->type == Type::HISTOGRAM )
+			{
+			for ( const auto& h : f->histograms )
+				{
+				const auto& labels = h.first;
+				auto prefix = labels.empty() ? labels : labels + ",";
+				const auto& bounds = h.second->Bounds();
+				auto counts = h.second->Counts();
+				uint64_t cumulative = 0;
+
+				for ( size_t i = 0; i < counts.size(); ++i )
+					{
+					cumulative += counts[i];
+					auto le = i < bounds.size() ? format_value(bounds[i]) : "+Inf";
+					add_sample(&out, f->name + "_bucket", prefix + "le=\"" + le + "\"",
+					           format_value(cumulative));
+					}
+
+				add_sample(&out, f->name + "_sum", labels, format_value(h.second->Sum()));
+				add_sample(&out, f->name + "_count", labels, format_value(cumulative));
+				}
+			}
+
+		else
+			{
+			samples.clear();
+			f->collector(&samples);
+
+			for ( const auto& s : samples )
+				add_sample(&out, sample_name, s.first, format_value(s.second));
+			}
+		}
+
+	out += "# EOF\n";
+	return out;
+	}
+
+// Returns a label set with a single label, escaping its value.
+static std::string label(const char* name, const std::string& value)
+	{
+	std::string escaped;
+
+	for ( auto c : value )
+		{
+		if ( c == '\\' || c == '"' )
+			escaped += '\\';
+
+		if ( c == '\n' )
+			escaped += "\\n";
+		else
+			escaped += c;
+		}
+
+	return util::fmt("%s=\"%s\"", name, escaped.c_str());
+	}
+
+// The buckets of the latency histograms, from a few microseconds up to
+// the point where a worker should be shedding load.
+static const std::vector<double> latency_bounds = {
+	0.00001, 0.0001, 0.001, 0.01, 0.1, 1, 10
+};
+
+// The buckets of the per-source processing times, a main loop iteration
+// should take a tiny fraction of a second.
+static const std::vector<double> iosource_bounds = {
+	0.000001, 0.00001, 0.0001, 0.001, 0.01, 0.1, 1
+};
+
+void Manager::ObserveIOSource(const char* tag, double secs)
+	{
+	auto& h = iosource_times[tag];
+
+	if ( ! h )
+		h = AddHistogram("zeek_iosource_process_seconds",
+		                 "Time each IOSource took to process its input in a main loop iteration.",
+		                 iosource_bounds, label("source", tag));
+
+	h->Observe(secs);
+	}
+
+void Manager::AddBuiltinMetrics()
+	{
+	packets = AddCounter("zeek_packets", "Packets processed.");
+	packet_bytes = AddCounter("zeek_packet_bytes", "Bytes of the packets processed.");
+	packet_latency = AddHistogram("zeek_packet_latency_seconds",
+	                              "Time from capturing a live packet to processing it.",
+	                              latency_bounds);
+	event_latency = AddHistogram("zeek_event_latency_seconds",
+	                             "Time from capturing the current live packet to dispatching the events queued for it.",
+	                             latency_bounds);
+	log_writes = AddCounter("zeek_log_writes", "Log records written by scripts.");
+
+	AddCollector(Type::COUNTER, "zeek_packets_received",
+	             "Packets received, dropped and seen on the link according to the packet source.",
+	             [](std::vector<Sample>* samples)
+		{
+		auto ps = iosource_mgr ? iosource_mgr->GetPktSrc() : nullptr;
+
+		if ( ! ps || ! ps->IsOpen() )
+			return;
+
+		iosource::PktSrc::Stats s;
+		ps->Statistics(&s);
+		samples->emplace_back("kind=\"received\"", s.received);
+		samples->emplace_back("kind=\"dropped\"", s.dropped);
+		samples->emplace_back("kind=\"link\"", s.link);
+		});
+
+	AddCallback(Type::GAUGE, "zeek_network_time_lag_seconds",
+	            "How far network time trails the wall clock when reading live.",
+	            []
+		{
+		if ( ! run_state::reading_live || ! run_state::network_time )
+			return 0.0;
+
+		return util::current_time(true) - run_state::network_time;
+		});
+
+	AddCollector(Type::GAUGE, "zeek_connections", "Current connections by protocol.",
+	             [](std::vector<Sample>* samples)
+		{
+		if ( ! sessions )
+			return;
+
+		SessionStats s;
+		sessions->GetStats(s);
+		samples->emplace_back("proto=\"tcp\"", s.num_TCP_conns);
+		samples->emplace_back("proto=\"udp\"", s.num_UDP_conns);
+		samples->emplace_back("proto=\"icmp\"", s.num_ICMP_conns);
+		});
+
+	AddCollector(Type::GAUGE, "zeek_reassembly_memory_bytes",
+	             "Memory held by reassemblers, by kind.",
+	             [](std::vector<Sample>* samples)
+		{
+		samples->emplace_back("kind=\"tcp\"", Reassembler::MemoryAllocation(REASSEM_TCP));
+		samples->emplace_back("kind=\"frag\"", Reassembler::MemoryAllocation(REASSEM_FRAG));
+		samples->emplace_back("kind=\"file\"", Reassembler::MemoryAllocation(REASSEM_FILE));
+		});
+
+	AddCallback(Type::COUNTER, "zeek_events_dispatched", "Events dispatched.",
+	            [] { return event_mgr.num_events_dispatched; });
+
+	AddCallback(Type::GAUGE, "zeek_event_queue_depth", "Events queued for dispatch.",
+	            [] { return event_mgr.Size(); });
+
+	AddCallback(Type::GAUGE, "zeek_timers", "Timers pending.",
+	            [] { return zeek::detail::timer_mgr ? zeek::detail::timer_mgr->Size() : 0; });
+
+	AddCollector(Type::GAUGE, "zeek_log_pending_writes",
+	             "Log writes queued for each writer's thread but not yet written.",
+	             [](std::vector<Sample>* samples)
+		{
+		if ( ! log_mgr )
+			return;
+
+		for ( const auto& w : log_mgr->GetWriterStats() )
+			samples->emplace_back(label("writer", w.first), w.second.pending_writes);
+		});
+
+	AddCollector(Type::GAUGE, "zeek_log_latency_seconds",
+	             "Time from queueing each writer's last batch to having written it.",
+	             [](std::vector<Sample>* samples)
+		{
+		if ( ! log_mgr )
+			return;
+
+		for ( const auto& w : log_mgr->GetWriterStats() )
+			samples->emplace_back(label("writer", w.first), w.second.latency);
+		});
+
+	AddCollector(Type::COUNTER, "zeek_log_writes_dropped",
+	             "Log writes dropped because a writer's queue was full.",
+	             [](std::vector<Sample>* samples)
+		{
+		if ( ! log_mgr )
+			return;
+
+		for ( const auto& w : log_mgr->GetWriterStats() )
+			samples->emplace_back(label("writer", w.first), w.second.dropped);
+		});
+
+	AddCallback(Type::GAUGE, "zeek_broker_peers", "Broker peers connected.",
+	            [] { return broker_mgr ? broker_mgr->GetStatistics().num_peers : 0; });
+
+	AddCallback(Type::GAUGE, "zeek_broker_message_backlog",
+	            "Broker messages waiting for the main loop at its last check.",
+	            [] { return broker_mgr ? broker_mgr->GetStatistics().num_messages_backlog : 0; });
+
+	AddCallback(Type::GAUGE, "zeek_memory_bytes", "Memory used by the process.",
+	            []
+		{
+		uint64_t total;
+		util::get_memory_usage(&total, nullptr);
+		return static_cast<double>(total);
+		});
+	}
+
+TEST_CASE("telemetry counter")
+	{
+	Counter c;
+	c.Inc();
+	c.Inc(41);
+	CHECK(c.Value() == 42);
+	}
+
+TEST_CASE("telemetry histogram")
+	{
+	Histogram h({1, 10});
+	h.Observe(0.5);
+	h.Observe(1);
+	h.Observe(5);
+	h.Observe(100);
+
+	auto counts = h.Counts();
+	REQUIRE(counts.size() == 3);
+	CHECK(counts[0] == 2);
+	CHECK(counts[1] == 1);
+	CHECK(counts[2] == 1);
+	CHECK(h.Sum() == 106.5);
+	}
+
+TEST_CASE("telemetry openmetrics format")
+	{
+	Manager m;
+	m.AddCounter("test_requests", "Requests.")->Inc(3);
+	m.AddHistogram("test_latency_seconds", "Latency.", {0.5})->Observe(0.25);
+	m.AddCollector(Manager::Type::GAUGE, "test_queue", "Queue depth.",
+	               [](std::vector<Manager::Sample>* samples)
+		{ samples->emplace_back(label("name", "a\"b"), 7); });
+
+	auto out = m.Collect();
+	CHECK(out.find("# TYPE test_requests counter\n# HELP test_requests Requests.\n"
+	               "test_requests_total 3\n") != std::string::npos);
+	CHECK(out.find("test_latency_seconds_bucket{le=\"0.5\"} 1\n"
+	               "test_latency_seconds_bucket{le=\"+Inf\"} 1\n"
+	               "test_latency_seconds_sum 0.25\n"
+	               "test_latency_seconds_count 1\n") != std::string::npos);
+	CHECK(out.find("test_queue{name=\"a\\\"b\"} 7\n") != std::string::npos);
+	CHECK(out.size() >= 6);
+	CHECK(out.compare(out.size() - 6, 6, "# EOF\n") == 0);
+	}
+
+TEST_CASE("telemetry labeled histograms")
+	{
+	Manager m;
+	m.AddHistogram("test_seconds", "Time.", {1}, label("source", "a"))->Observe(0.5);
+	m.AddHistogram("test_seconds", "Other.", {1}, label("source", "b"))->Observe(2);
+
+	auto out = m.Collect();
+	CHECK(out.find("# TYPE test_seconds histogram\n# HELP test_seconds Time.\n"
+	               "test_seconds_bucket{source=\"a\",le=\"1\"} 1\n") != std::string::npos);
+	CHECK(out.find("test_seconds_bucket{source=\"b\",le=\"+Inf\"} 1\n"
+	               "test_seconds_sum{source=\"b\"} 2\n"
+	               "test_seconds_count{source=\"b\"} 1\n") != std::string::npos);
+	CHECK(out.find("HELP test_seconds Other.") == std::string::npos);
+	CHECK(out.compare(out.size() - 6, 6, "# EOF\n") == 0);
+	}
+
+} // namespace zeek::telemetry
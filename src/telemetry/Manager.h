@@ -0,0 +1,158 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// A registry of the core's own metrics, served in the OpenMetrics text
+// format without going through the script layer.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "telemetry/Metric.h"
+
+namespace zeek::telemetry::detail { class MetricsServer; }
+
+namespace zeek::telemetry {
+
+/**
+ * Singleton class for managing metrics. Metrics are registered from the
+ * main thread during initialization and may be updated from any thread
+ * after that.
+ */
+class Manager {
+public:
+	/**
+	 * A sample of a metric family computed at collection time: a label
+	 * set like "writer=\"conn\"", which may be empty, and a value.
+	 */
+	using Sample = std::pair<std::string, double>;
+	using Collector = std::function<void(std::vector<Sample>* samples)>;
+
+	enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+	/**
+	 * Constructor. Registers the core's built-in metrics.
+	 */
+	Manager();
+
+	/**
+	 * Destructor.
+	 */
+	~Manager();
+
+	/**
+	 * Called after scripts are parsed. Starts serving metrics if
+	 * Telemetry::metrics_port is set.
+	 */
+	void InitPostScript();
+
+	/**
+	 * Adds a counter that's incremented by the code observing it.
+	 *
+	 * @param name The metric's name, without a "_total" suffix.
+	 *
+	 * @param help A short description of the metric.
+	 *
+	 * @return The counter, which remains valid for the manager's
+	 * lifetime.
+	 */
+	Counter* AddCounter(std::string name, std::string help);
+
+	/**
+	 * Adds a histogram that's updated by the code observing it.
+	 *
+	 * @param name The metric's name.
+	 *
+	 * @param help A short description of the metric.
+	 *
+	 * @param bounds The upper bounds of the buckets, in ascending order.
+	 *
+	 * @param labels The histogram's label set, like "source=\"pcap\"".
+	 * Histograms with the same name but different labels go into the
+	 * same family, which takes the help of the first one.
+	 *
+	 * @return The histogram, which remains valid for the manager's
+	 * lifetime.
+	 */
+	Histogram* AddHistogram(std::string name, std::string help,
+	                        std::vector<double> bounds,
+	                        std::string labels = "");
+
+	/**
+	 * Adds a counter or gauge family whose samples are computed by a
+	 * callback whenever metrics get collected, for values that the
+	 * core tracks anyway. The callback runs on the main thread.
+	 *
+	 * @param type Either COUNTER or GAUGE.
+	 *
+	 * @param name The metric's name, without a "_total" suffix.
+	 *
+	 * @param help A short description of the metric.
+	 *
+	 * @param collector The callback adding the current samples.
+	 */
+	void AddCollector(Type type, std::string name, std::string help,
+	                  Collector collector);
+
+	/**
+	 * Convenience version of AddCollector() for a metric with a single
+	 * sample without labels.
+	 */
+	void AddCallback(Type type, std::string name, std::string help,
+	                 std::function<double()> callback);
+
+	/**
+	 * Returns all metrics in the OpenMetrics text format.
+	 */
+	std::string Collect() const;
+
+	/**
+	 * Records the time an IOSource took to process its input in one
+	 * main loop iteration.
+	 *
+	 * @param tag The source's tag.
+	 *
+	 * @param secs The time in seconds.
+	 */
+	void ObserveIOSource(const char* tag, double secs);
+
+	/**
+	 * The core's metrics updated on hot paths.
+	 */
+	Counter* packets = nullptr;
+	Counter* packet_bytes = nullptr;
+	Counter* events_dispatched = nullptr;
+	Counter* log_writes = nullptr;
+	Histogram* packet_latency = nullptr;
+	Histogram* event_latency = nullptr;
+
+private:
+	struct Family {
+		Type type;
+		std::string name;
+		std::string help;
+		std::unique_ptr<Counter> counter;
+		// Pairs of label set and histogram.
+		std::vector<std::pair<std::string, std::unique_ptr<Histogram>>> histograms;
+		Collector collector;
+	};
+
+	Family* NewFamily(Type type, std::string name, std::string help);
+	void AddBuiltinMetrics();
+
+	std::vector<std::unique_ptr<Family>> families;
+	std::unordered_map<std::string, Histogram*> iosource_times;
+	detail::MetricsServer* server = nullptr;	// Owned by the iosource manager.
+};
+
+} // namespace zeek::telemetry
+
+namespace zeek {
+
+extern telemetry::Manager* telemetry_mgr;
+
+} // namespace zeek
@@ -0,0 +1,112 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace zeek::telemetry {
+
+namespace detail {
+
+// The number of slots a metric spreads its updates across.
+constexpr size_t NUM_SLOTS = 16;
+
+/**
+ * Returns the slot of the calling thread. Threads get slots round-robin
+ * when they first update a metric.
+ */
+inline size_t thread_slot()
+	{
+	static std::atomic<size_t> next_slot{0};
+	thread_local size_t slot = next_slot++ % NUM_SLOTS;
+	return slot;
+	}
+
+// A value on a cache line of its own, so that threads updating different
+// slots don't contend.
+struct alignas(64) Slot {
+	std::atomic<uint64_t> value{0};
+};
+
+} // namespace detail
+
+/**
+ * A monotonically increasing count that's cheap to update from any
+ * thread. Each thread increments a slot of its own, and reading the
+ * count sums them up.
+ */
+class Counter {
+public:
+	void Inc(uint64_t n = 1)
+		{ slots[detail::thread_slot()].value.fetch_add(n, std::memory_order_relaxed); }
+
+	uint64_t Value() const
+		{
+		uint64_t sum = 0;
+
+		for ( const auto& s : slots )
+			sum += s.value.load(std::memory_order_relaxed);
+
+		return sum;
+		}
+
+private:
+	detail::Slot slots[detail::NUM_SLOTS];
+};
+
+/**
+ * A distribution of observed values over fixed buckets, updated per
+ * thread like a Counter.
+ */
+class Histogram {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param bounds The buckets' inclusive upper bounds, in ascending
+	 * order. Values above the last go into an implicit +Inf bucket.
+	 */
+	explicit Histogram(std::vector<double> bounds);
+
+	void Observe(double v)
+		{
+		auto bucket = std::lower_bound(bounds.begin(), bounds.end(), v) - bounds.begin();
+		auto& s = slots[detail::thread_slot()];
+		s.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+
+		// Only the slot's own thread writes the sum, except when
+		// threads share a slot.
+		auto sum = s.sum.load(std::memory_order_relaxed);
+		while ( ! s.sum.compare_exchange_weak(sum, sum + v, std::memory_order_relaxed) )
+			;
+		}
+
+	const std::vector<double>& Bounds() const	{ return bounds; }
+
+	/**
+	 * Returns the number of observations per bucket, not cumulative,
+	 * with the +Inf bucket last.
+	 */
+	std::vector<uint64_t> Counts() const;
+
+	/**
+	 * Returns the sum of all observed values.
+	 */
+	double Sum() const;
+
+private:
+	struct alignas(64) HistogramSlot {
+		std::unique_ptr<std::atomic<uint64_t>[]> counts;
+		std::atomic<double> sum{0};
+	};
+
+	std::vector<double> bounds;
+	HistogramSlot slots[detail::NUM_SLOTS];
+};
+
+} // namespace zeek::telemetry
@@ -0,0 +1,240 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "telemetry/MetricsServer.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Reporter.h"
+#include "iosource/Manager.h"
+#include "telemetry/Manager.h"
+#include "util.h"
+
+namespace zeek::telemetry::detail {
+
+// Clients taking longer than this to send their request or to receive
+// the response get disconnected.
+static constexpr double CLIENT_TIMEOUT = 5.0;
+
+// Longest request accepted.
+static constexpr size_t MAX_REQUEST_SIZE = 8192;
+
+static bool set_nonblocking(int fd)
+	{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) >= 0;
+	}
+
+MetricsServer::MetricsServer(const IPAddr& arg_addr, uint16_t arg_port)
+	: addr(arg_addr), port(arg_port)
+	{
+	}
+
+MetricsServer::~MetricsServer()
+	{
+	for ( auto& c : clients )
+		close(c.fd);
+
+	if ( listen_fd >= 0 )
+		close(listen_fd);
+	}
+
+bool MetricsServer::Start()
+	{
+	struct sockaddr_storage ss;
+	socklen_t len;
+	memset(&ss, 0, sizeof(ss));
+
+	if ( addr.GetFamily() == IPv4 )
+		{
+		auto sa = reinterpret_cast<sockaddr_in*>(&ss);
+		sa->sin_family = AF_INET;
+		sa->sin_port = htons(port);
+		addr.CopyIPv4(&sa->sin_addr);
+		len = sizeof(*sa);
+		}
+	else
+		{
+		auto sa = reinterpret_cast<sockaddr_in6*>(&ss);
+		sa->sin6_family = AF_INET6;
+		sa->sin6_port = htons(port);
+		addr.CopyIPv6(&sa->sin6_addr);
+		len = sizeof(*sa);
+		}
+
+	listen_fd = socket(ss.ss_family, SOCK_STREAM, 0);
+
+	if ( listen_fd < 0 )
+		{
+		reporter->Error("cannot create metrics socket: %s", strerror(errno));
+		return false;
+		}
+
+	int on = 1;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	if ( bind(listen_fd, reinterpret_cast<sockaddr*>(&ss), len) < 0 ||
+	     listen(listen_fd, 16) < 0 || ! set_nonblocking(listen_fd) )
+		{
+		reporter->Error("cannot serve metrics on %s:%u: %s",
+		                addr.AsURIString().c_str(), port, strerror(errno));
+		close(listen_fd);
+		listen_fd = -1;
+		return false;
+		}
+
+	iosource_mgr->Register(this, true);
+
+	if ( ! iosource_mgr->RegisterFd(listen_fd, this) )
+		{
+		reporter->Error("failed to register metrics socket with iosource_mgr");
+		return false;
+		}
+
+	reporter->Info("serving metrics on %s:%u", addr.AsURIString().c_str(), port);
+	return true;
+	}
+
+double MetricsServer::GetNextTimeout()
+	{
+	// Responses too large for the socket's buffer go out bit by bit,
+	// and clients need to time out.
+	for ( const auto& c : clients )
+		if ( ! c.response.empty() )
+			return 0;
+
+	return clients.empty() ? -1 : CLIENT_TIMEOUT;
+	}
+
+void MetricsServer::Process()
+	{
+	Accept();
+
+	double now = util::current_time(true);
+
+	for ( auto it = clients.begin(); it != clients.end(); )
+		{
+		bool keep = it->response.empty() ? Read(&*it) : true;
+
+		if ( keep && ! it->response.empty() )
+			keep = Write(&*it);
+
+		if ( keep && now - it->start > CLIENT_TIMEOUT )
+			keep = false;
+
+		if ( keep )
+			++it;
+		else
+			{
+			CloseClient(&*it);
+			it = clients.erase(it);
+			}
+		}
+	}
+
+void MetricsServer::Accept()
+	{
+	while ( true )
+		{
+		int fd = accept(listen_fd, nullptr, nullptr);
+
+		if ( fd < 0 )
+			break;
+
+		if ( ! set_nonblocking(fd) || ! iosource_mgr->RegisterFd(fd, this) )
+			{
+			close(fd);
+			continue;
+			}
+
+		clients.push_back({fd, util::current_time(true)});
+		}
+	}
+
+bool MetricsServer::Read(Client* c)
+	{
+	char buf[1024];
+
+	while ( true )
+		{
+		auto n = read(c->fd, buf, sizeof(buf));
+
+		if ( n == 0 )
+			return false;
+
+		if ( n < 0 )
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+		c->request.append(buf, n);
+
+		if ( c->request.size() > MAX_REQUEST_SIZE )
+			return false;
+
+		if ( c->request.find("\r\n\r\n") != std::string::npos ||
+		     c->request.find("\n\n") != std::string::npos )
+			{
+			c->response = Respond(c->request);
+			return true;
+			}
+		}
+	}
+
+bool MetricsServer::Write(Client* c)
+	{
+	while ( c->sent < c->response.size() )
+		{
+		auto n = write(c->fd, c->response.data() + c->sent,
+		               c->response.size() - c->sent);
+
+		if ( n < 0 )
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+		c->sent += n;
+		}
+
+	return false;
+	}
+
+std::string MetricsServer::Respond(const std::string& request) const
+	{
+	const char* status = "200 OK";
+	const char* type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+	std::string body;
+
+	auto line_end = request.find_first_of("\r\n");
+	std::string line = request.substr(0, line_end);
+
+	if ( line.compare(0, 4, "GET ") != 0 )
+		{
+		status = "405 Method Not Allowed";
+		type = "text/plain";
+		body = "only GET is supported\n";
+		}
+
+	else if ( line.compare(4, 9, "/metrics ") != 0 &&
+	          line.compare(4, 9, "/metrics?") != 0 &&
+	          line != "GET /metrics" )
+		{
+		status = "404 Not Found";
+		type = "text/plain";
+		body = "metrics are at /metrics\n";
+		}
+
+	else
+		body = telemetry_mgr->Collect();
+
+	return util::fmt("HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+	                 "Connection: close\r\n\r\n", status, type, body.size()) + body;
+	}
+
+void MetricsServer::CloseClient(Client* c)
+	{
+	iosource_mgr->UnregisterFd(c->fd, this);
+	close(c->fd);
+	}
+
+} // namespace zeek::telemetry::detail
@@ -0,0 +1,64 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "IPAddr.h"
+#include "iosource/IOSource.h"
+
+namespace zeek::telemetry::detail {
+
+/**
+ * A minimal HTTP server answering GET /metrics with the telemetry
+ * manager's metrics. It runs inside the main loop as an I/O source and
+ * never blocks, handling each request in one go once it's complete.
+ */
+class MetricsServer final : public iosource::IOSource {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param addr The address to listen on.
+	 *
+	 * @param port The TCP port to listen on.
+	 */
+	MetricsServer(const IPAddr& addr, uint16_t port);
+
+	~MetricsServer() override;
+
+	/**
+	 * Starts listening and registers with the iosource manager.
+	 *
+	 * @return False if the socket couldn't be set up, after reporting
+	 * an error.
+	 */
+	bool Start();
+
+	double GetNextTimeout() override;
+	void Process() override;
+	const char* Tag() override	{ return "MetricsServer"; }
+
+private:
+	struct Client {
+		int fd;
+		double start;	// When accepted, for timing out.
+		std::string request;
+		std::string response;
+		size_t sent = 0;
+	};
+
+	void Accept();
+	bool Read(Client* c);	// Returns false once done with the client.
+	bool Write(Client* c);	// Same.
+	std::string Respond(const std::string& request) const;
+	void CloseClient(Client* c);
+
+	IPAddr addr;
+	uint16_t port;
+	int listen_fd = -1;
+	std::vector<Client> clients;
+};
+
+} // namespace zeek::telemetry::detail
@@ -16,6 +16,7 @@ uint64_t BasicThread::thread_counter = 0;
 BasicThread::BasicThread()
 	{
 	started = false;
+	external = false;
 	terminating = false;
 	killed = false;
 
@@ -46,6 +47,9 @@ void BasicThread::SetName(const char* arg_name)
 
 void BasicThread::SetOSName(const char* arg_name)
 	{
+	if ( external )
+		return;
+
 	static_assert(std::is_same<std::thread::native_handle_type, pthread_t>::value, "libstdc++ doesn't use pthread_t");
 	util::detail::set_thread_name(arg_name, thread.native_handle());
 	}
@@ -94,9 +98,12 @@ void BasicThread::Start()
 
 	started = true;
 
-	thread = std::thread(&BasicThread::launcher, this);
+	if ( OnStartExternally() )
+		external = true;
+	else
+		thread = std::thread(&BasicThread::launcher, this);
 
-	DBG_LOG(DBG_THREADING, "Started thread %s", name);
+	DBG_LOG(DBG_THREADING, "Started thread %s%s", name, external ? " externally" : "");
 
 	OnStart();
 	}
@@ -131,18 +138,27 @@ void BasicThread::Join()
 	if ( ! started )
 		return;
 
-	if ( ! thread.joinable() )
-		return;
-
-	assert(terminating);
-
-	try
+	if ( external )
 		{
-		thread.join();
+		assert(terminating);
+		OnJoin();
 		}
-	catch ( const std::system_error& e )
+
+	else
 		{
-		reporter->FatalError("Failure joining thread %s with error %s", name, e.what());
+		if ( ! thread.joinable() )
+			return;
+
+		assert(terminating);
+
+		try
+			{
+			thread.join();
+			}
+		catch ( const std::system_error& e )
+			{
+			reporter->FatalError("Failure joining thread %s with error %s", name, e.what());
+			}
 		}
 
 	DBG_LOG(DBG_THREADING, "Joined with thread %s", name);
@@ -166,13 +182,9 @@ void BasicThread::Done()
 	killed = true;
 	}
 
-void* BasicThread::launcher(void *arg)
+void BasicThread::BlockSignals()
 	{
-	static_assert(std::is_same<std::thread::native_handle_type, pthread_t>::value, "libstdc++ doesn't use pthread_t");
-	BasicThread* thread = (BasicThread *)arg;
-
-	// Block signals in thread. We handle signals only in the main
-	// process.
+	// We handle signals only in the main process.
 	sigset_t mask_set;
 	sigfillset(&mask_set);
 
@@ -185,6 +197,15 @@ void* BasicThread::launcher(void *arg)
 	sigdelset(&mask_set, SIGBUS);
 	int res = pthread_sigmask(SIG_BLOCK, &mask_set, 0);
 	assert(res == 0);
+	}
+
+void* BasicThread::launcher(void *arg)
+	{
+	static_assert(std::is_same<std::thread::native_handle_type, pthread_t>::value, "libstdc++ doesn't use pthread_t");
+	BasicThread* thread = (BasicThread *)arg;
+
+	// Block signals in thread.
+	BlockSignals();
 
 	// Run thread's main function.
 	thread->Run();
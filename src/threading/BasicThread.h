@@ -57,7 +57,8 @@ public:
 
 	/**
 	 * Set the name shown by the OS as the thread's description. Not
-	 * supported on all OSs.
+	 * supported on all OSs, and ignored for threads not running in an OS
+	 * thread of their own.
 	 *
 	 * Must be called only from the child thread.
 	 */
@@ -128,6 +129,12 @@ public:
 	 */
 	const char* Strerror(int err);
 
+	/**
+	 * Blocks the signals that Zeek handles in its main thread only. This
+	 * is called at the start of each child thread.
+	 */
+	static void BlockSignals();
+
 protected:
 	friend class Manager;
 
@@ -167,6 +174,22 @@ protected:
 	 */
 	virtual void OnKill()	{}
 
+	/**
+	 * Executed with Start() before spawning the OS thread. This is a hook
+	 * for running the thread's work elsewhere instead, such as on a
+	 * thread pool. If it returns true, Start() doesn't spawn a thread,
+	 * leaving it to the derived class to arrange for calling Done() once
+	 * finished.
+	 */
+	virtual bool OnStartExternally()	{ return false; }
+
+	/**
+	 * Executed with Join() if OnStartExternally() returned true. It must
+	 * only return once the thread's work has finished for good. The
+	 * method will be called from Bro's main thread.
+	 */
+	virtual void OnJoin()	{}
+
 	/**
 	 * Destructor. This will be called by the manager.
 	 *
@@ -200,6 +223,7 @@ private:
 	const char* name;
 	std::thread thread;
 	bool started; 		// Set to to true once running.
+	bool external;		// True if started without an OS thread of its own.
 	bool terminating;	// Set to to true to signal termination.
 	bool killed;	// Set to true once forcefully killed.
 
@@ -1,5 +1,6 @@
 #include "Manager.h"
 
+#include <algorithm>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -63,6 +64,16 @@ void Manager::Terminate()
 
 	all_threads.clear();
 	msg_threads.clear();
+
+	// All are done with it now.
+	pool.reset();
+
+	if ( flare_registered )
+		{
+		iosource_mgr->UnregisterFd(flare.FD(), this);
+		flare_registered = false;
+		}
+
 	terminating = false;
 	}
 
@@ -79,6 +90,73 @@ void Manager::AddMsgThread(MsgThread* thread)
 	{
 	DBG_LOG(DBG_THREADING, "%s is a MsgThread ...", thread->Name());
 	msg_threads.push_back(thread);
+
+	// We get created before the I/O source manager, so register our
+	// flare once there's a use for it.
+	if ( ! flare_registered )
+		{
+		if ( ! iosource_mgr->RegisterFd(flare.FD(), this) )
+			reporter->FatalError("Failed to register threading fd with iosource_mgr");
+
+		flare_registered = true;
+		}
+	}
+
+void Manager::OutputPending(MsgThread* thread)
+	{
+	bool was_empty;
+
+	{
+	std::lock_guard<std::mutex> lock(pending_mutex);
+	was_empty = pending_output.empty();
+	pending_output.push_back(thread);
+	}
+
+	// One wakeup covers all threads scheduled until Process() runs.
+	if ( was_empty )
+		flare.Fire();
+	}
+
+void Manager::RemovePendingOutput(MsgThread* thread)
+	{
+	std::lock_guard<std::mutex> lock(pending_mutex);
+	pending_output.erase(std::remove(pending_output.begin(), pending_output.end(), thread),
+	                     pending_output.end());
+
+	// Process() skips these.
+	std::replace(processing.begin(), processing.end(), thread, static_cast<MsgThread*>(nullptr));
+	}
+
+detail::ThreadPool* Manager::Pool()
+	{
+	if ( ! pool )
+		{
+		pool = std::make_unique<detail::ThreadPool>(BifConst::Threading::pool_size);
+		DBG_LOG(DBG_THREADING, "Started thread pool with %zu threads", pool->Size());
+		}
+
+	return pool.get();
+	}
+
+void Manager::Process()
+	{
+	flare.Extinguish();
+
+	{
+	std::lock_guard<std::mutex> lock(pending_mutex);
+	processing.swap(pending_output);
+	}
+
+	// Threads may get deleted while processing messages, so go by
+	// index and re-check every entry.
+	for ( size_t i = 0; i < processing.size(); i++ )
+		{
+		if ( auto t = processing[i] )
+			t->Process();
+		}
+
+	std::lock_guard<std::mutex> lock(pending_mutex);
+	processing.clear();
 	}
 
 void Manager::KillThreads()
@@ -2,10 +2,16 @@
 #pragma once
 
 #include "MsgThread.h"
+#include "ThreadPool.h"
 #include "Timer.h"
+#include "Flare.h"
+#include "iosource/IOSource.h"
 
 #include <list>
+#include <memory>
+#include <mutex>
 #include <utility>
+#include <vector>
 
 namespace zeek {
 namespace threading {
@@ -31,11 +37,13 @@ protected:
  * once it has terminated.
  *
  * In addition to basic threads, the manager also provides additional
- * functionality specific to MsgThread instances. In particular, it polls
- * their outgoing message queue on a regular basis and feeds data sent into
- * the rest of Bro. It also triggers the regular heartbeats.
+ * functionality specific to MsgThread instances. In particular, it feeds
+ * the messages they send into the rest of Bro, waking up the main loop
+ * through a single file descriptor whenever some thread has output for
+ * it. It also triggers the regular heartbeats, and owns the thread pool
+ * that message threads may run on instead of OS threads of their own.
  */
-class Manager
+class Manager : public iosource::IOSource
 {
 public:
 	/**
@@ -104,6 +112,14 @@ public:
 	 */
 	bool SendEvent(MsgThread* thread, const std::string& name, const int num_vals, Value* *vals) const;
 
+	/**
+	 * Overridden from iosource::IOSource. Processes the output of the
+	 * threads that have some pending.
+	 */
+	void Process() override;
+	const char* Tag() override	{ return "threading::Manager"; }
+	double GetNextTimeout() override	{ return -1; }
+
 protected:
 	friend class BasicThread;
 	friend class MsgThread;
@@ -127,6 +143,30 @@ protected:
 	 */
 	void AddMsgThread(MsgThread* thread);
 
+	/**
+	 * Schedules a message thread's Process() for the main thread to
+	 * call. Called by the thread when it queues output while not
+	 * scheduled already.
+	 *
+	 * @param thread The thread.
+	 */
+	void OutputPending(MsgThread* thread);
+
+	/**
+	 * Unschedules a message thread that's going away. Called by its
+	 * destructor.
+	 *
+	 * @param thread The thread.
+	 */
+	void RemovePendingOutput(MsgThread* thread);
+
+	/**
+	 * Returns the thread pool that message threads run on if
+	 * :zeek:see:`Threading::use_thread_pool` is set, starting it on
+	 * first use.
+	 */
+	detail::ThreadPool* Pool();
+
 	void Flush();
 
 	/**
@@ -153,6 +193,16 @@ private:
 	msg_stats_list stats;
 
 	bool heartbeat_timer_running = false;
+
+	// Threads with output for the main thread, and the ones being
+	// processed in Process() right now.
+	std::mutex pending_mutex;
+	std::vector<MsgThread*> pending_output;
+	std::vector<MsgThread*> processing;
+	zeek::detail::Flare flare;
+	bool flare_registered = false;
+
+	std::unique_ptr<detail::ThreadPool> pool;
 };
 
 } // namespace threading
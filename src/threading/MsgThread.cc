@@ -2,12 +2,17 @@
 #include <signal.h>
 #include <fcntl.h>
 
+#include <thread>
+
 #include "DebugLogger.h"
 
 #include "MsgThread.h"
 #include "Manager.h"
-#include "iosource/Manager.h"
 #include "RunState.h"
+#include "NetVar.h"
+#include "ThreadPool.h"
+
+#include "3rdparty/doctest.h"
 
 // Set by Zeek's main signal handler.
 extern int signal_val;
@@ -200,26 +205,25 @@ Message::~Message()
 	delete [] name;
 	}
 
-MsgThread::MsgThread() : BasicThread(), queue_in(this, nullptr), queue_out(nullptr, this)
+MsgThread::MsgThread()
+	: BasicThread(), queue_in(this, nullptr), queue_out(nullptr, this), output_pending(false),
+	  scheduled(false), task_finished(false)
 	{
 	cnt_sent_in = cnt_sent_out = 0;
 	main_finished = false;
 	child_finished = false;
 	child_sent_finish = false;
 	failed = false;
+	pooled = BifConst::Threading::use_thread_pool;
 	thread_mgr->AddMsgThread(this);
 
-	if ( ! iosource_mgr->RegisterFd(flare.FD(), this) )
-		reporter->FatalError("Failed to register MsgThread fd with iosource_mgr");
-
 	SetClosed(false);
 	}
 
 MsgThread::~MsgThread()
 	{
-	// Unregister this thread from the iosource manager so it doesn't wake
-	// up the main poll anymore.
-	iosource_mgr->UnregisterFd(flare.FD(), this);
+	// Make sure the thread manager doesn't try to process us anymore.
+	thread_mgr->RemovePendingOutput(this);
 	}
 
 void MsgThread::OnSignalStop()
@@ -296,6 +300,34 @@ void MsgThread::OnKill()
 	// input. This is just an optimization to make it terminate more
 	// quickly, even without the message it will eventually time out.
 	queue_in.WakeUp();
+
+	// On the pool, we need to run to notice.
+	if ( pool )
+		Schedule();
+	}
+
+bool MsgThread::OnStartExternally()
+	{
+	if ( ! pooled )
+		return false;
+
+	pool = thread_mgr->Pool();
+
+	// Get to what's been queued before starting.
+	Schedule();
+	return true;
+	}
+
+void MsgThread::OnJoin()
+	{
+	while ( ! task_finished.load() )
+		usleep(1000);
+	}
+
+void MsgThread::Schedule()
+	{
+	if ( ! scheduled.exchange(true) )
+		pool->Schedule([this]() { RunTask(); });
 	}
 
 void MsgThread::Heartbeat()
@@ -370,6 +402,9 @@ void MsgThread::SendIn(BasicInputMessage* msg, bool force)
 
 	queue_in.Put(msg);
 	++cnt_sent_in;
+
+	if ( pool )
+		Schedule();
 	}
 
 
@@ -385,7 +420,10 @@ void MsgThread::SendOut(BasicOutputMessage* msg, bool force)
 
 	++cnt_sent_out;
 
-	flare.Fire();
+	// Scheduling us once suffices until the main thread starts
+	// processing, see Process().
+	if ( ! output_pending.exchange(true) )
+		thread_mgr->OutputPending(this);
 	}
 
 void MsgThread::SendEvent(const char* name, const int num_vals, Value* *vals)
@@ -425,24 +463,8 @@ void MsgThread::Run()
 		{
 		BasicInputMessage* msg = RetrieveIn();
 
-		if ( ! msg )
-			continue;
-
-		bool result = msg->Process();
-
-		delete msg;
-
-		if ( ! result )
-			{
-			Error("terminating thread");
-
-			// This will eventually kill this thread, but only
-			// after all other outgoing messages (in particular
-			// error messages have been processed by then main
-			// thread).
-			SendOut(new detail::KillMeMessage(this));
-			failed = true;
-			}
+		if ( msg )
+			ProcessIn(msg);
 		}
 
 	// In case we haven't sent the finish method yet, do it now. Reading
@@ -455,6 +477,79 @@ void MsgThread::Run()
 		}
 	}
 
+void MsgThread::ProcessIn(BasicInputMessage* msg)
+	{
+	bool result = msg->Process();
+
+	delete msg;
+
+	if ( ! result )
+		{
+		Error("terminating thread");
+
+		// This will eventually kill this thread, but only
+		// after all other outgoing messages (in particular
+		// error messages have been processed by then main
+		// thread).
+		SendOut(new detail::KillMeMessage(this));
+		failed = true;
+		}
+	}
+
+void MsgThread::RunTask()
+	{
+	BasicInputMessage* msgs[PROCESS_BATCH_SIZE];
+	size_t n = 0;
+
+	if ( ! (child_finished || Killed()) )
+		n = queue_in.GetBatch(msgs, PROCESS_BATCH_SIZE);
+
+	for ( size_t i = 0; i < n; i++ )
+		{
+		// A thread of its own would leave these in the queue.
+		if ( child_finished || Killed() )
+			{
+			delete msgs[i];
+			continue;
+			}
+
+#ifdef DEBUG
+		std::string s = Fmt("Retrieved '%s' in %s",  msgs[i]->Name(), Name());
+		Debug(DBG_THREADING, s.c_str());
+#endif
+
+		ProcessIn(msgs[i]);
+		}
+
+	if ( child_finished || Killed() )
+		{
+		BasicThread::Done();
+
+		// From here on, the main thread may delete us, see OnJoin().
+		// Staying scheduled, we don't get to run again.
+		task_finished.store(true);
+		return;
+		}
+
+	if ( ! queue_in.Ready() )
+		{
+		scheduled.store(false);
+
+		// Pairs with the fence in Queue::Put() and the exchange in
+		// Schedule(), so that either the main thread schedules us for
+		// input queued from now on, or we see it here. Only the
+		// counters are safe to look at now that another task may be
+		// running already.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if ( ! (queue_in.MaybeReady() || Killed()) || scheduled.exchange(true) )
+			return;
+		}
+
+	// More to do, after giving the other tasks a turn.
+	pool->Schedule([this]() { RunTask(); });
+	}
+
 void MsgThread::GetStats(Stats* stats)
 	{
 	stats->sent_in = cnt_sent_in;
@@ -467,21 +562,74 @@ void MsgThread::GetStats(Stats* stats)
 
 void MsgThread::Process()
 	{
-	flare.Extinguish();
+	// Reset before looking at the queue, so that anything queued from
+	// then on schedules us again.
+	output_pending.exchange(false);
 
-	while ( HasOut() )
-		{
-		Message* msg = RetrieveOut();
-		assert(msg);
+	BasicOutputMessage* msgs[PROCESS_BATCH_SIZE];
+	size_t n;
 
-		if ( ! msg->Process() )
+	while ( (n = queue_out.GetBatch(msgs, PROCESS_BATCH_SIZE)) > 0 )
+		{
+		for ( size_t i = 0; i < n; i++ )
 			{
-			reporter->Error("%s failed, terminating thread", msg->Name());
-			SignalStop();
-			}
+			Message* msg = msgs[i];
 
-		delete msg;
+			DBG_LOG(DBG_THREADING, "Retrieved '%s' from %s",  msg->Name(), Name());
+
+			if ( ! msg->Process() )
+				{
+				reporter->Error("%s failed, terminating thread", msg->Name());
+				SignalStop();
+				}
+
+			delete msg;
+			}
 		}
 	}
 
+TEST_CASE("threading queue")
+	{
+	// A small ring forces messages through the overflow queue as well.
+	Queue<int*> q(nullptr, nullptr, 4);
+	int items[1000];
+	int* batch[16];
+
+	CHECK_FALSE(q.Ready());
+	CHECK(q.GetBatch(batch, 16) == 0);
+
+	for ( int i = 0; i < 10; i++ )
+		q.Put(&items[i]);
+
+	CHECK(q.Ready());
+	CHECK(q.Size() == 10);
+	CHECK(q.Get() == &items[0]);
+	CHECK(q.GetBatch(batch, 16) == 9);
+
+	for ( int i = 0; i < 9; i++ )
+		CHECK(batch[i] == &items[i + 1]);
+
+	Queue<int*>::Stats stats;
+	q.GetStats(&stats);
+	CHECK(stats.num_reads == 10);
+	CHECK(stats.num_writes == 10);
+	CHECK(stats.num_overflows == 6);
+
+	// Order holds with the writer in another thread.
+	std::thread writer([&]()
+		{
+		for ( auto& i : items )
+			q.Put(&i);
+		});
+
+	bool in_order = true;
+
+	for ( auto& i : items )
+		in_order = in_order && q.Get() == &i;
+
+	writer.join();
+	CHECK(in_order);
+	CHECK(q.Size() == 0);
+	}
+
 } // namespace zeek::threading
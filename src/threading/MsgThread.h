@@ -1,12 +1,13 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "DebugLogger.h"
 
 #include "BasicThread.h"
 #include "Queue.h"
 #include "iosource/IOSource.h"
-#include "Flare.h"
 
 namespace zeek::threading {
 	struct Value;
@@ -29,6 +30,7 @@ class HeartbeatMessage;
 class FinishMessage;
 class FinishedMessage;
 class KillMeMessage;
+class ThreadPool;
 
 }
 
@@ -278,6 +280,8 @@ protected:
 	void OnWaitForStop() override;
 	void OnSignalStop() override;
 	void OnKill() override;
+	bool OnStartExternally() override;
+	void OnJoin() override;
 
 private:
 	/**
@@ -341,6 +345,25 @@ private:
 	 */
 	void Finished();
 
+	/**
+	 * Processes a message from the main thread and deletes it. Called
+	 * from child.
+	 */
+	void ProcessIn(BasicInputMessage* msg);
+
+	/**
+	 * Schedules RunTask() on the thread pool, unless already scheduled.
+	 * Only for threads running on the pool.
+	 */
+	void Schedule();
+
+	/**
+	 * Processes the next batch of input when running on the thread
+	 * pool, scheduling itself again if there's more. This is what Run()
+	 * does for threads of their own.
+	 */
+	void RunTask();
+
 	Queue<BasicInputMessage *> queue_in;
 	Queue<BasicOutputMessage *> queue_out;
 
@@ -352,7 +375,19 @@ private:
 	bool child_sent_finish; // Child thread asked to be finished.
 	bool failed;	// Set to true when a command failed.
 
-	zeek::detail::Flare flare;
+	// True while the thread manager has us scheduled for Process().
+	std::atomic<bool> output_pending;
+
+	// For running on the thread pool instead of a thread of our own. A
+	// task is scheduled only while we aren't already, so that we never
+	// run twice at the same time.
+	bool pooled;	// Set if configured to run on the pool.
+	detail::ThreadPool* pool = nullptr;	// Set once started on the pool.
+	std::atomic<bool> scheduled;	// True while a task is queued or running.
+	std::atomic<bool> task_finished;	// Set once the last task is done with us.
+
+	// Number of messages Process() retrieves from the queue at once.
+	static constexpr size_t PROCESS_BATCH_SIZE = 64;
 };
 
 /**
@@ -0,0 +1,548 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "PackedValues.h"
+
+#include <string.h>
+
+#include "Reporter.h"
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::threading {
+
+// Identifies the encoding, with the last byte being its version.
+static const char MAGIC[] = { 'Z', 'P', 'V', 1 };
+static const size_t HEADER_SIZE = sizeof(MAGIC);
+
+// An entry's size and number of values.
+static const size_t ENTRY_HEADER_SIZE = 8;
+
+// A value's slot: type, subtype, presence, and two bytes of details
+// (port protocol, address family, subnet length), then 16 bytes of
+// payload at PAYLOAD. Strings and containers store the offset of their
+// data relative to the entry, followed by its length.
+static const size_t SLOT_SIZE = 24;
+static const size_t PAYLOAD = 8;
+
+static void put32(unsigned char* p, uint32_t v)
+	{
+	for ( int i = 0; i < 4; i++ )
+		p[i] = v >> (8 * i);
+	}
+
+static void put64(unsigned char* p, uint64_t v)
+	{
+	for ( int i = 0; i < 8; i++ )
+		p[i] = v >> (8 * i);
+	}
+
+static uint32_t get32(const unsigned char* p)
+	{
+	uint32_t v = 0;
+
+	for ( int i = 0; i < 4; i++ )
+		v |= uint32_t(p[i]) << (8 * i);
+
+	return v;
+	}
+
+static uint64_t get64(const unsigned char* p)
+	{
+	uint64_t v = 0;
+
+	for ( int i = 0; i < 8; i++ )
+		v |= uint64_t(p[i]) << (8 * i);
+
+	return v;
+	}
+
+PackedValues::PackedValues()
+	{
+	data.assign(MAGIC, HEADER_SIZE);
+	}
+
+void PackedValues::Clear()
+	{
+	data.assign(MAGIC, HEADER_SIZE);
+	entries.clear();
+	}
+
+void PackedValues::Append(const Value* const* vals, int num_vals)
+	{
+	size_t entry = data.size();
+	data.resize(entry + ENTRY_HEADER_SIZE + num_vals * SLOT_SIZE);
+
+	for ( int i = 0; i < num_vals; i++ )
+		PackValue(entry, entry + ENTRY_HEADER_SIZE + i * SLOT_SIZE, vals[i]);
+
+	if ( data.size() - entry > UINT32_MAX )
+		reporter->InternalError("entry too large in PackedValues::Append");
+
+	auto p = reinterpret_cast<unsigned char*>(&data[entry]);
+	put32(p, data.size() - entry);
+	put32(p + 4, num_vals);
+	entries.push_back(entry);
+	}
+
+void PackedValues::PackData(size_t entry, size_t slot, const char* s, size_t len)
+	{
+	auto p = reinterpret_cast<unsigned char*>(&data[slot]);
+	put32(p + PAYLOAD, data.size() - entry);
+	put32(p + PAYLOAD + 4, len);
+	data.append(s, len);
+	}
+
+void PackedValues::PackValue(size_t entry, size_t slot, const Value* v)
+	{
+	// Appending data may move the buffer, so look up the slot again
+	// after doing so.
+	auto p = reinterpret_cast<unsigned char*>(&data[slot]);
+	p[0] = v->type;
+	p[1] = v->subtype;
+	p[2] = v->present;
+
+	if ( ! v->present )
+		return;
+
+	switch ( v->type ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+		put64(p + PAYLOAD, v->val.int_val);
+		break;
+
+	case TYPE_COUNT:
+		put64(p + PAYLOAD, v->val.uint_val);
+		break;
+
+	case TYPE_PORT:
+		p[3] = v->val.port_val.proto;
+		put64(p + PAYLOAD, v->val.port_val.port);
+		break;
+
+	case TYPE_ADDR:
+	case TYPE_SUBNET:
+		{
+		// Addresses are in network byte order already.
+		const auto& addr = v->type == TYPE_ADDR ? v->val.addr_val : v->val.subnet_val.prefix;
+
+		if ( addr.family == IPv4 )
+			{
+			p[3] = 4;
+			memcpy(p + PAYLOAD, &addr.in.in4, sizeof(addr.in.in4));
+			}
+		else
+			{
+			p[3] = 6;
+			memcpy(p + PAYLOAD, &addr.in.in6, sizeof(addr.in.in6));
+			}
+
+		if ( v->type == TYPE_SUBNET )
+			p[4] = v->val.subnet_val.length;
+
+		break;
+		}
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		{
+		uint64_t bits;
+		memcpy(&bits, &v->val.double_val, sizeof(bits));
+		put64(p + PAYLOAD, bits);
+		break;
+		}
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		PackData(entry, slot, v->val.string_val.data, v->val.string_val.length);
+		break;
+
+	case TYPE_PATTERN:
+		PackData(entry, slot, v->val.pattern_text_val, strlen(v->val.pattern_text_val));
+		break;
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		// The two share a layout.
+		auto n = v->val.set_val.size;
+		auto elems = data.size();
+
+		put32(p + PAYLOAD, elems - entry);
+		put32(p + PAYLOAD + 4, n);
+		data.resize(elems + n * SLOT_SIZE);
+
+		for ( bro_int_t i = 0; i < n; i++ )
+			{
+			auto e = v->val.set_val.vals[i];
+
+			if ( e->type == TYPE_TABLE || e->type == TYPE_VECTOR )
+				reporter->InternalError("nested container in PackedValues::Append");
+
+			PackValue(entry, elems + i * SLOT_SIZE, e);
+			}
+
+		break;
+		}
+
+	default:
+		reporter->InternalError("unsupported type %s in PackedValues::Append", type_name(v->type));
+	}
+	}
+
+// Checks a value's slot for Load(). The data that slots point to must
+// follow in the order that Append() writes it, starting at *next, which
+// keeps the check linear in the size of the entry.
+static bool check_value(const unsigned char* entry, size_t size, size_t slot, bool element,
+                        size_t* next)
+	{
+	auto p = entry + slot;
+	auto type = p[0];
+
+	if ( type >= NUM_TYPES || p[1] >= NUM_TYPES || p[2] > 1 )
+		return false;
+
+	if ( ! p[2] )
+		return true;
+
+	auto off = get32(p + PAYLOAD);
+	auto len = get32(p + PAYLOAD + 4);
+
+	switch ( type ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		return true;
+
+	case TYPE_PORT:
+		return p[3] <= TRANSPORT_ICMP;
+
+	case TYPE_ADDR:
+		return p[3] == 4 || p[3] == 6;
+
+	case TYPE_SUBNET:
+		return (p[3] == 4 || p[3] == 6) && p[4] <= 128;
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+	case TYPE_PATTERN:
+		if ( off != *next || len > size - off )
+			return false;
+
+		*next += len;
+		return true;
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		if ( element || off != *next || len > (size - off) / SLOT_SIZE )
+			return false;
+
+		*next += len * SLOT_SIZE;
+
+		for ( uint32_t i = 0; i < len; i++ )
+			{
+			if ( ! check_value(entry, size, off + i * SLOT_SIZE, true, next) )
+				return false;
+			}
+
+		return true;
+		}
+
+	default:
+		return false;
+	}
+	}
+
+bool PackedValues::Load(std::string arg_data)
+	{
+	Clear();
+
+	if ( arg_data.size() < HEADER_SIZE || memcmp(arg_data.data(), MAGIC, HEADER_SIZE) != 0 )
+		return false;
+
+	auto buf = reinterpret_cast<const unsigned char*>(arg_data.data());
+	std::vector<size_t> offsets;
+
+	for ( size_t off = HEADER_SIZE; off < arg_data.size(); )
+		{
+		auto avail = arg_data.size() - off;
+
+		if ( avail < ENTRY_HEADER_SIZE )
+			return false;
+
+		auto entry = buf + off;
+		size_t size = get32(entry);
+		size_t n = get32(entry + 4);
+
+		if ( size < ENTRY_HEADER_SIZE || size > avail ||
+		     n > (size - ENTRY_HEADER_SIZE) / SLOT_SIZE )
+			return false;
+
+		size_t next = ENTRY_HEADER_SIZE + n * SLOT_SIZE;
+
+		for ( size_t i = 0; i < n; i++ )
+			{
+			if ( ! check_value(entry, size, ENTRY_HEADER_SIZE + i * SLOT_SIZE, false, &next) )
+				return false;
+			}
+
+		if ( next != size )
+			return false;
+
+		offsets.push_back(off);
+		off += size;
+		}
+
+	data = std::move(arg_data);
+	entries = std::move(offsets);
+	return true;
+	}
+
+int PackedValues::EntryView::NumValues() const
+	{
+	return get32(entry + 4);
+	}
+
+PackedValues::ValueView PackedValues::EntryView::operator[](int i) const
+	{
+	return ValueView(entry, entry + ENTRY_HEADER_SIZE + i * SLOT_SIZE);
+	}
+
+Value** PackedValues::EntryView::Unpack() const
+	{
+	auto n = NumValues();
+	auto vals = new Value*[n];
+
+	for ( int i = 0; i < n; i++ )
+		vals[i] = (*this)[i].Unpack();
+
+	return vals;
+	}
+
+bro_int_t PackedValues::ValueView::Int() const
+	{
+	return static_cast<bro_int_t>(get64(slot + PAYLOAD));
+	}
+
+bro_uint_t PackedValues::ValueView::Count() const
+	{
+	return get64(slot + PAYLOAD);
+	}
+
+double PackedValues::ValueView::Double() const
+	{
+	uint64_t bits = get64(slot + PAYLOAD);
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+	}
+
+Value::port_t PackedValues::ValueView::Port() const
+	{
+	Value::port_t port;
+	port.port = get64(slot + PAYLOAD);
+	port.proto = static_cast<TransportProto>(slot[3]);
+	return port;
+	}
+
+Value::addr_t PackedValues::ValueView::Addr() const
+	{
+	Value::addr_t addr;
+
+	if ( slot[3] == 4 )
+		{
+		addr.family = IPv4;
+		memcpy(&addr.in.in4, slot + PAYLOAD, sizeof(addr.in.in4));
+		}
+	else
+		{
+		addr.family = IPv6;
+		memcpy(&addr.in.in6, slot + PAYLOAD, sizeof(addr.in.in6));
+		}
+
+	return addr;
+	}
+
+Value::subnet_t PackedValues::ValueView::Subnet() const
+	{
+	Value::subnet_t subnet;
+	subnet.prefix = Addr();
+	subnet.length = slot[4];
+	return subnet;
+	}
+
+std::string_view PackedValues::ValueView::String() const
+	{
+	auto data = reinterpret_cast<const char*>(entry + get32(slot + PAYLOAD));
+	return {data, get32(slot + PAYLOAD + 4)};
+	}
+
+size_t PackedValues::ValueView::NumElements() const
+	{
+	return get32(slot + PAYLOAD + 4);
+	}
+
+PackedValues::ValueView PackedValues::ValueView::Element(size_t i) const
+	{
+	return ValueView(entry, entry + get32(slot + PAYLOAD) + i * SLOT_SIZE);
+	}
+
+Value* PackedValues::ValueView::Unpack() const
+	{
+	auto v = new Value(Type(), SubType(), Present());
+
+	if ( ! v->present )
+		return v;
+
+	switch ( v->type ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+		v->val.int_val = Int();
+		break;
+
+	case TYPE_COUNT:
+		v->val.uint_val = Count();
+		break;
+
+	case TYPE_PORT:
+		v->val.port_val = Port();
+		break;
+
+	case TYPE_ADDR:
+		v->val.addr_val = Addr();
+		break;
+
+	case TYPE_SUBNET:
+		v->val.subnet_val = Subnet();
+		break;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		v->val.double_val = Double();
+		break;
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		{
+		auto s = String();
+		v->val.string_val.data = new char[s.size()];
+		v->val.string_val.length = s.size();
+		memcpy(v->val.string_val.data, s.data(), s.size());
+		break;
+		}
+
+	case TYPE_PATTERN:
+		{
+		auto s = String();
+		auto text = new char[s.size() + 1];
+		memcpy(text, s.data(), s.size());
+		text[s.size()] = '\0';
+		v->val.pattern_text_val = text;
+		break;
+		}
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		auto n = NumElements();
+		v->val.set_val.size = n;
+		v->val.set_val.vals = new Value*[n];
+
+		for ( size_t i = 0; i < n; i++ )
+			v->val.set_val.vals[i] = Element(i).Unpack();
+
+		break;
+		}
+
+	default:
+		break;
+	}
+
+	return v;
+	}
+
+TEST_CASE("threading packed values")
+	{
+	Value* vals[5];
+
+	vals[0] = new Value(TYPE_COUNT);
+	vals[0]->val.uint_val = 42;
+
+	vals[1] = new Value(TYPE_STRING);
+	vals[1]->val.string_val.data = util::copy_string("foo");
+	vals[1]->val.string_val.length = 3;
+
+	vals[2] = new Value(TYPE_STRING, false);
+
+	vals[3] = new Value(TYPE_VECTOR, TYPE_ADDR);
+	vals[3]->val.vector_val.size = 2;
+	vals[3]->val.vector_val.vals = new Value*[2];
+
+	for ( int i = 0; i < 2; i++ )
+		{
+		auto a = new Value(TYPE_ADDR);
+		a->val.addr_val.family = IPv4;
+		a->val.addr_val.in.in4.s_addr = htonl(0x0a000001 + i);
+		vals[3]->val.vector_val.vals[i] = a;
+		}
+
+	vals[4] = new Value(TYPE_INTERVAL);
+	vals[4]->val.double_val = 1.5;
+
+	PackedValues packed;
+	packed.Append(vals, 5);
+	packed.Append(vals, 2);
+	CHECK(packed.NumEntries() == 2);
+
+	auto e = packed.Entry(0);
+	CHECK(e.NumValues() == 5);
+	CHECK(e[0].Count() == 42);
+	CHECK(e[1].String() == "foo");
+	CHECK(! e[2].Present());
+	CHECK(e[3].NumElements() == 2);
+	CHECK(ntohl(e[3].Element(1).Addr().in.in4.s_addr) == 0x0a000002);
+	CHECK(e[4].Double() == 1.5);
+
+	SUBCASE("load")
+		{
+		PackedValues loaded;
+		CHECK(loaded.Load(packed.Data()));
+		CHECK(loaded.NumEntries() == 2);
+		CHECK(loaded.Entry(1).NumValues() == 2);
+		CHECK(loaded.Entry(1)[1].String() == "foo");
+
+		auto unpacked = loaded.Entry(0).Unpack();
+		CHECK(unpacked[3]->val.vector_val.size == 2);
+		CHECK(unpacked[3]->val.vector_val.vals[0]->val.addr_val.in.in4.s_addr == htonl(0x0a000001));
+		Value::delete_value_ptr_array(unpacked, 5);
+		}
+
+	SUBCASE("malformed")
+		{
+		PackedValues loaded;
+		auto data = packed.Data();
+		CHECK(! loaded.Load(data.substr(0, data.size() - 1)));
+		CHECK(! loaded.Load("ZPV"));
+		CHECK(loaded.NumEntries() == 0);
+
+		// Point the string outside of the entry.
+		data[HEADER_SIZE + ENTRY_HEADER_SIZE + SLOT_SIZE + PAYLOAD] = 0xff;
+		CHECK(! loaded.Load(data));
+		}
+
+	for ( auto v : vals )
+		delete v;
+	}
+
+} // namespace zeek::threading
@@ -0,0 +1,197 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SerialTypes.h"
+
+namespace zeek::threading {
+
+/**
+ * A compact encoding of a sequence of Value arrays (e.g., log records or
+ * input lines) in a single contiguous buffer. All references inside the
+ * buffer are offsets relative to the start of the array's entry, so the
+ * buffer can be moved between threads as one allocation, and written to
+ * disk or sent to a peer as-is, then loaded on the other end. Values can
+ * be read in place through EntryView/ValueView without reconstructing
+ * them; Unpack() turns an entry back into heap Values where needed.
+ *
+ * The encoding uses little-endian byte order independent of the host.
+ * Each entry consists of its size and number of values, followed by one
+ * fixed-size slot per value and then the variable-size data (strings,
+ * set and vector elements) the slots point to.
+ */
+class PackedValues {
+public:
+	class EntryView;
+
+	/**
+	 * A read-only view of a value inside the buffer. It remains valid as
+	 * long as the buffer isn't modified.
+	 */
+	class ValueView {
+	public:
+		TypeTag Type() const	{ return static_cast<TypeTag>(slot[0]); }
+		TypeTag SubType() const	{ return static_cast<TypeTag>(slot[1]); }
+		bool Present() const	{ return slot[2]; }
+
+		/**
+		 * Returns a bool or int value.
+		 */
+		bro_int_t Int() const;
+
+		/**
+		 * Returns a count value.
+		 */
+		bro_uint_t Count() const;
+
+		/**
+		 * Returns a double, time, or interval value.
+		 */
+		double Double() const;
+
+		/**
+		 * Returns a port value.
+		 */
+		Value::port_t Port() const;
+
+		/**
+		 * Returns an addr value.
+		 */
+		Value::addr_t Addr() const;
+
+		/**
+		 * Returns a subnet value.
+		 */
+		Value::subnet_t Subnet() const;
+
+		/**
+		 * Returns the data of a string, enum, file, func, or pattern value.
+		 */
+		std::string_view String() const;
+
+		/**
+		 * Returns the number of elements of a set or vector value.
+		 */
+		size_t NumElements() const;
+
+		/**
+		 * Returns an element of a set or vector value.
+		 */
+		ValueView Element(size_t i) const;
+
+		/**
+		 * Reconstructs the value on the heap.
+		 */
+		Value* Unpack() const;
+
+	private:
+		friend class EntryView;
+		friend class PackedValues;
+
+		ValueView(const unsigned char* entry, const unsigned char* slot)
+			: entry(entry), slot(slot)	{}
+
+		const unsigned char* entry;
+		const unsigned char* slot;
+	};
+
+	/**
+	 * A read-only view of one array of values inside the buffer. It
+	 * remains valid as long as the buffer isn't modified.
+	 */
+	class EntryView {
+	public:
+		/**
+		 * Returns the number of values.
+		 */
+		int NumValues() const;
+
+		/**
+		 * Returns one of the values.
+		 */
+		ValueView operator[](int i) const;
+
+		/**
+		 * Reconstructs the values on the heap. The caller takes
+		 * ownership of the returned array, which has NumValues()
+		 * entries.
+		 */
+		Value** Unpack() const;
+
+	private:
+		friend class PackedValues;
+
+		explicit EntryView(const unsigned char* entry) : entry(entry)	{}
+
+		const unsigned char* entry;
+	};
+
+	/**
+	 * Constructor. Starts out without any entries.
+	 */
+	PackedValues();
+
+	/**
+	 * Appends the encoding of an array of values.
+	 *
+	 * @param vals The values, which remain owned by the caller.
+	 *
+	 * @param num_vals The size of *vals*.
+	 */
+	void Append(const Value* const* vals, int num_vals);
+
+	/**
+	 * Replaces the content with a buffer as returned by Data(), e.g.,
+	 * as read from disk or received from a peer. The buffer is checked
+	 * to be well-formed first, so this is safe to use with untrusted
+	 * input.
+	 *
+	 * @param data The buffer.
+	 *
+	 * @return False if the buffer isn't well-formed, leaving us empty.
+	 */
+	bool Load(std::string data);
+
+	/**
+	 * Removes all entries.
+	 */
+	void Clear();
+
+	/**
+	 * Returns the number of entries.
+	 */
+	size_t NumEntries() const	{ return entries.size(); }
+
+	/**
+	 * Returns a view of an entry.
+	 *
+	 * @param i The index of the entry, less than NumEntries().
+	 */
+	EntryView Entry(size_t i) const
+		{ return EntryView(reinterpret_cast<const unsigned char*>(data.data()) + entries[i]); }
+
+	/**
+	 * Returns the encoded buffer.
+	 */
+	const std::string& Data() const	{ return data; }
+
+	/**
+	 * Returns the size of the encoded buffer in bytes.
+	 */
+	size_t Size() const	{ return data.size(); }
+
+private:
+	void PackValue(size_t entry, size_t slot, const Value* v);
+	void PackData(size_t entry, size_t slot, const char* s, size_t len);
+
+	std::string data;
+	std::vector<size_t> entries;	// Offsets of the entries.
+};
+
+} // namespace zeek::threading
@@ -1,9 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
 #include <deque>
+#include <memory>
 #include <stdint.h>
 #include <sys/time.h>
 
@@ -17,26 +18,37 @@ namespace zeek::threading {
 /**
  * A thread-safe single-reader single-writer queue.
  *
- * The implementation uses multiple queues and reads/writes in rotary fashion
- * in an attempt to limit contention.
+ * Elements pass through a bounded lock-free ring buffer. Only if that is
+ * full, the writer spills them into a mutex-protected overflow queue, so
+ * that writing never blocks; the reader picks them up from there in
+ * order once it has emptied the ring. A reader waiting for input sleeps
+ * on a condition variable, which the writer signals only when the reader
+ * is actually waiting.
  *
  * All Queue instances must be instantiated by Bro's main thread.
- *
- * TODO: Unclear how critical performance is for this qeueue. We could likely
- * optimize it further if helpful.
  */
 template<typename T>
 class Queue
 {
 public:
+	/**
+	 * The default capacity of the ring buffer.
+	 */
+	static constexpr size_t DEFAULT_CAPACITY = 1024;
+
 	/**
 	 * Constructor.
 	 *
 	 * reader, writer: The corresponding threads. This is for checking
 	 * whether they have terminated so that we can abort I/O opeations.
 	 * Can be left null for the main thread.
+	 *
+	 * capacity: The number of elements the ring buffer holds before
+	 * spilling into the overflow queue. Gets rounded up to a power of
+	 * two.
 	 */
-	Queue(BasicThread* arg_reader, BasicThread* arg_writer);
+	Queue(BasicThread* arg_reader, BasicThread* arg_writer,
+	      size_t capacity = DEFAULT_CAPACITY);
 
 	/**
 	 * Destructor.
@@ -50,13 +62,26 @@ public:
 	 */
 	T Get();
 
+	/**
+	 * Retrieves what's available right now, up to a maximum number of
+	 * elements, without blocking.
+	 *
+	 * @param data An array receiving the elements.
+	 *
+	 * @param max The size of *data*.
+	 *
+	 * @return The number of elements retrieved.
+	 */
+	size_t GetBatch(T* data, size_t max);
+
 	/**
 	 * Queues one element.
 	 */
 	void Put(T data);
 
 	/**
-	 * Returns true if the next Get() operation will succeed.
+	 * Returns true if the next Get() operation will succeed. Must be
+	 * called by the reader.
 	 */
 	bool Ready();
 
@@ -69,7 +94,7 @@ public:
 	 * it is empty. In other words, this method helps to avoid locking the queue
 	 * frequently, but doesn't allow you to forgo it completely.
 	 */
-	bool MaybeReady() { return (num_reads != num_writes); }
+	bool MaybeReady() { return Size() > 0; }
 
 	/**
 	 * Wake up the reader if it's currently blocked for input. This is
@@ -89,6 +114,7 @@ public:
 		{
 		uint64_t num_reads;	//! Number of messages read from the queue.
 		uint64_t num_writes;	//! Number of messages written to the queue.
+		uint64_t num_overflows;	//! Number of messages written while the ring buffer was full.
 		};
 
 	/**
@@ -100,23 +126,38 @@ public:
 	void GetStats(Stats* stats);
 
 private:
-	static const int NUM_QUEUES = 8;
+	bool PushRing(T data);
+	bool PopRing(T* data);
+	bool Pop(T* data);
+
+	std::unique_ptr<T[]> ring;
+	uint64_t mask;
+
+	// Index of the next element to read, written by the reader only.
+	alignas(64) std::atomic<uint64_t> head;
+	uint64_t cached_tail;	// The reader's last look at tail.
+	std::deque<T> spilled;	// Taken from the overflow queue, to read first.
 
-	std::vector<std::unique_lock<std::mutex>> LocksForAllQueues();
+	// Index of the next element to write, written by the writer only.
+	alignas(64) std::atomic<uint64_t> tail;
+	uint64_t cached_head;	// The writer's last look at head.
 
-	std::mutex mutex[NUM_QUEUES];	// Mutex protected shared accesses.
-	std::condition_variable has_data[NUM_QUEUES];	// Signals when data becomes available
-	std::queue<T> messages[NUM_QUEUES];	// Actually holds the queued messages
+	alignas(64) std::mutex overflow_mutex;	// Protects overflow.
+	std::deque<T> overflow;
+	std::atomic<bool> has_overflow;	// Set by the writer, cleared by the reader.
 
-	int read_ptr;	// Where the next operation will read from
-	int write_ptr;	// Where the next operation will write to
+	std::mutex wait_mutex;
+	std::condition_variable has_data;	// Signals when data becomes available
+	std::atomic<bool> waiting;	// True while the reader waits for has_data.
+	std::atomic<bool> woken;	// Set by WakeUp().
 
 	BasicThread* reader;
 	BasicThread* writer;
 
 	// Statistics.
-	uint64_t num_reads;
-	uint64_t num_writes;
+	std::atomic<uint64_t> num_reads;
+	std::atomic<uint64_t> num_writes;
+	std::atomic<uint64_t> num_overflows;
 };
 
 inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
@@ -134,11 +175,18 @@ inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
 	}
 
 template<typename T>
-inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer)
+inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer, size_t capacity)
+	: head(0), cached_tail(0), tail(0), cached_head(0), has_overflow(false), waiting(false), woken(false),
+	  num_reads(0), num_writes(0), num_overflows(0)
 	{
-	read_ptr = 0;
-	write_ptr = 0;
-	num_reads = num_writes = 0;
+	size_t n = 1;
+
+	while ( n < capacity )
+		n <<= 1;
+
+	ring = std::make_unique<T[]>(n);
+	mask = n - 1;
+
 	reader = arg_reader;
 	writer = arg_writer;
 	}
@@ -149,116 +197,178 @@ inline Queue<T>::~Queue()
 	}
 
 template<typename T>
-inline T Queue<T>::Get()
+inline bool Queue<T>::PushRing(T data)
 	{
-	auto lock = acquire_lock(mutex[read_ptr]);
+	auto t = tail.load(std::memory_order_relaxed);
 
-	int old_read_ptr = read_ptr;
-
-	if ( messages[read_ptr].empty() && ! ((reader && reader->Killed()) || (writer && writer->Killed())) )
+	if ( t - cached_head > mask )
 		{
-		if ( has_data[read_ptr].wait_for(lock, std::chrono::seconds(5)) == std::cv_status::timeout )
-			return nullptr;
+		cached_head = head.load(std::memory_order_acquire);
+
+		if ( t - cached_head > mask )
+			return false;
 		}
 
-	if ( messages[read_ptr].empty() )
-		return nullptr;
+	ring[t & mask] = data;
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+	}
 
-	T data = messages[read_ptr].front();
-	messages[read_ptr].pop();
+template<typename T>
+inline bool Queue<T>::PopRing(T* data)
+	{
+	auto h = head.load(std::memory_order_relaxed);
 
-	read_ptr = (read_ptr + 1) % NUM_QUEUES;
-	++num_reads;
+	if ( h == cached_tail )
+		{
+		cached_tail = tail.load(std::memory_order_acquire);
 
-	return data;
+		if ( h == cached_tail )
+			return false;
+		}
+
+	*data = ring[h & mask];
+	head.store(h + 1, std::memory_order_release);
+	return true;
 	}
 
 template<typename T>
-inline void Queue<T>::Put(T data)
+inline bool Queue<T>::Pop(T* data)
 	{
-	auto lock = acquire_lock(mutex[write_ptr]);
+	if ( ! spilled.empty() )
+		{
+		*data = spilled.front();
+		spilled.pop_front();
+		return true;
+		}
 
-	int old_write_ptr = write_ptr;
+	// While there's overflow, the writer doesn't use the ring, so
+	// anything left in it is older than the overflow.
+	bool overflowed = has_overflow.load(std::memory_order_acquire);
 
-	bool need_signal = messages[write_ptr].empty();
+	if ( PopRing(data) )
+		return true;
+
+	if ( ! overflowed )
+		return false;
+
+	{
+	auto lock = acquire_lock(overflow_mutex);
+	spilled.swap(overflow);
+	has_overflow.store(false, std::memory_order_release);
+	}
 
-	messages[write_ptr].push(data);
+	*data = spilled.front();
+	spilled.pop_front();
+	return true;
+	}
 
-	write_ptr = (write_ptr + 1) % NUM_QUEUES;
-	++num_writes;
+template<typename T>
+inline T Queue<T>::Get()
+	{
+	T data;
 
-	if ( need_signal )
+	if ( ! Pop(&data) )
 		{
-		lock.unlock();
-		has_data[old_write_ptr].notify_one();
+		if ( (reader && reader->Killed()) || (writer && writer->Killed()) )
+			return nullptr;
+
+		auto lock = acquire_lock(wait_mutex);
+		waiting.store(true);
+
+		// Pairs with the fence in Put() so that either we see the new
+		// element in the first check of the predicate below, or the
+		// writer sees us waiting.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		data = nullptr;
+
+		// Notifications may be stale, from the writer seeing an
+		// earlier wait.
+		bool got = has_data.wait_for(lock, std::chrono::seconds(5), [&]()
+			{
+			return Pop(&data) || woken.exchange(false) ||
+			       (reader && reader->Killed()) || (writer && writer->Killed());
+			});
+
+		waiting.store(false);
+
+		if ( ! got || ! data )
+			return nullptr;
 		}
-	}
 
+	num_reads.store(num_reads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return data;
+	}
 
 template<typename T>
-inline bool Queue<T>::Ready()
+inline size_t Queue<T>::GetBatch(T* data, size_t max)
 	{
-	auto lock = acquire_lock(mutex[read_ptr]);
+	size_t n = 0;
 
-	bool ret = (messages[read_ptr].size());
+	while ( n < max && Pop(&data[n]) )
+		++n;
 
-	return ret;
+	num_reads.store(num_reads.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	return n;
 	}
 
 template<typename T>
-inline std::vector<std::unique_lock<std::mutex>> Queue<T>::LocksForAllQueues()
+inline void Queue<T>::Put(T data)
 	{
-	std::vector<std::unique_lock<std::mutex>> locks;
-
-	try
+	if ( has_overflow.load(std::memory_order_acquire) || ! PushRing(data) )
 		{
-		for ( int i = 0; i < NUM_QUEUES; i++ )
-			locks.emplace_back(std::unique_lock<std::mutex>(mutex[i]));
+		auto lock = acquire_lock(overflow_mutex);
+		overflow.push_back(data);
+		has_overflow.store(true, std::memory_order_release);
+		num_overflows.store(num_overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 		}
 
-	catch ( const std::system_error& e )
+	num_writes.store(num_writes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if ( waiting.load() )
 		{
-		reporter->FatalErrorWithCore("cannot lock all mutexes: %s", e.what());
-		// Never gets here.
-		throw std::exception();
+		auto lock = acquire_lock(wait_mutex);
+		has_data.notify_one();
 		}
-
-	return locks;
 	}
 
+
 template<typename T>
-inline uint64_t Queue<T>::Size()
+inline bool Queue<T>::Ready()
 	{
-	// Need to lock all queues.
-	auto locks = LocksForAllQueues();
+	if ( ! spilled.empty() || has_overflow.load(std::memory_order_acquire) )
+		return true;
 
-	uint64_t size = 0;
+	return head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire);
+	}
 
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		size += messages[i].size();
+template<typename T>
+inline uint64_t Queue<T>::Size()
+	{
+	auto reads = num_reads.load(std::memory_order_relaxed);
+	auto writes = num_writes.load(std::memory_order_relaxed);
 
-	return size;
+	// The counters are read separately, so the reads may momentarily
+	// be ahead.
+	return writes > reads ? writes - reads : 0;
 	}
 
 template<typename T>
 inline void Queue<T>::GetStats(Stats* stats)
 	{
-	// To be safe, we look all queues. That's probably unneccessary, but
-	// doesn't really hurt.
-	auto locks = LocksForAllQueues();
-
-	stats->num_reads = num_reads;
-	stats->num_writes = num_writes;
+	stats->num_reads = num_reads.load(std::memory_order_relaxed);
+	stats->num_writes = num_writes.load(std::memory_order_relaxed);
+	stats->num_overflows = num_overflows.load(std::memory_order_relaxed);
 	}
 
 template<typename T>
 inline void Queue<T>::WakeUp()
 	{
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		{
-		auto lock = acquire_lock(mutex[i]);
-		has_data[i].notify_all();
-		}
+	auto lock = acquire_lock(wait_mutex);
+	woken.store(true);
+	has_data.notify_all();
 	}
 
 } // namespace zeek::threading
@@ -122,6 +122,31 @@ Value::~Value()
 		}
 	}
 
+size_t Value::MemoryAllocation() const
+	{
+	size_t size = sizeof(*this);
+
+	if ( ! present )
+		return size;
+
+	if ( type == TYPE_ENUM || type == TYPE_STRING || type == TYPE_FILE || type == TYPE_FUNC )
+		size += val.string_val.length;
+
+	else if ( type == TYPE_PATTERN )
+		size += strlen(val.pattern_text_val) + 1;
+
+	else if ( type == TYPE_TABLE || type == TYPE_VECTOR )
+		{
+		// The two share a layout.
+		size += val.set_val.size * sizeof(Value*);
+
+		for ( bro_int_t i = 0; i < val.set_val.size; i++ )
+			size += val.set_val.vals[i]->MemoryAllocation();
+		}
+
+	return size;
+	}
+
 bool Value::IsCompatibleType(Type* t, bool atomic_only)
 	{
 	if ( ! t )
@@ -431,6 +456,16 @@ void Value::delete_value_ptr_array(Value** vals, int num_fields)
 	delete [] vals;
 	}
 
+size_t Value::value_ptr_array_allocation(const Value* const* vals, int num_fields)
+	{
+	size_t size = num_fields * sizeof(Value*);
+
+	for ( int i = 0; i < num_fields; ++i )
+		size += vals[i]->MemoryAllocation();
+
+	return size;
+	}
+
 Val* Value::ValueToVal(const std::string& source, const Value* val, bool& have_error)
 	{
 	if ( have_error )
@@ -183,6 +183,12 @@ struct Value {
 	 */
 	bool Write(zeek::detail::SerializationFormat* fmt) const;
 
+	/**
+	 * Returns the number of bytes the value occupies on the heap,
+	 * including any data it owns.
+	 */
+	size_t MemoryAllocation() const;
+
 	/**
 	 * Returns true if the type can be represented by a Value. If
 	 * `atomic_only` is true, will not permit composite types. This
@@ -196,6 +202,14 @@ struct Value {
 	 */
 	static void delete_value_ptr_array(Value** vals, int num_fields);
 
+	/**
+	 * Returns the number of bytes an array of value pointers occupies on
+	 * the heap, including the values.
+	 * @param vals Array of values
+	 * @param num_fields Number of members
+	 */
+	static size_t value_ptr_array_allocation(const Value* const* vals, int num_fields);
+
 	/**
 	 * Convert threading::Value to an internal Zeek type, just using the information given in the threading::Value.
 	 *
@@ -0,0 +1,96 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "BasicThread.h"
+#include "util.h"
+
+#include "3rdparty/doctest.h"
+
+namespace zeek::threading::detail {
+
+ThreadPool::ThreadPool(size_t size)
+	{
+	if ( size == 0 )
+		size = std::max(std::thread::hardware_concurrency(), 1u);
+
+	workers.reserve(size);
+
+	for ( size_t i = 0; i < size; i++ )
+		workers.emplace_back(&ThreadPool::Work, this);
+	}
+
+ThreadPool::~ThreadPool()
+	{
+	{
+	std::lock_guard<std::mutex> lock(mutex);
+	stopping = true;
+	}
+
+	has_tasks.notify_all();
+
+	for ( auto& w : workers )
+		w.join();
+	}
+
+void ThreadPool::Schedule(Task task)
+	{
+	{
+	std::lock_guard<std::mutex> lock(mutex);
+	tasks.push_back(std::move(task));
+	}
+
+	has_tasks.notify_one();
+	}
+
+void ThreadPool::Work()
+	{
+	BasicThread::BlockSignals();
+	util::detail::set_thread_name("zk.pool", pthread_self());
+
+	for ( ;; )
+		{
+		Task task;
+
+		{
+		std::unique_lock<std::mutex> lock(mutex);
+		has_tasks.wait(lock, [this]() { return stopping || ! tasks.empty(); });
+
+		if ( tasks.empty() )
+			return;
+
+		task = std::move(tasks.front());
+		tasks.pop_front();
+		}
+
+		task();
+		}
+	}
+
+TEST_CASE("threading thread pool")
+	{
+	std::atomic<int> count{0};
+
+	{
+	ThreadPool pool(4);
+	CHECK(pool.Size() == 4);
+
+	for ( int i = 0; i < 1000; i++ )
+		pool.Schedule([&count]() { ++count; });
+
+	// Tasks may schedule more tasks.
+	pool.Schedule([&pool, &count]()
+		{
+		for ( int i = 0; i < 10; i++ )
+			pool.Schedule([&count]() { ++count; });
+		});
+	}
+
+	// The destructor runs everything still queued.
+	CHECK(count == 1010);
+	}
+
+} // namespace zeek::threading::detail
@@ -0,0 +1,64 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zeek::threading::detail {
+
+/**
+ * A fixed set of OS threads executing tasks from a shared run queue, in
+ * the order scheduled. Message threads configured to run on the pool
+ * schedule a task whenever they have input, see
+ * :zeek:see:`Threading::use_thread_pool`. The pool itself doesn't
+ * serialize tasks; users need to make sure that whatever a task works on
+ * isn't scheduled twice at the same time.
+ */
+class ThreadPool {
+public:
+	using Task = std::function<void()>;
+
+	/**
+	 * Constructor. Starts the pool's threads.
+	 *
+	 * @param size The number of threads. Zero picks the number of
+	 * available cores.
+	 */
+	explicit ThreadPool(size_t size);
+
+	/**
+	 * Destructor. Runs all tasks still queued, then joins the threads.
+	 */
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * Queues a task for execution by the next available thread. This is
+	 * safe to call from any thread, including from a running task.
+	 */
+	void Schedule(Task task);
+
+	/**
+	 * Returns the number of threads.
+	 */
+	size_t Size() const	{ return workers.size(); }
+
+private:
+	void Work();
+
+	std::mutex mutex;	// Protects tasks and stopping.
+	std::condition_variable has_tasks;
+	std::deque<Task> tasks;
+	bool stopping = false;
+
+	std::vector<std::thread> workers;
+};
+
+} // namespace zeek::threading::detail
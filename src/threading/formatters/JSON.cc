@@ -4,7 +4,11 @@
 
 #include "JSON.h"
 #include "rapidjson/internal/ieee754.h"
+#include "rapidjson/internal/dtoa.h"
+#include "rapidjson/internal/itoa.h"
 #include "Desc.h"
+#include "ConvertUTF.h"
+#include "bro_inet_ntop.h"
 #include "threading/MsgThread.h"
 
 #ifndef __STDC_LIMIT_MACROS
@@ -16,8 +20,208 @@
 #include <math.h>
 #include <stdint.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "3rdparty/doctest.h"
+
 namespace zeek::threading::formatter {
 
+// Returns the number of bytes at the start of the data that go into a
+// JSON string as they are: printable ASCII other than quotes and
+// backslashes.
+static size_t plain_run(const u_char* data, size_t len)
+	{
+	size_t i = 0;
+
+	// With a signed comparison, bytes of 0x80 and above count as below
+	// the space character, so a single one finds both them and the
+	// control characters.
+#if defined(__AVX2__)
+	const __m256i space32 = _mm256_set1_epi8(' ');
+	const __m256i quote32 = _mm256_set1_epi8('"');
+	const __m256i backslash32 = _mm256_set1_epi8('\\');
+
+	for ( ; i + 32 <= len; i += 32 )
+		{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi8(space32, v),
+		                                                  _mm256_cmpeq_epi8(v, quote32)),
+		                                  _mm256_cmpeq_epi8(v, backslash32));
+
+		if ( unsigned int mask = _mm256_movemask_epi8(special) )
+			return i + __builtin_ctz(mask);
+		}
+#endif
+
+#if defined(__SSE2__)
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+
+	for ( ; i + 16 <= len; i += 16 )
+		{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(v, space),
+		                                            _mm_cmpeq_epi8(v, quote)),
+		                               _mm_cmpeq_epi8(v, backslash));
+
+		if ( int mask = _mm_movemask_epi8(special) )
+			return i + __builtin_ctz(mask);
+		}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const int8x16_t space = vdupq_n_s8(' ');
+	const uint8x16_t quote = vdupq_n_u8('"');
+	const uint8x16_t backslash = vdupq_n_u8('\\');
+
+	for ( ; i + 16 <= len; i += 16 )
+		{
+		uint8x16_t v = vld1q_u8(data + i);
+		uint8x16_t special = vorrq_u8(vorrq_u8(vcltq_s8(vreinterpretq_s8_u8(v), space),
+		                                       vceqq_u8(v, quote)),
+		                              vceqq_u8(v, backslash));
+
+		// The scalar loop below pinpoints it.
+		if ( vmaxvq_u8(special) )
+			break;
+		}
+#endif
+
+	for ( ; i < len; ++i )
+		{
+		u_char c = data[i];
+
+		if ( c < ' ' || c >= 0x80 || c == '"' || c == '\\' )
+			break;
+		}
+
+	return i;
+	}
+
+// Appends a string in quotes, escaped like rapidjson does. With
+// zeek_escapes, also replaces control characters and bytes that aren't
+// valid UTF-8 with \x escapes first, like util::json_escape_utf8(),
+// which then get their backslash escaped.
+static void append_string(std::string& out, const char* s, size_t len, bool zeek_escapes)
+	{
+	auto data = reinterpret_cast<const u_char*>(s);
+	out.push_back('"');
+
+	for ( size_t i = 0; i < len; )
+		{
+		size_t n = plain_run(data + i, len - i);
+		out.append(s + i, n);
+		i += n;
+
+		if ( i == len )
+			break;
+
+		u_char c = data[i];
+		const char* esc = nullptr;
+
+		switch ( c ) {
+		case '"': esc = "\\\""; break;
+		case '\\': esc = "\\\\"; break;
+		case '\b': esc = "\\b"; break;
+		case '\f': esc = "\\f"; break;
+		case '\n': esc = "\\n"; break;
+		case '\r': esc = "\\r"; break;
+		case '\t': esc = "\\t"; break;
+		default: break;
+		}
+
+		if ( esc )
+			{
+			out.append(esc, 2);
+			++i;
+			continue;
+			}
+
+		unsigned int char_size = 1;
+
+		if ( c >= 0x80 )
+			{
+			if ( ! zeek_escapes )
+				{
+				out.push_back(c);
+				++i;
+				continue;
+				}
+
+			char_size = getNumBytesForUTF8(c);
+
+			if ( char_size > 0 && i + char_size <= len &&
+			     isLegalUTF8Sequence(data + i, data + i + char_size) )
+				{
+				out.append(s + i, char_size);
+				i += char_size;
+				continue;
+				}
+			}
+
+		char hex[2];
+		util::bytetohex(c, hex);
+
+		if ( zeek_escapes )
+			out.append("\\\\x");
+		else
+			{
+			// rapidjson's own escape for control characters.
+			static constexpr char hex_chars[] = "0123456789ABCDEF";
+			hex[0] = hex_chars[c >> 4];
+			hex[1] = hex_chars[c & 0x0f];
+			out.append("\\u00");
+			}
+
+		out.append(hex, 2);
+		++i;
+		}
+
+	out.push_back('"');
+	}
+
+static void append_addr(std::string& out, const Value::addr_t& addr)
+	{
+	char s[INET6_ADDRSTRLEN];
+
+	if ( addr.family == IPv4 )
+		{
+		if ( ! bro_inet_ntop(AF_INET, &addr.in.in4, s, INET_ADDRSTRLEN) )
+			strcpy(s, "<bad IPv4 address conversion>");
+		}
+	else
+		{
+		if ( ! bro_inet_ntop(AF_INET6, &addr.in.in6, s, INET6_ADDRSTRLEN) )
+			strcpy(s, "<bad IPv6 address conversion>");
+		}
+
+	out.append(s);
+	}
+
+static void append_uint(std::string& out, uint64_t u)
+	{
+	char buf[24];
+	out.append(buf, rapidjson::internal::u64toa(u, buf) - buf);
+	}
+
+static void append_double(std::string& out, double d)
+	{
+	// As NullDoubleWriter does.
+	if ( rapidjson::internal::Double(d).IsNanOrInf() )
+		{
+		out.append("null");
+		return;
+		}
+
+	char buf[32];
+	out.append(buf, rapidjson::internal::dtoa(d, buf) - buf);
+	}
+
 bool JSON::NullDoubleWriter::Double(double d)
 	{
 	if ( rapidjson::internal::Double(d).IsNanOrInf() )
@@ -35,22 +239,49 @@ JSON::~JSON()
 	{
 	}
 
+const std::vector<std::string>& JSON::Keys(int num_fields, const Field* const* fields) const
+	{
+	if ( keys_fields == fields && keys.size() == static_cast<size_t>(num_fields) )
+		return keys;
+
+	keys.clear();
+
+	for ( int i = 0; i < num_fields; i++ )
+		{
+		std::string key;
+		append_string(key, fields[i]->name, strlen(fields[i]->name), false);
+		key.push_back(':');
+		keys.push_back(std::move(key));
+		}
+
+	keys_fields = fields;
+	return keys;
+	}
+
 bool JSON::Describe(ODesc* desc, int num_fields, const Field* const * fields,
                     Value** vals) const
 	{
-	rapidjson::StringBuffer buffer;
-	NullDoubleWriter writer(buffer);
+	const auto& k = Keys(num_fields, fields);
+	bool first = true;
 
-	writer.StartObject();
+	buffer.clear();
+	buffer.push_back('{');
 
 	for ( int i = 0; i < num_fields; i++ )
 		{
-		if ( vals[i]->present )
-			BuildJSON(writer, vals[i], fields[i]->name);
+		if ( ! vals[i]->present )
+			continue;
+
+		if ( ! first )
+			buffer.push_back(',');
+
+		buffer.append(k[i]);
+		AppendValue(buffer, vals[i]);
+		first = false;
 		}
 
-	writer.EndObject();
-	desc->Add(buffer.GetString());
+	buffer.push_back('}');
+	desc->AddN(buffer.data(), buffer.size());
 
 	return true;
 	}
@@ -66,15 +297,14 @@ bool JSON::Describe(ODesc* desc, Value* val, const std::string& name) const
 	if ( ! val->present || name.empty() )
 		return true;
 
-	rapidjson::Document doc;
-	rapidjson::StringBuffer buffer;
-	NullDoubleWriter writer(buffer);
-
-	writer.StartObject();
-	BuildJSON(writer, val, name);
-	writer.EndObject();
+	buffer.clear();
+	buffer.push_back('{');
+	append_string(buffer, name.data(), name.size(), false);
+	buffer.push_back(':');
+	AppendValue(buffer, val);
+	buffer.push_back('}');
 
-	desc->Add(buffer.GetString());
+	desc->AddN(buffer.data(), buffer.size());
 	return true;
 	}
 
@@ -85,46 +315,59 @@ Value* JSON::ParseValue(const std::string& s, const std::string& name,
 	return nullptr;
 	}
 
-void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& name) const
+void JSON::AppendValue(std::string& out, const Value* val) const
 	{
 	if ( ! val->present )
 		{
-		writer.Null();
+		out.append("null");
 		return;
 		}
 
-	if ( ! name.empty() )
-		writer.Key(name);
-
 	switch ( val->type )
 		{
 		case TYPE_BOOL:
-			writer.Bool(val->val.int_val != 0);
+			out.append(val->val.int_val != 0 ? "true" : "false");
 			break;
 
 		case TYPE_INT:
-			writer.Int64(val->val.int_val);
+			{
+			char buf[24];
+			out.append(buf, rapidjson::internal::i64toa(val->val.int_val, buf) - buf);
 			break;
+			}
 
 		case TYPE_COUNT:
-			writer.Uint64(val->val.uint_val);
+			append_uint(out, val->val.uint_val);
 			break;
 
 		case TYPE_PORT:
-			writer.Uint64(val->val.port_val.port);
+			append_uint(out, val->val.port_val.port);
 			break;
 
 		case TYPE_SUBNET:
-			writer.String(Formatter::Render(val->val.subnet_val));
+			{
+			out.push_back('"');
+			append_addr(out, val->val.subnet_val.prefix);
+			out.push_back('/');
+
+			if ( val->val.subnet_val.prefix.family == IPv4 )
+				append_uint(out, val->val.subnet_val.length - 96);
+			else
+				append_uint(out, val->val.subnet_val.length);
+
+			out.push_back('"');
 			break;
+			}
 
 		case TYPE_ADDR:
-			writer.String(Formatter::Render(val->val.addr_val));
+			out.push_back('"');
+			append_addr(out, val->val.addr_val);
+			out.push_back('"');
 			break;
 
 		case TYPE_DOUBLE:
 		case TYPE_INTERVAL:
-			writer.Double(val->val.double_val);
+			append_double(out, val->val.double_val);
 			break;
 
 		case TYPE_TIME:
@@ -142,7 +385,7 @@ void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& na
 					GetThread()->Error(GetThread()->Fmt("json formatter: failure getting time: (%lf)", val->val.double_val));
 					// This was a failure, doesn't really matter what gets put here
 					// but it should probably stand out...
-					writer.String("2000-01-01T00:00:00.000000");
+					out.append("\"2000-01-01T00:00:00.000000\"");
 					}
 				else
 					{
@@ -153,17 +396,19 @@ void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& na
 						frac += 1;
 
 					snprintf(buffer2, sizeof(buffer2), "%s.%06.0fZ", buffer, fabs(frac) * 1000000);
-					writer.String(buffer2, strlen(buffer2));
+					out.push_back('"');
+					out.append(buffer2);
+					out.push_back('"');
 					}
 				}
 
 			else if ( timestamps == TS_EPOCH )
-				writer.Double(val->val.double_val);
+				append_double(out, val->val.double_val);
 
 			else if ( timestamps == TS_MILLIS )
 				{
 				// ElasticSearch uses milliseconds for timestamps
-				writer.Uint64((uint64_t) (val->val.double_val * 1000));
+				append_uint(out, (uint64_t) (val->val.double_val * 1000));
 				}
 
 			break;
@@ -173,31 +418,25 @@ void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& na
 		case TYPE_STRING:
 		case TYPE_FILE:
 		case TYPE_FUNC:
-			{
-			writer.String(util::json_escape_utf8(
-				              std::string(val->val.string_val.data, val->val.string_val.length)));
+			append_string(out, val->val.string_val.data, val->val.string_val.length, true);
 			break;
-			}
 
 		case TYPE_TABLE:
-			{
-			writer.StartArray();
-
-			for ( bro_int_t idx = 0; idx < val->val.set_val.size; idx++ )
-				BuildJSON(writer, val->val.set_val.vals[idx]);
-
-			writer.EndArray();
-			break;
-			}
-
 		case TYPE_VECTOR:
 			{
-			writer.StartArray();
+			const auto& elements = val->type == TYPE_TABLE ? val->val.set_val
+			                                               : val->val.vector_val;
+			out.push_back('[');
+
+			for ( bro_int_t idx = 0; idx < elements.size; idx++ )
+				{
+				if ( idx > 0 )
+					out.push_back(',');
 
-			for ( bro_int_t idx = 0; idx < val->val.vector_val.size; idx++ )
-				BuildJSON(writer, val->val.vector_val.vals[idx]);
+				AppendValue(out, elements.vals[idx]);
+				}
 
-			writer.EndArray();
+			out.push_back(']');
 			break;
 			}
 
@@ -207,4 +446,34 @@ void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& na
 		}
 	}
 
+TEST_CASE("json formatter strings")
+	{
+	auto escaped = [](const std::string& s, bool zeek_escapes)
+		{
+		std::string out;
+		append_string(out, s.data(), s.size(), zeek_escapes);
+		return out;
+		};
+
+	CHECK(escaped("string", true) == "\"string\"");
+	CHECK(escaped("a \"quoted\" \\ string", true) == "\"a \\\"quoted\\\" \\\\ string\"");
+	CHECK(escaped("\b\f\n\r\t", true) == "\"\\b\\f\\n\\r\\t\"");
+	CHECK(escaped(std::string("\x07\x00", 2), true) == "\"\\\\x07\\\\x00\"");
+	CHECK(escaped(std::string("\x07\x00", 2), false) == "\"\\u0007\\u0000\"");
+	CHECK(escaped("\xc3\xb1\xf0\x90\x8c\xbc", true) == "\"\xc3\xb1\xf0\x90\x8c\xbc\"");
+	CHECK(escaped("\xc3\x28\xf0", true) == "\"\\\\xc3(\\\\xf0\"");
+	CHECK(escaped("\xc3\x28", false) == "\"\xc3\x28\"");
+
+	// Long enough for the vectorized scan, with the special characters
+	// in different positions of a block.
+	std::string plain(100, 'x');
+
+	for ( size_t i = 0; i < plain.size(); i += 7 )
+		{
+		std::string s = plain;
+		s[i] = '\n';
+		CHECK(escaped(s, true) == "\"" + plain.substr(0, i) + "\\n" + plain.substr(i + 1) + "\"");
+		}
+	}
+
 } // namespace zeek::threading::formatter
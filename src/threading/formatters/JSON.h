@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #define RAPIDJSON_HAS_STDSTRING 1
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
@@ -38,10 +41,27 @@ public:
 	};
 
 private:
-	void BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& name = "") const;
+	/**
+	 * Appends the JSON representation of a value to \a out, writing the
+	 * same output that rapidjson produces for it.
+	 */
+	void AppendValue(std::string& out, const Value* val) const;
+
+	/**
+	 * Returns the object keys for the fields, including quotes and colon.
+	 * They get computed once for the array that a writer passes in with
+	 * every record.
+	 */
+	const std::vector<std::string>& Keys(int num_fields, const Field* const* fields) const;
 
 	TimeFormat timestamps;
 	bool surrounding_braces;
+
+	// Each thread's writer has its own formatter, so these can stay
+	// around between calls to avoid allocations.
+	mutable std::string buffer;
+	mutable std::vector<std::string> keys;
+	mutable const Field* const* keys_fields = nullptr;
 };
 
 } // namespace zeek::threading::formatter
@@ -61,6 +61,10 @@
 
 #include "3rdparty/doctest.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #ifdef __linux__
 #if __has_include(<sys/random.h>)
 #define HAVE_GETRANDOM
@@ -1327,6 +1331,64 @@ unsigned char encode_hex(int h)
 	return hex[h];
 	}
 
+TEST_CASE("util bytes_to_hex")
+	{
+	u_char bytes[40];
+
+	for ( size_t i = 0; i < sizeof(bytes); ++i )
+		bytes[i] = static_cast<u_char>(i * 37 + 5);
+
+	char out[2 * sizeof(bytes)];
+	bytes_to_hex(bytes, sizeof(bytes), out);
+
+	for ( size_t i = 0; i < sizeof(bytes); ++i )
+		{
+		char expected[3];
+		snprintf(expected, sizeof(expected), "%.2hhx", bytes[i]);
+		CHECK(out[2 * i] == expected[0]);
+		CHECK(out[2 * i + 1] == expected[1]);
+		}
+	}
+
+void bytes_to_hex(const u_char* bytes, size_t len, char* out)
+	{
+	static constexpr char hex[] = "0123456789abcdef";
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	// Splits 16 bytes at a time into their nibbles, interleaves them in
+	// output order, and turns them into digits by adding '0' and, for
+	// values above 9, the distance from '9' + 1 to 'a'.
+	const __m128i low_nibble = _mm_set1_epi8(0x0f);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i alpha = _mm_set1_epi8('a' - '9' - 1);
+
+	for ( ; i + 16 <= len; i += 16 )
+		{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low_nibble);
+		__m128i lo = _mm_and_si128(v, low_nibble);
+
+		__m128i halves[2] = {_mm_unpacklo_epi8(hi, lo), _mm_unpackhi_epi8(hi, lo)};
+
+		for ( auto n : halves )
+			{
+			n = _mm_add_epi8(_mm_add_epi8(n, zero),
+			                 _mm_and_si128(_mm_cmpgt_epi8(n, nine), alpha));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), n);
+			out += 16;
+			}
+		}
+#endif
+
+	for ( ; i < len; ++i )
+		{
+		*out++ = hex[bytes[i] >> 4];
+		*out++ = hex[bytes[i] & 0x0f];
+		}
+	}
+
 TEST_CASE("util strpbrk_n")
 	{
 	const char* s = "abcdef";
@@ -1513,6 +1575,18 @@ TEST_CASE("util strstr_n")
 
 	out = strstr_n(16, s, 9, reinterpret_cast<const u_char*>("not there"));
 	CHECK(out == -1);
+
+	out = strstr_n(16, s, 1, reinterpret_cast<const u_char*>("g"));
+	CHECK(out == 15);
+
+	out = strstr_n(16, s, 0, reinterpret_cast<const u_char*>(""));
+	CHECK(out == 0);
+
+	out = strstr_n(16, s, 3, reinterpret_cast<const u_char*>("ing"));
+	CHECK(out == 13);
+
+	out = strstr_n(16, s, 3, reinterpret_cast<const u_char*>("ngx"));
+	CHECK(out == -1);
 	}
 
 int strstr_n(const int big_len, const u_char* big,
@@ -1521,10 +1595,25 @@ int strstr_n(const int big_len, const u_char* big,
 	if ( little_len > big_len )
 		return -1;
 
-	for ( int i = 0; i <= big_len - little_len; ++i )
+	if ( little_len == 0 )
+		return 0;
+
+	// Let memchr(), which libc implementations vectorize, skip ahead
+	// to candidate positions, and only compare the rest there.
+	const u_char* p = big;
+	const u_char* last = big + big_len - little_len;
+
+	while ( p <= last )
 		{
-		if ( ! memcmp(big + i, little, little_len) )
-			return i;
+		p = static_cast<const u_char*>(memchr(p, little[0], last - p + 1));
+
+		if ( ! p )
+			return -1;
+
+		if ( ! memcmp(p + 1, little + 1, little_len - 1) )
+			return p - big;
+
+		++p;
 		}
 
 	return -1;
@@ -2076,6 +2165,9 @@ int time_compare(struct timeval* tv_a, struct timeval* tv_b)
 		return tv_a->tv_sec - tv_b->tv_sec;
 	}
 
+// The number of IDs computed at a time, see UIDEntry::Refill().
+static constexpr size_t UID_BATCH_SIZE = 16;
+
 struct UIDEntry {
 	UIDEntry() : key(0, 0), needs_init(true) { }
 	UIDEntry(const uint64_t i) : key(i, 0), needs_init(false) { }
@@ -2087,6 +2179,30 @@ struct UIDEntry {
 	} key;
 
 	bool needs_init;
+
+	// Hashes the next batch of counter values in one go. The IDs are
+	// the same as when computing them one at a time.
+	void Refill()
+		{
+		for ( size_t i = 0; i < UID_BATCH_SIZE; ++i )
+			{
+			++key.counter;
+			batch[i] = zeek::detail::HashKey::HashBytes(&key, sizeof(key));
+			}
+
+		next = 0;
+		}
+
+	uint64_t Next()
+		{
+		if ( next == UID_BATCH_SIZE )
+			Refill();
+
+		return batch[next++];
+		}
+
+	uint64_t batch[UID_BATCH_SIZE];
+	size_t next = UID_BATCH_SIZE;
 };
 
 static std::vector<UIDEntry> uid_pool;
@@ -2096,7 +2212,7 @@ uint64_t calculate_unique_id()
 	return calculate_unique_id(UID_POOL_DEFAULT_INTERNAL);
 	}
 
-uint64_t calculate_unique_id(size_t pool)
+static UIDEntry& get_uid_entry(size_t pool)
 	{
 	uint64_t uid_instance = 0;
 
@@ -2150,8 +2266,20 @@ uint64_t calculate_unique_id(size_t pool)
 	assert(!uid_pool[pool].needs_init);
 	assert(uid_pool[pool].key.instance != 0);
 
-	++uid_pool[pool].key.counter;
-	return zeek::detail::HashKey::HashBytes(&(uid_pool[pool].key), sizeof(uid_pool[pool].key));
+	return uid_pool[pool];
+	}
+
+uint64_t calculate_unique_id(size_t pool)
+	{
+	return get_uid_entry(pool).Next();
+	}
+
+void calculate_unique_ids(size_t pool, uint64_t* out, size_t n)
+	{
+	auto& e = get_uid_entry(pool);
+
+	for ( size_t i = 0; i < n; ++i )
+		out[i] = e.Next();
 	}
 
 bool safe_write(int fd, const char* data, int len)
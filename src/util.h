@@ -383,6 +383,10 @@ extern void to_upper(char* s);
 extern std::string to_upper(const std::string& s);
 extern int decode_hex(char ch);
 extern unsigned char encode_hex(int h);
+
+// Writes the lowercase hex digits of len bytes to out, which needs room
+// for 2 * len characters.
+extern void bytes_to_hex(const u_char* bytes, size_t len, char* out);
 template<class T> int atoi_n(int len, const char* s, const char** end, int base, T& result);
 extern char* uitoa_n(uint64_t value, char* str, int n, int base, const char* prefix=nullptr);
 extern const char* strpbrk_n(size_t len, const char* s, const char* charset);
@@ -490,6 +494,10 @@ extern int time_compare(struct timeval* tv_a, struct timeval* tv_b);
 extern uint64_t calculate_unique_id();
 extern uint64_t calculate_unique_id(const size_t pool);
 
+// Fills out with n unique IDs from the pool, the same ones n calls of
+// calculate_unique_id() would return.
+extern void calculate_unique_ids(size_t pool, uint64_t* out, size_t n);
+
 // Use for map's string keys.
 struct ltstr {
 	bool operator()(const char* s1, const char* s2) const
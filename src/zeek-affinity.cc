@@ -14,6 +14,10 @@
 
 #include <sched.h>
 
+#include <fstream>
+
+#include "zeek-affinity.h"
+
 namespace zeek {
 bool set_affinity(int core_number)
 	{
@@ -23,6 +27,57 @@ bool set_affinity(int core_number)
 	auto res = sched_setaffinity(0, sizeof(cpus), &cpus);
 	return res == 0;
 	}
+
+bool set_affinity(const std::vector<int>& core_numbers)
+	{
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+
+	for ( auto c : core_numbers )
+		CPU_SET(c, &cpus);
+
+	auto res = sched_setaffinity(0, sizeof(cpus), &cpus);
+	return res == 0;
+	}
+
+static std::string read_sysfs_line(const std::string& path)
+	{
+	std::ifstream f(path);
+	std::string line;
+	std::getline(f, line);
+	return line;
+	}
+
+std::vector<int> online_cpus()
+	{
+	return parse_cpu_list(read_sysfs_line("/sys/devices/system/cpu/online"));
+	}
+
+int interface_numa_node(const std::string& interface)
+	{
+	if ( interface.empty() || interface.find('/') != std::string::npos )
+		return -1;
+
+	auto line = read_sysfs_line("/sys/class/net/" + interface + "/device/numa_node");
+
+	try
+		{
+		return line.empty() ? -1 : std::stoi(line);
+		}
+	catch ( const std::exception& )
+		{
+		return -1;
+		}
+	}
+
+std::vector<int> numa_node_cpus(int node)
+	{
+	if ( node < 0 )
+		return {};
+
+	return parse_cpu_list(read_sysfs_line("/sys/devices/system/node/node" +
+	                                      std::to_string(node) + "/cpulist"));
+	}
 } // namespace zeek
 
 #elif defined(__FreeBSD__)
@@ -30,6 +85,8 @@ bool set_affinity(int core_number)
 #include <sys/param.h>
 #include <sys/cpuset.h>
 
+#include "zeek-affinity.h"
+
 namespace zeek {
 bool set_affinity(int core_number)
 	{
@@ -40,18 +97,136 @@ bool set_affinity(int core_number)
 	                              sizeof(cpus), &cpus);
 	return res == 0;
 	}
+
+bool set_affinity(const std::vector<int>& core_numbers)
+	{
+	cpuset_t cpus;
+	CPU_ZERO(&cpus);
+
+	for ( auto c : core_numbers )
+		CPU_SET(c, &cpus);
+
+	auto res = cpuset_setaffinity(CPU_LEVEL_WHICH, CPU_WHICH_PID, -1,
+	                              sizeof(cpus), &cpus);
+	return res == 0;
+	}
+
+std::vector<int> online_cpus()
+	{
+	return {};
+	}
+
+int interface_numa_node(const std::string& interface)
+	{
+	return -1;
+	}
+
+std::vector<int> numa_node_cpus(int node)
+	{
+	return {};
+	}
 } // namespace zeek
 
 #else
 
 #include <cerrno>
 
+#include "zeek-affinity.h"
+
 namespace zeek {
 bool set_affinity(int core_number)
 	{
 	errno = ENOTSUP;
 	return false;
 	}
+
+bool set_affinity(const std::vector<int>& core_numbers)
+	{
+	errno = ENOTSUP;
+	return false;
+	}
+
+std::vector<int> online_cpus()
+	{
+	return {};
+	}
+
+int interface_numa_node(const std::string& interface)
+	{
+	return -1;
+	}
+
+std::vector<int> numa_node_cpus(int node)
+	{
+	return {};
+	}
 } // namespace zeek
 
 #endif
+
+#include <cctype>
+
+#include "3rdparty/doctest.h"
+
+namespace zeek {
+
+static bool parse_cpu_number(std::string_view s, int* n)
+	{
+	if ( s.empty() || s.size() > 6 )
+		return false;
+
+	*n = 0;
+
+	for ( auto c : s )
+		{
+		if ( ! isdigit(static_cast<unsigned char>(c)) )
+			return false;
+
+		*n = *n * 10 + (c - '0');
+		}
+
+	return true;
+	}
+
+std::vector<int> parse_cpu_list(std::string_view list)
+	{
+	std::vector<int> rval;
+
+	while ( ! list.empty() && isspace(static_cast<unsigned char>(list.back())) )
+		list.remove_suffix(1);
+
+	while ( ! list.empty() )
+		{
+		auto comma = list.find(',');
+		auto range = list.substr(0, comma);
+		list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+		auto dash = range.find('-');
+		int first, last;
+
+		if ( ! parse_cpu_number(range.substr(0, dash), &first) )
+			return {};
+
+		if ( dash == std::string_view::npos )
+			last = first;
+		else if ( ! parse_cpu_number(range.substr(dash + 1), &last) || last < first )
+			return {};
+
+		for ( auto i = first; i <= last; ++i )
+			rval.push_back(i);
+		}
+
+	return rval;
+	}
+
+TEST_CASE("affinity parse_cpu_list")
+	{
+	std::vector<int> expected{0, 1, 2, 3, 8, 10, 11};
+	CHECK(parse_cpu_list("0-3,8,10-11\n") == expected);
+	CHECK(parse_cpu_list("0").size() == 1);
+	CHECK(parse_cpu_list("").empty());
+	CHECK(parse_cpu_list("3-1").empty());
+	CHECK(parse_cpu_list("0,x").empty());
+	}
+
+} // namespace zeek
@@ -2,6 +2,10 @@
 
 #pragma once
 
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace zeek {
 
 /**
@@ -14,4 +18,42 @@ namespace zeek {
  */
 bool set_affinity(int core_number);
 
+/**
+ * Set the process affinity to a set of CPUs.  Currently only supported on
+ * Linux and FreeBSD.
+ * @param core_numbers  the cores on which this process may run.
+ * @return true if the affinity is successfully set and false if not with
+ * errno additionally being set to indicate the reason.
+ */
+bool set_affinity(const std::vector<int>& core_numbers);
+
+/**
+ * Returns the CPUs currently online.  Currently only supported on Linux,
+ * elsewhere this returns an empty list.
+ */
+std::vector<int> online_cpus();
+
+/**
+ * Returns the NUMA node that the device behind a network interface is
+ * attached to.  Currently only supported on Linux.
+ * @param interface  the name of the network interface.
+ * @return the NUMA node, or -1 if unknown, e.g. on single-node systems or
+ * for virtual interfaces.
+ */
+int interface_numa_node(const std::string& interface);
+
+/**
+ * Returns the CPUs belonging to a NUMA node.  Currently only supported on
+ * Linux, elsewhere this returns an empty list.
+ * @param node  the NUMA node.
+ */
+std::vector<int> numa_node_cpus(int node);
+
+/**
+ * Parses a CPU list in the format the Linux kernel uses, e.g., "0-3,8,10-11".
+ * @param list  the list.
+ * @return the CPUs in the list, or an empty list if it's malformed.
+ */
+std::vector<int> parse_cpu_list(std::string_view list);
+
 } // namespace zeek
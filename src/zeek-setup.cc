@@ -39,17 +39,28 @@ extern "C" {
 #include "DFA.h"
 #include "RuleMatcher.h"
 #include "Anon.h"
+#include "ByteCode.h"
+#include "ConstFold.h"
+#include "Inline.h"
 #include "EventRegistry.h"
 #include "Stats.h"
 #include "ScriptCoverageManager.h"
+#include "ScriptProfiler.h"
+#include "AllocationProfiler.h"
+#include "LoopTrace.h"
+#include "Snapshot.h"
+#include "Startup.h"
+#include "ValArena.h"
 #include "Traverse.h"
 #include "Trigger.h"
 #include "Hash.h"
 #include "Func.h"
 #include "ScannedFile.h"
 #include "Frag.h"
+#include "OfflineShards.h"
 
 #include "supervisor/Supervisor.h"
+#include "telemetry/Manager.h"
 #include "threading/Manager.h"
 #include "input/Manager.h"
 #include "logging/Manager.h"
@@ -73,6 +84,14 @@ extern "C" {
 
 zeek::detail::ScriptCoverageManager zeek::detail::script_coverage_mgr;
 zeek::detail::ScriptCoverageManager& brofiler = zeek::detail::script_coverage_mgr;
+zeek::detail::ScriptProfiler zeek::detail::script_profiler;
+zeek::detail::AllocationProfiler* zeek::detail::alloc_profiler = nullptr;
+
+static zeek::detail::StartupProfiler startup_profiler;
+
+// Static so that exiting during initialization still waits for the reads.
+static zeek::detail::FilePrefetcher file_prefetcher;
+zeek::detail::LoopTrace* zeek::detail::loop_trace = nullptr;
 
 #ifndef HAVE_STRSEP
 extern "C" {
@@ -122,6 +141,7 @@ zeek::iosource::Manager*& iosource_mgr = zeek::iosource_mgr;
 zeek::Broker::Manager* zeek::broker_mgr = nullptr;
 zeek::Broker::Manager*& broker_mgr = zeek::broker_mgr;
 zeek::Supervisor* zeek::supervisor_mgr = nullptr;
+zeek::telemetry::Manager* zeek::telemetry_mgr = nullptr;
 zeek::detail::trigger::Manager* zeek::detail::trigger_mgr = nullptr;
 zeek::detail::trigger::Manager*& trigger_mgr = zeek::detail::trigger_mgr;
 
@@ -155,10 +175,14 @@ zeek::OpaqueTypePtr sha256_type;
 zeek::OpaqueTypePtr entropy_type;
 zeek::OpaqueTypePtr cardinality_type;
 zeek::OpaqueTypePtr topk_type;
+zeek::OpaqueTypePtr quantile_type;
 zeek::OpaqueTypePtr bloomfilter_type;
+zeek::OpaqueTypePtr cuckoofilter_type;
 zeek::OpaqueTypePtr x509_opaque_type;
 zeek::OpaqueTypePtr ocsp_resp_opaque_type;
 zeek::OpaqueTypePtr paraglob_type;
+zeek::OpaqueTypePtr pattern_set_type;
+zeek::OpaqueTypePtr base64_decoder_type;
 
 // Keep copy of command line
 int zeek::detail::zeek_argc;
@@ -329,6 +353,18 @@ static void terminate_bro()
 
 	event_mgr.Drain();
 
+	script_profiler.Stop();
+
+	if ( alloc_profiler )
+		alloc_profiler->Dump();
+
+	if ( snapshot )
+		{
+		snapshot->Terminate();
+		delete snapshot;
+		snapshot = nullptr;
+		}
+
 	notifier::detail::registry.Terminate();
 	log_mgr->Terminate();
 	input_mgr->Terminate();
@@ -344,8 +380,10 @@ static void terminate_bro()
 	delete analyzer_mgr;
 	delete packet_mgr;
 	delete file_mgr;
+	delete analyzer_accounting;
 	// broker_mgr, timer_mgr, and supervisor are deleted via iosource_mgr
 	delete iosource_mgr;
+	delete telemetry_mgr;
 	delete event_registry;
 	delete log_mgr;
 	delete reporter;
@@ -356,6 +394,12 @@ static void terminate_bro()
 	// free the global scope
 	pop_scope();
 
+	delete alloc_profiler;
+	alloc_profiler = nullptr;
+
+	delete loop_trace;
+	loop_trace = nullptr;
+
 	reporter = nullptr;
 	}
 
@@ -402,6 +446,7 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	{
 	ZEEK_LSAN_DISABLE();
 	std::set_new_handler(bro_new_handler);
+	startup_profiler.Phase("early-init");
 
 	auto zeek_exe_path = util::detail::get_exe_path(argv[0]);
 
@@ -437,6 +482,9 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		exit(context.run());
 		}
 
+	if ( options.offline_shards > 1 )
+		run_offline_shards(&options);
+
 	auto stem = Supervisor::CreateStem(options.supervisor_mode);
 
 	if ( Supervisor::ThisNode() )
@@ -458,6 +506,7 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		util::tokenize_string(zeek_prefixes, ":", &zeek_script_prefixes);
 
 	run_state::pseudo_realtime = options.pseudo_realtime;
+	run_state::detail::bench_loops = options.bench_loops;
 
 #ifdef USE_PERFTOOLS_DEBUG
 	perftools_leaks = options.perftools_check_leaks;
@@ -546,7 +595,10 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	createCurrentDoc("1.0");		// Set a global XML document
 #endif
 
-	timer_mgr = new PQ_TimerMgr();
+	if ( util::zeekenv("ZEEK_TIMER_WHEEL") )
+		timer_mgr = new Wheel_TimerMgr();
+	else
+		timer_mgr = new PQ_TimerMgr();
 
 	auto zeekygen_cfg = options.zeekygen_config_file.value_or("");
 	zeekygen_mgr = new zeekygen::detail::Manager(zeekygen_cfg, zeek_argv[0]);
@@ -557,8 +609,24 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	if ( ! options.bare_mode )
 		add_input_file("base/init-default.zeek");
 
+	startup_profiler.Phase("plugin-search");
 	plugin_mgr->SearchDynamicPlugins(util::zeek_plugin_path());
 
+	// Their loading has to wait for the managers below, but their reads
+	// from disk don't.
+	if ( ! options.bare_mode )
+		file_prefetcher.Prefetch(plugin_mgr->DynamicPluginLibraries());
+
+	if ( ! options.signature_files.empty() )
+		{
+		std::vector<std::string> sigs;
+
+		for ( const auto& sf : options.signature_files )
+			sigs.emplace_back(util::find_file(sf, util::zeek_path(), ".sig"));
+
+		file_prefetcher.Prefetch(std::move(sigs));
+		}
+
 	if ( options.plugins_to_load.empty() && options.scripts_to_load.empty() &&
 	     options.script_options_to_set.empty() &&
 		 ! options.pcap_file && ! options.interface &&
@@ -588,6 +656,7 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	// policy, but we can't parse policy without DNS resolution.
 	dns_mgr->SetDir(".state");
 
+	startup_profiler.Phase("managers");
 	iosource_mgr = new iosource::Manager();
 	event_registry = new EventRegistry();
 	analyzer_mgr = new analyzer::Manager();
@@ -598,12 +667,27 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	auto broker_real_time = ! options.pcap_file && ! options.deterministic_mode;
 	broker_mgr = new Broker::Manager(broker_real_time);
 	trigger_mgr = new trigger::Manager();
+	telemetry_mgr = new telemetry::Manager();
+
+	if ( const char* alloc_profile = util::zeekenv("ZEEK_ALLOC_PROFILE_FILE") )
+		alloc_profiler = new AllocationProfiler(alloc_profile);
 
+	if ( const char* loop_trace_file = util::zeekenv("ZEEK_LOOP_TRACE_FILE") )
+		{
+		const char* size = util::zeekenv("ZEEK_LOOP_TRACE_SIZE");
+		const char* stall = util::zeekenv("ZEEK_LOOP_TRACE_STALL_MSEC");
+		loop_trace = new LoopTrace(loop_trace_file,
+		                           size ? strtoull(size, nullptr, 10) : 65536,
+		                           stall ? atof(stall) : 100);
+		}
+
+	startup_profiler.Phase("pre-script-init");
 	plugin_mgr->InitPreScript();
 	analyzer_mgr->InitPreScript();
 	file_mgr->InitPreScript();
 	zeekygen_mgr->InitPreScript();
 
+	startup_profiler.Phase("plugin-activation");
 	bool missing_plugin = false;
 
 	for ( set<string>::const_iterator i = requested_plugins.begin();
@@ -618,6 +702,7 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 
 	plugin_mgr->ActivateDynamicPlugins(! options.bare_mode);
 
+	startup_profiler.Phase("builtin-types");
 	init_event_handlers();
 
 	md5_type = make_intrusive<OpaqueType>("md5");
@@ -626,10 +711,14 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	entropy_type = make_intrusive<OpaqueType>("entropy");
 	cardinality_type = make_intrusive<OpaqueType>("cardinality");
 	topk_type = make_intrusive<OpaqueType>("topk");
+	quantile_type = make_intrusive<OpaqueType>("quantile");
 	bloomfilter_type = make_intrusive<OpaqueType>("bloomfilter");
+	cuckoofilter_type = make_intrusive<OpaqueType>("cuckoofilter");
 	x509_opaque_type = make_intrusive<OpaqueType>("x509");
 	ocsp_resp_opaque_type = make_intrusive<OpaqueType>("ocsp_resp");
 	paraglob_type = make_intrusive<OpaqueType>("paraglob");
+	pattern_set_type = make_intrusive<OpaqueType>("pattern_set");
+	base64_decoder_type = make_intrusive<OpaqueType>("base64_decoder");
 
 	// The leak-checker tends to produce some false
 	// positives (memory which had already been
@@ -655,16 +744,38 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		};
 	auto ipbb = make_intrusive<BuiltinFunc>(init_bifs, ipbid->Name(), false);
 
+	startup_profiler.Phase("script-parsing");
 	run_state::is_parsing = true;
 	yyparse();
 	run_state::is_parsing = false;
 
 	RecordVal::DoneParsing();
 	TableVal::DoneParsing();
+	memoize_same_type();
 
+	startup_profiler.Phase("script-init");
 	init_general_global_var();
 	init_net_var();
+
+	// Same for signature files that scripts have added, while the
+	// post-script initialization runs.
+	if ( ! zeek::detail::sig_files.empty() )
+		{
+		std::vector<std::string> sigs;
+
+		for ( const auto& sf : zeek::detail::sig_files )
+			sigs.emplace_back(util::find_file(sf, util::zeek_path(), ".sig"));
+
+		file_prefetcher.Prefetch(std::move(sigs));
+		}
+
+	if ( event_val_arena_size )
+		// Never deleted, values from it may live until the very end.
+		val_arena = new ValArena(event_val_arena_size);
 	run_bif_initializers();
+	fold_constant_expressions();
+	inline_script_function_calls();
+	compile_script_bodies();
 
 	// Assign the script_args for command line processing in Zeek scripts.
 	if ( ! options.script_args.empty() )
@@ -687,17 +798,20 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		"BinPAC::flowbuffer_contract_threshold")->GetVal()->AsCount();
 	binpac::init(&flowbuffer_policy);
 
+	startup_profiler.Phase("bif-init");
 	plugin_mgr->InitBifs();
 
 	if ( reporter->Errors() > 0 )
 		exit(1);
 
+	startup_profiler.Phase("post-script-init");
 	iosource_mgr->InitPostScript();
 	log_mgr->InitPostScript();
 	plugin_mgr->InitPostScript();
 	zeekygen_mgr->InitPostScript();
 	broker_mgr->InitPostScript();
 	timer_mgr->InitPostScript();
+	telemetry_mgr->InitPostScript();
 	event_mgr.InitPostScript();
 
 	if ( supervisor_mgr )
@@ -709,6 +823,9 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		exit(success ? 0 : 1);
 		}
 
+	if ( id::find_val("analyzer_accounting")->AsBool() )
+		analyzer_accounting = new AnalyzerAccounting();
+
 	analyzer_mgr->InitPostScript();
 	packet_mgr->InitPostScript();
 	file_mgr->InitPostScript();
@@ -754,6 +871,8 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	for ( const auto& sf : zeek::detail::sig_files )
 		all_signature_files.emplace_back(sf);
 
+	startup_profiler.Phase("signatures");
+
 	if ( ! all_signature_files.empty() )
 		{
 		rule_matcher = new RuleMatcher(options.signature_re_level);
@@ -788,6 +907,9 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 			}
 		}
 
+	file_prefetcher.Wait();
+	startup_profiler.Phase("run-init");
+
 	if ( dns_type != DNS_PRIME )
 		run_state::detail::init_run(options.interface, options.pcap_file, options.pcap_output_file, options.use_watchdog);
 
@@ -846,6 +968,9 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		// we don't have any other source for it.
 		run_state::detail::update_network_time(util::current_time());
 
+	if ( const char* startup_profile = util::zeekenv("ZEEK_STARTUP_PROFILE_FILE") )
+		startup_profiler.Report(startup_profile);
+
 	if ( zeek_init )
 		event_mgr.Enqueue(zeek_init, Args{});
 
@@ -865,6 +990,8 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	// cause more severe problems.
 	ZEEK_LSAN_ENABLE();
 
+	script_profiler.Start();
+
 	if ( stmts )
 		{
 		StmtFlowType flow;
@@ -905,11 +1032,19 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	// Drain the event queue here to support the protocols framework configuring DPM
 	event_mgr.Drain();
 
+	if ( const auto& sf = id::find_val("snapshot_file")->AsStringVal(); sf->Len() > 0 )
+		{
+		snapshot = new Snapshot(sf->ToStdString(),
+		                        id::find_val("snapshot_interval")->AsInterval());
+		snapshot->Restore();
+		}
+
 	if ( reporter->Errors() > 0 && ! util::zeekenv("ZEEK_ALLOW_INIT_ERRORS") )
 		reporter->FatalError("errors occurred while initializing");
 
 	run_state::detail::zeek_init_done = true;
 	analyzer_mgr->DumpDebug();
+	packet_mgr->InitPostZeekInit();
 	packet_mgr->DumpDebug();
 
 	run_state::detail::have_pending_timers = ! run_state::reading_traces && timer_mgr->Size() > 0;